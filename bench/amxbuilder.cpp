@@ -0,0 +1,296 @@
+// Copyright (c) 2026 Zeex
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <utility>
+#include <amx/amxaux.h>
+#include "amxbuilder.h"
+#include "amxpathfinder.h"
+#include "crashdetect.h"
+
+namespace {
+
+template<typename T>
+void Append(std::vector<unsigned char> &data, const T &value) {
+  const unsigned char *bytes = reinterpret_cast<const unsigned char *>(&value);
+  data.insert(data.end(), bytes, bytes + sizeof(value));
+}
+
+void AppendString(std::vector<unsigned char> &data, const std::string &s) {
+  data.insert(data.end(), s.begin(), s.end());
+  data.push_back('\0');
+}
+
+template<typename T>
+void Write(std::vector<unsigned char> &data, std::size_t offset, T value) {
+  std::memcpy(&data[offset], &value, sizeof(value));
+}
+
+bool CompareFunctionNames(const std::pair<std::string, cell> &a,
+                          const std::pair<std::string, cell> &b) {
+  return a.first < b.first;
+}
+
+} // anonymous namespace
+
+AMXBuilder::AMXBuilder() {
+  // Publics return to address 0.
+  Emit(AMX_OP_HALT, 0);
+}
+
+cell AMXBuilder::GetAddress() const {
+  return static_cast<cell>(code_.size() * sizeof(cell));
+}
+
+void AMXBuilder::Emit(AMXOpcode opcode) {
+  code_.push_back(opcode);
+}
+
+void AMXBuilder::Emit(AMXOpcode opcode, cell operand) {
+  code_.push_back(opcode);
+  code_.push_back(operand);
+}
+
+std::size_t AMXBuilder::EmitJump(AMXOpcode opcode) {
+  Emit(opcode, 0);
+  return code_.size() - 1;
+}
+
+void AMXBuilder::SetJumpTarget(std::size_t jump, cell address) {
+  code_[jump] = address;
+}
+
+void AMXBuilder::AddPublic(const std::string &name, cell address) {
+  Function function = {name, address};
+  publics_.push_back(function);
+}
+
+cell AMXBuilder::AddNative(const std::string &name) {
+  natives_.push_back(name);
+  return static_cast<cell>(natives_.size() - 1);
+}
+
+void AMXBuilder::AddFile(const std::string &name, cell address) {
+  Function file = {name, address};
+  files_.push_back(file);
+}
+
+void AMXBuilder::AddLine(cell address, int32_t line) {
+  AMX_DBG_LINE entry;
+  entry.address = address;
+  entry.line = line;
+  lines_.push_back(entry);
+}
+
+void AMXBuilder::AddFunction(const std::string &name, cell start, cell end) {
+  Symbol symbol = {name, start, start, end, iFUNCTN, 0};
+  symbols_.push_back(symbol);
+}
+
+void AMXBuilder::AddArgument(const std::string &name, int index) {
+  const Symbol &function = symbols_.back();
+  Symbol symbol = {
+    name,
+    static_cast<cell>(3 * sizeof(cell) + index * sizeof(cell)),
+    function.start,
+    function.end,
+    iVARIABLE,
+    1  // local
+  };
+  symbols_.push_back(symbol);
+}
+
+std::vector<unsigned char> AMXBuilder::Build(std::size_t stack_size) const {
+  // The server looks publics up with a binary search.
+  std::vector<std::pair<std::string, cell>> publics;
+  for (std::size_t i = 0; i < publics_.size(); i++) {
+    publics.push_back(std::make_pair(publics_[i].name, publics_[i].address));
+  }
+  std::sort(publics.begin(), publics.end(), CompareFunctionNames);
+
+  std::vector<unsigned char> data(sizeof(AMX_HEADER));
+  std::vector<unsigned char> names;
+  Append(names, static_cast<uint16_t>(sNAMEMAX));
+
+  std::size_t publics_offset = data.size();
+  std::size_t natives_offset = publics_offset
+    + publics.size() * sizeof(AMX_FUNCSTUBNT);
+  std::size_t nametable_offset = natives_offset
+    + natives_.size() * sizeof(AMX_FUNCSTUBNT);
+  for (std::size_t i = 0; i < publics.size(); i++) {
+    AMX_FUNCSTUBNT entry;
+    entry.address = publics[i].second;
+    entry.nameofs = static_cast<uint32_t>(nametable_offset + names.size());
+    Append(data, entry);
+    AppendString(names, publics[i].first);
+  }
+  for (std::size_t i = 0; i < natives_.size(); i++) {
+    AMX_FUNCSTUBNT entry;
+    entry.address = 0;
+    entry.nameofs = static_cast<uint32_t>(nametable_offset + names.size());
+    Append(data, entry);
+    AppendString(names, natives_[i]);
+  }
+  data.insert(data.end(), names.begin(), names.end());
+  data.resize((data.size() + sizeof(cell) - 1) & ~(sizeof(cell) - 1));
+
+  std::size_t code_offset = data.size();
+  for (std::size_t i = 0; i < code_.size(); i++) {
+    Append(data, code_[i]);
+  }
+  // A few cells of data so that the data section isn't empty.
+  std::size_t data_offset = data.size();
+  data.resize(data.size() + 4 * sizeof(cell));
+  std::size_t size = data.size();
+
+  bool has_debug_info =
+    !files_.empty() || !lines_.empty() || !symbols_.empty();
+
+  AMX_HEADER hdr;
+  std::memset(&hdr, 0, sizeof(hdr));
+  hdr.size = static_cast<int32_t>(size);
+  hdr.magic = AMX_MAGIC;
+  hdr.file_version = CUR_FILE_VERSION;
+  hdr.amx_version = MIN_AMX_VERSION;
+  hdr.flags = has_debug_info ? AMX_FLAG_DEBUG : 0;
+  hdr.defsize = sizeof(AMX_FUNCSTUBNT);
+  hdr.cod = static_cast<int32_t>(code_offset);
+  hdr.dat = static_cast<int32_t>(data_offset);
+  hdr.hea = static_cast<int32_t>(size);
+  hdr.stp = static_cast<int32_t>(size + stack_size);
+  hdr.cip = -1;
+  hdr.publics = static_cast<int32_t>(publics_offset);
+  hdr.natives = static_cast<int32_t>(natives_offset);
+  hdr.libraries = static_cast<int32_t>(nametable_offset);
+  hdr.pubvars = static_cast<int32_t>(nametable_offset);
+  hdr.tags = static_cast<int32_t>(nametable_offset);
+  hdr.nametable = static_cast<int32_t>(nametable_offset);
+  Write(data, 0, hdr);
+
+  if (!has_debug_info) {
+    return data;
+  }
+
+  AMX_DBG_HDR dbghdr;
+  std::memset(&dbghdr, 0, sizeof(dbghdr));
+  dbghdr.magic = AMX_DBG_MAGIC;
+  dbghdr.file_version = CUR_FILE_VERSION;
+  dbghdr.amx_version = MIN_AMX_VERSION;
+  // Like the compiler, let the line count wrap around: the reader detects
+  // this.
+  dbghdr.files = static_cast<uint16_t>(files_.size());
+  dbghdr.lines = static_cast<uint16_t>(lines_.size());
+  dbghdr.symbols = static_cast<uint16_t>(symbols_.size());
+  Append(data, dbghdr);
+
+  for (std::size_t i = 0; i < files_.size(); i++) {
+    Append(data, static_cast<ucell>(files_[i].address));
+    AppendString(data, files_[i].name);
+  }
+  for (std::size_t i = 0; i < lines_.size(); i++) {
+    Append(data, lines_[i]);
+  }
+  for (std::size_t i = 0; i < symbols_.size(); i++) {
+    const Symbol &symbol = symbols_[i];
+    Append(data, static_cast<ucell>(symbol.address));
+    Append(data, static_cast<uint16_t>(0));  // tag
+    Append(data, static_cast<ucell>(symbol.start));
+    Append(data, static_cast<ucell>(symbol.end));
+    Append(data, symbol.ident);
+    Append(data, symbol.vclass);
+    Append(data, static_cast<uint16_t>(0));  // dim
+    AppendString(data, symbol.name);
+  }
+
+  dbghdr.size = static_cast<uint32_t>(data.size() - size);
+  Write(data, size, dbghdr);
+  return data;
+}
+
+bool AMXBuilder::WriteFile(const std::string &filename,
+                           std::size_t stack_size) const {
+  std::vector<unsigned char> data = Build(stack_size);
+  std::FILE *file = std::fopen(filename.c_str(), "wb");
+  if (file == nullptr) {
+    return false;
+  }
+  bool ok = std::fwrite(data.data(), 1, data.size(), file) == data.size();
+  std::fclose(file);
+  return ok;
+}
+
+BenchScript::BenchScript(const std::vector<unsigned char> &image,
+                         const AMX_NATIVE_INFO *natives)
+  : attached_(false)
+{
+  AMX_HEADER hdr;
+  std::memcpy(&hdr, image.data(), sizeof(hdr));
+  memory_.resize(hdr.stp);
+  std::memcpy(memory_.data(), image.data(), hdr.size);
+
+  std::memset(&amx_, 0, sizeof(amx_));
+  int error = amx_Init(&amx_, memory_.data());
+  if (error != AMX_ERR_NONE) {
+    std::fprintf(stderr, "amx_Init() failed: %s\n", aux_StrError(error));
+    std::abort();
+  }
+  if (natives != nullptr) {
+    amx_Register(&amx_, natives, -1);
+  }
+}
+
+BenchScript::~BenchScript() {
+  if (attached_) {
+    CrashDetect::GetHandler(&amx_)->Unload();
+    CrashDetect::DestroyHandler(&amx_);
+    AMXPathFinder::shared().Forget(&amx_);
+  }
+  amx_Cleanup(&amx_);
+}
+
+void BenchScript::AttachCrashDetect(const std::string &filename) {
+  if (!filename.empty()) {
+    AMXPathFinder::shared().AddOpenedFile(filename);
+  }
+  CrashDetect *handler = CrashDetect::CreateHandler(&amx_);
+  handler->Load();
+  handler->InstallHooks();
+  attached_ = true;
+}
+
+int BenchScript::Exec(const char *name, cell arg, cell *retval) {
+  int index;
+  int error = amx_FindPublic(&amx_, name, &index);
+  if (error != AMX_ERR_NONE) {
+    return error;
+  }
+  amx_Push(&amx_, arg);
+  if (attached_) {
+    return CrashDetect::GetHandler(&amx_)->OnExec(retval, index);
+  }
+  return amx_Exec(&amx_, retval, index);
+}
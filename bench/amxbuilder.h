@@ -0,0 +1,120 @@
+// Copyright (c) 2026 Zeex
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef AMXBUILDER_H
+#define AMXBUILDER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <amx/amx.h>
+#include <amx/amxdbg.h>
+#include "amxopcode.h"
+
+// Assembles a script in memory, so that the benchmarks don't depend on the
+// Pawn compiler. Code addresses are relative to the start of the code, like
+// in a compiled .amx file. Debug info is optional: it's only written if
+// something has been added to it.
+class AMXBuilder {
+ public:
+  AMXBuilder();
+
+  // Address of the next instruction.
+  cell GetAddress() const;
+
+  void Emit(AMXOpcode opcode);
+  void Emit(AMXOpcode opcode, cell operand);
+
+  // Emits a jump (or call) whose target isn't known yet and returns where
+  // its operand is, for SetJumpTarget().
+  std::size_t EmitJump(AMXOpcode opcode);
+  void SetJumpTarget(std::size_t jump, cell address);
+
+  void AddPublic(const std::string &name, cell address);
+  // Returns the index of the native for SYSREQ.C.
+  cell AddNative(const std::string &name);
+
+  void AddFile(const std::string &name, cell address);
+  void AddLine(cell address, int32_t line);
+  void AddFunction(const std::string &name, cell start, cell end);
+  // An argument of the function added last, numbered from 0.
+  void AddArgument(const std::string &name, int index);
+
+  // Returns the contents of the .amx file.
+  std::vector<unsigned char> Build(std::size_t stack_size = 4096) const;
+  bool WriteFile(const std::string &filename,
+                 std::size_t stack_size = 4096) const;
+
+ private:
+  struct Function {
+    std::string name;
+    cell address;
+  };
+
+  struct Symbol {
+    std::string name;
+    cell address;
+    cell start;
+    cell end;
+    char ident;
+    char vclass;
+  };
+
+  std::vector<cell> code_;
+  std::vector<Function> publics_;
+  std::vector<std::string> natives_;
+  std::vector<Function> files_;
+  std::vector<AMX_DBG_LINE> lines_;
+  std::vector<Symbol> symbols_;
+};
+
+// Loads a script built by AMXBuilder and optionally attaches CrashDetect to
+// it the way the plugin does when the server loads a script.
+class BenchScript {
+ public:
+  BenchScript(const std::vector<unsigned char> &image,
+              const AMX_NATIVE_INFO *natives);
+  ~BenchScript();
+
+  BenchScript(const BenchScript &) = delete;
+  BenchScript &operator=(const BenchScript &) = delete;
+
+  AMX *amx() { return &amx_; }
+
+  // The script must have been written to filename to have its debug info
+  // loaded.
+  void AttachCrashDetect(const std::string &filename = std::string());
+
+  // Calls a public with a single argument, through CrashDetect if it's
+  // attached.
+  int Exec(const char *name, cell arg, cell *retval = nullptr);
+
+ private:
+  std::vector<unsigned char> memory_;
+  AMX amx_;
+  bool attached_;
+};
+
+#endif // !AMXBUILDER_H
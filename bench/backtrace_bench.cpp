@@ -0,0 +1,116 @@
+// Copyright (c) 2026 Zeex
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <cstdio>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "amxbuilder.h"
+#include "bench.h"
+#include "crashdetect.h"
+
+namespace {
+
+const char kScriptFile[] = "crashdetect-bench-backtrace.amx";
+
+BenchmarkState *current_state = nullptr;
+std::size_t backtrace_size = 0;
+
+// Prints the backtrace as many times as the benchmark wants. It's the
+// script that is measured, at the bottom of its call chain.
+cell AMX_NATIVE_CALL BenchBacktrace(AMX *amx, cell *params) {
+  std::ostringstream stream;
+  for (std::size_t i = 0; i < current_state->iterations(); i++) {
+    stream.str(std::string());
+    CrashDetect::PrintAMXBacktrace(stream);
+  }
+  backtrace_size = stream.str().size();
+  return 0;
+}
+
+const AMX_NATIVE_INFO kNatives[] = {
+  {"BenchBacktrace", BenchBacktrace},
+  {nullptr, nullptr}
+};
+
+// public Recurse(n) {
+//   if (n == 0) {
+//     return BenchBacktrace();
+//   }
+//   return Recurse(n - 1);
+// }
+AMXBuilder BuildRecursiveScript() {
+  AMXBuilder builder;
+  cell native = builder.AddNative("BenchBacktrace");
+  cell start = builder.GetAddress();
+  int line = 1;
+  builder.AddFile("backtrace.pwn", start);
+  builder.AddPublic("Recurse", start);
+  builder.AddLine(builder.GetAddress(), line++);
+  builder.Emit(AMX_OP_PROC);
+  builder.AddLine(builder.GetAddress(), line++);
+  builder.Emit(AMX_OP_LOAD_S_PRI, 3 * sizeof(cell));
+  std::size_t end = builder.EmitJump(AMX_OP_JZER);
+  builder.AddLine(builder.GetAddress(), line++);
+  builder.Emit(AMX_OP_ADD_C, -1);
+  builder.Emit(AMX_OP_PUSH_PRI);
+  builder.Emit(AMX_OP_PUSH_C, sizeof(cell));
+  builder.Emit(AMX_OP_CALL, start);
+  builder.Emit(AMX_OP_RETN);
+  builder.SetJumpTarget(end, builder.GetAddress());
+  builder.AddLine(builder.GetAddress(), line++);
+  builder.Emit(AMX_OP_PUSH_C, 0);
+  builder.Emit(AMX_OP_SYSREQ_C, native);
+  builder.Emit(AMX_OP_STACK, sizeof(cell));
+  builder.Emit(AMX_OP_RETN);
+  builder.AddFunction("Recurse", start, builder.GetAddress());
+  builder.AddArgument("n", 0);
+  return builder;
+}
+
+// Prints the AMX backtrace from state.arg() calls deep.
+void PrintAMXBacktrace(BenchmarkState &state) {
+  state.PauseTiming();
+  AMXBuilder builder = BuildRecursiveScript();
+  std::size_t stack_size = 64 * 1024;
+  if (!builder.WriteFile(kScriptFile, stack_size)) {
+    state.SkipWithError("Could not write the script");
+    return;
+  }
+  {
+    BenchScript script(builder.Build(stack_size), kNatives);
+    script.AttachCrashDetect(kScriptFile);
+    current_state = &state;
+    state.ResumeTiming();
+    script.Exec("Recurse", static_cast<cell>(state.arg()));
+    state.PauseTiming();
+    current_state = nullptr;
+  }
+  std::remove(kScriptFile);
+  state.SetLabel(std::to_string(backtrace_size) + " bytes");
+  state.ResumeTiming();
+}
+BENCHMARK_ARGS(PrintAMXBacktrace, 1, 10, 100, 1000);
+
+} // anonymous namespace
@@ -0,0 +1,284 @@
+// Copyright (c) 2026 Zeex
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <vector>
+#include "bench.h"
+#include "jsonwriter.h"
+#include "regexp.h"
+
+namespace {
+
+struct Benchmark {
+  std::string name;
+  BenchmarkFunction function;
+  long arg;
+};
+
+struct BenchmarkResult {
+  std::string name;
+  std::size_t iterations;
+  double ns_per_iteration;
+  double items_per_second;
+  std::string label;
+  std::string error;
+};
+
+std::vector<Benchmark> &GetBenchmarks() {
+  static std::vector<Benchmark> benchmarks;
+  return benchmarks;
+}
+
+std::string FormatDouble(const char *format, double value) {
+  char buffer[64];
+  std::snprintf(buffer, sizeof(buffer), format, value);
+  return buffer;
+}
+
+BenchmarkResult RunBenchmark(const Benchmark &benchmark,
+                             std::chrono::nanoseconds min_time,
+                             int repetitions) {
+  BenchmarkResult result;
+  result.name = benchmark.name;
+  result.iterations = 0;
+  result.ns_per_iteration = 0;
+  result.items_per_second = 0;
+
+  // Find out how many iterations it takes to run for at least min_time.
+  std::size_t iterations = 1;
+  for (;;) {
+    BenchmarkState state(iterations, benchmark.arg);
+    state.Start();
+    benchmark.function(state);
+    std::chrono::nanoseconds time = state.Stop();
+    if (!state.error().empty()) {
+      result.error = state.error();
+      return result;
+    }
+    if (time >= min_time || iterations >= 1000000000) {
+      break;
+    }
+    double scale = time.count() > 0
+      ? 1.4 * min_time.count() / time.count()
+      : 100.0;
+    iterations = static_cast<std::size_t>(
+      iterations * std::max(2.0, std::min(scale, 100.0)));
+  }
+
+  std::vector<double> times;
+  std::vector<double> rates;
+  for (int i = 0; i < repetitions; i++) {
+    BenchmarkState state(iterations, benchmark.arg);
+    state.Start();
+    benchmark.function(state);
+    std::chrono::nanoseconds time = state.Stop();
+    times.push_back(static_cast<double>(time.count()) / iterations);
+    if (state.items_processed() > 0 && time.count() > 0) {
+      rates.push_back(state.items_processed() * 1e9 / time.count());
+    }
+    result.label = state.label();
+  }
+
+  std::sort(times.begin(), times.end());
+  std::sort(rates.begin(), rates.end());
+  result.iterations = iterations;
+  result.ns_per_iteration = times[times.size() / 2];
+  if (!rates.empty()) {
+    result.items_per_second = rates[rates.size() / 2];
+  }
+  return result;
+}
+
+void PrintResult(const BenchmarkResult &result) {
+  if (!result.error.empty()) {
+    std::printf("%-40s ERROR: %s\n", result.name.c_str(),
+                result.error.c_str());
+    return;
+  }
+  std::printf("%-40s %12lu %14.1f", result.name.c_str(),
+              static_cast<unsigned long>(result.iterations),
+              result.ns_per_iteration);
+  if (result.items_per_second > 0) {
+    std::printf(" %14.0f", result.items_per_second);
+  } else {
+    std::printf(" %14s", "");
+  }
+  std::printf(" %s\n", result.label.c_str());
+  std::fflush(stdout);
+}
+
+void WriteResult(JSONWriter &json, const BenchmarkResult &result) {
+  json.BeginObject();
+  json.Field("name", result.name);
+  if (!result.error.empty()) {
+    json.Field("error", result.error);
+  } else {
+    json.Field("iterations", static_cast<unsigned long>(result.iterations));
+    json.Key("ns_per_iteration");
+    json.Raw(FormatDouble("%.3f", result.ns_per_iteration));
+    if (result.items_per_second > 0) {
+      json.Key("items_per_second");
+      json.Raw(FormatDouble("%.0f", result.items_per_second));
+    }
+    if (!result.label.empty()) {
+      json.Field("label", result.label);
+    }
+  }
+  json.EndObject();
+}
+
+void PrintUsage(const char *program) {
+  std::fprintf(stderr,
+               "Usage: %s [--json] [--list] [--min-time=<seconds>] "
+               "[--repetitions=<n>] [<regexp>]\n",
+               program);
+}
+
+} // anonymous namespace
+
+BenchmarkState::BenchmarkState(std::size_t iterations, long arg)
+  : iterations_(iterations),
+    arg_(arg),
+    running_(false),
+    elapsed_(0),
+    items_processed_(0)
+{
+}
+
+void BenchmarkState::PauseTiming() {
+  if (running_) {
+    elapsed_ += Clock::now() - start_time_;
+    running_ = false;
+  }
+}
+
+void BenchmarkState::ResumeTiming() {
+  if (!running_) {
+    start_time_ = Clock::now();
+    running_ = true;
+  }
+}
+
+void BenchmarkState::Start() {
+  elapsed_ = Clock::duration(0);
+  running_ = false;
+  ResumeTiming();
+}
+
+std::chrono::nanoseconds BenchmarkState::Stop() {
+  PauseTiming();
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed_);
+}
+
+BenchmarkRegistrar::BenchmarkRegistrar(const char *name,
+                                       BenchmarkFunction function) {
+  Benchmark benchmark = {name, function, 0};
+  GetBenchmarks().push_back(benchmark);
+}
+
+BenchmarkRegistrar::BenchmarkRegistrar(const char *name,
+                                       BenchmarkFunction function,
+                                       std::initializer_list<long> args) {
+  for (long arg : args) {
+    Benchmark benchmark = {
+      std::string(name) + "/" + std::to_string(arg),
+      function,
+      arg
+    };
+    GetBenchmarks().push_back(benchmark);
+  }
+}
+
+int RunBenchmarks(int argc, char **argv) {
+  bool json_output = false;
+  bool list = false;
+  double min_time = 0.2;
+  int repetitions = 5;
+  std::unique_ptr<RegExp> filter;
+
+  for (int i = 1; i < argc; i++) {
+    const char *arg = argv[i];
+    if (std::strcmp(arg, "--json") == 0) {
+      json_output = true;
+    } else if (std::strcmp(arg, "--list") == 0) {
+      list = true;
+    } else if (std::strncmp(arg, "--min-time=", 11) == 0) {
+      min_time = std::atof(arg + 11);
+    } else if (std::strncmp(arg, "--repetitions=", 14) == 0) {
+      repetitions = std::max(1, std::atoi(arg + 14));
+    } else if (arg[0] == '-') {
+      PrintUsage(argv[0]);
+      return EXIT_FAILURE;
+    } else {
+      filter.reset(new RegExp(arg));
+    }
+  }
+
+  std::vector<Benchmark> benchmarks;
+  for (const Benchmark &benchmark : GetBenchmarks()) {
+    if (filter == nullptr || filter->Test(benchmark.name)) {
+      benchmarks.push_back(benchmark);
+    }
+  }
+  if (list) {
+    for (const Benchmark &benchmark : benchmarks) {
+      std::printf("%s\n", benchmark.name.c_str());
+    }
+    return EXIT_SUCCESS;
+  }
+
+  std::chrono::nanoseconds min_duration(
+    static_cast<long long>(min_time * 1e9));
+  if (!json_output) {
+    std::printf("%-40s %12s %14s %14s\n",
+                "Benchmark", "Iterations", "ns/iteration", "items/s");
+  }
+
+  bool failed = false;
+  JSONWriter json;
+  json.BeginObject();
+  json.Key("benchmarks");
+  json.BeginArray();
+  for (const Benchmark &benchmark : benchmarks) {
+    BenchmarkResult result =
+      RunBenchmark(benchmark, min_duration, repetitions);
+    failed = failed || !result.error.empty();
+    if (json_output) {
+      WriteResult(json, result);
+    } else {
+      PrintResult(result);
+    }
+  }
+  json.EndArray();
+  json.EndObject();
+
+  if (json_output) {
+    std::printf("%s\n", json.str().c_str());
+  }
+  return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,107 @@
+// Copyright (c) 2026 Zeex
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <string>
+
+// A minimal benchmark harness. A benchmark is a function that does what's
+// being measured state.iterations() times. The harness keeps doubling the
+// number of iterations until a run takes long enough, then repeats that run
+// a few times and reports the median time per iteration.
+class BenchmarkState {
+ public:
+  BenchmarkState(std::size_t iterations, long arg);
+
+  std::size_t iterations() const { return iterations_; }
+
+  // The argument the benchmark was registered with (see BENCHMARK_ARGS).
+  long arg() const { return arg_; }
+
+  // Setup and cleanup done inside the benchmark aren't measured if they're
+  // surrounded with these.
+  void PauseTiming();
+  void ResumeTiming();
+
+  // Reports items/s in addition to the time, e.g. when an iteration
+  // processes more than one thing.
+  void SetItemsProcessed(uint64_t items) { items_processed_ = items; }
+  uint64_t items_processed() const { return items_processed_; }
+
+  // Arbitrary text printed next to the result.
+  void SetLabel(const std::string &label) { label_ = label; }
+  const std::string &label() const { return label_; }
+
+  // Aborts the benchmark, e.g. when the setup failed.
+  void SkipWithError(const std::string &error) { error_ = error; }
+  const std::string &error() const { return error_; }
+
+  void Start();
+  std::chrono::nanoseconds Stop();
+
+ private:
+  typedef std::chrono::steady_clock Clock;
+
+  std::size_t iterations_;
+  long arg_;
+  bool running_;
+  Clock::time_point start_time_;
+  Clock::duration elapsed_;
+  uint64_t items_processed_;
+  std::string label_;
+  std::string error_;
+};
+
+typedef void (*BenchmarkFunction)(BenchmarkState &state);
+
+// Use BENCHMARK() or BENCHMARK_ARGS() rather than this. Benchmarks that take
+// an argument are run once for each value in args and named "name/arg".
+class BenchmarkRegistrar {
+ public:
+  BenchmarkRegistrar(const char *name, BenchmarkFunction function);
+  BenchmarkRegistrar(const char *name,
+                     BenchmarkFunction function,
+                     std::initializer_list<long> args);
+};
+
+// Runs the benchmarks whose name matches the regular expression given on
+// the command line (or all of them). Returns the exit code.
+int RunBenchmarks(int argc, char **argv);
+
+#define BENCHMARK_CONCAT2(a, b) a##b
+#define BENCHMARK_CONCAT(a, b) BENCHMARK_CONCAT2(a, b)
+#define BENCHMARK_REGISTRAR \
+  static BenchmarkRegistrar BENCHMARK_CONCAT(benchmark_registrar_, __LINE__)
+
+#define BENCHMARK(function) \
+  BENCHMARK_REGISTRAR(#function, function)
+#define BENCHMARK_ARGS(function, ...) \
+  BENCHMARK_REGISTRAR(#function, function, {__VA_ARGS__})
+
+#endif // !BENCH_H
@@ -0,0 +1,118 @@
+// Copyright (c) 2026 Zeex
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <string>
+#include <vector>
+#include "amxbuilder.h"
+#include "bench.h"
+#include "crashdetect.h"
+
+namespace {
+
+cell AMX_NATIVE_CALL BenchNop(AMX *amx, cell *params) {
+  return 0;
+}
+
+const AMX_NATIVE_INFO kNatives[] = {
+  {"BenchNop", BenchNop},
+  {nullptr, nullptr}
+};
+
+// public Loop(n) { while (n--) BenchNop(); }
+std::vector<unsigned char> BuildLoopScript() {
+  AMXBuilder builder;
+  cell native = builder.AddNative("BenchNop");
+  builder.AddPublic("Loop", builder.GetAddress());
+  builder.Emit(AMX_OP_PROC);
+  cell loop = builder.GetAddress();
+  builder.Emit(AMX_OP_LOAD_S_PRI, 3 * sizeof(cell));
+  std::size_t done = builder.EmitJump(AMX_OP_JZER);
+  builder.Emit(AMX_OP_ADD_C, -1);
+  builder.Emit(AMX_OP_STOR_S_PRI, 3 * sizeof(cell));
+  builder.Emit(AMX_OP_PUSH_C, 0);
+  builder.Emit(AMX_OP_SYSREQ_C, native);
+  builder.Emit(AMX_OP_STACK, sizeof(cell));
+  builder.Emit(AMX_OP_JUMP, loop);
+  builder.SetJumpTarget(done, builder.GetAddress());
+  builder.Emit(AMX_OP_ZERO_PRI);
+  builder.Emit(AMX_OP_RETN);
+  return builder.Build();
+}
+
+enum NativeCallMode {
+  NO_CRASHDETECT,
+  CRASHDETECT,
+  CRASHDETECT_NO_SYSREQ_D
+};
+
+// Calls a native state.iterations() times from a single public call.
+void RunNativeCalls(BenchmarkState &state,
+                    NativeCallMode mode,
+                    const char *trace_flags) {
+  state.PauseTiming();
+  CrashDetect::SetTrace(trace_flags, std::vector<std::string>());
+  {
+    BenchScript script(BuildLoopScript(), kNatives);
+    if (mode != NO_CRASHDETECT) {
+      script.AttachCrashDetect();
+    }
+    // Make every call go through the callback instead of only the first
+    // one.
+    if (mode == CRASHDETECT_NO_SYSREQ_D) {
+      script.amx()->sysreq_d = 0;
+    }
+    state.ResumeTiming();
+    script.Exec("Loop", static_cast<cell>(state.iterations()));
+    state.PauseTiming();
+  }
+  CrashDetect::SetTrace("", std::vector<std::string>());
+  state.ResumeTiming();
+}
+
+// The baseline: how long it takes when the server calls natives itself.
+void NativeCallWithoutCrashDetect(BenchmarkState &state) {
+  RunNativeCalls(state, NO_CRASHDETECT, "");
+}
+BENCHMARK(NativeCallWithoutCrashDetect);
+
+// SYSREQ.C is patched into SYSREQ.D after the first call, so this is
+// mostly the cost of having the script attached.
+void NativeCallSysreqD(BenchmarkState &state) {
+  RunNativeCalls(state, CRASHDETECT, "");
+}
+BENCHMARK(NativeCallSysreqD);
+
+// Every call goes through CrashDetect::OnCallback().
+void NativeCallOnCallback(BenchmarkState &state) {
+  RunNativeCalls(state, CRASHDETECT_NO_SYSREQ_D, "");
+}
+BENCHMARK(NativeCallOnCallback);
+
+// The same with native calls being traced to the log.
+void NativeCallOnCallbackTraced(BenchmarkState &state) {
+  RunNativeCalls(state, CRASHDETECT_NO_SYSREQ_D, "n");
+}
+BENCHMARK(NativeCallOnCallbackTraced);
+
+} // anonymous namespace
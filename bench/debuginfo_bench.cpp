@@ -0,0 +1,168 @@
+// Copyright (c) 2026 Zeex
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <cstdio>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+#include "amxbuilder.h"
+#include "amxdebuginfo.h"
+#include "bench.h"
+
+namespace {
+
+const char kScriptFile[] = "crashdetect-bench-debuginfo.amx";
+
+// About as many functions as a big gamemode has, each with a few lines.
+const int kNumFunctions = 16000;
+const int kLinesPerFunction = 3;
+
+// Number of random addresses looked up in turn.
+const std::size_t kNumAddresses = 4096;
+
+// Returns the size of the code.
+cell WriteLargeScript(const char *filename) {
+  AMXBuilder builder;
+  builder.AddFile("large.pwn", 0);
+  int line = 1;
+  for (int i = 0; i < kNumFunctions; i++) {
+    cell start = builder.GetAddress();
+    builder.AddLine(builder.GetAddress(), line++);
+    builder.Emit(AMX_OP_PROC);
+    builder.AddLine(builder.GetAddress(), line++);
+    builder.Emit(AMX_OP_ZERO_PRI);
+    builder.AddLine(builder.GetAddress(), line++);
+    builder.Emit(AMX_OP_RETN);
+    line += kLinesPerFunction;  // blank lines and braces
+    builder.AddFunction("function" + std::to_string(i),
+                        start,
+                        builder.GetAddress());
+    builder.AddArgument("arg", 0);
+  }
+  cell code_size = builder.GetAddress();
+  return builder.WriteFile(filename) ? code_size : 0;
+}
+
+class LargeDebugInfo {
+ public:
+  LargeDebugInfo() {
+    cell code_size = WriteLargeScript(kScriptFile);
+    if (code_size == 0) {
+      return;
+    }
+    debug_info_.Load(kScriptFile);
+    std::remove(kScriptFile);
+
+    std::mt19937 random;
+    std::uniform_int_distribution<cell> distribution(0, code_size - 1);
+    for (std::size_t i = 0; i < kNumAddresses; i++) {
+      addresses_.push_back(distribution(random) & ~(sizeof(cell) - 1));
+    }
+  }
+
+  const AMXDebugInfo &debug_info() const { return debug_info_; }
+  bool IsLoaded() const { return debug_info_.IsLoaded(); }
+
+  cell GetAddress(std::size_t i) const {
+    return addresses_[i % kNumAddresses];
+  }
+
+  static LargeDebugInfo &shared() {
+    static LargeDebugInfo info;
+    return info;
+  }
+
+ private:
+  AMXDebugInfo debug_info_;
+  std::vector<cell> addresses_;
+};
+
+void DebugInfoLoad(BenchmarkState &state) {
+  state.PauseTiming();
+  if (WriteLargeScript(kScriptFile) == 0) {
+    state.SkipWithError("Could not write the script");
+    return;
+  }
+  state.ResumeTiming();
+  for (std::size_t i = 0; i < state.iterations(); i++) {
+    AMXDebugInfo debug_info;
+    debug_info.Load(kScriptFile);
+  }
+  state.PauseTiming();
+  std::remove(kScriptFile);
+  state.ResumeTiming();
+}
+BENCHMARK(DebugInfoLoad);
+
+void DebugInfoGetLine(BenchmarkState &state) {
+  const LargeDebugInfo &info = LargeDebugInfo::shared();
+  if (!info.IsLoaded()) {
+    state.SkipWithError("Could not load debug info");
+    return;
+  }
+  int32_t sum = 0;
+  for (std::size_t i = 0; i < state.iterations(); i++) {
+    sum += info.debug_info().GetLine(info.GetAddress(i)).GetNumber();
+  }
+  state.SetLabel(sum != 0 ? "" : "no lines found");
+}
+BENCHMARK(DebugInfoGetLine);
+
+void DebugInfoGetFunction(BenchmarkState &state) {
+  const LargeDebugInfo &info = LargeDebugInfo::shared();
+  if (!info.IsLoaded()) {
+    state.SkipWithError("Could not load debug info");
+    return;
+  }
+  std::size_t found = 0;
+  for (std::size_t i = 0; i < state.iterations(); i++) {
+    if (info.debug_info().GetFunction(info.GetAddress(i))) {
+      found++;
+    }
+  }
+  state.SetLabel(found != 0 ? "" : "no functions found");
+}
+BENCHMARK(DebugInfoGetFunction);
+
+void DebugInfoGetArguments(BenchmarkState &state) {
+  const LargeDebugInfo &info = LargeDebugInfo::shared();
+  if (!info.IsLoaded()) {
+    state.SkipWithError("Could not load debug info");
+    return;
+  }
+  std::size_t num_args = 0;
+  for (std::size_t i = 0; i < state.iterations(); i++) {
+    AMXDebugInfo::Symbol function =
+      info.debug_info().GetFunction(info.GetAddress(i));
+    if (function) {
+      num_args +=
+        info.debug_info().GetArguments(function.GetCodeStart()).size();
+    }
+  }
+  state.SetLabel(num_args != 0 ? "" : "no arguments found");
+}
+BENCHMARK(DebugInfoGetArguments);
+
+} // anonymous namespace
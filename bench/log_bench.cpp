@@ -0,0 +1,92 @@
+// Copyright (c) 2026 Zeex
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <string>
+#include "bench.h"
+#include "log.h"
+
+namespace {
+
+// Labels the result with the number of lines dropped since the start, as
+// the queue may not keep up.
+class DroppedLineCounter {
+ public:
+  DroppedLineCounter(): start_(LogGetDroppedLines()) {}
+
+  std::string GetLabel() const {
+    unsigned long dropped = LogGetDroppedLines() - start_;
+    return dropped != 0 ? std::to_string(dropped) + " dropped" : "";
+  }
+
+ private:
+  unsigned long start_;
+};
+
+// Everything printed is written out before the time is taken, so this is
+// the throughput of the whole path, not just of putting lines in the
+// queue.
+void LogDebugPrintThroughput(BenchmarkState &state) {
+  DroppedLineCounter dropped;
+  for (std::size_t i = 0; i < state.iterations(); i++) {
+    LogDebugPrint("Benchmark line %lu: %s",
+                  static_cast<unsigned long>(i),
+                  "the quick brown fox jumps over the lazy dog");
+  }
+  LogFlush();
+  state.SetItemsProcessed(state.iterations());
+  state.SetLabel(dropped.GetLabel());
+}
+BENCHMARK(LogDebugPrintThroughput);
+
+void LogTracePrintThroughput(BenchmarkState &state) {
+  DroppedLineCounter dropped;
+  for (std::size_t i = 0; i < state.iterations(); i++) {
+    LogTracePrint("public OnPlayerUpdate(playerid=%lu)",
+                  static_cast<unsigned long>(i % 1000));
+  }
+  LogFlush();
+  state.SetItemsProcessed(state.iterations());
+  state.SetLabel(dropped.GetLabel());
+}
+BENCHMARK(LogTracePrintThroughput);
+
+// A backtrace-sized report of 20 lines printed as a whole.
+void LogDebugPrintLinesThroughput(BenchmarkState &state) {
+  std::string text;
+  for (int i = 0; i < 20; i++) {
+    text.append("#" + std::to_string(i) +
+                " 00000abc in public OnPlayerUpdate (playerid=0) "
+                "at gamemode.pwn:123\n");
+  }
+  DroppedLineCounter dropped;
+  for (std::size_t i = 0; i < state.iterations(); i++) {
+    LogDebugPrintLines(text.data(), text.length());
+  }
+  LogFlush();
+  state.SetItemsProcessed(state.iterations() * 20);
+  state.SetLabel(dropped.GetLabel());
+}
+BENCHMARK(LogDebugPrintLinesThroughput);
+
+} // anonymous namespace
@@ -0,0 +1,453 @@
+// Copyright (c) 2026 Zeex
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+#ifdef _WIN32
+  #include <direct.h>
+#else
+  #include <sys/stat.h>
+  #include <unistd.h>
+#endif
+#include "jsonwriter.h"
+#include "latencyhistogram.h"
+#include "log.h"
+#include "logprintf.h"
+#include "udpreceiver.h"
+
+// Prints lines from several threads for a while and measures how long each
+// LogDebugPrint()/LogTracePrint() call takes the thread that makes it, how
+// fast the log thread writes them out, how much the queue grows and how
+// many lines get dropped.
+//
+// The log is set up through a server.cfg in a directory of its own
+// (logstress-<sink>), which is also where the output goes:
+//
+//   file     - crashdetect_log logstress.log
+//   server   - the server log, i.e. logprintf(), which here writes to
+//              server_log.txt
+//   network  - crashdetect_log_sink pointed at a local port that counts
+//              what it receives (as the sink is used in addition to the
+//              server log, the server log is discarded in this case)
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+enum Sink {
+  SINK_FILE,
+  SINK_SERVER_LOG,
+  SINK_NETWORK
+};
+
+struct StressOptions {
+  Sink sink;
+  int threads;
+  unsigned long rate;
+  double duration;
+  bool trace;
+  std::size_t line_length;
+  std::vector<std::string> config;
+  bool json;
+};
+
+struct ProducerResult {
+  LatencyHistogram latency;
+  unsigned long lines;
+};
+
+const char *kSinkNames[] = {"file", "server", "network"};
+
+std::FILE *server_log = nullptr;
+
+// Like the server, adds a newline unless there's one already (lines come
+// with one from the log thread).
+void WriteServerLog(const char *format, ...) {
+  static char buffer[65536];
+  std::va_list va;
+  va_start(va, format);
+  int length = std::vsnprintf(buffer, sizeof(buffer), format, va);
+  va_end(va);
+  if (length <= 0) {
+    return;
+  }
+  std::fputs(buffer, server_log);
+  if (buffer[std::min<std::size_t>(length, sizeof(buffer) - 1) - 1] != '\n') {
+    std::fputc('\n', server_log);
+  }
+}
+
+void DiscardLog(const char *format, ...) {
+}
+
+void PrintUsage(const char *program) {
+  std::fprintf(stderr,
+               "Usage: %s [--sink=file|server|network] [--threads=<n>] "
+               "[--rate=<lines per second per thread>] "
+               "[--duration=<seconds>] [--trace] [--line-length=<n>] "
+               "[--config=<server.cfg line>]... [--json]\n",
+               program);
+}
+
+bool ParseOptions(int argc, char **argv, StressOptions &options) {
+  options.sink = SINK_FILE;
+  options.threads = 4;
+  options.rate = 0;
+  options.duration = 5;
+  options.trace = false;
+  options.line_length = 80;
+  options.json = false;
+
+  for (int i = 1; i < argc; i++) {
+    const char *arg = argv[i];
+    if (std::strcmp(arg, "--sink=file") == 0) {
+      options.sink = SINK_FILE;
+    } else if (std::strcmp(arg, "--sink=server") == 0) {
+      options.sink = SINK_SERVER_LOG;
+    } else if (std::strcmp(arg, "--sink=network") == 0) {
+      options.sink = SINK_NETWORK;
+    } else if (std::strncmp(arg, "--threads=", 10) == 0) {
+      options.threads = std::max(1, std::atoi(arg + 10));
+    } else if (std::strncmp(arg, "--rate=", 7) == 0) {
+      options.rate = std::strtoul(arg + 7, nullptr, 10);
+    } else if (std::strncmp(arg, "--duration=", 11) == 0) {
+      options.duration = std::atof(arg + 11);
+    } else if (std::strcmp(arg, "--trace") == 0) {
+      options.trace = true;
+    } else if (std::strncmp(arg, "--line-length=", 14) == 0) {
+      options.line_length = std::strtoul(arg + 14, nullptr, 10);
+    } else if (std::strncmp(arg, "--config=", 9) == 0) {
+      options.config.push_back(arg + 9);
+    } else if (std::strcmp(arg, "--json") == 0) {
+      options.json = true;
+    } else {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool EnterWorkingDirectory(const std::string &name) {
+#ifdef _WIN32
+  _mkdir(name.c_str());
+  return _chdir(name.c_str()) == 0;
+#else
+  mkdir(name.c_str(), 0755);
+  return chdir(name.c_str()) == 0;
+#endif
+}
+
+bool WriteServerConfig(const StressOptions &options, int sink_port) {
+  std::FILE *file = std::fopen("server.cfg", "w");
+  if (file == nullptr) {
+    return false;
+  }
+  switch (options.sink) {
+    case SINK_FILE:
+      std::fprintf(file, "crashdetect_log logstress.log\n");
+      break;
+    case SINK_SERVER_LOG:
+      break;
+    case SINK_NETWORK:
+      std::fprintf(file, "crashdetect_log_sink udp://127.0.0.1:%d\n",
+                   sink_port);
+      break;
+  }
+  for (const std::string &line : options.config) {
+    std::fprintf(file, "%s\n", line.c_str());
+  }
+  std::fclose(file);
+  return true;
+}
+
+unsigned long CountFileLines(const char *filename) {
+  std::FILE *file = std::fopen(filename, "rb");
+  if (file == nullptr) {
+    return 0;
+  }
+  unsigned long lines = 0;
+  char buffer[65536];
+  std::size_t size;
+  while ((size = std::fread(buffer, 1, sizeof(buffer), file)) > 0) {
+    lines += static_cast<unsigned long>(std::count(buffer, buffer + size,
+                                                   '\n'));
+  }
+  std::fclose(file);
+  return lines;
+}
+
+void RunProducer(const StressOptions &options,
+                 int id,
+                 Clock::time_point deadline,
+                 ProducerResult &result) {
+  std::string payload(options.line_length, 'x');
+  Clock::duration interval(0);
+  if (options.rate > 0) {
+    interval = std::chrono::duration_cast<Clock::duration>(
+      std::chrono::nanoseconds(1000000000 / options.rate));
+  }
+  result.lines = 0;
+
+  Clock::time_point next_time = Clock::now();
+  for (;;) {
+    if (options.rate > 0) {
+      next_time += interval;
+      std::this_thread::sleep_until(next_time);
+    }
+    Clock::time_point start = Clock::now();
+    if (start >= deadline) {
+      break;
+    }
+    if (options.trace) {
+      LogTracePrint("public OnStress(thread=%d, line=%lu) %s",
+                    id, result.lines, payload.c_str());
+    } else {
+      LogDebugPrint("Stress thread %d line %lu: %s",
+                    id, result.lines, payload.c_str());
+    }
+    Clock::time_point end = Clock::now();
+    result.latency.Record(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+        end - start).count());
+    result.lines++;
+  }
+}
+
+// Counts the lines that arrive at the network sink.
+void RunReceiver(UDPReceiver &receiver,
+                 const std::atomic<bool> &stop,
+                 std::atomic<unsigned long> &lines) {
+  std::vector<char> buffer(65536);
+  while (!stop) {
+    int size = receiver.Receive(buffer.data(), buffer.size(), 100);
+    if (size > 0) {
+      lines += static_cast<unsigned long>(
+        std::count(buffer.data(), buffer.data() + size, '\n'));
+    }
+  }
+}
+
+// Keeps track of the largest size the overflow list reaches.
+void RunQueueMonitor(const std::atomic<bool> &stop,
+                     std::atomic<std::size_t> &peak) {
+  while (!stop) {
+    std::size_t size = LogGetQueuedBytes();
+    if (size > peak) {
+      peak = size;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+}
+
+double GetSeconds(Clock::duration duration) {
+  return std::chrono::duration_cast<std::chrono::duration<double>>(
+    duration).count();
+}
+
+} // anonymous namespace
+
+int main(int argc, char **argv) {
+  StressOptions options;
+  if (!ParseOptions(argc, argv, options)) {
+    PrintUsage(argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  std::string directory = std::string("logstress-") + kSinkNames[options.sink];
+  if (!EnterWorkingDirectory(directory)) {
+    std::fprintf(stderr, "Could not enter %s\n", directory.c_str());
+    return EXIT_FAILURE;
+  }
+
+  UDPReceiver receiver;
+  if (options.sink == SINK_NETWORK && !receiver.Open()) {
+    std::fprintf(stderr, "Could not open a UDP socket\n");
+    return EXIT_FAILURE;
+  }
+  if (!WriteServerConfig(options, receiver.port())) {
+    std::fprintf(stderr, "Could not write server.cfg\n");
+    return EXIT_FAILURE;
+  }
+  std::remove("logstress.log");
+  if (options.sink == SINK_SERVER_LOG) {
+    server_log = std::fopen("server_log.txt", "w");
+    if (server_log == nullptr) {
+      std::fprintf(stderr, "Could not open server_log.txt\n");
+      return EXIT_FAILURE;
+    }
+    logprintf = WriteServerLog;
+  } else {
+    logprintf = DiscardLog;
+  }
+
+  std::atomic<bool> stop_receiver(false);
+  std::atomic<unsigned long> received_lines(0);
+  std::thread receiver_thread;
+  if (receiver.IsOpen()) {
+    receiver_thread = std::thread(RunReceiver,
+                                  std::ref(receiver),
+                                  std::cref(stop_receiver),
+                                  std::ref(received_lines));
+  }
+
+  // The first line starts the log thread; it's not counted.
+  LogDebugPrint("Log stress test: %d threads, %s sink",
+                options.threads, kSinkNames[options.sink]);
+  LogFlush();
+  unsigned long initial_dropped_lines = LogGetDroppedLines();
+  unsigned long initial_received_lines = received_lines;
+
+  std::atomic<bool> stop_monitor(false);
+  std::atomic<std::size_t> peak_queued_bytes(0);
+  std::thread monitor_thread(RunQueueMonitor,
+                             std::cref(stop_monitor),
+                             std::ref(peak_queued_bytes));
+
+  std::vector<ProducerResult> results(options.threads);
+  std::vector<std::thread> producers;
+  Clock::time_point start_time = Clock::now();
+  Clock::time_point deadline = start_time +
+    std::chrono::duration_cast<Clock::duration>(
+      std::chrono::duration<double>(options.duration));
+  for (int i = 0; i < options.threads; i++) {
+    producers.push_back(std::thread(RunProducer,
+                                    std::cref(options),
+                                    i,
+                                    deadline,
+                                    std::ref(results[i])));
+  }
+  for (std::thread &producer : producers) {
+    producer.join();
+  }
+  Clock::time_point produced_time = Clock::now();
+  LogFlush();
+  Clock::time_point written_time = Clock::now();
+
+  stop_monitor = true;
+  monitor_thread.join();
+
+  // Give the last datagrams a moment to arrive.
+  if (receiver_thread.joinable()) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    stop_receiver = true;
+    receiver_thread.join();
+  }
+
+  LatencyHistogram latency;
+  unsigned long lines = 0;
+  for (const ProducerResult &result : results) {
+    latency.Merge(result.latency);
+    lines += result.lines;
+  }
+  unsigned long dropped_lines = LogGetDroppedLines() - initial_dropped_lines;
+  double produce_seconds = GetSeconds(produced_time - start_time);
+  double write_seconds = GetSeconds(written_time - start_time);
+
+  // What actually came out at the other end, not counting the first line.
+  long long output_lines = -1;
+  switch (options.sink) {
+    case SINK_FILE:
+      output_lines = static_cast<long long>(CountFileLines("logstress.log"));
+      output_lines--;
+      break;
+    case SINK_SERVER_LOG:
+      std::fflush(server_log);
+      output_lines = static_cast<long long>(CountFileLines("server_log.txt"));
+      output_lines--;
+      break;
+    case SINK_NETWORK:
+      output_lines = received_lines - initial_received_lines;
+      break;
+  }
+
+  double produce_rate = produce_seconds > 0 ? lines / produce_seconds : 0;
+  double write_rate = write_seconds > 0 && output_lines > 0
+    ? output_lines / write_seconds
+    : 0;
+
+  if (options.json) {
+    char buffer[64];
+    JSONWriter json;
+    json.BeginObject();
+    json.Field("sink", kSinkNames[options.sink]);
+    json.Field("threads", options.threads);
+    json.Field("rate", options.rate);
+    json.Field("trace", options.trace);
+    json.Field("lines", lines);
+    json.Field("dropped_lines", dropped_lines);
+    json.Field("output_lines", output_lines);
+    json.Key("produce_seconds");
+    std::snprintf(buffer, sizeof(buffer), "%.3f", produce_seconds);
+    json.Raw(buffer);
+    json.Key("write_seconds");
+    std::snprintf(buffer, sizeof(buffer), "%.3f", write_seconds);
+    json.Raw(buffer);
+    json.Field("lines_per_second", static_cast<long long>(write_rate));
+    json.Field("peak_queued_bytes",
+               static_cast<unsigned long>(peak_queued_bytes));
+    json.Key("latency_ns");
+    json.BeginObject();
+    json.Field("p50", static_cast<long long>(latency.GetPercentile(50)));
+    json.Field("p90", static_cast<long long>(latency.GetPercentile(90)));
+    json.Field("p99", static_cast<long long>(latency.GetPercentile(99)));
+    json.Field("p999", static_cast<long long>(latency.GetPercentile(99.9)));
+    json.Field("max", static_cast<long long>(latency.max()));
+    json.EndObject();
+    json.EndObject();
+    std::printf("%s\n", json.str().c_str());
+  } else {
+    std::printf("Sink:            %s\n", kSinkNames[options.sink]);
+    std::printf("Threads:         %d (%s)\n", options.threads,
+                options.trace ? "LogTracePrint" : "LogDebugPrint");
+    std::printf("Lines printed:   %lu in %.3f s (%.0f/s)\n",
+                lines, produce_seconds, produce_rate);
+    std::printf("Lines written:   %lld, written out after %.3f s (%.0f/s)\n",
+                output_lines, write_seconds, write_rate);
+    std::printf("Lines dropped:   %lu\n", dropped_lines);
+    std::printf("Peak overflow:   %lu bytes\n",
+                static_cast<unsigned long>(peak_queued_bytes));
+    std::printf("Print latency:   p50 %lld ns, p90 %lld ns, p99 %lld ns, "
+                "p99.9 %lld ns, max %lld ns\n",
+                static_cast<long long>(latency.GetPercentile(50)),
+                static_cast<long long>(latency.GetPercentile(90)),
+                static_cast<long long>(latency.GetPercentile(99)),
+                static_cast<long long>(latency.GetPercentile(99.9)),
+                static_cast<long long>(latency.max()));
+  }
+
+  if (server_log != nullptr) {
+    logprintf = DiscardLog;
+    std::fclose(server_log);
+  }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,70 @@
+// Copyright (c) 2026 Zeex
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <string>
+#include <vector>
+#include "bench.h"
+#include "regexp.h"
+
+namespace {
+
+// What trace_filter patterns get tested against.
+const char kTraceLine[] =
+  "public OnPlayerKeyStateChange(playerid=12, newkeys=8, oldkeys=0)";
+
+void RunRegExpTest(BenchmarkState &state, const RegExp &regexp) {
+  std::string text(kTraceLine);
+  std::size_t matches = 0;
+  for (std::size_t i = 0; i < state.iterations(); i++) {
+    if (regexp.Test(text)) {
+      matches++;
+    }
+  }
+  state.SetLabel(matches != 0 ? "match" : "no match");
+}
+
+void RegExpTestMatch(BenchmarkState &state) {
+  RegExp regexp("OnPlayer.*newkeys=8");
+  RunRegExpTest(state, regexp);
+}
+BENCHMARK(RegExpTestMatch);
+
+void RegExpTestNoMatch(BenchmarkState &state) {
+  RegExp regexp("^native Set");
+  RunRegExpTest(state, regexp);
+}
+BENCHMARK(RegExpTestNoMatch);
+
+void RegExpTestMultiplePatterns(BenchmarkState &state) {
+  std::vector<std::string> patterns;
+  patterns.push_back("OnPlayerUpdate");
+  patterns.push_back("^native Set");
+  patterns.push_back("playerid=0\\b");
+  patterns.push_back("oldkeys=[1-9]");
+  RegExp regexp(patterns);
+  RunRegExpTest(state, regexp);
+}
+BENCHMARK(RegExpTestMultiplePatterns);
+
+} // anonymous namespace
@@ -0,0 +1,105 @@
+// Copyright (c) 2026 Zeex
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <cstring>
+#include <netinet/in.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include "udpreceiver.h"
+
+namespace {
+
+const std::size_t kInvalidSocket = static_cast<std::size_t>(-1);
+
+} // anonymous namespace
+
+UDPReceiver::UDPReceiver()
+  : socket_(kInvalidSocket),
+    port_(0)
+{
+}
+
+UDPReceiver::~UDPReceiver() {
+  Close();
+}
+
+bool UDPReceiver::Open() {
+  Close();
+
+  int fd = socket(AF_INET, SOCK_DGRAM, 0);
+  if (fd < 0) {
+    return false;
+  }
+
+  sockaddr_in address;
+  std::memset(&address, 0, sizeof(address));
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  address.sin_port = 0;
+  socklen_t length = sizeof(address);
+  if (bind(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0
+      || getsockname(fd, reinterpret_cast<sockaddr *>(&address),
+                     &length) != 0) {
+    close(fd);
+    return false;
+  }
+
+  // Lines come in much faster than the default buffer can take them.
+  int buffer_size = 8 * 1024 * 1024;
+  setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &buffer_size, sizeof(buffer_size));
+
+  socket_ = static_cast<std::size_t>(fd);
+  port_ = ntohs(address.sin_port);
+  return true;
+}
+
+void UDPReceiver::Close() {
+  if (IsOpen()) {
+    close(static_cast<int>(socket_));
+    socket_ = kInvalidSocket;
+    port_ = 0;
+  }
+}
+
+bool UDPReceiver::IsOpen() const {
+  return socket_ != kInvalidSocket;
+}
+
+int UDPReceiver::Receive(char *buffer, std::size_t size, int timeout_ms) {
+  if (!IsOpen()) {
+    return -1;
+  }
+  pollfd fd;
+  fd.fd = static_cast<int>(socket_);
+  fd.events = POLLIN;
+  fd.revents = 0;
+  int result = poll(&fd, 1, timeout_ms);
+  if (result <= 0) {
+    return result;
+  }
+  ssize_t received = recv(static_cast<int>(socket_), buffer, size, 0);
+  return received >= 0 ? static_cast<int>(received) : -1;
+}
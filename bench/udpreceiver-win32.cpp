@@ -0,0 +1,110 @@
+// Copyright (c) 2026 Zeex
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <cstring>
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include "udpreceiver.h"
+
+UDPReceiver::UDPReceiver()
+  : socket_(INVALID_SOCKET),
+    port_(0)
+{
+}
+
+UDPReceiver::~UDPReceiver() {
+  Close();
+}
+
+bool UDPReceiver::Open() {
+  Close();
+
+  static bool wsa_initialized = false;
+  if (!wsa_initialized) {
+    WSADATA wsa_data;
+    if (WSAStartup(MAKEWORD(2, 2), &wsa_data) != 0) {
+      return false;
+    }
+    wsa_initialized = true;
+  }
+
+  SOCKET s = socket(AF_INET, SOCK_DGRAM, 0);
+  if (s == INVALID_SOCKET) {
+    return false;
+  }
+
+  sockaddr_in address;
+  std::memset(&address, 0, sizeof(address));
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  address.sin_port = 0;
+  int length = sizeof(address);
+  if (bind(s, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0
+      || getsockname(s, reinterpret_cast<sockaddr *>(&address),
+                     &length) != 0) {
+    closesocket(s);
+    return false;
+  }
+
+  // Lines come in much faster than the default buffer can take them.
+  int buffer_size = 8 * 1024 * 1024;
+  setsockopt(s, SOL_SOCKET, SO_RCVBUF,
+             reinterpret_cast<const char *>(&buffer_size),
+             sizeof(buffer_size));
+
+  socket_ = static_cast<std::size_t>(s);
+  port_ = ntohs(address.sin_port);
+  return true;
+}
+
+void UDPReceiver::Close() {
+  if (IsOpen()) {
+    closesocket(static_cast<SOCKET>(socket_));
+    socket_ = INVALID_SOCKET;
+    port_ = 0;
+  }
+}
+
+bool UDPReceiver::IsOpen() const {
+  return socket_ != INVALID_SOCKET;
+}
+
+int UDPReceiver::Receive(char *buffer, std::size_t size, int timeout_ms) {
+  if (!IsOpen()) {
+    return -1;
+  }
+  SOCKET s = static_cast<SOCKET>(socket_);
+  fd_set fds;
+  FD_ZERO(&fds);
+  FD_SET(s, &fds);
+  timeval timeout;
+  timeout.tv_sec = timeout_ms / 1000;
+  timeout.tv_usec = (timeout_ms % 1000) * 1000;
+  int result = select(0, &fds, nullptr, nullptr, &timeout);
+  if (result <= 0) {
+    return result;
+  }
+  int received = recv(s, buffer, static_cast<int>(size), 0);
+  return received != SOCKET_ERROR ? received : -1;
+}
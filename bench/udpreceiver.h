@@ -0,0 +1,57 @@
+// Copyright (c) 2026 Zeex
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef UDPRECEIVER_H
+#define UDPRECEIVER_H
+
+#include <cstddef>
+
+// Receives datagrams on a port of the loopback interface, so that what the
+// network log sink sends can be counted.
+class UDPReceiver {
+ public:
+  UDPReceiver();
+  ~UDPReceiver();
+
+  UDPReceiver(const UDPReceiver &) = delete;
+  UDPReceiver &operator=(const UDPReceiver &) = delete;
+
+  // Binds the socket to a free port on 127.0.0.1.
+  bool Open();
+  void Close();
+
+  bool IsOpen() const;
+  int port() const { return port_; }
+
+  // Waits up to timeout_ms for a datagram and receives it. Returns its size,
+  // 0 if nothing came in or -1 on error.
+  int Receive(char *buffer, std::size_t size, int timeout_ms);
+
+ private:
+  // SOCKET on Windows, a file descriptor everywhere else.
+  std::size_t socket_;
+  int port_;
+};
+
+#endif // !UDPRECEIVER_H
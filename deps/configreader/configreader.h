@@ -62,6 +62,8 @@ class ConfigReader {
   template<typename T>
   std::vector<T> GetValues(const std::string &name) const;
 
+  const option_map &GetOptions() const { return options_; }
+
  private:
   option_map options_;
 };
@@ -25,13 +25,21 @@
  * - ABORT() calls an external error handler via amx_RaiseExecError()
  * - ABORT() syncs registers with local variables before return
  * - CHKSTACK(), CHKMARGIN() and CHKHEAP() now use ABORT() instead return
- * - amx->cip is updated after each instruction
+ * - amx->cip is updated after each instruction (unless AMX_FLAG_NOTRACKCIP
+ *   is set, GNU C version only)
  * - CALL.pri and JUMP.pri instructions have been removed
  * - LREF.S.* and SREF.S.* instructions sync STK and FRM before dereferencing
  *   the pointer (because of possible crash)
  * - LCTRL 0xFF always sets PRI to 1
  * - Long call detection
  * - Detection of writes to address 0 (a.k.a "address naught" detection)
+ * - The GNU C version of amx_Exec() lives in amxexec.h and is built in
+ *   several variants with different instrumentation
+ * - Superinstructions (GNU C version only, see amx_FuseOpcodes())
+ * - The opcodes and a few macros have moved to amxinternal.h for the JIT
+ *   (amxjit.c), amx_DecodeOpcodes() translates relocated code back
+ * - Optional opcode and jump target counters (AMX_OPCODE_COUNTS, GNU C
+ *   version only, see amx_SetExecCounts())
  */
 
 #if BUILD_PLATFORM == WINDOWS && BUILD_TYPE == RELEASE && BUILD_COMPILER == MSVC && PAWN_CELL_SIZE == 64
@@ -55,6 +63,7 @@
 #include <limits.h>
 #include <stdarg.h>
 #include <stddef.h>     /* for wchar_t */
+#include <stdlib.h>     /* for qsort() and bsearch() */
 #include <string.h>
 #include "osdefs.h"
 #if defined LINUX || defined __FreeBSD__ || defined __OpenBSD__
@@ -71,31 +80,35 @@
   #include <wchar.h>    /* for wcslen() */
 #endif
 #include "amx.h"
+#include "amxinternal.h"
 #if (defined _Windows && !defined AMX_NODYNALOAD) || (defined JIT && __WIN32__)
   #include <windows.h>
 #endif
 
 /* CheckLongCallTime uses the values in `amx`, but while we're in `Exec`
  * they aren't accurate.
+ * The countdown (long_call_delay) is a local variable of amx_Exec() so that
+ * the compiler can keep it in a register. CIP is stored here as well for the
+ * variants of amx_Exec() that don't do it on every instruction.
  */
-#define CHECK_LONG_CALL_TIME()                \
-  do {                                        \
-    if (long_call_ctl==NULL)                  \
-      break;                                  \
-    static unsigned int long_call_delay=5000; \
-    if (--long_call_delay==0) {               \
-      cell tmp_frm=amx->frm;                  \
-      cell tmp_hea=amx->hea;                  \
-      cell tmp_stk=amx->stk;                  \
-      amx->frm=frm;                           \
-      amx->hea=hea;                           \
-      amx->stk=stk;                           \
-      long_call_ctl(amx,AMX_LCT_CHECK,0);     \
-      long_call_delay=5000;                   \
-      amx->frm=tmp_frm;                       \
-      amx->hea=tmp_hea;                       \
-      amx->stk=tmp_stk;                       \
-    }                                         \
+#define CHECK_LONG_CALL_TIME()                      \
+  do {                                              \
+    if (--long_call_delay==0) {                     \
+      long_call_delay=LONG_CALL_CHECK_INTERVAL;     \
+      if (long_call_ctl!=NULL) {                    \
+        cell tmp_frm=amx->frm;                      \
+        cell tmp_hea=amx->hea;                      \
+        cell tmp_stk=amx->stk;                      \
+        amx->frm=frm;                               \
+        amx->hea=hea;                               \
+        amx->stk=stk;                               \
+        amx->cip=(cell)((unsigned char*)cip-code);  \
+        long_call_ctl(amx,AMX_LCT_CHECK,0);         \
+        amx->frm=tmp_frm;                           \
+        amx->hea=tmp_hea;                           \
+        amx->stk=tmp_stk;                           \
+      }                                             \
+    }                                               \
   } while (0)
 
 /* When one or more of the AMX_funcname macris are defined, we want
@@ -156,160 +169,6 @@
   #undef AMX_UTF8XXX            /* no UTF-8 support in ANSI/ASCII-only version */
 #endif
 
-typedef enum {
-  OP_NONE,              /* invalid opcode */
-  OP_LOAD_PRI,
-  OP_LOAD_ALT,
-  OP_LOAD_S_PRI,
-  OP_LOAD_S_ALT,
-  OP_LREF_PRI,
-  OP_LREF_ALT,
-  OP_LREF_S_PRI,
-  OP_LREF_S_ALT,
-  OP_LOAD_I,
-  OP_LODB_I,
-  OP_CONST_PRI,
-  OP_CONST_ALT,
-  OP_ADDR_PRI,
-  OP_ADDR_ALT,
-  OP_STOR_PRI,
-  OP_STOR_ALT,
-  OP_STOR_S_PRI,
-  OP_STOR_S_ALT,
-  OP_SREF_PRI,
-  OP_SREF_ALT,
-  OP_SREF_S_PRI,
-  OP_SREF_S_ALT,
-  OP_STOR_I,
-  OP_STRB_I,
-  OP_LIDX,
-  OP_LIDX_B,
-  OP_IDXADDR,
-  OP_IDXADDR_B,
-  OP_ALIGN_PRI,
-  OP_ALIGN_ALT,
-  OP_LCTRL,
-  OP_SCTRL,
-  OP_MOVE_PRI,
-  OP_MOVE_ALT,
-  OP_XCHG,
-  OP_PUSH_PRI,
-  OP_PUSH_ALT,
-  OP_PUSH_R,
-  OP_PUSH_C,
-  OP_PUSH,
-  OP_PUSH_S,
-  OP_POP_PRI,
-  OP_POP_ALT,
-  OP_STACK,
-  OP_HEAP,
-  OP_PROC,
-  OP_RET,
-  OP_RETN,
-  OP_CALL,
-  OP_CALL_PRI,
-  OP_JUMP,
-  OP_JREL,
-  OP_JZER,
-  OP_JNZ,
-  OP_JEQ,
-  OP_JNEQ,
-  OP_JLESS,
-  OP_JLEQ,
-  OP_JGRTR,
-  OP_JGEQ,
-  OP_JSLESS,
-  OP_JSLEQ,
-  OP_JSGRTR,
-  OP_JSGEQ,
-  OP_SHL,
-  OP_SHR,
-  OP_SSHR,
-  OP_SHL_C_PRI,
-  OP_SHL_C_ALT,
-  OP_SHR_C_PRI,
-  OP_SHR_C_ALT,
-  OP_SMUL,
-  OP_SDIV,
-  OP_SDIV_ALT,
-  OP_UMUL,
-  OP_UDIV,
-  OP_UDIV_ALT,
-  OP_ADD,
-  OP_SUB,
-  OP_SUB_ALT,
-  OP_AND,
-  OP_OR,
-  OP_XOR,
-  OP_NOT,
-  OP_NEG,
-  OP_INVERT,
-  OP_ADD_C,
-  OP_SMUL_C,
-  OP_ZERO_PRI,
-  OP_ZERO_ALT,
-  OP_ZERO,
-  OP_ZERO_S,
-  OP_SIGN_PRI,
-  OP_SIGN_ALT,
-  OP_EQ,
-  OP_NEQ,
-  OP_LESS,
-  OP_LEQ,
-  OP_GRTR,
-  OP_GEQ,
-  OP_SLESS,
-  OP_SLEQ,
-  OP_SGRTR,
-  OP_SGEQ,
-  OP_EQ_C_PRI,
-  OP_EQ_C_ALT,
-  OP_INC_PRI,
-  OP_INC_ALT,
-  OP_INC,
-  OP_INC_S,
-  OP_INC_I,
-  OP_DEC_PRI,
-  OP_DEC_ALT,
-  OP_DEC,
-  OP_DEC_S,
-  OP_DEC_I,
-  OP_MOVS,
-  OP_CMPS,
-  OP_FILL,
-  OP_HALT,
-  OP_BOUNDS,
-  OP_SYSREQ_PRI,
-  OP_SYSREQ_C,
-  OP_FILE,    /* obsolete */
-  OP_LINE,    /* obsolete */
-  OP_SYMBOL,  /* obsolete */
-  OP_SRANGE,  /* obsolete */
-  OP_JUMP_PRI,
-  OP_SWITCH,
-  OP_CASETBL,
-  OP_SWAP_PRI,
-  OP_SWAP_ALT,
-  OP_PUSHADDR,
-  OP_NOP,
-  OP_SYSREQ_D,
-  OP_SYMTAG,  /* obsolete */
-  OP_BREAK,
-  /* ----- */
-  OP_NUM_OPCODES
-} OPCODE;
-
-#define USENAMETABLE(hdr) \
-                        ((hdr)->defsize==sizeof(AMX_FUNCSTUBNT))
-#define NUMENTRIES(hdr,field,nextfield) \
-                        (unsigned)(((hdr)->nextfield - (hdr)->field) / (hdr)->defsize)
-#define GETENTRY(hdr,table,index) \
-                        (AMX_FUNCSTUB *)((unsigned char*)(hdr) + (unsigned)(hdr)->table + (unsigned)index*(hdr)->defsize)
-#define GETENTRYNAME(hdr,entry) \
-                        ( USENAMETABLE(hdr) \
-                           ? (char *)((unsigned char*)(hdr) + (unsigned)((AMX_FUNCSTUBNT*)(entry))->nameofs) \
-                           : ((AMX_FUNCSTUB*)(entry))->name )
-
 #if !defined NDEBUG
   static int check_endian(void)
   {
@@ -793,6 +652,238 @@ static int amx_BrowseRelocate(AMX *amx)
   return AMX_ERR_NONE;
 }
 
+/* Number of parameters of each instruction, the same as in
+ * amx_BrowseRelocate(): -1 means that the length is variable, -2 that the
+ * instruction is invalid. A superinstruction is only as long as its first
+ * part, the other parts stay in place after it.
+ */
+static const signed char amx_opcodeparams[OP_NUM_FUSED_OPCODES] = {
+  -2,  1,  1,  1,  1,  1,  1,  1, /* OP_NONE */
+   1,  0,  1,  1,  1,  1,  1,  1, /* OP_LREF_S_ALT */
+   1,  1,  1,  1,  1,  1,  1,  0, /* OP_STOR_ALT */
+   1,  0,  1,  0,  1,  1,  1,  1, /* OP_STRB_I */
+   1,  0,  0,  0,  0,  0,  1,  1, /* OP_SCTRL */
+   1,  1,  0,  0,  1,  1,  0,  0, /* OP_PUSH */
+   0,  1,  0,  1,  1,  1,  1,  1, /* OP_RETN */
+   1,  1,  1,  1,  1,  1,  1,  1, /* OP_JNEQ */
+   1,  0,  0,  0,  1,  1,  1,  1, /* OP_JSGEQ */
+   0,  0,  0,  0,  0,  0,  0,  0, /* OP_SMUL */
+   0,  0,  0,  0,  0,  0,  0,  1, /* OP_SUB_ALT */
+   1,  0,  0,  1,  1,  0,  0,  0, /* OP_SMUL_C */
+   0,  0,  0,  0,  0,  0,  0,  0, /* OP_NEQ */
+   0,  1,  1,  0,  0,  1,  1,  0, /* OP_SGEQ */
+   0,  0,  1,  1,  0,  1,  1,  1, /* OP_DEC_PRI */
+   1,  1,  0,  1, -1,  2, -1,  2, /* OP_HALT */
+   0,  1, -1,  0,  0,  1,  0,  1, /* OP_JUMP_PRI */
+   1,  0,                         /* OP_SYMTAG */
+   1,  1,  1                      /* OP_LOAD_S_PRI_PUSH */
+};
+
+/* superinstructions are decoded as the first instruction that they replace */
+static int unfuse_opcode(int op)
+{
+  switch (op) {
+  case OP_LOAD_S_PRI_PUSH:
+    return OP_LOAD_S_PRI;
+  case OP_CONST_PRI_BOUNDS:
+    return OP_CONST_PRI;
+  case OP_PUSH2_C:
+    return OP_PUSH_C;
+  } /* switch */
+  return op;
+}
+
+#if (defined __GNUC__ && !defined __MINGW32__) && !(defined ASM32 || defined JIT)
+
+typedef struct tagOPCODE_ADDR {
+  cell address;
+  int opcode;
+} OPCODE_ADDR;
+
+static int compare_opcode_addr(const void *a, const void *b)
+{
+  cell x=((const OPCODE_ADDR *)a)->address;
+  cell y=((const OPCODE_ADDR *)b)->address;
+  return (x>y) - (x<y);
+}
+
+/* returns the label table of the amx_Exec() variant that the code has been
+ * relocated for */
+static cell *get_opcode_list(AMX *amx)
+{
+  cell *opcode_list;
+  uint16_t flags;
+
+  flags=amx->flags;
+  amx->flags=AMX_FLAG_BROWSE | (flags & (AMX_FLAG_NOTRACKCIP|AMX_FLAG_NOLONGCALL|AMX_FLAG_COUNTOPS));
+  amx_Exec(amx, (cell*)(void*)&opcode_list, 0);
+  amx->flags=flags;
+  return opcode_list;
+}
+
+/* Builds a reverse label table for looking up relocated opcodes with
+ * bsearch(). This fails if the compiler merged the handlers of instructions
+ * of a different length, since then the code can't be walked reliably.
+ */
+static int get_opcode_map(AMX *amx, OPCODE_ADDR map[OP_NUM_FUSED_OPCODES])
+{
+  cell *opcode_list;
+  int i;
+
+  opcode_list=get_opcode_list(amx);
+  for (i=0; i<OP_NUM_FUSED_OPCODES; i++) {
+    map[i].address=opcode_list[i];
+    map[i].opcode=i;
+  } /* for */
+  qsort(map, OP_NUM_FUSED_OPCODES, sizeof(map[0]), compare_opcode_addr);
+  for (i=1; i<OP_NUM_FUSED_OPCODES; i++) {
+    if (map[i].address==map[i-1].address
+        && amx_opcodeparams[map[i].opcode]!=amx_opcodeparams[map[i-1].opcode])
+      return AMX_ERR_GENERAL;
+  } /* for */
+  return AMX_ERR_NONE;
+}
+
+#endif
+
+/* Translates relocated code back to opcodes: for every cell of the code
+ * section, opcodes[i] receives the opcode of the instruction that starts
+ * there, or OP_NONE if the cell is a parameter. Superinstructions are
+ * reported as the first instruction they replace. Jump addresses are left
+ * relocated.
+ */
+int AMXAPI amx_DecodeOpcodes(AMX *amx, unsigned char *opcodes)
+{
+  AMX_HEADER *hdr;
+  unsigned char *code;
+  cell cip, codesize, num;
+  int op;
+  #if (defined __GNUC__ && !defined __MINGW32__) && !(defined ASM32 || defined JIT)
+    OPCODE_ADDR map[OP_NUM_FUSED_OPCODES];
+    OPCODE_ADDR key, *found;
+    int err;
+  #endif
+
+  assert(amx!=NULL);
+  assert(opcodes!=NULL);
+  if ((amx->flags & AMX_FLAG_RELOC)==0)
+    return AMX_ERR_INIT;
+  hdr=(AMX_HEADER *)amx->base;
+  assert(hdr!=NULL);
+  assert(hdr->magic==AMX_MAGIC);
+  code=amx->base+(int)hdr->cod;
+  codesize=hdr->dat - hdr->cod;
+
+  #if (defined __GNUC__ && !defined __MINGW32__) && !(defined ASM32 || defined JIT)
+    if ((err=get_opcode_map(amx, map))!=AMX_ERR_NONE)
+      return err;
+  #elif defined ASM32 || defined JIT
+    /* the labels of the assembler versions are not known here */
+    return AMX_ERR_GENERAL;
+  #endif
+
+  memset(opcodes, OP_NONE, (size_t)(codesize/sizeof(cell)));
+  for (cip=0; cip<codesize; ) {
+    #if (defined __GNUC__ && !defined __MINGW32__) && !(defined ASM32 || defined JIT)
+      key.address=*(cell *)(code+(int)cip);
+      found=(OPCODE_ADDR *)bsearch(&key, map, OP_NUM_FUSED_OPCODES, sizeof(map[0]),
+                                   compare_opcode_addr);
+      op=(found!=NULL) ? found->opcode : OP_NONE;
+    #else
+      op=(int)*(cell *)(code+(int)cip);
+      if (op<0 || op>=OP_NUM_FUSED_OPCODES)
+        op=OP_NONE;
+    #endif
+    if (amx_opcodeparams[op]==-2)
+      return AMX_ERR_INVINSTR;
+    opcodes[cip/sizeof(cell)]=(unsigned char)unfuse_opcode(op);
+
+    cip+=sizeof(cell);
+    num=amx_opcodeparams[op];
+    if (num==-1) {
+      num=*(cell *)(code+(int)cip);
+      if (op==OP_CASETBL)
+        num=(2*num + 2)*sizeof(cell);  /* count, default and the records */
+      else
+        num+=sizeof(cell);             /* OP_FILE, OP_SYMBOL: size in bytes */
+    } else {
+      num*=sizeof(cell);
+    } /* if */
+    cip+=num;
+  } /* for */
+  return AMX_ERR_NONE;
+}
+
+#if (defined __GNUC__ && !defined __MINGW32__) && !(defined ASM32 || defined JIT)
+
+/* Replaces common pairs of instructions in relocated code with
+ * superinstructions. The first instruction of a pair becomes the combined
+ * one and the second is left as is, so the code doesn't move and jumps to
+ * the second instruction still work.
+ */
+int AMXAPI amx_FuseOpcodes(AMX *amx)
+{
+  AMX_HEADER *hdr;
+  unsigned char *code, *opcodes;
+  cell *opcode_list;
+  cell i, prev, ncells;
+  int op, prev_op, fused, err;
+
+  assert(amx!=NULL);
+  if ((amx->flags & AMX_FLAG_RELOC)==0)
+    return AMX_ERR_INIT;
+  hdr=(AMX_HEADER *)amx->base;
+  assert(hdr!=NULL);
+  assert(hdr->magic==AMX_MAGIC);
+  code=amx->base+(int)hdr->cod;
+  ncells=(hdr->dat - hdr->cod)/sizeof(cell);
+
+  if ((opcodes=(unsigned char *)malloc((size_t)ncells+1))==NULL)
+    return AMX_ERR_MEMORY;
+  if ((err=amx_DecodeOpcodes(amx, opcodes))!=AMX_ERR_NONE) {
+    free(opcodes);
+    return err;
+  } /* if */
+  opcode_list=get_opcode_list(amx);
+
+  prev_op=OP_NONE;
+  prev=0;
+  for (i=0; i<ncells; i++) {
+    op=opcodes[i];
+    if (op==OP_NONE)
+      continue;         /* a parameter */
+
+    if (prev_op==OP_LOAD_S_PRI && op==OP_PUSH_PRI)
+      fused=OP_LOAD_S_PRI_PUSH;
+    else if (prev_op==OP_CONST_PRI && op==OP_BOUNDS)
+      fused=OP_CONST_PRI_BOUNDS;
+    else if (prev_op==OP_PUSH_C && op==OP_PUSH_C)
+      fused=OP_PUSH2_C;
+    else
+      fused=OP_NONE;
+    if (fused!=OP_NONE) {
+      ((cell *)code)[prev]=opcode_list[fused];
+      prev_op=OP_NONE;  /* don't use the same instruction twice */
+    } else {
+      prev_op=op;
+      prev=i;
+    } /* if */
+  } /* for */
+  free(opcodes);
+  return AMX_ERR_NONE;
+}
+
+#else
+
+int AMXAPI amx_FuseOpcodes(AMX *amx)
+{
+  /* there are no superinstructions in the other versions */
+  (void)amx;
+  return AMX_ERR_NONE;
+}
+
+#endif
+
 #if AMX_COMPACTMARGIN > 2
 static void expand(unsigned char *code, long codesize, long memsize)
 {
@@ -1626,8 +1717,6 @@ AMX_NATIVE_INFO * AMXAPI amx_NativeInfo(const char *name, AMX_NATIVE func)
 
 #if defined AMX_EXEC || defined AMX_INIT
 
-#define STKMARGIN       ((cell)(16*sizeof(cell)))
-
 int AMXAPI amx_Push(AMX *amx, cell value)
 {
   AMX_HEADER *hdr;
@@ -1720,6 +1809,21 @@ int AMXAPI amx_SetExtHooks(AMX *amx, AMX_EXT_HOOKS *ext_hooks)
 
   return amx_SetUserData(amx,AMX_USERTAG('c','d','e','h'),ext_hooks);
 }
+
+int AMXAPI amx_GetExecCounts(AMX *amx, AMX_EXEC_COUNTS **counts)
+{
+  assert(amx!=NULL);
+  assert(counts!=NULL);
+
+  return amx_GetUserData(amx,AMX_USERTAG('c','d','o','c'),(void **)counts);
+}
+
+int AMXAPI amx_SetExecCounts(AMX *amx, AMX_EXEC_COUNTS *counts)
+{
+  assert(amx!=NULL);
+
+  return amx_SetUserData(amx,AMX_USERTAG('c','d','o','c'),counts);
+}
 #endif /* AMX_XXXUSERDATA */
 
 #define GETPARAM(v)     ( v=*(cell *)cip++ )
@@ -1735,999 +1839,74 @@ int AMXAPI amx_SetExtHooks(AMX *amx, AMX_EXT_HOOKS *ext_hooks)
                           (amx)->hea=reset_hea;                      \
                           return v; }
 
-/* throw an error when writing to address naught is disabled */
-#define CHKNAUGHT()     if (address_naught_ctl!=NULL&&address_naught_ctl(amx,-1)!=0) ABORT(amx, AMX_ERR_ADDRESS_0)
+/* throw an error when writing to address naught is disabled; the state is
+ * cached in a local variable (address_naught) and only changes with SCTRL */
+#define CHKNAUGHT()     if (address_naught) ABORT(amx, AMX_ERR_ADDRESS_0)
 #define CHKMARGIN()     if (hea+STKMARGIN>stk) ABORT(amx, AMX_ERR_STACKERR)
 #define CHKSTACK()      if (stk>amx->stp) ABORT(amx, AMX_ERR_STACKLOW)
 #define CHKHEAP()       if (hea<amx->hlw) ABORT(amx, AMX_ERR_HEAPLOW)
 
+/* report a function entry or return to the host; whether it wants them is
+ * cached in a local variable (function_events) when amx_Exec() starts */
+#define FUNC_EVENT(e)   if (function_events) {                     \
+                          amx->frm=frm;                            \
+                          amx->stk=stk;                            \
+                          amx->hea=hea;                            \
+                          amx->cip=(cell)((unsigned char*)cip-code); \
+                          num=function_ctl(amx,e);                 \
+                          if (num!=AMX_ERR_NONE) ABORT(amx,num);   \
+                        }
+
 #if (defined __GNUC__ && !defined __MINGW32__) && !(defined ASM32 || defined JIT)
     /* GNU C version uses the "labels as values" extension to create
      * fast "indirect threaded" interpreter.
      */
 
-#define NEXT(cip)       do { (amx)->cip=(cell)cip-(cell)code; CHECK_LONG_CALL_TIME(); goto **cip++; } while (0)
+/* The interpreter is instantiated several times from amxexec.h, with and
+ * without the instrumentation that CrashDetect adds to every instruction
+ * (see AMX_FLAG_NOTRACKCIP and AMX_FLAG_NOLONGCALL). Each instance has its
+ * own label table, so the flags must be set when the AMX is relocated and
+ * must not change afterwards.
+ */
+#define AMX_EXEC_NAME       amx_ExecFull
+#define AMX_EXEC_TRACK_CIP  1
+#define AMX_EXEC_LONG_CALL  1
+#include "amxexec.h"
+
+#define AMX_EXEC_NAME       amx_ExecLongCall
+#define AMX_EXEC_TRACK_CIP  0
+#define AMX_EXEC_LONG_CALL  1
+#include "amxexec.h"
+
+#define AMX_EXEC_NAME       amx_ExecErrors
+#define AMX_EXEC_TRACK_CIP  0
+#define AMX_EXEC_LONG_CALL  0
+#include "amxexec.h"
+
+/* The opcode counting variant is for profiling and makes every instruction
+ * slower, so it is only built on request (AMX_FLAG_COUNTOPS is ignored
+ * otherwise).
+ */
+#if defined AMX_OPCODE_COUNTS
+#define AMX_EXEC_NAME       amx_ExecCount
+#define AMX_EXEC_TRACK_CIP  1
+#define AMX_EXEC_LONG_CALL  1
+#define AMX_EXEC_COUNT_OPS  1
+#include "amxexec.h"
+#endif
 
 int AMXAPI amx_Exec(AMX *amx, cell *retval, int index)
 {
-static const void * const amx_opcodelist[] = {
-        &&op_none,      &&op_load_pri,  &&op_load_alt,  &&op_load_s_pri,
-        &&op_load_s_alt,&&op_lref_pri,  &&op_lref_alt,  &&op_lref_s_pri,
-        &&op_lref_s_alt,&&op_load_i,    &&op_lodb_i,    &&op_const_pri,
-        &&op_const_alt, &&op_addr_pri,  &&op_addr_alt,  &&op_stor_pri,
-        &&op_stor_alt,  &&op_stor_s_pri,&&op_stor_s_alt,&&op_sref_pri,
-        &&op_sref_alt,  &&op_sref_s_pri,&&op_sref_s_alt,&&op_stor_i,
-        &&op_strb_i,    &&op_lidx,      &&op_lidx_b,    &&op_idxaddr,
-        &&op_idxaddr_b, &&op_align_pri, &&op_align_alt, &&op_lctrl,
-        &&op_sctrl,     &&op_move_pri,  &&op_move_alt,  &&op_xchg,
-        &&op_push_pri,  &&op_push_alt,  &&op_push_r,    &&op_push_c,
-        &&op_push,      &&op_push_s,    &&op_pop_pri,   &&op_pop_alt,
-        &&op_stack,     &&op_heap,      &&op_proc,      &&op_ret,
-        &&op_retn,      &&op_call,      &&op_call_pri,  &&op_jump,
-        &&op_jrel,      &&op_jzer,      &&op_jnz,       &&op_jeq,
-        &&op_jneq,      &&op_jless,     &&op_jleq,      &&op_jgrtr,
-        &&op_jgeq,      &&op_jsless,    &&op_jsleq,     &&op_jsgrtr,
-        &&op_jsgeq,     &&op_shl,       &&op_shr,       &&op_sshr,
-        &&op_shl_c_pri, &&op_shl_c_alt, &&op_shr_c_pri, &&op_shr_c_alt,
-        &&op_smul,      &&op_sdiv,      &&op_sdiv_alt,  &&op_umul,
-        &&op_udiv,      &&op_udiv_alt,  &&op_add,       &&op_sub,
-        &&op_sub_alt,   &&op_and,       &&op_or,        &&op_xor,
-        &&op_not,       &&op_neg,       &&op_invert,    &&op_add_c,
-        &&op_smul_c,    &&op_zero_pri,  &&op_zero_alt,  &&op_zero,
-        &&op_zero_s,    &&op_sign_pri,  &&op_sign_alt,  &&op_eq,
-        &&op_neq,       &&op_less,      &&op_leq,       &&op_grtr,
-        &&op_geq,       &&op_sless,     &&op_sleq,      &&op_sgrtr,
-        &&op_sgeq,      &&op_eq_c_pri,  &&op_eq_c_alt,  &&op_inc_pri,
-        &&op_inc_alt,   &&op_inc,       &&op_inc_s,     &&op_inc_i,
-        &&op_dec_pri,   &&op_dec_alt,   &&op_dec,       &&op_dec_s,
-        &&op_dec_i,     &&op_movs,      &&op_cmps,      &&op_fill,
-        &&op_halt,      &&op_bounds,    &&op_sysreq_pri,&&op_sysreq_c,
-        &&op_file,      &&op_line,      &&op_symbol,    &&op_srange,
-        &&op_jump_pri,  &&op_switch,    &&op_casetbl,   &&op_swap_pri,
-        &&op_swap_alt,  &&op_pushaddr,  &&op_nop,       &&op_sysreq_d,
-        &&op_symtag,    &&op_break };
-  AMX_HEADER *hdr;
-  AMX_FUNCSTUB *func;
-  unsigned char *code, *data;
-  cell pri,alt,stk,frm,hea;
-  cell reset_stk, reset_hea, *cip;
-  cell offs;
-  ucell codesize;
-  int num,i;
-  AMX_EXT_HOOKS *ext_hooks=NULL;
-  AMX_LCT_CTL long_call_ctl=NULL;
-  AMX_ADDR_0_CTL address_naught_ctl=NULL;
-
-  /* HACK: return label table (for amx_BrowseRelocate) if amx structure
-   * has the AMX_FLAG_BROWSE flag set.
-   */
   assert(amx!=NULL);
-  if ((amx->flags & AMX_FLAG_BROWSE)==AMX_FLAG_BROWSE) {
-    assert(sizeof(cell)==sizeof(void *));
-    assert(retval!=NULL);
-    *retval=(cell)amx_opcodelist;
-    return 0;
-  } /* if */
-
-  if (amx->callback==NULL)
-    return AMX_ERR_CALLBACK;
-  if ((amx->flags & AMX_FLAG_NTVREG)==0)
-    return AMX_ERR_NOTFOUND;
-  if ((amx->flags & AMX_FLAG_RELOC)==0)
-    return AMX_ERR_INIT;
-  assert((amx->flags & AMX_FLAG_BROWSE)==0);
-
-  /* set up the registers */
-  hdr=(AMX_HEADER *)amx->base;
-  assert(hdr->magic==AMX_MAGIC);
-  codesize=(ucell)(hdr->dat-hdr->cod);
-  code=amx->base+(int)hdr->cod;
-  data=(amx->data!=NULL) ? amx->data : amx->base+(int)hdr->dat;
-  hea=amx->hea;
-  stk=amx->stk;
-  reset_stk=stk;
-  reset_hea=hea;
-  alt=frm=0;    /* just to avoid compiler warnings */
-  num=0;        /* just to avoid compiler warnings */
-
-  /* get the start address */
-  if (index==AMX_EXEC_MAIN) {
-    if (hdr->cip<0)
-      return AMX_ERR_INDEX;
-    cip=(cell *)(code + (int)hdr->cip);
-  } else if (index==AMX_EXEC_CONT) {
-    /* all registers: pri, alt, frm, cip, hea, stk, reset_stk, reset_hea */
-    frm=amx->frm;
-    stk=amx->stk;
-    hea=amx->hea;
-    pri=amx->pri;
-    alt=amx->alt;
-    reset_stk=amx->reset_stk;
-    reset_hea=amx->reset_hea;
-    cip=(cell *)(code + (int)amx->cip);
-  } else if (index<0) {
-    return AMX_ERR_INDEX;
-  } else {
-    if (index>=(int)NUMENTRIES(hdr,publics,natives))
-      return AMX_ERR_INDEX;
-    func=GETENTRY(hdr,publics,index);
-    cip=(cell *)(code + (int)func->address);
-  } /* if */
-  /* check values just copied */
-  CHKSTACK();
-  CHKHEAP();
-  assert(check_endian());
-
-  /* sanity checks */
-  assert(OP_PUSH_PRI==36);
-  assert(OP_PROC==46);
-  assert(OP_SHL==65);
-  assert(OP_SMUL==72);
-  assert(OP_EQ==95);
-  assert(OP_INC_PRI==107);
-  assert(OP_MOVS==117);
-  assert(OP_SYMBOL==126);
-  #if PAWN_CELL_SIZE==16
-    assert(sizeof(cell)==2);
-  #elif PAWN_CELL_SIZE==32
-    assert(sizeof(cell)==4);
-  #elif PAWN_CELL_SIZE==64
-    assert(sizeof(cell)==8);
-  #else
-    #error Unsupported cell size
+  #if defined AMX_OPCODE_COUNTS
+    if ((amx->flags & AMX_FLAG_COUNTOPS)!=0)
+      return amx_ExecCount(amx,retval,index);
   #endif
-
-  if (index!=AMX_EXEC_CONT) {
-    reset_stk+=amx->paramcount*sizeof(cell);
-    PUSH(amx->paramcount*sizeof(cell));
-    amx->paramcount=0;          /* push the parameter count to the stack & reset */
-    PUSH(0);                    /* zero return address */
-  } /* if */
-  /* check stack/heap before starting to run */
-  CHKMARGIN();
-
-  /* initialize long_call_ctl */
-  amx_GetExtHooks(amx,&ext_hooks);
-  if (ext_hooks!=NULL)
-    long_call_ctl=ext_hooks->long_call_ctl;
-  if (ext_hooks!=NULL)
-    address_naught_ctl=ext_hooks->address_naught_ctl;
-
-  /* start running */
-  NEXT(cip);
-
-  op_none:
-    ABORT(amx,AMX_ERR_INVINSTR);
-  op_load_pri:
-    GETPARAM(offs);
-    pri=*(cell *)(data+(int)offs);
-    NEXT(cip);
-  op_load_alt:
-    GETPARAM(offs);
-    alt=*(cell *)(data+(int)offs);
-    NEXT(cip);
-  op_load_s_pri:
-    GETPARAM(offs);
-    pri=*(cell *)(data+(int)frm+(int)offs);
-    NEXT(cip);
-  op_load_s_alt:
-    GETPARAM(offs);
-    alt=*(cell *)(data+(int)frm+(int)offs);
-    NEXT(cip);
-  op_lref_pri:
-    GETPARAM(offs);
-    offs=*(cell *)(data+(int)offs);
-    pri=*(cell *)(data+(int)offs);
-    NEXT(cip);
-  op_lref_alt:
-    GETPARAM(offs);
-    offs=*(cell *)(data+(int)offs);
-    alt=*(cell *)(data+(int)offs);
-    NEXT(cip);
-  op_lref_s_pri:
-    GETPARAM(offs);
-    offs=*(cell *)(data+(int)frm+(int)offs);
-    pri=*(cell *)(data+(int)offs);
-    NEXT(cip);
-  op_lref_s_alt:
-    GETPARAM(offs);
-    offs=*(cell *)(data+(int)frm+(int)offs);
-    alt=*(cell *)(data+(int)offs);
-    NEXT(cip);
-  op_load_i:
-    /* verify address */
-    if (pri>=hea && pri<stk || (ucell)pri>=(ucell)amx->stp)
-      ABORT(amx,AMX_ERR_MEMACCESS);
-    pri=*(cell *)(data+(int)pri);
-    NEXT(cip);
-  op_lodb_i:
-    GETPARAM(offs);
-    /* verify address */
-    if (pri>=hea && pri<stk || (ucell)pri>=(ucell)amx->stp)
-      ABORT(amx,AMX_ERR_MEMACCESS);
-    switch (offs) {
-    case 1:
-      pri=*(data+(int)pri);
-      break;
-    case 2:
-      pri=*(uint16_t *)(data+(int)pri);
-      break;
-    case 4:
-      pri=*(uint32_t *)(data+(int)pri);
-      break;
-    } /* switch */
-    NEXT(cip);
-  op_const_pri:
-    GETPARAM(pri);
-    NEXT(cip);
-  op_const_alt:
-    GETPARAM(alt);
-    NEXT(cip);
-  op_addr_pri:
-    GETPARAM(pri);
-    pri+=frm;
-    NEXT(cip);
-  op_addr_alt:
-    GETPARAM(alt);
-    alt+=frm;
-    NEXT(cip);
-  op_stor_pri:
-    GETPARAM(offs);
-    if ((int)offs==0)
-      CHKNAUGHT();
-    *(cell *)(data+(int)offs)=pri;
-    NEXT(cip);
-  op_stor_alt:
-    GETPARAM(offs);
-    if ((int)offs==0)
-      CHKNAUGHT();
-    *(cell *)(data+(int)offs)=alt;
-    NEXT(cip);
-  op_stor_s_pri:
-    GETPARAM(offs);
-    if ((int)frm+(int)offs==0)
-      CHKNAUGHT();
-    *(cell *)(data+(int)frm+(int)offs)=pri;
-    NEXT(cip);
-  op_stor_s_alt:
-    GETPARAM(offs);
-    if ((int)frm+(int)offs==0)
-      CHKNAUGHT();
-    *(cell *)(data+(int)frm+(int)offs)=alt;
-    NEXT(cip);
-  op_sref_pri:
-    GETPARAM(offs);
-    offs=*(cell *)(data+(int)offs);
-    if ((int)offs==0)
-      CHKNAUGHT();
-    *(cell *)(data+(int)offs)=pri;
-    NEXT(cip);
-  op_sref_alt:
-    GETPARAM(offs);
-    offs=*(cell *)(data+(int)offs);
-    if ((int)offs==0)
-      CHKNAUGHT();
-    *(cell *)(data+(int)offs)=alt;
-    NEXT(cip);
-  op_sref_s_pri:
-    GETPARAM(offs);
-    offs=*(cell *)(data+(int)frm+(int)offs);
-    if ((int)offs==0)
-      CHKNAUGHT();
-    *(cell *)(data+(int)offs)=pri;
-    NEXT(cip);
-  op_sref_s_alt:
-    GETPARAM(offs);
-    offs=*(cell *)(data+(int)frm+(int)offs);
-    if ((int)offs==0)
-      CHKNAUGHT();
-    *(cell *)(data+(int)offs)=alt;
-    NEXT(cip);
-  op_stor_i:
-    /* verify address */
-    if (alt>=hea && alt<stk || (ucell)alt>=(ucell)amx->stp)
-      ABORT(amx,AMX_ERR_MEMACCESS);
-    if ((int)alt==0)
-      CHKNAUGHT();
-    *(cell *)(data+(int)alt)=pri;
-    NEXT(cip);
-  op_strb_i:
-    GETPARAM(offs);
-    /* verify address */
-    if (alt>=hea && alt<stk || (ucell)alt>=(ucell)amx->stp)
-      ABORT(amx,AMX_ERR_MEMACCESS);
-    if ((int)offs==0)
-      CHKNAUGHT();
-    switch (offs) {
-    case 1:
-      *(data+(int)alt)=(unsigned char)pri;
-      break;
-    case 2:
-      *(uint16_t *)(data+(int)alt)=(uint16_t)pri;
-      break;
-    case 4:
-      *(uint32_t *)(data+(int)alt)=(uint32_t)pri;
-      break;
-    } /* switch */
-    NEXT(cip);
-  op_lidx:
-    offs=pri*sizeof(cell)+alt;
-    /* verify address */
-    if (offs>=hea && offs<stk || (ucell)offs>=(ucell)amx->stp)
-      ABORT(amx,AMX_ERR_MEMACCESS);
-    pri=*(cell *)(data+(int)offs);
-    NEXT(cip);
-  op_lidx_b:
-    GETPARAM(offs);
-    offs=(pri << (int)offs)+alt;
-    /* verify address */
-    if (offs>=hea && offs<stk || (ucell)offs>=(ucell)amx->stp)
-      ABORT(amx,AMX_ERR_MEMACCESS);
-    pri=*(cell *)(data+(int)offs);
-    NEXT(cip);
-  op_idxaddr:
-    pri=pri*sizeof(cell)+alt;
-    NEXT(cip);
-  op_idxaddr_b:
-    GETPARAM(offs);
-    pri=(pri << (int)offs)+alt;
-    NEXT(cip);
-  op_align_pri:
-    GETPARAM(offs);
-    #if BYTE_ORDER==LITTLE_ENDIAN
-      if (offs<(int)sizeof(cell))
-        pri ^= sizeof(cell)-offs;
-    #endif
-    NEXT(cip);
-  op_align_alt:
-    GETPARAM(offs);
-    #if BYTE_ORDER==LITTLE_ENDIAN
-      if (offs<(int)sizeof(cell))
-        alt ^= sizeof(cell)-offs;
-    #endif
-    NEXT(cip);
-  op_lctrl:
-    GETPARAM(offs);
-    switch (offs) {
-    case 0:
-      pri=hdr->cod;
-      break;
-    case 1:
-      pri=hdr->dat;
-      break;
-    case 2:
-      pri=hea;
-      break;
-    case 3:
-      pri=amx->stp;
-      break;
-    case 4:
-      pri=stk;
-      break;
-    case 5:
-      pri=frm;
-      break;
-    case 6:
-      pri=(cell)((unsigned char *)cip-code);
-      break;
-    case 0xFE:
-      if (long_call_ctl==NULL)
-        pri=0;
-      else
-        pri=long_call_ctl(amx,AMX_LCT_OPTION,AMX_LCT_OPTION_CURRENT);
-      break;
-    case 0xFF:
-      if (ext_hooks==NULL)
-        pri=1|16|32|64;
-      else
-        pri=1|32|(long_call_ctl(amx,AMX_LCT_OPTION,AMX_LCT_OPTION_ACTIVE)<<1)|64|(address_naught_ctl(amx, -1)<<7);
-      break;
-    } /* switch */
-    NEXT(cip);
-  op_sctrl:
-    GETPARAM(offs);
-    switch (offs) {
-    case 0:
-    case 1:
-    case 3:
-      /* cannot change these parameters */
-      break;
-    case 2:
-      hea=pri;
-      break;
-    case 4:
-      stk=pri;
-      break;
-    case 5:
-      frm=pri;
-      break;
-    case 6:
-      cip=(cell *)(code+(int)pri);
-      break;
-    case 0xFE:
-      /* set long_call_time */
-      if (long_call_ctl!=NULL)
-        long_call_ctl(amx,AMX_LCT_SET_TIME,pri);
-      break;
-    case 0xFF:
-      if (long_call_ctl!=NULL) {
-        if (pri&32) {
-          /* long_call_time control */
-          if (pri&2)
-            /* enable long_call_time check */
-            long_call_ctl(amx,AMX_LCT_OPTION,AMX_LCT_OPTION_ENABLE);
-          else if (pri&4)
-            /* reset long_call_time */
-            long_call_ctl(amx,AMX_LCT_OPTION,AMX_LCT_OPTION_RESET);
-          else if (pri&8)
-            /* restart long_call_time check */
-            long_call_ctl(amx,AMX_LCT_OPTION,AMX_LCT_OPTION_RESTART);
-          else
-            /* disable long_call_time check */
-            long_call_ctl(amx, AMX_LCT_OPTION,AMX_LCT_OPTION_DISABLE);
-        }
-      } /* if */
-      if (address_naught_ctl!=NULL) {
-        if (pri&64) {
-          /* address_naught control */
-          if (pri&128)
-            /* enable long_call_time check */
-            address_naught_ctl(amx,1);
-          else
-            /* disable long_call_time check */
-            address_naught_ctl(amx,0);
-        }
-      } /* if */
-      break;
-    } /* switch */
-    NEXT(cip);
-  op_move_pri:
-    pri=alt;
-    NEXT(cip);
-  op_move_alt:
-    alt=pri;
-    NEXT(cip);
-  op_xchg:
-    offs=pri;         /* offs is a temporary variable */
-    pri=alt;
-    alt=offs;
-    NEXT(cip);
-  op_push_pri:
-    PUSH(pri);
-    NEXT(cip);
-  op_push_alt:
-    PUSH(alt);
-    NEXT(cip);
-  op_push_c:
-    GETPARAM(offs);
-    PUSH(offs);
-    NEXT(cip);
-  op_push_r:
-    GETPARAM(offs);
-    while (offs--)
-      PUSH(pri);
-    NEXT(cip);
-  op_push:
-    GETPARAM(offs);
-    PUSH(* (cell *)(data+(int)offs));
-    NEXT(cip);
-  op_push_s:
-    GETPARAM(offs);
-    PUSH(* (cell *)(data+(int)frm+(int)offs));
-    NEXT(cip);
-  op_pop_pri:
-    POP(pri);
-    NEXT(cip);
-  op_pop_alt:
-    POP(alt);
-    NEXT(cip);
-  op_stack:
-    GETPARAM(offs);
-    alt=stk;
-    stk+=offs;
-    CHKMARGIN();
-    CHKSTACK();
-    NEXT(cip);
-  op_heap:
-    GETPARAM(offs);
-    alt=hea;
-    hea+=offs;
-    CHKMARGIN();
-    CHKHEAP();
-    NEXT(cip);
-  op_proc:
-    PUSH(frm);
-    frm=stk;
-    CHKMARGIN();
-    NEXT(cip);
-  op_ret:
-    POP(frm);
-    POP(offs);
-    /* verify the return address */
-    if ((ucell)offs>=codesize)
-      ABORT(amx,AMX_ERR_MEMACCESS);
-    cip=(cell *)(code+(int)offs);
-    NEXT(cip);
-  op_retn:
-    POP(frm);
-    POP(offs);
-    /* verify the return address */
-    if ((ucell)offs>=codesize)
-      ABORT(amx,AMX_ERR_MEMACCESS);
-    cip=(cell *)(code+(int)offs);
-    stk+= *(cell *)(data+(int)stk) + sizeof(cell); /* remove parameters from the stack */
-    NEXT(cip);
-  op_call:
-    PUSH(((unsigned char *)cip-code)+sizeof(cell));/* push address behind instruction */
-    cip=JUMPABS(code, cip);                     /* jump to the address */
-    NEXT(cip);
-  op_call_pri:
-    PUSH((unsigned char *)cip-code);
-    cip=(cell *)(code+(int)pri);
-    NEXT(cip);
-  op_jump:
-    /* since the GETPARAM() macro modifies cip, you cannot
-     * do GETPARAM(cip) directly */
-    cip=JUMPABS(code, cip);
-    NEXT(cip);
-  op_jrel:
-    offs=*cip;
-    cip=(cell *)((unsigned char *)cip + (int)offs + sizeof(cell));
-    NEXT(cip);
-  op_jzer:
-    if (pri==0)
-      cip=JUMPABS(code, cip);
-    else
-      cip=(cell *)((unsigned char *)cip+sizeof(cell));
-    NEXT(cip);
-  op_jnz:
-    if (pri!=0)
-      cip=JUMPABS(code, cip);
-    else
-      cip=(cell *)((unsigned char *)cip+sizeof(cell));
-    NEXT(cip);
-  op_jeq:
-    if (pri==alt)
-      cip=JUMPABS(code, cip);
-    else
-      cip=(cell *)((unsigned char *)cip+sizeof(cell));
-    NEXT(cip);
-  op_jneq:
-    if (pri!=alt)
-      cip=JUMPABS(code, cip);
-    else
-      cip=(cell *)((unsigned char *)cip+sizeof(cell));
-    NEXT(cip);
-  op_jless:
-    if ((ucell)pri < (ucell)alt)
-      cip=JUMPABS(code, cip);
-    else
-      cip=(cell *)((unsigned char *)cip+sizeof(cell));
-    NEXT(cip);
-  op_jleq:
-    if ((ucell)pri <= (ucell)alt)
-      cip=JUMPABS(code, cip);
-    else
-      cip=(cell *)((unsigned char *)cip+sizeof(cell));
-    NEXT(cip);
-  op_jgrtr:
-    if ((ucell)pri > (ucell)alt)
-      cip=JUMPABS(code, cip);
-    else
-      cip=(cell *)((unsigned char *)cip+sizeof(cell));
-    NEXT(cip);
-  op_jgeq:
-    if ((ucell)pri >= (ucell)alt)
-      cip=JUMPABS(code, cip);
-    else
-      cip=(cell *)((unsigned char *)cip+sizeof(cell));
-    NEXT(cip);
-  op_jsless:
-    if (pri<alt)
-      cip=JUMPABS(code, cip);
-    else
-      cip=(cell *)((unsigned char *)cip+sizeof(cell));
-    NEXT(cip);
-  op_jsleq:
-    if (pri<=alt)
-      cip=JUMPABS(code, cip);
-    else
-      cip=(cell *)((unsigned char *)cip+sizeof(cell));
-    NEXT(cip);
-  op_jsgrtr:
-    if (pri>alt)
-      cip=JUMPABS(code, cip);
-    else
-      cip=(cell *)((unsigned char *)cip+sizeof(cell));
-    NEXT(cip);
-  op_jsgeq:
-    if (pri>=alt)
-      cip=JUMPABS(code, cip);
-    else
-      cip=(cell *)((unsigned char *)cip+sizeof(cell));
-    NEXT(cip);
-  op_shl:
-    pri<<=alt;
-    NEXT(cip);
-  op_shr:
-    pri=(ucell)pri >> (ucell)alt;
-    NEXT(cip);
-  op_sshr:
-    pri>>=alt;
-    NEXT(cip);
-  op_shl_c_pri:
-    GETPARAM(offs);
-    pri<<=offs;
-    NEXT(cip);
-  op_shl_c_alt:
-    GETPARAM(offs);
-    alt<<=offs;
-    NEXT(cip);
-  op_shr_c_pri:
-    GETPARAM(offs);
-    pri=(ucell)pri >> (ucell)offs;
-    NEXT(cip);
-  op_shr_c_alt:
-    GETPARAM(offs);
-    alt=(ucell)alt >> (ucell)offs;
-    NEXT(cip);
-  op_smul:
-    pri*=alt;
-    NEXT(cip);
-  op_sdiv:
-    if (alt==0)
-      ABORT(amx,AMX_ERR_DIVIDE);
-    /* divide must always round down; this is a bit
-     * involved to do in a machine-independent way.
-     */
-    offs=(pri % alt + alt) % alt;     /* true modulus */
-    pri=(pri - offs) / alt;           /* division result */
-    alt=offs;
-    NEXT(cip);
-  op_sdiv_alt:
-    if (pri==0)
-      ABORT(amx,AMX_ERR_DIVIDE);
-    /* divide must always round down; this is a bit
-     * involved to do in a machine-independent way.
-     */
-    offs=(alt % pri + pri) % pri;     /* true modulus */
-    pri=(alt - offs) / pri;           /* division result */
-    alt=offs;
-    NEXT(cip);
-  op_umul:
-    pri=(ucell)pri * (ucell)alt;
-    NEXT(cip);
-  op_udiv:
-    if (alt==0)
-      ABORT(amx,AMX_ERR_DIVIDE);
-    offs=(ucell)pri % (ucell)alt;     /* temporary storage */
-    pri=(ucell)pri / (ucell)alt;
-    alt=offs;
-    NEXT(cip);
-  op_udiv_alt:
-    if (pri==0)
-      ABORT(amx,AMX_ERR_DIVIDE);
-    offs=(ucell)alt % (ucell)pri;     /* temporary storage */
-    pri=(ucell)alt / (ucell)pri;
-    alt=offs;
-    NEXT(cip);
-  op_add:
-    pri+=alt;
-    NEXT(cip);
-  op_sub:
-    pri-=alt;
-    NEXT(cip);
-  op_sub_alt:
-    pri=alt-pri;
-    NEXT(cip);
-  op_and:
-    pri&=alt;
-    NEXT(cip);
-  op_or:
-    pri|=alt;
-    NEXT(cip);
-  op_xor:
-    pri^=alt;
-    NEXT(cip);
-  op_not:
-    pri=!pri;
-    NEXT(cip);
-  op_neg:
-    pri=-pri;
-    NEXT(cip);
-  op_invert:
-    pri=~pri;
-    NEXT(cip);
-  op_add_c:
-    GETPARAM(offs);
-    pri+=offs;
-    NEXT(cip);
-  op_smul_c:
-    GETPARAM(offs);
-    pri*=offs;
-    NEXT(cip);
-  op_zero_pri:
-    pri=0;
-    NEXT(cip);
-  op_zero_alt:
-    alt=0;
-    NEXT(cip);
-  op_zero:
-    GETPARAM(offs);
-    *(cell *)(data+(int)offs)=0;
-    NEXT(cip);
-  op_zero_s:
-    GETPARAM(offs);
-    *(cell *)(data+(int)frm+(int)offs)=0;
-    NEXT(cip);
-  op_sign_pri:
-    if ((pri & 0xff)>=0x80)
-      pri|= ~ (ucell)0xff;
-    NEXT(cip);
-  op_sign_alt:
-    if ((alt & 0xff)>=0x80)
-      alt|= ~ (ucell)0xff;
-    NEXT(cip);
-  op_eq:
-    pri= pri==alt ? 1 : 0;
-    NEXT(cip);
-  op_neq:
-    pri= pri!=alt ? 1 : 0;
-    NEXT(cip);
-  op_less:
-    pri= (ucell)pri < (ucell)alt ? 1 : 0;
-    NEXT(cip);
-  op_leq:
-    pri= (ucell)pri <= (ucell)alt ? 1 : 0;
-    NEXT(cip);
-  op_grtr:
-    pri= (ucell)pri > (ucell)alt ? 1 : 0;
-    NEXT(cip);
-  op_geq:
-    pri= (ucell)pri >= (ucell)alt ? 1 : 0;
-    NEXT(cip);
-  op_sless:
-    pri= pri<alt ? 1 : 0;
-    NEXT(cip);
-  op_sleq:
-    pri= pri<=alt ? 1 : 0;
-    NEXT(cip);
-  op_sgrtr:
-    pri= pri>alt ? 1 : 0;
-    NEXT(cip);
-  op_sgeq:
-    pri= pri>=alt ? 1 : 0;
-    NEXT(cip);
-  op_eq_c_pri:
-    GETPARAM(offs);
-    pri= pri==offs ? 1 : 0;
-    NEXT(cip);
-  op_eq_c_alt:
-    GETPARAM(offs);
-    pri= alt==offs ? 1 : 0;
-    NEXT(cip);
-  op_inc_pri:
-    pri++;
-    NEXT(cip);
-  op_inc_alt:
-    alt++;
-    NEXT(cip);
-  op_inc:
-    GETPARAM(offs);
-    *(cell *)(data+(int)offs) += 1;
-    NEXT(cip);
-  op_inc_s:
-    GETPARAM(offs);
-    *(cell *)(data+(int)frm+(int)offs) += 1;
-    NEXT(cip);
-  op_inc_i:
-    *(cell *)(data+(int)pri) += 1;
-    NEXT(cip);
-  op_dec_pri:
-    pri--;
-    NEXT(cip);
-  op_dec_alt:
-    alt--;
-    NEXT(cip);
-  op_dec:
-    GETPARAM(offs);
-    *(cell *)(data+(int)offs) -= 1;
-    NEXT(cip);
-  op_dec_s:
-    GETPARAM(offs);
-    *(cell *)(data+(int)frm+(int)offs) -= 1;
-    NEXT(cip);
-  op_dec_i:
-    *(cell *)(data+(int)pri) -= 1;
-    NEXT(cip);
-  op_movs:
-    GETPARAM(offs);
-    /* verify top & bottom memory addresses, for both source and destination
-     * addresses
-     */
-    if (pri>=hea && pri<stk || (ucell)pri>=(ucell)amx->stp)
-      ABORT(amx,AMX_ERR_MEMACCESS);
-    if ((pri+offs)>hea && (pri+offs)<stk || (ucell)(pri+offs)>(ucell)amx->stp)
-      ABORT(amx,AMX_ERR_MEMACCESS);
-    if (alt>=hea && alt<stk || (ucell)alt>=(ucell)amx->stp)
-      ABORT(amx,AMX_ERR_MEMACCESS);
-    if ((alt+offs)>hea && (alt+offs)<stk || (ucell)(alt+offs)>(ucell)amx->stp)
-      ABORT(amx,AMX_ERR_MEMACCESS);
-    memcpy(data+(int)alt, data+(int)pri, (int)offs);
-    NEXT(cip);
-  op_cmps:
-    GETPARAM(offs);
-    /* verify top & bottom memory addresses, for both source and destination
-     * addresses
-     */
-    if (pri>=hea && pri<stk || (ucell)pri>=(ucell)amx->stp)
-      ABORT(amx,AMX_ERR_MEMACCESS);
-    if ((pri+offs)>hea && (pri+offs)<stk || (ucell)(pri+offs)>(ucell)amx->stp)
-      ABORT(amx,AMX_ERR_MEMACCESS);
-    if (alt>=hea && alt<stk || (ucell)alt>=(ucell)amx->stp)
-      ABORT(amx,AMX_ERR_MEMACCESS);
-    if ((alt+offs)>hea && (alt+offs)<stk || (ucell)(alt+offs)>(ucell)amx->stp)
-      ABORT(amx,AMX_ERR_MEMACCESS);
-    pri=memcmp(data+(int)alt, data+(int)pri, (int)offs);
-    NEXT(cip);
-  op_fill:
-    GETPARAM(offs);
-    /* verify top & bottom memory addresses */
-    if (alt>=hea && alt<stk || (ucell)alt>=(ucell)amx->stp)
-      ABORT(amx,AMX_ERR_MEMACCESS);
-    if ((alt+offs)>hea && (alt+offs)<stk || (ucell)(alt+offs)>(ucell)amx->stp)
-      ABORT(amx,AMX_ERR_MEMACCESS);
-    for (i=(int)alt; offs>=(int)sizeof(cell); i+=sizeof(cell), offs-=sizeof(cell))
-      *(cell *)(data+i) = pri;
-    NEXT(cip);
-  op_halt:
-    GETPARAM(offs);
-    if (retval!=NULL)
-      *retval=pri;
-    /* store complete status (stk and hea are already set in the ABORT macro) */
-    amx->frm=frm;
-    amx->pri=pri;
-    amx->alt=alt;
-    if (offs!=AMX_ERR_SLEEP) {
-      ABORT(amx,(int)offs);
-    } else {
-      amx->cip=(cell)((unsigned char*)cip-code);
-      amx->reset_stk=reset_stk;
-      amx->reset_hea=reset_hea;
-      return (int)offs;
-    } /* if */
-  op_bounds:
-    GETPARAM(offs);
-    if ((ucell)pri>(ucell)offs)
-      ABORT(amx,AMX_ERR_BOUNDS);
-    NEXT(cip);
-  op_sysreq_pri:
-    /* save a few registers */
-    amx->cip=(cell)((unsigned char *)cip-code);
-    amx->hea=hea;
-    amx->frm=frm;
-    amx->stk=stk;
-    num=amx->callback(amx,pri,&pri,(cell *)(data+(int)stk));
-    if (num!=AMX_ERR_NONE) {
-      if (num==AMX_ERR_SLEEP) {
-        amx->pri=pri;
-        amx->alt=alt;
-        amx->reset_stk=reset_stk;
-        amx->reset_hea=reset_hea;
-        return num;
-      } /* if */
-      ABORT(amx,num);
-    } /* if */
-    NEXT(cip);
-  op_sysreq_c:
-    GETPARAM(offs);
-    /* save a few registers */
-    amx->cip=(cell)((unsigned char *)cip-code);
-    amx->hea=hea;
-    amx->frm=frm;
-    amx->stk=stk;
-    num=amx->callback(amx,offs,&pri,(cell *)(data+(int)stk));
-    if (num!=AMX_ERR_NONE) {
-      if (num==AMX_ERR_SLEEP) {
-        amx->pri=pri;
-        amx->alt=alt;
-        amx->reset_stk=reset_stk;
-        amx->reset_hea=reset_hea;
-        return num;
-      } /* if */
-      ABORT(amx,num);
-    } /* if */
-    NEXT(cip);
-  op_sysreq_d:
-    GETPARAM(offs);
-    /* save a few registers */
-    amx->cip=(cell)((unsigned char *)cip-code);
-    amx->hea=hea;
-    amx->frm=frm;
-    amx->stk=stk;
-    pri=((AMX_NATIVE)offs)(amx,(cell *)(data+(int)stk));
-    if (amx->error!=AMX_ERR_NONE) {
-      if (amx->error==AMX_ERR_SLEEP) {
-        amx->pri=pri;
-        amx->alt=alt;
-        amx->reset_stk=reset_stk;
-        amx->reset_hea=reset_hea;
-        return num;
-      } /* if */
-      ABORT(amx,amx->error);
-    } /* if */
-    NEXT(cip);
-  op_file:
-    GETPARAM(offs);
-    cip=(cell *)((unsigned char *)cip + (int)offs);
-    assert(0);        /* this code should not occur during execution */
-    NEXT(cip);
-  op_line:
-    SKIPPARAM(2);
-    NEXT(cip);
-  op_symbol:
-    GETPARAM(offs);
-    cip=(cell *)((unsigned char *)cip + (int)offs);
-    NEXT(cip);
-  op_srange:
-    SKIPPARAM(2);
-    NEXT(cip);
-  op_symtag:
-    SKIPPARAM(1);
-    NEXT(cip);
-  op_jump_pri:
-    cip=(cell *)(code+(int)pri);
-    NEXT(cip);
-  op_switch: {
-    cell *cptr;
-    cptr=JUMPABS(code,cip)+1;   /* +1, to skip the "casetbl" opcode */
-    cip=JUMPABS(code,cptr+1);   /* preset to "none-matched" case */
-    num=(int)*cptr;             /* number of records in the case table */
-    for (cptr+=2; num>0 && *cptr!=pri; num--,cptr+=2)
-      /* nothing */;
-    if (num>0)
-      cip=JUMPABS(code,cptr+1); /* case found */
-    NEXT(cip);
-    }
-  op_casetbl:
-    assert(0);          /* this should not occur during execution */
-    NEXT(cip);
-  op_swap_pri:
-    offs=*(cell *)(data+(int)stk);
-    *(cell *)(data+(int)stk)=pri;
-    pri=offs;
-    NEXT(cip);
-  op_swap_alt:
-    offs=*(cell *)(data+(int)stk);
-    *(cell *)(data+(int)stk)=alt;
-    alt=offs;
-    NEXT(cip);
-  op_pushaddr:
-    GETPARAM(offs);
-    PUSH(frm+offs);
-    NEXT(cip);
-  op_nop:
-    NEXT(cip);
-  op_break:
-      if (amx->debug!=NULL) {
-      /* store status */
-      amx->frm=frm;
-      amx->stk=stk;
-      amx->hea=hea;
-      amx->cip=(cell)((unsigned char*)cip-code);
-      num=amx->debug(amx);
-      if (num!=AMX_ERR_NONE) {
-        if (num==AMX_ERR_SLEEP) {
-          amx->pri=pri;
-          amx->alt=alt;
-          amx->reset_stk=reset_stk;
-          amx->reset_hea=reset_hea;
-          return num;
-        } /* if */
-        ABORT(amx,num);
-      } /* if */
-    } /* if */
-    NEXT(cip);
+  if ((amx->flags & AMX_FLAG_NOTRACKCIP)==0)
+    return amx_ExecFull(amx,retval,index);
+  if ((amx->flags & AMX_FLAG_NOLONGCALL)==0)
+    return amx_ExecLongCall(amx,retval,index);
+  return amx_ExecErrors(amx,retval,index);
 }
 
 #else
@@ -2795,6 +1974,10 @@ int AMXAPI amx_Exec(AMX *amx, cell *retval, int index)
   AMX_EXT_HOOKS *ext_hooks=NULL;
   AMX_LCT_CTL long_call_ctl=NULL;
   AMX_ADDR_0_CTL address_naught_ctl=NULL;
+  int address_naught=0;
+  AMX_FUNC_CTL function_ctl=NULL;
+  int function_events=0;
+  unsigned int long_call_delay=LONG_CALL_CHECK_INTERVAL;
 
   assert(amx!=NULL);
   #if defined ASM32 || defined JIT
@@ -2904,6 +2087,12 @@ int AMXAPI amx_Exec(AMX *amx, cell *retval, int index)
     long_call_ctl=ext_hooks->long_call_ctl;
   if (ext_hooks!=NULL)
     address_naught_ctl=ext_hooks->address_naught_ctl;
+  if (address_naught_ctl!=NULL)
+    address_naught=address_naught_ctl(amx,-1);
+  if (ext_hooks!=NULL)
+    function_ctl=ext_hooks->function_ctl;
+  if (function_ctl!=NULL)
+    function_events=function_ctl(amx,AMX_FUNC_QUERY);
 
   /* start running */
 #if defined ASM32 || defined JIT
@@ -3179,7 +2368,7 @@ int AMXAPI amx_Exec(AMX *amx, cell *retval, int index)
         if (ext_hooks==NULL)
           pri=1|16|32|64;
         else
-          pri=1|32|(long_call_ctl(amx,AMX_LCT_OPTION,AMX_LCT_OPTION_ACTIVE)<<1)|64|(address_naught_ctl(amx, -1)<<7);
+          pri=1|32|(long_call_ctl(amx,AMX_LCT_OPTION,AMX_LCT_OPTION_ACTIVE)<<1)|64|(address_naught<<7);
         break;
       } /* switch */
       break;
@@ -3229,12 +2418,9 @@ int AMXAPI amx_Exec(AMX *amx, cell *retval, int index)
         if (address_naught_ctl!=NULL) {
           if (pri&64) {
             /* address_naught control */
-            if (pri&128)
-              /* enable long_call_time check */
-              address_naught_ctl(amx,1);
-            else
-              /* disable long_call_time check */
-              address_naught_ctl(amx,0);
+            /* enable or disable address naught check */
+            address_naught=(pri&128)!=0;
+            address_naught_ctl(amx,address_naught);
           }
         } /* if */
         break;
@@ -3298,6 +2484,7 @@ int AMXAPI amx_Exec(AMX *amx, cell *retval, int index)
       PUSH(frm);
       frm=stk;
       CHKMARGIN();
+      FUNC_EVENT(AMX_FUNC_ENTER);
       break;
     case OP_RET:
       POP(frm);
@@ -3306,6 +2493,7 @@ int AMXAPI amx_Exec(AMX *amx, cell *retval, int index)
       if ((ucell)offs>=codesize)
         ABORT(amx,AMX_ERR_MEMACCESS);
       cip=(cell *)(code+(int)offs);
+      FUNC_EVENT(AMX_FUNC_RETURN);
       break;
     case OP_RETN:
       POP(frm);
@@ -3316,6 +2504,7 @@ int AMXAPI amx_Exec(AMX *amx, cell *retval, int index)
       cip=(cell *)(code+(int)offs);
       stk+= *(cell *)(data+(int)stk) + sizeof(cell); /* remove parameters from the stack */
       amx->stk=stk;
+      FUNC_EVENT(AMX_FUNC_RETURN);
       break;
     case OP_CALL:
       PUSH(((unsigned char *)cip-code)+sizeof(cell));/* skip address */
@@ -172,6 +172,7 @@ typedef int (AMXAPI *AMX_DEBUG)(struct tagAMX *amx);
 typedef int (AMXAPI *AMX_EXEC_ERROR)(struct tagAMX *amx, int index, cell *retval, int error);
 typedef int (AMXAPI *AMX_LCT_CTL)(struct tagAMX *amx, int option, int value);
 typedef int (AMXAPI * AMX_ADDR_0_CTL)(struct tagAMX *amx, int option);
+typedef int (AMXAPI *AMX_FUNC_CTL)(struct tagAMX *amx, int event);
 
 #if !defined _FAR
   #define _FAR
@@ -296,8 +297,26 @@ typedef struct tagAMX_EXT_HOOKS {
   AMX_EXEC_ERROR exec_error;
   AMX_LCT_CTL long_call_ctl;
   AMX_ADDR_0_CTL address_naught_ctl;
+  AMX_FUNC_CTL function_ctl;
 } PACKED AMX_EXT_HOOKS;
 
+/* Events passed to AMX_EXT_HOOKS.function_ctl. It is queried once when
+ * amx_Exec() starts and is only called on PROC and RET/RETN if it returned
+ * non-zero; the registers are stored in the AMX structure before each call.
+ */
+#define AMX_FUNC_QUERY  (-1)  /* are function events wanted? */
+#define AMX_FUNC_ENTER  0     /* after PROC has set up the new frame */
+#define AMX_FUNC_RETURN 1     /* after RET/RETN has returned to the caller */
+
+/* CrashDetect: counters updated by the opcode counting version of amx_Exec()
+ * (see AMX_FLAG_COUNTOPS and AMX_OPCODE_COUNTS), set with amx_SetExecCounts().
+ * Either array may be NULL.
+ */
+typedef struct tagAMX_EXEC_COUNTS {
+  uint64_t *opcodes;  /* runs of each opcode, AMX_NUM_COUNTED_OPS entries */
+  uint64_t *targets;  /* jumps and calls to each code cell (CIP/sizeof(cell)) */
+} AMX_EXEC_COUNTS;
+
 #if PAWN_CELL_SIZE==16
   #define AMX_MAGIC     0xf1e2
 #elif PAWN_CELL_SIZE==32
@@ -343,11 +362,18 @@ enum {
 #define AMX_FLAG_COMPACT  0x04  /* compact encoding */
 #define AMX_FLAG_BYTEOPC  0x08  /* opcode is a byte (not a cell) */
 #define AMX_FLAG_NOCHECKS 0x10  /* no array bounds checking; no STMT opcode */
+/* CrashDetect: select a faster variant of amx_Exec() (GNU C version only);
+ * must be set before the AMX is relocated */
+#define AMX_FLAG_NOTRACKCIP 0x100 /* don't store CIP on every instruction */
+#define AMX_FLAG_NOLONGCALL 0x200 /* no long call checks (with NOTRACKCIP) */
+#define AMX_FLAG_COUNTOPS 0x400 /* count executed opcodes, see amx_SetExecCounts() */
 #define AMX_FLAG_NTVREG 0x1000  /* all native functions are registered */
 #define AMX_FLAG_JITC   0x2000  /* abstract machine is JIT compiled */
 #define AMX_FLAG_BROWSE 0x4000  /* busy browsing */
 #define AMX_FLAG_RELOC  0x8000  /* jump/call addresses relocated */
 
+#define AMX_NUM_COUNTED_OPS 141 /* opcodes and superinstructions */
+
 #define AMX_EXEC_MAIN   -1      /* start at program entry point */
 #define AMX_EXEC_CONT   -2      /* continue from last address */
 
@@ -403,13 +429,16 @@ int AMXAPI amx_Allot(AMX *amx, int cells, cell *amx_addr, cell **phys_addr);
 int AMXAPI amx_Callback(AMX *amx, cell index, cell *result, cell *params);
 int AMXAPI amx_Cleanup(AMX *amx);
 int AMXAPI amx_Clone(AMX *amxClone, AMX *amxSource, void *data);
+int AMXAPI amx_DecodeOpcodes(AMX *amx, unsigned char *opcodes);
 int AMXAPI amx_Exec(AMX *amx, cell *retval, int index);
 int AMXAPI amx_FindNative(AMX *amx, const char *name, int *index);
 int AMXAPI amx_FindPublic(AMX *amx, const char *funcname, int *index);
 int AMXAPI amx_FindPubVar(AMX *amx, const char *varname, cell *amx_addr);
 int AMXAPI amx_FindTagId(AMX *amx, cell tag_id, char *tagname);
 int AMXAPI amx_Flags(AMX *amx,uint16_t *flags);
+int AMXAPI amx_FuseOpcodes(AMX *amx);
 int AMXAPI amx_GetAddr(AMX *amx,cell amx_addr,cell **phys_addr);
+int AMXAPI amx_GetExecCounts(AMX *amx, AMX_EXEC_COUNTS **counts);
 int AMXAPI amx_GetExtHooks(AMX *amx, AMX_EXT_HOOKS **ext_hook);
 int AMXAPI amx_GetNative(AMX *amx, int index, char *funcname);
 int AMXAPI amx_GetPublic(AMX *amx, int index, char *funcname);
@@ -436,6 +465,7 @@ int AMXAPI amx_Release(AMX *amx, cell amx_addr);
 int AMXAPI amx_SetCallback(AMX *amx, AMX_CALLBACK callback);
 int AMXAPI amx_SetDebugHook(AMX *amx, AMX_DEBUG debug);
 int AMXAPI amx_SetExtHooks(AMX *amx, AMX_EXT_HOOKS *ext_hook);
+int AMXAPI amx_SetExecCounts(AMX *amx, AMX_EXEC_COUNTS *counts);
 int AMXAPI amx_SetString(cell *dest, const char *source, int pack, int use_wchar, size_t size);
 int AMXAPI amx_SetUserData(AMX *amx, long tag, void *ptr);
 int AMXAPI amx_StrLen(const cell *cstring, int *length);
@@ -23,6 +23,11 @@
  *  Version: $Id: amxdbg.c 3363 2005-07-23 09:03:29Z thiadmer $
  */
 
+/* Differences from the original file:
+ * - dbg_LoadInfoMem() and dbg_FreeInfoMem() for using debug information
+ *   directly from an in-memory (e.g. memory-mapped) image of the .amx file
+ */
+
 #include <assert.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -54,9 +59,29 @@ int AMXAPI dbg_FreeInfo(AMX_DBG *amxdbg)
   return AMX_ERR_NONE;
 }
 
-int AMXAPI dbg_LoadInfo(AMX_DBG *amxdbg, FILE *fp)
+static int dbg_AllocTables(AMX_DBG *amxdbg, const AMX_DBG_HDR *dbghdr)
+{
+  if (dbghdr->files > 0)
+    amxdbg->filetbl = malloc(dbghdr->files * sizeof(AMX_DBG_FILE *));
+  if (dbghdr->symbols > 0)
+    amxdbg->symboltbl = malloc(dbghdr->symbols * sizeof(AMX_DBG_SYMBOL *));
+  if (dbghdr->tags > 0)
+    amxdbg->tagtbl = malloc(dbghdr->tags * sizeof(AMX_DBG_TAG *));
+  if (dbghdr->automatons > 0)
+    amxdbg->automatontbl = malloc(dbghdr->automatons * sizeof(AMX_DBG_MACHINE *));
+  if (dbghdr->states > 0)
+    amxdbg->statetbl = malloc(dbghdr->states * sizeof(AMX_DBG_STATE *));
+  if ((dbghdr->files > 0 && amxdbg->filetbl == NULL)
+      || (dbghdr->symbols > 0 && amxdbg->symboltbl == NULL)
+      || (dbghdr->tags > 0 && amxdbg->tagtbl == NULL)
+      || (dbghdr->states > 0 && amxdbg->statetbl == NULL)
+      || (dbghdr->automatons > 0 && amxdbg->automatontbl == NULL))
+    return AMX_ERR_MEMORY;
+  return AMX_ERR_NONE;
+}
+
+static void dbg_SetupTables(AMX_DBG *amxdbg, const AMX_HEADER *amxhdr)
 {
-  AMX_HEADER amxhdr;
   AMX_DBG_HDR dbghdr;
   unsigned char *ptr;
   int index, dim;
@@ -65,67 +90,7 @@ int AMXAPI dbg_LoadInfo(AMX_DBG *amxdbg, FILE *fp)
   unsigned char *linetbl_max_ptr;
   ucell codesize;
 
-  assert(fp != NULL);
-  assert(amxdbg != NULL);
-
-  memset(&amxhdr, 0, sizeof amxhdr);
-  fseek(fp, 0L, SEEK_SET);
-  fread(&amxhdr, sizeof amxhdr, 1, fp);
-  #if BYTE_ORDER==BIG_ENDIAN
-    amx_Align32((uint32_t*)&amxhdr.size);
-    amx_Align16(&amxhdr.magic);
-    amx_Align16(&dbghdr.flags);
-  #endif
-  if (amxhdr.magic != AMX_MAGIC)
-    return AMX_ERR_FORMAT;
-  if ((amxhdr.flags & AMX_FLAG_DEBUG) == 0)
-    return AMX_ERR_DEBUG;
-
-  fseek(fp, amxhdr.size, SEEK_SET);
-  memset(&dbghdr, 0, sizeof(AMX_DBG_HDR));
-  fread(&dbghdr, sizeof(AMX_DBG_HDR), 1, fp);
-
-  #if BYTE_ORDER==BIG_ENDIAN
-    amx_Align32((uint32_t*)&dbghdr.size);
-    amx_Align16(&dbghdr.magic);
-    amx_Align16(&dbghdr.flags);
-    amx_Align16(&dbghdr.files);
-    amx_Align16(&dbghdr.lines);
-    amx_Align16(&dbghdr.symbols);
-    amx_Align16(&dbghdr.tags);
-    amx_Align16(&dbghdr.automatons);
-    amx_Align16(&dbghdr.states);
-  #endif
-  if (dbghdr.magic != AMX_DBG_MAGIC)
-    return AMX_ERR_FORMAT;
-
-  /* allocate all memory */
-  memset(amxdbg, 0, sizeof(AMX_DBG));
-  amxdbg->hdr = malloc((size_t)dbghdr.size);
-  if (dbghdr.files > 0)
-    amxdbg->filetbl = malloc(dbghdr.files * sizeof(AMX_DBG_FILE *));
-  if (dbghdr.symbols > 0)
-    amxdbg->symboltbl = malloc(dbghdr.symbols * sizeof(AMX_DBG_SYMBOL *));
-  if (dbghdr.tags > 0)
-    amxdbg->tagtbl = malloc(dbghdr.tags * sizeof(AMX_DBG_TAG *));
-  if (dbghdr.automatons > 0)
-    amxdbg->automatontbl = malloc(dbghdr.automatons * sizeof(AMX_DBG_MACHINE *));
-  if (dbghdr.states > 0)
-    amxdbg->statetbl = malloc(dbghdr.states * sizeof(AMX_DBG_STATE *));
-  if (amxdbg->hdr == NULL
-      || (dbghdr.files > 0 && amxdbg->filetbl == NULL)
-      || (dbghdr.symbols > 0 && amxdbg->symboltbl == NULL)
-      || (dbghdr.tags > 0 && amxdbg->tagtbl == NULL)
-      || (dbghdr.states > 0 && amxdbg->statetbl == NULL)
-      || (dbghdr.automatons > 0 && amxdbg->automatontbl == NULL))
-  {
-    dbg_FreeInfo(amxdbg);
-    return AMX_ERR_MEMORY;
-  } /* if */
-
-  /* load the entire symbolic information block into memory */
-  memcpy(amxdbg->hdr, &dbghdr, sizeof dbghdr);
-  fread(amxdbg->hdr + 1, 1, (size_t)(dbghdr.size - sizeof dbghdr), fp);
+  memcpy(&dbghdr, amxdbg->hdr, sizeof dbghdr);
 
   /* run through the file, fix alignment issues and set up table pointers */
   ptr = (unsigned char *)(amxdbg->hdr + 1);
@@ -158,7 +123,7 @@ int AMXAPI dbg_LoadInfo(AMX_DBG *amxdbg, FILE *fp)
     - sizeof(AMX_DBG_TAG) * dbghdr.tags
     - sizeof(AMX_DBG_MACHINE) * dbghdr.automatons
     - sizeof(AMX_DBG_STATE) * dbghdr.states;
-  codesize = amxhdr.dat - amxhdr.cod;
+  codesize = amxhdr->dat - amxhdr->cod;
   while (ptr < linetbl_max_ptr
          && ptr + ((uint32_t)UINT16_MAX + 1) < linetbl_max_ptr
          && (line = (AMX_DBG_LINE *)ptr)
@@ -235,9 +200,114 @@ int AMXAPI dbg_LoadInfo(AMX_DBG *amxdbg, FILE *fp)
     ptr++;              /* skip '\0' too */
   } /* for */
 
+}
+
+int AMXAPI dbg_LoadInfo(AMX_DBG *amxdbg, FILE *fp)
+{
+  AMX_HEADER amxhdr;
+  AMX_DBG_HDR dbghdr;
+
+  assert(fp != NULL);
+  assert(amxdbg != NULL);
+
+  memset(&amxhdr, 0, sizeof amxhdr);
+  fseek(fp, 0L, SEEK_SET);
+  fread(&amxhdr, sizeof amxhdr, 1, fp);
+  #if BYTE_ORDER==BIG_ENDIAN
+    amx_Align32((uint32_t*)&amxhdr.size);
+    amx_Align16(&amxhdr.magic);
+    amx_Align16(&dbghdr.flags);
+  #endif
+  if (amxhdr.magic != AMX_MAGIC)
+    return AMX_ERR_FORMAT;
+  if ((amxhdr.flags & AMX_FLAG_DEBUG) == 0)
+    return AMX_ERR_DEBUG;
+
+  fseek(fp, amxhdr.size, SEEK_SET);
+  memset(&dbghdr, 0, sizeof(AMX_DBG_HDR));
+  fread(&dbghdr, sizeof(AMX_DBG_HDR), 1, fp);
+
+  #if BYTE_ORDER==BIG_ENDIAN
+    amx_Align32((uint32_t*)&dbghdr.size);
+    amx_Align16(&dbghdr.magic);
+    amx_Align16(&dbghdr.flags);
+    amx_Align16(&dbghdr.files);
+    amx_Align16(&dbghdr.lines);
+    amx_Align16(&dbghdr.symbols);
+    amx_Align16(&dbghdr.tags);
+    amx_Align16(&dbghdr.automatons);
+    amx_Align16(&dbghdr.states);
+  #endif
+  if (dbghdr.magic != AMX_DBG_MAGIC)
+    return AMX_ERR_FORMAT;
+
+  /* allocate all memory */
+  memset(amxdbg, 0, sizeof(AMX_DBG));
+  amxdbg->hdr = malloc((size_t)dbghdr.size);
+  if (amxdbg->hdr == NULL || dbg_AllocTables(amxdbg, &dbghdr) != AMX_ERR_NONE) {
+    dbg_FreeInfo(amxdbg);
+    return AMX_ERR_MEMORY;
+  } /* if */
+
+  /* load the entire symbolic information block into memory */
+  memcpy(amxdbg->hdr, &dbghdr, sizeof dbghdr);
+  fread(amxdbg->hdr + 1, 1, (size_t)(dbghdr.size - sizeof dbghdr), fp);
+
+  dbg_SetupTables(amxdbg, &amxhdr);
+  return AMX_ERR_NONE;
+}
+
+/* dbg_LoadInfoMem() is like dbg_LoadInfo() but it takes an image of the
+ * whole .amx file that is already in memory (e.g. a memory-mapped file) and
+ * sets up the tables to point directly into it instead of reading a private
+ * copy. The image must outlive the AMX_DBG structure. No byte swapping is
+ * done, so the image must be in native byte order.
+ */
+int AMXAPI dbg_LoadInfoMem(AMX_DBG *amxdbg, const void *base, size_t size)
+{
+  const AMX_HEADER *amxhdr;
+  AMX_DBG_HDR *dbghdr;
+
+  assert(base != NULL);
+  assert(amxdbg != NULL);
+
+  if (size < sizeof(AMX_HEADER))
+    return AMX_ERR_FORMAT;
+  amxhdr = (const AMX_HEADER *)base;
+  if (amxhdr->magic != AMX_MAGIC)
+    return AMX_ERR_FORMAT;
+  if ((amxhdr->flags & AMX_FLAG_DEBUG) == 0)
+    return AMX_ERR_DEBUG;
+
+  if ((size_t)amxhdr->size + sizeof(AMX_DBG_HDR) > size)
+    return AMX_ERR_FORMAT;
+  dbghdr = (AMX_DBG_HDR *)((unsigned char *)base + amxhdr->size);
+  if (dbghdr->magic != AMX_DBG_MAGIC)
+    return AMX_ERR_FORMAT;
+  if ((size_t)amxhdr->size + dbghdr->size > size)
+    return AMX_ERR_FORMAT;
+
+  memset(amxdbg, 0, sizeof(AMX_DBG));
+  if (dbg_AllocTables(amxdbg, dbghdr) != AMX_ERR_NONE) {
+    dbg_FreeInfoMem(amxdbg);
+    return AMX_ERR_MEMORY;
+  } /* if */
+  amxdbg->hdr = dbghdr;
+
+  dbg_SetupTables(amxdbg, amxhdr);
   return AMX_ERR_NONE;
 }
 
+/* dbg_FreeInfoMem() releases an AMX_DBG structure that was set up with
+ * dbg_LoadInfoMem(); it does not touch the memory image itself.
+ */
+int AMXAPI dbg_FreeInfoMem(AMX_DBG *amxdbg)
+{
+  assert(amxdbg != NULL);
+  amxdbg->hdr = NULL;
+  return dbg_FreeInfo(amxdbg);
+}
+
 int AMXAPI dbg_LookupFile(AMX_DBG *amxdbg, ucell address, const char **filename)
 {
   int index;
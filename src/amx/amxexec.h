@@ -0,0 +1,1296 @@
+/*  Pawn Abstract Machine (for the Pawn language)
+ *
+ *  Copyright (c) ITB CompuPhase, 1997-2005
+ *
+ *  This software is provided "as-is", without any express or implied warranty.
+ *  In no event will the authors be held liable for any damages arising from
+ *  the use of this software.
+ *
+ *  Permission is granted to anyone to use this software for any purpose,
+ *  including commercial applications, and to alter it and redistribute it
+ *  freely, subject to the following restrictions:
+ *
+ *  1.  The origin of this software must not be misrepresented; you must not
+ *      claim that you wrote the original software. If you use this software in
+ *      a product, an acknowledgment in the product documentation would be
+ *      appreciated but is not required.
+ *  2.  Altered source versions must be plainly marked as such, and must not be
+ *      misrepresented as being the original software.
+ *  3.  This notice may not be removed or altered from any source distribution.
+ */
+
+/* The GNU C ("labels as values") version of amx_Exec(), split out of amx.c
+ * so that it can be built more than once. This file has no include guard:
+ * amx.c includes it once per variant after defining the following macros:
+ *
+ * AMX_EXEC_NAME       - name of the (static) function
+ * AMX_EXEC_TRACK_CIP  - store CIP in the AMX before every instruction; if 0,
+ *                       it is stored only when something outside of the VM
+ *                       may look at it (natives, the debug hook, long call
+ *                       checks and runtime errors)
+ * AMX_EXEC_LONG_CALL  - count instructions and check for long calls
+ * AMX_EXEC_COUNT_OPS  - count how many times each opcode runs and how often
+ *                       each jump and call target is reached, in the arrays
+ *                       set with amx_SetExecCounts() (optional, 0 if not
+ *                       defined)
+ *
+ * All of them are undefined at the end.
+ */
+
+#if AMX_EXEC_LONG_CALL
+  #define EXEC_CHECK_LONG_CALL() CHECK_LONG_CALL_TIME()
+#else
+  #define EXEC_CHECK_LONG_CALL() ((void)0)
+#endif
+
+/* COUNT_TARGET() is used after a jump or call has set CIP. Targets that
+ * the instruction doesn't verify (CALL.pri, JUMP.pri, SCTRL 6) may point
+ * anywhere, hence the range check. */
+#if defined AMX_EXEC_COUNT_OPS && AMX_EXEC_COUNT_OPS
+  #define COUNT_OP(op)    if (opcode_counts!=NULL) opcode_counts[op]++
+  #define COUNT_TARGET()  if (target_counts!=NULL                          \
+                              && (ucell)((unsigned char *)cip-code)<codesize) \
+                            target_counts[cip-(cell *)code]++
+#else
+  #define COUNT_OP(op)    ((void)0)
+  #define COUNT_TARGET()  ((void)0)
+#endif
+
+/* ABORT_AT() is ABORT() for instructions whose opcode is n cells behind
+ * CIP at the point of the error. */
+#if AMX_EXEC_TRACK_CIP
+  #define NEXT(cip)       do { (amx)->cip=(cell)cip-(cell)code; EXEC_CHECK_LONG_CALL(); goto **cip++; } while (0)
+  #define ABORT_AT(n,v)   ABORT(amx,v)
+#else
+  #define NEXT(cip)       do { EXEC_CHECK_LONG_CALL(); goto **cip++; } while (0)
+  #define ABORT_AT(n,v)   { (amx)->cip=(cell)(cip-(n))-(cell)code;       \
+                            ABORT(amx,v); }
+#endif
+
+#define CHKNAUGHT_AT(n) if (address_naught) ABORT_AT(n, AMX_ERR_ADDRESS_0)
+#define CHKMARGIN_AT(n) if (hea+STKMARGIN>stk) ABORT_AT(n, AMX_ERR_STACKERR)
+#define CHKSTACK_AT(n)  if (stk>amx->stp) ABORT_AT(n, AMX_ERR_STACKLOW)
+#define CHKHEAP_AT(n)   if (hea<amx->hlw) ABORT_AT(n, AMX_ERR_HEAPLOW)
+
+static int AMX_EXEC_NAME(AMX *amx, cell *retval, int index)
+{
+static const void * const amx_opcodelist[] = {
+        &&op_none,      &&op_load_pri,  &&op_load_alt,  &&op_load_s_pri,
+        &&op_load_s_alt,&&op_lref_pri,  &&op_lref_alt,  &&op_lref_s_pri,
+        &&op_lref_s_alt,&&op_load_i,    &&op_lodb_i,    &&op_const_pri,
+        &&op_const_alt, &&op_addr_pri,  &&op_addr_alt,  &&op_stor_pri,
+        &&op_stor_alt,  &&op_stor_s_pri,&&op_stor_s_alt,&&op_sref_pri,
+        &&op_sref_alt,  &&op_sref_s_pri,&&op_sref_s_alt,&&op_stor_i,
+        &&op_strb_i,    &&op_lidx,      &&op_lidx_b,    &&op_idxaddr,
+        &&op_idxaddr_b, &&op_align_pri, &&op_align_alt, &&op_lctrl,
+        &&op_sctrl,     &&op_move_pri,  &&op_move_alt,  &&op_xchg,
+        &&op_push_pri,  &&op_push_alt,  &&op_push_r,    &&op_push_c,
+        &&op_push,      &&op_push_s,    &&op_pop_pri,   &&op_pop_alt,
+        &&op_stack,     &&op_heap,      &&op_proc,      &&op_ret,
+        &&op_retn,      &&op_call,      &&op_call_pri,  &&op_jump,
+        &&op_jrel,      &&op_jzer,      &&op_jnz,       &&op_jeq,
+        &&op_jneq,      &&op_jless,     &&op_jleq,      &&op_jgrtr,
+        &&op_jgeq,      &&op_jsless,    &&op_jsleq,     &&op_jsgrtr,
+        &&op_jsgeq,     &&op_shl,       &&op_shr,       &&op_sshr,
+        &&op_shl_c_pri, &&op_shl_c_alt, &&op_shr_c_pri, &&op_shr_c_alt,
+        &&op_smul,      &&op_sdiv,      &&op_sdiv_alt,  &&op_umul,
+        &&op_udiv,      &&op_udiv_alt,  &&op_add,       &&op_sub,
+        &&op_sub_alt,   &&op_and,       &&op_or,        &&op_xor,
+        &&op_not,       &&op_neg,       &&op_invert,    &&op_add_c,
+        &&op_smul_c,    &&op_zero_pri,  &&op_zero_alt,  &&op_zero,
+        &&op_zero_s,    &&op_sign_pri,  &&op_sign_alt,  &&op_eq,
+        &&op_neq,       &&op_less,      &&op_leq,       &&op_grtr,
+        &&op_geq,       &&op_sless,     &&op_sleq,      &&op_sgrtr,
+        &&op_sgeq,      &&op_eq_c_pri,  &&op_eq_c_alt,  &&op_inc_pri,
+        &&op_inc_alt,   &&op_inc,       &&op_inc_s,     &&op_inc_i,
+        &&op_dec_pri,   &&op_dec_alt,   &&op_dec,       &&op_dec_s,
+        &&op_dec_i,     &&op_movs,      &&op_cmps,      &&op_fill,
+        &&op_halt,      &&op_bounds,    &&op_sysreq_pri,&&op_sysreq_c,
+        &&op_file,      &&op_line,      &&op_symbol,    &&op_srange,
+        &&op_jump_pri,  &&op_switch,    &&op_casetbl,   &&op_swap_pri,
+        &&op_swap_alt,  &&op_pushaddr,  &&op_nop,       &&op_sysreq_d,
+        &&op_symtag,    &&op_break,
+        /* superinstructions */
+        &&op_load_s_pri_push,           &&op_const_pri_bounds,
+        &&op_push2_c };
+  AMX_HEADER *hdr;
+  AMX_FUNCSTUB *func;
+  unsigned char *code, *data;
+  cell pri,alt,stk,frm,hea;
+  cell reset_stk, reset_hea, *cip;
+  cell offs;
+  ucell codesize;
+  int num,i;
+  AMX_EXT_HOOKS *ext_hooks=NULL;
+  AMX_LCT_CTL long_call_ctl=NULL;
+  AMX_ADDR_0_CTL address_naught_ctl=NULL;
+  int address_naught=0;
+  AMX_FUNC_CTL function_ctl=NULL;
+  int function_events=0;
+#if AMX_EXEC_LONG_CALL
+  unsigned int long_call_delay=LONG_CALL_CHECK_INTERVAL;
+#endif
+#if defined AMX_EXEC_COUNT_OPS && AMX_EXEC_COUNT_OPS
+  AMX_EXEC_COUNTS *exec_counts=NULL;
+  uint64_t *opcode_counts=NULL;
+  uint64_t *target_counts=NULL;
+#endif
+
+  /* HACK: return label table (for amx_BrowseRelocate) if amx structure
+   * has the AMX_FLAG_BROWSE flag set.
+   */
+  assert(amx!=NULL);
+  if ((amx->flags & AMX_FLAG_BROWSE)==AMX_FLAG_BROWSE) {
+    assert(sizeof(cell)==sizeof(void *));
+    assert(retval!=NULL);
+    *retval=(cell)amx_opcodelist;
+    return 0;
+  } /* if */
+
+  if (amx->callback==NULL)
+    return AMX_ERR_CALLBACK;
+  if ((amx->flags & AMX_FLAG_NTVREG)==0)
+    return AMX_ERR_NOTFOUND;
+  if ((amx->flags & AMX_FLAG_RELOC)==0)
+    return AMX_ERR_INIT;
+  assert((amx->flags & AMX_FLAG_BROWSE)==0);
+
+  /* set up the registers */
+  hdr=(AMX_HEADER *)amx->base;
+  assert(hdr->magic==AMX_MAGIC);
+  codesize=(ucell)(hdr->dat-hdr->cod);
+  code=amx->base+(int)hdr->cod;
+  data=(amx->data!=NULL) ? amx->data : amx->base+(int)hdr->dat;
+  hea=amx->hea;
+  stk=amx->stk;
+  reset_stk=stk;
+  reset_hea=hea;
+  alt=frm=0;    /* just to avoid compiler warnings */
+  num=0;        /* just to avoid compiler warnings */
+
+  /* get the start address */
+  if (index==AMX_EXEC_MAIN) {
+    if (hdr->cip<0)
+      return AMX_ERR_INDEX;
+    cip=(cell *)(code + (int)hdr->cip);
+  } else if (index==AMX_EXEC_CONT) {
+    /* all registers: pri, alt, frm, cip, hea, stk, reset_stk, reset_hea */
+    frm=amx->frm;
+    stk=amx->stk;
+    hea=amx->hea;
+    pri=amx->pri;
+    alt=amx->alt;
+    reset_stk=amx->reset_stk;
+    reset_hea=amx->reset_hea;
+    cip=(cell *)(code + (int)amx->cip);
+  } else if (index<0) {
+    return AMX_ERR_INDEX;
+  } else {
+    if (index>=(int)NUMENTRIES(hdr,publics,natives))
+      return AMX_ERR_INDEX;
+    func=GETENTRY(hdr,publics,index);
+    cip=(cell *)(code + (int)func->address);
+  } /* if */
+  /* check values just copied */
+  CHKSTACK_AT(0);
+  CHKHEAP_AT(0);
+  assert(check_endian());
+
+  /* sanity checks */
+  assert(OP_PUSH_PRI==36);
+  assert(OP_PROC==46);
+  assert(OP_SHL==65);
+  assert(OP_SMUL==72);
+  assert(OP_EQ==95);
+  assert(OP_INC_PRI==107);
+  assert(OP_MOVS==117);
+  assert(OP_SYMBOL==126);
+  assert(OP_NUM_FUSED_OPCODES==AMX_NUM_COUNTED_OPS);
+  #if PAWN_CELL_SIZE==16
+    assert(sizeof(cell)==2);
+  #elif PAWN_CELL_SIZE==32
+    assert(sizeof(cell)==4);
+  #elif PAWN_CELL_SIZE==64
+    assert(sizeof(cell)==8);
+  #else
+    #error Unsupported cell size
+  #endif
+
+  if (index!=AMX_EXEC_CONT) {
+    reset_stk+=amx->paramcount*sizeof(cell);
+    PUSH(amx->paramcount*sizeof(cell));
+    amx->paramcount=0;          /* push the parameter count to the stack & reset */
+    PUSH(0);                    /* zero return address */
+  } /* if */
+  /* check stack/heap before starting to run */
+  CHKMARGIN_AT(0);
+
+  /* initialize long_call_ctl */
+  amx_GetExtHooks(amx,&ext_hooks);
+  if (ext_hooks!=NULL)
+    long_call_ctl=ext_hooks->long_call_ctl;
+  if (ext_hooks!=NULL)
+    address_naught_ctl=ext_hooks->address_naught_ctl;
+  if (address_naught_ctl!=NULL)
+    address_naught=address_naught_ctl(amx,-1);
+  if (ext_hooks!=NULL)
+    function_ctl=ext_hooks->function_ctl;
+  if (function_ctl!=NULL)
+    function_events=function_ctl(amx,AMX_FUNC_QUERY);
+#if defined AMX_EXEC_COUNT_OPS && AMX_EXEC_COUNT_OPS
+  if (amx_GetExecCounts(amx,&exec_counts)==AMX_ERR_NONE && exec_counts!=NULL) {
+    opcode_counts=exec_counts->opcodes;
+    target_counts=exec_counts->targets;
+  } /* if */
+  /* entry points of publics and main are call targets too */
+  if (index!=AMX_EXEC_CONT)
+    COUNT_TARGET();
+#endif
+
+  /* start running */
+  NEXT(cip);
+
+  op_none:
+    COUNT_OP(OP_NONE);
+    ABORT_AT(1,AMX_ERR_INVINSTR);
+  op_load_pri:
+    COUNT_OP(OP_LOAD_PRI);
+    GETPARAM(offs);
+    pri=*(cell *)(data+(int)offs);
+    NEXT(cip);
+  op_load_alt:
+    COUNT_OP(OP_LOAD_ALT);
+    GETPARAM(offs);
+    alt=*(cell *)(data+(int)offs);
+    NEXT(cip);
+  op_load_s_pri:
+    COUNT_OP(OP_LOAD_S_PRI);
+    GETPARAM(offs);
+    pri=*(cell *)(data+(int)frm+(int)offs);
+    NEXT(cip);
+  op_load_s_alt:
+    COUNT_OP(OP_LOAD_S_ALT);
+    GETPARAM(offs);
+    alt=*(cell *)(data+(int)frm+(int)offs);
+    NEXT(cip);
+  op_lref_pri:
+    COUNT_OP(OP_LREF_PRI);
+    GETPARAM(offs);
+    offs=*(cell *)(data+(int)offs);
+    pri=*(cell *)(data+(int)offs);
+    NEXT(cip);
+  op_lref_alt:
+    COUNT_OP(OP_LREF_ALT);
+    GETPARAM(offs);
+    offs=*(cell *)(data+(int)offs);
+    alt=*(cell *)(data+(int)offs);
+    NEXT(cip);
+  op_lref_s_pri:
+    COUNT_OP(OP_LREF_S_PRI);
+    GETPARAM(offs);
+    offs=*(cell *)(data+(int)frm+(int)offs);
+    pri=*(cell *)(data+(int)offs);
+    NEXT(cip);
+  op_lref_s_alt:
+    COUNT_OP(OP_LREF_S_ALT);
+    GETPARAM(offs);
+    offs=*(cell *)(data+(int)frm+(int)offs);
+    alt=*(cell *)(data+(int)offs);
+    NEXT(cip);
+  op_load_i:
+    COUNT_OP(OP_LOAD_I);
+    /* verify address */
+    if (pri>=hea && pri<stk || (ucell)pri>=(ucell)amx->stp)
+      ABORT_AT(1,AMX_ERR_MEMACCESS);
+    pri=*(cell *)(data+(int)pri);
+    NEXT(cip);
+  op_lodb_i:
+    COUNT_OP(OP_LODB_I);
+    GETPARAM(offs);
+    /* verify address */
+    if (pri>=hea && pri<stk || (ucell)pri>=(ucell)amx->stp)
+      ABORT_AT(2,AMX_ERR_MEMACCESS);
+    switch (offs) {
+    case 1:
+      pri=*(data+(int)pri);
+      break;
+    case 2:
+      pri=*(uint16_t *)(data+(int)pri);
+      break;
+    case 4:
+      pri=*(uint32_t *)(data+(int)pri);
+      break;
+    } /* switch */
+    NEXT(cip);
+  op_const_pri:
+    COUNT_OP(OP_CONST_PRI);
+    GETPARAM(pri);
+    NEXT(cip);
+  op_const_alt:
+    COUNT_OP(OP_CONST_ALT);
+    GETPARAM(alt);
+    NEXT(cip);
+  op_addr_pri:
+    COUNT_OP(OP_ADDR_PRI);
+    GETPARAM(pri);
+    pri+=frm;
+    NEXT(cip);
+  op_addr_alt:
+    COUNT_OP(OP_ADDR_ALT);
+    GETPARAM(alt);
+    alt+=frm;
+    NEXT(cip);
+  op_stor_pri:
+    COUNT_OP(OP_STOR_PRI);
+    GETPARAM(offs);
+    if ((int)offs==0)
+      CHKNAUGHT_AT(2);
+    *(cell *)(data+(int)offs)=pri;
+    NEXT(cip);
+  op_stor_alt:
+    COUNT_OP(OP_STOR_ALT);
+    GETPARAM(offs);
+    if ((int)offs==0)
+      CHKNAUGHT_AT(2);
+    *(cell *)(data+(int)offs)=alt;
+    NEXT(cip);
+  op_stor_s_pri:
+    COUNT_OP(OP_STOR_S_PRI);
+    GETPARAM(offs);
+    if ((int)frm+(int)offs==0)
+      CHKNAUGHT_AT(2);
+    *(cell *)(data+(int)frm+(int)offs)=pri;
+    NEXT(cip);
+  op_stor_s_alt:
+    COUNT_OP(OP_STOR_S_ALT);
+    GETPARAM(offs);
+    if ((int)frm+(int)offs==0)
+      CHKNAUGHT_AT(2);
+    *(cell *)(data+(int)frm+(int)offs)=alt;
+    NEXT(cip);
+  op_sref_pri:
+    COUNT_OP(OP_SREF_PRI);
+    GETPARAM(offs);
+    offs=*(cell *)(data+(int)offs);
+    if ((int)offs==0)
+      CHKNAUGHT_AT(2);
+    *(cell *)(data+(int)offs)=pri;
+    NEXT(cip);
+  op_sref_alt:
+    COUNT_OP(OP_SREF_ALT);
+    GETPARAM(offs);
+    offs=*(cell *)(data+(int)offs);
+    if ((int)offs==0)
+      CHKNAUGHT_AT(2);
+    *(cell *)(data+(int)offs)=alt;
+    NEXT(cip);
+  op_sref_s_pri:
+    COUNT_OP(OP_SREF_S_PRI);
+    GETPARAM(offs);
+    offs=*(cell *)(data+(int)frm+(int)offs);
+    if ((int)offs==0)
+      CHKNAUGHT_AT(2);
+    *(cell *)(data+(int)offs)=pri;
+    NEXT(cip);
+  op_sref_s_alt:
+    COUNT_OP(OP_SREF_S_ALT);
+    GETPARAM(offs);
+    offs=*(cell *)(data+(int)frm+(int)offs);
+    if ((int)offs==0)
+      CHKNAUGHT_AT(2);
+    *(cell *)(data+(int)offs)=alt;
+    NEXT(cip);
+  op_stor_i:
+    COUNT_OP(OP_STOR_I);
+    /* verify address */
+    if (alt>=hea && alt<stk || (ucell)alt>=(ucell)amx->stp)
+      ABORT_AT(1,AMX_ERR_MEMACCESS);
+    if ((int)alt==0)
+      CHKNAUGHT_AT(1);
+    *(cell *)(data+(int)alt)=pri;
+    NEXT(cip);
+  op_strb_i:
+    COUNT_OP(OP_STRB_I);
+    GETPARAM(offs);
+    /* verify address */
+    if (alt>=hea && alt<stk || (ucell)alt>=(ucell)amx->stp)
+      ABORT_AT(2,AMX_ERR_MEMACCESS);
+    if ((int)offs==0)
+      CHKNAUGHT_AT(2);
+    switch (offs) {
+    case 1:
+      *(data+(int)alt)=(unsigned char)pri;
+      break;
+    case 2:
+      *(uint16_t *)(data+(int)alt)=(uint16_t)pri;
+      break;
+    case 4:
+      *(uint32_t *)(data+(int)alt)=(uint32_t)pri;
+      break;
+    } /* switch */
+    NEXT(cip);
+  op_lidx:
+    COUNT_OP(OP_LIDX);
+    offs=pri*sizeof(cell)+alt;
+    /* verify address */
+    if (offs>=hea && offs<stk || (ucell)offs>=(ucell)amx->stp)
+      ABORT_AT(1,AMX_ERR_MEMACCESS);
+    pri=*(cell *)(data+(int)offs);
+    NEXT(cip);
+  op_lidx_b:
+    COUNT_OP(OP_LIDX_B);
+    GETPARAM(offs);
+    offs=(pri << (int)offs)+alt;
+    /* verify address */
+    if (offs>=hea && offs<stk || (ucell)offs>=(ucell)amx->stp)
+      ABORT_AT(2,AMX_ERR_MEMACCESS);
+    pri=*(cell *)(data+(int)offs);
+    NEXT(cip);
+  op_idxaddr:
+    COUNT_OP(OP_IDXADDR);
+    pri=pri*sizeof(cell)+alt;
+    NEXT(cip);
+  op_idxaddr_b:
+    COUNT_OP(OP_IDXADDR_B);
+    GETPARAM(offs);
+    pri=(pri << (int)offs)+alt;
+    NEXT(cip);
+  op_align_pri:
+    COUNT_OP(OP_ALIGN_PRI);
+    GETPARAM(offs);
+    #if BYTE_ORDER==LITTLE_ENDIAN
+      if (offs<(int)sizeof(cell))
+        pri ^= sizeof(cell)-offs;
+    #endif
+    NEXT(cip);
+  op_align_alt:
+    COUNT_OP(OP_ALIGN_ALT);
+    GETPARAM(offs);
+    #if BYTE_ORDER==LITTLE_ENDIAN
+      if (offs<(int)sizeof(cell))
+        alt ^= sizeof(cell)-offs;
+    #endif
+    NEXT(cip);
+  op_lctrl:
+    COUNT_OP(OP_LCTRL);
+    GETPARAM(offs);
+    switch (offs) {
+    case 0:
+      pri=hdr->cod;
+      break;
+    case 1:
+      pri=hdr->dat;
+      break;
+    case 2:
+      pri=hea;
+      break;
+    case 3:
+      pri=amx->stp;
+      break;
+    case 4:
+      pri=stk;
+      break;
+    case 5:
+      pri=frm;
+      break;
+    case 6:
+      pri=(cell)((unsigned char *)cip-code);
+      break;
+    case 0xFE:
+      if (long_call_ctl==NULL)
+        pri=0;
+      else
+        pri=long_call_ctl(amx,AMX_LCT_OPTION,AMX_LCT_OPTION_CURRENT);
+      break;
+    case 0xFF:
+      if (ext_hooks==NULL)
+        pri=1|16|32|64;
+      else
+        pri=1|32|(long_call_ctl(amx,AMX_LCT_OPTION,AMX_LCT_OPTION_ACTIVE)<<1)|64|(address_naught<<7);
+      break;
+    } /* switch */
+    NEXT(cip);
+  op_sctrl:
+    COUNT_OP(OP_SCTRL);
+    GETPARAM(offs);
+    switch (offs) {
+    case 0:
+    case 1:
+    case 3:
+      /* cannot change these parameters */
+      break;
+    case 2:
+      hea=pri;
+      break;
+    case 4:
+      stk=pri;
+      break;
+    case 5:
+      frm=pri;
+      break;
+    case 6:
+      cip=(cell *)(code+(int)pri);
+      COUNT_TARGET();
+      break;
+    case 0xFE:
+      /* set long_call_time */
+      if (long_call_ctl!=NULL)
+        long_call_ctl(amx,AMX_LCT_SET_TIME,pri);
+      break;
+    case 0xFF:
+      if (long_call_ctl!=NULL) {
+        if (pri&32) {
+          /* long_call_time control */
+          if (pri&2)
+            /* enable long_call_time check */
+            long_call_ctl(amx,AMX_LCT_OPTION,AMX_LCT_OPTION_ENABLE);
+          else if (pri&4)
+            /* reset long_call_time */
+            long_call_ctl(amx,AMX_LCT_OPTION,AMX_LCT_OPTION_RESET);
+          else if (pri&8)
+            /* restart long_call_time check */
+            long_call_ctl(amx,AMX_LCT_OPTION,AMX_LCT_OPTION_RESTART);
+          else
+            /* disable long_call_time check */
+            long_call_ctl(amx, AMX_LCT_OPTION,AMX_LCT_OPTION_DISABLE);
+        }
+      } /* if */
+      if (address_naught_ctl!=NULL) {
+        if (pri&64) {
+          /* address_naught control */
+          /* enable or disable address naught check */
+          address_naught=(pri&128)!=0;
+          address_naught_ctl(amx,address_naught);
+        }
+      } /* if */
+      break;
+    } /* switch */
+    NEXT(cip);
+  op_move_pri:
+    COUNT_OP(OP_MOVE_PRI);
+    pri=alt;
+    NEXT(cip);
+  op_move_alt:
+    COUNT_OP(OP_MOVE_ALT);
+    alt=pri;
+    NEXT(cip);
+  op_xchg:
+    COUNT_OP(OP_XCHG);
+    offs=pri;         /* offs is a temporary variable */
+    pri=alt;
+    alt=offs;
+    NEXT(cip);
+  op_push_pri:
+    COUNT_OP(OP_PUSH_PRI);
+    PUSH(pri);
+    NEXT(cip);
+  op_push_alt:
+    COUNT_OP(OP_PUSH_ALT);
+    PUSH(alt);
+    NEXT(cip);
+  op_push_c:
+    COUNT_OP(OP_PUSH_C);
+    GETPARAM(offs);
+    PUSH(offs);
+    NEXT(cip);
+  op_push_r:
+    COUNT_OP(OP_PUSH_R);
+    GETPARAM(offs);
+    while (offs--)
+      PUSH(pri);
+    NEXT(cip);
+  op_push:
+    COUNT_OP(OP_PUSH);
+    GETPARAM(offs);
+    PUSH(* (cell *)(data+(int)offs));
+    NEXT(cip);
+  op_push_s:
+    COUNT_OP(OP_PUSH_S);
+    GETPARAM(offs);
+    PUSH(* (cell *)(data+(int)frm+(int)offs));
+    NEXT(cip);
+  op_pop_pri:
+    COUNT_OP(OP_POP_PRI);
+    POP(pri);
+    NEXT(cip);
+  op_pop_alt:
+    COUNT_OP(OP_POP_ALT);
+    POP(alt);
+    NEXT(cip);
+  op_stack:
+    COUNT_OP(OP_STACK);
+    GETPARAM(offs);
+    alt=stk;
+    stk+=offs;
+    CHKMARGIN_AT(2);
+    CHKSTACK_AT(2);
+    NEXT(cip);
+  op_heap:
+    COUNT_OP(OP_HEAP);
+    GETPARAM(offs);
+    alt=hea;
+    hea+=offs;
+    CHKMARGIN_AT(2);
+    CHKHEAP_AT(2);
+    NEXT(cip);
+  op_proc:
+    COUNT_OP(OP_PROC);
+    PUSH(frm);
+    frm=stk;
+    CHKMARGIN_AT(1);
+    FUNC_EVENT(AMX_FUNC_ENTER);
+    NEXT(cip);
+  op_ret:
+    COUNT_OP(OP_RET);
+    POP(frm);
+    POP(offs);
+    /* verify the return address */
+    if ((ucell)offs>=codesize)
+      ABORT_AT(1,AMX_ERR_MEMACCESS);
+    cip=(cell *)(code+(int)offs);
+    FUNC_EVENT(AMX_FUNC_RETURN);
+    NEXT(cip);
+  op_retn:
+    COUNT_OP(OP_RETN);
+    POP(frm);
+    POP(offs);
+    /* verify the return address */
+    if ((ucell)offs>=codesize)
+      ABORT_AT(1,AMX_ERR_MEMACCESS);
+    cip=(cell *)(code+(int)offs);
+    stk+= *(cell *)(data+(int)stk) + sizeof(cell); /* remove parameters from the stack */
+    FUNC_EVENT(AMX_FUNC_RETURN);
+    NEXT(cip);
+  op_call:
+    COUNT_OP(OP_CALL);
+    PUSH(((unsigned char *)cip-code)+sizeof(cell));/* push address behind instruction */
+    cip=JUMPABS(code, cip);                     /* jump to the address */
+    COUNT_TARGET();
+    NEXT(cip);
+  op_call_pri:
+    COUNT_OP(OP_CALL_PRI);
+    PUSH((unsigned char *)cip-code);
+    cip=(cell *)(code+(int)pri);
+    COUNT_TARGET();
+    NEXT(cip);
+  op_jump:
+    COUNT_OP(OP_JUMP);
+    /* since the GETPARAM() macro modifies cip, you cannot
+     * do GETPARAM(cip) directly */
+    cip=JUMPABS(code, cip);
+    COUNT_TARGET();
+    NEXT(cip);
+  op_jrel:
+    COUNT_OP(OP_JREL);
+    offs=*cip;
+    cip=(cell *)((unsigned char *)cip + (int)offs + sizeof(cell));
+    COUNT_TARGET();
+    NEXT(cip);
+  op_jzer:
+    COUNT_OP(OP_JZER);
+    if (pri==0) {
+      cip=JUMPABS(code, cip);
+      COUNT_TARGET();
+    } else {
+      cip=(cell *)((unsigned char *)cip+sizeof(cell));
+    } /* if */
+    NEXT(cip);
+  op_jnz:
+    COUNT_OP(OP_JNZ);
+    if (pri!=0) {
+      cip=JUMPABS(code, cip);
+      COUNT_TARGET();
+    } else {
+      cip=(cell *)((unsigned char *)cip+sizeof(cell));
+    } /* if */
+    NEXT(cip);
+  op_jeq:
+    COUNT_OP(OP_JEQ);
+    if (pri==alt) {
+      cip=JUMPABS(code, cip);
+      COUNT_TARGET();
+    } else {
+      cip=(cell *)((unsigned char *)cip+sizeof(cell));
+    } /* if */
+    NEXT(cip);
+  op_jneq:
+    COUNT_OP(OP_JNEQ);
+    if (pri!=alt) {
+      cip=JUMPABS(code, cip);
+      COUNT_TARGET();
+    } else {
+      cip=(cell *)((unsigned char *)cip+sizeof(cell));
+    } /* if */
+    NEXT(cip);
+  op_jless:
+    COUNT_OP(OP_JLESS);
+    if ((ucell)pri < (ucell)alt) {
+      cip=JUMPABS(code, cip);
+      COUNT_TARGET();
+    } else {
+      cip=(cell *)((unsigned char *)cip+sizeof(cell));
+    } /* if */
+    NEXT(cip);
+  op_jleq:
+    COUNT_OP(OP_JLEQ);
+    if ((ucell)pri <= (ucell)alt) {
+      cip=JUMPABS(code, cip);
+      COUNT_TARGET();
+    } else {
+      cip=(cell *)((unsigned char *)cip+sizeof(cell));
+    } /* if */
+    NEXT(cip);
+  op_jgrtr:
+    COUNT_OP(OP_JGRTR);
+    if ((ucell)pri > (ucell)alt) {
+      cip=JUMPABS(code, cip);
+      COUNT_TARGET();
+    } else {
+      cip=(cell *)((unsigned char *)cip+sizeof(cell));
+    } /* if */
+    NEXT(cip);
+  op_jgeq:
+    COUNT_OP(OP_JGEQ);
+    if ((ucell)pri >= (ucell)alt) {
+      cip=JUMPABS(code, cip);
+      COUNT_TARGET();
+    } else {
+      cip=(cell *)((unsigned char *)cip+sizeof(cell));
+    } /* if */
+    NEXT(cip);
+  op_jsless:
+    COUNT_OP(OP_JSLESS);
+    if (pri<alt) {
+      cip=JUMPABS(code, cip);
+      COUNT_TARGET();
+    } else {
+      cip=(cell *)((unsigned char *)cip+sizeof(cell));
+    } /* if */
+    NEXT(cip);
+  op_jsleq:
+    COUNT_OP(OP_JSLEQ);
+    if (pri<=alt) {
+      cip=JUMPABS(code, cip);
+      COUNT_TARGET();
+    } else {
+      cip=(cell *)((unsigned char *)cip+sizeof(cell));
+    } /* if */
+    NEXT(cip);
+  op_jsgrtr:
+    COUNT_OP(OP_JSGRTR);
+    if (pri>alt) {
+      cip=JUMPABS(code, cip);
+      COUNT_TARGET();
+    } else {
+      cip=(cell *)((unsigned char *)cip+sizeof(cell));
+    } /* if */
+    NEXT(cip);
+  op_jsgeq:
+    COUNT_OP(OP_JSGEQ);
+    if (pri>=alt) {
+      cip=JUMPABS(code, cip);
+      COUNT_TARGET();
+    } else {
+      cip=(cell *)((unsigned char *)cip+sizeof(cell));
+    } /* if */
+    NEXT(cip);
+  op_shl:
+    COUNT_OP(OP_SHL);
+    pri<<=alt;
+    NEXT(cip);
+  op_shr:
+    COUNT_OP(OP_SHR);
+    pri=(ucell)pri >> (ucell)alt;
+    NEXT(cip);
+  op_sshr:
+    COUNT_OP(OP_SSHR);
+    pri>>=alt;
+    NEXT(cip);
+  op_shl_c_pri:
+    COUNT_OP(OP_SHL_C_PRI);
+    GETPARAM(offs);
+    pri<<=offs;
+    NEXT(cip);
+  op_shl_c_alt:
+    COUNT_OP(OP_SHL_C_ALT);
+    GETPARAM(offs);
+    alt<<=offs;
+    NEXT(cip);
+  op_shr_c_pri:
+    COUNT_OP(OP_SHR_C_PRI);
+    GETPARAM(offs);
+    pri=(ucell)pri >> (ucell)offs;
+    NEXT(cip);
+  op_shr_c_alt:
+    COUNT_OP(OP_SHR_C_ALT);
+    GETPARAM(offs);
+    alt=(ucell)alt >> (ucell)offs;
+    NEXT(cip);
+  op_smul:
+    COUNT_OP(OP_SMUL);
+    pri*=alt;
+    NEXT(cip);
+  op_sdiv:
+    COUNT_OP(OP_SDIV);
+    if (alt==0)
+      ABORT_AT(1,AMX_ERR_DIVIDE);
+    /* divide must always round down; this is a bit
+     * involved to do in a machine-independent way.
+     */
+    offs=(pri % alt + alt) % alt;     /* true modulus */
+    pri=(pri - offs) / alt;           /* division result */
+    alt=offs;
+    NEXT(cip);
+  op_sdiv_alt:
+    COUNT_OP(OP_SDIV_ALT);
+    if (pri==0)
+      ABORT_AT(1,AMX_ERR_DIVIDE);
+    /* divide must always round down; this is a bit
+     * involved to do in a machine-independent way.
+     */
+    offs=(alt % pri + pri) % pri;     /* true modulus */
+    pri=(alt - offs) / pri;           /* division result */
+    alt=offs;
+    NEXT(cip);
+  op_umul:
+    COUNT_OP(OP_UMUL);
+    pri=(ucell)pri * (ucell)alt;
+    NEXT(cip);
+  op_udiv:
+    COUNT_OP(OP_UDIV);
+    if (alt==0)
+      ABORT_AT(1,AMX_ERR_DIVIDE);
+    offs=(ucell)pri % (ucell)alt;     /* temporary storage */
+    pri=(ucell)pri / (ucell)alt;
+    alt=offs;
+    NEXT(cip);
+  op_udiv_alt:
+    COUNT_OP(OP_UDIV_ALT);
+    if (pri==0)
+      ABORT_AT(1,AMX_ERR_DIVIDE);
+    offs=(ucell)alt % (ucell)pri;     /* temporary storage */
+    pri=(ucell)alt / (ucell)pri;
+    alt=offs;
+    NEXT(cip);
+  op_add:
+    COUNT_OP(OP_ADD);
+    pri+=alt;
+    NEXT(cip);
+  op_sub:
+    COUNT_OP(OP_SUB);
+    pri-=alt;
+    NEXT(cip);
+  op_sub_alt:
+    COUNT_OP(OP_SUB_ALT);
+    pri=alt-pri;
+    NEXT(cip);
+  op_and:
+    COUNT_OP(OP_AND);
+    pri&=alt;
+    NEXT(cip);
+  op_or:
+    COUNT_OP(OP_OR);
+    pri|=alt;
+    NEXT(cip);
+  op_xor:
+    COUNT_OP(OP_XOR);
+    pri^=alt;
+    NEXT(cip);
+  op_not:
+    COUNT_OP(OP_NOT);
+    pri=!pri;
+    NEXT(cip);
+  op_neg:
+    COUNT_OP(OP_NEG);
+    pri=-pri;
+    NEXT(cip);
+  op_invert:
+    COUNT_OP(OP_INVERT);
+    pri=~pri;
+    NEXT(cip);
+  op_add_c:
+    COUNT_OP(OP_ADD_C);
+    GETPARAM(offs);
+    pri+=offs;
+    NEXT(cip);
+  op_smul_c:
+    COUNT_OP(OP_SMUL_C);
+    GETPARAM(offs);
+    pri*=offs;
+    NEXT(cip);
+  op_zero_pri:
+    COUNT_OP(OP_ZERO_PRI);
+    pri=0;
+    NEXT(cip);
+  op_zero_alt:
+    COUNT_OP(OP_ZERO_ALT);
+    alt=0;
+    NEXT(cip);
+  op_zero:
+    COUNT_OP(OP_ZERO);
+    GETPARAM(offs);
+    *(cell *)(data+(int)offs)=0;
+    NEXT(cip);
+  op_zero_s:
+    COUNT_OP(OP_ZERO_S);
+    GETPARAM(offs);
+    *(cell *)(data+(int)frm+(int)offs)=0;
+    NEXT(cip);
+  op_sign_pri:
+    COUNT_OP(OP_SIGN_PRI);
+    if ((pri & 0xff)>=0x80)
+      pri|= ~ (ucell)0xff;
+    NEXT(cip);
+  op_sign_alt:
+    COUNT_OP(OP_SIGN_ALT);
+    if ((alt & 0xff)>=0x80)
+      alt|= ~ (ucell)0xff;
+    NEXT(cip);
+  op_eq:
+    COUNT_OP(OP_EQ);
+    pri= pri==alt ? 1 : 0;
+    NEXT(cip);
+  op_neq:
+    COUNT_OP(OP_NEQ);
+    pri= pri!=alt ? 1 : 0;
+    NEXT(cip);
+  op_less:
+    COUNT_OP(OP_LESS);
+    pri= (ucell)pri < (ucell)alt ? 1 : 0;
+    NEXT(cip);
+  op_leq:
+    COUNT_OP(OP_LEQ);
+    pri= (ucell)pri <= (ucell)alt ? 1 : 0;
+    NEXT(cip);
+  op_grtr:
+    COUNT_OP(OP_GRTR);
+    pri= (ucell)pri > (ucell)alt ? 1 : 0;
+    NEXT(cip);
+  op_geq:
+    COUNT_OP(OP_GEQ);
+    pri= (ucell)pri >= (ucell)alt ? 1 : 0;
+    NEXT(cip);
+  op_sless:
+    COUNT_OP(OP_SLESS);
+    pri= pri<alt ? 1 : 0;
+    NEXT(cip);
+  op_sleq:
+    COUNT_OP(OP_SLEQ);
+    pri= pri<=alt ? 1 : 0;
+    NEXT(cip);
+  op_sgrtr:
+    COUNT_OP(OP_SGRTR);
+    pri= pri>alt ? 1 : 0;
+    NEXT(cip);
+  op_sgeq:
+    COUNT_OP(OP_SGEQ);
+    pri= pri>=alt ? 1 : 0;
+    NEXT(cip);
+  op_eq_c_pri:
+    COUNT_OP(OP_EQ_C_PRI);
+    GETPARAM(offs);
+    pri= pri==offs ? 1 : 0;
+    NEXT(cip);
+  op_eq_c_alt:
+    COUNT_OP(OP_EQ_C_ALT);
+    GETPARAM(offs);
+    pri= alt==offs ? 1 : 0;
+    NEXT(cip);
+  op_inc_pri:
+    COUNT_OP(OP_INC_PRI);
+    pri++;
+    NEXT(cip);
+  op_inc_alt:
+    COUNT_OP(OP_INC_ALT);
+    alt++;
+    NEXT(cip);
+  op_inc:
+    COUNT_OP(OP_INC);
+    GETPARAM(offs);
+    *(cell *)(data+(int)offs) += 1;
+    NEXT(cip);
+  op_inc_s:
+    COUNT_OP(OP_INC_S);
+    GETPARAM(offs);
+    *(cell *)(data+(int)frm+(int)offs) += 1;
+    NEXT(cip);
+  op_inc_i:
+    COUNT_OP(OP_INC_I);
+    *(cell *)(data+(int)pri) += 1;
+    NEXT(cip);
+  op_dec_pri:
+    COUNT_OP(OP_DEC_PRI);
+    pri--;
+    NEXT(cip);
+  op_dec_alt:
+    COUNT_OP(OP_DEC_ALT);
+    alt--;
+    NEXT(cip);
+  op_dec:
+    COUNT_OP(OP_DEC);
+    GETPARAM(offs);
+    *(cell *)(data+(int)offs) -= 1;
+    NEXT(cip);
+  op_dec_s:
+    COUNT_OP(OP_DEC_S);
+    GETPARAM(offs);
+    *(cell *)(data+(int)frm+(int)offs) -= 1;
+    NEXT(cip);
+  op_dec_i:
+    COUNT_OP(OP_DEC_I);
+    *(cell *)(data+(int)pri) -= 1;
+    NEXT(cip);
+  op_movs:
+    COUNT_OP(OP_MOVS);
+    GETPARAM(offs);
+    /* verify top & bottom memory addresses, for both source and destination
+     * addresses
+     */
+    if (pri>=hea && pri<stk || (ucell)pri>=(ucell)amx->stp)
+      ABORT_AT(2,AMX_ERR_MEMACCESS);
+    if ((pri+offs)>hea && (pri+offs)<stk || (ucell)(pri+offs)>(ucell)amx->stp)
+      ABORT_AT(2,AMX_ERR_MEMACCESS);
+    if (alt>=hea && alt<stk || (ucell)alt>=(ucell)amx->stp)
+      ABORT_AT(2,AMX_ERR_MEMACCESS);
+    if ((alt+offs)>hea && (alt+offs)<stk || (ucell)(alt+offs)>(ucell)amx->stp)
+      ABORT_AT(2,AMX_ERR_MEMACCESS);
+    memcpy(data+(int)alt, data+(int)pri, (int)offs);
+    NEXT(cip);
+  op_cmps:
+    COUNT_OP(OP_CMPS);
+    GETPARAM(offs);
+    /* verify top & bottom memory addresses, for both source and destination
+     * addresses
+     */
+    if (pri>=hea && pri<stk || (ucell)pri>=(ucell)amx->stp)
+      ABORT_AT(2,AMX_ERR_MEMACCESS);
+    if ((pri+offs)>hea && (pri+offs)<stk || (ucell)(pri+offs)>(ucell)amx->stp)
+      ABORT_AT(2,AMX_ERR_MEMACCESS);
+    if (alt>=hea && alt<stk || (ucell)alt>=(ucell)amx->stp)
+      ABORT_AT(2,AMX_ERR_MEMACCESS);
+    if ((alt+offs)>hea && (alt+offs)<stk || (ucell)(alt+offs)>(ucell)amx->stp)
+      ABORT_AT(2,AMX_ERR_MEMACCESS);
+    pri=memcmp(data+(int)alt, data+(int)pri, (int)offs);
+    NEXT(cip);
+  op_fill:
+    COUNT_OP(OP_FILL);
+    GETPARAM(offs);
+    /* verify top & bottom memory addresses */
+    if (alt>=hea && alt<stk || (ucell)alt>=(ucell)amx->stp)
+      ABORT_AT(2,AMX_ERR_MEMACCESS);
+    if ((alt+offs)>hea && (alt+offs)<stk || (ucell)(alt+offs)>(ucell)amx->stp)
+      ABORT_AT(2,AMX_ERR_MEMACCESS);
+    for (i=(int)alt; offs>=(int)sizeof(cell); i+=sizeof(cell), offs-=sizeof(cell))
+      *(cell *)(data+i) = pri;
+    NEXT(cip);
+  op_halt:
+    COUNT_OP(OP_HALT);
+    GETPARAM(offs);
+    if (retval!=NULL)
+      *retval=pri;
+    /* store complete status (stk and hea are already set in the ABORT macro) */
+    amx->frm=frm;
+    amx->pri=pri;
+    amx->alt=alt;
+    if (offs!=AMX_ERR_SLEEP) {
+      ABORT_AT(2,(int)offs);
+    } else {
+      amx->cip=(cell)((unsigned char*)cip-code);
+      amx->reset_stk=reset_stk;
+      amx->reset_hea=reset_hea;
+      return (int)offs;
+    } /* if */
+  op_bounds:
+    COUNT_OP(OP_BOUNDS);
+    GETPARAM(offs);
+    if ((ucell)pri>(ucell)offs)
+      ABORT_AT(2,AMX_ERR_BOUNDS);
+    NEXT(cip);
+  op_sysreq_pri:
+    COUNT_OP(OP_SYSREQ_PRI);
+    /* save a few registers */
+    amx->cip=(cell)((unsigned char *)cip-code);
+    amx->hea=hea;
+    amx->frm=frm;
+    amx->stk=stk;
+    num=amx->callback(amx,pri,&pri,(cell *)(data+(int)stk));
+    if (num!=AMX_ERR_NONE) {
+      if (num==AMX_ERR_SLEEP) {
+        amx->pri=pri;
+        amx->alt=alt;
+        amx->reset_stk=reset_stk;
+        amx->reset_hea=reset_hea;
+        return num;
+      } /* if */
+      ABORT(amx,num);
+    } /* if */
+    NEXT(cip);
+  op_sysreq_c:
+    COUNT_OP(OP_SYSREQ_C);
+    GETPARAM(offs);
+    /* save a few registers */
+    amx->cip=(cell)((unsigned char *)cip-code);
+    amx->hea=hea;
+    amx->frm=frm;
+    amx->stk=stk;
+    num=amx->callback(amx,offs,&pri,(cell *)(data+(int)stk));
+    if (num!=AMX_ERR_NONE) {
+      if (num==AMX_ERR_SLEEP) {
+        amx->pri=pri;
+        amx->alt=alt;
+        amx->reset_stk=reset_stk;
+        amx->reset_hea=reset_hea;
+        return num;
+      } /* if */
+      ABORT(amx,num);
+    } /* if */
+    NEXT(cip);
+  op_sysreq_d:
+    COUNT_OP(OP_SYSREQ_D);
+    GETPARAM(offs);
+    /* save a few registers */
+    amx->cip=(cell)((unsigned char *)cip-code);
+    amx->hea=hea;
+    amx->frm=frm;
+    amx->stk=stk;
+    pri=((AMX_NATIVE)offs)(amx,(cell *)(data+(int)stk));
+    if (amx->error!=AMX_ERR_NONE) {
+      if (amx->error==AMX_ERR_SLEEP) {
+        amx->pri=pri;
+        amx->alt=alt;
+        amx->reset_stk=reset_stk;
+        amx->reset_hea=reset_hea;
+        return num;
+      } /* if */
+      ABORT(amx,amx->error);
+    } /* if */
+    NEXT(cip);
+  op_file:
+    COUNT_OP(OP_FILE);
+    GETPARAM(offs);
+    cip=(cell *)((unsigned char *)cip + (int)offs);
+    assert(0);        /* this code should not occur during execution */
+    NEXT(cip);
+  op_line:
+    COUNT_OP(OP_LINE);
+    SKIPPARAM(2);
+    NEXT(cip);
+  op_symbol:
+    COUNT_OP(OP_SYMBOL);
+    GETPARAM(offs);
+    cip=(cell *)((unsigned char *)cip + (int)offs);
+    NEXT(cip);
+  op_srange:
+    COUNT_OP(OP_SRANGE);
+    SKIPPARAM(2);
+    NEXT(cip);
+  op_symtag:
+    COUNT_OP(OP_SYMTAG);
+    SKIPPARAM(1);
+    NEXT(cip);
+  op_jump_pri:
+    COUNT_OP(OP_JUMP_PRI);
+    cip=(cell *)(code+(int)pri);
+    COUNT_TARGET();
+    NEXT(cip);
+  op_switch: {
+    cell *cptr;
+    COUNT_OP(OP_SWITCH);
+    cptr=JUMPABS(code,cip)+1;   /* +1, to skip the "casetbl" opcode */
+    cip=JUMPABS(code,cptr+1);   /* preset to "none-matched" case */
+    num=(int)*cptr;             /* number of records in the case table */
+    for (cptr+=2; num>0 && *cptr!=pri; num--,cptr+=2)
+      /* nothing */;
+    if (num>0)
+      cip=JUMPABS(code,cptr+1); /* case found */
+    COUNT_TARGET();
+    NEXT(cip);
+    }
+  op_casetbl:
+    COUNT_OP(OP_CASETBL);
+    assert(0);          /* this should not occur during execution */
+    NEXT(cip);
+  op_swap_pri:
+    COUNT_OP(OP_SWAP_PRI);
+    offs=*(cell *)(data+(int)stk);
+    *(cell *)(data+(int)stk)=pri;
+    pri=offs;
+    NEXT(cip);
+  op_swap_alt:
+    COUNT_OP(OP_SWAP_ALT);
+    offs=*(cell *)(data+(int)stk);
+    *(cell *)(data+(int)stk)=alt;
+    alt=offs;
+    NEXT(cip);
+  op_pushaddr:
+    COUNT_OP(OP_PUSHADDR);
+    GETPARAM(offs);
+    PUSH(frm+offs);
+    NEXT(cip);
+  op_nop:
+    COUNT_OP(OP_NOP);
+    NEXT(cip);
+  op_break:
+    COUNT_OP(OP_BREAK);
+      if (amx->debug!=NULL) {
+      /* store status */
+      amx->frm=frm;
+      amx->stk=stk;
+      amx->hea=hea;
+      amx->cip=(cell)((unsigned char*)cip-code);
+      num=amx->debug(amx);
+      if (num!=AMX_ERR_NONE) {
+        if (num==AMX_ERR_SLEEP) {
+          amx->pri=pri;
+          amx->alt=alt;
+          amx->reset_stk=reset_stk;
+          amx->reset_hea=reset_hea;
+          return num;
+        } /* if */
+        ABORT(amx,num);
+      } /* if */
+    } /* if */
+    NEXT(cip);
+  /* Superinstructions: the instructions that they replace (except the first
+   * one) are still there, so their opcodes must be skipped. */
+  op_load_s_pri_push:
+    COUNT_OP(OP_LOAD_S_PRI_PUSH);
+    GETPARAM(offs);
+    pri=*(cell *)(data+(int)frm+(int)offs);
+    SKIPPARAM(1);
+    PUSH(pri);
+    NEXT(cip);
+  op_const_pri_bounds:
+    COUNT_OP(OP_CONST_PRI_BOUNDS);
+    GETPARAM(pri);
+    SKIPPARAM(1);
+    GETPARAM(offs);
+    if ((ucell)pri>(ucell)offs) {
+      /* report the error at the BOUNDS instruction */
+      amx->cip=(cell)(cip-2)-(cell)code;
+      ABORT(amx,AMX_ERR_BOUNDS);
+    } /* if */
+    NEXT(cip);
+  op_push2_c:
+    COUNT_OP(OP_PUSH2_C);
+    GETPARAM(offs);
+    PUSH(offs);
+    SKIPPARAM(1);
+    GETPARAM(offs);
+    PUSH(offs);
+    NEXT(cip);
+}
+
+#undef CHKHEAP_AT
+#undef CHKSTACK_AT
+#undef CHKMARGIN_AT
+#undef CHKNAUGHT_AT
+#undef ABORT_AT
+#undef NEXT
+#undef EXEC_CHECK_LONG_CALL
+#undef COUNT_TARGET
+#undef COUNT_OP
+#undef AMX_EXEC_LONG_CALL
+#undef AMX_EXEC_COUNT_OPS
+#undef AMX_EXEC_TRACK_CIP
+#undef AMX_EXEC_NAME
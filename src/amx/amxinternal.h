@@ -0,0 +1,195 @@
+/*  Pawn Abstract Machine (for the Pawn language)
+ *
+ *  Copyright (c) ITB CompuPhase, 1997-2005
+ *
+ *  This software is provided "as-is", without any express or implied warranty.
+ *  In no event will the authors be held liable for any damages arising from
+ *  the use of this software.
+ *
+ *  Permission is granted to anyone to use this software for any purpose,
+ *  including commercial applications, and to alter it and redistribute it
+ *  freely, subject to the following restrictions:
+ *
+ *  1.  The origin of this software must not be misrepresented; you must not
+ *      claim that you wrote the original software. If you use this software in
+ *      a product, an acknowledgment in the product documentation would be
+ *      appreciated but is not required.
+ *  2.  Altered source versions must be plainly marked as such, and must not be
+ *      misrepresented as being the original software.
+ *  3.  This notice may not be removed or altered from any source distribution.
+ */
+
+/* Definitions shared by amx.c and the JIT compiler (amxjit.c) that are not
+ * part of the public interface.
+ */
+#ifndef AMXINTERNAL_H_INCLUDED
+#define AMXINTERNAL_H_INCLUDED
+
+#include "amx.h"
+
+/* number of instructions executed between long call time checks */
+#define LONG_CALL_CHECK_INTERVAL 5000
+
+#define STKMARGIN       ((cell)(16*sizeof(cell)))
+
+#define USENAMETABLE(hdr) \
+                        ((hdr)->defsize==sizeof(AMX_FUNCSTUBNT))
+#define NUMENTRIES(hdr,field,nextfield) \
+                        (unsigned)(((hdr)->nextfield - (hdr)->field) / (hdr)->defsize)
+#define GETENTRY(hdr,table,index) \
+                        (AMX_FUNCSTUB *)((unsigned char*)(hdr) + (unsigned)(hdr)->table + (unsigned)index*(hdr)->defsize)
+#define GETENTRYNAME(hdr,entry) \
+                        ( USENAMETABLE(hdr) \
+                           ? (char *)((unsigned char*)(hdr) + (unsigned)((AMX_FUNCSTUBNT*)(entry))->nameofs) \
+                           : ((AMX_FUNCSTUB*)(entry))->name )
+
+typedef enum {
+  OP_NONE,              /* invalid opcode */
+  OP_LOAD_PRI,
+  OP_LOAD_ALT,
+  OP_LOAD_S_PRI,
+  OP_LOAD_S_ALT,
+  OP_LREF_PRI,
+  OP_LREF_ALT,
+  OP_LREF_S_PRI,
+  OP_LREF_S_ALT,
+  OP_LOAD_I,
+  OP_LODB_I,
+  OP_CONST_PRI,
+  OP_CONST_ALT,
+  OP_ADDR_PRI,
+  OP_ADDR_ALT,
+  OP_STOR_PRI,
+  OP_STOR_ALT,
+  OP_STOR_S_PRI,
+  OP_STOR_S_ALT,
+  OP_SREF_PRI,
+  OP_SREF_ALT,
+  OP_SREF_S_PRI,
+  OP_SREF_S_ALT,
+  OP_STOR_I,
+  OP_STRB_I,
+  OP_LIDX,
+  OP_LIDX_B,
+  OP_IDXADDR,
+  OP_IDXADDR_B,
+  OP_ALIGN_PRI,
+  OP_ALIGN_ALT,
+  OP_LCTRL,
+  OP_SCTRL,
+  OP_MOVE_PRI,
+  OP_MOVE_ALT,
+  OP_XCHG,
+  OP_PUSH_PRI,
+  OP_PUSH_ALT,
+  OP_PUSH_R,
+  OP_PUSH_C,
+  OP_PUSH,
+  OP_PUSH_S,
+  OP_POP_PRI,
+  OP_POP_ALT,
+  OP_STACK,
+  OP_HEAP,
+  OP_PROC,
+  OP_RET,
+  OP_RETN,
+  OP_CALL,
+  OP_CALL_PRI,
+  OP_JUMP,
+  OP_JREL,
+  OP_JZER,
+  OP_JNZ,
+  OP_JEQ,
+  OP_JNEQ,
+  OP_JLESS,
+  OP_JLEQ,
+  OP_JGRTR,
+  OP_JGEQ,
+  OP_JSLESS,
+  OP_JSLEQ,
+  OP_JSGRTR,
+  OP_JSGEQ,
+  OP_SHL,
+  OP_SHR,
+  OP_SSHR,
+  OP_SHL_C_PRI,
+  OP_SHL_C_ALT,
+  OP_SHR_C_PRI,
+  OP_SHR_C_ALT,
+  OP_SMUL,
+  OP_SDIV,
+  OP_SDIV_ALT,
+  OP_UMUL,
+  OP_UDIV,
+  OP_UDIV_ALT,
+  OP_ADD,
+  OP_SUB,
+  OP_SUB_ALT,
+  OP_AND,
+  OP_OR,
+  OP_XOR,
+  OP_NOT,
+  OP_NEG,
+  OP_INVERT,
+  OP_ADD_C,
+  OP_SMUL_C,
+  OP_ZERO_PRI,
+  OP_ZERO_ALT,
+  OP_ZERO,
+  OP_ZERO_S,
+  OP_SIGN_PRI,
+  OP_SIGN_ALT,
+  OP_EQ,
+  OP_NEQ,
+  OP_LESS,
+  OP_LEQ,
+  OP_GRTR,
+  OP_GEQ,
+  OP_SLESS,
+  OP_SLEQ,
+  OP_SGRTR,
+  OP_SGEQ,
+  OP_EQ_C_PRI,
+  OP_EQ_C_ALT,
+  OP_INC_PRI,
+  OP_INC_ALT,
+  OP_INC,
+  OP_INC_S,
+  OP_INC_I,
+  OP_DEC_PRI,
+  OP_DEC_ALT,
+  OP_DEC,
+  OP_DEC_S,
+  OP_DEC_I,
+  OP_MOVS,
+  OP_CMPS,
+  OP_FILL,
+  OP_HALT,
+  OP_BOUNDS,
+  OP_SYSREQ_PRI,
+  OP_SYSREQ_C,
+  OP_FILE,    /* obsolete */
+  OP_LINE,    /* obsolete */
+  OP_SYMBOL,  /* obsolete */
+  OP_SRANGE,  /* obsolete */
+  OP_JUMP_PRI,
+  OP_SWITCH,
+  OP_CASETBL,
+  OP_SWAP_PRI,
+  OP_SWAP_ALT,
+  OP_PUSHADDR,
+  OP_NOP,
+  OP_SYSREQ_D,
+  OP_SYMTAG,  /* obsolete */
+  OP_BREAK,
+  /* ----- */
+  OP_NUM_OPCODES,
+  /* superinstructions, only created by amx_FuseOpcodes() */
+  OP_LOAD_S_PRI_PUSH=OP_NUM_OPCODES,  /* LOAD.S.pri + PUSH.pri */
+  OP_CONST_PRI_BOUNDS,                /* CONST.pri + BOUNDS */
+  OP_PUSH2_C,                         /* PUSH.C + PUSH.C */
+  /* ----- */
+  OP_NUM_FUSED_OPCODES
+} OPCODE;
+
+#endif /* AMXINTERNAL_H_INCLUDED */
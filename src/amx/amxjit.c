@@ -0,0 +1,1733 @@
+/*  JIT compiler for the Pawn Abstract Machine (x86, 32-bit cells only)
+ *
+ *  Copyright (c) 2026 Zeex
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <assert.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include "osdefs.h"
+#if defined LINUX || defined __FreeBSD__ || defined __OpenBSD__
+  #include <sclinux.h>
+#endif
+#include "amx.h"
+#include "amxinternal.h"
+#include "amxjit.h"
+
+#if (defined __i386__ || defined _M_IX86) && PAWN_CELL_SIZE==32
+
+#if defined __WIN32__ || defined _WIN32 || defined WIN32
+  #include <windows.h>
+#else
+  #include <sys/types.h>
+  #include <sys/mman.h>
+#endif
+
+/* the helpers are called from the generated code, which cleans up the
+ * stack after them */
+#if defined _MSC_VER
+  #define JIT_CDECL __cdecl
+#elif defined __GNUC__
+  #define JIT_CDECL __attribute__((cdecl))
+#else
+  #define JIT_CDECL
+#endif
+
+/* The state of a running program, EBX points to it in the generated code.
+ * PRI, ALT, STK and FRM are kept in registers and are only stored here
+ * when calling a helper or leaving the generated code; HEA always lives
+ * here.
+ */
+typedef struct tagJIT_STATE {
+  cell pri;
+  cell alt;
+  cell stk;
+  cell frm;
+  cell hea;
+  cell cip;             /* current instruction (for helpers and errors) */
+  cell hlw;
+  cell stp;
+  int error;
+  int halt;             /* stopped by HALT */
+  int long_call_delay;
+  int address_naught;
+  unsigned char *data;
+  void *esp;            /* native stack pointer on entry */
+  AMX *amx;
+  AMX_EXT_HOOKS *ext_hooks;
+  AMX_LCT_CTL long_call_ctl;
+  AMX_ADDR_0_CTL address_naught_ctl;
+} JIT_STATE;
+
+typedef int (JIT_CDECL *JIT_ENTRY)(JIT_STATE *st, void *start);
+typedef int (JIT_CDECL *JIT_HELPER)(JIT_STATE *st, cell arg);
+
+typedef struct tagJIT_PCMAP {
+  size_t offset;        /* start of the native code */
+  cell cip;             /* the instruction it belongs to */
+} JIT_PCMAP;
+
+struct tagAMX_JIT {
+  AMX *amx;
+  unsigned char *code;  /* generated code, the entry point is at offset 0 */
+  size_t code_size;
+  size_t body_size;     /* the instructions end here, the stubs follow */
+  void **targets;       /* native address of every cell of the AMX code */
+  cell codesize;        /* size of the AMX code */
+  JIT_PCMAP *pcmap;
+  int num_pcmap;
+  int num_body_pcmap;   /* entries of the instructions, in order of CIP */
+};
+
+/* x86 registers and the AMX registers that are kept in them */
+enum {
+  R_EAX, R_ECX, R_EDX, R_EBX, R_ESP, R_EBP, R_ESI, R_EDI,
+  R_NONE=-1
+};
+#define R_PRI   R_EAX
+#define R_ALT   R_ECX
+#define R_STK   R_EDI
+#define R_FRM   R_EBP
+#define R_DAT   R_ESI           /* start of the data section */
+#define R_ST    R_EBX           /* JIT_STATE */
+
+/* condition codes */
+enum {
+  CC_B=2, CC_AE, CC_E, CC_NE, CC_BE, CC_A, CC_S, CC_NS,
+  CC_L=12, CC_GE, CC_LE, CC_G,
+  CC_ALWAYS=-1
+};
+
+#define ST(field)       ((cell)offsetof(JIT_STATE, field))
+
+enum {
+  STUB_TRAP,            /* raise an error */
+  STUB_LONG_CALL        /* check the long call time and come back */
+};
+
+typedef struct tagJIT_STUB {
+  int kind;
+  size_t jump;          /* rel32 of the jump to the stub */
+  size_t back;          /* STUB_LONG_CALL: where to continue */
+  cell cip;
+  int error;
+} JIT_STUB;
+
+typedef struct tagJIT_FIXUP {
+  size_t jump;          /* rel32 of the jump */
+  cell target;          /* CIP of the target */
+} JIT_FIXUP;
+
+typedef struct tagJIT_COMPILER {
+  unsigned char *buf;
+  size_t size, capacity;
+  int error;
+  AMX *amx;
+  unsigned char *code;  /* the AMX code */
+  cell codesize;
+  unsigned char *opcodes;
+  size_t *offsets;      /* native offset of each instruction, 0 if none */
+  void **targets;
+  JIT_FIXUP *fixups;
+  int num_fixups, max_fixups;
+  JIT_STUB *stubs;
+  int num_stubs, max_stubs;
+  JIT_PCMAP *pcmap;
+  int num_pcmap, max_pcmap;
+  int long_calls;       /* generate long call checks */
+  int count;            /* instructions since the last long call check */
+  size_t exit_full;     /* store PRI and ALT, then exit_regs */
+  size_t exit_regs;     /* store STK and FRM and return ctx->error */
+  size_t helper_fail;   /* a helper returned an error (in EAX) */
+  size_t bad_target;    /* jump into the middle of an instruction (CIP in EDX) */
+} JIT_COMPILER;
+
+static int grow(void **array, int *max, int num, size_t elsize)
+{
+  void *p;
+  int newmax;
+
+  if (num<*max)
+    return 1;
+  newmax=(*max==0) ? 256 : *max*2;
+  if ((p=realloc(*array, (size_t)newmax*elsize))==NULL)
+    return 0;
+  *array=p;
+  *max=newmax;
+  return 1;
+}
+
+static void emit8(JIT_COMPILER *c, int b)
+{
+  unsigned char *p;
+  size_t newcap;
+
+  if (c->size==c->capacity) {
+    newcap=(c->capacity==0) ? 4096 : c->capacity*2;
+    if ((p=(unsigned char *)realloc(c->buf, newcap))==NULL) {
+      c->error=AMX_ERR_MEMORY;
+      c->size=0;        /* keep going, the result is thrown away */
+      return;
+    } /* if */
+    c->buf=p;
+    c->capacity=newcap;
+  } /* if */
+  c->buf[c->size++]=(unsigned char)b;
+}
+
+static void emit32(JIT_COMPILER *c, ucell v)
+{
+  emit8(c, (int)(v & 0xff));
+  emit8(c, (int)((v>>8) & 0xff));
+  emit8(c, (int)((v>>16) & 0xff));
+  emit8(c, (int)((v>>24) & 0xff));
+}
+
+static void patch32(JIT_COMPILER *c, size_t pos, ucell v)
+{
+  if (c->error!=AMX_ERR_NONE)
+    return;
+  c->buf[pos]=(unsigned char)(v & 0xff);
+  c->buf[pos+1]=(unsigned char)((v>>8) & 0xff);
+  c->buf[pos+2]=(unsigned char)((v>>16) & 0xff);
+  c->buf[pos+3]=(unsigned char)((v>>24) & 0xff);
+}
+
+/* points the rel32 at pos to target */
+static void patch_rel32(JIT_COMPILER *c, size_t pos, size_t target)
+{
+  patch32(c, pos, (ucell)(target-(pos+4)));
+}
+
+static int fits8(cell v)
+{
+  return v>=-128 && v<=127;
+}
+
+/* ModRM, SIB and displacement for [base+index*(1<<scale)+disp]; base may be
+ * R_NONE for an absolute address */
+static void emit_mem_scaled(JIT_COMPILER *c, int reg, int base, int index,
+                            int scale, cell disp)
+{
+  int mod;
+
+  assert(index!=R_ESP);
+  if (base==R_NONE) {
+    assert(index==R_NONE);
+    emit8(c, (reg<<3) | 5);
+    emit32(c, (ucell)disp);
+    return;
+  } /* if */
+  if (disp==0 && base!=R_EBP)
+    mod=0;
+  else if (fits8(disp))
+    mod=1;
+  else
+    mod=2;
+  if (index==R_NONE && base!=R_ESP) {
+    emit8(c, (mod<<6) | (reg<<3) | base);
+  } else {
+    emit8(c, (mod<<6) | (reg<<3) | 4);
+    emit8(c, (scale<<6) | ((index==R_NONE ? 4 : index)<<3) | base);
+  } /* if */
+  if (mod==1)
+    emit8(c, (int)(disp & 0xff));
+  else if (mod==2)
+    emit32(c, (ucell)disp);
+}
+
+static void emit_mem(JIT_COMPILER *c, int reg, int base, int index, cell disp)
+{
+  emit_mem_scaled(c, reg, base, index, 0, disp);
+}
+
+/* op reg, [base+index+disp] (or the other way around) */
+static void emit_op_mem(JIT_COMPILER *c, int op, int reg, int base, int index,
+                        cell disp)
+{
+  emit8(c, op);
+  emit_mem(c, reg, base, index, disp);
+}
+
+/* op rm, reg (register operands) */
+static void emit_op_rr(JIT_COMPILER *c, int op, int reg, int rm)
+{
+  emit8(c, op);
+  emit8(c, 0xc0 | (reg<<3) | rm);
+}
+
+#define emit_load(c,reg,base,index,disp)  emit_op_mem(c,0x8b,reg,base,index,disp)
+#define emit_store(c,reg,base,index,disp) emit_op_mem(c,0x89,reg,base,index,disp)
+#define emit_lea(c,reg,base,index,disp)   emit_op_mem(c,0x8d,reg,base,index,disp)
+#define emit_mov_rr(c,dst,src)            emit_op_rr(c,0x89,src,dst)
+
+/* mov reg, imm32 */
+static void emit_mov_imm(JIT_COMPILER *c, int reg, cell v)
+{
+  emit8(c, 0xb8+reg);
+  emit32(c, (ucell)v);
+}
+
+/* mov dword [base+index+disp], imm32 */
+static void emit_store_imm(JIT_COMPILER *c, int base, int index, cell disp,
+                           cell v)
+{
+  emit_op_mem(c, 0xc7, 0, base, index, disp);
+  emit32(c, (ucell)v);
+}
+
+/* ALU operations with an immediate operand, the digit selects the operation */
+enum { ALU_ADD, ALU_OR, ALU_ADC, ALU_SBB, ALU_AND, ALU_SUB, ALU_XOR, ALU_CMP };
+
+static void emit_alu_imm(JIT_COMPILER *c, int digit, int reg, cell v)
+{
+  if (fits8(v)) {
+    emit_op_rr(c, 0x83, digit, reg);
+    emit8(c, (int)(v & 0xff));
+  } else {
+    emit_op_rr(c, 0x81, digit, reg);
+    emit32(c, (ucell)v);
+  } /* if */
+}
+
+static void emit_alu_imm_mem(JIT_COMPILER *c, int digit, int base, int index,
+                             cell disp, cell v)
+{
+  if (fits8(v)) {
+    emit_op_mem(c, 0x83, digit, base, index, disp);
+    emit8(c, (int)(v & 0xff));
+  } else {
+    emit_op_mem(c, 0x81, digit, base, index, disp);
+    emit32(c, (ucell)v);
+  } /* if */
+}
+
+/* setcc al; movzx eax, al */
+static void emit_setcc_pri(JIT_COMPILER *c, int cc)
+{
+  emit8(c, 0x0f);
+  emit8(c, 0x90+cc);
+  emit8(c, 0xc0);
+  emit8(c, 0x0f);
+  emit8(c, 0xb6);
+  emit8(c, 0xc0);
+}
+
+/* jmp/jcc rel32, returns the position of the displacement */
+static size_t emit_jump(JIT_COMPILER *c, int cc)
+{
+  if (cc==CC_ALWAYS) {
+    emit8(c, 0xe9);
+  } else {
+    emit8(c, 0x0f);
+    emit8(c, 0x80+cc);
+  } /* if */
+  emit32(c, 0);
+  return c->size-4;
+}
+
+/* a jump to code that has already been generated */
+static void emit_jump_back(JIT_COMPILER *c, int cc, size_t target)
+{
+  patch_rel32(c, emit_jump(c, cc), target);
+}
+
+/* short jcc over a few instructions, see patch_short() */
+static size_t emit_short_jump(JIT_COMPILER *c, int cc)
+{
+  emit8(c, (cc==CC_ALWAYS) ? 0xeb : 0x70+cc);
+  emit8(c, 0);
+  return c->size-1;
+}
+
+static void patch_short(JIT_COMPILER *c, size_t pos)
+{
+  assert(c->error!=AMX_ERR_NONE || c->size-(pos+1)<128);
+  if (c->error==AMX_ERR_NONE)
+    c->buf[pos]=(unsigned char)(c->size-(pos+1));
+}
+
+static void add_pcmap(JIT_COMPILER *c, cell cip)
+{
+  if (!grow((void **)&c->pcmap, &c->max_pcmap, c->num_pcmap, sizeof(JIT_PCMAP))) {
+    c->error=AMX_ERR_MEMORY;
+    return;
+  } /* if */
+  c->pcmap[c->num_pcmap].offset=c->size;
+  c->pcmap[c->num_pcmap].cip=cip;
+  c->num_pcmap++;
+}
+
+static JIT_STUB *add_stub(JIT_COMPILER *c, int kind, size_t jump, cell cip)
+{
+  JIT_STUB *stub;
+
+  if (!grow((void **)&c->stubs, &c->max_stubs, c->num_stubs, sizeof(JIT_STUB))) {
+    c->error=AMX_ERR_MEMORY;
+    return NULL;
+  } /* if */
+  stub=&c->stubs[c->num_stubs++];
+  stub->kind=kind;
+  stub->jump=jump;
+  stub->back=0;
+  stub->cip=cip;
+  stub->error=AMX_ERR_NONE;
+  return stub;
+}
+
+/* raises an error at the instruction at cip if the condition is true */
+static void emit_trap(JIT_COMPILER *c, int cc, cell cip, int error)
+{
+  JIT_STUB *stub=add_stub(c, STUB_TRAP, emit_jump(c, cc), cip);
+  if (stub!=NULL)
+    stub->error=error;
+}
+
+/* a jump to another instruction */
+static void emit_branch(JIT_COMPILER *c, int cc, cell target)
+{
+  size_t jump=emit_jump(c, cc);
+
+  if (!grow((void **)&c->fixups, &c->max_fixups, c->num_fixups, sizeof(JIT_FIXUP))) {
+    c->error=AMX_ERR_MEMORY;
+    return;
+  } /* if */
+  c->fixups[c->num_fixups].jump=jump;
+  c->fixups[c->num_fixups].target=target;
+  c->num_fixups++;
+}
+
+/* The interpreter checks the long call time every few thousand
+ * instructions; the generated code counts the instructions that it went
+ * through before each jump, call and return instead.
+ */
+static void emit_long_call_check(JIT_COMPILER *c, cell cip)
+{
+  JIT_STUB *stub;
+  cell count=(c->count>0) ? c->count : 1;
+
+  c->count=0;
+  if (!c->long_calls)
+    return;
+  emit_alu_imm_mem(c, ALU_SUB, R_ST, R_NONE, ST(long_call_delay), count);
+  stub=add_stub(c, STUB_LONG_CALL, emit_jump(c, CC_LE), cip);
+  if (stub!=NULL)
+    stub->back=c->size;
+}
+
+/* the same checks as in the interpreter: an address must not be between
+ * the heap and the stack or above the stack */
+static void emit_check_address(JIT_COMPILER *c, int reg, cell cip)
+{
+  size_t skip;
+
+  emit_op_mem(c, 0x3b, reg, R_ST, R_NONE, ST(stp));     /* cmp reg, [stp] */
+  emit_trap(c, CC_AE, cip, AMX_ERR_MEMACCESS);
+  emit_op_mem(c, 0x3b, reg, R_ST, R_NONE, ST(hea));     /* cmp reg, [hea] */
+  skip=emit_short_jump(c, CC_L);
+  emit_op_rr(c, 0x3b, reg, R_STK);                      /* cmp reg, edi */
+  emit_trap(c, CC_L, cip, AMX_ERR_MEMACCESS);
+  patch_short(c, skip);
+}
+
+static void emit_check_naught_enabled(JIT_COMPILER *c, cell cip)
+{
+  emit_alu_imm_mem(c, ALU_CMP, R_ST, R_NONE, ST(address_naught), 0);
+  emit_trap(c, CC_NE, cip, AMX_ERR_ADDRESS_0);
+}
+
+/* writing to address 0 (in reg) is an error if address naught checks are
+ * enabled */
+static void emit_check_naught(JIT_COMPILER *c, int reg, cell cip)
+{
+  size_t skip;
+
+  emit_op_rr(c, 0x85, reg, reg);                        /* test reg, reg */
+  skip=emit_short_jump(c, CC_NE);
+  emit_check_naught_enabled(c, cip);
+  patch_short(c, skip);
+}
+
+static void emit_check_margin(JIT_COMPILER *c, cell cip)
+{
+  emit_load(c, R_EDX, R_ST, R_NONE, ST(hea));
+  emit_alu_imm(c, ALU_ADD, R_EDX, STKMARGIN);
+  emit_op_rr(c, 0x3b, R_EDX, R_STK);                    /* cmp edx, edi */
+  emit_trap(c, CC_G, cip, AMX_ERR_STACKERR);
+}
+
+static void emit_push(JIT_COMPILER *c, int reg)
+{
+  emit_alu_imm(c, ALU_SUB, R_STK, sizeof(cell));
+  emit_store(c, reg, R_DAT, R_STK, 0);
+}
+
+static void emit_push_imm(JIT_COMPILER *c, cell v)
+{
+  emit_alu_imm(c, ALU_SUB, R_STK, sizeof(cell));
+  emit_store_imm(c, R_DAT, R_STK, 0, v);
+}
+
+static void emit_pop(JIT_COMPILER *c, int reg)
+{
+  emit_load(c, reg, R_DAT, R_STK, 0);
+  emit_alu_imm(c, ALU_ADD, R_STK, sizeof(cell));
+}
+
+static void emit_spill(JIT_COMPILER *c)
+{
+  emit_store(c, R_PRI, R_ST, R_NONE, ST(pri));
+  emit_store(c, R_ALT, R_ST, R_NONE, ST(alt));
+  emit_store(c, R_STK, R_ST, R_NONE, ST(stk));
+  emit_store(c, R_FRM, R_ST, R_NONE, ST(frm));
+}
+
+/* calls helper(st, arg) with the registers stored in the state; the
+ * argument is either in a register or an immediate value */
+static void emit_call_helper(JIT_COMPILER *c, JIT_HELPER helper, cell cip,
+                             int arg_reg, cell arg)
+{
+  emit_spill(c);
+  emit_store_imm(c, R_ST, R_NONE, ST(cip), cip);
+  emit_store(c, R_ST, R_ESP, R_NONE, 0);
+  if (arg_reg==R_NONE)
+    emit_store_imm(c, R_ESP, R_NONE, sizeof(cell), arg);
+  else
+    emit_store(c, arg_reg, R_ESP, R_NONE, sizeof(cell));
+  emit_mov_imm(c, R_EDX, (cell)helper);
+  emit_op_rr(c, 0xff, 2, R_EDX);                        /* call edx */
+  emit_op_rr(c, 0x85, R_EAX, R_EAX);                    /* test eax, eax */
+  emit_jump_back(c, CC_NE, c->helper_fail);
+  emit_load(c, R_PRI, R_ST, R_NONE, ST(pri));
+  emit_load(c, R_ALT, R_ST, R_NONE, ST(alt));
+}
+
+/* jumps to the instruction at the AMX address in EDX */
+static void emit_check_target(JIT_COMPILER *c, cell cip)
+{
+  emit_alu_imm(c, ALU_CMP, R_EDX, c->codesize);
+  emit_trap(c, CC_AE, cip, AMX_ERR_MEMACCESS);
+  emit8(c, 0xf6);                                       /* test dl, 3 */
+  emit8(c, 0xc2);
+  emit8(c, 3);
+  emit_trap(c, CC_NE, cip, AMX_ERR_MEMACCESS);
+}
+
+static void emit_jump_table(JIT_COMPILER *c)
+{
+  emit_op_mem(c, 0xff, 4, R_EDX, R_NONE, (cell)c->targets); /* jmp [edx+targets] */
+}
+
+/* floor division of EAX by ECX, the quotient goes to PRI and the remainder
+ * to ALT */
+static void emit_sdiv(JIT_COMPILER *c)
+{
+  size_t done1, neg, done2;
+
+  emit8(c, 0x99);                                       /* cdq */
+  emit_op_rr(c, 0xf7, 7, R_ECX);                        /* idiv ecx */
+  emit_op_rr(c, 0x85, R_EDX, R_EDX);
+  done1=emit_short_jump(c, CC_E);
+  emit_op_rr(c, 0x31, R_ECX, R_EDX);                    /* xor edx, ecx */
+  neg=emit_short_jump(c, CC_S);
+  emit_op_rr(c, 0x31, R_ECX, R_EDX);
+  done2=emit_short_jump(c, CC_ALWAYS);
+  patch_short(c, neg);
+  emit_op_rr(c, 0x31, R_ECX, R_EDX);
+  emit8(c, 0x48);                                       /* dec eax */
+  emit_op_rr(c, 0x01, R_ECX, R_EDX);                    /* add edx, ecx */
+  patch_short(c, done1);
+  patch_short(c, done2);
+  emit_mov_rr(c, R_ALT, R_EDX);
+}
+
+static void emit_udiv(JIT_COMPILER *c)
+{
+  emit_op_rr(c, 0x31, R_EDX, R_EDX);                    /* xor edx, edx */
+  emit_op_rr(c, 0xf7, 6, R_ECX);                        /* div ecx */
+  emit_mov_rr(c, R_ALT, R_EDX);
+}
+
+static int JIT_CDECL jit_sysreq(JIT_STATE *st, cell index)
+{
+  AMX *amx=st->amx;
+
+  amx->cip=st->cip;
+  amx->hea=st->hea;
+  amx->frm=st->frm;
+  amx->stk=st->stk;
+  return amx->callback(amx, index, &st->pri, (cell *)(st->data+(int)st->stk));
+}
+
+static int JIT_CDECL jit_sysreq_d(JIT_STATE *st, cell address)
+{
+  AMX *amx=st->amx;
+
+  amx->cip=st->cip;
+  amx->hea=st->hea;
+  amx->frm=st->frm;
+  amx->stk=st->stk;
+  st->pri=((AMX_NATIVE)address)(amx, (cell *)(st->data+(int)st->stk));
+  return amx->error;
+}
+
+static int JIT_CDECL jit_break(JIT_STATE *st, cell unused)
+{
+  AMX *amx=st->amx;
+
+  (void)unused;
+  if (amx->debug==NULL)
+    return AMX_ERR_NONE;
+  amx->frm=st->frm;
+  amx->stk=st->stk;
+  amx->hea=st->hea;
+  amx->cip=st->cip;
+  return amx->debug(amx);
+}
+
+static int JIT_CDECL jit_long_call(JIT_STATE *st, cell unused)
+{
+  AMX *amx=st->amx;
+  cell frm, hea, stk;
+
+  (void)unused;
+  st->long_call_delay=LONG_CALL_CHECK_INTERVAL;
+  if (st->long_call_ctl!=NULL) {
+    frm=amx->frm;
+    hea=amx->hea;
+    stk=amx->stk;
+    amx->frm=st->frm;
+    amx->hea=st->hea;
+    amx->stk=st->stk;
+    amx->cip=st->cip;
+    st->long_call_ctl(amx, AMX_LCT_CHECK, 0);
+    amx->frm=frm;
+    amx->hea=hea;
+    amx->stk=stk;
+  } /* if */
+  return AMX_ERR_NONE;
+}
+
+static int JIT_CDECL jit_lctrl(JIT_STATE *st, cell index)
+{
+  AMX *amx=st->amx;
+
+  switch (index) {
+  case 0xFE:
+    if (st->long_call_ctl==NULL)
+      st->pri=0;
+    else
+      st->pri=st->long_call_ctl(amx, AMX_LCT_OPTION, AMX_LCT_OPTION_CURRENT);
+    break;
+  case 0xFF:
+    if (st->ext_hooks==NULL || st->long_call_ctl==NULL)
+      st->pri=1|16|32|64;
+    else
+      st->pri=1|32|(st->long_call_ctl(amx, AMX_LCT_OPTION, AMX_LCT_OPTION_ACTIVE)<<1)|64|(st->address_naught<<7);
+    break;
+  } /* switch */
+  return AMX_ERR_NONE;
+}
+
+static int JIT_CDECL jit_sctrl(JIT_STATE *st, cell index)
+{
+  AMX *amx=st->amx;
+  cell pri=st->pri;
+
+  switch (index) {
+  case 0xFE:
+    if (st->long_call_ctl!=NULL)
+      st->long_call_ctl(amx, AMX_LCT_SET_TIME, pri);
+    break;
+  case 0xFF:
+    if (st->long_call_ctl!=NULL && (pri&32)!=0) {
+      if (pri&2)
+        st->long_call_ctl(amx, AMX_LCT_OPTION, AMX_LCT_OPTION_ENABLE);
+      else if (pri&4)
+        st->long_call_ctl(amx, AMX_LCT_OPTION, AMX_LCT_OPTION_RESET);
+      else if (pri&8)
+        st->long_call_ctl(amx, AMX_LCT_OPTION, AMX_LCT_OPTION_RESTART);
+      else
+        st->long_call_ctl(amx, AMX_LCT_OPTION, AMX_LCT_OPTION_DISABLE);
+    } /* if */
+    if (st->address_naught_ctl!=NULL && (pri&64)!=0) {
+      st->address_naught=(pri&128)!=0;
+      st->address_naught_ctl(amx, st->address_naught);
+    } /* if */
+    break;
+  } /* switch */
+  return AMX_ERR_NONE;
+}
+
+/* the address checks of MOVS, CMPS and FILL */
+static int check_block(JIT_STATE *st, cell addr, cell size)
+{
+  cell hea=st->hea, stk=st->stk;
+
+  if ((addr>=hea && addr<stk) || (ucell)addr>=(ucell)st->stp)
+    return 0;
+  if (((addr+size)>hea && (addr+size)<stk) || (ucell)(addr+size)>(ucell)st->stp)
+    return 0;
+  return 1;
+}
+
+static int JIT_CDECL jit_movs(JIT_STATE *st, cell size)
+{
+  if (!check_block(st, st->pri, size) || !check_block(st, st->alt, size))
+    return AMX_ERR_MEMACCESS;
+  memcpy(st->data+(int)st->alt, st->data+(int)st->pri, (int)size);
+  return AMX_ERR_NONE;
+}
+
+static int JIT_CDECL jit_cmps(JIT_STATE *st, cell size)
+{
+  if (!check_block(st, st->pri, size) || !check_block(st, st->alt, size))
+    return AMX_ERR_MEMACCESS;
+  st->pri=memcmp(st->data+(int)st->alt, st->data+(int)st->pri, (int)size);
+  return AMX_ERR_NONE;
+}
+
+static int JIT_CDECL jit_fill(JIT_STATE *st, cell size)
+{
+  int i;
+
+  if (!check_block(st, st->alt, size))
+    return AMX_ERR_MEMACCESS;
+  for (i=(int)st->alt; size>=(int)sizeof(cell); i+=sizeof(cell), size-=sizeof(cell))
+    *(cell *)(st->data+i)=st->pri;
+  return AMX_ERR_NONE;
+}
+
+/* entry point, exits and other code used by all instructions */
+static void emit_runtime(JIT_COMPILER *c)
+{
+  /* int enter(JIT_STATE *st, void *start) */
+  emit8(c, 0x55);                                       /* push ebp */
+  emit8(c, 0x53);                                       /* push ebx */
+  emit8(c, 0x56);                                       /* push esi */
+  emit8(c, 0x57);                                       /* push edi */
+  emit_load(c, R_ST, R_ESP, R_NONE, 20);
+  emit_load(c, R_EDX, R_ESP, R_NONE, 24);
+  emit_store(c, R_ESP, R_ST, R_NONE, ST(esp));
+  emit_alu_imm(c, ALU_AND, R_ESP, -16);
+  emit_alu_imm(c, ALU_SUB, R_ESP, 16);                  /* helper arguments */
+  emit_load(c, R_PRI, R_ST, R_NONE, ST(pri));
+  emit_load(c, R_ALT, R_ST, R_NONE, ST(alt));
+  emit_load(c, R_STK, R_ST, R_NONE, ST(stk));
+  emit_load(c, R_FRM, R_ST, R_NONE, ST(frm));
+  emit_load(c, R_DAT, R_ST, R_NONE, ST(data));
+  emit_op_rr(c, 0xff, 4, R_EDX);                        /* jmp edx */
+
+  c->exit_full=c->size;
+  emit_store(c, R_PRI, R_ST, R_NONE, ST(pri));
+  emit_store(c, R_ALT, R_ST, R_NONE, ST(alt));
+  c->exit_regs=c->size;
+  emit_store(c, R_STK, R_ST, R_NONE, ST(stk));
+  emit_store(c, R_FRM, R_ST, R_NONE, ST(frm));
+  emit_load(c, R_ESP, R_ST, R_NONE, ST(esp));
+  emit_load(c, R_EAX, R_ST, R_NONE, ST(error));
+  emit8(c, 0x5f);                                       /* pop edi */
+  emit8(c, 0x5e);                                       /* pop esi */
+  emit8(c, 0x5b);                                       /* pop ebx */
+  emit8(c, 0x5d);                                       /* pop ebp */
+  emit8(c, 0xc3);                                       /* ret */
+
+  c->helper_fail=c->size;
+  emit_store(c, R_EAX, R_ST, R_NONE, ST(error));
+  emit_jump_back(c, CC_ALWAYS, c->exit_regs);
+
+  c->bad_target=c->size;
+  emit_store(c, R_EDX, R_ST, R_NONE, ST(cip));
+  emit_store_imm(c, R_ST, R_NONE, ST(error), AMX_ERR_INVINSTR);
+  emit_jump_back(c, CC_ALWAYS, c->exit_full);
+}
+
+#define PARAM(n)  (*(cell *)(c->code+(int)cip+(n)*sizeof(cell)))
+#define TARGET(n) (PARAM(n)-(cell)c->code)  /* relocated jump address */
+
+/* generates code for the instruction at cip, returns 0 if it is invalid */
+static int emit_instruction(JIT_COMPILER *c, cell cip, int op)
+{
+  cell offs, num, i, *table;
+
+  switch (op) {
+  case OP_LOAD_PRI:
+  case OP_LOAD_ALT:
+    emit_load(c, (op==OP_LOAD_PRI) ? R_PRI : R_ALT, R_DAT, R_NONE, PARAM(1));
+    break;
+  case OP_LOAD_S_PRI:
+  case OP_LOAD_S_ALT:
+    emit_load(c, (op==OP_LOAD_S_PRI) ? R_PRI : R_ALT, R_DAT, R_FRM, PARAM(1));
+    break;
+  case OP_LREF_PRI:
+  case OP_LREF_ALT:
+    emit_load(c, R_EDX, R_DAT, R_NONE, PARAM(1));
+    emit_load(c, (op==OP_LREF_PRI) ? R_PRI : R_ALT, R_DAT, R_EDX, 0);
+    break;
+  case OP_LREF_S_PRI:
+  case OP_LREF_S_ALT:
+    emit_load(c, R_EDX, R_DAT, R_FRM, PARAM(1));
+    emit_load(c, (op==OP_LREF_S_PRI) ? R_PRI : R_ALT, R_DAT, R_EDX, 0);
+    break;
+  case OP_LOAD_I:
+    emit_check_address(c, R_PRI, cip);
+    emit_load(c, R_PRI, R_DAT, R_PRI, 0);
+    break;
+  case OP_LODB_I:
+    emit_check_address(c, R_PRI, cip);
+    switch (PARAM(1)) {
+    case 1:
+      emit8(c, 0x0f);                                   /* movzx eax, byte */
+      emit_op_mem(c, 0xb6, R_PRI, R_DAT, R_PRI, 0);
+      break;
+    case 2:
+      emit8(c, 0x0f);                                   /* movzx eax, word */
+      emit_op_mem(c, 0xb7, R_PRI, R_DAT, R_PRI, 0);
+      break;
+    case 4:
+      emit_load(c, R_PRI, R_DAT, R_PRI, 0);
+      break;
+    } /* switch */
+    break;
+  case OP_CONST_PRI:
+  case OP_CONST_ALT:
+    emit_mov_imm(c, (op==OP_CONST_PRI) ? R_PRI : R_ALT, PARAM(1));
+    break;
+  case OP_ADDR_PRI:
+  case OP_ADDR_ALT:
+    emit_lea(c, (op==OP_ADDR_PRI) ? R_PRI : R_ALT, R_FRM, R_NONE, PARAM(1));
+    break;
+  case OP_STOR_PRI:
+  case OP_STOR_ALT:
+    if (PARAM(1)==0)
+      emit_check_naught_enabled(c, cip);
+    emit_store(c, (op==OP_STOR_PRI) ? R_PRI : R_ALT, R_DAT, R_NONE, PARAM(1));
+    break;
+  case OP_STOR_S_PRI:
+  case OP_STOR_S_ALT:
+    emit_lea(c, R_EDX, R_FRM, R_NONE, PARAM(1));
+    emit_check_naught(c, R_EDX, cip);
+    emit_store(c, (op==OP_STOR_S_PRI) ? R_PRI : R_ALT, R_DAT, R_EDX, 0);
+    break;
+  case OP_SREF_PRI:
+  case OP_SREF_ALT:
+    emit_load(c, R_EDX, R_DAT, R_NONE, PARAM(1));
+    emit_check_naught(c, R_EDX, cip);
+    emit_store(c, (op==OP_SREF_PRI) ? R_PRI : R_ALT, R_DAT, R_EDX, 0);
+    break;
+  case OP_SREF_S_PRI:
+  case OP_SREF_S_ALT:
+    emit_load(c, R_EDX, R_DAT, R_FRM, PARAM(1));
+    emit_check_naught(c, R_EDX, cip);
+    emit_store(c, (op==OP_SREF_S_PRI) ? R_PRI : R_ALT, R_DAT, R_EDX, 0);
+    break;
+  case OP_STOR_I:
+    emit_check_address(c, R_ALT, cip);
+    emit_check_naught(c, R_ALT, cip);
+    emit_store(c, R_PRI, R_DAT, R_ALT, 0);
+    break;
+  case OP_STRB_I:
+    emit_check_address(c, R_ALT, cip);
+    if (PARAM(1)==0)
+      emit_check_naught_enabled(c, cip);    /* sic, the same as amx_Exec() */
+    switch (PARAM(1)) {
+    case 1:
+      emit_op_mem(c, 0x88, R_PRI, R_DAT, R_ALT, 0);     /* mov [..], al */
+      break;
+    case 2:
+      emit8(c, 0x66);                                   /* mov [..], ax */
+      emit_store(c, R_PRI, R_DAT, R_ALT, 0);
+      break;
+    case 4:
+      emit_store(c, R_PRI, R_DAT, R_ALT, 0);
+      break;
+    } /* switch */
+    break;
+  case OP_LIDX:
+    emit8(c, 0x8d);                                     /* lea edx, [ecx+eax*4] */
+    emit_mem_scaled(c, R_EDX, R_ALT, R_PRI, 2, 0);
+    emit_check_address(c, R_EDX, cip);
+    emit_load(c, R_PRI, R_DAT, R_EDX, 0);
+    break;
+  case OP_LIDX_B:
+    emit_mov_rr(c, R_EDX, R_PRI);
+    emit_op_rr(c, 0xc1, 4, R_EDX);                      /* shl edx, n */
+    emit8(c, (int)(PARAM(1) & 0xff));
+    emit_op_rr(c, 0x01, R_ALT, R_EDX);                  /* add edx, ecx */
+    emit_check_address(c, R_EDX, cip);
+    emit_load(c, R_PRI, R_DAT, R_EDX, 0);
+    break;
+  case OP_IDXADDR:
+    emit8(c, 0x8d);                                     /* lea eax, [ecx+eax*4] */
+    emit_mem_scaled(c, R_PRI, R_ALT, R_PRI, 2, 0);
+    break;
+  case OP_IDXADDR_B:
+    emit_op_rr(c, 0xc1, 4, R_PRI);                      /* shl eax, n */
+    emit8(c, (int)(PARAM(1) & 0xff));
+    emit_op_rr(c, 0x01, R_ALT, R_PRI);                  /* add eax, ecx */
+    break;
+  case OP_ALIGN_PRI:
+  case OP_ALIGN_ALT:
+    if (PARAM(1)<(int)sizeof(cell))
+      emit_alu_imm(c, ALU_XOR, (op==OP_ALIGN_PRI) ? R_PRI : R_ALT,
+                   sizeof(cell)-PARAM(1));
+    break;
+  case OP_LCTRL:
+    switch (PARAM(1)) {
+    case 0:
+      emit_mov_imm(c, R_PRI, ((AMX_HEADER *)c->amx->base)->cod);
+      break;
+    case 1:
+      emit_mov_imm(c, R_PRI, ((AMX_HEADER *)c->amx->base)->dat);
+      break;
+    case 2:
+      emit_load(c, R_PRI, R_ST, R_NONE, ST(hea));
+      break;
+    case 3:
+      emit_load(c, R_PRI, R_ST, R_NONE, ST(stp));
+      break;
+    case 4:
+      emit_mov_rr(c, R_PRI, R_STK);
+      break;
+    case 5:
+      emit_mov_rr(c, R_PRI, R_FRM);
+      break;
+    case 6:
+      emit_mov_imm(c, R_PRI, cip+2*sizeof(cell));
+      break;
+    case 0xFE:
+    case 0xFF:
+      emit_call_helper(c, jit_lctrl, cip, R_NONE, PARAM(1));
+      break;
+    } /* switch */
+    break;
+  case OP_SCTRL:
+    switch (PARAM(1)) {
+    case 2:
+      emit_store(c, R_PRI, R_ST, R_NONE, ST(hea));
+      break;
+    case 4:
+      emit_mov_rr(c, R_STK, R_PRI);
+      break;
+    case 5:
+      emit_mov_rr(c, R_FRM, R_PRI);
+      break;
+    case 6:
+      emit_long_call_check(c, cip);
+      emit_mov_rr(c, R_EDX, R_PRI);
+      emit_check_target(c, cip);
+      emit_jump_table(c);
+      break;
+    case 0xFE:
+    case 0xFF:
+      emit_call_helper(c, jit_sctrl, cip, R_NONE, PARAM(1));
+      break;
+    } /* switch */
+    break;
+  case OP_MOVE_PRI:
+    emit_mov_rr(c, R_PRI, R_ALT);
+    break;
+  case OP_MOVE_ALT:
+    emit_mov_rr(c, R_ALT, R_PRI);
+    break;
+  case OP_XCHG:
+    emit8(c, 0x91);                                     /* xchg eax, ecx */
+    break;
+  case OP_PUSH_PRI:
+    emit_push(c, R_PRI);
+    break;
+  case OP_PUSH_ALT:
+    emit_push(c, R_ALT);
+    break;
+  case OP_PUSH_R:
+    num=PARAM(1);
+    if (num>0 && num<=8) {
+      for (i=0; i<num; i++)
+        emit_push(c, R_PRI);
+    } else if (num>0) {
+      size_t loop;
+      emit_mov_imm(c, R_EDX, num);
+      loop=c->size;
+      emit_push(c, R_PRI);
+      emit8(c, 0x4a);                                   /* dec edx */
+      emit_jump_back(c, CC_NE, loop);
+    } /* if */
+    break;
+  case OP_PUSH_C:
+    emit_push_imm(c, PARAM(1));
+    break;
+  case OP_PUSH:
+    emit_load(c, R_EDX, R_DAT, R_NONE, PARAM(1));
+    emit_push(c, R_EDX);
+    break;
+  case OP_PUSH_S:
+    emit_load(c, R_EDX, R_DAT, R_FRM, PARAM(1));
+    emit_push(c, R_EDX);
+    break;
+  case OP_POP_PRI:
+    emit_pop(c, R_PRI);
+    break;
+  case OP_POP_ALT:
+    emit_pop(c, R_ALT);
+    break;
+  case OP_STACK:
+    emit_mov_rr(c, R_ALT, R_STK);
+    emit_alu_imm(c, ALU_ADD, R_STK, PARAM(1));
+    emit_check_margin(c, cip);
+    emit_op_mem(c, 0x3b, R_STK, R_ST, R_NONE, ST(stp));   /* cmp edi, [stp] */
+    emit_trap(c, CC_G, cip, AMX_ERR_STACKLOW);
+    break;
+  case OP_HEAP:
+    emit_load(c, R_ALT, R_ST, R_NONE, ST(hea));
+    emit_alu_imm_mem(c, ALU_ADD, R_ST, R_NONE, ST(hea), PARAM(1));
+    emit_check_margin(c, cip);
+    emit_load(c, R_EDX, R_ST, R_NONE, ST(hea));
+    emit_op_mem(c, 0x3b, R_EDX, R_ST, R_NONE, ST(hlw));   /* cmp edx, [hlw] */
+    emit_trap(c, CC_L, cip, AMX_ERR_HEAPLOW);
+    break;
+  case OP_PROC:
+    emit_push(c, R_FRM);
+    emit_mov_rr(c, R_FRM, R_STK);
+    emit_check_margin(c, cip);
+    break;
+  case OP_RET:
+  case OP_RETN:
+    emit_long_call_check(c, cip);
+    emit_load(c, R_FRM, R_DAT, R_STK, 0);
+    emit_load(c, R_EDX, R_DAT, R_STK, sizeof(cell));
+    emit_alu_imm(c, ALU_ADD, R_STK, 2*sizeof(cell));
+    emit_check_target(c, cip);
+    if (op==OP_RETN) {
+      emit_op_mem(c, 0x03, R_STK, R_DAT, R_STK, 0);     /* add edi, [esi+edi] */
+      emit_alu_imm(c, ALU_ADD, R_STK, sizeof(cell));
+    } /* if */
+    emit_jump_table(c);
+    break;
+  case OP_CALL:
+    emit_long_call_check(c, cip);
+    emit_push_imm(c, cip+2*sizeof(cell));
+    emit_branch(c, CC_ALWAYS, TARGET(1));
+    break;
+  case OP_CALL_PRI:
+    emit_long_call_check(c, cip);
+    emit_push_imm(c, cip+sizeof(cell));
+    emit_mov_rr(c, R_EDX, R_PRI);
+    emit_check_target(c, cip);
+    emit_jump_table(c);
+    break;
+  case OP_JUMP:
+    emit_long_call_check(c, cip);
+    emit_branch(c, CC_ALWAYS, TARGET(1));
+    break;
+  case OP_JREL:
+    emit_long_call_check(c, cip);
+    emit_branch(c, CC_ALWAYS, cip+2*sizeof(cell)+PARAM(1));
+    break;
+  case OP_JZER:
+  case OP_JNZ:
+    emit_long_call_check(c, cip);
+    emit_op_rr(c, 0x85, R_PRI, R_PRI);
+    emit_branch(c, (op==OP_JZER) ? CC_E : CC_NE, TARGET(1));
+    break;
+  case OP_JEQ:
+  case OP_JNEQ:
+  case OP_JLESS:
+  case OP_JLEQ:
+  case OP_JGRTR:
+  case OP_JGEQ:
+  case OP_JSLESS:
+  case OP_JSLEQ:
+  case OP_JSGRTR:
+  case OP_JSGEQ: {
+    static const int cc[]={
+      CC_E, CC_NE, CC_B, CC_BE, CC_A, CC_AE, CC_L, CC_LE, CC_G, CC_GE
+    };
+    emit_long_call_check(c, cip);
+    emit_op_rr(c, 0x39, R_ALT, R_PRI);                  /* cmp eax, ecx */
+    emit_branch(c, cc[op-OP_JEQ], TARGET(1));
+    break;
+  } /* case */
+  case OP_SHL:
+    emit_op_rr(c, 0xd3, 4, R_PRI);                      /* shl eax, cl */
+    break;
+  case OP_SHR:
+    emit_op_rr(c, 0xd3, 5, R_PRI);                      /* shr eax, cl */
+    break;
+  case OP_SSHR:
+    emit_op_rr(c, 0xd3, 7, R_PRI);                      /* sar eax, cl */
+    break;
+  case OP_SHL_C_PRI:
+  case OP_SHL_C_ALT:
+  case OP_SHR_C_PRI:
+  case OP_SHR_C_ALT:
+    emit_op_rr(c, 0xc1, (op==OP_SHL_C_PRI || op==OP_SHL_C_ALT) ? 4 : 5,
+               (op==OP_SHL_C_PRI || op==OP_SHR_C_PRI) ? R_PRI : R_ALT);
+    emit8(c, (int)(PARAM(1) & 0xff));
+    break;
+  case OP_SMUL:
+  case OP_UMUL:
+    emit8(c, 0x0f);                                     /* imul eax, ecx */
+    emit_op_rr(c, 0xaf, R_PRI, R_ALT);
+    break;
+  case OP_SDIV:
+    emit_op_rr(c, 0x85, R_ALT, R_ALT);
+    emit_trap(c, CC_E, cip, AMX_ERR_DIVIDE);
+    emit_sdiv(c);
+    break;
+  case OP_SDIV_ALT:
+    emit_op_rr(c, 0x85, R_PRI, R_PRI);
+    emit_trap(c, CC_E, cip, AMX_ERR_DIVIDE);
+    emit8(c, 0x91);                                     /* xchg eax, ecx */
+    emit_sdiv(c);
+    break;
+  case OP_UDIV:
+    emit_op_rr(c, 0x85, R_ALT, R_ALT);
+    emit_trap(c, CC_E, cip, AMX_ERR_DIVIDE);
+    emit_udiv(c);
+    break;
+  case OP_UDIV_ALT:
+    emit_op_rr(c, 0x85, R_PRI, R_PRI);
+    emit_trap(c, CC_E, cip, AMX_ERR_DIVIDE);
+    emit8(c, 0x91);                                     /* xchg eax, ecx */
+    emit_udiv(c);
+    break;
+  case OP_ADD:
+    emit_op_rr(c, 0x01, R_ALT, R_PRI);
+    break;
+  case OP_SUB:
+    emit_op_rr(c, 0x29, R_ALT, R_PRI);
+    break;
+  case OP_SUB_ALT:
+    emit_op_rr(c, 0xf7, 3, R_PRI);                      /* neg eax */
+    emit_op_rr(c, 0x01, R_ALT, R_PRI);
+    break;
+  case OP_AND:
+    emit_op_rr(c, 0x21, R_ALT, R_PRI);
+    break;
+  case OP_OR:
+    emit_op_rr(c, 0x09, R_ALT, R_PRI);
+    break;
+  case OP_XOR:
+    emit_op_rr(c, 0x31, R_ALT, R_PRI);
+    break;
+  case OP_NOT:
+    emit_op_rr(c, 0x85, R_PRI, R_PRI);
+    emit_setcc_pri(c, CC_E);
+    break;
+  case OP_NEG:
+    emit_op_rr(c, 0xf7, 3, R_PRI);
+    break;
+  case OP_INVERT:
+    emit_op_rr(c, 0xf7, 2, R_PRI);                      /* not eax */
+    break;
+  case OP_ADD_C:
+    emit_alu_imm(c, ALU_ADD, R_PRI, PARAM(1));
+    break;
+  case OP_SMUL_C:
+    emit_op_rr(c, 0x69, R_PRI, R_PRI);                  /* imul eax, eax, n */
+    emit32(c, (ucell)PARAM(1));
+    break;
+  case OP_ZERO_PRI:
+    emit_op_rr(c, 0x31, R_PRI, R_PRI);
+    break;
+  case OP_ZERO_ALT:
+    emit_op_rr(c, 0x31, R_ALT, R_ALT);
+    break;
+  case OP_ZERO:
+    emit_store_imm(c, R_DAT, R_NONE, PARAM(1), 0);
+    break;
+  case OP_ZERO_S:
+    emit_store_imm(c, R_DAT, R_FRM, PARAM(1), 0);
+    break;
+  case OP_SIGN_PRI:
+  case OP_SIGN_ALT: {
+    size_t skip;
+    emit8(c, 0xf6);                                     /* test al/cl, 0x80 */
+    emit8(c, 0xc0 | ((op==OP_SIGN_PRI) ? R_PRI : R_ALT));
+    emit8(c, 0x80);
+    skip=emit_short_jump(c, CC_E);
+    emit_alu_imm(c, ALU_OR, (op==OP_SIGN_PRI) ? R_PRI : R_ALT, ~(cell)0xff);
+    patch_short(c, skip);
+    break;
+  } /* case */
+  case OP_EQ:
+  case OP_NEQ:
+  case OP_LESS:
+  case OP_LEQ:
+  case OP_GRTR:
+  case OP_GEQ:
+  case OP_SLESS:
+  case OP_SLEQ:
+  case OP_SGRTR:
+  case OP_SGEQ: {
+    static const int cc[]={
+      CC_E, CC_NE, CC_B, CC_BE, CC_A, CC_AE, CC_L, CC_LE, CC_G, CC_GE
+    };
+    emit_op_rr(c, 0x39, R_ALT, R_PRI);                  /* cmp eax, ecx */
+    emit_setcc_pri(c, cc[op-OP_EQ]);
+    break;
+  } /* case */
+  case OP_EQ_C_PRI:
+  case OP_EQ_C_ALT:
+    emit_alu_imm(c, ALU_CMP, (op==OP_EQ_C_PRI) ? R_PRI : R_ALT, PARAM(1));
+    emit_setcc_pri(c, CC_E);
+    break;
+  case OP_INC_PRI:
+    emit8(c, 0x40+R_PRI);
+    break;
+  case OP_INC_ALT:
+    emit8(c, 0x40+R_ALT);
+    break;
+  case OP_INC:
+    emit_op_mem(c, 0xff, 0, R_DAT, R_NONE, PARAM(1));
+    break;
+  case OP_INC_S:
+    emit_op_mem(c, 0xff, 0, R_DAT, R_FRM, PARAM(1));
+    break;
+  case OP_INC_I:
+    emit_op_mem(c, 0xff, 0, R_DAT, R_PRI, 0);
+    break;
+  case OP_DEC_PRI:
+    emit8(c, 0x48+R_PRI);
+    break;
+  case OP_DEC_ALT:
+    emit8(c, 0x48+R_ALT);
+    break;
+  case OP_DEC:
+    emit_op_mem(c, 0xff, 1, R_DAT, R_NONE, PARAM(1));
+    break;
+  case OP_DEC_S:
+    emit_op_mem(c, 0xff, 1, R_DAT, R_FRM, PARAM(1));
+    break;
+  case OP_DEC_I:
+    emit_op_mem(c, 0xff, 1, R_DAT, R_PRI, 0);
+    break;
+  case OP_MOVS:
+    emit_call_helper(c, jit_movs, cip, R_NONE, PARAM(1));
+    break;
+  case OP_CMPS:
+    emit_call_helper(c, jit_cmps, cip, R_NONE, PARAM(1));
+    break;
+  case OP_FILL:
+    emit_call_helper(c, jit_fill, cip, R_NONE, PARAM(1));
+    break;
+  case OP_HALT:
+    /* after sleeping the program continues behind the instruction */
+    offs=(PARAM(1)==AMX_ERR_SLEEP) ? (cell)(cip+2*sizeof(cell)) : cip;
+    emit_store_imm(c, R_ST, R_NONE, ST(cip), offs);
+    emit_store_imm(c, R_ST, R_NONE, ST(error), PARAM(1));
+    emit_store_imm(c, R_ST, R_NONE, ST(halt), 1);
+    emit_jump_back(c, CC_ALWAYS, c->exit_full);
+    break;
+  case OP_BOUNDS:
+    emit_alu_imm(c, ALU_CMP, R_PRI, PARAM(1));
+    emit_trap(c, CC_A, cip, AMX_ERR_BOUNDS);
+    break;
+  case OP_SYSREQ_PRI:
+    emit_call_helper(c, jit_sysreq, cip+sizeof(cell), R_PRI, 0);
+    break;
+  case OP_SYSREQ_C:
+    emit_call_helper(c, jit_sysreq, cip+2*sizeof(cell), R_NONE, PARAM(1));
+    break;
+  case OP_SYSREQ_D:
+    emit_call_helper(c, jit_sysreq_d, cip+2*sizeof(cell), R_NONE, PARAM(1));
+    break;
+  case OP_FILE:
+  case OP_LINE:
+  case OP_SYMBOL:
+  case OP_SRANGE:
+  case OP_SYMTAG:
+  case OP_NOP:
+    break;
+  case OP_JUMP_PRI:
+    emit_long_call_check(c, cip);
+    emit_mov_rr(c, R_EDX, R_PRI);
+    emit_check_target(c, cip);
+    emit_jump_table(c);
+    break;
+  case OP_SWITCH:
+    /* the case table: CASETBL, number of records, default address and
+     * records of a value and an address */
+    offs=TARGET(1);
+    if (offs<0 || offs+3*(cell)sizeof(cell)>c->codesize
+        || c->opcodes[offs/sizeof(cell)]!=OP_CASETBL)
+      return 0;
+    table=(cell *)(c->code+(int)offs);
+    num=table[1];
+    if (num<0 || offs+(2*num+3)*(cell)sizeof(cell)>c->codesize)
+      return 0;
+    emit_long_call_check(c, cip);
+    for (i=0; i<num; i++) {
+      emit_alu_imm(c, ALU_CMP, R_PRI, table[3+2*i]);
+      emit_branch(c, CC_E, table[4+2*i]-(cell)c->code);
+    } /* for */
+    emit_branch(c, CC_ALWAYS, table[2]-(cell)c->code);
+    break;
+  case OP_CASETBL:
+    /* never executed */
+    emit_trap(c, CC_ALWAYS, cip, AMX_ERR_INVINSTR);
+    break;
+  case OP_SWAP_PRI:
+  case OP_SWAP_ALT: {
+    int reg=(op==OP_SWAP_PRI) ? R_PRI : R_ALT;
+    emit_load(c, R_EDX, R_DAT, R_STK, 0);
+    emit_store(c, reg, R_DAT, R_STK, 0);
+    emit_mov_rr(c, reg, R_EDX);
+    break;
+  } /* case */
+  case OP_PUSHADDR:
+    emit_lea(c, R_EDX, R_FRM, R_NONE, PARAM(1));
+    emit_push(c, R_EDX);
+    break;
+  case OP_BREAK: {
+    size_t skip;
+    emit_load(c, R_EDX, R_ST, R_NONE, ST(amx));
+    emit_alu_imm_mem(c, ALU_CMP, R_EDX, R_NONE, (cell)offsetof(AMX, debug), 0);
+    skip=emit_jump(c, CC_E);
+    emit_call_helper(c, jit_break, cip+sizeof(cell), R_NONE, 0);
+    patch_rel32(c, skip, c->size);
+    break;
+  } /* case */
+  default:
+    emit_trap(c, CC_ALWAYS, cip, AMX_ERR_INVINSTR);
+    break;
+  } /* switch */
+  return 1;
+}
+
+static void emit_stubs(JIT_COMPILER *c)
+{
+  JIT_STUB *stub;
+  int i;
+
+  for (i=0; i<c->num_stubs && c->error==AMX_ERR_NONE; i++) {
+    stub=&c->stubs[i];
+    add_pcmap(c, stub->cip);
+    patch_rel32(c, stub->jump, c->size);
+    switch (stub->kind) {
+    case STUB_TRAP:
+      emit_store_imm(c, R_ST, R_NONE, ST(cip), stub->cip);
+      emit_store_imm(c, R_ST, R_NONE, ST(error), stub->error);
+      emit_jump_back(c, CC_ALWAYS, c->exit_full);
+      break;
+    case STUB_LONG_CALL:
+      emit_spill(c);
+      emit_store_imm(c, R_ST, R_NONE, ST(cip), stub->cip);
+      emit_store(c, R_ST, R_ESP, R_NONE, 0);
+      emit_mov_imm(c, R_EDX, (cell)jit_long_call);
+      emit_op_rr(c, 0xff, 2, R_EDX);                    /* call edx */
+      emit_load(c, R_PRI, R_ST, R_NONE, ST(pri));
+      emit_load(c, R_ALT, R_ST, R_NONE, ST(alt));
+      emit_jump_back(c, CC_ALWAYS, stub->back);
+      break;
+    } /* switch */
+  } /* for */
+}
+
+static int resolve_fixups(JIT_COMPILER *c)
+{
+  JIT_FIXUP *fixup;
+  int i;
+
+  for (i=0; i<c->num_fixups; i++) {
+    fixup=&c->fixups[i];
+    if (fixup->target<0 || fixup->target>=c->codesize
+        || fixup->target%sizeof(cell)!=0
+        || c->offsets[fixup->target/sizeof(cell)]==0)
+      return 0;
+    patch_rel32(c, fixup->jump, c->offsets[fixup->target/sizeof(cell)]);
+  } /* for */
+  return 1;
+}
+
+static unsigned char *alloc_code(size_t size)
+{
+  #if defined __WIN32__ || defined _WIN32 || defined WIN32
+    return (unsigned char *)VirtualAlloc(NULL, size, MEM_COMMIT | MEM_RESERVE,
+                                         PAGE_READWRITE);
+  #else
+    void *p=mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS,
+                 -1, 0);
+    return (p!=MAP_FAILED) ? (unsigned char *)p : NULL;
+  #endif
+}
+
+static int protect_code(unsigned char *code, size_t size)
+{
+  #if defined __WIN32__ || defined _WIN32 || defined WIN32
+    DWORD prev;
+    return VirtualProtect(code, size, PAGE_EXECUTE_READ, &prev)!=0;
+  #else
+    return mprotect(code, size, PROT_READ | PROT_EXEC)==0;
+  #endif
+}
+
+static void free_code(unsigned char *code, size_t size)
+{
+  #if defined __WIN32__ || defined _WIN32 || defined WIN32
+    (void)size;
+    VirtualFree(code, 0, MEM_RELEASE);
+  #else
+    munmap(code, size);
+  #endif
+}
+
+int AMXAPI amx_JitCompile(AMX *amx, AMX_JIT **jit)
+{
+  JIT_COMPILER c;
+  AMX_HEADER *hdr;
+  AMX_JIT *result=NULL;
+  cell cip, ncells, i;
+  size_t body_size=0;
+  int num_body_pcmap=0;
+  int err;
+
+  assert(amx!=NULL);
+  assert(jit!=NULL);
+  *jit=NULL;
+  if ((amx->flags & AMX_FLAG_RELOC)==0)
+    return AMX_ERR_INIT;
+  hdr=(AMX_HEADER *)amx->base;
+  assert(hdr!=NULL);
+  assert(hdr->magic==AMX_MAGIC);
+
+  memset(&c, 0, sizeof c);
+  c.amx=amx;
+  c.code=amx->base+(int)hdr->cod;
+  c.codesize=hdr->dat-hdr->cod;
+  c.long_calls=(amx->flags & AMX_FLAG_NOLONGCALL)==0;
+  ncells=c.codesize/sizeof(cell);
+  c.opcodes=(unsigned char *)malloc((size_t)ncells+1);
+  c.offsets=(size_t *)calloc((size_t)ncells+1, sizeof(size_t));
+  c.targets=(void **)malloc(((size_t)ncells+1)*sizeof(void *));
+  if (c.opcodes==NULL || c.offsets==NULL || c.targets==NULL) {
+    err=AMX_ERR_MEMORY;
+    goto done;
+  } /* if */
+  if ((err=amx_DecodeOpcodes(amx, c.opcodes))!=AMX_ERR_NONE)
+    goto done;
+
+  emit_runtime(&c);
+  for (i=0; i<ncells && c.error==AMX_ERR_NONE; i++) {
+    if (c.opcodes[i]==OP_NONE)
+      continue;
+    cip=i*sizeof(cell);
+    c.offsets[i]=c.size;
+    add_pcmap(&c, cip);
+    if (!emit_instruction(&c, cip, c.opcodes[i])) {
+      err=AMX_ERR_INVINSTR;
+      goto done;
+    } /* if */
+    c.count++;
+  } /* for */
+  body_size=c.size;
+  num_body_pcmap=c.num_pcmap;
+  emit_stubs(&c);
+  if (c.error!=AMX_ERR_NONE) {
+    err=c.error;
+    goto done;
+  } /* if */
+  if (!resolve_fixups(&c)) {
+    err=AMX_ERR_INVINSTR;
+    goto done;
+  } /* if */
+
+  if ((result=(AMX_JIT *)calloc(1, sizeof(AMX_JIT)))==NULL
+      || (result->code=alloc_code(c.size))==NULL) {
+    err=AMX_ERR_MEMORY;
+    goto done;
+  } /* if */
+  result->code_size=c.size;
+  result->body_size=body_size;
+  memcpy(result->code, c.buf, c.size);
+  if (!protect_code(result->code, c.size)) {
+    err=AMX_ERR_INIT_JIT;
+    goto done;
+  } /* if */
+  for (i=0; i<ncells; i++) {
+    size_t offset=(c.offsets[i]!=0) ? c.offsets[i] : c.bad_target;
+    c.targets[i]=result->code+offset;
+  } /* for */
+  result->amx=amx;
+  result->targets=c.targets;
+  result->codesize=c.codesize;
+  result->pcmap=c.pcmap;
+  result->num_pcmap=c.num_pcmap;
+  result->num_body_pcmap=num_body_pcmap;
+  c.targets=NULL;
+  c.pcmap=NULL;
+  *jit=result;
+  result=NULL;
+  err=AMX_ERR_NONE;
+
+done:
+  if (result!=NULL) {
+    if (result->code!=NULL)
+      free_code(result->code, result->code_size);
+    free(result);
+  } /* if */
+  free(c.buf);
+  free(c.opcodes);
+  free(c.offsets);
+  free(c.targets);
+  free(c.fixups);
+  free(c.stubs);
+  free(c.pcmap);
+  return err;
+}
+
+/* the ABORT() macro of amx_Exec() */
+static int jit_abort(AMX *amx, JIT_STATE *st, cell *retval, int index,
+                     int error, cell reset_stk, cell reset_hea)
+{
+  amx->pri=st->pri;
+  amx->stk=st->stk;
+  amx->hea=st->hea;
+  amx->frm=st->frm;
+  amx->cip=st->cip;
+  amx_RaiseExecError(amx, index, retval, error);
+  amx->stk=reset_stk;
+  amx->hea=reset_hea;
+  return error;
+}
+
+int AMXAPI amx_JitExec(AMX_JIT *jit, cell *retval, int index)
+{
+  JIT_STATE st;
+  AMX *amx;
+  AMX_HEADER *hdr;
+  AMX_FUNCSTUB *func;
+  cell reset_stk, reset_hea;
+  int err;
+
+  assert(jit!=NULL);
+  amx=jit->amx;
+  if (amx->callback==NULL)
+    return AMX_ERR_CALLBACK;
+  if ((amx->flags & AMX_FLAG_NTVREG)==0)
+    return AMX_ERR_NOTFOUND;
+  if ((amx->flags & AMX_FLAG_RELOC)==0)
+    return AMX_ERR_INIT;
+
+  hdr=(AMX_HEADER *)amx->base;
+  memset(&st, 0, sizeof st);
+  st.amx=amx;
+  st.data=(amx->data!=NULL) ? amx->data : amx->base+(int)hdr->dat;
+  st.hea=amx->hea;
+  st.stk=amx->stk;
+  st.hlw=amx->hlw;
+  st.stp=amx->stp;
+  st.long_call_delay=LONG_CALL_CHECK_INTERVAL;
+  reset_stk=st.stk;
+  reset_hea=st.hea;
+
+  if (index==AMX_EXEC_MAIN) {
+    if (hdr->cip<0)
+      return AMX_ERR_INDEX;
+    st.cip=hdr->cip;
+  } else if (index==AMX_EXEC_CONT) {
+    st.frm=amx->frm;
+    st.pri=amx->pri;
+    st.alt=amx->alt;
+    reset_stk=amx->reset_stk;
+    reset_hea=amx->reset_hea;
+    st.cip=amx->cip;
+  } else if (index<0) {
+    return AMX_ERR_INDEX;
+  } else {
+    if (index>=(int)NUMENTRIES(hdr,publics,natives))
+      return AMX_ERR_INDEX;
+    func=GETENTRY(hdr,publics,index);
+    st.cip=func->address;
+  } /* if */
+  if (st.stk>amx->stp)
+    return jit_abort(amx, &st, retval, index, AMX_ERR_STACKLOW, reset_stk, reset_hea);
+  if (st.hea<amx->hlw)
+    return jit_abort(amx, &st, retval, index, AMX_ERR_HEAPLOW, reset_stk, reset_hea);
+
+  if (index!=AMX_EXEC_CONT) {
+    reset_stk+=amx->paramcount*sizeof(cell);
+    st.stk-=sizeof(cell);
+    *(cell *)(st.data+(int)st.stk)=amx->paramcount*sizeof(cell);
+    amx->paramcount=0;
+    st.stk-=sizeof(cell);
+    *(cell *)(st.data+(int)st.stk)=0;   /* zero return address */
+  } /* if */
+  if (st.hea+STKMARGIN>st.stk)
+    return jit_abort(amx, &st, retval, index, AMX_ERR_STACKERR, reset_stk, reset_hea);
+  if ((ucell)st.cip>=(ucell)jit->codesize || st.cip%sizeof(cell)!=0)
+    return jit_abort(amx, &st, retval, index, AMX_ERR_MEMACCESS, reset_stk, reset_hea);
+
+  amx_GetExtHooks(amx, &st.ext_hooks);
+  if (st.ext_hooks!=NULL) {
+    st.long_call_ctl=st.ext_hooks->long_call_ctl;
+    st.address_naught_ctl=st.ext_hooks->address_naught_ctl;
+  } /* if */
+  if (st.address_naught_ctl!=NULL)
+    st.address_naught=st.address_naught_ctl(amx, -1);
+
+  err=((JIT_ENTRY)(void *)jit->code)(&st, jit->targets[st.cip/sizeof(cell)]);
+
+  if (st.halt && retval!=NULL)
+    *retval=st.pri;
+  amx->alt=st.alt;
+  if (err==AMX_ERR_SLEEP) {
+    amx->pri=st.pri;
+    amx->stk=st.stk;
+    amx->hea=st.hea;
+    amx->frm=st.frm;
+    amx->cip=st.cip;
+    amx->reset_stk=reset_stk;
+    amx->reset_hea=reset_hea;
+    return err;
+  } /* if */
+  return jit_abort(amx, &st, retval, index, err, reset_stk, reset_hea);
+}
+
+int AMXAPI amx_JitFree(AMX_JIT *jit)
+{
+  if (jit!=NULL) {
+    free_code(jit->code, jit->code_size);
+    free(jit->targets);
+    free(jit->pcmap);
+    free(jit);
+  } /* if */
+  return AMX_ERR_NONE;
+}
+
+int AMXAPI amx_JitGetCip(AMX_JIT *jit, const void *address, cell *cip)
+{
+  const unsigned char *p=(const unsigned char *)address;
+  size_t offset;
+  int lo, hi, mid;
+
+  assert(jit!=NULL);
+  assert(cip!=NULL);
+  if (p<jit->code || p>=jit->code+jit->code_size)
+    return AMX_ERR_NOTFOUND;
+  offset=(size_t)(p-jit->code);
+  /* find the last entry that starts at or before the address */
+  lo=0;
+  hi=jit->num_pcmap;
+  while (lo<hi) {
+    mid=(lo+hi)/2;
+    if (jit->pcmap[mid].offset<=offset)
+      lo=mid+1;
+    else
+      hi=mid;
+  } /* while */
+  if (lo==0)
+    return AMX_ERR_NOTFOUND;    /* in the entry/exit code */
+  *cip=jit->pcmap[lo-1].cip;
+  return AMX_ERR_NONE;
+}
+
+int AMXAPI amx_JitGetAddress(AMX_JIT *jit, cell cip, void **address)
+{
+  int lo, hi, mid;
+
+  assert(jit!=NULL);
+  assert(address!=NULL);
+  if (cip==jit->codesize) {
+    *address=jit->code+jit->body_size;
+    return AMX_ERR_NONE;
+  } /* if */
+  /* the map starts with an entry for every instruction */
+  lo=0;
+  hi=jit->num_body_pcmap;
+  while (lo<hi) {
+    mid=(lo+hi)/2;
+    if (jit->pcmap[mid].cip<cip)
+      lo=mid+1;
+    else
+      hi=mid;
+  } /* while */
+  if (lo==jit->num_body_pcmap || jit->pcmap[lo].cip!=cip)
+    return AMX_ERR_NOTFOUND;
+  *address=jit->code+jit->pcmap[lo].offset;
+  return AMX_ERR_NONE;
+}
+
+int AMXAPI amx_JitGetCode(AMX_JIT *jit, void **code, size_t *size)
+{
+  assert(jit!=NULL);
+  if (code!=NULL)
+    *code=jit->code;
+  if (size!=NULL)
+    *size=jit->code_size;
+  return AMX_ERR_NONE;
+}
+
+#else
+
+int AMXAPI amx_JitCompile(AMX *amx, AMX_JIT **jit)
+{
+  (void)amx;
+  *jit=NULL;
+  return AMX_ERR_INIT_JIT;
+}
+
+int AMXAPI amx_JitExec(AMX_JIT *jit, cell *retval, int index)
+{
+  (void)jit;
+  (void)retval;
+  (void)index;
+  return AMX_ERR_INIT_JIT;
+}
+
+int AMXAPI amx_JitFree(AMX_JIT *jit)
+{
+  (void)jit;
+  return AMX_ERR_NONE;
+}
+
+int AMXAPI amx_JitGetCip(AMX_JIT *jit, const void *address, cell *cip)
+{
+  (void)jit;
+  (void)address;
+  (void)cip;
+  return AMX_ERR_NOTFOUND;
+}
+
+int AMXAPI amx_JitGetAddress(AMX_JIT *jit, cell cip, void **address)
+{
+  (void)jit;
+  (void)cip;
+  (void)address;
+  return AMX_ERR_NOTFOUND;
+}
+
+int AMXAPI amx_JitGetCode(AMX_JIT *jit, void **code, size_t *size)
+{
+  (void)jit;
+  if (code!=NULL)
+    *code=NULL;
+  if (size!=NULL)
+    *size=0;
+  return AMX_ERR_NONE;
+}
+
+#endif
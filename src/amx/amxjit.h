@@ -0,0 +1,66 @@
+/*  JIT compiler for the Pawn Abstract Machine (x86, 32-bit cells only)
+ *
+ *  The generated code behaves like the GNU C version of amx_Exec() with
+ *  AMX_FLAG_NOTRACKCIP: errors are reported through amx_RaiseExecError()
+ *  with CIP pointing at the failing instruction, natives and the debug hook
+ *  see the same state as in the interpreter, and the long call checks still
+ *  run (unless AMX_FLAG_NOLONGCALL is set). While the generated code runs,
+ *  FRM is kept in EBP and STK in EDI, and amx_JitGetCip() maps an address in
+ *  the generated code back to CIP, so a crash can still be traced back to
+ *  the script.
+ *
+ *  Copyright (c) 2026 Zeex
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef AMXJIT_H_INCLUDED
+#define AMXJIT_H_INCLUDED
+
+#include "amx.h"
+
+#ifdef  __cplusplus
+extern  "C" {
+#endif
+
+typedef struct tagAMX_JIT AMX_JIT;
+
+/* compiles relocated code, returns AMX_ERR_INIT_JIT if the JIT is not
+ * supported on this platform */
+int AMXAPI amx_JitCompile(AMX *amx, AMX_JIT **jit);
+/* the same as amx_Exec() for the AMX that the code was compiled for */
+int AMXAPI amx_JitExec(AMX_JIT *jit, cell *retval, int index);
+int AMXAPI amx_JitFree(AMX_JIT *jit);
+/* finds the instruction that an address in the generated code belongs to */
+int AMXAPI amx_JitGetCip(AMX_JIT *jit, const void *address, cell *cip);
+/* the reverse of amx_JitGetCip(): finds the generated code of an instruction,
+ * or the end of the generated instructions if cip is the size of the code */
+int AMXAPI amx_JitGetAddress(AMX_JIT *jit, cell cip, void **address);
+/* gets the whole block of generated code, including the runtime and stubs */
+int AMXAPI amx_JitGetCode(AMX_JIT *jit, void **code, size_t *size);
+
+#ifdef  __cplusplus
+}
+#endif
+
+#endif /* AMXJIT_H_INCLUDED */
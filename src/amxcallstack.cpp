@@ -22,9 +22,15 @@
 // ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
 // POSSIBILITY OF SUCH DAMAGE.
 
-#include <cassert>
 #include "amxcallstack.h"
 
+namespace {
+
+// Deep enough for practically any script; the array grows beyond that.
+const std::size_t kInitialCapacity = 256;
+
+} // anonymous namespace
+
 AMXCall::AMXCall(Type type, AMXRef amx, cell index)
  : amx_(amx),
    type_(type),
@@ -53,27 +59,6 @@ AMXCall AMXCall::Native(AMXRef amx, cell index) {
   return AMXCall(NATIVE, amx, index);
 }
 
-bool AMXCallStack::IsEmpty() const {
-  return call_stack_.empty();
-}
-
-AMXCall &AMXCallStack::Top() {
-  assert(!IsEmpty());
-  return call_stack_.top();
-}
-
-const AMXCall &AMXCallStack::Top() const {
-  assert(!IsEmpty());
-  return call_stack_.top();
-}
-
-void AMXCallStack::Push(AMXCall call) {
-  call_stack_.push(call);
-}
-
-AMXCall AMXCallStack::Pop() {
-  assert(!IsEmpty());
-  AMXCall result = call_stack_.top();
-  call_stack_.pop();
-  return result;
+AMXCallStack::AMXCallStack() {
+  calls_.reserve(kInitialCapacity);
 }
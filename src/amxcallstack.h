@@ -25,7 +25,8 @@
 #ifndef AMXCALLSTACK_H
 #define AMXCALLSTACK_H
 
-#include <stack>
+#include <cassert>
+#include <vector>
 #include "amxref.h"
 
 class AMXCall {
@@ -59,18 +60,43 @@ class AMXCall {
   cell index_;
 };
 
+// Calls are kept in a contiguous array that is allocated up front and only
+// grows if a script nests deeper than that. Push() and Pop() happen for
+// every native call so they are defined inline.
 class AMXCallStack {
  public:
-  bool IsEmpty() const;
+  typedef std::vector<AMXCall>::const_reverse_iterator const_iterator;
 
-  AMXCall &Top();
-  const AMXCall &Top() const;
+  AMXCallStack();
 
-  void Push(AMXCall call);
-  AMXCall Pop();
+  bool IsEmpty() const { return calls_.empty(); }
+  std::size_t Size() const { return calls_.size(); }
+
+  AMXCall &Top() {
+    assert(!IsEmpty());
+    return calls_.back();
+  }
+  const AMXCall &Top() const {
+    assert(!IsEmpty());
+    return calls_.back();
+  }
+
+  void Push(AMXCall call) {
+    calls_.push_back(call);
+  }
+  AMXCall Pop() {
+    assert(!IsEmpty());
+    AMXCall result = calls_.back();
+    calls_.pop_back();
+    return result;
+  }
+
+  // Iterate from the most recent call to the oldest one.
+  const_iterator begin() const { return calls_.rbegin(); }
+  const_iterator end() const { return calls_.rend(); }
 
  private:
-  std::stack<AMXCall> call_stack_;
+  std::vector<AMXCall> calls_;
 };
 
 #endif // !AMXCALLSTACK_H
@@ -22,84 +22,281 @@
 // ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
 // POSSIBILITY OF SUCH DAMAGE.
 
+#include <algorithm>
+#include <cstddef>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
 #include "amxdebuginfo.h"
+#include "workqueue.h"
 
 std::vector<AMXDebugInfo::SymbolDim> AMXDebugInfo::Symbol::GetDims() const {
   std::vector<AMXDebugSymbolDim> dims;
+  SymbolDimList dim_list = GetDimList();
+  for (std::size_t i = 0; i < dim_list.size(); ++i) {
+    dims.push_back(dim_list[i]);
+  }
+  return dims;
+}
+
+AMXDebugInfo::SymbolDimList AMXDebugInfo::Symbol::GetDimList() const {
   if ((IsArray() || IsArrayRef()) && GetNumDims() > 0) {
     const char *dimPtr = symbol_->name + std::strlen(symbol_->name) + 1;
-    for (int i = 0; i < GetNumDims(); ++i) {
-      SymbolDim dim(reinterpret_cast<const AMX_DBG_SYMDIM*>(dimPtr) + i);
-      dims.push_back(dim);
-    }
+    return SymbolDimList(reinterpret_cast<const AMX_DBG_SYMDIM*>(dimPtr),
+                         GetNumDims());
   }
-  return dims;
+  return SymbolDimList();
 }
 
 AMXDebugInfo::AMXDebugInfo()
-  : amxdbg_(nullptr)
+  : amxdbg_(nullptr),
+    deferred_mtime_(0),
+    deferred_use_mapping_(false),
+    deferred_use_index_file_(false),
+    deferred_level_(FULL),
+    loading_(false)
 {
 }
 
 AMXDebugInfo::AMXDebugInfo(const std::string &filename)
-  : amxdbg_(nullptr)
+  : amxdbg_(nullptr),
+    deferred_mtime_(0),
+    deferred_use_mapping_(false),
+    deferred_use_index_file_(false),
+    deferred_level_(FULL),
+    loading_(false)
 {
   Load(filename);
 }
 
 AMXDebugInfo::~AMXDebugInfo() {
+  WaitForLoad();
   Free();
 }
 
 bool AMXDebugInfo::IsLoaded() const {
+  if (loading_.load(std::memory_order_acquire)) {
+    const_cast<AMXDebugInfo*>(this)->WaitForLoad();
+  }
+  if (!deferred_filename_.empty()) {
+    // Loading is invisible to the users of this class apart from making
+    // the debug info available, so it's fine to do it here.
+    const_cast<AMXDebugInfo*>(this)->LoadIfDeferred();
+  }
   return amxdbg_ != nullptr;
 }
 
-void AMXDebugInfo::Load(const std::string &filename) {
-  std::FILE* fp = std::fopen(filename.c_str(), "rb");
-  if (fp != nullptr) {
-    AMX_DBG amxdbg;
-    if (dbg_LoadInfo(&amxdbg, fp) == AMX_ERR_NONE) {
+void AMXDebugInfo::Load(const std::string &filename,
+                        bool use_mapping,
+                        bool use_index_file,
+                        Level level) {
+  Free();
+
+  AMX_DBG amxdbg;
+  if (use_mapping && mapped_file_.Map(filename)) {
+    if (dbg_LoadInfoMem(&amxdbg,
+                        mapped_file_.data(),
+                        mapped_file_.size()) == AMX_ERR_NONE) {
       amxdbg_ = new AMX_DBG(amxdbg);
+    } else {
+      mapped_file_.Unmap();
+    }
+  }
+
+  if (amxdbg_ == nullptr) {
+    std::FILE* fp = std::fopen(filename.c_str(), "rb");
+    if (fp != nullptr) {
+      if (dbg_LoadInfo(&amxdbg, fp) == AMX_ERR_NONE) {
+        amxdbg_ = new AMX_DBG(amxdbg);
+      }
+      fclose(fp);
     }
-    fclose(fp);
+  }
+
+  if (amxdbg_ != nullptr) {
+    if (use_index_file && ReadIndexFile(filename)) {
+      BuildLookupTables();
+    } else {
+      BuildIndexes();
+      if (use_index_file) {
+        WriteIndexFile(filename);
+      }
+    }
+    Trim(level);
+  }
+}
+
+void AMXDebugInfo::LoadDeferred(const std::string &filename,
+                                bool use_mapping,
+                                bool use_index_file,
+                                Level level) {
+  Free();
+  deferred_filename_ = filename;
+  deferred_mtime_ = fileutils::GetModificationTime(filename);
+  deferred_use_mapping_ = use_mapping;
+  deferred_use_index_file_ = use_index_file;
+  deferred_level_ = level;
+}
+
+void AMXDebugInfo::LoadAsync(const std::string &filename,
+                             bool use_mapping,
+                             bool use_index_file,
+                             Level level) {
+  WaitForLoad();
+  Free();
+  std::lock_guard<std::mutex> lock(loading_mutex_);
+  loading_.store(true, std::memory_order_release);
+  loading_result_ = WorkQueue::shared().Submit(
+    [this, filename, use_mapping, use_index_file, level]() {
+      Load(filename, use_mapping, use_index_file, level);
+    });
+}
+
+void AMXDebugInfo::WaitForLoad() {
+  std::lock_guard<std::mutex> lock(loading_mutex_);
+  if (loading_result_.valid()) {
+    loading_result_.get();
+  }
+  loading_.store(false, std::memory_order_release);
+}
+
+void AMXDebugInfo::LoadIfDeferred() {
+  std::string filename;
+  filename.swap(deferred_filename_);
+  if (!filename.empty()
+      && fileutils::GetModificationTime(filename) == deferred_mtime_) {
+    Load(filename,
+         deferred_use_mapping_,
+         deferred_use_index_file_,
+         deferred_level_);
   }
 }
 
 void AMXDebugInfo::Free() {
-  if (amxdbg_ != nullptr) {
-    dbg_FreeInfo(amxdbg_);
-    delete amxdbg_;
+  deferred_filename_.clear();
+  FreeAMXDBG();
+  trimmed_data_.clear();
+  trimmed_files_.clear();
+  trimmed_symbols_.clear();
+  trimmed_tags_.clear();
+  trimmed_automata_.clear();
+  trimmed_states_.clear();
+  line_index_.clear();
+  file_addresses_.clear();
+  file_records_.clear();
+  names_.Clear();
+  function_starts_.clear();
+  function_ends_.clear();
+  function_symbols_.clear();
+  function_names_.clear();
+  bugged_functions_.clear();
+  argument_functions_.clear();
+  argument_offsets_.clear();
+  arguments_.clear();
+  argument_names_.clear();
+  tag_ids_.clear();
+  tag_records_.clear();
+  tag_names_.clear();
+  hash_indexes_.reset();
+}
+
+void AMXDebugInfo::FreeAMXDBG() {
+  if (amxdbg_ == nullptr) {
+    return;
+  }
+  // If the debug info has been trimmed, the tables are owned by this
+  // object and go away with it.
+  if (trimmed_data_.empty()) {
+    if (mapped_file_.IsMapped()) {
+      dbg_FreeInfoMem(amxdbg_);
+      mapped_file_.Unmap();
+    } else {
+      dbg_FreeInfo(amxdbg_);
+    }
+  }
+  delete amxdbg_;
+  amxdbg_ = nullptr;
+}
+
+void AMXDebugInfo::BuildIndexes() {
+  BuildLineIndex();
+  BuildFunctionIndex();
+  BuildArgumentIndex();
+  BuildNameIndex();
+  BuildLookupTables();
+}
+
+static bool CompareLineAddress(const AMX_DBG_LINE &lhs,
+                               const AMX_DBG_LINE &rhs) {
+  return static_cast<cell>(lhs.address) < static_cast<cell>(rhs.address);
+}
+
+static bool CompareAddressToLine(cell address, const AMX_DBG_LINE &line) {
+  return address < static_cast<cell>(line.address);
+}
+
+void AMXDebugInfo::BuildLineIndex() {
+  // Go through GetLines() rather than hdr->lines so that we get the same
+  // number of entries as the table itself (see the comment there).
+  LineTable lines = GetLines();
+  line_index_.clear();
+  line_index_.reserve(lines.size());
+  for (LineTable::const_iterator it = lines.begin(); it != lines.end(); ++it) {
+    AMX_DBG_LINE line;
+    line.address = it->GetAddress();
+    line.line = it->GetNumber();
+    line_index_.push_back(line);
   }
+  // Stable sort keeps entries with equal addresses in table order so that
+  // the last one wins, just like with the old reverse linear search.
+  std::stable_sort(line_index_.begin(), line_index_.end(), CompareLineAddress);
 }
 
 AMXDebugLine AMXDebugInfo::GetLine(cell address) const {
   Line line;
-  LineTable lines = GetLines();
-  for (LineTable::const_reverse_iterator it = lines.crbegin();
-       it != lines.crend(); ++it) {
-    if  (it->GetAddress() <= address) {
-      line = *it;
-      break;
-    }
+  std::vector<AMX_DBG_LINE>::const_iterator it =
+    std::upper_bound(line_index_.begin(),
+                     line_index_.end(),
+                     address,
+                     CompareAddressToLine);
+  if (it != line_index_.begin()) {
+    line = *--it;
   }
   return line;
 }
 
+int AMXDebugInfo::GetNumLines() const {
+  return static_cast<int>(line_index_.size());
+}
+
+int AMXDebugInfo::GetLineIndex(cell address) const {
+  std::vector<AMX_DBG_LINE>::const_iterator it =
+    std::upper_bound(line_index_.begin(),
+                     line_index_.end(),
+                     address,
+                     CompareAddressToLine);
+  if (it != line_index_.begin()) {
+    return static_cast<int>(it - line_index_.begin()) - 1;
+  }
+  return -1;
+}
+
+AMXDebugLine AMXDebugInfo::GetLineByIndex(int index) const {
+  if (index >= 0 && index < static_cast<int>(line_index_.size())) {
+    return Line(line_index_[index]);
+  }
+  return Line();
+}
+
 AMXDebugFile AMXDebugInfo::GetFile(cell address) const {
-  File file;
-  FileTable files = GetFiles();
-  for (FileTable::const_reverse_iterator it = files.crbegin();
-       it != files.crend(); ++it) {
-    if  (it->GetAddress() <= address) {
-      file = *it;
-      break;
-    }
+  // Of several files starting at the same address the last one wins, as it
+  // did with linear search from the end of the table.
+  std::vector<cell>::const_iterator it =
+    std::upper_bound(file_addresses_.begin(), file_addresses_.end(), address);
+  if (it != file_addresses_.begin()) {
+    return File(file_records_[it - file_addresses_.begin() - 1]);
   }
-  return file;
+  return File();
 }
 
 static bool IsBuggedForward(const AMX_DBG_SYMBOL *symbol) {
@@ -109,83 +306,265 @@ static bool IsBuggedForward(const AMX_DBG_SYMBOL *symbol) {
   return (symbol->name[0] == '@');
 }
 
-AMXDebugSymbol AMXDebugInfo::GetFunction(
-  cell address, bool ignoreBrokenSymbols) const
-{
-  Symbol function;
+template<typename Range>
+static bool CompareCodeStart(const Range &lhs, const Range &rhs) {
+  return lhs.code_start < rhs.code_start;
+}
+
+void AMXDebugInfo::BuildFunctionIndex() {
+  function_starts_.clear();
+  function_ends_.clear();
+  function_symbols_.clear();
+  bugged_functions_.clear();
+
+  std::vector<FunctionRange> functions;
   SymbolTable symbols = GetSymbols();
   for (SymbolTable::const_iterator it = symbols.begin();
        it != symbols.end(); ++it) {
-    if (!it->IsFunction())
-      continue;
-    if (it->GetCodeStart() > address || it->GetCodeEnd() <= address)
+    if (!it->IsFunction()) {
       continue;
-    if (ignoreBrokenSymbols && IsBuggedForward(it->GetPOD())) 
-      continue;
-    function = *it;
-    break;
+    }
+    FunctionRange range;
+    range.code_start = it->GetCodeStart();
+    range.code_end = it->GetCodeEnd();
+    range.symbol = it->GetPOD();
+    if (IsBuggedForward(range.symbol)) {
+      bugged_functions_.push_back(range);
+    } else {
+      functions.push_back(range);
+    }
+  }
+
+  // Functions sharing the same start address stay in symbol table order,
+  // so lookups still return the first matching symbol.
+  std::stable_sort(functions.begin(),
+                   functions.end(),
+                   CompareCodeStart<FunctionRange>);
+
+  function_starts_.reserve(functions.size());
+  function_ends_.reserve(functions.size());
+  function_symbols_.reserve(functions.size());
+  for (std::size_t i = 0; i < functions.size(); i++) {
+    function_starts_.push_back(functions[i].code_start);
+    function_ends_.push_back(functions[i].code_end);
+    function_symbols_.push_back(functions[i].symbol);
   }
-  return function;
+}
+
+// Returns the index of the function containing the address, or -1.
+static int FindFunction(const std::vector<cell> &starts,
+                        const std::vector<cell> &ends,
+                        cell address) {
+  std::vector<cell>::const_iterator it =
+    std::upper_bound(starts.begin(), starts.end(), address);
+  if (it != starts.begin()) {
+    cell code_start = *--it;
+    for (it = std::lower_bound(starts.begin(), it, code_start);
+         it != starts.end() && *it == code_start; ++it) {
+      if (ends[it - starts.begin()] > address) {
+        return static_cast<int>(it - starts.begin());
+      }
+    }
+  }
+  return -1;
+}
+
+AMXDebugSymbol AMXDebugInfo::GetFunction(
+  cell address, bool ignoreBrokenSymbols) const
+{
+  int index = FindFunction(function_starts_, function_ends_, address);
+  if (index >= 0) {
+    return Symbol(function_symbols_[index]);
+  }
+  if (!ignoreBrokenSymbols) {
+    for (std::vector<FunctionRange>::const_iterator it =
+           bugged_functions_.begin();
+         it != bugged_functions_.end(); ++it) {
+      if (it->code_start <= address && it->code_end > address) {
+        return Symbol(it->symbol);
+      }
+    }
+  }
+  return Symbol();
 }
 
 AMXDebugSymbol AMXDebugInfo::GetExactFunction(
   cell address, bool ignoreBrokenSymbols) const
 {
-  Symbol function;
-  SymbolTable symbols = GetSymbols();
-  for (SymbolTable::const_iterator it = symbols.begin();
-       it != symbols.end(); ++it) {
-    if (!it->IsFunction())
-      continue;
-    if (ignoreBrokenSymbols && IsBuggedForward(it->GetPOD())) 
-      continue;
-    if (it->GetCodeStart() == address) {
-      function = *it;
-      break;
+  int index = GetFunctionIndex(address);
+  if (index >= 0) {
+    return Symbol(function_symbols_[index]);
+  }
+  if (!ignoreBrokenSymbols) {
+    for (std::vector<FunctionRange>::const_iterator it =
+           bugged_functions_.begin();
+         it != bugged_functions_.end(); ++it) {
+      if (it->code_start == address) {
+        return Symbol(it->symbol);
+      }
     }
   }
-  return function;
+  return Symbol();
 }
 
-AMXDebugTag AMXDebugInfo::GetTag(int32_t tag_id) const {
-  Tag tag;
+int AMXDebugInfo::GetNumFunctions() const {
+  return static_cast<int>(function_starts_.size());
+}
+
+int AMXDebugInfo::GetFunctionIndex(cell address) const {
+  std::vector<cell>::const_iterator it =
+    std::lower_bound(function_starts_.begin(), function_starts_.end(),
+                     address);
+  if (it != function_starts_.end() && *it == address) {
+    return static_cast<int>(it - function_starts_.begin());
+  }
+  return -1;
+}
+
+AMXDebugSymbol AMXDebugInfo::GetFunctionByIndex(int index) const {
+  if (index >= 0 && index < static_cast<int>(function_symbols_.size())) {
+    return Symbol(function_symbols_[index]);
+  }
+  return Symbol();
+}
+
+void AMXDebugInfo::BuildNameIndex() {
+  names_.Clear();
+  function_names_.clear();
+  function_names_.reserve(function_symbols_.size());
+  for (std::size_t i = 0; i < function_symbols_.size(); i++) {
+    function_names_.push_back(names_.Intern(function_symbols_[i]->name));
+  }
+  argument_names_.clear();
+  argument_names_.reserve(arguments_.size());
+  for (std::size_t i = 0; i < arguments_.size(); i++) {
+    argument_names_.push_back(names_.Intern(arguments_[i].GetNamePtr()));
+  }
+}
+
+static uint32_t MakeStateKey(int16_t automaton_id, int16_t state_id) {
+  return (static_cast<uint32_t>(static_cast<uint16_t>(automaton_id)) << 16)
+         | static_cast<uint16_t>(state_id);
+}
+
+void AMXDebugInfo::BuildLookupTables() {
+  // This is redone after Trim(), which moves the file records.
+  FileTable files = GetFiles();
+  std::vector<std::pair<cell, const AMX_DBG_FILE*>> sorted_files;
+  sorted_files.reserve(files.size());
+  for (std::size_t i = 0; i < files.size(); i++) {
+    const AMX_DBG_FILE *file = amxdbg_->filetbl[i];
+    sorted_files.push_back(std::make_pair(static_cast<cell>(file->address),
+                                          file));
+  }
+  std::stable_sort(sorted_files.begin(), sorted_files.end(),
+                   [](const std::pair<cell, const AMX_DBG_FILE*> &lhs,
+                      const std::pair<cell, const AMX_DBG_FILE*> &rhs) {
+                     return lhs.first < rhs.first;
+                   });
+  file_addresses_.clear();
+  file_records_.clear();
+  file_addresses_.reserve(sorted_files.size());
+  file_records_.reserve(sorted_files.size());
+  for (std::size_t i = 0; i < sorted_files.size(); i++) {
+    file_addresses_.push_back(sorted_files[i].first);
+    file_records_.push_back(sorted_files[i].second);
+  }
+
+  // If there are duplicate IDs the first one wins like it did with linear
+  // search, hence the stable sort.
   TagTable tags = GetTags();
-  for (TagTable::const_iterator it = tags.begin();
-       it != tags.end(); ++it) {
-    if (it->GetID() == tag_id) {
-      tag = *it;
-      break;
+  std::vector<std::pair<int32_t, const AMX_DBG_TAG*>> sorted_tags;
+  sorted_tags.reserve(tags.size());
+  for (std::size_t i = 0; i < tags.size(); i++) {
+    const AMX_DBG_TAG *tag = amxdbg_->tagtbl[i];
+    sorted_tags.push_back(std::make_pair(static_cast<int32_t>(tag->tag), tag));
+  }
+  std::stable_sort(sorted_tags.begin(), sorted_tags.end(),
+                   [](const std::pair<int32_t, const AMX_DBG_TAG*> &lhs,
+                      const std::pair<int32_t, const AMX_DBG_TAG*> &rhs) {
+                     return lhs.first < rhs.first;
+                   });
+  tag_ids_.clear();
+  tag_records_.clear();
+  tag_names_.clear();
+  for (std::size_t i = 0; i < sorted_tags.size(); i++) {
+    if (!tag_ids_.empty() && tag_ids_.back() == sorted_tags[i].first) {
+      continue;
     }
+    tag_ids_.push_back(sorted_tags[i].first);
+    tag_records_.push_back(sorted_tags[i].second);
+    tag_names_.push_back(names_.Intern(sorted_tags[i].second->name));
+  }
+  // Tags are the last names to be added.
+  names_.Compact();
+
+  // Most scripts don't use states at all.
+  AutomatonTable automata = GetAutomata();
+  StateTable states = GetStates();
+  hash_indexes_.reset();
+  if (automata.size() == 0 && states.size() == 0) {
+    return;
+  }
+  hash_indexes_.reset(new HashIndexes);
+
+  hash_indexes_->automata.reserve(automata.size());
+  for (std::size_t i = 0; i < automata.size(); i++) {
+    const AMX_DBG_MACHINE *automaton = amxdbg_->automatontbl[i];
+    hash_indexes_->automata.emplace(automaton->address, automaton);
+  }
+
+  hash_indexes_->states.reserve(states.size());
+  for (std::size_t i = 0; i < states.size(); i++) {
+    const AMX_DBG_STATE *state = amxdbg_->statetbl[i];
+    hash_indexes_->states.emplace(
+      MakeStateKey(state->automaton, state->state),
+      state);
   }
-  return tag;
+}
+
+// Returns the position of the tag in tag_ids, or -1.
+static int FindTag(const std::vector<int32_t> &tag_ids, int32_t tag_id) {
+  std::vector<int32_t>::const_iterator it =
+    std::lower_bound(tag_ids.begin(), tag_ids.end(), tag_id);
+  if (it != tag_ids.end() && *it == tag_id) {
+    return static_cast<int>(it - tag_ids.begin());
+  }
+  return -1;
+}
+
+AMXDebugTag AMXDebugInfo::GetTag(int32_t tag_id) const {
+  int index = FindTag(tag_ids_, tag_id);
+  if (index >= 0) {
+    return Tag(tag_records_[index]);
+  }
+  return Tag();
 }
 
 AMXDebugAutomaton AMXDebugInfo::GetAutomaton(cell address) const {
-  Automaton automaton;
-  AutomatonTable automata = GetAutomata();
-  for (AutomatonTable::const_iterator it = automata.begin();
-       it != automata.end(); ++it) {
-    if (it->GetAddress() == address) {
-      automaton = *it;
-      break;
-    }
+  if (hash_indexes_ == nullptr) {
+    return Automaton();
+  }
+  ArenaHashMap<cell, const AMX_DBG_MACHINE*>::const_iterator it =
+    hash_indexes_->automata.find(address);
+  if (it != hash_indexes_->automata.end()) {
+    return Automaton(it->second);
   }
-  return automaton;
+  return Automaton();
 }
 
 AMXDebugState AMXDebugInfo::GetState(
   int16_t automaton_id, int16_t state_id) const
 {
-  State state;
-  StateTable states = GetStates();
-  for (StateTable::const_iterator it = states.begin();
-       it != states.end(); ++it) {
-    if (it->GetAutomaton() == automaton_id && it->GetID() == state_id) {
-      state = *it;
-      break;
-    }
+  if (hash_indexes_ == nullptr) {
+    return State();
   }
-  return state;
+  ArenaHashMap<uint32_t, const AMX_DBG_STATE*>::const_iterator it =
+    hash_indexes_->states.find(MakeStateKey(automaton_id, state_id));
+  if (it != hash_indexes_->states.end()) {
+    return State(it->second);
+  }
+  return State();
 }
 
 int32_t AMXDebugInfo::GetLineNumber(cell address) const {
@@ -205,22 +584,36 @@ std::string AMXDebugInfo::GetFileName(cell address) const {
   return name;
 }
 
+const char *AMXDebugInfo::GetFileNamePtr(cell address) const {
+  File file = GetFile(address);
+  if (file) {
+    return file.GetNamePtr();
+  }
+  return "";
+}
+
 std::string AMXDebugInfo::GetFunctionName(cell address) const {
-  std::string name;
-  Symbol function = GetFunction(address);
-  if (function) {
-    name = function.GetName();
+  return GetFunctionNamePtr(address);
+}
+
+const char *AMXDebugInfo::GetFunctionNamePtr(cell address) const {
+  int index = FindFunction(function_starts_, function_ends_, address);
+  if (index >= 0) {
+    return names_.Get(function_names_[index]);
   }
-  return name;
+  return "";
 }
 
 std::string AMXDebugInfo::GetTagName(int32_t tag_id) const {
-  std::string name;
-  Tag tag = GetTag(tag_id);
-  if (tag) {
-    name = tag.GetName();
+  return GetTagNamePtr(tag_id);
+}
+
+const char *AMXDebugInfo::GetTagNamePtr(int32_t tag_id) const {
+  int index = FindTag(tag_ids_, tag_id);
+  if (index >= 0) {
+    return names_.Get(tag_names_[index]);
   }
-  return name;
+  return "";
 }
 
 cell AMXDebugInfo::GetFunctionAddress(const std::string &func,
@@ -236,6 +629,477 @@ cell AMXDebugInfo::GetLineAddress(long line, const std::string &file) const {
   return static_cast<cell>(address);
 }
 
+void AMXDebugInfo::BuildArgumentIndex() {
+  argument_functions_.clear();
+  argument_offsets_.clear();
+  arguments_.clear();
+
+  // Function arguments are local symbols whose scope starts at the very
+  // beginning of the function.
+  SymbolTable symbols = GetSymbols();
+  for (SymbolTable::const_iterator it = symbols.begin();
+       it != symbols.end(); ++it) {
+    if (it->IsLocal()) {
+      arguments_.push_back(*it);
+    }
+  }
+  // Group them by function, then by their position in the stack frame.
+  std::stable_sort(arguments_.begin(), arguments_.end(),
+                   [](const Symbol &lhs, const Symbol &rhs) {
+                     if (lhs.GetCodeStart() != rhs.GetCodeStart()) {
+                       return lhs.GetCodeStart() < rhs.GetCodeStart();
+                     }
+                     return lhs < rhs;
+                   });
+  for (std::size_t i = 0; i < arguments_.size(); i++) {
+    cell code_start = arguments_[i].GetCodeStart();
+    if (argument_functions_.empty()
+        || argument_functions_.back() != code_start) {
+      argument_functions_.push_back(code_start);
+      argument_offsets_.push_back(static_cast<uint32_t>(i));
+    }
+  }
+  argument_offsets_.push_back(static_cast<uint32_t>(arguments_.size()));
+}
+
+AMXDebugSymbolList AMXDebugInfo::GetArguments(cell function_address) const {
+  std::vector<cell>::const_iterator it =
+    std::lower_bound(argument_functions_.begin(),
+                     argument_functions_.end(),
+                     function_address);
+  if (it != argument_functions_.end() && *it == function_address) {
+    std::size_t group = it - argument_functions_.begin();
+    uint32_t first = argument_offsets_[group];
+    return SymbolList(arguments_.data() + first,
+                      argument_offsets_[group + 1] - first);
+  }
+  return SymbolList();
+}
+
+template<typename Record>
+static std::size_t GetRecordSize(const Record *record) {
+  return offsetof(Record, name) + std::strlen(record->name) + 1;
+}
+
+static std::size_t GetSymbolSize(const AMX_DBG_SYMBOL *symbol) {
+  // The dimensions follow the name (see Symbol::GetDimList()).
+  return GetRecordSize(symbol) + symbol->dim * sizeof(AMX_DBG_SYMDIM);
+}
+
+// Copies a record to the end of data and returns the copy. data must have
+// enough room reserved so that earlier copies stay where they are.
+template<typename Record>
+static Record *CopyRecord(std::vector<unsigned char> &data,
+                          const Record *record,
+                          std::size_t size) {
+  const unsigned char *bytes = reinterpret_cast<const unsigned char*>(record);
+  assert(data.size() + size <= data.capacity());
+  data.insert(data.end(), bytes, bytes + size);
+  return reinterpret_cast<Record*>(&data[data.size() - size]);
+}
+
+template<typename Record>
+static void CopyTable(std::vector<unsigned char> &data,
+                      Record **table,
+                      std::size_t size,
+                      std::vector<Record*> &copies) {
+  copies.reserve(size);
+  for (std::size_t i = 0; i < size; i++) {
+    copies.push_back(CopyRecord(data, table[i], GetRecordSize(table[i])));
+  }
+}
+
+void AMXDebugInfo::Trim(Level level) {
+  if (level == FULL) {
+    return;
+  }
+
+  // Arguments are at positive offsets from the frame, locals of the
+  // function's outermost block (if they ever end up here) at negative.
+  std::vector<cell> argument_functions;
+  std::vector<uint32_t> argument_offsets;
+  std::vector<Symbol> arguments;
+  for (std::size_t i = 0; i < argument_functions_.size(); i++) {
+    uint32_t first = static_cast<uint32_t>(arguments.size());
+    for (uint32_t j = argument_offsets_[i]; j < argument_offsets_[i + 1];
+         j++) {
+      if (level == ARGUMENTS && arguments_[j].GetAddress() > 0) {
+        arguments.push_back(arguments_[j]);
+      }
+    }
+    if (arguments.size() > first) {
+      argument_functions.push_back(argument_functions_[i]);
+      argument_offsets.push_back(first);
+    }
+  }
+  argument_offsets.push_back(static_cast<uint32_t>(arguments.size()));
+  argument_functions_.swap(argument_functions);
+  argument_offsets_.swap(argument_offsets);
+  arguments_.swap(arguments);
+
+  // The symbols that the indexes refer to, in symbol table order.
+  std::vector<const AMX_DBG_SYMBOL*> symbols(function_symbols_);
+  for (std::size_t i = 0; i < bugged_functions_.size(); i++) {
+    symbols.push_back(bugged_functions_[i].symbol);
+  }
+  for (std::size_t i = 0; i < arguments_.size(); i++) {
+    symbols.push_back(arguments_[i].GetPOD());
+  }
+  std::sort(symbols.begin(), symbols.end());
+  symbols.erase(std::unique(symbols.begin(), symbols.end()), symbols.end());
+
+  const AMX_DBG_HDR *hdr = amxdbg_->hdr;
+  std::size_t size = sizeof(AMX_DBG_HDR);
+  for (std::size_t i = 0; i < symbols.size(); i++) {
+    size += GetSymbolSize(symbols[i]);
+  }
+  for (std::size_t i = 0; i < hdr->files; i++) {
+    size += GetRecordSize(amxdbg_->filetbl[i]);
+  }
+  for (std::size_t i = 0; i < hdr->tags; i++) {
+    size += GetRecordSize(amxdbg_->tagtbl[i]);
+  }
+  for (std::size_t i = 0; i < hdr->automatons; i++) {
+    size += GetRecordSize(amxdbg_->automatontbl[i]);
+  }
+  for (std::size_t i = 0; i < hdr->states; i++) {
+    size += GetRecordSize(amxdbg_->statetbl[i]);
+  }
+
+  std::vector<unsigned char> data;
+  data.reserve(size);
+  AMX_DBG_HDR *new_hdr = CopyRecord(data, hdr, sizeof(AMX_DBG_HDR));
+  new_hdr->symbols = static_cast<uint16_t>(symbols.size());
+  // Same as in the file, the count may have overflowed (see GetLines()).
+  new_hdr->lines = static_cast<uint16_t>(line_index_.size());
+
+  std::vector<AMX_DBG_SYMBOL*> new_symbols;
+  // Only needed while the copies are made, like symbol_numbers in
+  // WriteIndexFile().
+  Arena arena;
+  ArenaHashMap<const AMX_DBG_SYMBOL*, const AMX_DBG_SYMBOL*> copies(arena);
+  new_symbols.reserve(symbols.size());
+  copies.reserve(symbols.size());
+  for (std::size_t i = 0; i < symbols.size(); i++) {
+    AMX_DBG_SYMBOL *copy =
+      CopyRecord(data, symbols[i], GetSymbolSize(symbols[i]));
+    new_symbols.push_back(copy);
+    copies.emplace(symbols[i], copy);
+  }
+
+  std::vector<AMX_DBG_FILE*> new_files;
+  std::vector<AMX_DBG_TAG*> new_tags;
+  std::vector<AMX_DBG_MACHINE*> new_automata;
+  std::vector<AMX_DBG_STATE*> new_states;
+  CopyTable(data, amxdbg_->filetbl, hdr->files, new_files);
+  CopyTable(data, amxdbg_->tagtbl, hdr->tags, new_tags);
+  CopyTable(data, amxdbg_->automatontbl, hdr->automatons, new_automata);
+  CopyTable(data, amxdbg_->statetbl, hdr->states, new_states);
+
+  // This frees (or unmaps) the file's copy, so that only the indexes and
+  // the records copied above remain.
+  FreeAMXDBG();
+
+  trimmed_data_.swap(data);
+  trimmed_files_.swap(new_files);
+  trimmed_symbols_.swap(new_symbols);
+  trimmed_tags_.swap(new_tags);
+  trimmed_automata_.swap(new_automata);
+  trimmed_states_.swap(new_states);
+
+  amxdbg_ = new AMX_DBG;
+  amxdbg_->hdr = new_hdr;
+  amxdbg_->filetbl = trimmed_files_.data();
+  amxdbg_->linetbl = line_index_.data();
+  amxdbg_->symboltbl = trimmed_symbols_.data();
+  amxdbg_->tagtbl = trimmed_tags_.data();
+  amxdbg_->automatontbl = trimmed_automata_.data();
+  amxdbg_->statetbl = trimmed_states_.data();
+
+  for (std::size_t i = 0; i < function_symbols_.size(); i++) {
+    function_symbols_[i] = copies[function_symbols_[i]];
+  }
+  for (std::size_t i = 0; i < bugged_functions_.size(); i++) {
+    bugged_functions_[i].symbol = copies[bugged_functions_[i].symbol];
+  }
+  for (std::size_t i = 0; i < arguments_.size(); i++) {
+    arguments_[i] = Symbol(copies[arguments_[i].GetPOD()]);
+  }
+  // Start over with a new pool so that the names of the dropped symbols
+  // don't stay around.
+  BuildNameIndex();
+  BuildLookupTables();
+}
+
+// Index file layout: IndexFileHeader followed by the line index, the
+// function index, bugged functions, argument groups, argument symbols and
+// the name pool. Symbols are stored as indexes into the symbol table of the
+// .amx itself, names as IDs in the pool.
+
+static const char kIndexFileMagic[4] = {'C', 'D', 'I', 'X'};
+static const uint16_t kIndexFileVersion = 2;
+
+struct IndexFileHeader {
+  char magic[4];
+  uint16_t version;
+  uint16_t cell_size;
+  int64_t amx_mtime;
+  uint64_t amx_size;
+  uint32_t num_symbols;
+  uint32_t num_lines;
+  uint32_t num_functions;
+  uint32_t num_bugged_functions;
+  uint32_t num_argument_groups;
+  uint32_t num_arguments;
+  uint32_t names_size;
+};
+
+struct IndexFileFunction {
+  cell code_start;
+  cell code_end;
+  uint32_t symbol;
+  uint32_t name;
+};
+
+struct IndexFileArgumentGroup {
+  cell code_start;
+  uint32_t first_argument;
+  uint32_t num_arguments;
+};
+
+struct IndexFileArgument {
+  uint32_t symbol;
+  uint32_t name;
+};
+
+template<typename T>
+static const T *ReadIndexFileArray(const unsigned char *&ptr,
+                                   const unsigned char *end,
+                                   std::size_t count) {
+  const T *array = reinterpret_cast<const T*>(ptr);
+  if (static_cast<std::size_t>(end - ptr) / sizeof(T) < count) {
+    return nullptr;
+  }
+  ptr += count * sizeof(T);
+  return array;
+}
+
+template<typename T>
+static bool WriteIndexFileArray(std::FILE *fp, const T *array,
+                                std::size_t count) {
+  return count == 0 || std::fwrite(array, sizeof(T), count, fp) == count;
+}
+
+bool AMXDebugInfo::ReadIndexFile(const std::string &filename) {
+  fileutils::MappedFile index_file;
+  if (!index_file.Map(GetIndexFileName(filename))) {
+    return false;
+  }
+
+  const unsigned char *ptr =
+    static_cast<const unsigned char*>(index_file.data());
+  const unsigned char *end = ptr + index_file.size();
+
+  const IndexFileHeader *header =
+    ReadIndexFileArray<IndexFileHeader>(ptr, end, 1);
+  if (header == nullptr
+      || std::memcmp(header->magic, kIndexFileMagic, sizeof(header->magic)) != 0
+      || header->version != kIndexFileVersion
+      || header->cell_size != sizeof(cell)
+      || header->amx_mtime != fileutils::GetModificationTime(filename)
+      || header->amx_size != fileutils::GetFileSize(filename)
+      || header->num_symbols != static_cast<uint32_t>(amxdbg_->hdr->symbols)
+      || header->num_lines != GetLines().size()) {
+    return false;
+  }
+
+  const AMX_DBG_LINE *lines =
+    ReadIndexFileArray<AMX_DBG_LINE>(ptr, end, header->num_lines);
+  const IndexFileFunction *functions =
+    ReadIndexFileArray<IndexFileFunction>(ptr, end, header->num_functions);
+  const IndexFileFunction *bugged_functions =
+    ReadIndexFileArray<IndexFileFunction>(ptr, end,
+                                          header->num_bugged_functions);
+  const IndexFileArgumentGroup *argument_groups =
+    ReadIndexFileArray<IndexFileArgumentGroup>(ptr, end,
+                                               header->num_argument_groups);
+  const IndexFileArgument *arguments =
+    ReadIndexFileArray<IndexFileArgument>(ptr, end, header->num_arguments);
+  const char *names =
+    ReadIndexFileArray<char>(ptr, end, header->names_size);
+  if (lines == nullptr
+      || functions == nullptr
+      || bugged_functions == nullptr
+      || argument_groups == nullptr
+      || arguments == nullptr
+      || names == nullptr
+      || ptr != end
+      || !names_.Assign(names, header->names_size)) {
+    return false;
+  }
+
+  line_index_.assign(lines, lines + header->num_lines);
+
+  function_starts_.resize(header->num_functions);
+  function_ends_.resize(header->num_functions);
+  function_symbols_.resize(header->num_functions);
+  function_names_.resize(header->num_functions);
+  for (uint32_t i = 0; i < header->num_functions; i++) {
+    if (functions[i].symbol >= header->num_symbols
+        || !names_.IsValidID(functions[i].name)) {
+      return false;
+    }
+    function_starts_[i] = functions[i].code_start;
+    function_ends_[i] = functions[i].code_end;
+    function_symbols_[i] = amxdbg_->symboltbl[functions[i].symbol];
+    function_names_[i] = functions[i].name;
+  }
+
+  bugged_functions_.resize(header->num_bugged_functions);
+  for (uint32_t i = 0; i < header->num_bugged_functions; i++) {
+    if (bugged_functions[i].symbol >= header->num_symbols) {
+      return false;
+    }
+    bugged_functions_[i].code_start = bugged_functions[i].code_start;
+    bugged_functions_[i].code_end = bugged_functions[i].code_end;
+    bugged_functions_[i].symbol =
+      amxdbg_->symboltbl[bugged_functions[i].symbol];
+  }
+
+  // Groups are stored in the same order as in memory, one after another.
+  argument_functions_.clear();
+  argument_offsets_.clear();
+  arguments_.clear();
+  argument_names_.clear();
+  argument_functions_.reserve(header->num_argument_groups);
+  argument_offsets_.reserve(header->num_argument_groups + 1);
+  for (uint32_t i = 0; i < header->num_argument_groups; i++) {
+    const IndexFileArgumentGroup &group = argument_groups[i];
+    if (group.first_argument != arguments_.size()
+        || header->num_arguments - group.first_argument
+           < group.num_arguments
+        || (i > 0 && argument_functions_.back() >= group.code_start)) {
+      return false;
+    }
+    argument_functions_.push_back(group.code_start);
+    argument_offsets_.push_back(group.first_argument);
+    for (uint32_t j = 0; j < group.num_arguments; j++) {
+      const IndexFileArgument &arg = arguments[group.first_argument + j];
+      if (arg.symbol >= header->num_symbols
+          || !names_.IsValidID(arg.name)) {
+        return false;
+      }
+      arguments_.push_back(Symbol(amxdbg_->symboltbl[arg.symbol]));
+      argument_names_.push_back(arg.name);
+    }
+  }
+  if (arguments_.size() != header->num_arguments) {
+    return false;
+  }
+  argument_offsets_.push_back(header->num_arguments);
+
+  return true;
+}
+
+bool AMXDebugInfo::WriteIndexFile(const std::string &filename) const {
+  Arena arena;
+  ArenaHashMap<const AMX_DBG_SYMBOL*, uint32_t> symbol_numbers(arena);
+  symbol_numbers.reserve(amxdbg_->hdr->symbols);
+  for (uint32_t i = 0; i < static_cast<uint32_t>(amxdbg_->hdr->symbols);
+       i++) {
+    symbol_numbers.emplace(amxdbg_->symboltbl[i], i);
+  }
+
+  std::vector<IndexFileFunction> functions;
+  functions.reserve(function_starts_.size());
+  for (std::size_t i = 0; i < function_starts_.size(); i++) {
+    IndexFileFunction function;
+    function.code_start = function_starts_[i];
+    function.code_end = function_ends_[i];
+    function.symbol = symbol_numbers[function_symbols_[i]];
+    function.name = function_names_[i];
+    functions.push_back(function);
+  }
+
+  std::vector<IndexFileFunction> bugged_functions;
+  bugged_functions.reserve(bugged_functions_.size());
+  for (std::size_t i = 0; i < bugged_functions_.size(); i++) {
+    IndexFileFunction function;
+    function.code_start = bugged_functions_[i].code_start;
+    function.code_end = bugged_functions_[i].code_end;
+    function.symbol = symbol_numbers[bugged_functions_[i].symbol];
+    function.name = 0;
+    bugged_functions.push_back(function);
+  }
+
+  std::vector<IndexFileArgumentGroup> argument_groups;
+  argument_groups.reserve(argument_functions_.size());
+  for (std::size_t i = 0; i < argument_functions_.size(); i++) {
+    IndexFileArgumentGroup group;
+    group.code_start = argument_functions_[i];
+    group.first_argument = argument_offsets_[i];
+    group.num_arguments = argument_offsets_[i + 1] - argument_offsets_[i];
+    argument_groups.push_back(group);
+  }
+
+  std::vector<IndexFileArgument> arguments;
+  arguments.reserve(arguments_.size());
+  for (std::size_t i = 0; i < arguments_.size(); i++) {
+    IndexFileArgument arg;
+    arg.symbol = symbol_numbers[arguments_[i].GetPOD()];
+    arg.name = argument_names_[i];
+    arguments.push_back(arg);
+  }
+
+  IndexFileHeader header;
+  std::memset(&header, 0, sizeof(header));
+  std::memcpy(header.magic, kIndexFileMagic, sizeof(header.magic));
+  header.version = kIndexFileVersion;
+  header.cell_size = sizeof(cell);
+  header.amx_mtime = fileutils::GetModificationTime(filename);
+  header.amx_size = fileutils::GetFileSize(filename);
+  header.num_symbols = amxdbg_->hdr->symbols;
+  header.num_lines = static_cast<uint32_t>(line_index_.size());
+  header.num_functions = static_cast<uint32_t>(functions.size());
+  header.num_bugged_functions = static_cast<uint32_t>(bugged_functions.size());
+  header.num_argument_groups = static_cast<uint32_t>(argument_groups.size());
+  header.num_arguments = static_cast<uint32_t>(arguments.size());
+  header.names_size = static_cast<uint32_t>(names_.size());
+
+  // Write to a temporary file first so that other servers loading the same
+  // script never see a partially written index.
+  std::string index_filename = GetIndexFileName(filename);
+  std::string temp_filename = index_filename + ".tmp";
+  std::FILE *fp = std::fopen(temp_filename.c_str(), "wb");
+  if (fp == nullptr) {
+    return false;
+  }
+  bool ok = WriteIndexFileArray(fp, &header, 1)
+    && WriteIndexFileArray(fp, line_index_.data(), line_index_.size())
+    && WriteIndexFileArray(fp, functions.data(), functions.size())
+    && WriteIndexFileArray(fp, bugged_functions.data(),
+                           bugged_functions.size())
+    && WriteIndexFileArray(fp, argument_groups.data(), argument_groups.size())
+    && WriteIndexFileArray(fp, arguments.data(), arguments.size())
+    && WriteIndexFileArray(fp, names_.data(), names_.size());
+  ok = (std::fclose(fp) == 0) && ok;
+
+  if (ok) {
+    // rename() doesn't overwrite existing files on Windows.
+    std::remove(index_filename.c_str());
+    ok = std::rename(temp_filename.c_str(), index_filename.c_str()) == 0;
+  }
+  if (!ok) {
+    std::remove(temp_filename.c_str());
+  }
+  return ok;
+}
+
+// static
+std::string AMXDebugInfo::GetIndexFileName(const std::string &filename) {
+  return filename + ".cdidx";
+}
+
 // static
 bool AMXDebugInfo::IsPresent(AMX *amx) {
   uint16_t flags;
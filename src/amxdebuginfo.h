@@ -25,12 +25,21 @@
 #ifndef AMXDEBUGINFO_H
 #define AMXDEBUGINFO_H
 
+#include <atomic>
 #include <cassert>
+#include <ctime>
+#include <future>
 #include <iterator>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <unordered_map>
 #include <vector>
 #include <amx/amx.h>
 #include <amx/amxdbg.h>
+#include "arena.h"
+#include "fileutils.h"
+#include "stringpool.h"
 
 class AMXDebugInfo {
  public:
@@ -110,6 +119,8 @@ class AMXDebugInfo {
 
     std::string GetName() const
       { return file_->name; }
+    const char *GetNamePtr() const
+      { return file_->name; }
     cell GetAddress() const
       { return file_->address; }
     operator bool() const
@@ -143,7 +154,9 @@ class AMXDebugInfo {
     int32_t GetID() const
       { return tag_->tag; }
     std::string GetName() const
-      { return tag_->name; }    
+      { return tag_->name; }
+    const char *GetNamePtr() const
+      { return tag_->name; }
     operator bool() const
       { return tag_ != nullptr; }
 
@@ -162,6 +175,8 @@ class AMXDebugInfo {
       { return automaton_->address; }
     std::string GetName() const
       { return automaton_->name; }
+    const char *GetNamePtr() const
+      { return automaton_->name; }
     operator bool() const
       { return automaton_ != nullptr; }
 
@@ -180,6 +195,8 @@ class AMXDebugInfo {
       { return state_->automaton; }
     std::string GetName() const
       { return state_->name; }
+    const char *GetNamePtr() const
+      { return state_->name; }
     operator bool() const
       { return state_ != nullptr; }
 
@@ -188,6 +205,7 @@ class AMXDebugInfo {
   };
 
   class SymbolDim;
+  class SymbolDimList;
 
   class Symbol {
    public:
@@ -247,11 +265,17 @@ class AMXDebugInfo {
       { return symbol_->dim; }
     std::string GetName() const
       { return symbol_->name; }
+    const char *GetNamePtr() const
+      { return symbol_->name; }
     int16_t GetNumDims() const
       { return symbol_->dim; }
 
     std::vector<SymbolDim> GetDims() const;
 
+    // Same as GetDims() but refers to the dimensions stored in the debug
+    // info instead of copying them.
+    SymbolDimList GetDimList() const;
+
     operator bool() const { return symbol_ != nullptr; }
 
    private:
@@ -274,11 +298,95 @@ class AMXDebugInfo {
     const AMX_DBG_SYMDIM *symdim_;
   };
 
+  class SymbolDimList {
+   public:
+    SymbolDimList() : dims_(nullptr), size_(0) {}
+    SymbolDimList(const AMX_DBG_SYMDIM *dims, std::size_t size)
+      : dims_(dims), size_(size)
+    {}
+
+    std::size_t size() const
+      { return size_; }
+    bool empty() const
+      { return size_ == 0; }
+
+    SymbolDim operator[](std::size_t index) const {
+      assert(index < size_);
+      return SymbolDim(dims_ + index);
+    }
+
+   private:
+    const AMX_DBG_SYMDIM *dims_;
+    std::size_t size_;
+  };
+
+  class SymbolList {
+   public:
+    SymbolList() : symbols_(nullptr), size_(0) {}
+    SymbolList(const Symbol *symbols, std::size_t size)
+      : symbols_(symbols), size_(size)
+    {}
+
+    std::size_t size() const
+      { return size_; }
+    bool empty() const
+      { return size_ == 0; }
+
+    const Symbol &operator[](std::size_t index) const {
+      assert(index < size_);
+      return symbols_[index];
+    }
+
+   private:
+    const Symbol *symbols_;
+    std::size_t size_;
+  };
+
+  // How much of the debug info is kept once the indexes have been built.
+  // Below FULL only the records that the indexes point to are copied out
+  // of the file, the rest is freed:
+  //
+  // LINES:     line numbers, file names, functions, tags and states
+  // ARGUMENTS: the same plus function arguments
+  // FULL:      everything, including global and local variables
+  enum Level {
+    LINES,
+    ARGUMENTS,
+    FULL
+  };
+
   AMXDebugInfo();
   explicit AMXDebugInfo(const std::string &filename);
   ~AMXDebugInfo();
 
-  void Load(const std::string &filename);
+  // If use_mapping is true the file is memory-mapped and debug info is used
+  // in place instead of being read into memory. Falls back to reading if
+  // the file can't be mapped.
+  //
+  // If use_index_file is true the lookup indexes are read from an index
+  // file next to the script (see GetIndexFileName()) if it's up to date,
+  // otherwise they are built as usual and then saved to that file.
+  void Load(const std::string &filename,
+            bool use_mapping = true,
+            bool use_index_file = false,
+            Level level = FULL);
+
+  // Remembers the file name and its modification time but doesn't load
+  // anything until the debug info is actually needed, i.e. IsLoaded() is
+  // called. If the file has been modified by then, nothing is loaded.
+  void LoadDeferred(const std::string &filename,
+                    bool use_mapping = true,
+                    bool use_index_file = false,
+                    Level level = FULL);
+
+  // Same as Load() but done on a worker thread (see WorkQueue), so that
+  // the caller can go on with something else. IsLoaded() waits for it to
+  // finish.
+  void LoadAsync(const std::string &filename,
+                 bool use_mapping = true,
+                 bool use_index_file = false,
+                 Level level = FULL);
+
   bool IsLoaded() const;
   void Free();
 
@@ -286,19 +394,46 @@ class AMXDebugInfo {
   File GetFile(cell address) const;
   Symbol GetFunction(cell address, bool ignoreBrokenSymbols = true) const;
   Symbol GetExactFunction(cell address, bool ignoreBrokenSymbols = true) const;
+
+  // Functions are numbered from 0 to GetNumFunctions() - 1 in order of
+  // their code address. GetFunctionIndex() returns -1 if no function
+  // starts at the specified address.
+  int GetNumFunctions() const;
+  int GetFunctionIndex(cell address) const;
+  Symbol GetFunctionByIndex(int index) const;
+
+  // Same for the line table: GetLineIndex() returns the number of the line
+  // containing the address (see GetLine()), or -1 if there's none.
+  int GetNumLines() const;
+  int GetLineIndex(cell address) const;
+  Line GetLineByIndex(int index) const;
   Tag GetTag(int32_t tag_id) const;  
   Automaton GetAutomaton(cell address) const;
   State GetState(int16_t automaton_id, int16_t state_id) const;
 
   int32_t GetLineNumber(cell addrss) const;
   std::string GetFileName(cell address) const;
+  // Same as GetFileName() but doesn't make a copy of the name. Returns an
+  // empty string if the file is unknown.
+  const char *GetFileNamePtr(cell address) const;
   std::string GetFunctionName(cell address) const;
+  // Same as GetFunctionName() but doesn't make a copy of the name. Returns
+  // an empty string if there's no function at that address.
+  const char *GetFunctionNamePtr(cell address) const;
   std::string GetTagName(int32_t tag_id) const;
 
+  // Same as GetTagName() but doesn't make a copy of the name. Returns an
+  // empty string if there's no such tag.
+  const char *GetTagNamePtr(int32_t tag_id) const;
+
   cell GetFunctionAddress(const std::string &func,
                           const std::string &file) const;
   cell GetLineAddress(long line, const std::string &file) const;
 
+  // Returns the arguments of the function starting at the specified
+  // address, sorted by their position in the stack frame.
+  SymbolList GetArguments(cell function_address) const;
+
   #define AMXDEBUGINFO_TABLE_TYPEDEF(type, name) \
     typedef Table<type, name> name##Table
 
@@ -321,6 +456,11 @@ class AMXDebugInfo {
   AMXDEBUGINFO_TABLE_GETTER(States, State, statetbl, states);
 
   LineTable GetLines() const {
+    if (!trimmed_data_.empty()) {
+      // The line table is gone, the index has the same lines.
+      return LineTable(const_cast<AMX_DBG_LINE*>(line_index_.data()),
+                       line_index_.size());
+    }
     // Work around possible overflow of amxdbg_->hdr->lines.
     int num_lines = (
       reinterpret_cast<unsigned char*>(amxdbg_->symboltbl[0]) -
@@ -330,13 +470,102 @@ class AMXDebugInfo {
   }
 
   static bool IsPresent(AMX *amx);
+  static std::string GetIndexFileName(const std::string &filename);
 
  private:
   AMXDebugInfo(const AMXDebugInfo &);
   AMXDebugInfo &operator=(const AMXDebugInfo &);
 
+  void LoadIfDeferred();
+  void WaitForLoad();
+  void BuildIndexes();
+  void BuildLineIndex();
+  void BuildFunctionIndex();
+  void BuildArgumentIndex();
+  void BuildNameIndex();
+  void BuildLookupTables();
+  void Trim(Level level);
+  void FreeAMXDBG();
+
+  bool ReadIndexFile(const std::string &filename);
+  bool WriteIndexFile(const std::string &filename) const;
+
+ private:
+  struct FunctionRange {
+    cell code_start;
+    cell code_end;
+    const AMX_DBG_SYMBOL *symbol;
+  };
+
  private:
   AMX_DBG *amxdbg_;
+  fileutils::MappedFile mapped_file_;
+
+  std::string deferred_filename_;
+  std::time_t deferred_mtime_;
+  bool deferred_use_mapping_;
+  bool deferred_use_index_file_;
+  Level deferred_level_;
+
+  // Set while LoadAsync() is in progress, so that IsLoaded() only has to
+  // lock the mutex in that case.
+  std::atomic<bool> loading_;
+  std::mutex loading_mutex_;
+  std::future<void> loading_result_;
+
+  // Line table entries sorted by address, for binary search in GetLine().
+  std::vector<AMX_DBG_LINE> line_index_;
+
+  // File table entries sorted by address, for binary search in GetFile().
+  std::vector<cell> file_addresses_;
+  std::vector<const AMX_DBG_FILE*> file_records_;
+
+  // Names of the functions, arguments and tags below, each stored once.
+  // The indexes refer to them by ID.
+  StringPool names_;
+
+  // Function symbols sorted by code start address, one array per field so
+  // that lookups only touch the start addresses while searching. Bugged
+  // forwards (see IsBuggedForward()) are kept separately as they are only
+  // searched when explicitly asked for.
+  std::vector<cell> function_starts_;
+  std::vector<cell> function_ends_;
+  std::vector<const AMX_DBG_SYMBOL*> function_symbols_;
+  std::vector<uint32_t> function_names_;
+  std::vector<FunctionRange> bugged_functions_;
+
+  // Local symbols grouped by the code start address of their function:
+  // the arguments of argument_functions_[i] are arguments_[j] for j from
+  // argument_offsets_[i] to argument_offsets_[i + 1].
+  std::vector<cell> argument_functions_;
+  std::vector<uint32_t> argument_offsets_;
+  std::vector<Symbol> arguments_;
+  std::vector<uint32_t> argument_names_;
+
+  // Tags sorted by ID.
+  std::vector<int32_t> tag_ids_;
+  std::vector<const AMX_DBG_TAG*> tag_records_;
+  std::vector<uint32_t> tag_names_;
+
+  // The hash tables are allocated from their own arena and are freed
+  // along with it, all at once.
+  struct HashIndexes {
+    HashIndexes(): automata(arena), states(arena) {}
+    Arena arena;
+    ArenaHashMap<cell, const AMX_DBG_MACHINE*> automata;
+    // Keyed by (automaton ID << 16) | state ID.
+    ArenaHashMap<uint32_t, const AMX_DBG_STATE*> states;
+  };
+  std::unique_ptr<HashIndexes> hash_indexes_;
+
+  // After Trim() amxdbg_ refers to these instead of the file: the records
+  // that are kept, one after another, and the tables pointing to them.
+  std::vector<unsigned char> trimmed_data_;
+  std::vector<AMX_DBG_FILE*> trimmed_files_;
+  std::vector<AMX_DBG_SYMBOL*> trimmed_symbols_;
+  std::vector<AMX_DBG_TAG*> trimmed_tags_;
+  std::vector<AMX_DBG_MACHINE*> trimmed_automata_;
+  std::vector<AMX_DBG_STATE*> trimmed_states_;
 };
 
 typedef AMXDebugInfo::File AMXDebugFile;
@@ -344,6 +573,8 @@ typedef AMXDebugInfo::Line AMXDebugLine;
 typedef AMXDebugInfo::Tag AMXDebugTag;
 typedef AMXDebugInfo::Symbol AMXDebugSymbol;
 typedef AMXDebugInfo::SymbolDim AMXDebugSymbolDim;
+typedef AMXDebugInfo::SymbolDimList AMXDebugSymbolDimList;
+typedef AMXDebugInfo::SymbolList AMXDebugSymbolList;
 typedef AMXDebugInfo::Automaton AMXDebugAutomaton;
 typedef AMXDebugInfo::State AMXDebugState;
 
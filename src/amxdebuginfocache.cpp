@@ -0,0 +1,106 @@
+// Copyright (c) 2026 Zeex
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <cstddef>
+#include "amxdebuginfocache.h"
+#include "fileutils.h"
+#include "filewatcher.h"
+
+namespace {
+
+// FNV-1a
+uint32_t HashBytes(const unsigned char *data, std::size_t size) {
+  uint32_t hash = 2166136261u;
+  for (std::size_t i = 0; i < size; i++) {
+    hash ^= data[i];
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+} // anonymous namespace
+
+bool AMXDebugInfoCache::Key::operator<(const Key &other) const {
+  if (path != other.path) {
+    return path < other.path;
+  }
+  if (mtime != other.mtime) {
+    return mtime < other.mtime;
+  }
+  if (version != other.version) {
+    return version < other.version;
+  }
+  return header_hash < other.header_hash;
+}
+
+std::shared_ptr<AMXDebugInfo> AMXDebugInfoCache::Get(
+    AMX *amx,
+    const std::string &path,
+    bool deferred,
+    bool async,
+    bool use_mapping,
+    bool use_index_file,
+    AMXDebugInfo::Level level) {
+  Key key;
+  key.path = path;
+  key.mtime = 0;
+  key.version = 0;
+  if (!FileWatcher::shared().GetFileVersion(path, key.version)) {
+    key.mtime = fileutils::GetModificationTime(path);
+  }
+  key.header_hash = HashBytes(amx->base, sizeof(AMX_HEADER));
+
+  // Drop entries of scripts that are no longer loaded.
+  for (EntryMap::iterator it = entries_.begin(); it != entries_.end(); ) {
+    if (it->second.expired()) {
+      it = entries_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+
+  EntryMap::const_iterator it = entries_.find(key);
+  if (it != entries_.end()) {
+    if (std::shared_ptr<AMXDebugInfo> debug_info = it->second.lock()) {
+      return debug_info;
+    }
+  }
+
+  std::shared_ptr<AMXDebugInfo> debug_info = std::make_shared<AMXDebugInfo>();
+  if (deferred) {
+    debug_info->LoadDeferred(path, use_mapping, use_index_file, level);
+  } else if (async) {
+    debug_info->LoadAsync(path, use_mapping, use_index_file, level);
+  } else {
+    debug_info->Load(path, use_mapping, use_index_file, level);
+  }
+  entries_[key] = debug_info;
+  return debug_info;
+}
+
+// static
+AMXDebugInfoCache &AMXDebugInfoCache::shared() {
+  static AMXDebugInfoCache instance;
+  return instance;
+}
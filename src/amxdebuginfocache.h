@@ -0,0 +1,68 @@
+// Copyright (c) 2026 Zeex
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef AMXDEBUGINFOCACHE_H
+#define AMXDEBUGINFOCACHE_H
+
+#include <ctime>
+#include <map>
+#include <memory>
+#include <string>
+#include <amx/amx.h>
+#include "amxdebuginfo.h"
+
+// Keeps track of loaded debug info so that scripts running from the same
+// .amx file (e.g. multiple instances of one script, or a filterscript that
+// is reloaded) share a single copy of it. Entries are released when the last
+// script using them is unloaded.
+class AMXDebugInfoCache {
+ public:
+  std::shared_ptr<AMXDebugInfo> Get(AMX *amx,
+                                    const std::string &path,
+                                    bool deferred,
+                                    bool async,
+                                    bool use_mapping,
+                                    bool use_index_file,
+                                    AMXDebugInfo::Level level);
+
+  static AMXDebugInfoCache &shared();
+
+ private:
+  // If the file's directory is watched (see FileWatcher), its version is
+  // used instead of the modification time, which doesn't need a stat() and
+  // changes even if the file is rewritten within the same second.
+  struct Key {
+    std::string path;
+    std::time_t mtime;
+    uint32_t version;
+    uint32_t header_hash;
+
+    bool operator<(const Key &other) const;
+  };
+
+  typedef std::map<Key, std::weak_ptr<AMXDebugInfo>> EntryMap;
+  EntryMap entries_;
+};
+
+#endif // !AMXDEBUGINFOCACHE_H
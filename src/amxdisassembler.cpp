@@ -0,0 +1,156 @@
+// Copyright (c) 2026 Zeex
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <cstdint>
+#include <cstdio>
+#include <amx/amx.h>
+#include "amxdisassembler.h"
+#include "amxopcode.h"
+
+namespace {
+
+// Instructions whose operand is a (relocated) code address.
+bool HasCodeOperand(int opcode) {
+  switch (opcode) {
+    case AMX_OP_CALL:
+    case AMX_OP_JUMP:
+    case AMX_OP_JZER:
+    case AMX_OP_JNZ:
+    case AMX_OP_JEQ:
+    case AMX_OP_JNEQ:
+    case AMX_OP_JLESS:
+    case AMX_OP_JLEQ:
+    case AMX_OP_JGRTR:
+    case AMX_OP_JGEQ:
+    case AMX_OP_JSLESS:
+    case AMX_OP_JSLEQ:
+    case AMX_OP_JSGRTR:
+    case AMX_OP_JSGEQ:
+    case AMX_OP_SWITCH:
+      return true;
+  }
+  return false;
+}
+
+// Operands beyond this are not printed (CASETBL can be any size).
+const cell kMaxPrintedOperands = 4;
+
+} // anonymous namespace
+
+AMXDisassembler::AMXDisassembler(AMXRef amx)
+  : amx_(amx),
+    code_size_(amx.GetHeader()->dat - amx.GetHeader()->cod)
+{
+  opcodes_.resize(code_size_ / sizeof(cell));
+  if (amx_DecodeOpcodes(amx.amx(), opcodes_.data()) != AMX_ERR_NONE) {
+    opcodes_.clear();
+  }
+}
+
+std::vector<std::string> AMXDisassembler::Disassemble(cell address,
+                                                      int num_around) const {
+  std::vector<std::string> lines;
+  if (!IsValid()) {
+    return lines;
+  }
+  cell current = FindInstruction(address);
+  if (current < 0) {
+    return lines;
+  }
+
+  cell first = current;
+  for (int i = 0; i < num_around && first > 0; i++) {
+    cell prev = FindInstruction(first - sizeof(cell));
+    if (prev < 0) {
+      break;
+    }
+    first = prev;
+  }
+  for (cell ip = first; ip < current; ip = NextInstruction(ip)) {
+    lines.push_back(FormatInstruction(ip, false));
+  }
+  lines.push_back(FormatInstruction(current, true));
+  cell ip = NextInstruction(current);
+  for (int i = 0; i < num_around && ip < code_size_; i++) {
+    lines.push_back(FormatInstruction(ip, false));
+    ip = NextInstruction(ip);
+  }
+  return lines;
+}
+
+cell AMXDisassembler::FindInstruction(cell address) const {
+  if (address < 0 || address >= code_size_) {
+    return -1;
+  }
+  for (cell i = address / sizeof(cell); i >= 0; i--) {
+    if (opcodes_[i] != AMX_OP_NONE) {
+      return i * sizeof(cell);
+    }
+  }
+  return -1;
+}
+
+cell AMXDisassembler::NextInstruction(cell address) const {
+  cell i = address / sizeof(cell) + 1;
+  cell num_cells = static_cast<cell>(opcodes_.size());
+  while (i < num_cells && opcodes_[i] == AMX_OP_NONE) {
+    i++;
+  }
+  return i * sizeof(cell);
+}
+
+std::string AMXDisassembler::FormatInstruction(cell address,
+                                               bool is_current) const {
+  const cell *ip = reinterpret_cast<const cell *>(amx_.GetCode() + address);
+  // The actual opcode may differ from the decoded one if SYSREQ.C has been
+  // patched into SYSREQ.D or the instruction is a superinstruction.
+  int opcode = UnrelocateAMXOpcode(*ip, amx_.GetFlags());
+  if (opcode < 0) {
+    opcode = opcodes_[address / sizeof(cell)];
+  }
+
+  char buffer[256];
+  int length = std::snprintf(buffer, sizeof(buffer), "%s 0x%08X  %s",
+                             is_current ? ">" : " ",
+                             static_cast<unsigned int>(address),
+                             GetAMXOpcodeName(opcode));
+  cell num_operands =
+    (NextInstruction(address) - address) / sizeof(cell) - 1;
+  for (cell i = 0; i < num_operands && i < kMaxPrintedOperands; i++) {
+    cell operand = ip[1 + i];
+    const char *format = " %d";
+    if (HasCodeOperand(opcode)) {
+      operand -= static_cast<cell>(
+        reinterpret_cast<intptr_t>(amx_.GetCode()));
+      format = " 0x%08X";
+    }
+    length += std::snprintf(buffer + length, sizeof(buffer) - length,
+                            format, operand);
+  }
+  std::string line(buffer);
+  if (num_operands > kMaxPrintedOperands) {
+    line.append(" ...");
+  }
+  return line;
+}
@@ -0,0 +1,62 @@
+// Copyright (c) 2026 Zeex
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef AMXDISASSEMBLER_H
+#define AMXDISASSEMBLER_H
+
+#include <string>
+#include <vector>
+#include "amxref.h"
+
+// Prints the instructions of a relocated script. Instruction boundaries
+// are found by decoding the whole code once (see amx_DecodeOpcodes()), so
+// it's possible to go backwards from an address, e.g. to show what led to
+// a runtime error.
+class AMXDisassembler {
+ public:
+  explicit AMXDisassembler(AMXRef amx);
+
+  // False if the code could not be decoded.
+  bool IsValid() const { return !opcodes_.empty(); }
+
+  // Returns the instruction that contains the address, up to num_around
+  // instructions before and after it, one line per instruction. The line
+  // of that instruction is marked with ">".
+  std::vector<std::string> Disassemble(cell address, int num_around) const;
+
+ private:
+  // Returns the address of the instruction that contains address or -1.
+  cell FindInstruction(cell address) const;
+  cell NextInstruction(cell address) const;
+  std::string FormatInstruction(cell address, bool is_current) const;
+
+ private:
+  AMXRef amx_;
+  cell code_size_;
+  // Opcode of each code cell where an instruction starts, AMX_OP_NONE
+  // for operands.
+  std::vector<unsigned char> opcodes_;
+};
+
+#endif // !AMXDISASSEMBLER_H
@@ -0,0 +1,143 @@
+// Copyright (c) 2026 Zeex
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <algorithm>
+#include "amxfunctiontable.h"
+
+namespace {
+
+const char *const kKnownPublicNames[] = {
+  "OnRuntimeError",
+  "OnRconCommand",
+  "OnCrashDetectLongCall"
+};
+
+} // anonymous namespace
+
+AMXFunctionTable::AMXFunctionTable(AMXRef amx)
+  : amx_(amx),
+    natives_registered_(false)
+{
+  std::fill(known_publics_, known_publics_ + NUM_KNOWN_PUBLICS, -1);
+}
+
+void AMXFunctionTable::Build() {
+  public_names_.clear();
+  public_addresses_.clear();
+
+  AMX_FUNCSTUBNT *publics = amx_.GetPublics();
+  int num_publics = amx_.GetNumPublics();
+  public_names_.reserve(num_publics);
+  public_addresses_.reserve(num_publics);
+  for (int i = 0; i < num_publics; i++) {
+    // The first public with a given name wins, like in GetPublicIndex().
+    public_names_.insert(std::make_pair(
+      std::string(amx_.GetString(publics[i].nameofs)), i));
+    ucell address = publics[i].address;
+    public_addresses_.push_back(std::make_pair(address, i));
+  }
+  std::stable_sort(public_addresses_.begin(), public_addresses_.end(),
+    [](const std::pair<ucell, cell> &a, const std::pair<ucell, cell> &b) {
+      return a.first < b.first;
+    });
+
+  for (int i = 0; i < NUM_KNOWN_PUBLICS; i++) {
+    known_publics_[i] = GetPublicIndex(kKnownPublicNames[i]);
+  }
+
+  BuildNatives();
+}
+
+void AMXFunctionTable::BuildNatives() {
+  native_names_.clear();
+  native_addresses_.clear();
+  natives_registered_ = true;
+
+  AMX_FUNCSTUBNT *natives = amx_.GetNatives();
+  int num_natives = amx_.GetNumNatives();
+  native_names_.reserve(num_natives);
+  native_addresses_.reserve(num_natives);
+  for (int i = 0; i < num_natives; i++) {
+    native_names_.insert(std::make_pair(
+      std::string(amx_.GetString(natives[i].nameofs)), i));
+    ucell address = natives[i].address;
+    if (address != 0) {
+      native_addresses_.push_back(std::make_pair(address, i));
+    } else {
+      natives_registered_ = false;
+    }
+  }
+  std::stable_sort(native_addresses_.begin(), native_addresses_.end(),
+    [](const std::pair<ucell, cell> &a, const std::pair<ucell, cell> &b) {
+      return a.first < b.first;
+    });
+}
+
+cell AMXFunctionTable::GetPublicIndex(const char *name) const {
+  std::unordered_map<std::string, cell>::const_iterator it =
+    public_names_.find(name);
+  return it != public_names_.end() ? it->second : -1;
+}
+
+cell AMXFunctionTable::GetNativeIndex(const char *name) const {
+  std::unordered_map<std::string, cell>::const_iterator it =
+    native_names_.find(name);
+  return it != native_names_.end() ? it->second : -1;
+}
+
+cell AMXFunctionTable::FindPublicIndex(cell address) const {
+  return Find(public_addresses_, address);
+}
+
+cell AMXFunctionTable::FindNativeIndex(cell address) {
+  cell index = Find(native_addresses_, address);
+  if (index < 0 && !natives_registered_) {
+    BuildNatives();
+    index = Find(native_addresses_, address);
+  }
+  return index;
+}
+
+const char *AMXFunctionTable::FindPublic(cell address) const {
+  // GetPublicName() would return "main" for -1 (AMX_EXEC_MAIN).
+  cell index = FindPublicIndex(address);
+  return index >= 0 ? amx_.GetPublicName(index) : nullptr;
+}
+
+const char *AMXFunctionTable::FindNative(cell address) {
+  return amx_.GetNativeName(FindNativeIndex(address));
+}
+
+// static
+cell AMXFunctionTable::Find(const AddressIndex &index, cell address) {
+  AddressIndex::const_iterator it = std::lower_bound(
+    index.begin(), index.end(), static_cast<ucell>(address),
+    [](const std::pair<ucell, cell> &entry, ucell address) {
+      return entry.first < address;
+    });
+  if (it != index.end() && it->first == static_cast<ucell>(address)) {
+    return it->second;
+  }
+  return -1;
+}
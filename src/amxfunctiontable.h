@@ -0,0 +1,87 @@
+// Copyright (c) 2026 Zeex
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef AMXFUNCTIONTABLE_H
+#define AMXFUNCTIONTABLE_H
+
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "amxref.h"
+
+// Indexes the public and native tables of a script so that finding a
+// function by name or by address doesn't scan them like AMXRef does.
+// Publics never change after the script is loaded; natives are only given
+// addresses as they are registered, so their part is rebuilt when an
+// address can't be found and some natives were still unregistered.
+class AMXFunctionTable {
+ public:
+  // Publics that CrashDetect calls or checks for itself.
+  enum KnownPublic {
+    ON_RUNTIME_ERROR,
+    ON_RCON_COMMAND,
+    ON_CRASHDETECT_LONG_CALL,
+    NUM_KNOWN_PUBLICS
+  };
+
+  AMXFunctionTable(AMXRef amx);
+
+  void Build();
+
+  cell GetPublicIndex(const char *name) const;
+  cell GetNativeIndex(const char *name) const;
+
+  // -1 if the script doesn't have this public.
+  cell GetKnownPublicIndex(KnownPublic known_public) const {
+    return known_publics_[known_public];
+  }
+
+  // Return the index of the public or native with the specified address,
+  // or -1 if there's no such function.
+  cell FindPublicIndex(cell address) const;
+  cell FindNativeIndex(cell address);
+
+  // The same but return the name, or nullptr.
+  const char *FindPublic(cell address) const;
+  const char *FindNative(cell address);
+
+ private:
+  void BuildNatives();
+
+ private:
+  typedef std::vector<std::pair<ucell, cell>> AddressIndex;
+
+  static cell Find(const AddressIndex &index, cell address);
+
+  AMXRef amx_;
+  std::unordered_map<std::string, cell> public_names_;
+  std::unordered_map<std::string, cell> native_names_;
+  AddressIndex public_addresses_;  // sorted by address
+  AddressIndex native_addresses_;  // sorted by address
+  bool natives_registered_;
+  cell known_publics_[NUM_KNOWN_PUBLICS];
+};
+
+#endif // !AMXFUNCTIONTABLE_H
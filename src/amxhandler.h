@@ -26,6 +26,8 @@
 #define AMXHANDLER_H
 
 #include <map>
+#include <memory>
+#include <mutex>
 #include <amx/amx.h>
 
 template<typename T>
@@ -38,32 +40,85 @@ class AMXHandler {
  public:
   static T *CreateHandler(AMX *amx);
   static T *GetHandler(AMX *amx);
+  // Same as GetHandler() but keeps the handler alive for as long as the
+  // pointer is held, even if it's destroyed in the meantime.
+  static std::shared_ptr<T> PinHandler(AMX *amx);
   static void DestroyHandler(AMX *amx);
 
+  // Each call sees the handlers as they were when it started, and keeps
+  // them alive until it returns.
+  template<typename F>
+  static void ForEachHandler(F func);
+
  private:
   AMX *amx_;
 
  private:
-  typedef std::map<AMX*, T*> HandlerMap;
-  static HandlerMap handlers_;
+  // The handler is also stored in the AMX's user data under this tag so
+  // that GetHandler() doesn't have to search the map. The map is still
+  // used for enumeration and for AMXs whose user data slots are all taken.
+  static const long kUserDataTag = AMX_USERTAG('c', 'd', 'h', 'd');
+
+  // Scripts may be loaded and unloaded on different threads, and other
+  // threads may be looking at the handlers at the same time. The map is
+  // never modified in place: writers make a copy, change it and publish
+  // it, so readers just grab the current snapshot. Handlers are shared
+  // by snapshots (and PinHandler() callers) and die with the last one that
+  // has them, which may be on any thread, so their destructors must not
+  // do more than free memory. GetHandler() doesn't pin anything: its result
+  // is only good until the handler is destroyed.
+  typedef std::map<AMX*, std::shared_ptr<T>> HandlerMap;
+  static std::shared_ptr<const HandlerMap> GetHandlers() {
+    return std::atomic_load(&handlers_);
+  }
+  static std::shared_ptr<const HandlerMap> handlers_;
+  static std::mutex handlers_mutex_;  // serializes writers
 };
 
 template<typename T>
-typename AMXHandler<T>::HandlerMap AMXHandler<T>::handlers_;
+std::shared_ptr<const typename AMXHandler<T>::HandlerMap>
+  AMXHandler<T>::handlers_ = std::make_shared<HandlerMap>();
+
+template<typename T>
+std::mutex AMXHandler<T>::handlers_mutex_;
 
 // static
 template<typename T>
 T *AMXHandler<T>::CreateHandler(AMX *amx) {
-  T *handler = new T(amx);
-  handlers_.insert(std::make_pair(amx, handler));
-  return handler;
+  std::shared_ptr<T> handler(new T(amx));
+  {
+    std::lock_guard<std::mutex> lock(handlers_mutex_);
+    std::shared_ptr<HandlerMap> handlers =
+      std::make_shared<HandlerMap>(*handlers_);
+    (*handlers)[amx] = handler;
+    std::atomic_store(&handlers_,
+                      std::shared_ptr<const HandlerMap>(handlers));
+  }
+  amx_SetUserData(amx, kUserDataTag, handler.get());
+  return handler.get();
 }
 
 // static
 template<typename T>
 T *AMXHandler<T>::GetHandler(AMX *amx) {
-  typename HandlerMap::const_iterator iterator = handlers_.find(amx);
-  if (iterator != handlers_.end()) {
+  void *handler;
+  if (amx_GetUserData(amx, kUserDataTag, &handler) == AMX_ERR_NONE) {
+    return static_cast<T*>(handler);
+  }
+  std::shared_ptr<const HandlerMap> handlers = GetHandlers();
+  typename HandlerMap::const_iterator iterator = handlers->find(amx);
+  if (iterator != handlers->end()) {
+    return iterator->second.get();
+  }
+  return nullptr;
+}
+
+// static
+template<typename T>
+std::shared_ptr<T> AMXHandler<T>::PinHandler(AMX *amx) {
+  std::shared_ptr<const HandlerMap> handlers = GetHandlers();
+  typename HandlerMap::const_iterator iterator = handlers->find(amx);
+  if (iterator != handlers->end()) {
     return iterator->second;
   }
   return nullptr;
@@ -72,11 +127,30 @@ T *AMXHandler<T>::GetHandler(AMX *amx) {
 // static
 template<typename T>
 void AMXHandler<T>::DestroyHandler(AMX *amx) {
-  typename HandlerMap::iterator iterator = handlers_.find(amx);
-  if (iterator != handlers_.end()) {
-    T *handler = iterator->second;
-    handlers_.erase(iterator);
-    delete handler;
+  std::lock_guard<std::mutex> lock(handlers_mutex_);
+  if (handlers_->find(amx) == handlers_->end()) {
+    return;
+  }
+  std::shared_ptr<HandlerMap> handlers =
+    std::make_shared<HandlerMap>(*handlers_);
+  handlers->erase(amx);
+  // There's no way to free the slot, but another handler may be created
+  // for the same AMX later so it must not point to this one.
+  void *data;
+  if (amx_GetUserData(amx, kUserDataTag, &data) == AMX_ERR_NONE) {
+    amx_SetUserData(amx, kUserDataTag, nullptr);
+  }
+  std::atomic_store(&handlers_, std::shared_ptr<const HandlerMap>(handlers));
+}
+
+// static
+template<typename T>
+template<typename F>
+void AMXHandler<T>::ForEachHandler(F func) {
+  std::shared_ptr<const HandlerMap> handlers = GetHandlers();
+  for (typename HandlerMap::const_iterator iterator = handlers->begin();
+       iterator != handlers->end(); ++iterator) {
+    func(iterator->second.get());
   }
 }
 
@@ -0,0 +1,89 @@
+// Copyright (c) 2026 Zeex
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <algorithm>
+#include "amxintegritychecker.h"
+
+const cell AMXIntegrityChecker::kBlockSize;
+
+AMXIntegrityChecker::AMXIntegrityChecker(AMXRef amx)
+  : amx_(amx),
+    next_block_(0),
+    baseline_done_(false)
+{
+  const AMX_HEADER *hdr = amx_.GetHeader();
+  code_size_ = hdr->dat - hdr->cod;
+  checksums_.assign(1 + (code_size_ + kBlockSize - 1) / kBlockSize, 0);
+}
+
+bool AMXIntegrityChecker::CheckNextBlock(std::size_t &block) {
+  block = next_block_;
+  if (++next_block_ == checksums_.size()) {
+    next_block_ = 0;
+  }
+  uint32_t checksum = GetChecksum(block);
+  bool changed = baseline_done_ && checksum != checksums_[block];
+  checksums_[block] = checksum;
+  if (next_block_ == 0) {
+    baseline_done_ = true;
+  }
+  return !changed;
+}
+
+cell AMXIntegrityChecker::GetBlockStart(std::size_t block) const {
+  if (IsHeaderBlock(block)) {
+    return 0;
+  }
+  return static_cast<cell>(block - 1) * kBlockSize;
+}
+
+cell AMXIntegrityChecker::GetBlockEnd(std::size_t block) const {
+  if (IsHeaderBlock(block)) {
+    return static_cast<cell>(sizeof(AMX_HEADER));
+  }
+  return std::min(GetBlockStart(block) + kBlockSize, code_size_);
+}
+
+void AMXIntegrityChecker::UpdateCode(cell address) {
+  if (address < 0 || address >= code_size_) {
+    return;
+  }
+  std::size_t block = 1 + static_cast<std::size_t>(address / kBlockSize);
+  checksums_[block] = GetChecksum(block);
+}
+
+// FNV-1a, like the header hash of the debug info cache.
+uint32_t AMXIntegrityChecker::GetChecksum(std::size_t block) const {
+  const unsigned char *data = IsHeaderBlock(block)
+    ? reinterpret_cast<const unsigned char *>(amx_.GetHeader())
+    : amx_.GetCode();
+  const unsigned char *start = data + GetBlockStart(block);
+  const unsigned char *end = data + GetBlockEnd(block);
+  uint32_t hash = 2166136261u;
+  for (const unsigned char *p = start; p < end; p++) {
+    hash ^= *p;
+    hash *= 16777619u;
+  }
+  return hash;
+}
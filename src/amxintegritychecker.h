@@ -0,0 +1,75 @@
+// Copyright (c) 2026 Zeex
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef AMXINTEGRITYCHECKER_H
+#define AMXINTEGRITYCHECKER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <amx/amx.h>
+#include "amxref.h"
+
+// Checksums the AMX header and code of a script a block at a time, so that
+// a full pass can be spread over many server ticks, and tells when a block
+// has changed since the last pass. None of this is supposed to change once
+// the script is running, so a change means that something wrote where it
+// shouldn't have. The first pass only records the checksums.
+class AMXIntegrityChecker {
+ public:
+  static const cell kBlockSize = 4096;
+
+  explicit AMXIntegrityChecker(AMXRef amx);
+
+  // Checks the next block (wrapping around to the first one after the last)
+  // and returns false if it has changed. The new contents become the ones
+  // that later passes compare against, so each change is seen once.
+  bool CheckNextBlock(std::size_t &block);
+
+  // Block 0 is the AMX header, the rest cover the code. The range of a
+  // code block is in code addresses (like CIP).
+  std::size_t GetNumBlocks() const { return checksums_.size(); }
+  bool IsHeaderBlock(std::size_t block) const { return block == 0; }
+  cell GetBlockStart(std::size_t block) const;
+  cell GetBlockEnd(std::size_t block) const;
+
+  // Records the current contents of the code at the address, for code that
+  // is changed on purpose (e.g. by SYSREQ.D patching).
+  void UpdateCode(cell address);
+
+  // Whether every block has been checked at least once.
+  bool IsBaselineDone() const { return baseline_done_; }
+
+ private:
+  uint32_t GetChecksum(std::size_t block) const;
+
+ private:
+  AMXRef amx_;
+  cell code_size_;
+  std::vector<uint32_t> checksums_;
+  std::size_t next_block_;
+  bool baseline_done_;
+};
+
+#endif // !AMXINTEGRITYCHECKER_H
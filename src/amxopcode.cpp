@@ -22,13 +22,40 @@
 // ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
 // POSSIBILITY OF SUCH DAMAGE.
 
+#include <unordered_map>
 #include "amxopcode.h"
 
-static cell *GetOpcodeMap() {
+static const uint16_t kExecFlags =
+  AMX_FLAG_NOTRACKCIP | AMX_FLAG_NOLONGCALL | AMX_FLAG_COUNTOPS;
+
+static const char *const kOpcodeNames[] = {
+  "none", "load.pri", "load.alt", "load.s.pri", "load.s.alt", "lref.pri",
+  "lref.alt", "lref.s.pri", "lref.s.alt", "load.i", "lodb.i", "const.pri",
+  "const.alt", "addr.pri", "addr.alt", "stor.pri", "stor.alt", "stor.s.pri",
+  "stor.s.alt", "sref.pri", "sref.alt", "sref.s.pri", "sref.s.alt", "stor.i",
+  "strb.i", "lidx", "lidx.b", "idxaddr", "idxaddr.b", "align.pri",
+  "align.alt", "lctrl", "sctrl", "move.pri", "move.alt", "xchg", "push.pri",
+  "push.alt", "push.r", "push.c", "push", "push.s", "pop.pri", "pop.alt",
+  "stack", "heap", "proc", "ret", "retn", "call", "call.pri", "jump", "jrel",
+  "jzer", "jnz", "jeq", "jneq", "jless", "jleq", "jgrtr", "jgeq", "jsless",
+  "jsleq", "jsgrtr", "jsgeq", "shl", "shr", "sshr", "shl.c.pri", "shl.c.alt",
+  "shr.c.pri", "shr.c.alt", "smul", "sdiv", "sdiv.alt", "umul", "udiv",
+  "udiv.alt", "add", "sub", "sub.alt", "and", "or", "xor", "not", "neg",
+  "invert", "add.c", "smul.c", "zero.pri", "zero.alt", "zero", "zero.s",
+  "sign.pri", "sign.alt", "eq", "neq", "less", "leq", "grtr", "geq", "sless",
+  "sleq", "sgrtr", "sgeq", "eq.c.pri", "eq.c.alt", "inc.pri", "inc.alt",
+  "inc", "inc.s", "inc.i", "dec.pri", "dec.alt", "dec", "dec.s", "dec.i",
+  "movs", "cmps", "fill", "halt", "bounds", "sysreq.pri", "sysreq.c", "file",
+  "line", "symbol", "srange", "jump.pri", "switch", "casetbl", "swap.pri",
+  "swap.alt", "push.adr", "nop", "sysreq.d", "symtag", "break",
+  "load.s.pri+push.pri", "const.pri+bounds", "push.c+push.c"
+};
+
+static cell *GetOpcodeMap(uint16_t amx_flags) {
   #if defined __GNUC__
     cell *opcode_map;
     AMX amx = {0};
-    amx.flags |= AMX_FLAG_BROWSE;
+    amx.flags = (amx_flags & kExecFlags) | AMX_FLAG_BROWSE;
     amx_Exec(&amx, reinterpret_cast<cell*>(&opcode_map), 0);
     amx.flags &= ~AMX_FLAG_BROWSE;
     return opcode_map;
@@ -37,13 +64,51 @@ static cell *GetOpcodeMap() {
   #endif
 }
 
-cell RelocateAMXOpcode(cell opcode) {
+cell RelocateAMXOpcode(cell opcode, uint16_t amx_flags) {
   #if defined __GNUC__
-    static cell *opcode_map = GetOpcodeMap();
+    // Indexed by the exec flags (there are only 3 of them).
+    static cell *opcode_maps[8];
+    int variant = (amx_flags & kExecFlags) / AMX_FLAG_NOTRACKCIP;
+    if (opcode_maps[variant] == nullptr) {
+      opcode_maps[variant] = GetOpcodeMap(amx_flags);
+    }
     if (opcode >= 0 && opcode < NUM_AMX_OPCODES) {
-      return opcode_map[opcode];
+      return opcode_maps[variant][opcode];
     }
   #endif
   return opcode;
 }
 
+
+int UnrelocateAMXOpcode(cell relocated_opcode, uint16_t amx_flags) {
+  #if defined __GNUC__
+    static std::unordered_map<cell, int> opcode_maps[8];
+    int variant = (amx_flags & kExecFlags) / AMX_FLAG_NOTRACKCIP;
+    std::unordered_map<cell, int> &opcode_map = opcode_maps[variant];
+    if (opcode_map.empty()) {
+      cell *opcodes = GetOpcodeMap(amx_flags);
+      // If the compiler merged some handlers, the first opcode wins.
+      for (int i = 0; i < NUM_AMX_FUSED_OPCODES; i++) {
+        opcode_map.insert(std::make_pair(opcodes[i], i));
+      }
+    }
+    std::unordered_map<cell, int>::const_iterator it =
+      opcode_map.find(relocated_opcode);
+    if (it != opcode_map.end()) {
+      return it->second;
+    }
+    return -1;
+  #else
+    if (relocated_opcode >= 0 && relocated_opcode < NUM_AMX_FUSED_OPCODES) {
+      return relocated_opcode;
+    }
+    return -1;
+  #endif
+}
+
+const char *GetAMXOpcodeName(int opcode) {
+  if (opcode >= 0 && opcode < NUM_AMX_FUSED_OPCODES) {
+    return kOpcodeNames[opcode];
+  }
+  return nullptr;
+}
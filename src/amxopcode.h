@@ -74,11 +74,28 @@ enum AMXOpcode {
   AMX_OP_SWITCH,       AMX_OP_CASETBL,      AMX_OP_SWAP_PRI,
   AMX_OP_SWAP_ALT,     AMX_OP_PUSH_ADR,     AMX_OP_NOP,
   AMX_OP_SYSREQ_D,     AMX_OP_SYMTAG,       AMX_OP_BREAK,
-  AMX_OP_LAST_
+  AMX_OP_LAST_,
+  // Superinstructions (see amx_FuseOpcodes()).
+  AMX_OP_LOAD_S_PRI_PUSH = AMX_OP_LAST_,
+  AMX_OP_CONST_PRI_BOUNDS,
+  AMX_OP_PUSH2_C,
+  AMX_OP_FUSED_LAST_
 };
 
 const int NUM_AMX_OPCODES = AMX_OP_LAST_;
+const int NUM_AMX_FUSED_OPCODES = AMX_OP_FUSED_LAST_;
 
-cell RelocateAMXOpcode(cell opcode);
+// Returns the mnemonic of an opcode (or superinstruction), e.g. "load.s.pri",
+// or nullptr if the opcode is out of range.
+const char *GetAMXOpcodeName(int opcode);
+
+// Each variant of amx_Exec() has its own opcode addresses, so this needs the
+// flags of the AMX that the opcode belongs to.
+cell RelocateAMXOpcode(cell opcode, uint16_t amx_flags);
+
+// The reverse of RelocateAMXOpcode(): returns the opcode (possibly a
+// superinstruction) that a relocated opcode stands for, or -1 if it's not
+// a valid opcode.
+int UnrelocateAMXOpcode(cell relocated_opcode, uint16_t amx_flags);
 
 #endif // !AMXOPCODE_H
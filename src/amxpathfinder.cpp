@@ -22,49 +22,99 @@
 // ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
 // POSSIBILITY OF SUCH DAMAGE.
 
-#include <cstdlib>
+#include <algorithm>
+#include <cstdio>
 #include <cstring>
-#include <iterator>
-#include <list>
-#include <vector>
-#include <amx/amxaux.h>
+#include <thread>
 #include "amxpathfinder.h"
 #include "fileutils.h"
+#include "filewatcher.h"
+#include "threadpolicy.h"
 
-AMXPathFinder::AMXFile::AMXFile(const std::string &name)
- : amx_(reinterpret_cast<AMX*>(std::malloc(sizeof(*amx_)))),
-   name_(name),
-   mtime_(fileutils::GetModificationTime(name))
-{
-  if (amx_ != nullptr) {
-    if (aux_LoadProgram(amx_, name.c_str(), nullptr) != AMX_ERR_NONE) {
-      std::free(amx_);
-      amx_ = nullptr;
-    }
+// static
+bool AMXPathFinder::ReadHeader(const std::string &filename,
+                               AMX_HEADER &header) {
+  std::FILE *fp = std::fopen(filename.c_str(), "rb");
+  if (fp == nullptr) {
+    return false;
   }
+  bool ok = std::fread(&header, sizeof(header), 1, fp) == 1
+         && header.magic == AMX_MAGIC;
+  std::fclose(fp);
+  return ok;
 }
 
-AMXPathFinder::AMXFile::~AMXFile() {
-  if (amx_ != nullptr) {
-    aux_FreeProgram(amx_);
-    std::free(amx_);
+// static
+uint64_t AMXPathFinder::HashHeader(const AMX_HEADER &header) {
+  // 64-bit FNV-1a
+  const unsigned char *data = reinterpret_cast<const unsigned char *>(&header);
+  uint64_t hash = 14695981039346656037ULL;
+  for (std::size_t i = 0; i < sizeof(header); i++) {
+    hash ^= data[i];
+    hash *= 1099511628211ULL;
   }
+  return hash;
 }
 
-AMXPathFinder::~AMXPathFinder() {
-  for (StringToAMXFileMap::const_iterator mapIter = string_to_amx_file_.begin();
-      mapIter != string_to_amx_file_.end(); ++mapIter)
+void AMXPathFinder::AddSearchPath(std::string path) {
+  if (path.length() >= 2 && path.compare(path.length() - 2, 2, "**") == 0) {
+    path.erase(path.length() - 2);
+    while (path.length() > 1
+           && (path[path.length() - 1] == '/'
+               || path[path.length() - 1] == '\\')) {
+      path.erase(path.length() - 1);
+    }
+    AddSearchPathRecursive(path.empty() ? "." : path);
+    return;
+  }
+  SearchPath search_path;
+  search_path.path = path;
+  search_path.mtime = 0;
+  search_path.listed = false;
+  search_paths_.push_back(search_path);
+}
+
+void AMXPathFinder::AddSearchPathRecursive(const std::string &path) {
+  AddSearchPath(path);
+  std::vector<std::string> subdirectories;
+  fileutils::GetSubdirectories(path, subdirectories);
+  std::sort(subdirectories.begin(), subdirectories.end());
+  for (std::vector<std::string>::const_iterator it = subdirectories.begin();
+      it != subdirectories.end(); ++it)
   {
-    delete mapIter->second;
+    AddSearchPathRecursive(path + fileutils::kNativePathSepString + *it);
   }
 }
 
-void AMXPathFinder::AddSearchPath(std::string path) {
-  search_paths_.push_back(path);
+void AMXPathFinder::AddOpenedFile(const std::string &path) {
+  OpenedFile file;
+  file.path = path;
+  if (ReadHeader(path, file.header)) {
+    // If several files have the same header (copies of the same script),
+    // which one was used doesn't matter much.
+    std::lock_guard<std::mutex> lock(opened_files_mutex_);
+    opened_files_[HashHeader(file.header)] = file;
+  }
+}
+
+void AMXPathFinder::Forget(AMX *amx) {
+  amx_to_string_.erase(amx);
+}
+
+void AMXPathFinder::WatchSearchPaths() {
+  for (std::list<SearchPath>::const_iterator dir_iterator =
+         search_paths_.begin();
+      dir_iterator != search_paths_.end(); ++dir_iterator)
+  {
+    FileWatcher::shared().Watch(dir_iterator->path);
+  }
+  FileWatcher::shared().Start();
 }
 
-void AMXPathFinder::AddKnownFile(AMX *amx, std::string path) {
-  amx_to_string_[amx] = path;
+void AMXPathFinder::StartScan() {
+  if (!scan_.valid()) {
+    scan_ = std::async(std::launch::async, [this]() { Update(); });
+  }
 }
 
 std::string AMXPathFinder::Find(AMX *amx) {
@@ -74,51 +124,238 @@ std::string AMXPathFinder::Find(AMX *amx) {
     return cache_iterator->second;
   }
 
-  std::string result;
+  const AMX_HEADER &header = *reinterpret_cast<AMX_HEADER*>(amx->base);
+  {
+    std::lock_guard<std::mutex> lock(opened_files_mutex_);
+    OpenedFileMap::const_iterator opened_iterator =
+      opened_files_.find(HashHeader(header));
+    if (opened_iterator != opened_files_.end()
+        && std::memcmp(&header,
+                       &opened_iterator->second.header,
+                       sizeof(AMX_HEADER)) == 0) {
+      const std::string &path = opened_iterator->second.path;
+      amx_to_string_.insert(std::make_pair(amx, path));
+      return path;
+    }
+  }
 
-  // Load all .amx files in each of the current search paths (non-recursive).
-  for (std::list<std::string>::const_iterator dir_iterator = search_paths_.begin();
+  // Scripts loaded from memory, or opened in some other way.
+  if (scan_.valid()) {
+    scan_.get();
+  }
+  std::string result = Lookup(header);
+  if (result.empty()) {
+    Update();
+    result = Lookup(header);
+  }
+  if (!result.empty()) {
+    amx_to_string_.insert(std::make_pair(amx, result));
+  }
+  return result;
+}
+
+std::string AMXPathFinder::Lookup(const AMX_HEADER &header) const {
+  std::pair<HeaderIndex::const_iterator, HeaderIndex::const_iterator> range =
+    header_index_.equal_range(HashHeader(header));
+  for (HeaderIndex::const_iterator it = range.first;
+      it != range.second; ++it)
+  {
+    StringToAMXFileHeaderMap::const_iterator script_it =
+      string_to_amx_file_header_.find(it->second);
+    if (script_it != string_to_amx_file_header_.end()
+        && std::memcmp(&header,
+                       &script_it->second.header,
+                       sizeof(AMX_HEADER)) == 0) {
+      return it->second;
+    }
+  }
+  return std::string();
+}
+
+// Reads the headers of all .amx files in each of the current search paths
+// that are new or have been modified since the last time.
+void AMXPathFinder::Update() {
+  std::vector<FileUpdate> updates;
+  for (std::list<SearchPath>::iterator dir_iterator = search_paths_.begin();
       dir_iterator != search_paths_.end(); ++dir_iterator)
   {
-    std::vector<std::string> files;
-    fileutils::GetDirectoryFiles(*dir_iterator, "*.amx", files);
-
-    for (std::vector<std::string>::iterator file_iterator = files.begin();
-        file_iterator != files.end(); ++file_iterator)
-    {
-      std::string filename;
-      filename.append(*dir_iterator);
-      filename.append(fileutils::kNativePathSepString);
-      filename.append(*file_iterator);
-
-      std::time_t mtime = fileutils::GetModificationTime(filename);
-
-      StringToAMXFileMap::iterator script_it = string_to_amx_file_.find(filename);
-      if (script_it == string_to_amx_file_.end() ||
-          script_it->second->mtime() < mtime) {
-        if (script_it != string_to_amx_file_.end()) {
-          string_to_amx_file_.erase(script_it);
-        }
-        AMXFile *script = new AMXFile(filename);
-        if (script != nullptr && script->IsLoaded()) {
-          string_to_amx_file_.insert(std::make_pair(filename, script));
+    SearchPath &search_path = *dir_iterator;
+
+    // If the directory is watched, only the files that have changed need
+    // to be read (and the rest don't even need to be stat()'ed).
+    std::vector<std::string> changed_files;
+    bool listing_changed = false;
+    bool watched = FileWatcher::shared().TakeChanges(search_path.path,
+                                                     changed_files,
+                                                     listing_changed)
+                   && search_path.listed;
+    std::sort(changed_files.begin(), changed_files.end());
+
+    // Adding, removing or renaming files changes the directory's own
+    // modification time, but rewriting a file doesn't, so without a watcher
+    // the files are still checked one by one.
+    std::time_t dir_mtime = 0;
+    if (!watched) {
+      dir_mtime = fileutils::GetModificationTime(search_path.path);
+    }
+    // The listing includes the size and modification time of each file,
+    // so files don't have to be stat()'ed again right after that.
+    std::vector<fileutils::FileInfo> listed_files;
+    bool relisted = false;
+    if (!search_path.listed
+        || (watched && listing_changed)
+        || (!watched && dir_mtime != search_path.mtime)) {
+      fileutils::GetDirectoryFiles(search_path.path, "*.amx", listed_files);
+      std::sort(listed_files.begin(), listed_files.end(),
+                [](const fileutils::FileInfo &a,
+                   const fileutils::FileInfo &b) {
+                  return a.name < b.name;
+                });
+      std::vector<std::string> files;
+      files.reserve(listed_files.size());
+      for (std::size_t i = 0; i < listed_files.size(); i++) {
+        files.push_back(listed_files[i].name);
+      }
+      for (std::vector<std::string>::const_iterator file_iterator =
+             search_path.files.begin();
+          file_iterator != search_path.files.end(); ++file_iterator)
+      {
+        if (!std::binary_search(files.begin(), files.end(), *file_iterator)) {
+          RemoveFile(search_path.path
+                     + fileutils::kNativePathSepString
+                     + *file_iterator);
         }
       }
+      search_path.files.swap(files);
+      if (watched) {
+        dir_mtime = fileutils::GetModificationTime(search_path.path);
+      }
+      search_path.mtime = dir_mtime;
+      search_path.listed = true;
+      relisted = true;
+    }
+
+    for (std::size_t i = 0; i < search_path.files.size(); i++) {
+      const std::string &name = search_path.files[i];
+      // A file that was rewritten within the same second as the last time
+      // it was read looks the same by its modification time (unless its
+      // size has changed).
+      bool changed = std::binary_search(changed_files.begin(),
+                                        changed_files.end(),
+                                        name);
+      if (watched && !changed) {
+        continue;
+      }
+      AddFileUpdate(updates,
+                    search_path.path + fileutils::kNativePathSepString + name,
+                    changed,
+                    relisted ? &listed_files[i] : nullptr);
     }
   }
 
-  for (StringToAMXFileMap::const_iterator mapIter = string_to_amx_file_.begin();
-      mapIter != string_to_amx_file_.end(); ++mapIter)
+  CheckFiles(updates);
+
+  for (std::vector<FileUpdate>::iterator it = updates.begin();
+      it != updates.end(); ++it)
   {
-    const AMX *otherAmx = mapIter->second->amx();
-    if (std::memcmp(amx->base, otherAmx->base, sizeof(AMX_HEADER)) == 0) {
-      result = mapIter->first;
-      amx_to_string_.insert(std::make_pair(amx, result));
-      break;
+    if (!it->read) {
+      continue;
+    }
+    RemoveFile(it->filename);
+    if (it->ok) {
+      string_to_amx_file_header_.insert(
+        std::make_pair(it->filename, it->script));
+      header_index_.insert(
+        std::make_pair(HashHeader(it->script.header), it->filename));
     }
   }
+}
 
-  return result;
+void AMXPathFinder::AddFileUpdate(std::vector<FileUpdate> &updates,
+                                  const std::string &filename,
+                                  bool changed,
+                                  const fileutils::FileInfo *info) const {
+  FileUpdate update;
+  update.filename = filename;
+  update.changed = changed;
+  StringToAMXFileHeaderMap::const_iterator script_it =
+    string_to_amx_file_header_.find(filename);
+  update.cached = script_it != string_to_amx_file_header_.end();
+  update.cached_mtime = update.cached ? script_it->second.mtime : 0;
+  update.cached_size = update.cached ? script_it->second.size : 0;
+  update.listed = info != nullptr;
+  if (info != nullptr) {
+    update.info = *info;
+  }
+  update.read = false;
+  update.ok = false;
+  updates.push_back(update);
+}
+
+// static
+void AMXPathFinder::CheckFile(FileUpdate &update) {
+  if (!update.listed
+      && !fileutils::GetFileInfo(update.filename, update.info)) {
+    update.info.size = 0;
+    update.info.mtime = 0;
+  }
+  if (!update.changed
+      && update.cached
+      && update.cached_mtime >= update.info.mtime
+      && update.cached_size == update.info.size) {
+    return;
+  }
+  update.read = true;
+  update.script.mtime = update.info.mtime;
+  update.script.size = update.info.size;
+  update.ok = ReadHeader(update.filename, update.script.header);
+}
+
+// Checks the files on a few threads, since most of the time goes into
+// waiting for the disk (or a network share).
+// static
+void AMXPathFinder::CheckFiles(std::vector<FileUpdate> &updates) {
+  const std::size_t kMaxThreads = 4;
+  const std::size_t kMinFilesPerThread = 16;
+
+  std::size_t num_threads = std::min<std::size_t>(
+    std::max(std::thread::hardware_concurrency(), 1u),
+    kMaxThreads);
+  num_threads = std::min(num_threads,
+                         updates.size() / kMinFilesPerThread + 1);
+
+  std::vector<std::thread> threads;
+  for (std::size_t i = 1; i < num_threads; i++) {
+    threads.push_back(std::thread([&updates, i, num_threads]() {
+      ApplyThreadPolicy(THREAD_CLASS_WORKER);
+      for (std::size_t j = i; j < updates.size(); j += num_threads) {
+        CheckFile(updates[j]);
+      }
+    }));
+  }
+  for (std::size_t j = 0; j < updates.size(); j += num_threads) {
+    CheckFile(updates[j]);
+  }
+  for (std::size_t i = 0; i < threads.size(); i++) {
+    threads[i].join();
+  }
+}
+
+void AMXPathFinder::RemoveFile(const std::string &filename) {
+  StringToAMXFileHeaderMap::iterator script_it =
+    string_to_amx_file_header_.find(filename);
+  if (script_it == string_to_amx_file_header_.end()) {
+    return;
+  }
+  std::pair<HeaderIndex::iterator, HeaderIndex::iterator> range =
+    header_index_.equal_range(HashHeader(script_it->second.header));
+  for (HeaderIndex::iterator it = range.first; it != range.second; ++it) {
+    if (it->second == filename) {
+      header_index_.erase(it);
+      break;
+    }
+  }
+  string_to_amx_file_header_.erase(script_it);
 }
 
 // static
@@ -126,4 +363,3 @@ AMXPathFinder &AMXPathFinder::shared() {
   static AMXPathFinder instance;
   return instance;
 }
-
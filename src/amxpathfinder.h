@@ -25,59 +25,122 @@
 #ifndef AMXPATHFINDER_H
 #define AMXPATHFINDER_H
 
+#include <cstdint>
 #include <ctime>
+#include <future>
 #include <list>
 #include <map>
+#include <mutex>
 #include <string>
+#include <unordered_map>
+#include <vector>
 #include <amx/amx.h>
+#include "fileutils.h"
 
+// Finds the file that a script was loaded from by comparing its header to the
+// headers of the .amx files that the server has opened, or failing that, of
+// the .amx files in the search paths. Only the headers are read,
+// and they're indexed by their hash, so scripts that are already known are
+// found without touching the file system. The directories are scanned again
+// only when a script isn't found, and re-listed only if their modification
+// time has changed. If the search paths are watched (see FileWatcher), only
+// the files that have changed since the last scan are read.
 class AMXPathFinder {
  public:
-  ~AMXPathFinder();
-
+  // A path ending with "**" (e.g. "scripts/**") is searched recursively.
+  // Its subdirectories are found when it's added, so ones created later
+  // aren't searched.
   void AddSearchPath(std::string path);
-  void AddKnownFile(AMX *amx, std::string path);
+
+  // Remembers the header of a file the server is about to load a script
+  // from. This is called from the file open hooks, possibly on any thread
+  // (e.g. when debug info is loaded in the background).
+  void AddOpenedFile(const std::string &path);
+
+  // Starts watching the search paths added so far for changes.
+  void WatchSearchPaths();
+
+  // Reads the headers of the files in the search paths on a separate
+  // thread, so that they're (hopefully) ready by the time the first script
+  // is loaded. Find() waits for this to finish.
+  void StartScan();
 
   std::string Find(AMX *amx);
 
+  // Forgets the file found for a script, since another script may be
+  // loaded at the same address later.
+  void Forget(AMX *amx);
+
   static AMXPathFinder &shared();
 
  private:
-  std::list<std::string> search_paths_;
-
-  class AMXFile {
-   public:
-    explicit AMXFile(const std::string &name);
-    ~AMXFile();
-
-    bool IsLoaded() const { return amx_ != nullptr; }
-
-    const AMX *amx() const {
-      return amx_;
-    }
-    const std::string &name() const {
-      return name_;
-    }
-    std::time_t mtime() const {
-      return mtime_;
-    }
-
-   private:
-    AMXFile(const AMXFile &other);
-    AMXFile &operator=(const AMXFile &other);
-
-   private:
-    AMX *amx_;
-    std::string name_;
-    std::time_t mtime_;
+  struct SearchPath {
+    std::string path;
+    std::time_t mtime;
+    bool listed;
+    std::vector<std::string> files;
   };
 
+  struct AMXFileHeader {
+    AMX_HEADER header;
+    std::time_t mtime;
+    std::size_t size;
+  };
+
+  static bool ReadHeader(const std::string &filename, AMX_HEADER &header);
+  static uint64_t HashHeader(const AMX_HEADER &header);
+
+  // A file that may need to be read again, and the result.
+  struct FileUpdate {
+    std::string filename;
+    bool changed;
+    bool cached;
+    std::time_t cached_mtime;
+    std::size_t cached_size;
+    // Whether info is already known from listing the directory.
+    bool listed;
+    fileutils::FileInfo info;
+    bool read;
+    bool ok;
+    AMXFileHeader script;
+  };
+
+  static void CheckFile(FileUpdate &update);
+  static void CheckFiles(std::vector<FileUpdate> &updates);
+
+  void AddSearchPathRecursive(const std::string &path);
+  void Update();
+  void AddFileUpdate(std::vector<FileUpdate> &updates,
+                     const std::string &filename,
+                     bool changed,
+                     const fileutils::FileInfo *info) const;
+  void RemoveFile(const std::string &filename);
+  std::string Lookup(const AMX_HEADER &header) const;
+
  private:
-  typedef std::map<std::string, AMXFile*> StringToAMXFileMap;
-  StringToAMXFileMap string_to_amx_file_;
+  std::list<SearchPath> search_paths_;
+
+  typedef std::map<std::string, AMXFileHeader> StringToAMXFileHeaderMap;
+  StringToAMXFileHeaderMap string_to_amx_file_header_;
+
+  // Several files may have the same header (e.g. copies of a script).
+  typedef std::unordered_multimap<uint64_t, std::string> HeaderIndex;
+  HeaderIndex header_index_;
 
   typedef std::map<AMX*, std::string> AMXToStringMap;
   AMXToStringMap amx_to_string_;
+
+  // Files added with AddOpenedFile(), by header hash. Unlike the rest, this
+  // isn't touched by the scan thread, but has its own lock.
+  struct OpenedFile {
+    std::string path;
+    AMX_HEADER header;
+  };
+  typedef std::unordered_map<uint64_t, OpenedFile> OpenedFileMap;
+  OpenedFileMap opened_files_;
+  std::mutex opened_files_mutex_;
+
+  std::future<void> scan_;
 };
 
 #endif // AMXPATHFINDER_H
@@ -103,6 +103,17 @@ cell AMXRef::GetNativeIndex(const char *name) const {
   return -1;
 }
 
+cell AMXRef::FindNativeIndex(cell address) const {
+  int n = GetNumNatives();
+  const AMX_FUNCSTUBNT *natives = GetNatives();
+  for (int i = 0; i < n; i++) {
+    if (natives[i].address == static_cast<ucell>(address)) {
+      return i;
+    }
+  }
+  return -1;
+}
+
 cell AMXRef::GetPublicIndex(const char *name) const {
   int n = GetNumPublics();
   const AMX_FUNCSTUBNT *publics = GetPublics();
@@ -155,6 +166,19 @@ const char *AMXRef::GetPublicName(int index) const {
   return nullptr;
 }
 
+std::string AMXRef::GetDataString(cell address) const {
+  cell *ptr;
+  int length;
+  if (amx_GetAddr(amx_, address, &ptr) != AMX_ERR_NONE
+      || amx_StrLen(ptr, &length) != AMX_ERR_NONE) {
+    return std::string();
+  }
+  std::string string(length + 1, '\0');
+  amx_GetString(&string[0], ptr, 0, string.size());
+  string.resize(length);
+  return string;
+}
+
 const char *AMXRef::GetString(uint32_t offset) const {
   return reinterpret_cast<char*>(amx_->base + offset);
 }
@@ -25,6 +25,7 @@
 #ifndef AMXREF_H
 #define AMXREF_H
 
+#include <string>
 #include <amx/amx.h>
 
 class AMXRef {
@@ -47,6 +48,7 @@ class AMXRef {
 
   bool IsSysreqDEnabled() const { return amx_->sysreq_d != 0; }
   void SetSysreqDEnabled(bool is_enabled) { amx_->sysreq_d = is_enabled; };
+  cell GetSysreqDOpcode() const { return amx_->sysreq_d; }
 
   cell GetCip() const { return amx_->cip; }
   cell GetFrm() const { return amx_->frm; }
@@ -57,6 +59,7 @@ class AMXRef {
   cell GetPri() const { return amx_->pri; }
   cell GetAlt() const { return amx_->alt; }
 
+  void SetCip(cell cip) { amx_->cip = cip; }
   void SetFrm(cell frm) { amx_->frm = frm; }
   void SetHea(cell hea) { amx_->hea = hea; }
   void SetStk(cell stk) { amx_->stk = stk; }
@@ -78,6 +81,10 @@ class AMXRef {
   cell GetNativeIndex(const char *name) const;
   cell GetPublicIndex(const char *name) const;
 
+  // Returns the index of the native function with the specified address
+  // or -1 if there's no such native.
+  cell FindNativeIndex(cell address) const;
+
   cell GetNativeAddress(int index) const;
   cell GetPublicAddress(int index) const;
 
@@ -85,6 +92,10 @@ class AMXRef {
   const char *GetNativeName(int index) const;
   const char *GetPublicName(int index) const;
 
+  // Reads a packed or unpacked string stored at the specified data address.
+  // Returns an empty string if the address is invalid.
+  std::string GetDataString(cell address) const;
+
   cell GetStackSpaceLeft() const;
   bool CheckStack() const;
 
@@ -24,8 +24,9 @@
 
 #include <algorithm>
 #include <cassert>
+#include <cstdio>
+#include <cstring>
 #include <functional>
-#include <iomanip>
 #include <iostream>
 #include <iterator>
 #include <sstream>
@@ -35,6 +36,13 @@
 #include "amxopcode.h"
 #include "amxref.h"
 #include "amxstacktrace.h"
+#include "nativesignatures.h"
+
+#if defined __SSE2__ || defined _M_X64 \
+    || (defined _M_IX86_FP && _M_IX86_FP >= 2)
+  #define HAVE_SSE2
+  #include <emmintrin.h>
+#endif
 
 namespace {
 
@@ -157,12 +165,67 @@ AMXStackFrame AMXStackFrame::GetPrevious() const {
   return AMXStackFrame(amx_, GetPreviousFrameSafe(amx_, address_));
 }
 
+namespace {
+
+cell GetArgumentValue(AMXRef amx, cell frame_address, int index) {
+  cell arg_address = frame_address + (3 + index) * sizeof(cell);
+  return *reinterpret_cast<cell*>(amx.GetData() + arg_address);
+}
+
+cell GetArgumentValue(const AMXStackFrame &frame, int index) {
+  return GetArgumentValue(frame.amx(), frame.address(), index);
+}
+
+cell GetNumArguments(AMXRef amx, cell frame_address) {
+  cell num_args_address = frame_address + 2 * sizeof(cell);
+  cell num_bytes =
+    *reinterpret_cast<cell*>(amx.GetData() + num_args_address);
+  // Mote: num_bytes can be negative! e.g. YSI puts a negative count onto
+  // the stack to do its magic. Therefore, to get the below arithmetic to
+  // work correctly we need to make sure num_bytes is not converted to an
+  // unsigned integer (size_t) by explicitly casting the sizeof part to a
+  // signed type (cell).
+  return num_bytes / static_cast<cell>(sizeof(cell));
+}
+
+cell GetNumArguments(const AMXStackFrame &frame,
+                     const AMXStackFrame &prev_frame) {
+  cell num_args = GetNumArguments(frame.amx(), prev_frame.address());
+  if (num_args < 0) {
+    // For better compatibility with YSI, if the the count is negative use
+    // the count from the previous frame.
+    num_args = GetNumArguments(frame.amx(), prev_frame.GetPrevious().address());
+  }
+  return num_args;
+}
+
+} // anonymous namespace
+
+cell AMXStackFrame::GetArgumentValues(cell *values, cell max_values) const {
+  AMXStackFrame prev_frame = GetPrevious();
+  if (prev_frame.address() == 0) {
+    return 0;
+  }
+  cell num_args = GetNumArguments(*this, prev_frame);
+  for (cell i = 0; i < num_args && i < max_values; i++) {
+    values[i] = GetArgumentValue(prev_frame, i);
+  }
+  return num_args;
+}
+
 void AMXStackFrame::Print(std::ostream &stream,
                           const AMXDebugInfo &debug_info) const {
   AMXStackFramePrinter printer(stream, debug_info);
   printer.Print(*this);
 }
 
+void AMXStackFrame::Print(std::ostream &stream,
+                          const AMXDebugInfo &debug_info,
+                          AMXStackFrameCache *cache) const {
+  AMXStackFramePrinter printer(stream, debug_info, cache);
+  printer.Print(*this);
+}
+
 AMXStackTrace::AMXStackTrace(AMXRef amx, cell frame, int max_depth)
  : current_frame_(amx, frame),
    max_depth_(max_depth),
@@ -200,38 +263,71 @@ AMXStackTrace GetAMXStackTrace(AMXRef amx,
   return trace;
 }
 
-namespace {
+AMXStackWalkCache::AMXStackWalkCache() {
+}
 
-class IsArgumentOf : public std::unary_function<AMXDebugSymbol, bool> {
- public:
-  IsArgumentOf(cell function_address) : function_address_(function_address) {}
-  bool operator()(AMXDebugSymbol symbol) const {
-    return symbol.IsLocal() && symbol.GetCodeStart() == function_address_;
+const std::vector<AMXStackWalkCache::Frame> &AMXStackWalkCache::Walk(
+    AMXRef amx,
+    cell frm,
+    cell cip,
+    int max_depth) {
+  new_frames_.clear();
+
+  AMXStackTrace trace = GetAMXStackTrace(amx, frm, cip, max_depth);
+  while (static_cast<int>(new_frames_.size()) < max_depth) {
+    const AMXStackFrame &current = trace.current_frame();
+    if (current.return_address() == 0) {
+      break;
+    }
+    Frame frame;
+    frame.address = current.address();
+    frame.return_address = current.return_address();
+    frame.previous_frame = GetPreviousFrameSafe(amx, current.address());
+    frame.caller_address = current.caller_address();
+
+    // The topmost frame is made up by GetAMXStackTrace() from frm and cip,
+    // so it's never taken from the cache.
+    std::size_t index = frames_.size();
+    if (!new_frames_.empty()) {
+      index = FindFrame(frame);
+    }
+    if (index < frames_.size()) {
+      std::size_t count = std::min(frames_.size() - index,
+                                   max_depth - new_frames_.size());
+      new_frames_.insert(new_frames_.end(),
+                         frames_.begin() + index,
+                         frames_.begin() + index + count);
+      break;
+    }
+    new_frames_.push_back(frame);
+    if (!trace.MoveNext()) {
+      break;
+    }
   }
- private:
-  cell function_address_;
-};
 
-cell GetArgumentValue(AMXRef amx, cell frame_address, int index) {
-  cell arg_address = frame_address + (3 + index) * sizeof(cell);
-  return *reinterpret_cast<cell*>(amx.GetData() + arg_address);
+  frames_.swap(new_frames_);
+  return frames_;
 }
 
-cell GetArgumentValue(const AMXStackFrame &frame, int index) {
-  return GetArgumentValue(frame.amx(), frame.address(), index);
+// Returns the index of the cached frame that is the same as frame, or the
+// number of cached frames if there's none.
+std::size_t AMXStackWalkCache::FindFrame(const Frame &frame) const {
+  for (std::size_t i = 0; i < frames_.size(); i++) {
+    const Frame &cached = frames_[i];
+    if (cached.address == frame.address
+        && cached.return_address == frame.return_address
+        && cached.previous_frame == frame.previous_frame) {
+      return i;
+    }
+    if (cached.address > frame.address) {
+      // The stack grows down, so the remaining frames are all older.
+      break;
+    }
+  }
+  return frames_.size();
 }
 
-cell GetNumArguments(AMXRef amx, cell frame_address) {
-  cell num_args_address = frame_address + 2 * sizeof(cell);
-  cell num_bytes =
-    *reinterpret_cast<cell*>(amx.GetData() + num_args_address);
-  // Mote: num_bytes can be negative! e.g. YSI puts a negative count onto
-  // the stack to do its magic. Therefore, to get the below arithmetic to
-  // work correctly we need to make sure num_bytes is not converted to an
-  // unsigned integer (size_t) by explicitly casting the sizeof part to a
-  // signed type (cell).
-  return num_bytes / static_cast<cell>(sizeof(cell));
-}
+namespace {
 
 bool IsPrintableChar(char c) {
   return (c >= 32 && c <= 126);
@@ -256,54 +352,173 @@ cell GetMaxStringSize(AMXRef amx, cell address) {
   return amx.GetHeader()->stp - address;
 }
 
-std::string GetPackedString(const cell *string, std::size_t size) {
-  std::string s;
-  for (std::size_t i = 0; i < size; i++) {
-    cell cp = string[i / sizeof(cell)] >>
-              ((sizeof(cell) - i % sizeof(cell) - 1) * 8);
-    char cu = IsPrintableChar(cp) ? cp : '\0';
-    if (cu == '\0') {
-      break;
-    }
-    s.push_back(cu);
+char GetStringChar(const cell *string, std::size_t index, bool packed) {
+  if (packed) {
+    cell cp = string[index / sizeof(cell)] >>
+              ((sizeof(cell) - index % sizeof(cell) - 1) * 8);
+    return IsPrintableChar(cp) ? cp : '\0';
   }
-  return s;
+  return IsPrintableChar(string[index]) ? string[index] : '\0';
 }
 
-std::string GetUnpackedString(const cell *string, std::size_t size) {
-  std::string s;
-  for (std::size_t i = 0; i < size; i++) {
-    char c = IsPrintableChar(string[i]) ? string[i] : '\0';
+// Maximum number of characters printed for string arguments.
+const std::size_t kMaxString = 80;
+
+// Copies the characters of a string into buffer until there's one that
+// GetStringChar() would turn into '\0' or length characters have been
+// copied. Returns the number of characters copied.
+std::size_t NarrowString(const cell *ptr, bool packed, std::size_t length,
+                         char *buffer) {
+  std::size_t i = 0;
+  if (packed) {
+    // Characters are stored starting from the most significant byte.
+    for (; i + sizeof(cell) <= length; i += sizeof(cell)) {
+      ucell c = static_cast<ucell>(ptr[i / sizeof(cell)]);
+      for (std::size_t j = 0; j < sizeof(cell); j++) {
+        char b = static_cast<char>(c >> ((sizeof(cell) - j - 1) * 8));
+        if (!IsPrintableChar(b)) {
+          return i + j;
+        }
+        buffer[i + j] = b;
+      }
+    }
+  } else {
+#ifdef HAVE_SSE2
+    // Four cells at a time: only the low byte of each cell matters.
+    const __m128i low_byte = _mm_set1_epi32(0xFF);
+    const __m128i min = _mm_set1_epi32(31);
+    const __m128i max = _mm_set1_epi32(127);
+    for (; i + 4 <= length; i += 4) {
+      __m128i c = _mm_and_si128(
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(ptr + i)),
+        low_byte);
+      __m128i printable = _mm_and_si128(_mm_cmpgt_epi32(c, min),
+                                        _mm_cmplt_epi32(c, max));
+      if (_mm_movemask_epi8(printable) != 0xFFFF) {
+        break;
+      }
+      __m128i words = _mm_packs_epi32(c, c);
+      __m128i bytes = _mm_packus_epi16(words, words);
+      int32_t chars = _mm_cvtsi128_si32(bytes);
+      std::memcpy(buffer + i, &chars, 4);
+    }
+#endif
+  }
+  for (; i < length; i++) {
+    char c = GetStringChar(ptr, i, packed);
     if (c == '\0') {
       break;
     }
-    s.push_back(c);
+    buffer[i] = c;
   }
-  return s;
+  return i;
 }
 
-void GetStringContents(AMXRef amx, cell address, std::size_t size,
-                       std::string &string, bool &packed) {
+// Prints at most max_length characters of a string. If the string doesn't
+// end within size characters and mark_unterminated is set, it's assumed to
+// be cut off and "..." is printed after it.
+void PrintString(AMXTextWriter &stream, const cell *ptr, bool packed,
+                 std::size_t size, std::size_t max_length,
+                 bool mark_unterminated) {
+  char buffer[kMaxString];
+  max_length = std::min(max_length, kMaxString);
+  std::size_t limit = std::min(size, max_length);
+  std::size_t length = NarrowString(ptr, packed, limit, buffer);
+  stream.Write(buffer, length);
+  if (length < limit) {
+    return;
+  }
+  if (length < size) {
+    // There's more, unless the next character ends the string.
+    if (GetStringChar(ptr, length, packed) != '\0') {
+      stream << "...";
+    }
+  } else if (mark_unterminated) {
+    stream << "...";
+  }
+}
 
+// Prints a quoted string stored in the AMX data section, truncated to
+// max_length characters. Characters are written to the stream directly to
+// avoid making a copy of the string.
+void PrintStringContents(AMXTextWriter &stream, AMXRef amx, cell address,
+                         std::size_t size, std::size_t max_length) {
   cell *ptr = GetDataPtr(amx, address);
+  bool packed = ptr != nullptr && IsPackedString(ptr);
+
+  stream << (packed ? " !" : " ") << "\"";
   if (ptr != nullptr) {
-    packed = IsPackedString(ptr);
     if (size == 0) {
       size = GetMaxStringSize(amx, address);
     }
+    PrintString(stream, ptr, packed, size, max_length, false);
+  }
+  stream << "\"";
+}
+
+// Same as PrintStringContents() but for a string copied with
+// AMXStackFrame::GetArgumentData().
+void PrintCapturedStringContents(AMXTextWriter &stream, const cell *data,
+                                 cell data_size, std::size_t max_length) {
+  bool packed = IsPackedString(data);
+  std::size_t size = data_size * (packed ? sizeof(cell) : 1);
+
+  stream << (packed ? " !" : " ") << "\"";
+  PrintString(stream, data, packed, size, max_length, true);
+  stream << "\"";
+}
+
+// Tries to filter out non-printable arrays (e.g. non-strings). This doesn't
+// work 100% of the time, but it's better than nothing.
+bool IsStringArgument(const AMXDebugInfo &debug_info,
+                      const AMXDebugSymbol &arg) {
+  if (!arg.IsArray() && !arg.IsArrayRef()) {
+    return false;
+  }
+  AMXDebugSymbolDimList dims = arg.GetDimList();
+  return dims.size() == 1
+         && std::strcmp(debug_info.GetTagNamePtr(arg.GetTag()), "_") == 0
+         && std::strcmp(debug_info.GetTagNamePtr(dims[0].GetTag()), "_") == 0;
+}
+
+// Returns the number of cells taken by a string, including the terminating
+// cell, or max_cells if it's longer than that.
+cell GetStringCells(const cell *ptr, cell max_cells) {
+  bool packed = IsPackedString(ptr);
+  cell i = 0;
+#ifdef HAVE_SSE2
+  // Look for a zero cell (or a zero byte in a packed string) in four cells
+  // at a time, the loop below finds where exactly it is.
+  const __m128i zero = _mm_setzero_si128();
+  for (; i + 4 <= max_cells; i += 4) {
+    __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ptr + i));
+    __m128i is_zero = packed ? _mm_cmpeq_epi8(c, zero)
+                             : _mm_cmpeq_epi32(c, zero);
+    if (_mm_movemask_epi8(is_zero) != 0) {
+      break;
+    }
+  }
+#endif
+  for (; i < max_cells; i++) {
     if (packed) {
-      string = GetPackedString(ptr, size);
-    } else {
-      string = GetUnpackedString(ptr, size);
+      ucell c = static_cast<ucell>(ptr[i]);
+      for (std::size_t j = 0; j < sizeof(cell); j++, c >>= 8) {
+        if ((c & 0xFF) == 0) {
+          return i + 1;
+        }
+      }
+    } else if (ptr[i] == 0) {
+      return i + 1;
     }
   }
+  return max_cells;
 }
 
 cell GetStateVarAddress(AMXRef amx, cell function_address) {
   if (IsCodeAddress(amx, function_address) &&
       IsCodeAddress(amx, function_address + sizeof(cell))) {
     cell opcode = *reinterpret_cast<cell*>(amx.GetCode() + function_address);
-    if (opcode == RelocateAMXOpcode(AMX_OP_LOAD_PRI)) {
+    if (UnrelocateAMXOpcode(opcode, amx.GetFlags()) == AMX_OP_LOAD_PRI) {
       return *reinterpret_cast<cell*>(amx.GetCode() + function_address
                                       + sizeof(cell));
     }
@@ -311,10 +526,6 @@ cell GetStateVarAddress(AMXRef amx, cell function_address) {
   return -1;
 }
 
-bool UsesAutomata(const AMXStackFrame &frame) {
-  return GetStateVarAddress(frame.amx(), frame.caller_address()) > 0;
-}
-
 class CaseTable {
  public:
   struct Record {
@@ -357,42 +568,83 @@ cell GetStateTableAddressSafe(AMXRef amx, cell function_address) {
   return 0;
 }
 
-cell GetRealFunctionAddress(AMXRef amx,
-                            cell function_address,
-                            cell return_address) {
+void ReadStateSwitch(AMXRef amx,
+                     cell function_address,
+                     AMXStateSwitch &state_switch) {
+  state_switch.state_var = 0;
+  state_switch.records.clear();
+
+  cell state_var = GetStateVarAddress(amx, function_address);
+  if (state_var <= 0) {
+    return;
+  }
+  state_switch.state_var = state_var;
+
   cell state_table_address = GetStateTableAddressSafe(amx, function_address);
   if (state_table_address != 0) {
     CaseTable state_table(amx, state_table_address);
+    state_switch.records.resize(state_table.GetNumRecords());
     for (int i = 0; i < state_table.GetNumRecords(); i++) {
-      if (state_table.GetAddressAt(i) > return_address) {
-        return state_table.GetAddressAt(i - (i > 0));
-      }
+      state_switch.records[i].state = state_table.GetValueAt(i);
+      state_switch.records[i].address = state_table.GetAddressAt(i);
+    }
+  }
+}
+
+// Returns the state switch of the frame's function, from the cache if
+// there is one. Otherwise it's decoded into temp.
+const AMXStateSwitch &GetStateSwitch(const AMXStackFrame &frame,
+                                     AMXStackFrameCache *cache,
+                                     AMXStateSwitch &temp) {
+  if (cache != nullptr) {
+    const AMXStateSwitch *state_switch =
+      cache->FindStateSwitch(frame.caller_address());
+    if (state_switch == nullptr) {
+      ReadStateSwitch(frame.amx(), frame.caller_address(), temp);
+      state_switch = &cache->AddStateSwitch(frame.caller_address(), temp);
+    }
+    return *state_switch;
+  }
+  ReadStateSwitch(frame.amx(), frame.caller_address(), temp);
+  return temp;
+}
+
+cell GetRealFunctionAddress(const AMXStateSwitch &state_switch,
+                            cell return_address) {
+  const std::vector<AMXStateSwitch::Record> &records = state_switch.records;
+  for (std::size_t i = 0; i < records.size(); i++) {
+    if (records[i].address > return_address) {
+      return records[i - (i > 0)].address;
     }
   }
   return -1;
 }
 
-std::vector<cell> GetStateIDs(AMXRef amx,
-                              cell function_address,
+// Despite that the symbol's code start address points at the state switch
+// code block, function arguments actually use the real function address
+// for the code start because in different states they may be not the same.
+cell GetArgumentCodeStart(const AMXStackFrame &frame,
+                          const AMXStateSwitch &state_switch) {
+  if (state_switch.state_var > 0) {
+    return GetRealFunctionAddress(state_switch, frame.return_address());
+  }
+  return frame.caller_address();
+}
+
+std::vector<cell> GetStateIDs(const AMXStateSwitch &state_switch,
                               cell return_address) {
   std::vector<cell> states;
 
-  cell real_address = GetRealFunctionAddress(amx, function_address,
-                                                  return_address);
+  cell real_address = GetRealFunctionAddress(state_switch, return_address);
   if (real_address == 0) {
     return states;
   }
 
-  cell state_table_address = GetStateTableAddressSafe(amx, function_address);
-  if (state_table_address == 0) {
-    return states;
-  }
-
-  CaseTable state_table(amx, state_table_address);
-  for (int i = 0; i < state_table.GetNumRecords(); i++) {
-    if (state_table.GetAddressAt(i) == real_address) {
+  const std::vector<AMXStateSwitch::Record> &records = state_switch.records;
+  for (std::size_t i = 0; i < records.size(); i++) {
+    if (records[i].address == real_address) {
       if (i > 0) {
-        states.push_back(state_table.GetValueAt(i));
+        states.push_back(records[i].state);
       } else {
         states.push_back(0); // fallback
       }
@@ -409,41 +661,228 @@ std::vector<cell> GetStateIDs(AMXRef amx,
 
 } // anonymous namespace
 
-AMXStackFramePrinter::AMXStackFramePrinter(std::ostream &stream,
-                                           const AMXDebugInfo &debug_info)
-  : stream_(stream),
-    debug_info_(debug_info)
+const int AMXArgumentData::kMaxArgs;
+const int AMXArgumentData::kMaxCells;
+
+void AMXStackFrame::GetArgumentData(const AMXDebugInfo &debug_info,
+                                    const cell *values,
+                                    cell num_values,
+                                    AMXArgumentData *data,
+                                    AMXStackFrameCache *cache) const {
+  std::memset(data->sizes, 0, sizeof(data->sizes));
+  if (!debug_info.IsLoaded()) {
+    return;
+  }
+
+  AMXStateSwitch temp;
+  AMXDebugSymbolList args = debug_info.GetArguments(
+    GetArgumentCodeStart(*this, GetStateSwitch(*this, cache, temp)));
+  cell num_args = std::min<cell>(num_values, args.size());
+  cell num_cells = 0;
+
+  for (cell i = 0; i < num_args && i < AMXArgumentData::kMaxArgs; i++) {
+    const AMXDebugSymbol &arg = args[i];
+    if (arg.IsVariable()) {
+      continue;
+    }
+    const cell *ptr = GetDataPtr(amx_, values[i]);
+    if (ptr == nullptr) {
+      continue;
+    }
+    cell room = AMXArgumentData::kMaxCells - num_cells;
+    cell size = 0;
+    if (arg.IsReference()) {
+      size = std::min<cell>(room, 1);
+    } else if (IsStringArgument(debug_info, arg)) {
+      cell max_size = GetMaxStringSize(amx_, values[i]) / sizeof(cell);
+      size = GetStringCells(ptr, std::min(room, max_size));
+    }
+    if (size > 0) {
+      std::memcpy(data->cells + num_cells, ptr, size * sizeof(cell));
+      data->offsets[i] = static_cast<unsigned char>(num_cells);
+      data->sizes[i] = static_cast<unsigned char>(size);
+      num_cells += size;
+    }
+  }
+}
+
+void GetNativeArgumentData(AMXRef amx,
+                           const NativeSignature &signature,
+                           const cell *values,
+                           cell num_values,
+                           AMXArgumentData *data) {
+  std::memset(data->sizes, 0, sizeof(data->sizes));
+  cell num_args =
+    std::min<cell>(num_values, signature.params.size());
+  cell num_cells = 0;
+
+  for (cell i = 0; i < num_args && i < AMXArgumentData::kMaxArgs; i++) {
+    const NativeParam &param = signature.params[i];
+    if (param.kind != NativeParam::REFERENCE
+        && param.kind != NativeParam::STRING) {
+      continue;
+    }
+    const cell *ptr = GetDataPtr(amx, values[i]);
+    if (ptr == nullptr) {
+      continue;
+    }
+    cell room = AMXArgumentData::kMaxCells - num_cells;
+    cell size;
+    if (param.kind == NativeParam::REFERENCE) {
+      size = std::min<cell>(room, 1);
+    } else {
+      cell max_size = GetMaxStringSize(amx, values[i]) / sizeof(cell);
+      size = GetStringCells(ptr, std::min(room, max_size));
+    }
+    if (size > 0) {
+      std::memcpy(data->cells + num_cells, ptr, size * sizeof(cell));
+      data->offsets[i] = static_cast<unsigned char>(num_cells);
+      data->sizes[i] = static_cast<unsigned char>(size);
+      num_cells += size;
+    }
+  }
+}
+
+AMXStackFrameCache::Table::Table() {
+  Clear();
+}
+
+const std::string *AMXStackFrameCache::Table::Find(cell address) const {
+  const Entry &entry = entries_[GetIndex(address)];
+  if (entry.valid && entry.address == address) {
+    return &entry.text;
+  }
+  return nullptr;
+}
+
+const std::string &AMXStackFrameCache::Table::Add(cell address,
+                                                  const std::string &text) {
+  Entry &entry = entries_[GetIndex(address)];
+  entry.valid = true;
+  entry.address = address;
+  entry.text.assign(text);
+  return entry.text;
+}
+
+void AMXStackFrameCache::Table::Clear() {
+  for (std::size_t i = 0; i < kSize; i++) {
+    entries_[i].valid = false;
+  }
+}
+
+AMXStackFrameCache::AMXStackFrameCache() {
+}
+
+void AMXStackFrameCache::Clear() {
+  caller_names_.Clear();
+  source_locations_.Clear();
+  state_switches_.clear();
+}
+
+void AMXTextWriter::Write(const char *s, std::size_t length) {
+  if (string_ != nullptr) {
+    string_->append(s, length);
+  } else {
+    stream_->write(s, static_cast<std::streamsize>(length));
+  }
+}
+
+void AMXTextWriter::WriteInt(long long value) {
+  if (value < 0) {
+    Write("-", 1);
+    // Negate as unsigned so that the smallest value doesn't overflow.
+    WriteUnsigned(0ULL - static_cast<unsigned long long>(value));
+  } else {
+    WriteUnsigned(static_cast<unsigned long long>(value));
+  }
+}
+
+void AMXTextWriter::WriteUnsigned(unsigned long long value) {
+  char buffer[20];
+  char *end = buffer + sizeof(buffer);
+  char *p = end;
+  do {
+    *--p = static_cast<char>('0' + value % 10);
+    value /= 10;
+  } while (value != 0);
+  Write(p, end - p);
+}
+
+void AMXTextWriter::WriteHex(ucell value, int width) {
+  static const char kDigits[] = "0123456789abcdef";
+  char buffer[16];
+  char *end = buffer + sizeof(buffer);
+  char *p = end;
+  do {
+    *--p = kDigits[value & 0xF];
+    value >>= 4;
+  } while (value != 0);
+  while (end - p < width && p > buffer) {
+    *--p = '0';
+  }
+  Write(p, end - p);
+}
+
+void AMXTextWriter::WriteFloat(float value, int precision) {
+  char buffer[64];
+  int length = std::snprintf(buffer, sizeof(buffer), "%.*f",
+                             precision, static_cast<double>(value));
+  if (length > 0) {
+    // Huge values don't fit, but neither would they be useful.
+    Write(buffer, std::min<std::size_t>(length, sizeof(buffer) - 1));
+  }
+}
+
+AMXStackFramePrinter::AMXStackFramePrinter(AMXTextWriter out,
+                                           const AMXDebugInfo &debug_info,
+                                           AMXStackFrameCache *cache)
+  : out_(out),
+    debug_info_(debug_info),
+    cache_(cache)
 {
 }
 
 void AMXStackFramePrinter::Print(const AMXStackFrame &frame) {
   PrintReturnAddress(frame);
-  stream_ << " in ";
+  out_ << " in ";
 
   PrintCallerNameAndArguments(frame);
+  PrintStateAndLocation(frame);
+}
+
+void AMXStackFramePrinter::Print(const AMXStackFrame &frame,
+                                 const cell *values,
+                                 cell num_values,
+                                 cell num_args,
+                                 const AMXArgumentData *data) {
+  PrintReturnAddress(frame);
+  out_ << " in ";
 
-  if (debug_info_.IsLoaded() && UsesAutomata(frame)) {
-    stream_ << " ";
+  PrintCallerNameAndArguments(frame, values, num_values, num_args, data);
+  PrintStateAndLocation(frame);
+}
+
+void AMXStackFramePrinter::PrintStateAndLocation(const AMXStackFrame &frame) {
+  if (debug_info_.IsLoaded() && GetStateSwitch(frame).state_var > 0) {
+    out_ << " ";
     PrintState(frame);
   }
 
   if (debug_info_.IsLoaded() && frame.return_address() != 0) {
-    stream_ << " at ";
+    out_ << " at ";
     PrintSourceLocation(frame.return_address());
   }
 }
 
 void AMXStackFramePrinter::PrintTag(const AMXDebugSymbol &symbol) {
-  std::string tag_name = debug_info_.GetTagName(symbol.GetTag());
-  if (!tag_name.empty() && tag_name != "_") {
-    stream_ << tag_name << ":";
+  const char *tag_name = debug_info_.GetTagNamePtr(symbol.GetTag());
+  if (tag_name[0] != '\0' && std::strcmp(tag_name, "_") != 0) {
+    out_ << tag_name << ":";
   }
 }
 
 void AMXStackFramePrinter::PrintAddress(cell address) {
-  char old_fill = stream_.fill('0');
-  stream_ << std::hex << std::setw(sizeof(cell) * 2) << address << std::dec;
-  stream_.fill(old_fill);
+  out_.WriteHex(static_cast<ucell>(address), sizeof(cell) * 2);
 }
 
 void AMXStackFramePrinter::PrintReturnAddress(const AMXStackFrame &frame) {
@@ -451,8 +890,19 @@ void AMXStackFramePrinter::PrintReturnAddress(const AMXStackFrame &frame) {
 }
 
 void AMXStackFramePrinter::PrintCallerName(const AMXStackFrame &frame) {
+  if (cache_ != nullptr) {
+    const std::string *name = cache_->FindCallerName(frame.caller_address());
+    if (name == nullptr) {
+      std::string new_name;
+      AMXStackFramePrinter(new_name, debug_info_).PrintCallerName(frame);
+      name = &cache_->AddCallerName(frame.caller_address(), new_name);
+    }
+    out_ << *name;
+    return;
+  }
+
   if (IsMain(frame.amx(), frame.caller_address())) {
-    stream_ << "main";
+    out_ << "main";
     return;
   }
 
@@ -465,10 +915,10 @@ void AMXStackFramePrinter::PrintCallerName(const AMXStackFrame &frame) {
     if (caller) {
       if (IsPublicFunction(frame.amx(), caller.GetCodeStart())
           && !IsMain(frame.amx(), caller.GetCodeStart())) {
-        stream_ << "public ";
+        out_ << "public ";
       }
       PrintTag(caller);
-      stream_ << caller.GetName();
+      out_ << caller.GetNamePtr();
       return;
     }
   }
@@ -478,18 +928,18 @@ void AMXStackFramePrinter::PrintCallerName(const AMXStackFrame &frame) {
     name = frame.amx().FindPublic(frame.caller_address());
   }
   if (name != nullptr) {
-    stream_ << "public " << name;
+    out_ << "public " << name;
   } else {
-    stream_ << "??";
+    out_ << "??";
   }
 }
 
 void AMXStackFramePrinter::PrintCallerNameAndArguments(
     const AMXStackFrame &frame) {
   PrintCallerName(frame);
-  stream_ << " (";
+  out_ << " (";
   PrintArgumentList(frame);
-  stream_ << ")";
+  out_ << ")";
 }
 
 void AMXStackFramePrinter::PrintArgument(const AMXStackFrame &frame,
@@ -500,53 +950,84 @@ void AMXStackFramePrinter::PrintArgument(const AMXStackFrame &frame,
 void AMXStackFramePrinter::PrintArgument(const AMXStackFrame &frame,
                                          const AMXDebugSymbol &arg,
                                          int index) {
+  PrintArgumentName(arg);
+  out_ << "=";
+  PrintArgumentValue(frame, arg, index);
+}
+
+void AMXStackFramePrinter::PrintArgument(const AMXDebugSymbol &arg,
+                                         cell value,
+                                         const cell *data,
+                                         cell data_size) {
+  const char *tag_name = debug_info_.GetTagNamePtr(arg.GetTag());
+
+  PrintArgumentName(arg);
+  out_ << "=";
+  if (arg.IsVariable()) {
+    PrintValue(tag_name, value);
+    return;
+  }
+
+  out_ << "@";
+  PrintAddress(value);
+
+  if (data_size > 0) {
+    if (arg.IsReference()) {
+      out_ << " ";
+      PrintValue(tag_name, data[0]);
+    } else if (IsStringArgument(debug_info_, arg)) {
+      PrintCapturedStringContents(out_, data, data_size, kMaxString);
+    }
+  }
+}
+
+void AMXStackFramePrinter::PrintArgumentName(const AMXDebugSymbol &arg) {
   if (arg.IsReference()) {
-    stream_ << "&";
+    out_ << "&";
   }
 
   PrintTag(arg);
-  stream_ << arg.GetName();
+  out_ << arg.GetNamePtr();
 
   if (!arg.IsVariable()) {
-    std::vector<AMXDebugSymbolDim> dims = arg.GetDims();
+    AMXDebugSymbolDimList dims = arg.GetDimList();
 
     if (arg.IsArray() || arg.IsArrayRef()) {
       for (std::size_t i = 0; i < dims.size(); ++i) {
         if (dims[i].GetSize() == 0) {
-          stream_ << "[]";
+          out_ << "[]";
         } else {
-          std::string tag = debug_info_.GetTagName(dims[i].GetTag()) + ":";
-          if (tag == "_:") tag.clear();
-          stream_ << "[" << tag << dims[i].GetSize() << "]";
+          const char *tag = debug_info_.GetTagNamePtr(dims[i].GetTag());
+          out_ << "[";
+          if (std::strcmp(tag, "_") != 0) {
+            out_ << tag << ":";
+          }
+          out_ << dims[i].GetSize() << "]";
         }
       }
     }
   }
-
-  stream_ << "=";
-  PrintArgumentValue(frame, arg, index);
 }
 
-void AMXStackFramePrinter::PrintValue(const std::string &tag_name,
-                                      cell value) {
-  if (tag_name == "bool") {
-    stream_ << (value ? "true" : "false");
-  } else if (tag_name == "Float") {
-    stream_ << std::fixed << std::setprecision(5) << amx_ctof(value);
+void AMXStackFramePrinter::PrintValue(const char *tag_name, cell value) {
+  if (std::strcmp(tag_name, "bool") == 0) {
+    out_ << (value ? "true" : "false");
+  } else if (std::strcmp(tag_name, "Float") == 0) {
+    out_.WriteFloat(amx_ctof(value), 5);
   } else {
-    stream_ << value;
+    out_ << value;
   }
 }
 
 void AMXStackFramePrinter::PrintArgumentValue(const AMXStackFrame &frame,
                                               int index) {
-  stream_ << GetArgumentValue(frame, index);
+  out_ << GetArgumentValue(frame, index);
 }
 
 void AMXStackFramePrinter::PrintArgumentValue(const AMXStackFrame &frame,
                                               const AMXDebugSymbol &arg,
                                               int index) {
-  std::string tag_name = debug_info_.GetTagName(arg.GetTag());
+  const char *tag_name = debug_info_.GetTagNamePtr(arg.GetTag());
   cell value = GetArgumentValue(frame, index);
 
   if (arg.IsVariable()) {
@@ -554,39 +1035,20 @@ void AMXStackFramePrinter::PrintArgumentValue(const AMXStackFrame &frame,
     return;
   }
 
-  stream_ << "@";
+  out_ << "@";
   PrintAddress(value);
 
   if (arg.IsReference()) {
     if (cell *ptr = GetDataPtr(frame.amx(), value)) {
-      stream_ << " ";
+      out_ << " ";
       PrintValue(tag_name, *ptr);
     }
     return;
   }
 
-  if (arg.IsArray() || arg.IsArrayRef()) {
-    std::vector<AMXDebugSymbolDim> dims = arg.GetDims();
-
-    // Try to filter out non-printable arrays (e.g. non-strings).
-    // This doesn't work 100% of the time, but it's better than nothing.
-    if (dims.size() == 1
-        && tag_name == "_"
-        && debug_info_.GetTagName(dims[0].GetTag()) == "_")
-    {
-      std::string string;
-      bool packed = false;
-
-      GetStringContents(frame.amx(), value, dims[0].GetSize(), string, packed);
-      stream_ << (packed ? " !" : " ");
-
-      static const std::size_t kMaxString = 80;
-      if (string.length() > kMaxString) {
-        string.replace(kMaxString, string.length() - kMaxString, "...");
-      }
-
-      stream_ << "\"" << string << "\"";
-    }
+  if (IsStringArgument(debug_info_, arg)) {
+    PrintStringContents(out_, frame.amx(), value,
+                        arg.GetDimList()[0].GetSize(), kMaxString);
   }
 }
 
@@ -597,41 +1059,19 @@ void AMXStackFramePrinter::PrintArgumentList(const AMXStackFrame &frame) {
     return;
   }
 
-  // Despite that the symbol's code start address points at the state switch
-  // code block, function arguments actually use the real function address
-  // for the code start because in different states they may be not the same.
-  // So we start by determining the address of the function.
-  cell func_address = frame.caller_address();
-  if (UsesAutomata(frame)) {
-    func_address = GetRealFunctionAddress(frame.amx(),
-                                          frame.caller_address(),
-                                          frame.return_address());
-  }
-
-  std::vector<AMXDebugSymbol> args;
-  cell num_actual_args = GetNumArguments(frame.amx(), prev_frame.address());
-  if (num_actual_args < 0) {
-    // For better compatibility with YSI, if the the count is negative use
-    // the count from the previous frame.
-    num_actual_args =
-      GetNumArguments(frame.amx(), prev_frame.GetPrevious().address());
-  }
+  cell num_actual_args = GetNumArguments(frame, prev_frame);
   cell num_printed_args = std::min(10, num_actual_args);
 
-  if (debug_info_.IsLoaded()) {
-    std::remove_copy_if(debug_info_.GetSymbols().begin(),
-                        debug_info_.GetSymbols().end(),
-                        std::back_inserter(args),
-                        std::not1(IsArgumentOf(func_address)));
-    std::sort(args.begin(), args.end());
-  }
+  AMXDebugSymbolList args =
+    debug_info_.GetArguments(
+      GetArgumentCodeStart(frame, GetStateSwitch(frame)));
 
   // Print a comma-separated list of arguments and their values. If debug
   // info is not available argument names are omitted (only their values
   // are printed).
   for (cell i = 0; i < num_printed_args; i++) {
     if (i > 0) {
-      stream_ << ", ";
+      out_ << ", ";
     }
     if (debug_info_.IsLoaded() && i < static_cast<cell>(args.size())) {
       PrintArgument(prev_frame, args[i], i);
@@ -640,12 +1080,112 @@ void AMXStackFramePrinter::PrintArgumentList(const AMXStackFrame &frame) {
     }
   }
 
-  cell num_more_args = num_actual_args - num_printed_args;
+  PrintMoreArguments(num_printed_args, num_actual_args - num_printed_args);
+}
+
+void AMXStackFramePrinter::PrintCallerNameAndArguments(
+    const AMXStackFrame &frame,
+    const cell *values,
+    cell num_values,
+    cell num_args,
+    const AMXArgumentData *data) {
+  PrintCallerName(frame);
+  out_ << " (";
+  PrintArgumentList(frame, values, num_values, num_args, data);
+  out_ << ")";
+}
+
+void AMXStackFramePrinter::PrintArgumentList(const AMXStackFrame &frame,
+                                             const cell *values,
+                                             cell num_values,
+                                             cell num_args,
+                                             const AMXArgumentData *data) {
+  cell num_printed_args = std::min(std::min(10, num_args), num_values);
+
+  AMXDebugSymbolList args =
+    debug_info_.GetArguments(
+      GetArgumentCodeStart(frame, GetStateSwitch(frame)));
+
+  for (cell i = 0; i < num_printed_args; i++) {
+    if (i > 0) {
+      out_ << ", ";
+    }
+    if (debug_info_.IsLoaded() && i < static_cast<cell>(args.size())) {
+      if (data != nullptr && i < AMXArgumentData::kMaxArgs) {
+        PrintArgument(args[i],
+                      values[i],
+                      data->cells + data->offsets[i],
+                      data->sizes[i]);
+      } else {
+        PrintArgument(args[i], values[i]);
+      }
+    } else {
+      out_ << values[i];
+    }
+  }
+
+  PrintMoreArguments(num_printed_args, num_args - num_printed_args);
+}
+
+void AMXStackFramePrinter::PrintNativeArgumentList(
+    const NativeSignature &signature,
+    const cell *values,
+    cell num_values,
+    cell num_args,
+    const AMXArgumentData *data) {
+  cell num_printed_args = std::min(std::min(10, num_args), num_values);
+
+  for (cell i = 0; i < num_printed_args; i++) {
+    if (i > 0) {
+      out_ << ", ";
+    }
+    if (i >= static_cast<cell>(signature.params.size())) {
+      out_ << values[i];
+      continue;
+    }
+    const NativeParam &param = signature.params[i];
+    if (param.kind == NativeParam::REFERENCE) {
+      out_ << "&";
+    }
+    if (!param.tag.empty()) {
+      out_ << param.tag.c_str() << ":";
+    }
+    out_ << param.name.c_str();
+    if (param.kind == NativeParam::ARRAY || param.kind == NativeParam::STRING) {
+      out_ << "[]";
+    }
+    out_ << "=";
+    if (param.kind == NativeParam::VALUE) {
+      PrintValue(param.tag.c_str(), values[i]);
+      continue;
+    }
+
+    out_ << "@";
+    PrintAddress(values[i]);
+
+    cell data_size = data != nullptr && i < AMXArgumentData::kMaxArgs
+      ? data->sizes[i] : 0;
+    if (data_size > 0) {
+      const cell *cells = data->cells + data->offsets[i];
+      if (param.kind == NativeParam::REFERENCE) {
+        out_ << " ";
+        PrintValue(param.tag.c_str(), cells[0]);
+      } else {
+        PrintCapturedStringContents(out_, cells, data_size, kMaxString);
+      }
+    }
+  }
+
+  PrintMoreArguments(num_printed_args, num_args - num_printed_args);
+}
+
+void AMXStackFramePrinter::PrintMoreArguments(cell num_printed_args,
+                                              cell num_more_args) {
   if (num_more_args > 0) {
     if (num_printed_args != 0) {
-      stream_ << ", ";
+      out_ << ", ";
     }
-    stream_ << "... <"
+    out_ << "... <"
             << num_more_args
             << " more " << (num_more_args == 1 ? "argument" : "arguments")
             << ">";
@@ -653,33 +1193,53 @@ void AMXStackFramePrinter::PrintArgumentList(const AMXStackFrame &frame) {
 }
 
 void AMXStackFramePrinter::PrintState(const AMXStackFrame &frame) {
-  AMXDebugAutomaton automaton = debug_info_.GetAutomaton(
-    GetStateVarAddress(frame.amx(), frame.caller_address()));
+  const AMXStateSwitch &state_switch = GetStateSwitch(frame);
+  if (state_switch.state_var <= 0) {
+    return;
+  }
+  AMXDebugAutomaton automaton =
+    debug_info_.GetAutomaton(state_switch.state_var);
   if (automaton) {
-    std::vector<cell> states = GetStateIDs(frame.amx(),
-                                           frame.caller_address(),
+    std::vector<cell> states = GetStateIDs(state_switch,
                                            frame.return_address());
     if (!states.empty()) {
-      stream_ << "<" << automaton.GetName() << ":";
+      out_ << "<" << automaton.GetNamePtr() << ":";
       for (std::size_t i = 0; i < states.size(); i++ ) {
         if (i > 0) {
-          stream_ << ", ";
+          out_ << ", ";
         }
         AMXDebugState state =
           debug_info_.GetState(automaton.GetID(), states[i]);
         if (state) {
-          stream_ << state.GetName();
+          out_ << state.GetNamePtr();
         }
       }
-      stream_ << ">";
+      out_ << ">";
     }
   }
 }
 
+const AMXStateSwitch &AMXStackFramePrinter::GetStateSwitch(
+    const AMXStackFrame &frame) {
+  return ::GetStateSwitch(frame, cache_, state_switch_);
+}
+
 void AMXStackFramePrinter::PrintSourceLocation(cell address) {
-  std::string filename = debug_info_.GetFileName(address);
-  if (filename.empty()) {
-    filename.assign("<unknown file>");
+  if (cache_ != nullptr) {
+    const std::string *location = cache_->FindSourceLocation(address);
+    if (location == nullptr) {
+      std::string new_location;
+      AMXStackFramePrinter(new_location, debug_info_)
+        .PrintSourceLocation(address);
+      location = &cache_->AddSourceLocation(address, new_location);
+    }
+    out_ << *location;
+    return;
+  }
+
+  const char *filename = debug_info_.GetFileNamePtr(address);
+  if (filename[0] == '\0') {
+    filename = "<unknown file>";
   }
-  stream_ << filename << ":" << debug_info_.GetLineNumber(address) + 1;
+  out_ << filename << ":" << debug_info_.GetLineNumber(address) + 1;
 }
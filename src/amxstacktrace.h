@@ -25,10 +25,36 @@
 #ifndef AMXSTACKTRACE_H
 #define AMXSTACKTRACE_H
 
+#include <cstring>
 #include <iosfwd>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "amxdebuginfo.h"
 #include "amxref.h"
 
-class AMXDebugInfo;
+class AMXStackFrameCache;
+struct NativeSignature;
+
+// Contents of the arrays and references passed to a function, copied with
+// AMXStackFrame::GetArgumentData() so that the arguments can be printed
+// after the function has returned. Strings that don't fit are truncated.
+struct AMXArgumentData {
+  static const int kMaxArgs = 10;
+  static const int kMaxCells = 64;
+
+  unsigned char offsets[kMaxArgs];  // index of the argument's first cell
+  unsigned char sizes[kMaxArgs];    // number of cells, 0 if nothing copied
+  cell cells[kMaxCells];
+};
+
+// Same as AMXStackFrame::GetArgumentData() but for the arguments of a
+// native, whose types come from its signature (see NativeSignatureTable).
+void GetNativeArgumentData(AMXRef amx,
+                           const NativeSignature &signature,
+                           const cell *values,
+                           cell num_values,
+                           AMXArgumentData *data);
 
 class AMXStackFrame {
  public:
@@ -69,7 +95,23 @@ class AMXStackFrame {
 
   AMXStackFrame GetPrevious() const;
 
+  // Copies the values of at most max_values arguments passed to the caller
+  // into values and returns the total number of arguments.
+  cell GetArgumentValues(cell *values, cell max_values) const;
+
+  // Copies the data referenced by the first num_values arguments, as
+  // returned by GetArgumentValues(). Only references and strings are
+  // copied; this needs debug info to tell them apart from normal values.
+  void GetArgumentData(const AMXDebugInfo &debug_info,
+                       const cell *values,
+                       cell num_values,
+                       AMXArgumentData *data,
+                       AMXStackFrameCache *cache = nullptr) const;
+
   void Print(std::ostream &stream, const AMXDebugInfo &debug_info) const;
+  void Print(std::ostream &stream,
+             const AMXDebugInfo &debug_info,
+             AMXStackFrameCache *cache) const;
 
  private:
   AMXRef amx_;
@@ -100,12 +142,186 @@ AMXStackTrace GetAMXStackTrace(AMXRef amx,
                                cell cip,
                                int max_depth);
 
+// The frames found by the last walk of a script's stack. Samples taken one
+// after another during the same call mostly differ in the top few frames,
+// so the next walk stops at the first frame that is still the same as
+// before (same address, return address and saved frm) and takes the rest
+// of the chain from here. Frames are only compared, not followed, so a
+// call that returns and is made again with exactly the same stack layout
+// keeps its old callers; Clear() when the outermost call changes.
+class AMXStackWalkCache {
+ public:
+  struct Frame {
+    cell address;
+    cell return_address;
+    cell previous_frame;
+    cell caller_address;
+  };
+
+  AMXStackWalkCache();
+
+  // Walks at most max_depth frames from frm and cip like GetAMXStackTrace()
+  // and returns them, innermost first. Frames with no return address are
+  // not included.
+  const std::vector<Frame> &Walk(AMXRef amx, cell frm, cell cip,
+                                 int max_depth);
+
+  void Clear() { frames_.clear(); }
+
+ private:
+  std::size_t FindFrame(const Frame &frame) const;
+
+ private:
+  std::vector<Frame> frames_;
+  std::vector<Frame> new_frames_;
+};
+
+// Remembers what the parts of a stack frame that only depend on code
+// addresses (caller name, source location) look like when printed, so that
+// repeated backtraces through the same call sites don't need to look up the
+// debug info again. Each table is direct-mapped: an entry is simply replaced
+// when another address maps to the same slot.
+// The code at the start of a function that has different implementations
+// for different states: the variable holding the automaton's state and the
+// case table that picks the implementation (the first record is the
+// default one, its state is unused).
+struct AMXStateSwitch {
+  struct Record {
+    cell state;
+    cell address;
+  };
+  cell state_var;  // 0 if the function doesn't use automata
+  std::vector<Record> records;
+};
+
+class AMXStackFrameCache {
+ public:
+  AMXStackFrameCache();
+
+  // State switches are decoded once per function, by entry address.
+  const AMXStateSwitch *FindStateSwitch(cell address) const {
+    std::unordered_map<cell, AMXStateSwitch>::const_iterator it =
+      state_switches_.find(address);
+    return it != state_switches_.end() ? &it->second : nullptr;
+  }
+  const AMXStateSwitch &AddStateSwitch(cell address,
+                                       const AMXStateSwitch &state_switch) {
+    return state_switches_[address] = state_switch;
+  }
+
+  const std::string *FindCallerName(cell address) const {
+    return caller_names_.Find(address);
+  }
+  const std::string &AddCallerName(cell address, const std::string &name) {
+    return caller_names_.Add(address, name);
+  }
+
+  const std::string *FindSourceLocation(cell address) const {
+    return source_locations_.Find(address);
+  }
+  const std::string &AddSourceLocation(cell address,
+                                       const std::string &location) {
+    return source_locations_.Add(address, location);
+  }
+
+  void Clear();
+
+ private:
+  class Table {
+   public:
+    Table();
+
+    const std::string *Find(cell address) const;
+    const std::string &Add(cell address, const std::string &text);
+    void Clear();
+
+   private:
+    static const std::size_t kSize = 256;
+
+    struct Entry {
+      bool valid;
+      cell address;
+      std::string text;
+    };
+
+    static std::size_t GetIndex(cell address) {
+      return (static_cast<ucell>(address) / sizeof(cell)) % kSize;
+    }
+
+    Entry entries_[kSize];
+  };
+
+  Table caller_names_;
+  Table source_locations_;
+  std::unordered_map<cell, AMXStateSwitch> state_switches_;
+};
+
+// Where AMXStackFramePrinter's output goes: a std::ostream, or a string
+// that is appended to directly, which skips the stream's sentry and locale
+// machinery (callers can reserve() it up front). Numbers are formatted
+// here rather than by the stream either way.
+class AMXTextWriter {
+ public:
+  AMXTextWriter(std::ostream &stream) : stream_(&stream), string_(nullptr) {}
+  AMXTextWriter(std::string &string) : stream_(nullptr), string_(&string) {}
+
+  void Write(const char *s, std::size_t length);
+
+  AMXTextWriter &operator<<(const char *s) {
+    Write(s, std::strlen(s));
+    return *this;
+  }
+  AMXTextWriter &operator<<(const std::string &s) {
+    Write(s.data(), s.size());
+    return *this;
+  }
+  AMXTextWriter &operator<<(char c) {
+    Write(&c, 1);
+    return *this;
+  }
+  AMXTextWriter &operator<<(int value) {
+    WriteInt(value);
+    return *this;
+  }
+  AMXTextWriter &operator<<(long value) {
+    WriteInt(value);
+    return *this;
+  }
+  AMXTextWriter &operator<<(unsigned int value) {
+    WriteUnsigned(value);
+    return *this;
+  }
+  AMXTextWriter &operator<<(unsigned long value) {
+    WriteUnsigned(value);
+    return *this;
+  }
+
+  void WriteInt(long long value);
+  void WriteUnsigned(unsigned long long value);
+  // Lowercase, padded with zeros to width digits.
+  void WriteHex(ucell value, int width);
+  // Like std::fixed with std::setprecision(precision).
+  void WriteFloat(float value, int precision);
+
+ private:
+  std::ostream *stream_;
+  std::string *string_;
+};
+
 class AMXStackFramePrinter {
  public:
-  AMXStackFramePrinter(std::ostream &stream,
-                       const AMXDebugInfo &debug_info);
+  AMXStackFramePrinter(AMXTextWriter out,
+                       const AMXDebugInfo &debug_info,
+                       AMXStackFrameCache *cache = nullptr);
 
   void Print(const AMXStackFrame &frame);
+  // Same as above but with argument values captured earlier (see
+  // PrintCallerNameAndArguments()).
+  void Print(const AMXStackFrame &frame,
+             const cell *values,
+             cell num_values,
+             cell num_args,
+             const AMXArgumentData *data = nullptr);
 
   void PrintTag(const AMXDebugSymbol &symbol);
 
@@ -119,8 +335,13 @@ class AMXStackFramePrinter {
   void PrintArgument(const AMXStackFrame &frame,
                      const AMXDebugSymbol &arg,
                      int index);
+  void PrintArgument(const AMXDebugSymbol &arg,
+                     cell value,
+                     const cell *data = nullptr,
+                     cell data_size = 0);
+  void PrintArgumentName(const AMXDebugSymbol &arg);
 
-  void PrintValue(const std::string &tag_name, cell value);
+  void PrintValue(const char *tag_name, cell value);
   void PrintArgumentValue(const AMXStackFrame &frame, int index);
   void PrintArgumentValue(const AMXStackFrame &frame,
                           const AMXDebugSymbol &arg,
@@ -128,13 +349,43 @@ class AMXStackFramePrinter {
 
   void PrintArgumentList(const AMXStackFrame &frame);
 
+  // Same as PrintCallerNameAndArguments() and PrintArgumentList() but take
+  // argument values captured with AMXStackFrame::GetArgumentValues() rather
+  // than reading them from the stack. Arrays and references are printed as
+  // addresses only unless their contents were captured as well.
+  void PrintCallerNameAndArguments(const AMXStackFrame &frame,
+                                   const cell *values,
+                                   cell num_values,
+                                   cell num_args,
+                                   const AMXArgumentData *data = nullptr);
+  void PrintArgumentList(const AMXStackFrame &frame,
+                         const cell *values,
+                         cell num_values,
+                         cell num_args,
+                         const AMXArgumentData *data = nullptr);
+
+  // Prints the arguments of a native like PrintArgumentList() does for
+  // functions, with names and types taken from the signature.
+  void PrintNativeArgumentList(const NativeSignature &signature,
+                               const cell *values,
+                               cell num_values,
+                               cell num_args,
+                               const AMXArgumentData *data = nullptr);
+
   void PrintState(const AMXStackFrame &frame);
 
   void PrintSourceLocation(cell address);
 
  private:
-  std::ostream &stream_;
+  void PrintMoreArguments(cell num_printed_args, cell num_more_args);
+  void PrintStateAndLocation(const AMXStackFrame &frame);
+  const AMXStateSwitch &GetStateSwitch(const AMXStackFrame &frame);
+
+ private:
+  AMXTextWriter out_;
   const AMXDebugInfo &debug_info_;
+  AMXStackFrameCache *cache_;
+  AMXStateSwitch state_switch_;  // when there's no cache
 };
 
 #endif // !AMXSTACKTRACE_H
@@ -0,0 +1,85 @@
+// Copyright (c) 2026 Zeex
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <algorithm>
+#include <cstdint>
+#include <new>
+#include "arena.h"
+
+namespace {
+
+const std::size_t kMinBlockSize = 4096;
+const std::size_t kMaxBlockSize = 1024 * 1024;
+
+} // anonymous namespace
+
+Arena::Arena()
+  : blocks_(nullptr),
+    next_(nullptr),
+    end_(nullptr),
+    next_block_size_(kMinBlockSize),
+    allocated_(0)
+{
+}
+
+Arena::~Arena() {
+  Release();
+}
+
+void *Arena::Allocate(std::size_t size, std::size_t alignment) {
+  uintptr_t address = reinterpret_cast<uintptr_t>(next_);
+  uintptr_t aligned = (address + alignment - 1) & ~(alignment - 1);
+  if (next_ == nullptr
+      || aligned + size > reinterpret_cast<uintptr_t>(end_)) {
+    AddBlock(size + alignment);
+    address = reinterpret_cast<uintptr_t>(next_);
+    aligned = (address + alignment - 1) & ~(alignment - 1);
+  }
+  next_ = reinterpret_cast<char*>(aligned + size);
+  return reinterpret_cast<void*>(aligned);
+}
+
+void Arena::Release() {
+  while (blocks_ != nullptr) {
+    Block *next = blocks_->next;
+    ::operator delete(blocks_);
+    blocks_ = next;
+  }
+  next_ = nullptr;
+  end_ = nullptr;
+  next_block_size_ = kMinBlockSize;
+  allocated_ = 0;
+}
+
+void Arena::AddBlock(std::size_t min_size) {
+  std::size_t size = std::max(next_block_size_, sizeof(Block) + min_size);
+  Block *block = static_cast<Block*>(::operator new(size));
+  block->next = blocks_;
+  block->size = size;
+  blocks_ = block;
+  next_ = reinterpret_cast<char*>(block + 1);
+  end_ = reinterpret_cast<char*>(block) + size;
+  next_block_size_ = std::min(next_block_size_ * 2, kMaxBlockSize);
+  allocated_ += size;
+}
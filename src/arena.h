@@ -0,0 +1,116 @@
+// Copyright (c) 2026 Zeex
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <cstddef>
+#include <functional>
+#include <unordered_map>
+#include <utility>
+
+// A monotonic allocator: memory is handed out from a list of blocks one
+// piece after another and is only given back all at once, by Release() or
+// when the arena is destroyed. Freeing individual pieces does nothing, so
+// it's meant for things that only grow while a script is loaded (indexes,
+// counters) and not for containers that are cleared and refilled. Blocks
+// start small and double in size, the first one is allocated on first use.
+//
+// Not thread-safe.
+class Arena {
+ public:
+  Arena();
+  ~Arena();
+
+  Arena(const Arena &) = delete;
+  Arena &operator=(const Arena &) = delete;
+
+  void *Allocate(std::size_t size, std::size_t alignment);
+
+  // Frees all blocks. Anything allocated from the arena must be gone by
+  // then.
+  void Release();
+
+  // Total size of the blocks allocated so far.
+  std::size_t allocated() const
+    { return allocated_; }
+
+ private:
+  struct Block {
+    Block *next;
+    std::size_t size;
+  };
+
+  void AddBlock(std::size_t min_size);
+
+  Block *blocks_;
+  char *next_;
+  char *end_;
+  std::size_t next_block_size_;
+  std::size_t allocated_;
+};
+
+// An allocator for standard containers that takes memory from an arena.
+// Like std::pmr::polymorphic_allocator it converts implicitly from the
+// arena, so a container can be given just the arena in its constructor.
+template<typename T>
+class ArenaAllocator {
+ public:
+  typedef T value_type;
+
+  ArenaAllocator(Arena &arena): arena_(&arena) {}
+  template<typename U>
+  ArenaAllocator(const ArenaAllocator<U> &other): arena_(other.arena()) {}
+
+  T *allocate(std::size_t n) {
+    return static_cast<T*>(arena_->Allocate(n * sizeof(T), alignof(T)));
+  }
+  void deallocate(T *, std::size_t) {}
+
+  Arena *arena() const
+    { return arena_; }
+
+ private:
+  Arena *arena_;
+};
+
+template<typename T, typename U>
+bool operator==(const ArenaAllocator<T> &lhs, const ArenaAllocator<U> &rhs) {
+  return lhs.arena() == rhs.arena();
+}
+
+template<typename T, typename U>
+bool operator!=(const ArenaAllocator<T> &lhs, const ArenaAllocator<U> &rhs) {
+  return lhs.arena() != rhs.arena();
+}
+
+template<typename Key, typename T>
+using ArenaHashMap =
+  std::unordered_map<Key,
+                     T,
+                     std::hash<Key>,
+                     std::equal_to<Key>,
+                     ArenaAllocator<std::pair<const Key, T>>>;
+
+#endif // !ARENA_H
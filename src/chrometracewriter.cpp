@@ -0,0 +1,159 @@
+// Copyright (c) 2026 Zeex
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "chrometracewriter.h"
+#include "jsonwriter.h"
+
+namespace {
+
+const std::size_t kBufferSize = 1024 * 1024;
+
+// Buffered events are flushed to disk at least this often (in
+// microseconds).
+const int64_t kFlushInterval = 1000000;
+
+const char *GetCategory(TraceRecord::Kind kind) {
+  switch (kind) {
+    case TraceRecord::NATIVE:
+      return "native";
+    case TraceRecord::FUNCTION:
+      return "function";
+    default:
+      return "public";
+  }
+}
+
+} // anonymous namespace
+
+ChromeTraceWriter::ChromeTraceWriter()
+  : file_(nullptr),
+    has_events_(false),
+    last_flush_time_(0)
+{
+}
+
+ChromeTraceWriter::~ChromeTraceWriter() {
+  Close();
+}
+
+bool ChromeTraceWriter::Open(const std::string &filename) {
+  Close();
+
+  file_ = std::fopen(filename.c_str(), "w");
+  if (file_ == nullptr) {
+    return false;
+  }
+  buffer_.reset(new char[kBufferSize]);
+  std::setvbuf(file_, buffer_.get(), _IOFBF, kBufferSize);
+  std::fputs("[\n", file_);
+
+  has_events_ = false;
+  last_flush_time_ = 0;
+  scripts_.clear();
+  return true;
+}
+
+void ChromeTraceWriter::Close() {
+  if (file_ != nullptr) {
+    // The viewers accept a file without the closing bracket too, e.g. if
+    // the server crashed.
+    std::fputs("\n]\n", file_);
+    std::fclose(file_);
+    file_ = nullptr;
+  }
+  buffer_.reset();
+}
+
+void ChromeTraceWriter::WriteEvent(const std::string &json) {
+  if (has_events_) {
+    std::fputs(",\n", file_);
+  }
+  std::fwrite(json.data(), 1, json.length(), file_);
+  has_events_ = true;
+}
+
+void ChromeTraceWriter::Write(const TraceRecord &record,
+                              uint32_t script_id,
+                              const std::string &script_name,
+                              const std::string &name) {
+  if (file_ == nullptr) {
+    return;
+  }
+
+  if (scripts_.insert(script_id).second) {
+    JSONWriter json;
+    json.BeginObject();
+    json.Field("ph", "M");
+    json.Field("name", "thread_name");
+    json.Field("pid", 1);
+    json.Field("tid", script_id);
+    json.Key("args");
+    json.BeginObject();
+    json.Field("name", script_name);
+    json.EndObject();
+    json.EndObject();
+    WriteEvent(json.str());
+  }
+
+  JSONWriter json;
+  json.BeginObject();
+  json.Field("name", name);
+  json.Field("cat", GetCategory(record.kind));
+  switch (record.kind) {
+    case TraceRecord::NATIVE:
+      json.Field("ph", "X");
+      json.Field("ts", static_cast<long long>(record.start_time));
+      json.Field("dur",
+                 static_cast<long long>(record.time - record.start_time));
+      break;
+    case TraceRecord::PUBLIC:
+      json.Field("ph", "B");
+      json.Field("ts", static_cast<long long>(record.time));
+      break;
+    case TraceRecord::PUBLIC_RETURN:
+      json.Field("ph", "E");
+      json.Field("ts", static_cast<long long>(record.time));
+      break;
+    case TraceRecord::FUNCTION:
+      json.Field("ph", "i");
+      json.Field("s", "t");
+      json.Field("ts", static_cast<long long>(record.time));
+      break;
+  }
+  json.Field("pid", 1);
+  json.Field("tid", script_id);
+  json.EndObject();
+  WriteEvent(json.str());
+
+  if (record.time - last_flush_time_ >= kFlushInterval) {
+    std::fflush(file_);
+    last_flush_time_ = record.time;
+  }
+}
+
+// static
+ChromeTraceWriter &ChromeTraceWriter::shared() {
+  static ChromeTraceWriter instance;
+  return instance;
+}
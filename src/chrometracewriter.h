@@ -0,0 +1,73 @@
+// Copyright (c) 2026 Zeex
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef CHROMETRACEWRITER_H
+#define CHROMETRACEWRITER_H
+
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <set>
+#include <string>
+#include "tracebuffer.h"
+
+// Writes trace records as Chrome trace events (a JSON array that can be
+// loaded into chrome://tracing or Perfetto). Each script is shown as a
+// separate thread. Publics are begin/end pairs, natives are complete events
+// (they're recorded after they return) and functions are instant events
+// since nothing records when they return.
+class ChromeTraceWriter {
+ public:
+  ChromeTraceWriter();
+  ~ChromeTraceWriter();
+
+  ChromeTraceWriter(const ChromeTraceWriter &) = delete;
+  ChromeTraceWriter &operator=(const ChromeTraceWriter &) = delete;
+
+  bool Open(const std::string &filename);
+  void Close();
+
+  bool IsOpen() const { return file_ != nullptr; }
+
+  // Script IDs must be unique for the lifetime of the writer. The script
+  // name is only written the first time a script is seen.
+  void Write(const TraceRecord &record,
+             uint32_t script_id,
+             const std::string &script_name,
+             const std::string &name);
+
+  static ChromeTraceWriter &shared();
+
+ private:
+  void WriteEvent(const std::string &json);
+
+ private:
+  std::FILE *file_;
+  std::unique_ptr<char[]> buffer_;
+  bool has_events_;
+  int64_t last_flush_time_;
+  std::set<uint32_t> scripts_;
+};
+
+#endif // !CHROMETRACEWRITER_H
@@ -22,29 +22,58 @@
 // ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
 // POSSIBILITY OF SUCH DAMAGE.
 
+#include <algorithm>
 #include <cassert>
 #include <chrono>
+#include <cstdarg>
+#include <cstdint>
+#include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <fstream>
 #include <functional>
 #include <iomanip>
+#include <limits>
+#include <map>
 #include <sstream>
 #include <string>
 #include <vector>
 #include <amx/amxaux.h>
 #include "amxcallstack.h"
 #include "amxdebuginfo.h"
+#include "amxdebuginfocache.h"
+#include "amxdisassembler.h"
+#include "amxintegritychecker.h"
 #include "amxopcode.h"
 #include "amxpathfinder.h"
 #include "amxref.h"
 #include "amxstacktrace.h"
+#include "chrometracewriter.h"
+#include "crashdump.h"
+#include "errorreporter.h"
 #include "crashdetect.h"
+#include "fastclock.h"
 #include "fileutils.h"
+#include "flightrecorder.h"
+#include "hangwatchdog.h"
+#include "idlescheduler.h"
+#include "jsonwriter.h"
 #include "log.h"
+#include "longcallwatchdog.h"
+#include "metrics.h"
+#include "moduletable.h"
+#include "nativesignatures.h"
 #include "options.h"
 #include "os.h"
+#include "perfmap.h"
+#include "profiler.h"
+#include "regexp.h"
 #include "stacktrace.h"
+#include "statssegment.h"
 #include "stringutils.h"
+#include "symbolizer.h"
+#include "tracewriter.h"
+#include "workqueue.h"
 
 #define AMX_EXEC_GDK    (-10)
 #define AMX_EXEC_GDK_42 (-10000)
@@ -63,154 +92,1472 @@ class PrintLine: public std::unary_function<const std::string &, void> {
 };
 
 template<typename Printer>
-void PrintStream(Printer printer, const std::stringstream &stream) {
-  stringutils::SplitString(stream.str(),
-                           '\n',
-                           PrintLine<Printer>(printer));
+void PrintText(Printer printer, const std::string &text) {
+  stringutils::SplitString(text, '\n', PrintLine<Printer>(printer));
+}
+
+// Prints a multi-line report to the log in one piece.
+void PrintStream(const std::stringstream &stream) {
+  const std::string text = stream.str();
+  LogDebugPrintLines(text.data(), text.length());
+}
+
+void PrintTrace(const std::string &text) {
+  // Filters that only look at names are applied before formatting (see
+  // CrashDetect::IsFunctionTraced()).
+  const RegExp *filter = Options::shared().trace_filter();
+  if (filter == nullptr
+      || Options::shared().trace_filter_names_only()
+      || filter->Test(text)) {
+    PrintText(LogTracePrint, text);
+  }
+}
+
+std::string GetNativeTraceText(AMXRef amx, cell index) {
+  const char *name = amx.GetNativeName(index);
+  std::string text("native ");
+  text.append(name != nullptr ? name : "<unknown>");
+  text.append(" ()");
+  return text;
+}
+
+std::string FormatString(const char *format, ...) {
+  char buffer[256];
+  std::va_list va;
+  va_start(va, format);
+  std::vsnprintf(buffer, sizeof(buffer), format, va);
+  va_end(va);
+  return buffer;
+}
+
+// An empty list matches everything.
+bool MatchesAnyPattern(const std::vector<std::string> &patterns,
+                       const std::string &s) {
+  if (patterns.empty()) {
+    return true;
+  }
+  for (std::size_t i = 0; i < patterns.size(); i++) {
+    if (stringutils::MatchWildcard(patterns[i], s)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool IsJSONLog() {
+  return Options::shared().log_format() == LOG_FORMAT_JSONL;
+}
+
+// Every line written in crashdetect_log_format jsonl starts like this.
+void BeginJSONEvent(JSONWriter &json, const char *type) {
+  json.BeginObject();
+  json.Field("time", LogGetTime());
+  json.Field("type", type);
+}
+
+void WriteSourceLocation(JSONWriter &json,
+                         const AMXDebugInfo &debug_info,
+                         cell address) {
+  if (debug_info.IsLoaded() && address != 0) {
+    const char *filename = debug_info.GetFileNamePtr(address);
+    if (filename[0] != '\0') {
+      json.Field("file", filename);
+    }
+    json.Field("line", debug_info.GetLineNumber(address) + 1);
+  }
+}
+
+const char *GetTraceKindName(TraceRecord::Kind kind) {
+  switch (kind) {
+    case TraceRecord::NATIVE:
+      return "native";
+    case TraceRecord::PUBLIC:
+      return "public";
+    default:
+      return "function";
+  }
+}
+
+// JSON version of PrintTrace(). The filter sees the same text as in the
+// normal trace output.
+void PrintTraceJSON(TraceRecord::Kind kind,
+                    const std::string &script,
+                    const std::string &function,
+                    const std::string &arguments,
+                    const AMXDebugInfo &debug_info,
+                    cell return_address) {
+  const RegExp *filter = Options::shared().trace_filter();
+  if (filter != nullptr
+      && !Options::shared().trace_filter_names_only()
+      && !filter->Test(function + " (" + arguments + ")")) {
+    return;
+  }
+
+  JSONWriter json;
+  BeginJSONEvent(json, "trace");
+  json.Field("kind", GetTraceKindName(kind));
+  json.Field("script", script);
+  json.Field("function", function);
+  if (kind != TraceRecord::NATIVE || !arguments.empty()) {
+    json.Field("arguments", arguments);
+  }
+  if (kind != TraceRecord::NATIVE) {
+    WriteSourceLocation(json, debug_info, return_address);
+  }
+  json.EndObject();
+  LogTraceJSON(json.str());
+}
+
+// Number of records each thread can have in the trace buffer before it has
+// to wait for them to be printed.
+const std::size_t kTraceRingSize = 16384;
+
+// How many of the most called functions are shown in trace_mode counts.
+const std::size_t kTraceCountsTopN = 20;
+const std::size_t kBlockCountsTopN = 50;
+
+// long_call_profile keeps at most this many samples of a single call and
+// prints this many of the most common stacks.
+const std::size_t kMaxLongCallSamples = 100000;
+const std::size_t kLongCallTopN = 10;
+
+// redundant_natives forgets the calls it has seen when there are more than
+// this many.
+const std::size_t kMaxNativeCallHashes = 65536;
+
+void IncrementCallCount(std::vector<uint32_t> &counts, cell index) {
+  if (index >= 0 && index < static_cast<cell>(counts.size())) {
+    counts[index]++;
+  }
+}
+
+typedef std::pair<uint32_t, std::string> CallCount;
+
+bool CompareCallCounts(const CallCount &a, const CallCount &b) {
+  return a.first > b.first;
+}
+
+// Returns the time since start in microseconds and moves start to now.
+int64_t TakeElapsedTime(std::chrono::steady_clock::time_point &start) {
+  std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+  int64_t time = std::chrono::duration_cast<std::chrono::microseconds>(
+    now - start).count();
+  start = now;
+  return time;
+}
+
+const char *const kLoadStageNames[] = {
+  "path",
+  "debug info",
+  "setup",
+  "natives"
+};
+
+// The native stack at the time of a crash, captured before anything else
+// is done in the crash handler.
+void *crash_frames[kMaxStackFrames];
+
+// Forget about old repeated errors once there are this many of them.
+const std::size_t kMaxRepeatedErrors = 1024;
+
+// The same for error_throttle sites.
+const std::size_t kMaxThrottledErrors = 1024;
+
+// FNV-1a
+const uint64_t kFingerprintBasis = 14695981039346656037ULL;
+
+void AddToFingerprint(uint64_t &fingerprint, cell value) {
+  ucell v = static_cast<ucell>(value);
+  for (std::size_t i = 0; i < sizeof(v); i++) {
+    fingerprint ^= (v >> (i * 8)) & 0xFF;
+    fingerprint *= 1099511628211ULL;
+  }
+}
+
+AMXDebugInfo::Level GetDebugInfoLevel() {
+  switch (Options::shared().debug_info_level()) {
+    case DEBUG_INFO_LINES:
+      return AMXDebugInfo::LINES;
+    case DEBUG_INFO_ARGUMENTS:
+      return AMXDebugInfo::ARGUMENTS;
+    default:
+      return AMXDebugInfo::FULL;
+  }
 }
 
 } // anonymous namespace
 
-AMXCallStack CrashDetect::call_stack_;
+thread_local AMXCallStack *CrashDetect::call_stack_;
+thread_local std::unique_ptr<AMXCallStack> CrashDetect::own_call_stack_;
+AMXCallStack *CrashDetect::main_call_stack_;
 
 unsigned int CrashDetect::long_call_time_;
-std::chrono::microseconds CrashDetect::long_call_time_current_;
-std::chrono::high_resolution_clock::time_point CrashDetect::long_call_time_next_;
-bool CrashDetect::long_call_time_running_;
+bool CrashDetect::long_call_checks_;
+bool CrashDetect::call_time_limits_;
+bool CrashDetect::track_native_time_;
+std::vector<CrashDetect::LongCallNative> CrashDetect::long_call_natives_;
+thread_local CrashDetect::Dispatch *CrashDetect::dispatch_;
+AMX_CALLBACK CrashDetect::vm_callback_;
+int64_t CrashDetect::tick_call_start_;
+int64_t CrashDetect::tick_time_;
+std::unordered_map<uint64_t, CrashDetect::TickCall> CrashDetect::tick_calls_;
+unsigned int CrashDetect::ticks_over_budget_;
+int64_t CrashDetect::last_tick_report_;
+int64_t CrashDetect::stats_next_update_;
+uint64_t CrashDetect::tick_count_;
+int64_t CrashDetect::plugin_load_time_;
+int64_t CrashDetect::startup_times_[LOAD_STAGE_COUNT];
+unsigned int CrashDetect::startup_scripts_;
+bool CrashDetect::startup_done_;
+bool CrashDetect::long_call_profiling_;
+int64_t CrashDetect::long_call_next_sample_;
+std::vector<ProfileSample> CrashDetect::long_call_samples_;
+bool CrashDetect::long_call_pending_;
+CrashDetect::Watchpoint CrashDetect::watchpoints_[os::kNumWatchpoints];
+CrashDetect::WatchHit CrashDetect::watch_hits_[os::kNumWatchpoints];
+std::atomic<bool> CrashDetect::watch_hit_pending_(false);
+std::atomic<uint32_t> CrashDetect::next_trace_script_id_(0);
 
 CrashDetect::CrashDetect(AMX *amx)
   : AMXHandler<CrashDetect>(amx),
     amx_(amx),
+    debug_info_(std::make_shared<AMXDebugInfo>()),
+    has_debug_info_(false),
+    functions_(amx),
+    profile_walk_public_(0),
     prev_debug_(nullptr),
     prev_callback_(nullptr),
+    call_natives_directly_(false),
+    jit_(nullptr),
     last_frame_(amx->stp),
+    function_hook_(false),
     block_exec_errors_(false),
-    address_naught_(false)
+    address_naught_(false),
+    trace_script_id_(next_trace_script_id_++),
+    trace_flags_(0),
+    script_long_call_time_(-1),
+    stack_usage_slot_(-1),
+    bad_registers_reported_(false),
+    redundant_natives_(0),
+    redundant_natives_sampled_(false),
+    redundant_natives_call_(0),
+    redundant_native_sites_(arena_),
+    native_site_stats_(0),
+    native_site_counter_(0),
+    native_sites_(arena_),
+    dispatch_stats_(false),
+    timer_stats_(false),
+    callgraph_(false),
+    callgraph_base_(0),
+    callgraph_public_(0),
+    callgraph_nodes_(arena_),
+    callgraph_edges_(arena_),
+    heap_profile_(false),
+    heap_base_(-1),
+    heap_call_(0),
+    heap_sites_(arena_),
+    coverage_(false),
+    line_profile_(false),
+    file_stats_(false),
+    file_stats_samples_(arena_),
+    load_times_(),
+    error_counts_(arena_),
+    error_functions_(arena_)
 {
 }
 
 void CrashDetect::PluginLoad() {
-  long_call_time_ = Options::shared().long_call_time();
-  long_call_time_current_ = std::chrono::microseconds(long_call_time_);
-  long_call_time_next_ = std::chrono::high_resolution_clock::time_point::max();
-  long_call_time_running_ = long_call_time_ != 0;
+  main_call_stack_ = &GetCallStack();
+  InitSymbols();
+  // Recording starts right away, so this can't be changed on reload.
+  if (!FlightRecorder::shared().SetCapacity(
+      Options::shared().flight_recorder(),
+      Options::shared().flight_recorder_file())) {
+    LogDebugPrint("Could not create flight recorder file '%s'",
+                  Options::shared().flight_recorder_file().c_str());
+  }
+  InitLongCallChecks();
+  // A part of each script is checked every tick, between other idle jobs.
+  IdleScheduler::shared().PostMain([](int64_t deadline) {
+    if (Options::shared().integrity_check()) {
+      CheckIntegrity(std::min(deadline,
+                              fastclock::Now()
+                              + Options::shared().integrity_check_budget()));
+    }
+    return false;
+  });
+  if (Options::shared().hang_timeout() != 0) {
+    os::SetMainThread();
+    HangWatchdog::shared().Start(
+      std::chrono::seconds(Options::shared().hang_timeout()),
+      OnHang,
+      OnHangRecover);
+  }
+  if (!Options::shared().report_collector_port().empty()) {
+    ErrorReporter::shared().Start(
+      Options::shared().report_collector_host(),
+      Options::shared().report_collector_port(),
+      std::chrono::seconds(Options::shared().report_interval()));
+  }
+  if (!Options::shared().metrics_port().empty()) {
+    Metrics::shared().Start(
+      Options::shared().metrics_host(),
+      Options::shared().metrics_port(),
+      std::chrono::seconds(Options::shared().metrics_interval()),
+      Options::shared().metrics_prefix());
+  }
+  if (Options::shared().stats_segment()) {
+    if (!StatsSegment::shared().Open()) {
+      LogDebugPrint("Could not create the statistics segment");
+    }
+  }
+  const std::string &signatures = Options::shared().trace_native_signatures();
+  if (!signatures.empty()
+      && !NativeSignatureTable::shared().Load(signatures)) {
+    LogDebugPrint("Could not read native signatures from %s",
+                  signatures.c_str());
+  }
+  StartTraceOutput();
+  CrashDump::shared().SetDirectory(Options::shared().crash_dump());
+  if (Options::shared().profiler()) {
+    StartProfiler(0, std::string());
+  }
 }
 
 void CrashDetect::PluginUnload() {
-  long_call_time_running_ = false;
+  LongCallWatchdog::shared().SetEnabled(false);
+  LongCallWatchdog::shared().Stop();
+  HangWatchdog::shared().Stop();
+  ErrorReporter::shared().Stop();
+  Metrics::shared().Stop();
+  StatsSegment::shared().Close();
+  TraceBuffer::shared().Stop();
+  TraceWriter::shared().Close();
+  ChromeTraceWriter::shared().Close();
+  Profiler::shared().Stop();
+  IdleScheduler::shared().Clear();
+  WorkQueue::shared().Stop();
+}
+
+// static
+uint16_t CrashDetect::GetExecFlags() {
+  #ifdef AMX_OPCODE_COUNTS
+    if (Options::shared().opcode_counts() || Options::shared().block_counts()) {
+      return AMX_FLAG_COUNTOPS;
+    }
+  #endif
+  if (Options::shared().track_cip()) {
+    return 0;
+  }
+  // Long call checks can't be turned on later if long_call_time is 0. The
+  // profiler takes its samples at the same points.
+  uint16_t flags = AMX_FLAG_NOTRACKCIP;
+  if (!Options::shared().HasLongCallTime()
+      && !Options::shared().profiler()) {
+    flags |= AMX_FLAG_NOLONGCALL;
+  }
+  return flags;
+}
+
+// static
+void CrashDetect::SetTrace(const std::string &flags,
+                           const std::vector<std::string> &filter_patterns) {
+  // The trace buffer thread may be using the current filter, wait until
+  // it's done with whatever has been traced so far.
+  TraceBuffer::shared().Flush();
+
+  if (!Options::shared().SetTrace(flags, filter_patterns)) {
+    return;
+  }
+  ForEachHandler([](CrashDetect *handler) {
+    handler->InitTrace();
+    handler->InstallHooks();
+  });
+  StartTraceOutput();
+
+  std::string filter;
+  for (std::size_t i = 0; i < filter_patterns.size(); i++) {
+    if (i > 0) {
+      filter.append(", ");
+    }
+    filter.append(filter_patterns[i]);
+  }
+  LogDebugPrint("Trace flags set to \"%s\", filter: \"%s\"",
+                flags.c_str(), filter.c_str());
+}
+
+// static
+bool CrashDetect::ReloadOptions() {
+  if (!Options::Reload()) {
+    return false;
+  }
+  InitLongCallChecks();
+  ForEachHandler([](CrashDetect *handler) {
+    handler->InitScriptLongCallTime();
+    handler->InitTrace();
+    handler->InstallHooks();
+  });
+  StartTraceOutput();
+  LogDebugPrint("Settings reloaded from server.cfg");
+  return true;
+}
+
+// static
+bool CrashDetect::StartProfiler(unsigned int interval,
+                                const std::string &filename) {
+  if (Profiler::shared().IsRunning()) {
+    return false;
+  }
+  if (interval == 0) {
+    interval = Options::shared().profiler_interval();
+  }
+  Profiler::shared().Start(
+    ResolveProfileSample,
+    std::chrono::microseconds(interval),
+    filename.empty() ? Options::shared().profiler_file() : filename);
+  return true;
+}
+
+// static
+bool CrashDetect::StopProfiler() {
+  if (!Profiler::shared().IsRunning()) {
+    return false;
+  }
+  Profiler::shared().Stop();
+  return true;
+}
+
+// static
+bool CrashDetect::DumpProfile() {
+  if (!Profiler::shared().IsRunning()) {
+    return false;
+  }
+  Profiler::shared().Dump();
+  return true;
+}
+
+// static
+void CrashDetect::InitLongCallChecks() {
+  long_call_time_ = Options::shared().long_call_time();
+  long_call_checks_ = Options::shared().HasLongCallTime();
+  // Limits set for publics at runtime stay after a reload.
+  if (Options::shared().HasScriptLongCallTime()) {
+    call_time_limits_ = true;
+  }
+  track_native_time_ = long_call_checks_ || Options::shared().callback_stats();
+  LongCallWatchdog::shared().SetTimeLimit(
+    std::chrono::microseconds(long_call_time_));
+  switch (Options::shared().long_call_budget()) {
+    case LONG_CALL_BUDGET_TOTAL:
+      LongCallWatchdog::shared().SetBudget(LongCallWatchdog::BUDGET_TOTAL);
+      break;
+    case LONG_CALL_BUDGET_SCRIPT:
+      LongCallWatchdog::shared().SetBudget(LongCallWatchdog::BUDGET_SCRIPT);
+      break;
+    case LONG_CALL_BUDGET_NATIVES:
+      LongCallWatchdog::shared().SetBudget(LongCallWatchdog::BUDGET_NATIVES);
+      break;
+  }
+  LongCallWatchdog::shared().SetEnabled(long_call_checks_);
+  if (long_call_checks_) {
+    LongCallWatchdog::shared().Start(OnLongCallStuck);
+  }
+}
+
+int64_t CrashDetect::GetCallTimeLimit(const AMXCall &call) const {
+  if (call.IsPublic()) {
+    std::size_t slot = static_cast<std::size_t>(call.index() + 1);
+    if (slot < public_long_call_times_.size()
+        && public_long_call_times_[slot] >= 0) {
+      return public_long_call_times_[slot];
+    }
+  }
+  return script_long_call_time_;
+}
+
+bool CrashDetect::SetPublicLongCallTime(const char *public_name,
+                                        int64_t time) {
+  int index = functions_.GetPublicIndex(public_name);
+  if (index < 0) {
+    return false;
+  }
+  if (public_long_call_times_.empty()) {
+    public_long_call_times_.assign(amx_.GetNumPublics() + 1, -1);
+  }
+  public_long_call_times_[index + 1] = time < 0 ? -1 : time;
+  if (time > 0 && !long_call_checks_) {
+    long_call_checks_ = true;
+    track_native_time_ = true;
+    // Natives already patched to SYSREQ.D stay that way, but no more are.
+    amx_.SetSysreqDEnabled(false);
+    LongCallWatchdog::shared().SetEnabled(true);
+    LongCallWatchdog::shared().Start(OnLongCallStuck);
+  }
+  call_time_limits_ = true;
+  return true;
+}
+
+void CrashDetect::InitScriptLongCallTime() {
+  unsigned int long_call_time;
+  if (Options::shared().GetScriptLongCallTime(amx_path_, long_call_time)) {
+    script_long_call_time_ = long_call_time;
+  } else {
+    script_long_call_time_ = -1;
+  }
+  // Publics that this script doesn't have are simply skipped. The limits go
+  // into the same table as the ones set by scripts, so a script can still
+  // change them later.
+  const std::vector<std::pair<std::string, unsigned int>> &publics =
+    Options::shared().long_call_time_publics();
+  for (std::size_t i = 0; i < publics.size(); i++) {
+    SetPublicLongCallTime(publics[i].first.c_str(), publics[i].second);
+  }
+}
+
+// static
+void CrashDetect::StartTraceOutput() {
+  if (!Options::shared().HasTraceFlags()
+      || Options::shared().trace_mode() != TRACE_MODE_LOG
+      || TraceBuffer::shared().IsRunning()) {
+    return;
+  }
+  if (Options::shared().trace_output() == TRACE_OUTPUT_BINARY) {
+    const std::string &filename = Options::shared().trace_file();
+    if (TraceWriter::shared().Open(filename)) {
+      TraceBuffer::shared().Start(WriteTraceRecord, kTraceRingSize);
+    } else {
+      LogDebugPrint("Could not open trace file: %s", filename.c_str());
+    }
+  } else if (Options::shared().trace_output() == TRACE_OUTPUT_CHROME) {
+    const std::string &filename = Options::shared().trace_file();
+    if (ChromeTraceWriter::shared().Open(filename)) {
+      TraceBuffer::shared().Start(WriteChromeTraceRecord, kTraceRingSize);
+    } else {
+      LogDebugPrint("Could not open trace file: %s", filename.c_str());
+    }
+  } else if (Options::shared().trace_async()) {
+    TraceBuffer::shared().Start(FormatTraceRecord, kTraceRingSize);
+  }
 }
 
 int CrashDetect::Load() {
+  std::chrono::steady_clock::time_point start =
+    std::chrono::steady_clock::now();
   amx_path_ = AMXPathFinder::shared().Find(amx());
+  AddLoadTime(LOAD_FIND_PATH, TakeElapsedTime(start));
+
+  // Plugins are loaded before scripts, so this is a good time to make sure
+  // that the crash handler knows about all of them.
+  ModuleTable::shared().Refresh();
+  InitSymbols();
+  Symbolizer::shared().Clear();
   if (!amx_path_.empty()) {
     if (AMXDebugInfo::IsPresent(amx())) {
-      debug_info_.Load(amx_path_);
+      debug_info_ = AMXDebugInfoCache::shared().Get(
+        amx(),
+        amx_path_,
+        Options::shared().debug_info_lazy(),
+        Options::shared().debug_info_async(),
+        Options::shared().debug_info_mmap(),
+        Options::shared().debug_info_index(),
+        GetDebugInfoLevel());
+      has_debug_info_ = true;
     }
   }
+  AddLoadTime(LOAD_DEBUG_INFO, TakeElapsedTime(start));
 
   amx_name_ = fileutils::GetFileName(amx_path_);
   if (amx_name_.empty()) {
     assert(amx_path_.empty());
     amx_name_ = "<unknown>";
   }
+  InitScriptLongCallTime();
+  FlightRecorder::shared().AddScript(amx(), amx_path_);
+
+  functions_.Build();
+  InitTrace();
+  native_stats_next_print_ = std::chrono::steady_clock::now()
+    + std::chrono::seconds(Options::shared().native_stats_interval());
+  if (Options::shared().stack_usage()) {
+    InitStackUsage();
+  }
+  if (Options::shared().callback_stats()) {
+    InitCallbackStats();
+  }
+  if (Options::shared().argument_stats()) {
+    InitArgumentStats();
+  }
+  if (Options::shared().integrity_check()) {
+    integrity_checker_.reset(new AMXIntegrityChecker(amx_));
+  }
+  redundant_natives_ = Options::shared().redundant_natives();
+  native_site_stats_ = Options::shared().native_site_stats();
+  dispatch_stats_ = Options::shared().dispatch_stats();
+  if (dispatch_stats_) {
+    nested_calls_.assign(amx_.GetNumPublics(), NestedCalls());
+  }
+  callgraph_ = Options::shared().profile_callgraph() && has_debug_info_;
+  heap_profile_ = Options::shared().heap_profile();
+  coverage_ = Options::shared().coverage() && has_debug_info_;
+  if (coverage_) {
+    const AMX_HEADER *hdr = amx_.GetHeader();
+    coverage_cips_.assign(((hdr->dat - hdr->cod) / sizeof(cell) + 31) / 32, 0);
+  }
+  line_profile_ = Options::shared().line_profile() && has_debug_info_;
+  file_stats_ = Options::shared().file_stats() && has_debug_info_;
 
-  amx_.SetSysreqDEnabled(false);
+  // Natives called with SYSREQ.D bypass the callback, so they can't be
+  // traced or timed. They can still be seen in backtraces though (see
+  // GetDirectNativeCall()). The JIT compiles the code once, so it doesn't
+  // see SYSREQ.C being patched into SYSREQ.D either.
+  if (!Options::shared().sysreq_d()
+      || (trace_flags_ & (TRACE_NATIVES | TRACE_TIMERS))
+      || Options::shared().timer_stats()
+      || Options::shared().HasLongCallTime()
+      || Options::shared().callback_stats()
+      || Options::shared().flight_recorder() != 0
+      || Options::shared().redundant_natives() != 0
+      || Options::shared().native_site_stats() != 0
+      || Options::shared().dispatch_stats()
+      || Options::shared().native_stats()
+      || Options::shared().heap_profile()
+      || Options::shared().jit()) {
+    amx_.SetSysreqDEnabled(false);
+  }
+  if (Options::shared().fuse_opcodes()) {
+    amx_FuseOpcodes(amx());
+  }
+  if (amx()->flags & AMX_FLAG_COUNTOPS) {
+    InitExecCounts();
+  }
+  // Compiled code doesn't count anything.
+  if (Options::shared().jit() && (amx()->flags & AMX_FLAG_COUNTOPS) == 0) {
+    int error = amx_JitCompile(amx(), &jit_);
+    if (error != AMX_ERR_NONE) {
+      LogDebugPrint("Could not compile %s with the JIT: %s",
+                    amx_name_.c_str(),
+                    aux_StrError(error));
+    } else if (Options::shared().perf_map()) {
+      WritePerfMap();
+    }
+  }
   prev_debug_ = amx_.GetDebugHook();
   prev_callback_ = amx_.GetCallback();
+  InitNatives();
+  if (!NativeSignatureTable::shared().IsEmpty()) {
+    native_signatures_.resize(natives_.size());
+    for (std::size_t i = 0; i < native_signatures_.size(); i++) {
+      const char *name = amx_.GetNativeName(static_cast<int>(i));
+      native_signatures_[i] = name != nullptr
+        ? NativeSignatureTable::shared().Find(name)
+        : nullptr;
+    }
+  }
+  AddLoadTime(LOAD_SETUP, TakeElapsedTime(start));
 
   return AMX_ERR_NONE;
 }
 
-int CrashDetect::Unload() {
-  return AMX_ERR_NONE;
+void CrashDetect::AddLoadTime(LoadStage stage, int64_t time) {
+  load_times_[stage] += time;
+  if (!startup_done_) {
+    if (stage == LOAD_FIND_PATH) {
+      startup_scripts_++;
+    }
+    startup_times_[stage] += time;
+  }
 }
 
-int CrashDetect::OnDebugHook() {
-  if (amx_.GetFrm() < last_frame_
-      && (Options::shared().trace_flags() & TRACE_FUNCTIONS)
-      && debug_info_.IsLoaded()) {
-    AMXStackTrace trace = GetAMXStackTrace(
-      amx_,
-      amx_.GetFrm(),
-      amx_.GetCip(),
-      1);
-    if (trace.current_frame().return_address() != 0) {
-      PrintTraceFrame(trace.current_frame(), debug_info_);
+void CrashDetect::PrintLoadTimes() const {
+  if (!Options::shared().startup_timing()) {
+    return;
+  }
+  std::string stages;
+  for (int i = 0; i < LOAD_STAGE_COUNT; i++) {
+    stages.append(FormatString("%s%s: %.3f",
+                               i > 0 ? ", " : "",
+                               kLoadStageNames[i],
+                               load_times_[i] / 1000.0));
+  }
+  LogDebugPrint("Loaded %s in %.3f ms (%s)",
+                amx_name_.c_str(),
+                GetLoadTime(-1, false) / 1000.0,
+                stages.c_str());
+}
+
+int64_t CrashDetect::GetLoadTime(int stage, bool total) const {
+  const int64_t *times = total ? startup_times_ : load_times_;
+  if (stage >= 0 && stage < LOAD_STAGE_COUNT) {
+    return times[stage];
+  }
+  if (stage != -1) {
+    return -1;
+  }
+  int64_t sum = total ? plugin_load_time_ : 0;
+  for (int i = 0; i < LOAD_STAGE_COUNT; i++) {
+    sum += times[i];
+  }
+  return sum;
+}
+
+// static
+void CrashDetect::SetPluginLoadTime(int64_t time) {
+  plugin_load_time_ = time;
+}
+
+// static
+void CrashDetect::PrintStartupTimes() {
+  int64_t total = plugin_load_time_;
+  std::string stages = FormatString("plugin: %.3f",
+                                    plugin_load_time_ / 1000.0);
+  for (int i = 0; i < LOAD_STAGE_COUNT; i++) {
+    total += startup_times_[i];
+    stages.append(FormatString(", %s: %.3f",
+                               kLoadStageNames[i],
+                               startup_times_[i] / 1000.0));
+  }
+  LogDebugPrint("Startup took %.3f ms for %u scripts (%s)",
+                total / 1000.0,
+                startup_scripts_,
+                stages.c_str());
+}
+
+int CrashDetect::Unload() {
+  if (Options::shared().trace_mode() == TRACE_MODE_COUNTS) {
+    PrintTraceCounts();
+  }
+  for (std::unordered_map<uint64_t, RepeatedError>::const_iterator it =
+         repeated_errors_.begin();
+       it != repeated_errors_.end(); it++) {
+    if (it->second.count > 0) {
+      PrintRepeatedError(it->second);
     }
   }
-  last_frame_ = amx_.GetFrm();
-  return prev_debug_ != nullptr ? prev_debug_(amx_) : AMX_ERR_NONE;
+  for (std::unordered_map<uint64_t, ThrottledError>::const_iterator it =
+         throttled_errors_.begin();
+       it != throttled_errors_.end(); it++) {
+    if (it->second.dropped > 0) {
+      PrintThrottledError(it->second);
+    }
+  }
+  PrintStackUsage();
+  PrintHeapProfile();
+  PrintCallbackStats();
+  PrintArgumentStats();
+  PrintTimerStats();
+  PrintRedundantNatives();
+  PrintNativeSiteStats();
+  PrintDispatchStats();
+  PrintNativeStats();
+  PrintFileStats();
+  // The script's memory is about to go away.
+  if (IsWatchHitPending()) {
+    ReportWatchHits();
+  }
+  Unwatch(0, amx_.GetStp() / static_cast<cell>(sizeof(cell)));
+  if (callgraph_) {
+    WriteCallGraph();
+  }
+  if (coverage_) {
+    WriteCoverage();
+  }
+  if (line_profile_) {
+    WriteLineProfile();
+  }
+  if (amx()->flags & AMX_FLAG_COUNTOPS) {
+    PrintOpcodeCounts();
+    PrintBlockCounts();
+    amx_SetExecCounts(amx(), nullptr);
+  }
+  // Pending trace records and samples may still refer to this script, and
+  // so may backtraces that the log thread hasn't formatted yet.
+  TraceBuffer::shared().Flush();
+  if (Options::shared().backtrace_async()) {
+    LogFlush();
+  }
+  Profiler::shared().Flush();
+  if (jit_ != nullptr) {
+    amx_JitFree(jit_);
+    jit_ = nullptr;
+  }
+  return AMX_ERR_NONE;
 }
 
-int CrashDetect::OnCallback(cell index, cell *result, cell *params) {
-  Push(AMXCall::Native(amx_, index));
+void CrashDetect::InstallHooks() {
+  unsigned int trace_flags = trace_flags_;
 
-  if (Options::shared().trace_flags() & TRACE_NATIVES) {
-    std::stringstream stream;
-    const char *name = amx_.GetNativeName(index);
-    stream << "native " << (name != nullptr ? name : "<unknown>") << " ()";
-    if (Options::shared().trace_filter() == nullptr
-        || Options::shared().trace_filter()->Test(stream.str())) {
-      PrintStream(LogTracePrint, stream);
+  // Leave the hooks alone if another plugin has installed its own on top of
+  // ours, it would stop being called otherwise.
+  AMX_DEBUG debug_hook = amx_.GetDebugHook();
+  if (debug_hook == prev_debug_ || debug_hook == DebugHook) {
+    // Function tracing and the call graph only need to know when functions
+    // are entered and left, which the VM can tell us on PROC and RET
+    // instead of calling the debug hook on every line. The per-line
+    // features and the JIT (which doesn't report these events) still need
+    // the debug hook.
+    function_hook_ = ((trace_flags & TRACE_FUNCTIONS) || callgraph_)
+                     && !heap_profile_
+                     && !coverage_
+                     && !line_profile_
+                     && jit_ == nullptr
+                     && has_debug_info_;
+    // The debug hook is only needed for tracing and profiling functions,
+    // which can't be done without debug info. Without it the VM doesn't
+    // have to call anything on every line of code (except for the previous
+    // hook if there was one).
+    if (((trace_flags & TRACE_FUNCTIONS)
+         || callgraph_
+         || heap_profile_
+         || coverage_
+         || line_profile_)
+        && has_debug_info_
+        && !function_hook_) {
+      amx_.SetDebugHook(DebugHook);
+    } else {
+      amx_.SetDebugHook(prev_debug_);
+    }
+  }
+
+  AMX_CALLBACK callback = amx_.GetCallback();
+  if (callback == prev_callback_
+      || callback == Callback<true>
+      || callback == Callback<false>) {
+    if ((trace_flags & (TRACE_NATIVES | TRACE_TIMERS)) || timer_stats_) {
+      amx_.SetCallback(Callback<true>);
+    } else {
+      amx_.SetCallback(Callback<false>);
     }
   }
+}
 
-  int error = prev_callback_(amx_, index, result, params);
+// static
+int AMXAPI CrashDetect::DebugHook(AMX *amx) {
+  return GetHandler(amx)->OnDebugHook();
+}
 
-  Pop();
+// static
+template<bool TraceNatives>
+int AMXAPI CrashDetect::Callback(AMX *amx,
+                                 cell index,
+                                 cell *result,
+                                 cell *params) {
+  CrashDetect *handler = GetHandler(amx);
+  if (!handler->dispatch_stats_) {
+    return CallbackWithStats<TraceNatives>(handler, index, result, params);
+  }
+  // Publics run by the native add themselves to this (see OnExec()).
+  Dispatch dispatch = {0, 0, nullptr};
+  Dispatch *outer_dispatch = dispatch_;
+  dispatch_ = &dispatch;
+  int64_t start = fastclock::Now();
+  int error = CallbackWithStats<TraceNatives>(handler, index, result, params);
+  dispatch_ = outer_dispatch;
+  if (dispatch.num_calls != 0) {
+    handler->AddDispatch(index, dispatch, fastclock::Now() - start);
+  }
   return error;
 }
 
-int CrashDetect::OnExec(cell *retval, int index) {
-  Push(AMXCall::Public(amx_, index));
+// static
+template<bool TraceNatives>
+int CrashDetect::CallbackWithStats(CrashDetect *handler,
+                                   cell index,
+                                   cell *result,
+                                   cell *params) {
+  if (handler->native_site_stats_ != 0
+      && ++handler->native_site_counter_ >= handler->native_site_stats_) {
+    // CIP still points at the SYSREQ.C that made the call.
+    handler->native_site_counter_ = 0;
+    cell cip = handler->amx_.GetCip();
+    int64_t start = fastclock::Now();
+    int error = handler->callgraph_
+      ? CallbackWithCallGraph<TraceNatives>(handler, index, result, params)
+      : handler->OnCallback<TraceNatives>(index, result, params);
+    handler->AddNativeSiteTime(index, cip, fastclock::Now() - start);
+    return error;
+  }
+  if (!handler->callgraph_) {
+    return handler->OnCallback<TraceNatives>(index, result, params);
+  }
+  return CallbackWithCallGraph<TraceNatives>(handler, index, result, params);
+}
 
-  if (Options::shared().trace_flags() & TRACE_FUNCTIONS) {
-    last_frame_ = 0;
+// static
+template<bool TraceNatives>
+int CrashDetect::CallbackWithCallGraph(CrashDetect *handler,
+                                       cell index,
+                                       cell *result,
+                                       cell *params) {
+  handler->PushCallGraphFrame(-1 - index, 0, 0);
+  int error = handler->OnCallback<TraceNatives>(index, result, params);
+  handler->PopCallGraphFrame();
+  return error;
+}
+
+// Once the script has called a native, the VM's callback (prev_callback_)
+// replaces the SYSREQ.C instruction with SYSREQ.D which calls the native
+// directly, unless SYSREQ.D is disabled. Such calls don't go through
+// OnCallback() and aren't on the call stack, but while the native runs CIP
+// points right after the instruction. Returns the native's index in that
+// case or -1 otherwise.
+// static
+cell CrashDetect::GetDirectNativeCall(AMXRef amx) {
+  if (!amx.IsSysreqDEnabled()) {
+    return -1;
   }
-  if (Options::shared().trace_flags() & TRACE_PUBLICS) {
-    if (cell address = amx_.GetPublicAddress(index)) {
-      AMXStackTrace trace = GetAMXStackTrace(
-        amx_,
-        amx_.GetFrm(),
-        amx_.GetCip(),
-        1);
-      AMXStackFrame frame = trace.current_frame();
-      if (frame.return_address() != 0) {
-        frame.set_caller_address(address);
-        PrintTraceFrame(frame, debug_info_);
-      } else {
-        AMXStackFrame fake_frame(
-          amx_,
-          amx_.GetFrm(),
-          0,
-          0,
-          address);
-        PrintTraceFrame(fake_frame, debug_info_);
-      }
-    }
+  const AMX_HEADER *hdr = amx.GetHeader();
+  cell cip = amx.GetCip();
+  if (cip < static_cast<cell>(2 * sizeof(cell)) || cip > hdr->dat - hdr->cod) {
+    return -1;
   }
+  const cell *ip = reinterpret_cast<const cell*>(amx.GetCode() + cip);
+  if (*(ip - 2) != amx.GetSysreqDOpcode()) {
+    return -1;
+  }
+  CrashDetect *handler = GetHandler(amx);
+  if (handler != nullptr) {
+    return handler->functions_.FindNativeIndex(*(ip - 1));
+  }
+  return amx.FindNativeIndex(*(ip - 1));
+}
 
-  int error = ::amx_Exec(amx_, retval, index);
-  if (error == AMX_ERR_CALLBACK
-      || error == AMX_ERR_NOTFOUND
-      || error == AMX_ERR_INIT
-      || error == AMX_ERR_INDEX
-      || error == AMX_ERR_SLEEP) {
-    // For these types of errors amx_Error() is not called because of
-    // early return from amx_Exec().
-    OnExecError(index, retval, error);
+// static
+void CrashDetect::SetVMCallback(AMX_CALLBACK callback) {
+  vm_callback_ = callback;
+}
+
+void CrashDetect::WritePerfMap() {
+  unsigned char *code;
+  std::size_t code_size;
+  amx_JitGetCode(jit_, reinterpret_cast<void **>(&code), &code_size);
+
+  // Everything not covered by a function is runtime code shared by the
+  // whole script, or code that isn't in any function (if there's no debug
+  // info).
+  unsigned char *start = code;
+  int num_functions = debug_info_->IsLoaded()
+                      ? debug_info_->GetNumFunctions()
+                      : 0;
+  for (int i = 0; i < num_functions; i++) {
+    AMXDebugInfo::Symbol function = debug_info_->GetFunctionByIndex(i);
+    void *function_start;
+    void *function_end;
+    if (amx_JitGetAddress(jit_,
+                          function.GetCodeStart(),
+                          &function_start) != AMX_ERR_NONE
+        || amx_JitGetAddress(jit_,
+                             function.GetCodeEnd(),
+                             &function_end) != AMX_ERR_NONE
+        || function_start < start
+        || function_end <= function_start) {
+      continue;
+    }
+    PerfMap::shared().AddSymbol(
+      start,
+      static_cast<unsigned char *>(function_start) - start,
+      FormatString("[%s]", amx_name_.c_str()));
+    PerfMap::shared().AddSymbol(
+      function_start,
+      static_cast<unsigned char *>(function_end)
+        - static_cast<unsigned char *>(function_start),
+      FormatString("%s [%s]", function.GetNamePtr(), amx_name_.c_str()));
+    start = static_cast<unsigned char *>(function_end);
   }
+  PerfMap::shared().AddSymbol(start,
+                              code + code_size - start,
+                              FormatString("[%s]", amx_name_.c_str()));
+}
 
-  Pop();
-  return error;
+void CrashDetect::InitNatives() {
+  // Natives registered by other plugins after this point are filled in
+  // on first call (amx_Register() never changes registered natives).
+  natives_.resize(amx_.GetNumNatives());
+  for (std::size_t i = 0; i < natives_.size(); i++) {
+    natives_[i].function =
+      reinterpret_cast<AMX_NATIVE>(amx_.GetNativeAddress(i));
+    natives_[i].calls = 0;
+    natives_[i].time = 0;
+  }
+  // If another plugin has installed its own callback, it must still be
+  // called.
+  call_natives_directly_ =
+    prev_callback_ != nullptr && prev_callback_ == vm_callback_;
 }
 
-int CrashDetect::OnExecError(int index, cell *retval, int error) {
-  if (block_exec_errors_) {
-    return AMX_ERR_NONE;
+// Does what the VM's callback (amx_Callback) does but with the native
+// table built in InitNatives(), so there's one indirect call less and no
+// need to look at the AMX header.
+int CrashDetect::CallNative(cell index, cell *result, cell *params) {
+  if (!call_natives_directly_
+      || index < 0
+      || index >= static_cast<cell>(natives_.size())) {
+    return prev_callback_(amx_, index, result, params);
+  }
+  AMX_NATIVE native = natives_[index].function;
+  if (native == nullptr) {
+    native = reinterpret_cast<AMX_NATIVE>(amx_.GetNativeAddress(index));
+    if (native == nullptr) {
+      return prev_callback_(amx_, index, result, params);
+    }
+    natives_[index].function = native;
+  }
+  if (amx_.IsSysreqDEnabled()) {
+    PatchSysreqD(index, native);
   }
+  AMX *amx = amx_.amx();
+  amx->error = AMX_ERR_NONE;
+  *result = native(amx, params);
+  return amx->error;
+}
 
-  // The following error codes should not be treated as errors:
+// Counts the call and its duration for trace_mode counts and native_stats.
+// The time includes everything the native calls, such as publics in other
+// scripts.
+int CrashDetect::CallNativeTimed(cell index, cell *result, cell *params) {
+  if (index < 0 || index >= static_cast<cell>(natives_.size())) {
+    return CallNative(index, result, params);
+  }
+  NativeSlot &slot = natives_[index];
+  slot.calls++;
+  int64_t start = fastclock::Now();
+  int error = CallNative(index, result, params);
+  slot.time += fastclock::Now() - start;
+  return error;
+}
+
+void CrashDetect::ResetNativeCounts() {
+  for (std::size_t i = 0; i < natives_.size(); i++) {
+    natives_[i].calls = 0;
+    natives_[i].time = 0;
+  }
+}
+
+// Replaces the SYSREQ.C instruction that called the native with SYSREQ.D,
+// like amx_Callback does.
+void CrashDetect::PatchSysreqD(cell index, AMX_NATIVE native) {
+  const AMX_HEADER *hdr = amx_.GetHeader();
+  cell cip = amx_.GetCip();
+  if (cip < static_cast<cell>(2 * sizeof(cell)) || cip > hdr->dat - hdr->cod) {
+    return;
+  }
+  cell *ip = reinterpret_cast<cell*>(amx_.GetCode() + cip);
+  if (*(ip - 2) == RelocateAMXOpcode(AMX_OP_SYSREQ_C, amx_.GetFlags())
+      && *(ip - 1) == index) {
+    *(ip - 2) = amx_.GetSysreqDOpcode();
+    *(ip - 1) = static_cast<cell>(reinterpret_cast<intptr_t>(native));
+    if (integrity_checker_) {
+      integrity_checker_->UpdateCode(cip - 2 * sizeof(cell));
+      integrity_checker_->UpdateCode(cip - sizeof(cell));
+    }
+  }
+}
+
+// Installed only when functions are traced or profiled (see
+// InstallHooks()).
+int CrashDetect::OnDebugHook() {
+  if (coverage_) {
+    UpdateCoverage();
+  }
+  if (line_profile_) {
+    CountLine();
+  }
+  if (callgraph_) {
+    UpdateCallGraph();
+  }
+  if (heap_base_ >= 0) {
+    SampleHeap();
+  }
+  if ((trace_flags_ & TRACE_FUNCTIONS) && amx_.GetFrm() < last_frame_) {
+    TraceFunctionCall();
+  }
+  last_frame_ = amx_.GetFrm();
+  return prev_debug_ != nullptr ? prev_debug_(amx_) : AMX_ERR_NONE;
+}
+
+void CrashDetect::TraceFunctionCall() {
+  if (!debug_info_->IsLoaded()) {
+    return;
+  }
+  if (Options::shared().trace_mode() == TRACE_MODE_COUNTS) {
+    CountFunctionCall();
+  } else if (SampleFunctionCall()) {
+    AMXStackTrace trace = GetAMXStackTrace(
+      amx_,
+      amx_.GetFrm(),
+      amx_.GetCip(),
+      1);
+    if (trace.current_frame().return_address() != 0
+        && IsFunctionTraced(trace.current_frame())) {
+      if (TraceBuffer::shared().IsRunning()) {
+        PushTraceRecord(TraceRecord::FUNCTION, 0, trace.current_frame());
+      } else {
+        PrintTraceFrame(TraceRecord::FUNCTION, trace.current_frame());
+      }
+    }
+  }
+}
+
+template<bool TraceNatives>
+int CrashDetect::OnCallback(cell index, cell *result, cell *params) {
+  Push(AMXCall::Native(amx_, index));
+  if (redundant_natives_sampled_) {
+    CheckRedundantNativeCall(index, params);
+  }
+  if (stack_usage_slot_ >= 0) {
+    SampleStackSpace();
+  }
+  if (Profiler::shared().IsSamplePending()) {
+    TakeProfileSample(index);
+  }
+  if (IsWatchHitPending()) {
+    ReportWatchHits();
+  }
+  if (long_call_profiling_) {
+    SampleLongCall(this, index);
+  }
+  if (heap_base_ >= 0) {
+    SampleHeap();
+  }
+
+  if (!TraceNatives) {
+    int error = Options::shared().native_stats()
+      ? CallNativeTimed(index, result, params)
+      : CallNative(index, result, params);
+    Pop();
+    return error;
+  }
+
+  unsigned char trace_flags = GetNativeTraceFlags(index);
+  if ((trace_flags & NATIVE_TRACE_SETS_TIMER)
+      && (trace_flags_ & TRACE_TIMERS)) {
+    AddTimerPublic(params);
+  }
+  if ((trace_flags & NATIVE_TRACE_KILLS_TIMER)
+      && params[0] >= static_cast<cell>(sizeof(cell))) {
+    RemoveTimer(params[1]);
+  }
+
+  bool push_record = false;
+  if (Options::shared().trace_mode() == TRACE_MODE_COUNTS) {
+    int error = CallNativeTimed(index, result, params);
+    if (timer_stats_ && (trace_flags & NATIVE_TRACE_SETS_TIMER)) {
+      AddTimer(params, *result);
+    }
+    Pop();
+    return error;
+  } else if ((trace_flags & NATIVE_TRACE_ON)
+             && native_trace_sampler_.Sample(index)) {
+    if (TraceBuffer::shared().IsRunning()) {
+      push_record = true;
+    } else {
+      cell num_args = params[0] / static_cast<cell>(sizeof(cell));
+      const NativeSignature *signature = GetNativeSignature(index);
+      AMXArgumentData arg_data;
+      if (signature != nullptr) {
+        GetNativeArgumentData(amx_,
+                              *signature,
+                              params + 1,
+                              std::min<cell>(num_args, TraceRecord::kMaxArgs),
+                              &arg_data);
+      }
+      PrintNativeTrace(index, params + 1, num_args, &arg_data);
+    }
+  }
+
+  int64_t start_time = push_record ? TraceBuffer::shared().GetTime() : 0;
+  int error = Options::shared().native_stats()
+    ? CallNativeTimed(index, result, params)
+    : CallNative(index, result, params);
+
+  // Buffered records are pushed after the call so they can include the
+  // return value. This also means that they come after anything traced
+  // while the native was running, e.g. publics called with CallLocalFunction.
+  if (push_record) {
+    PushNativeTraceRecord(index, params, *result, start_time);
+  }
+  if (timer_stats_ && (trace_flags & NATIVE_TRACE_SETS_TIMER)) {
+    AddTimer(params, *result);
+  }
+
+  Pop();
+  return error;
+}
+
+int CrashDetect::OnExec(cell *retval, int index) {
+  // If this public is called from a native that the calling script invoked
+  // via SYSREQ.D, put that native on the call stack too, like OnCallback()
+  // would, so that it shows up in backtraces.
+  bool push_native = false;
+  AMXCallStack &call_stack = GetCallStack();
+  // Timers are run by the server, so they're always top-level calls.
+  TimerPublic *timer_public = nullptr;
+  if (timer_stats_ && call_stack.IsEmpty()) {
+    timer_public = FireTimer(index);
+  }
+  bool redundant_natives_top = false;
+  if (redundant_natives_ != 0 && call_stack.IsEmpty()) {
+    redundant_natives_top = true;
+    redundant_natives_sampled_ =
+      ++redundant_natives_call_ % redundant_natives_ == 0;
+  }
+  if (!call_stack.IsEmpty() && call_stack.Top().IsPublic()) {
+    AMXRef caller = call_stack.Top().amx();
+    cell native_index = GetDirectNativeCall(caller);
+    if (native_index >= 0) {
+      Push(AMXCall::Native(caller, native_index));
+      push_native = true;
+    }
+  }
+
+  // The caller is on top of the call stack now. If it's a native, it's the
+  // one that Callback() has set dispatch_ for.
+  NestedCalls *nested_calls = nullptr;
+  bool nested_from_native = false;
+  Dispatch *dispatch = nullptr;
+  int64_t nested_start_time = 0;
+  if (!nested_calls_.empty()
+      && !call_stack.IsEmpty()
+      && index >= 0
+      && index < static_cast<int>(nested_calls_.size())) {
+    nested_calls = &nested_calls_[index];
+    nested_from_native = call_stack.Top().IsNative();
+    if (nested_from_native && !push_native) {
+      dispatch = dispatch_;
+    }
+    nested_start_time = fastclock::Now();
+  }
+
+  Push(AMXCall::Public(amx_, index));
+
+  // Nested calls of publics in the same script count towards the outermost
+  // one.
+  bool stack_usage_top = false;
+  if (!stack_space_.empty()
+      && stack_usage_slot_ < 0
+      && index >= AMX_EXEC_MAIN
+      && index + 1 < static_cast<int>(stack_space_.size())) {
+    unsigned int interval = Options::shared().stack_usage_interval();
+    if (interval != 0
+        && std::chrono::steady_clock::now() >= stack_usage_next_print_) {
+      PrintStackUsage();
+      stack_usage_next_print_ =
+        std::chrono::steady_clock::now() + std::chrono::seconds(interval);
+    }
+    stack_usage_slot_ = index + 1;
+    stack_usage_top = true;
+  }
+  if (stack_usage_slot_ >= 0) {
+    SampleStackSpace();
+  }
+  bool heap_profile_top = false;
+  if (heap_profile_ && heap_base_ < 0) {
+    heap_base_ = amx_.GetHea();
+    heap_call_++;
+    heap_profile_top = true;
+  }
+
+  if (index >= 0 && index == functions_.GetKnownPublicIndex(
+                                AMXFunctionTable::ON_RCON_COMMAND)) {
+    HandleRconCommand();
+  }
+
+  if (trace_flags_ & TRACE_FUNCTIONS) {
+    last_frame_ = 0;
+  }
+  // Chrome trace events need to know when the public returns as well.
+  bool push_return = false;
+  if (Options::shared().trace_mode() == TRACE_MODE_COUNTS) {
+    // Everything a script does starts with a public call, so checking
+    // here is frequent enough without looking at the clock on every
+    // native or function call.
+    if (std::chrono::steady_clock::now() >= trace_counts_next_print_) {
+      PrintTraceCounts();
+    }
+    if (IsPublicTraced(index)) {
+      IncrementCallCount(public_call_counts_, index);
+    }
+  } else if (IsPublicTraced(index) && public_trace_sampler_.Sample(index)) {
+    if (cell address = amx_.GetPublicAddress(index)) {
+      AMXStackTrace trace = GetAMXStackTrace(
+        amx_,
+        amx_.GetFrm(),
+        amx_.GetCip(),
+        1);
+      AMXStackFrame frame = trace.current_frame();
+      if (frame.return_address() != 0) {
+        frame.set_caller_address(address);
+      } else {
+        frame = AMXStackFrame(
+          amx_,
+          amx_.GetFrm(),
+          0,
+          0,
+          address);
+      }
+      if (IsFunctionTraced(frame)) {
+        if (TraceBuffer::shared().IsRunning()) {
+          PushTraceRecord(TraceRecord::PUBLIC, index, frame);
+          push_return =
+            Options::shared().trace_output() == TRACE_OUTPUT_CHROME;
+        } else {
+          PrintTraceFrame(TraceRecord::PUBLIC, frame);
+        }
+      }
+    }
+  }
+
+  if (Options::shared().native_stats()
+      && Options::shared().native_stats_interval() != 0
+      && GetCallStack().Size() == 1
+      && std::chrono::steady_clock::now() >= native_stats_next_print_) {
+    PrintNativeStats();
+    ResetNativeCounts();
+    native_stats_next_print_ = std::chrono::steady_clock::now()
+      + std::chrono::seconds(Options::shared().native_stats_interval());
+  }
+
+  // Functions of this public go on top of what's on the call graph stack
+  // now, and whatever is left of them when it returns is popped.
+  std::size_t callgraph_base = callgraph_base_;
+  cell callgraph_public = callgraph_public_;
+  if (callgraph_) {
+    callgraph_base_ = callgraph_stack_.size();
+    callgraph_public_ = amx_.GetPublicAddress(index);
+  }
+
+  LatencyHistogram *histogram = nullptr;
+  int64_t start_time = 0;
+  int64_t start_native_time = 0;
+  if (!callback_stats_.empty()
+      && index >= AMX_EXEC_MAIN
+      && index + 1 < static_cast<int>(callback_stats_.size())) {
+    unsigned int interval = Options::shared().callback_stats_interval();
+    if (interval != 0
+        && std::chrono::steady_clock::now() >= callback_stats_next_print_) {
+      PrintCallbackStats();
+      for (std::size_t i = 0; i < callback_stats_.size(); i++) {
+        if (callback_stats_[i]) {
+          callback_stats_[i]->Reset();
+        }
+        callback_native_time_[i] = 0;
+      }
+      callback_stats_next_print_ =
+        std::chrono::steady_clock::now() + std::chrono::seconds(interval);
+    }
+    std::unique_ptr<LatencyHistogram> &slot = callback_stats_[index + 1];
+    if (!slot) {
+      slot.reset(new LatencyHistogram);
+    }
+    histogram = slot.get();
+    start_time = fastclock::Now();
+    start_native_time = LongCallWatchdog::shared().GetNativeTime();
+  }
+
+  // The first argument is on top of the stack.
+  cell argument = 0;
+  int64_t argument_start_time = 0;
+  if (argument_stats_ && index >= 0 && amx_.amx()->paramcount >= 1) {
+    unsigned int interval = Options::shared().argument_stats_interval();
+    if (interval != 0
+        && std::chrono::steady_clock::now() >= argument_stats_next_print_) {
+      PrintArgumentStats();
+      argument_stats_->Clear();
+      argument_stats_next_print_ =
+        std::chrono::steady_clock::now() + std::chrono::seconds(interval);
+    }
+    argument = *reinterpret_cast<cell*>(amx_.GetData() + amx_.GetStk());
+    argument_start_time = fastclock::Now();
+  }
+  int64_t timer_start_time = timer_public != nullptr ? fastclock::Now() : 0;
+  int error;
+  if (jit_ != nullptr) {
+    error = amx_JitExec(jit_, retval, index);
+  } else {
+    error = ::amx_Exec(amx_, retval, index);
+  }
+  if (timer_public != nullptr) {
+    timer_public->cost.Record(fastclock::Now() - timer_start_time);
+  }
+  if (nested_calls != nullptr) {
+    int64_t time = fastclock::Now() - nested_start_time;
+    if (nested_from_native) {
+      nested_calls->native_calls++;
+      nested_calls->native_time += time;
+    } else {
+      nested_calls->public_calls++;
+      nested_calls->public_time += time;
+    }
+    if (dispatch != nullptr) {
+      if (dispatch->num_calls++ == 0) {
+        dispatch->public_name = amx_.GetPublicName(index);
+      }
+      dispatch->call_time += time;
+    }
+  }
+  if (argument_start_time != 0) {
+    argument_stats_->Add((static_cast<uint64_t>(index) << 32)
+                           | static_cast<uint32_t>(argument),
+                         fastclock::Now() - argument_start_time);
+  }
+  if (histogram != nullptr) {
+    histogram->Record(fastclock::Now() - start_time);
+    callback_native_time_[index + 1] +=
+      LongCallWatchdog::shared().GetNativeTime() - start_native_time;
+  }
+  if (push_return) {
+    PushReturnTraceRecord(index);
+  }
+  if (callgraph_) {
+    while (callgraph_stack_.size() > callgraph_base_) {
+      PopCallGraphFrame();
+    }
+    callgraph_base_ = callgraph_base;
+    callgraph_public_ = callgraph_public;
+  }
+  if (error == AMX_ERR_CALLBACK
+      || error == AMX_ERR_NOTFOUND
+      || error == AMX_ERR_INIT
+      || error == AMX_ERR_INDEX
+      || error == AMX_ERR_SLEEP) {
+    // For these types of errors amx_Error() is not called because of
+    // early return from amx_Exec().
+    OnExecError(index, retval, error);
+  }
+
+  if (stack_usage_top) {
+    stack_usage_slot_ = -1;
+  }
+  if (redundant_natives_top) {
+    redundant_natives_sampled_ = false;
+  }
+  if (heap_profile_top) {
+    heap_base_ = -1;
+  }
+  Pop();
+  if (push_native) {
+    Pop();
+  }
+
+  // The script is only told about a long call once the top-level call is
+  // over, so that it doesn't have to deal with being in the middle of it.
+  // A long OnCrashDetectLongCall itself is left to the call that ran it.
+  if (long_call_pending_
+      && call_stack.IsEmpty()
+      && &call_stack == main_call_stack_
+      && index != functions_.GetKnownPublicIndex(
+                    AMXFunctionTable::ON_CRASHDETECT_LONG_CALL)) {
+    CallOnLongCall(index, LongCallWatchdog::shared().GetCallDuration());
+    long_call_pending_ = false;
+  }
+  return error;
+}
+
+int CrashDetect::OnExecError(int index, cell *retval, int error) {
+  if (block_exec_errors_) {
+    return AMX_ERR_NONE;
+  }
+
+  // The following error codes should not be treated as errors:
   //
   // 1. AMX_ERR_NONE is always returned when a public function returns
   //    normally as it jumps to return address 0 where it performs "halt 0".
@@ -221,152 +1568,2828 @@ int CrashDetect::OnExecError(int index, cell *retval, int error) {
     return AMX_ERR_NONE;
   }
 
-  // For compatibility with sampgdk.
-  if (error == AMX_ERR_INDEX && (index == AMX_EXEC_GDK ||
-                                 index <= AMX_EXEC_GDK_42)) {
-    return AMX_ERR_NONE;
+  // The VM doesn't let STK and HEA cross, so this is as close as they get.
+  if (error == AMX_ERR_STACKERR && stack_usage_slot_ >= 0) {
+    stack_space_[stack_usage_slot_] = 0;
+  }
+
+  // For compatibility with sampgdk.
+  if (error == AMX_ERR_INDEX && (index == AMX_EXEC_GDK ||
+                                 index <= AMX_EXEC_GDK_42)) {
+    return AMX_ERR_NONE;
+  }
+
+  // Block errors while calling OnRuntimeError as it may result in yet
+  // another error (and for certain errors it in fact always does, e.g.
+  // stack/heap collision due to insufficient stack space for making
+  // the public call).
+  block_exec_errors_ = true;
+
+  // Everything printed about the error goes to crashdetect_error_log.
+  LogChannelScope log_channel(LOG_CHANNEL_ERROR);
+
+  // Error statistics are kept for every error, it's just two counters.
+  error_counts_[error]++;
+  error_functions_[GetErrorFrame().caller_address()]++;
+  Metrics::shared().CountError(error);
+
+  // Past its error_throttle budget an error only gets to OnRuntimeError,
+  // nothing else is looked at.
+  if (Options::shared().error_throttle_count() != 0
+      && IsThrottledError(error)) {
+    CallOnRuntimeError(retval, error);
+    block_exec_errors_ = false;
+    return AMX_ERR_NONE;
+  }
+
+  // The same error in the same place is only printed in full once in a
+  // while, so don't bother capturing the backtrace for repeats.
+  uint64_t fingerprint = 0;
+  bool repeated = false;
+  if (Options::shared().error_repeat_time() != 0) {
+    fingerprint = GetErrorFingerprint(error);
+    repeated = IsRepeatedError(fingerprint);
+  }
+  bool report = false;
+  if (ErrorReporter::shared().IsRunning()) {
+    if (fingerprint == 0) {
+      fingerprint = GetErrorFingerprint(error);
+    }
+    report = !ErrorReporter::shared().IsRateLimited(fingerprint);
+  }
+
+  // Capture backtrace before continuing as OnRuntimError will modify the
+  // state of the AMX thus we'll end up with a different stack and possibly
+  // other things too. This also should protect from cases where something
+  // hooks logprintf (like fixes2). Only the frames are captured here, the
+  // stack they're in is left alone by OnRuntimeError (its own frames go
+  // below them). Turning them into text is left until it's known that the
+  // error isn't suppressed.
+  std::vector<AMXBacktraceFrame> bt_frames;
+  std::string location;
+  if (!repeated || report) {
+    GetAMXBacktrace(bt_frames);
+    if (Options::shared().error_repeat_time() != 0) {
+      location = GetErrorLocation();
+    }
+  }
+
+  // Remember values of AMX registers before calling OnRuntimeError().
+  AMX amx_state = *amx_.amx();
+
+  cell suppress = CallOnRuntimeError(retval, error);
+
+  JSONWriter bt_json;
+  if (suppress == 0 && (report || (!repeated && IsJSONLog()))) {
+    WriteAMXBacktrace(bt_json, bt_frames);
+  }
+  if (report && suppress == 0) {
+    std::vector<std::string> disassembly = GetDisassembly(amx_state.cip);
+    ErrorReporter::shared().Report(
+      fingerprint,
+      FormatRuntimeError(amx_name_,
+                         amx_,
+                         amx_state,
+                         error,
+                         disassembly,
+                         &bt_json.str(),
+                         fingerprint));
+  }
+
+  if (repeated) {
+    if (suppress == 0) {
+      RepeatedError &repeated_error = repeated_errors_[fingerprint];
+      repeated_error.count++;
+      std::chrono::steady_clock::time_point now =
+        std::chrono::steady_clock::now();
+      if (now - repeated_error.since
+          >= std::chrono::seconds(Options::shared().error_repeat_time())) {
+        PrintRepeatedError(repeated_error);
+        repeated_error.count = 0;
+        repeated_error.since = now;
+      }
+    }
+  } else if (suppress == 0) {
+    bool print_backtrace = error != AMX_ERR_NOTFOUND
+                           && error != AMX_ERR_INDEX
+                           && error != AMX_ERR_CALLBACK
+                           && error != AMX_ERR_INIT;
+    std::vector<std::string> disassembly;
+    if (print_backtrace) {
+      disassembly = GetDisassembly(amx_state.cip);
+    }
+    if (IsJSONLog()) {
+      WriteRuntimeError(amx_name_,
+                        amx_,
+                        amx_state,
+                        error,
+                        disassembly,
+                        print_backtrace ? &bt_json.str() : nullptr);
+      if (FlightRecorder::shared().IsEnabled()) {
+        JSONWriter json;
+        BeginJSONEvent(json, "flight_recorder");
+        json.Key("events");
+        WriteFlightRecorder(json);
+        json.EndObject();
+        LogPrintJSON(json.str());
+      }
+    } else {
+      PrintRuntimeError(amx_, amx_state, error);
+      PrintDisassembly(disassembly);
+      if (print_backtrace) {
+        if (Options::shared().backtrace_async()) {
+          PrintAMXBacktraceDeferred(bt_frames);
+        } else {
+          std::stringstream bt_stream;
+          PrintAMXBacktrace(bt_stream, bt_frames);
+          PrintStream(bt_stream);
+        }
+      }
+      PrintFlightRecorder();
+    }
+    if (Options::shared().error_repeat_time() != 0) {
+      AddRepeatedError(fingerprint, error, location);
+    }
+  }
+
+  block_exec_errors_ = false;
+  return AMX_ERR_NONE;
+}
+
+// public OnRuntimeError(code, &bool:suppress);
+//
+// Returns the value of suppress, or 0 if there's no such public.
+cell CrashDetect::CallOnRuntimeError(cell *retval, int error) {
+  cell callback_index =
+    functions_.GetKnownPublicIndex(AMXFunctionTable::ON_RUNTIME_ERROR);
+  cell suppress = 0;
+
+  if (callback_index >= 0) {
+    if (amx_.CheckStack()) {
+      cell suppress_addr, *suppress_ptr;
+      amx_PushArray(amx_, &suppress_addr, &suppress_ptr, &suppress, 1);
+      amx_Push(amx_, error);
+      OnExec(retval, callback_index);
+      amx_Release(amx_, suppress_addr);
+      suppress = *suppress_ptr;
+    }
+  }
+  return suppress;
+}
+
+// public OnCrashDetectLongCall(const func[], elapsed_us);
+void CrashDetect::CallOnLongCall(int index,
+                                 std::chrono::microseconds duration) {
+  cell callback_index = functions_.GetKnownPublicIndex(
+    AMXFunctionTable::ON_CRASHDETECT_LONG_CALL);
+  if (callback_index < 0 || !amx_.CheckStack()) {
+    return;
+  }
+  const char *name = index == AMX_EXEC_MAIN
+    ? "main"
+    : amx_.GetPublicName(index);
+  if (name == nullptr) {
+    name = "";
+  }
+  cell func_addr, *func_ptr;
+  int num_cells = static_cast<int>(std::strlen(name)) + 1;
+  if (amx_Allot(amx_, num_cells, &func_addr, &func_ptr) != AMX_ERR_NONE) {
+    return;
+  }
+  amx_SetString(func_ptr, name, 0, 0, num_cells);
+  amx_Push(amx_, static_cast<cell>(duration.count()));
+  amx_Push(amx_, func_addr);
+  cell retval;
+  OnExec(&retval, callback_index);
+  amx_Release(amx_, func_addr);
+}
+
+int CrashDetect::OnLongCallRequest(int option, int value) {
+  if (option == AMX_LCT_CHECK) {
+    if (stack_usage_slot_ >= 0) {
+      SampleStackSpace();
+    }
+    if (Profiler::shared().IsSamplePending()) {
+      TakeProfileSample(-1);
+    }
+    if (IsWatchHitPending()) {
+      ReportWatchHits();
+    }
+  }
+  if (long_call_checks_) {
+    switch (option) {
+      case AMX_LCT_OPTION:
+        return LongCallOption(value);
+      case AMX_LCT_SET_TIME:
+        SetLongCallTime(static_cast<unsigned int>(value));
+        // The new limit applies to the rest of the current call even if
+        // the script has its own long_call_time.
+        LongCallWatchdog::shared().SetThreadTimeLimit(
+          std::chrono::microseconds(-1));
+        break;
+      case AMX_LCT_CHECK:
+        CheckLongCallTime();
+        break;
+    }
+  }
+  return AMX_ERR_NONE;
+}
+
+int CrashDetect::OnAddressNaughtRequest(int option) {
+  switch (option) {
+    case -1:
+      return address_naught_;
+    case 0:
+      address_naught_ = false;
+      break;
+    case 1:
+      address_naught_ = true;
+      break;
+  }
+  return AMX_ERR_NONE;
+}
+
+int CrashDetect::OnFunctionRequest(int event) {
+  switch (event) {
+    case AMX_FUNC_QUERY:
+      return function_hook_;
+    case AMX_FUNC_ENTER:
+      if (callgraph_) {
+        UpdateCallGraph();
+      }
+      if (trace_flags_ & TRACE_FUNCTIONS) {
+        TraceFunctionCall();
+      }
+      break;
+    case AMX_FUNC_RETURN:
+      // Returning from the public itself leaves CIP at 0, OnExec() closes
+      // its call graph frame.
+      if (callgraph_ && amx_.GetCip() != 0) {
+        UpdateCallGraph();
+      }
+      break;
+  }
+  return AMX_ERR_NONE;
+}
+
+// static
+void CrashDetect::OnCrash(const os::Context &context) {
+  // Whatever we print from now on should make it to the log even if the
+  // server dies right after.
+  LogEnterCrashMode();
+  LogChannelScope log_channel(LOG_CHANNEL_CRASH);
+
+  // The heap may well be corrupted, so get the native stack before doing
+  // anything that allocates memory.
+  int num_crash_frames = CaptureStackTrace(crash_frames,
+                                           kMaxStackFrames,
+                                           context.native_context());
+
+  // Crashes are handled on the thread that crashed, so this is its stack.
+  AMXCallStack &call_stack = GetCallStack();
+  CrashDetect *instance = nullptr;
+  if (!call_stack.IsEmpty()) {
+    instance = GetHandler(call_stack.Top().amx());
+  }
+  // Compiled code doesn't keep CIP, FRM and STK in the AMX, so if that's
+  // where the crash happened get them from the registers.
+  if (instance != nullptr && instance->jit_ != nullptr) {
+    os::Context::Registers registers = context.GetRegisters();
+    cell cip;
+    if (amx_JitGetCip(instance->jit_,
+                      reinterpret_cast<void *>(registers.eip),
+                      &cip) == AMX_ERR_NONE) {
+      instance->amx_.SetCip(cip);
+      instance->amx_.SetFrm(static_cast<cell>(registers.ebp));
+      instance->amx_.SetStk(static_cast<cell>(registers.edi));
+    }
+  }
+  // Like the native backtrace, the dump is written without allocating
+  // memory, so it's done before the report below.
+  const char *dump_path = CrashDump::shared().Write(context,
+                                                    crash_frames,
+                                                    num_crash_frames,
+                                                    call_stack,
+                                                    GetScriptPath);
+  if (dump_path != nullptr) {
+    LogDebugPrint("Crash dump saved to %s", dump_path);
+  }
+  ErrorReporter::shared().ReportCrash(
+    instance != nullptr ? instance->amx_name_.c_str() : nullptr,
+    crash_frames,
+    num_crash_frames,
+    dump_path);
+  std::vector<std::string> disassembly;
+  if (instance != nullptr) {
+    disassembly = instance->GetDisassembly(instance->amx_.GetCip());
+  }
+  if (IsJSONLog()) {
+    JSONWriter json;
+    BeginJSONEvent(json, "crash");
+    if (instance != nullptr) {
+      json.Field("script", instance->amx_name_);
+    }
+    WriteDisassembly(json, disassembly);
+    json.Key("backtrace");
+    WriteAMXBacktrace(json);
+    json.Key("native_backtrace");
+    WriteNativeBacktrace(json, crash_frames, num_crash_frames);
+    json.Key("registers");
+    WriteRegisters(json, context);
+    json.Key("modules");
+    WriteLoadedModules(json);
+    if (FlightRecorder::shared().IsEnabled()) {
+      json.Key("flight_recorder");
+      WriteFlightRecorder(json);
+    }
+    json.EndObject();
+    LogPrintJSON(json.str());
+    return;
+  }
+  if (instance != nullptr) {
+    LogDebugPrint("Server crashed while executing %s",\
+                  instance->amx_name_.c_str());
+  } else {
+    LogDebugPrint("Server crashed due to an unknown error");
+  }
+  PrintDisassembly(disassembly);
+  PrintAMXBacktrace();
+  PrintFlightRecorder();
+  PrintNativeBacktrace(crash_frames, num_crash_frames);
+  PrintRegisters(context);
+  PrintStack(context, instance);
+  PrintLoadedModules();
+}
+
+// static
+void CrashDetect::OnInterrupt(const os::Context &context) {
+  LogEnterCrashMode();
+  LogChannelScope log_channel(LOG_CHANNEL_CRASH);
+
+  // The signal may be delivered to any thread (on Windows it gets a new
+  // thread of its own), so unless it arrived in the middle of a call show
+  // what the server thread is doing. This thread won't run scripts again,
+  // so just borrow that stack.
+  if (GetCallStack().IsEmpty() && main_call_stack_ != nullptr) {
+    call_stack_ = main_call_stack_;
+  }
+  AMXCallStack &call_stack = GetCallStack();
+  CrashDetect *instance = nullptr;
+  if (!call_stack.IsEmpty()) {
+    instance = GetHandler(call_stack.Top().amx());
+  }
+  if (IsJSONLog()) {
+    JSONWriter json;
+    BeginJSONEvent(json, "interrupt");
+    if (instance != nullptr) {
+      json.Field("script", instance->amx_name_);
+    }
+    json.Key("backtrace");
+    WriteAMXBacktrace(json);
+    json.Key("native_backtrace");
+    WriteNativeBacktrace(json, context);
+    json.EndObject();
+    LogPrintJSON(json.str());
+    return;
+  }
+  if (instance != nullptr) {
+    LogDebugPrint("Server received interrupt signal while executing %s",
+                  instance->amx_name_.c_str());
+  } else {
+    LogDebugPrint("Server received interrupt signal");
+  }
+  PrintAMXBacktrace();
+  PrintNativeBacktrace(context.native_context());
+}
+
+bool CrashDetect::Watch(cell address, cell num_cells) {
+  // Debug registers are per thread, and there are only a few of them.
+  if (&GetCallStack() != main_call_stack_
+      || num_cells <= 0
+      || num_cells > os::kNumWatchpoints
+      || address < 0
+      || address % sizeof(cell) != 0
+      || address + num_cells * static_cast<cell>(sizeof(cell))
+           > amx_.GetStp()) {
+    return false;
+  }
+  Unwatch(address, num_cells);
+
+  int slots[os::kNumWatchpoints];
+  int num_slots = 0;
+  for (int slot = 0; slot < os::kNumWatchpoints && num_slots < num_cells;
+       slot++) {
+    if (watchpoints_[slot].amx == nullptr) {
+      slots[num_slots++] = slot;
+    }
+  }
+  if (num_slots < num_cells) {
+    return false;
+  }
+  for (int i = 0; i < num_slots; i++) {
+    cell cell_address = address + i * static_cast<cell>(sizeof(cell));
+    if (!os::SetWatchpoint(slots[i],
+                           amx_.GetData() + cell_address,
+                           sizeof(cell))) {
+      Unwatch(address, i);
+      return false;
+    }
+    watchpoints_[slots[i]].amx = amx();
+    watchpoints_[slots[i]].address = cell_address;
+    watchpoints_[slots[i]].data =
+      reinterpret_cast<const cell *>(amx_.GetData() + cell_address);
+  }
+  return true;
+}
+
+void CrashDetect::Unwatch(cell address, cell num_cells) {
+  cell end = address + num_cells * static_cast<cell>(sizeof(cell));
+  for (int slot = 0; slot < os::kNumWatchpoints; slot++) {
+    Watchpoint &watchpoint = watchpoints_[slot];
+    if (watchpoint.amx == amx()
+        && watchpoint.address >= address
+        && watchpoint.address < end) {
+      os::ClearWatchpoint(slot);
+      watchpoint.amx = nullptr;
+    }
+  }
+}
+
+// static
+void CrashDetect::OnWatch(const os::Context &context, int slot) {
+  // This may have interrupted anything, including malloc() or a thread
+  // holding the log lock, so just record the write for ReportWatchHits().
+  const Watchpoint &watchpoint = watchpoints_[slot];
+  if (watchpoint.amx == nullptr) {
+    return;
+  }
+  WatchHit &hit = watch_hits_[slot];
+  hit.amx = watchpoint.amx;
+  hit.address = watchpoint.address;
+  // The CPU traps after the write, so this is the new value.
+  hit.value = *watchpoint.data;
+  hit.code_address = context.GetRegisters().eip;
+  hit.writes.fetch_add(1);
+  watch_hit_pending_ = true;
+}
+
+// static
+void CrashDetect::ReportWatchHits() {
+  watch_hit_pending_ = false;
+  for (int slot = 0; slot < os::kNumWatchpoints; slot++) {
+    WatchHit &hit = watch_hits_[slot];
+    uint32_t writes = hit.writes.exchange(0);
+    if (writes == 0) {
+      continue;
+    }
+    CrashDetect *instance = GetHandler(hit.amx);
+    if (instance == nullptr) {
+      continue;
+    }
+    // Where the last write was made from; the backtraces are of where the
+    // script is now.
+    void *code_address =
+      reinterpret_cast<void *>(static_cast<std::uintptr_t>(hit.code_address));
+    if (IsJSONLog()) {
+      JSONWriter json;
+      BeginJSONEvent(json, "watch");
+      json.Field("script", instance->amx_name_);
+      json.Field("address", static_cast<long long>(hit.address));
+      json.Field("value", static_cast<long long>(hit.value));
+      json.Field("writes", static_cast<long long>(writes));
+      json.Key("backtrace");
+      WriteAMXBacktrace(json);
+      json.Key("native_backtrace");
+      WriteNativeBacktrace(json, &code_address, 1);
+      json.EndObject();
+      LogPrintJSON(json.str());
+      continue;
+    }
+    LogDebugPrint("Watched address %08x in %s changed to %d (%08x)",
+                  static_cast<ucell>(hit.address),
+                  instance->amx_name_.c_str(),
+                  static_cast<int>(hit.value),
+                  static_cast<ucell>(hit.value));
+    const char *name = FindSymbolName(code_address);
+    const char *module = ModuleTable::shared().FindModuleName(code_address);
+    LogDebugPrint(" Written %u time%s, last by %08lx in %s ()%s%s",
+                  static_cast<unsigned int>(writes),
+                  writes != 1 ? "s" : "",
+                  static_cast<unsigned long>(hit.code_address),
+                  name != nullptr && name[0] != '\0' ? name : "??",
+                  module != nullptr ? " in " : "",
+                  module != nullptr ? module : "");
+    PrintReportBacktraces();
+  }
+}
+
+void CrashDetect::PrintTraceFrame(TraceRecord::Kind kind,
+                                  const AMXStackFrame &frame) {
+  if (IsJSONLog()) {
+    std::stringstream function;
+    std::stringstream arguments;
+    AMXStackFramePrinter(function, *debug_info_, &frame_cache_)
+      .PrintCallerName(frame);
+    AMXStackFramePrinter(arguments, *debug_info_, &frame_cache_)
+      .PrintArgumentList(frame);
+    PrintTraceJSON(kind,
+                   amx_name_,
+                   function.str(),
+                   arguments.str(),
+                   *debug_info_,
+                   frame.return_address());
+    return;
+  }
+
+  std::string text;
+  text.reserve(256);
+  AMXStackFramePrinter printer(text, *debug_info_, &frame_cache_);
+  printer.PrintCallerNameAndArguments(frame);
+  PrintTrace(text);
+}
+
+void CrashDetect::PushTraceRecord(TraceRecord::Kind kind,
+                                  cell index,
+                                  const AMXStackFrame &frame) {
+  // If debug info loading is deferred, do it here rather than on the trace
+  // buffer thread.
+  debug_info_->IsLoaded();
+
+  TraceRecord record;
+  record.time = TraceBuffer::shared().GetTime();
+  record.start_time = record.time;
+  record.amx = amx();
+  record.kind = kind;
+  record.index = index;
+  record.caller_address = frame.caller_address();
+  record.return_address = frame.return_address();
+  record.frame = frame.address();
+  record.num_args = frame.GetArgumentValues(record.args, TraceRecord::kMaxArgs);
+  frame.GetArgumentData(*debug_info_,
+                        record.args,
+                        std::min<cell>(record.num_args, TraceRecord::kMaxArgs),
+                        &record.arg_data,
+                        &frame_cache_);
+  TraceBuffer::shared().Push(record);
+}
+
+void CrashDetect::PushNativeTraceRecord(cell index,
+                                        const cell *params,
+                                        cell retval,
+                                        int64_t start_time) {
+  TraceRecord record;
+  record.time = TraceBuffer::shared().GetTime();
+  record.start_time = start_time;
+  record.amx = amx();
+  record.kind = TraceRecord::NATIVE;
+  record.index = index;
+  record.caller_address = 0;
+  record.return_address = amx_.GetCip();
+  record.frame = amx_.GetFrm();
+  record.num_args = params[0] / static_cast<cell>(sizeof(cell));
+  cell num_values = std::min<cell>(record.num_args, TraceRecord::kMaxArgs);
+  for (cell i = 0; i < num_values; i++) {
+    record.args[i] = params[i + 1];
+  }
+  // Copied after the call, so references and output strings hold what the
+  // native has put in them.
+  if (const NativeSignature *signature = GetNativeSignature(index)) {
+    GetNativeArgumentData(amx_,
+                          *signature,
+                          record.args,
+                          num_values,
+                          &record.arg_data);
+  } else {
+    std::memset(record.arg_data.sizes, 0, sizeof(record.arg_data.sizes));
+  }
+  record.retval = retval;
+  TraceBuffer::shared().Push(record);
+}
+
+void CrashDetect::PushReturnTraceRecord(cell index) {
+  TraceRecord record;
+  record.time = TraceBuffer::shared().GetTime();
+  record.start_time = record.time;
+  record.amx = amx();
+  record.kind = TraceRecord::PUBLIC_RETURN;
+  record.index = index;
+  record.caller_address = 0;
+  record.return_address = 0;
+  record.frame = 0;
+  record.num_args = 0;
+  record.retval = 0;
+  TraceBuffer::shared().Push(record);
+}
+
+// Natives are traced with their arguments only if their signatures are
+// known, otherwise there's no telling strings from numbers.
+void CrashDetect::PrintNativeTrace(cell index,
+                                   const cell *values,
+                                   cell num_args,
+                                   const AMXArgumentData *data) const {
+  const NativeSignature *signature = GetNativeSignature(index);
+  if (signature == nullptr) {
+    if (IsJSONLog()) {
+      const char *name = amx_.GetNativeName(index);
+      PrintTraceJSON(TraceRecord::NATIVE,
+                     amx_name_,
+                     name != nullptr ? name : "<unknown>",
+                     "",
+                     *debug_info_,
+                     0);
+    } else {
+      LogTracePrint("%s", GetNativeTraceText(amx_, index).c_str());
+    }
+    return;
+  }
+
+  std::string arguments;
+  AMXStackFramePrinter(arguments, *debug_info_).PrintNativeArgumentList(
+    *signature,
+    values,
+    std::min<cell>(num_args, TraceRecord::kMaxArgs),
+    num_args,
+    data);
+  if (IsJSONLog()) {
+    PrintTraceJSON(TraceRecord::NATIVE,
+                   amx_name_,
+                   signature->name,
+                   arguments,
+                   *debug_info_,
+                   0);
+  } else {
+    LogTracePrint("native %s (%s)",
+                  signature->name.c_str(),
+                  arguments.c_str());
+  }
+}
+
+// static
+void CrashDetect::FormatTraceRecord(const TraceRecord &record) {
+  // Scripts flush the trace buffer before they're unloaded (and before new
+  // handlers are created), so the handler can't go away in the meantime.
+  CrashDetect *handler = GetHandler(record.amx);
+  if (handler == nullptr) {
+    return;
+  }
+
+  if (record.kind == TraceRecord::NATIVE) {
+    handler->PrintNativeTrace(record.index,
+                              record.args,
+                              record.num_args,
+                              &record.arg_data);
+    return;
+  }
+
+  AMXStackFrame frame(handler->amx_,
+                      0,
+                      record.return_address,
+                      0,
+                      record.caller_address);
+  cell num_args = std::min<cell>(record.num_args, TraceRecord::kMaxArgs);
+
+  if (IsJSONLog()) {
+    std::stringstream function;
+    std::stringstream arguments;
+    AMXStackFramePrinter(function,
+                         *handler->debug_info_,
+                         &handler->trace_frame_cache_)
+      .PrintCallerName(frame);
+    AMXStackFramePrinter(arguments,
+                         *handler->debug_info_,
+                         &handler->trace_frame_cache_)
+      .PrintArgumentList(frame,
+                         record.args,
+                         num_args,
+                         record.num_args,
+                         &record.arg_data);
+    PrintTraceJSON(record.kind,
+                   handler->amx_name_,
+                   function.str(),
+                   arguments.str(),
+                   *handler->debug_info_,
+                   record.return_address);
+    return;
+  }
+
+  std::string text;
+  text.reserve(256);
+  AMXStackFramePrinter printer(text,
+                               *handler->debug_info_,
+                               &handler->trace_frame_cache_);
+  printer.PrintCallerNameAndArguments(
+    frame,
+    record.args,
+    num_args,
+    record.num_args,
+    &record.arg_data);
+  PrintTrace(text);
+}
+
+void CrashDetect::InitTrace() {
+  trace_flags_ = Options::shared().GetScriptTraceFlags(amx_path_);
+  native_trace_table_.clear();
+  public_trace_table_.clear();
+  function_trace_filter_.clear();
+  if (trace_flags_ != 0) {
+    InitTraceFilter();
+    if (Options::shared().trace_mode() == TRACE_MODE_COUNTS) {
+      InitTraceCounts();
+    } else {
+      InitTraceSampler();
+    }
+  }
+  // timer_stats finds the timer natives the same way as trace t.
+  timer_stats_ = Options::shared().timer_stats();
+  if (timer_stats_ && native_trace_table_.empty()) {
+    native_trace_table_.assign(amx_.GetNumNatives(), 0);
+  } else if (!timer_stats_) {
+    timers_.clear();
+    timer_publics_.clear();
+  }
+}
+
+void CrashDetect::InitTraceFilter() {
+  const Options &options = Options::shared();
+
+  // Natives are looked at on their first call (see GetNativeTraceFlags()).
+  if (trace_flags_ & (TRACE_NATIVES | TRACE_TIMERS)) {
+    native_trace_table_.assign(amx_.GetNumNatives(), 0);
+  }
+
+  // Timer callbacks are only known once SetTimer() has been called.
+  if (trace_flags_ & (TRACE_PUBLICS | TRACE_TIMERS)) {
+    int num_publics = amx_.GetNumPublics();
+    public_trace_table_.assign(num_publics + 1, false);
+    if (trace_flags_ & TRACE_PUBLICS) {
+      for (int i = AMX_EXEC_MAIN; i < num_publics; i++) {
+        const char *name = amx_.GetPublicName(i);
+        public_trace_table_[i + 1] =
+          name != nullptr && MatchesAnyPattern(options.trace_publics(), name);
+      }
+    }
+  }
+
+  if ((options.trace_filter() != nullptr && options.trace_filter_names_only())
+      || !options.trace_files().empty()) {
+    const AMX_HEADER *hdr = amx_.GetHeader();
+    function_trace_filter_.assign((hdr->dat - hdr->cod) / sizeof(cell), 0);
+  }
+}
+
+unsigned char CrashDetect::GetNativeTraceFlags(cell index) {
+  if (index < 0 || index >= static_cast<cell>(native_trace_table_.size())) {
+    return 0;
+  }
+  unsigned char &flags = native_trace_table_[index];
+  if (flags != 0) {
+    return flags;
+  }
+
+  flags = NATIVE_TRACE_CHECKED;
+  const char *name = amx_.GetNativeName(index);
+  if (name == nullptr) {
+    return flags;
+  }
+  if (((trace_flags_ & TRACE_TIMERS) || timer_stats_)
+      && (std::strcmp(name, "SetTimer") == 0
+          || std::strcmp(name, "SetTimerEx") == 0)) {
+    flags |= NATIVE_TRACE_SETS_TIMER;
+  }
+  if (timer_stats_ && std::strcmp(name, "KillTimer") == 0) {
+    flags |= NATIVE_TRACE_KILLS_TIMER;
+  }
+  if (trace_flags_ & TRACE_NATIVES) {
+    const Options &options = Options::shared();
+    // Native trace messages contain nothing but the name of the native, so
+    // the filter gives the same result every time.
+    bool traced = options.trace_filter() == nullptr
+      || options.trace_filter()->Test(GetNativeTraceText(amx_, index));
+    if (traced && !options.trace_native_modules().empty()) {
+      void *address = reinterpret_cast<void *>(amx_.GetNativeAddress(index));
+      std::string module = address != nullptr
+        ? fileutils::GetFileName(ModuleTable::shared().GetModuleName(address))
+        : std::string();
+      traced = !module.empty()
+        && MatchesAnyPattern(options.trace_native_modules(), module);
+    }
+    if (traced) {
+      flags |= NATIVE_TRACE_ON;
+    }
+  }
+  return flags;
+}
+
+const NativeSignature *CrashDetect::GetNativeSignature(cell index) const {
+  if (index < 0 || index >= static_cast<cell>(native_signatures_.size())) {
+    return nullptr;
+  }
+  return native_signatures_[index];
+}
+
+bool CrashDetect::IsNativeTraced(cell index) {
+  return (GetNativeTraceFlags(index) & NATIVE_TRACE_ON) != 0;
+}
+
+bool CrashDetect::IsPublicTraced(cell index) const {
+  std::size_t slot = static_cast<std::size_t>(index + 1);
+  return slot < public_trace_table_.size() && public_trace_table_[slot];
+}
+
+// native SetTimer(const funcname[], interval, bool:repeating);
+// native SetTimerEx(const funcname[], interval, bool:repeating,
+//                   const format[], {Float, _}:...);
+void CrashDetect::AddTimerPublic(const cell *params) {
+  if (params[0] < static_cast<cell>(sizeof(cell))) {
+    return;
+  }
+  std::string name = amx_.GetDataString(params[1]);
+  cell index = functions_.GetPublicIndex(name.c_str());
+  if (index >= 0 && !IsPublicTraced(index)) {
+    public_trace_table_[index + 1] = true;
+  }
+}
+
+void CrashDetect::AddTimer(const cell *params, cell id) {
+  if (params[0] < static_cast<cell>(3 * sizeof(cell)) || id == 0) {
+    return;
+  }
+  std::string name = amx_.GetDataString(params[1]);
+  cell index = functions_.GetPublicIndex(name.c_str());
+  if (index < 0) {
+    return;
+  }
+  // The server reuses the IDs of timers that have finished.
+  RemoveTimer(id);
+  Timer &timer = timers_[id];
+  timer.public_index = index;
+  timer.interval = static_cast<int64_t>(params[2]) * 1000;
+  timer.repeating = params[3] != 0;
+  timer.due = timer_publics_[index].due.insert(
+    std::make_pair(fastclock::Now() + timer.interval, id));
+}
+
+void CrashDetect::RemoveTimer(cell id) {
+  std::unordered_map<cell, Timer>::iterator it = timers_.find(id);
+  if (it != timers_.end()) {
+    timer_publics_[it->second.public_index].due.erase(it->second.due);
+    timers_.erase(it);
+  }
+}
+
+// Returns the statistics of the public if one of its timers is due, which
+// is the one taken to be firing now.
+CrashDetect::TimerPublic *CrashDetect::FireTimer(cell index) {
+  std::unordered_map<cell, TimerPublic>::iterator public_it =
+    timer_publics_.find(index);
+  if (public_it == timer_publics_.end() || public_it->second.due.empty()) {
+    return nullptr;
+  }
+  TimerPublic &timer_public = public_it->second;
+  std::multimap<int64_t, cell>::iterator due_it = timer_public.due.begin();
+  cell id = due_it->second;
+  Timer &timer = timers_[id];
+  // Calls that come long before the timer is due must be coming from
+  // somewhere else, e.g. another plugin calling the public.
+  int64_t now = fastclock::Now();
+  if (now < due_it->first - timer.interval / 2) {
+    return nullptr;
+  }
+  timer_public.jitter.Record(now >= due_it->first ? now - due_it->first
+                                                  : due_it->first - now);
+  timer_public.due.erase(due_it);
+  if (timer.repeating) {
+    timer.due = timer_public.due.insert(
+      std::make_pair(now + timer.interval, id));
+  } else {
+    timers_.erase(id);
+  }
+  return &timer_public;
+}
+
+bool CrashDetect::PrintTimerStats() {
+  if (!timer_stats_) {
+    return false;
+  }
+
+  std::vector<std::pair<cell, const TimerPublic *>> publics;
+  for (std::unordered_map<cell, TimerPublic>::const_iterator it =
+         timer_publics_.begin();
+       it != timer_publics_.end(); it++) {
+    if (it->second.cost.count() != 0) {
+      publics.push_back(std::make_pair(it->first, &it->second));
+    }
+  }
+  std::size_t num_shown = std::min(publics.size(), kTraceCountsTopN);
+  std::partial_sort(publics.begin(),
+                    publics.begin() + num_shown,
+                    publics.end(),
+                    [](const std::pair<cell, const TimerPublic *> &a,
+                       const std::pair<cell, const TimerPublic *> &b) {
+                      return a.second->cost.sum() > b.second->cost.sum();
+                    });
+
+  LogDebugPrint("Timer times in %s (ms):", amx_name_.c_str());
+  for (std::size_t i = 0; i < num_shown; i++) {
+    const TimerPublic &timer_public = *publics[i].second;
+    const char *name = amx_.GetPublicName(publics[i].first);
+    LogDebugPrint("%10llu calls %12.3f total %9.3f p99 %9.3f max "
+                  "%9.3f p99 jitter %9.3f max jitter %6u running %s",
+                  static_cast<unsigned long long>(timer_public.cost.count()),
+                  timer_public.cost.sum() / 1000.0,
+                  timer_public.cost.GetPercentile(99) / 1000.0,
+                  timer_public.cost.max() / 1000.0,
+                  timer_public.jitter.GetPercentile(99) / 1000.0,
+                  timer_public.jitter.max() / 1000.0,
+                  static_cast<unsigned int>(timer_public.due.size()),
+                  name != nullptr ? name : "<unknown>");
+  }
+  return true;
+}
+
+bool CrashDetect::IsFunctionTraced(const AMXStackFrame &frame) {
+  if (function_trace_filter_.empty()) {
+    // Either there's no filter or it has to be tested against the whole
+    // message, arguments included.
+    return true;
+  }
+
+  ucell slot = static_cast<ucell>(frame.caller_address()) / sizeof(cell);
+  if (slot >= function_trace_filter_.size()) {
+    return true;
+  }
+
+  unsigned char &result = function_trace_filter_[slot];
+  if (result == 0) {
+    const RegExp *filter = Options::shared().trace_filter();
+    bool traced = IsFileTraced(frame.caller_address());
+    if (traced
+        && filter != nullptr
+        && Options::shared().trace_filter_names_only()) {
+      std::stringstream stream;
+      AMXStackFramePrinter printer(stream, *debug_info_, &frame_cache_);
+      printer.PrintCallerName(frame);
+      traced = filter->Test(stream.str());
+    }
+    result = traced ? 1 : 2;
+  }
+  return result == 1;
+}
+
+// Functions are matched by the path of the file they are defined in, as
+// recorded by the compiler, or just its name if the pattern doesn't
+// contain a slash.
+bool CrashDetect::IsFileTraced(cell address) const {
+  const std::vector<std::string> &patterns = Options::shared().trace_files();
+  if (patterns.empty()) {
+    return true;
+  }
+  if (!debug_info_->IsLoaded()) {
+    return false;
+  }
+  std::string path = debug_info_->GetFileNamePtr(address);
+  std::replace(path.begin(), path.end(), '\\', '/');
+  std::string name = fileutils::GetFileName(path);
+  for (std::size_t i = 0; i < patterns.size(); i++) {
+    const std::string &pattern = patterns[i];
+    if (stringutils::MatchWildcard(
+          pattern,
+          pattern.find('/') != std::string::npos ? path : name)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void CrashDetect::InitTraceSampler() {
+  unsigned int sample = Options::shared().trace_sample();
+  unsigned int rate = Options::shared().trace_rate();
+  const AMX_HEADER *hdr = amx_.GetHeader();
+  native_trace_sampler_.Init(amx_.GetNumNatives(), sample, rate);
+  public_trace_sampler_.Init(amx_.GetNumPublics(), sample, rate);
+  function_trace_sampler_.Init((hdr->dat - hdr->cod) / sizeof(cell),
+                               sample, rate);
+}
+
+bool CrashDetect::SampleFunctionCall() {
+  if (!function_trace_sampler_.IsEnabled()) {
+    return true;
+  }
+  // The current frame's return address points right after the CALL
+  // instruction, whose operand is the address of the current function.
+  // This is much cheaper than building a stack trace for calls that are
+  // going to be skipped anyway.
+  AMXStackFrame frame(amx_, amx_.GetFrm());
+  if (frame.return_address() == 0) {
+    return true;
+  }
+  ucell slot = static_cast<ucell>(frame.callee_address()) / sizeof(cell);
+  return function_trace_sampler_.Sample(slot);
+}
+
+void CrashDetect::HandleRconCommand() {
+  // public OnRconCommand(cmd[]);
+  if (amx_.amx()->paramcount < 1) {
+    return;
+  }
+  cell cmd_address =
+    *reinterpret_cast<cell*>(amx_.GetData() + amx_.GetStk());
+  std::string cmd = amx_.GetDataString(cmd_address);
+
+  // OnRconCommand is called in every script that has it, but the settings
+  // are only reloaded (and that is logged) if server.cfg has changed.
+  if (cmd == "crashdetect_reload") {
+    ReloadOptions();
+    return;
+  }
+
+  // crashdetect_trace <flags|off> [filter]
+  static const char kCommand[] = "crashdetect_trace";
+  std::size_t command_length = sizeof(kCommand) - 1;
+  if (cmd.compare(0, command_length, kCommand) != 0
+      || (cmd.length() > command_length && cmd[command_length] != ' ')) {
+    return;
+  }
+
+  std::string args = stringutils::TrimString(cmd.substr(command_length));
+  std::string flags = args.substr(0, args.find(' '));
+  std::vector<std::string> filter_patterns;
+  if (flags.length() < args.length()) {
+    std::string filter = stringutils::TrimString(args.substr(flags.length()));
+    if (!filter.empty()) {
+      filter_patterns.push_back(filter);
+    }
+  }
+  if (flags == "off") {
+    flags.clear();
+  }
+
+  // OnRconCommand is called in every script that has it, but the change
+  // only takes effect (and is logged) once.
+  SetTrace(flags, filter_patterns);
+}
+
+void CrashDetect::InitTraceCounts() {
+  ResetNativeCounts();
+  public_call_counts_.assign(amx_.GetNumPublics(), 0);
+  // Function counts are allocated on first use because the debug info may
+  // not be loaded yet.
+  function_call_counts_.clear();
+  trace_counts_start_ = std::chrono::steady_clock::now();
+  trace_counts_next_print_ =
+    trace_counts_start_ +
+    std::chrono::seconds(Options::shared().trace_interval());
+}
+
+void CrashDetect::CountFunctionCall() {
+  if (function_call_counts_.empty()) {
+    function_call_counts_.assign(debug_info_->GetNumFunctions(), 0);
+  }
+  // See SampleFunctionCall().
+  AMXStackFrame frame(amx_, amx_.GetFrm());
+  if (frame.return_address() != 0) {
+    IncrementCallCount(function_call_counts_,
+                       debug_info_->GetFunctionIndex(frame.callee_address()));
+  }
+}
+
+void CrashDetect::PrintTraceCounts() {
+  std::vector<CallCount> counts;
+  const RegExp *filter = Options::shared().trace_filter();
+  bool use_filter =
+    filter != nullptr && Options::shared().trace_filter_names_only();
+
+  for (std::size_t i = 0; i < natives_.size(); i++) {
+    if (natives_[i].calls != 0 && IsNativeTraced(i)) {
+      const char *name = amx_.GetNativeName(i);
+      counts.push_back(CallCount(natives_[i].calls,
+        FormatString("native %s (%.3f ms)",
+                     name != nullptr ? name : "<unknown>",
+                     natives_[i].time / 1000.0)));
+    }
+  }
+  for (std::size_t i = 0; i < public_call_counts_.size(); i++) {
+    if (public_call_counts_[i] != 0) {
+      const char *name = amx_.GetPublicName(i);
+      std::string text =
+        std::string("public ") + (name != nullptr ? name : "<unknown>");
+      if ((!use_filter || filter->Test(text))
+          && IsFileTraced(amx_.GetPublicAddress(i))) {
+        counts.push_back(CallCount(public_call_counts_[i], text));
+      }
+    }
+  }
+  for (std::size_t i = 0; i < function_call_counts_.size(); i++) {
+    if (function_call_counts_[i] != 0) {
+      AMXDebugInfo::Symbol function = debug_info_->GetFunctionByIndex(i);
+      std::string text = function.GetNamePtr();
+      if ((!use_filter || filter->Test(text))
+          && IsFileTraced(function.GetCodeStart())) {
+        counts.push_back(CallCount(function_call_counts_[i], text));
+      }
+    }
+  }
+
+  std::chrono::steady_clock::time_point now =
+    std::chrono::steady_clock::now();
+  if (!counts.empty()) {
+    std::size_t num_shown = std::min(counts.size(), kTraceCountsTopN);
+    std::partial_sort(counts.begin(),
+                      counts.begin() + num_shown,
+                      counts.end(),
+                      CompareCallCounts);
+    long seconds = static_cast<long>(
+      std::chrono::duration_cast<std::chrono::seconds>(
+        now - trace_counts_start_).count());
+    LogTracePrint("Most called functions in %s in the last %ld seconds:",
+                  amx_name_.c_str(), seconds);
+    for (std::size_t i = 0; i < num_shown; i++) {
+      LogTracePrint("%10u %s", counts[i].first, counts[i].second.c_str());
+    }
+  }
+
+  ResetNativeCounts();
+  std::fill(public_call_counts_.begin(), public_call_counts_.end(), 0);
+  std::fill(function_call_counts_.begin(), function_call_counts_.end(), 0);
+  trace_counts_start_ = now;
+  trace_counts_next_print_ =
+    now + std::chrono::seconds(Options::shared().trace_interval());
+}
+
+void CrashDetect::InitExecCounts() {
+  if (Options::shared().opcode_counts()) {
+    opcode_counts_.assign(AMX_NUM_COUNTED_OPS, 0);
+  }
+  if (Options::shared().block_counts()) {
+    AMX_HEADER *hdr = amx_.GetHeader();
+    target_counts_.assign((hdr->dat - hdr->cod) / sizeof(cell), 0);
+  }
+  exec_counts_.opcodes = opcode_counts_.empty() ? nullptr
+                                                : opcode_counts_.data();
+  exec_counts_.targets = target_counts_.empty() ? nullptr
+                                                : target_counts_.data();
+  int error = amx_SetExecCounts(amx(), &exec_counts_);
+  if (error != AMX_ERR_NONE) {
+    LogDebugPrint("Could not count opcodes in %s: %s",
+                  amx_name_.c_str(),
+                  aux_StrError(error));
+    opcode_counts_.clear();
+    target_counts_.clear();
+  }
+}
+
+bool CrashDetect::PrintOpcodeCounts() {
+  if (opcode_counts_.empty()) {
+    return false;
+  }
+
+  std::vector<int> opcodes;
+  unsigned long long total = 0;
+  for (std::size_t i = 0; i < opcode_counts_.size(); i++) {
+    if (opcode_counts_[i] != 0) {
+      opcodes.push_back(static_cast<int>(i));
+      total += opcode_counts_[i];
+    }
+  }
+  std::sort(opcodes.begin(), opcodes.end(), [this](int a, int b) {
+    return opcode_counts_[a] > opcode_counts_[b];
+  });
+
+  // The counters keep running while this is printed if the script calls
+  // PrintOpcodeCounts(), which doesn't matter much.
+  LogDebugPrint("Executed %llu instructions in %s:", total,
+                amx_name_.c_str());
+  for (std::size_t i = 0; i < opcodes.size(); i++) {
+    unsigned long long count = opcode_counts_[opcodes[i]];
+    LogDebugPrint("%15llu %6.2f%% %s",
+                  count,
+                  100.0 * count / total,
+                  GetAMXOpcodeName(opcodes[i]));
+  }
+  return true;
+}
+
+bool CrashDetect::PrintBlockCounts() {
+  if (target_counts_.empty()) {
+    return false;
+  }
+
+  std::vector<cell> targets;
+  for (std::size_t i = 0; i < target_counts_.size(); i++) {
+    if (target_counts_[i] != 0) {
+      targets.push_back(static_cast<cell>(i));
+    }
+  }
+  std::size_t num_shown = std::min(targets.size(), kBlockCountsTopN);
+  std::partial_sort(targets.begin(),
+                    targets.begin() + num_shown,
+                    targets.end(),
+                    [this](cell a, cell b) {
+                      return target_counts_[a] > target_counts_[b];
+                    });
+
+  LogDebugPrint("Most frequent jump and call targets in %s:",
+                amx_name_.c_str());
+  for (std::size_t i = 0; i < num_shown; i++) {
+    cell address = targets[i] * sizeof(cell);
+    std::stringstream location;
+    if (debug_info_->IsLoaded()) {
+      AMXDebugInfo::Symbol function = debug_info_->GetFunction(address);
+      if (function) {
+        location << function.GetNamePtr() << " at ";
+      }
+      AMXStackFramePrinter(location, *debug_info_, &frame_cache_)
+        .PrintSourceLocation(address);
+    } else {
+      const char *name = functions_.FindPublic(address);
+      location << std::hex << std::setw(8) << std::setfill('0') << address;
+      if (name != nullptr) {
+        location << " (" << name << ")";
+      }
+    }
+    LogDebugPrint("%15llu %s",
+                  static_cast<unsigned long long>(target_counts_[targets[i]]),
+                  location.str().c_str());
+  }
+  return true;
+}
+
+// Called from the native callback and long call checks, where the AMX
+// registers are up to date.
+void CrashDetect::TakeProfileSample(cell native_index) {
+  // Only one thread can push samples.
+  if (&GetCallStack() != main_call_stack_) {
+    return;
+  }
+  ProfileSample sample;
+  FillProfileSample(sample, native_index);
+  if (file_stats_ && sample.depth > 0) {
+    file_stats_samples_[sample.functions[0]]++;
+  }
+  if (Options::shared().profiler_native()) {
+    sample.native_depth =
+      CaptureFastStackTrace(sample.native_frames,
+                            ProfileSample::kMaxNativeDepth);
+  }
+  Profiler::shared().Push(sample);
+}
+
+void CrashDetect::FillProfileSample(ProfileSample &sample,
+                                    cell native_index) const {
+  sample.amx = amx_;
+  sample.native_index = native_index;
+  sample.depth = 0;
+  sample.native_depth = 0;
+
+  // The frame of the public itself has no caller to take its address from.
+  cell public_address = 0;
+  const AMXCallStack &call_stack = GetCallStack();
+  for (AMXCallStack::const_iterator it = call_stack.begin();
+       it != call_stack.end(); ++it) {
+    if (it->IsPublic() && it->amx() == amx_) {
+      public_address = amx_.GetPublicAddress(it->index());
+      break;
+    }
+  }
+
+  // Samples are taken every few milliseconds in the same call, and most of
+  // the stack is usually the same as last time.
+  if (public_address != profile_walk_public_) {
+    profile_walk_cache_.Clear();
+    profile_walk_public_ = public_address;
+  }
+  const std::vector<AMXStackWalkCache::Frame> &frames =
+    profile_walk_cache_.Walk(amx_,
+                             amx_.GetFrm(),
+                             amx_.GetCip(),
+                             ProfileSample::kMaxDepth);
+  for (std::size_t i = 0; i < frames.size(); i++) {
+    cell address = frames[i].caller_address;
+    sample.functions[sample.depth++] =
+      address != 0 ? address : public_address;
+    if (address == 0) {
+      break;
+    }
+  }
+}
+
+// static
+void CrashDetect::ResolveProfileSample(const ProfileSample &sample,
+                                       std::vector<std::string> &frames) {
+  CrashDetect *handler = GetHandler(sample.amx);
+  if (handler == nullptr) {
+    return;
+  }
+
+  // The native frames are the code that called into the script. Our own
+  // frames are left out, along with anything they called.
+  static const std::string plugin_module = ModuleTable::shared().GetModuleName(
+    reinterpret_cast<void *>(&CrashDetect::ResolveProfileSample));
+  std::vector<SymbolizedFrame> native_frames;
+  Symbolizer::shared().Resolve(sample.native_frames,
+                               sample.native_depth,
+                               native_frames);
+  for (int i = sample.native_depth - 1; i >= 0; i--) {
+    const SymbolizedFrame &frame = native_frames[i];
+    if (frame.module == plugin_module) {
+      break;
+    }
+    if (!frame.function.empty()) {
+      frames.push_back(frame.function);
+    } else {
+      frames.push_back(FormatString("%s!0x%08X",
+        fileutils::GetFileName(frame.module).c_str(),
+        static_cast<unsigned>(
+          reinterpret_cast<std::uintptr_t>(frame.address))));
+    }
+  }
+
+  frames.push_back(handler->amx_name_);
+  for (int i = sample.depth - 1; i >= 0; i--) {
+    cell address = sample.functions[i];
+    const char *name = nullptr;
+    if (handler->debug_info_->IsLoaded()) {
+      AMXDebugInfo::Symbol function =
+        handler->debug_info_->GetFunction(address);
+      if (function) {
+        name = function.GetNamePtr();
+      }
+    }
+    if (name == nullptr) {
+      name = handler->functions_.FindPublic(address);
+    }
+    if (name != nullptr) {
+      frames.push_back(name);
+    } else {
+      frames.push_back(FormatString("0x%08X", static_cast<unsigned>(address)));
+    }
+  }
+  if (sample.native_index >= 0) {
+    const char *name = handler->amx_.GetNativeName(sample.native_index);
+    frames.push_back(name != nullptr ? name : "<unknown>");
+  }
+}
+
+// Called on every line. A function is entered when a frame appears below
+// the current one, and has returned when we're back in a frame above it.
+// A call to another function from the same place looks like its own frame
+// with a different return address.
+void CrashDetect::UpdateCallGraph() {
+  cell frm = amx_.GetFrm();
+  while (callgraph_stack_.size() > callgraph_base_
+         && callgraph_stack_.back().frame < frm) {
+    PopCallGraphFrame();
+  }
+  AMXStackFrame frame(amx_, frm);
+  if (callgraph_stack_.size() > callgraph_base_) {
+    const CallGraphFrame &top = callgraph_stack_.back();
+    if (top.frame == frm) {
+      if (top.return_address == frame.return_address()) {
+        return;
+      }
+      PopCallGraphFrame();
+    }
+  }
+  // The public's frame has no return address to find the callee by.
+  cell function = frame.return_address() != 0 ? frame.callee_address()
+                                              : callgraph_public_;
+  PushCallGraphFrame(function, frm, frame.return_address());
+}
+
+void CrashDetect::PushCallGraphFrame(cell function,
+                                     cell frame,
+                                     cell return_address) {
+  CallGraphFrame call_frame;
+  call_frame.function = function;
+  call_frame.frame = frame;
+  call_frame.return_address = return_address;
+  call_frame.start = fastclock::Now();
+  call_frame.child_time = 0;
+  callgraph_stack_.push_back(call_frame);
+  callgraph_nodes_[function].active++;
+}
+
+void CrashDetect::PopCallGraphFrame() {
+  CallGraphFrame call_frame = callgraph_stack_.back();
+  callgraph_stack_.pop_back();
+  int64_t time = fastclock::Now() - call_frame.start;
+
+  CallGraphNode &node = callgraph_nodes_[call_frame.function];
+  node.calls++;
+  node.exclusive += time - call_frame.child_time;
+  // Recursive calls are already included in the outermost one.
+  if (--node.active == 0) {
+    node.inclusive += time;
+  }
+
+  if (!callgraph_stack_.empty()) {
+    CallGraphFrame &caller = callgraph_stack_.back();
+    caller.child_time += time;
+    uint64_t key = (static_cast<uint64_t>(
+                      static_cast<uint32_t>(caller.function)) << 32)
+                 | static_cast<uint32_t>(call_frame.function);
+    CallGraphEdge &edge = callgraph_edges_[key];
+    edge.calls++;
+    edge.time += time;
+  }
+}
+
+// Returns the file and name that the call graph file refers to a function
+// by. Natives don't have a file.
+void CrashDetect::GetCallGraphName(cell function,
+                                   std::string &file_name,
+                                   std::string &name) const {
+  if (function < 0) {
+    const char *native_name = amx_.GetNativeName(-1 - function);
+    file_name = "(natives)";
+    name = native_name != nullptr ? native_name : "<unknown>";
+    return;
+  }
+  file_name = "<unknown>";
+  name = FormatString("0x%08X", function);
+  if (debug_info_->IsLoaded()) {
+    if (AMXDebugInfo::File file = debug_info_->GetFile(function)) {
+      file_name = file.GetNamePtr();
+    }
+    if (AMXDebugInfo::Symbol symbol = debug_info_->GetFunction(function)) {
+      name = symbol.GetNamePtr();
+    }
+  }
+}
+
+bool CrashDetect::WriteCallGraph() {
+  if (!callgraph_) {
+    return false;
+  }
+
+  std::string filename = "callgrind.out." + amx_name_;
+  std::ofstream file(filename.c_str(), std::ios::out | std::ios::trunc);
+  if (!file) {
+    LogDebugPrint("Could not open call graph file '%s'", filename.c_str());
+    return false;
+  }
+
+  // Costs are given per function rather than per line, at the line where
+  // the function starts.
+  std::unordered_map<cell, int32_t> lines;
+  if (debug_info_->IsLoaded()) {
+    for (ArenaHashMap<cell, CallGraphNode>::const_iterator it =
+           callgraph_nodes_.begin();
+         it != callgraph_nodes_.end(); it++) {
+      if (it->first >= 0) {
+        AMXDebugInfo::Line line = debug_info_->GetLine(it->first);
+        lines[it->first] = line ? line.GetNumber() + 1 : 0;
+      }
+    }
+  }
+  std::unordered_map<cell, std::vector<cell>> callees;
+  for (ArenaHashMap<uint64_t, CallGraphEdge>::const_iterator it =
+         callgraph_edges_.begin();
+       it != callgraph_edges_.end(); it++) {
+    callees[static_cast<cell>(it->first >> 32)].push_back(
+      static_cast<cell>(it->first & 0xFFFFFFFF));
+  }
+
+  file << "# callgrind format\n"
+       << "version: 1\n"
+       << "creator: crashdetect\n"
+       << "cmd: " << amx_name_ << "\n"
+       << "positions: line\n"
+       << "events: Microseconds\n\n";
+  std::vector<cell> functions;
+  for (ArenaHashMap<cell, CallGraphNode>::const_iterator it =
+         callgraph_nodes_.begin();
+       it != callgraph_nodes_.end(); it++) {
+    cell function = it->first;
+    functions.push_back(function);
+    std::string file_name, name;
+    GetCallGraphName(function, file_name, name);
+    int32_t line = lines[function];
+    file << "fl=" << file_name << "\n"
+         << "fn=" << name << "\n"
+         << line << " " << it->second.exclusive << "\n";
+    const std::vector<cell> &function_callees = callees[function];
+    for (std::size_t i = 0; i < function_callees.size(); i++) {
+      cell callee = function_callees[i];
+      uint64_t key = (static_cast<uint64_t>(
+                        static_cast<uint32_t>(function)) << 32)
+                   | static_cast<uint32_t>(callee);
+      const CallGraphEdge &edge = callgraph_edges_[key];
+      GetCallGraphName(callee, file_name, name);
+      file << "cfi=" << file_name << "\n"
+           << "cfn=" << name << "\n"
+           << "calls=" << edge.calls << " " << lines[callee] << "\n"
+           << line << " " << edge.time << "\n";
+    }
+    file << "\n";
+  }
+
+  std::size_t num_shown = std::min(functions.size(), kTraceCountsTopN);
+  std::partial_sort(functions.begin(),
+                    functions.begin() + num_shown,
+                    functions.end(),
+                    [this](cell a, cell b) {
+                      return callgraph_nodes_[a].inclusive
+                           > callgraph_nodes_[b].inclusive;
+                    });
+  LogDebugPrint("Wrote call graph of %s to '%s', top functions (ms):",
+                amx_name_.c_str(),
+                filename.c_str());
+  for (std::size_t i = 0; i < num_shown; i++) {
+    const CallGraphNode &node = callgraph_nodes_[functions[i]];
+    std::string file_name, name;
+    GetCallGraphName(functions[i], file_name, name);
+    LogDebugPrint("%10llu calls %12.3f inclusive %12.3f exclusive %s",
+                  static_cast<unsigned long long>(node.calls),
+                  node.inclusive / 1000.0,
+                  node.exclusive / 1000.0,
+                  name.c_str());
+  }
+  return true;
+}
+
+void CrashDetect::InitCallbackStats() {
+  callback_stats_.clear();
+  callback_stats_.resize(amx_.GetNumPublics() + 1);
+  callback_native_time_.assign(callback_stats_.size(), 0);
+  callback_stats_next_print_ = std::chrono::steady_clock::now()
+    + std::chrono::seconds(Options::shared().callback_stats_interval());
+}
+
+void CrashDetect::InitArgumentStats() {
+  argument_stats_.reset(
+    new TopKCounter(Options::shared().argument_stats_size()));
+  argument_stats_next_print_ = std::chrono::steady_clock::now()
+    + std::chrono::seconds(Options::shared().argument_stats_interval());
+}
+
+bool CrashDetect::PrintArgumentStats() {
+  if (!argument_stats_) {
+    return false;
+  }
+
+  std::vector<TopKCounter::Entry> entries;
+  argument_stats_->GetTop(kTraceCountsTopN, entries);
+  LogDebugPrint("Callback times in %s by first argument (ms):",
+                amx_name_.c_str());
+  for (std::size_t i = 0; i < entries.size(); i++) {
+    const TopKCounter::Entry &entry = entries[i];
+    const char *name =
+      amx_.GetPublicName(static_cast<int>(entry.key >> 32));
+    LogDebugPrint("%10u calls %12.3f total (+/- %.3f) %s(%d)",
+                  entry.count,
+                  entry.weight / 1000.0,
+                  entry.error / 1000.0,
+                  name != nullptr ? name : "<unknown>",
+                  static_cast<int>(static_cast<uint32_t>(entry.key)));
+  }
+  return true;
+}
+
+int64_t CrashDetect::GetArgumentStats(int index,
+                                      std::string &public_name,
+                                      cell &argument,
+                                      cell &calls) const {
+  if (!argument_stats_ || index < 0) {
+    return -1;
+  }
+  std::vector<TopKCounter::Entry> entries;
+  argument_stats_->GetTop(static_cast<std::size_t>(index) + 1, entries);
+  if (static_cast<std::size_t>(index) >= entries.size()) {
+    return -1;
+  }
+  const TopKCounter::Entry &entry = entries[index];
+  const char *name = amx_.GetPublicName(static_cast<int>(entry.key >> 32));
+  public_name = name != nullptr ? name : "";
+  argument = static_cast<cell>(static_cast<uint32_t>(entry.key));
+  calls = static_cast<cell>(entry.count);
+  return entry.weight;
+}
+
+bool CrashDetect::PrintCallbackStats() {
+  if (callback_stats_.empty()) {
+    return false;
+  }
+
+  std::vector<int> slots;
+  for (std::size_t i = 0; i < callback_stats_.size(); i++) {
+    if (callback_stats_[i] && callback_stats_[i]->count() != 0) {
+      slots.push_back(static_cast<int>(i));
+    }
+  }
+  std::size_t num_shown = std::min(slots.size(), kTraceCountsTopN);
+  std::partial_sort(slots.begin(),
+                    slots.begin() + num_shown,
+                    slots.end(),
+                    [this](int a, int b) {
+                      return callback_stats_[a]->sum()
+                           > callback_stats_[b]->sum();
+                    });
+
+  LogDebugPrint("Callback times in %s (ms):", amx_name_.c_str());
+  for (std::size_t i = 0; i < num_shown; i++) {
+    const LatencyHistogram &histogram = *callback_stats_[slots[i]];
+    int64_t native_time = callback_native_time_[slots[i]];
+    const char *name = slots[i] == 0 ? "main"
+                                     : amx_.GetPublicName(slots[i] - 1);
+    LogDebugPrint("%10llu calls %12.3f total %12.3f script %12.3f natives "
+                  "%9.3f p50 %9.3f p99 %9.3f max %s",
+                  static_cast<unsigned long long>(histogram.count()),
+                  histogram.sum() / 1000.0,
+                  (histogram.sum() - native_time) / 1000.0,
+                  native_time / 1000.0,
+                  histogram.GetPercentile(50) / 1000.0,
+                  histogram.GetPercentile(99) / 1000.0,
+                  histogram.max() / 1000.0,
+                  name != nullptr ? name : "<unknown>");
+  }
+  return true;
+}
+
+bool CrashDetect::PrintNativeStats() {
+  if (!Options::shared().native_stats()) {
+    return false;
+  }
+
+  struct ModuleStats {
+    ModuleStats(): calls(0), time(0) {}
+    unsigned long long calls;
+    int64_t time;
+  };
+  std::unordered_map<std::string, ModuleStats> modules;
+  std::vector<int> natives;
+  for (std::size_t i = 0; i < natives_.size(); i++) {
+    const NativeSlot &slot = natives_[i];
+    if (slot.calls == 0) {
+      continue;
+    }
+    natives.push_back(static_cast<int>(i));
+    // natives_ is only filled in if natives are called directly, so take
+    // the address from the AMX.
+    std::string module = fileutils::GetFileName(
+      ModuleTable::shared().GetModuleName(
+        reinterpret_cast<void*>(amx_.GetNativeAddress(i))));
+    ModuleStats &stats = modules[module.empty() ? "<unknown>" : module];
+    stats.calls += slot.calls;
+    stats.time += slot.time;
+  }
+  std::size_t num_shown = std::min(natives.size(), kTraceCountsTopN);
+  std::partial_sort(natives.begin(),
+                    natives.begin() + num_shown,
+                    natives.end(),
+                    [this](int a, int b) {
+                      return natives_[a].time > natives_[b].time;
+                    });
+
+  LogDebugPrint("Native call times in %s (ms):", amx_name_.c_str());
+  for (std::size_t i = 0; i < num_shown; i++) {
+    const NativeSlot &slot = natives_[natives[i]];
+    const char *name = amx_.GetNativeName(natives[i]);
+    LogDebugPrint("%10u calls %12.3f total %s",
+                  slot.calls,
+                  slot.time / 1000.0,
+                  name != nullptr ? name : "<unknown>");
+  }
+
+  std::vector<std::pair<std::string, ModuleStats>> sorted_modules(
+    modules.begin(), modules.end());
+  std::sort(sorted_modules.begin(), sorted_modules.end(),
+            [](const std::pair<std::string, ModuleStats> &a,
+               const std::pair<std::string, ModuleStats> &b) {
+              return a.second.time > b.second.time;
+            });
+  LogDebugPrint("Native call times in %s by module (ms):", amx_name_.c_str());
+  for (std::size_t i = 0; i < sorted_modules.size(); i++) {
+    const ModuleStats &stats = sorted_modules[i].second;
+    LogDebugPrint("%10llu calls %12.3f total %s",
+                  stats.calls,
+                  stats.time / 1000.0,
+                  sorted_modules[i].first.c_str());
+  }
+  return true;
+}
+
+cell CrashDetect::GetCallbackStats(const char *public_name,
+                                   cell &p50,
+                                   cell &p99,
+                                   cell &max) const {
+  p50 = p99 = max = 0;
+  if (callback_stats_.empty()) {
+    return 0;
+  }
+  int index = functions_.GetPublicIndex(public_name);
+  if (index < 0 || !callback_stats_[index + 1]) {
+    return 0;
+  }
+  const LatencyHistogram &histogram = *callback_stats_[index + 1];
+  p50 = static_cast<cell>(histogram.GetPercentile(50));
+  p99 = static_cast<cell>(histogram.GetPercentile(99));
+  max = static_cast<cell>(histogram.max());
+  return static_cast<cell>(histogram.count());
+}
+
+// The figures come from callback_stats and native_stats, so they are for
+// the current interval of those settings.
+void CrashDetect::WriteMetrics(std::string &lines) const {
+  const Metrics &metrics = Metrics::shared();
+  std::string script =
+    "script." + Metrics::SanitizeName(fileutils::GetBaseName(amx_name_));
+  metrics.AppendGauge(lines, script + ".errors",
+                      static_cast<int64_t>(GetErrorCount(-1)));
+  for (std::size_t i = 0; i < callback_stats_.size(); i++) {
+    if (!callback_stats_[i] || callback_stats_[i]->count() == 0) {
+      continue;
+    }
+    const LatencyHistogram &histogram = *callback_stats_[i];
+    const char *name = i == 0 ? "main" : amx_.GetPublicName(i - 1);
+    if (name == nullptr) {
+      continue;
+    }
+    std::string prefix = script + ".public." + Metrics::SanitizeName(name);
+    metrics.AppendGauge(lines, prefix + ".calls",
+                        static_cast<int64_t>(histogram.count()));
+    metrics.AppendGauge(lines, prefix + ".p50", histogram.GetPercentile(50));
+    metrics.AppendGauge(lines, prefix + ".p99", histogram.GetPercentile(99));
+    metrics.AppendGauge(lines, prefix + ".max", histogram.max());
+    metrics.AppendGauge(lines, prefix + ".native_time",
+                        callback_native_time_[i]);
+  }
+  if (Options::shared().native_stats()) {
+    for (std::size_t i = 0; i < natives_.size(); i++) {
+      const NativeSlot &slot = natives_[i];
+      const char *name = amx_.GetNativeName(static_cast<int>(i));
+      if (slot.calls == 0 || name == nullptr) {
+        continue;
+      }
+      std::string prefix = script + ".native." + Metrics::SanitizeName(name);
+      metrics.AppendGauge(lines, prefix + ".calls", slot.calls);
+      metrics.AppendGauge(lines, prefix + ".time", slot.time);
+    }
+  }
+}
+
+void CrashDetect::WriteStats(StatsSegment &stats) const {
+  uint32_t script_index;
+  StatsScript *script = stats.AddScript(
+    fileutils::GetBaseName(amx_name_).c_str(), script_index);
+  if (script == nullptr) {
+    return;
+  }
+  script->errors = GetErrorCount(-1);
+  for (std::size_t i = 0; i < callback_stats_.size(); i++) {
+    if (!callback_stats_[i] || callback_stats_[i]->count() == 0) {
+      continue;
+    }
+    const LatencyHistogram &histogram = *callback_stats_[i];
+    const char *name = i == 0 ? "main" : amx_.GetPublicName(i - 1);
+    if (name == nullptr) {
+      continue;
+    }
+    StatsPublic *entry = stats.AddPublic(script_index, name);
+    if (entry == nullptr) {
+      break;
+    }
+    entry->calls = histogram.count();
+    entry->total = histogram.sum();
+    entry->p50 = histogram.GetPercentile(50);
+    entry->p99 = histogram.GetPercentile(99);
+    entry->max = histogram.max();
+  }
+  if (Options::shared().native_stats()) {
+    for (std::size_t i = 0; i < natives_.size(); i++) {
+      const NativeSlot &slot = natives_[i];
+      const char *name = amx_.GetNativeName(static_cast<int>(i));
+      if (slot.calls == 0 || name == nullptr) {
+        continue;
+      }
+      StatsNative *entry = stats.AddNative(script_index, name);
+      if (entry == nullptr) {
+        break;
+      }
+      entry->calls = slot.calls;
+      entry->time = slot.time;
+      const char *module = ModuleTable::shared().FindModuleName(
+        reinterpret_cast<void *>(slot.function));
+      if (module != nullptr) {
+        std::string module_name = fileutils::GetBaseName(module);
+        std::strncpy(entry->module, module_name.c_str(),
+                     sizeof(entry->module) - 1);
+      }
+    }
+  }
+}
+
+// static
+void CrashDetect::UpdateStats() {
+  StatsSegment &stats = StatsSegment::shared();
+  stats.BeginUpdate();
+  StatsHeader &header = stats.header();
+  for (int i = 0; i < Metrics::kNumErrorCodes; i++) {
+    header.errors[i] = Metrics::shared().GetErrorCount(i);
+  }
+  header.long_calls = Metrics::shared().GetLongCallCount();
+  header.dropped_log_lines = LogGetDroppedLines();
+  header.log_queued_bytes = LogGetQueuedBytes();
+  ForEachHandler([&stats](CrashDetect *handler) {
+    handler->WriteStats(stats);
+  });
+  stats.EndUpdate();
+}
+
+void CrashDetect::InitStackUsage() {
+  stack_space_.assign(amx_.GetNumPublics() + 1,
+                      std::numeric_limits<cell>::max());
+  stack_usage_next_print_ = std::chrono::steady_clock::now()
+    + std::chrono::seconds(Options::shared().stack_usage_interval());
+}
+
+void CrashDetect::SampleStackSpace() {
+  cell space = amx_.GetStk() - amx_.GetHea();
+  if (space < stack_space_[stack_usage_slot_]) {
+    stack_space_[stack_usage_slot_] = space;
+  }
+}
+
+bool CrashDetect::PrintStackUsage() {
+  if (stack_space_.empty()) {
+    return false;
+  }
+
+  std::vector<int> slots;
+  for (std::size_t i = 0; i < stack_space_.size(); i++) {
+    if (stack_space_[i] != std::numeric_limits<cell>::max()) {
+      slots.push_back(static_cast<int>(i));
+    }
+  }
+  std::sort(slots.begin(), slots.end(), [this](int a, int b) {
+    return stack_space_[a] < stack_space_[b];
+  });
+
+  // The space between HLW and STP is shared by the heap (growing up) and
+  // the stack (growing down).
+  cell total = amx_.GetStp() - amx_.GetHlw();
+  LogDebugPrint("Stack usage in %s (%d bytes for stack and heap):",
+                amx_name_.c_str(),
+                static_cast<int>(total));
+  for (std::size_t i = 0; i < slots.size(); i++) {
+    cell space = stack_space_[slots[i]];
+    const char *name = slots[i] == 0 ? "main"
+                                     : amx_.GetPublicName(slots[i] - 1);
+    LogDebugPrint("%10d bytes used, %10d free (%5.1f%%) %s",
+                  static_cast<int>(total - space),
+                  static_cast<int>(space),
+                  total > 0 ? 100.0 * space / total : 0.0,
+                  name != nullptr ? name : "<unknown>");
+  }
+  if (!slots.empty()) {
+    PrintStackRecommendation(total, total - stack_space_[slots[0]]);
+  }
+  return true;
+}
+
+// #pragma dynamic is in cells and sets the size of the stack and the heap
+// together, i.e. STP - HLW. The peak is only checked now and then (see
+// stack_usage), so the headroom also covers what may have been missed.
+void CrashDetect::PrintStackRecommendation(cell total, cell peak) const {
+  if (peak <= 0) {
+    return;
+  }
+  // Rounded up to 4 KB on 32-bit cells, like the compiler's default of
+  // 4096 cells, so the numbers are easier to read.
+  const int64_t kGranularity = 1024;
+  int64_t headroom = Options::shared().stack_usage_headroom();
+  int64_t wanted = static_cast<int64_t>(peak) * (100 + headroom) / 100;
+  int64_t cells = (wanted + sizeof(cell) - 1) / sizeof(cell);
+  cells = (cells + kGranularity - 1) / kGranularity * kGranularity;
+  int64_t difference =
+    static_cast<int64_t>(total) - cells * static_cast<int64_t>(sizeof(cell));
+  LogDebugPrint("Peak stack/heap usage in %s is %d of %d bytes, "
+                "#pragma dynamic %lld would leave %d%% headroom (%lld bytes "
+                "%s than now)",
+                amx_name_.c_str(),
+                static_cast<int>(peak),
+                static_cast<int>(total),
+                static_cast<long long>(cells),
+                static_cast<int>(headroom),
+                static_cast<long long>(difference >= 0 ? difference
+                                                       : -difference),
+                difference >= 0 ? "less" : "more");
+}
+
+cell CrashDetect::GetStackWatermark(const char *public_name) const {
+  if (stack_space_.empty()) {
+    return -1;
+  }
+  int index = functions_.GetPublicIndex(public_name);
+  if (index < 0) {
+    return -1;
+  }
+  cell space = stack_space_[index + 1];
+  return space != std::numeric_limits<cell>::max() ? space : -1;
+}
+
+void CrashDetect::SampleHeap() {
+  cell used = amx_.GetHea() - heap_base_;
+  if (used <= 0) {
+    return;
+  }
+  HeapSite &site = heap_sites_[amx_.GetCip()];
+  if (site.last_call != heap_call_) {
+    site.calls++;
+    site.last_call = heap_call_;
+  }
+  if (used > site.peak) {
+    site.peak = used;
+  }
+}
+
+void CrashDetect::GetHeapSites(std::vector<cell> &sites) const {
+  sites.clear();
+  for (ArenaHashMap<cell, HeapSite>::const_iterator it =
+         heap_sites_.begin();
+       it != heap_sites_.end(); it++) {
+    sites.push_back(it->first);
+  }
+  std::sort(sites.begin(), sites.end(), [this](cell a, cell b) {
+    cell peak_a = heap_sites_.find(a)->second.peak;
+    cell peak_b = heap_sites_.find(b)->second.peak;
+    return peak_a != peak_b ? peak_a > peak_b : a < b;
+  });
+}
+
+std::string CrashDetect::GetCodeLocation(cell address) const {
+  if (debug_info_->IsLoaded()) {
+    const char *file_name = debug_info_->GetFileNamePtr(address);
+    int32_t line = debug_info_->GetLineNumber(address);
+    if (file_name != nullptr && line != 0) {
+      return FormatString("%s:%d", file_name, static_cast<int>(line));
+    }
+  }
+  return FormatString("0x%08X", static_cast<unsigned>(address));
+}
+
+void CrashDetect::CheckRedundantNativeCall(cell index, const cell *params) {
+  // FNV-1a over the index and the arguments, cell by cell.
+  uint64_t hash = 14695981039346656037ull;
+  cell num_args = params[0] / static_cast<cell>(sizeof(cell));
+  hash = (hash ^ static_cast<ucell>(index)) * 1099511628211ull;
+  for (cell i = 1; i <= num_args; i++) {
+    hash = (hash ^ static_cast<ucell>(params[i])) * 1099511628211ull;
+  }
+
+  if (native_call_hashes_.size() >= kMaxNativeCallHashes) {
+    native_call_hashes_.clear();
+  }
+  RedundantNativeSite &site = redundant_native_sites_[amx_.GetCip()];
+  site.index = index;
+  site.calls++;
+  std::pair<std::unordered_map<uint64_t, uint32_t>::iterator, bool> result =
+    native_call_hashes_.emplace(hash, redundant_natives_call_);
+  if (!result.second) {
+    if (result.first->second == redundant_natives_call_) {
+      site.repeats++;
+    } else {
+      result.first->second = redundant_natives_call_;
+    }
+  }
+}
+
+void CrashDetect::AddNativeSiteTime(cell index, cell cip, int64_t time) {
+  NativeSite &site = native_sites_[cip];
+  site.index = index;
+  site.calls++;
+  site.time += time;
+}
+
+bool CrashDetect::PrintNativeSiteStats() {
+  if (native_site_stats_ == 0) {
+    return false;
+  }
+
+  std::vector<cell> sites;
+  for (ArenaHashMap<cell, NativeSite>::const_iterator it =
+         native_sites_.begin();
+       it != native_sites_.end(); it++) {
+    sites.push_back(it->first);
+  }
+  std::size_t num_shown = std::min(sites.size(), kTraceCountsTopN);
+  std::partial_sort(sites.begin(),
+                    sites.begin() + num_shown,
+                    sites.end(),
+                    [this](cell a, cell b) {
+                      return native_sites_[a].time > native_sites_[b].time;
+                    });
+
+  // The figures are scaled up to make up for the calls that weren't timed.
+  LogDebugPrint("Native call sites in %s (ms, estimated from 1 in %u calls):",
+                amx_name_.c_str(),
+                native_site_stats_);
+  for (std::size_t i = 0; i < num_shown; i++) {
+    const NativeSite &site = native_sites_[sites[i]];
+    const char *name = amx_.GetNativeName(site.index);
+    LogDebugPrint("%10llu calls %12.3f total %s at %s",
+                  static_cast<unsigned long long>(site.calls)
+                    * native_site_stats_,
+                  static_cast<double>(site.time) * native_site_stats_ / 1000.0,
+                  name != nullptr ? name : "<unknown>",
+                  GetCodeLocation(sites[i]).c_str());
+  }
+  return true;
+}
+
+void CrashDetect::AddDispatch(cell index,
+                              const Dispatch &dispatch,
+                              int64_t time) {
+  const char *name = dispatch.public_name;
+  DispatchStats &stats = dispatches_[name != nullptr ? name : ""];
+  if (stats.dispatches == 0) {
+    stats.native_index = index;
+  }
+  stats.dispatches++;
+  stats.num_calls += dispatch.num_calls;
+  stats.max_calls = std::max(stats.max_calls, dispatch.num_calls);
+  stats.time += time;
+  stats.call_time += dispatch.call_time;
+}
+
+bool CrashDetect::PrintDispatchStats() {
+  if (!dispatch_stats_) {
+    return false;
+  }
+
+  typedef std::unordered_map<std::string, DispatchStats>::const_iterator
+    DispatchIterator;
+  std::vector<DispatchIterator> dispatches;
+  for (DispatchIterator it = dispatches_.begin();
+       it != dispatches_.end(); it++) {
+    dispatches.push_back(it);
+  }
+  std::size_t num_shown = std::min(dispatches.size(), kTraceCountsTopN);
+  std::partial_sort(dispatches.begin(),
+                    dispatches.begin() + num_shown,
+                    dispatches.end(),
+                    [](DispatchIterator a, DispatchIterator b) {
+                      return a->second.time - a->second.call_time
+                           > b->second.time - b->second.call_time;
+                    });
+  if (num_shown > 0) {
+    LogDebugPrint("Public dispatches from %s (ms):", amx_name_.c_str());
+    for (std::size_t i = 0; i < num_shown; i++) {
+      const DispatchStats &stats = dispatches[i]->second;
+      const char *native_name = amx_.GetNativeName(stats.native_index);
+      LogDebugPrint("%10u calls %6.2f avg %4u max scripts %12.3f total "
+                    "%12.3f overhead %s via %s",
+                    stats.dispatches,
+                    static_cast<double>(stats.num_calls) / stats.dispatches,
+                    stats.max_calls,
+                    stats.time / 1000.0,
+                    (stats.time - stats.call_time) / 1000.0,
+                    dispatches[i]->first.c_str(),
+                    native_name != nullptr ? native_name : "<unknown>");
+    }
+  }
+
+  std::vector<int> publics;
+  for (std::size_t i = 0; i < nested_calls_.size(); i++) {
+    if (nested_calls_[i].native_calls != 0
+        || nested_calls_[i].public_calls != 0) {
+      publics.push_back(static_cast<int>(i));
+    }
+  }
+  num_shown = std::min(publics.size(), kTraceCountsTopN);
+  std::partial_sort(publics.begin(),
+                    publics.begin() + num_shown,
+                    publics.end(),
+                    [this](int a, int b) {
+                      return nested_calls_[a].native_time
+                               + nested_calls_[a].public_time
+                           > nested_calls_[b].native_time
+                               + nested_calls_[b].public_time;
+                    });
+  if (num_shown > 0) {
+    LogDebugPrint("Nested public calls in %s (ms):", amx_name_.c_str());
+    for (std::size_t i = 0; i < num_shown; i++) {
+      const NestedCalls &calls = nested_calls_[publics[i]];
+      const char *name = amx_.GetPublicName(publics[i]);
+      LogDebugPrint("%10u from natives %12.3f %10u from publics %12.3f %s",
+                    calls.native_calls,
+                    calls.native_time / 1000.0,
+                    calls.public_calls,
+                    calls.public_time / 1000.0,
+                    name != nullptr ? name : "<unknown>");
+    }
+  }
+  return true;
+}
+
+bool CrashDetect::PrintFileStats() {
+  if (!file_stats_ || !debug_info_->IsLoaded()) {
+    return false;
+  }
+
+  struct FileStats {
+    FileStats(): samples(0), calls(0), time(0), native_calls(0),
+                 native_time(0) {}
+    uint64_t samples;
+    uint64_t calls;
+    int64_t time;
+    uint64_t native_calls;
+    int64_t native_time;
+  };
+  std::unordered_map<std::string, FileStats> files;
+  // GetFile() does a binary search, so it's cheap enough to look up every
+  // function and call site here rather than keep counts by file.
+  auto get_file_stats = [&](cell address) -> FileStats & {
+    const char *name = debug_info_->GetFileNamePtr(address);
+    return files[name[0] != '\0' ? name : "<unknown>"];
+  };
+  for (ArenaHashMap<cell, uint64_t>::const_iterator it =
+         file_stats_samples_.begin();
+       it != file_stats_samples_.end(); it++) {
+    get_file_stats(it->first).samples += it->second;
+  }
+  for (ArenaHashMap<cell, CallGraphNode>::const_iterator it =
+         callgraph_nodes_.begin();
+       it != callgraph_nodes_.end(); it++) {
+    // Natives are keyed by -1 - index.
+    if (it->first >= 0) {
+      FileStats &stats = get_file_stats(it->first);
+      stats.calls += it->second.calls;
+      stats.time += it->second.exclusive;
+    }
+  }
+  for (ArenaHashMap<cell, NativeSite>::const_iterator it =
+         native_sites_.begin();
+       it != native_sites_.end(); it++) {
+    FileStats &stats = get_file_stats(it->first);
+    stats.native_calls +=
+      static_cast<uint64_t>(it->second.calls) * native_site_stats_;
+    stats.native_time += it->second.time * native_site_stats_;
+  }
+
+  typedef std::pair<std::string, FileStats> FileEntry;
+  std::vector<FileEntry> sorted_files(files.begin(), files.end());
+  std::size_t num_shown = std::min(sorted_files.size(), kTraceCountsTopN);
+  std::partial_sort(sorted_files.begin(),
+                    sorted_files.begin() + num_shown,
+                    sorted_files.end(),
+                    [](const FileEntry &a, const FileEntry &b) {
+                      if (a.second.samples != b.second.samples) {
+                        return a.second.samples > b.second.samples;
+                      }
+                      return a.second.time + a.second.native_time
+                           > b.second.time + b.second.native_time;
+                    });
+
+  LogDebugPrint("Costs in %s by source file (ms):", amx_name_.c_str());
+  for (std::size_t i = 0; i < num_shown; i++) {
+    const FileStats &stats = sorted_files[i].second;
+    LogDebugPrint("%10llu samples %10llu calls %12.3f self "
+                  "%10llu native calls %12.3f native %s",
+                  static_cast<unsigned long long>(stats.samples),
+                  static_cast<unsigned long long>(stats.calls),
+                  stats.time / 1000.0,
+                  static_cast<unsigned long long>(stats.native_calls),
+                  stats.native_time / 1000.0,
+                  sorted_files[i].first.c_str());
+  }
+  return true;
+}
+
+bool CrashDetect::PrintRedundantNatives() {
+  if (redundant_natives_ == 0) {
+    return false;
+  }
+
+  std::vector<cell> sites;
+  for (ArenaHashMap<cell, RedundantNativeSite>::const_iterator it =
+         redundant_native_sites_.begin();
+       it != redundant_native_sites_.end(); it++) {
+    if (it->second.repeats != 0) {
+      sites.push_back(it->first);
+    }
+  }
+  std::size_t num_shown = std::min(sites.size(), kTraceCountsTopN);
+  std::partial_sort(sites.begin(),
+                    sites.begin() + num_shown,
+                    sites.end(),
+                    [this](cell a, cell b) {
+                      return redundant_native_sites_[a].repeats
+                           > redundant_native_sites_[b].repeats;
+                    });
+
+  LogDebugPrint("Repeated native calls in %s:", amx_name_.c_str());
+  for (std::size_t i = 0; i < num_shown; i++) {
+    const RedundantNativeSite &site = redundant_native_sites_[sites[i]];
+    const char *name = amx_.GetNativeName(site.index);
+    LogDebugPrint("%10u of %10u calls %s at %s",
+                  site.repeats,
+                  site.calls,
+                  name != nullptr ? name : "<unknown>",
+                  GetCodeLocation(sites[i]).c_str());
+  }
+  return true;
+}
+
+bool CrashDetect::PrintHeapProfile() {
+  if (!heap_profile_) {
+    return false;
+  }
+
+  std::vector<cell> sites;
+  GetHeapSites(sites);
+
+  // The same as #pragma dynamic, which sets the size of the heap and the
+  // stack together.
+  cell total = amx_.GetStp() - amx_.GetHlw();
+  LogDebugPrint("Heap usage in %s (%d bytes for stack and heap):",
+                amx_name_.c_str(),
+                static_cast<int>(total));
+  std::size_t num_shown = std::min(sites.size(), kTraceCountsTopN);
+  for (std::size_t i = 0; i < num_shown; i++) {
+    const HeapSite &site = heap_sites_.find(sites[i])->second;
+    std::string function_name;
+    if (debug_info_->IsLoaded()) {
+      if (AMXDebugInfo::Symbol function =
+            debug_info_->GetFunction(sites[i])) {
+        function_name = function.GetName();
+      }
+    }
+    LogDebugPrint("%10d bytes peak %10u calls %s %s",
+                  static_cast<int>(site.peak),
+                  static_cast<unsigned>(site.calls),
+                  GetCodeLocation(sites[i]).c_str(),
+                  function_name.c_str());
+  }
+  return true;
+}
+
+cell CrashDetect::GetHeapConsumer(int index, std::string &location) const {
+  if (!heap_profile_ || index < 0) {
+    return -1;
+  }
+  std::vector<cell> sites;
+  GetHeapSites(sites);
+  if (static_cast<std::size_t>(index) >= sites.size()) {
+    return -1;
+  }
+  location = GetCodeLocation(sites[index]);
+  return heap_sites_.find(sites[index])->second.peak;
+}
+
+void CrashDetect::UpdateCoverage() {
+  ucell cip = static_cast<ucell>(amx_.GetCip()) / sizeof(cell);
+  if (cip / 32 >= coverage_cips_.size()) {
+    return;
+  }
+  uint32_t &cips = coverage_cips_[cip / 32];
+  uint32_t cip_bit = 1u << (cip % 32);
+  if ((cips & cip_bit) != 0 || !debug_info_->IsLoaded()) {
+    return;
+  }
+  cips |= cip_bit;
+  if (coverage_lines_.empty()) {
+    coverage_lines_.assign((debug_info_->GetNumLines() + 31) / 32, 0);
+  }
+  int line = debug_info_->GetLineIndex(amx_.GetCip());
+  if (line >= 0) {
+    coverage_lines_[line / 32] |= 1u << (line % 32);
+  }
+}
+
+bool CrashDetect::WriteCoverage() {
+  if (!coverage_) {
+    return false;
+  }
+
+  // Several line table entries may be for the same line, e.g. loops and
+  // multi-line statements. The line counts as covered if any of them is.
+  std::map<std::string, std::map<int32_t, bool>> files;
+  if (debug_info_->IsLoaded()) {
+    for (int i = 0; i < debug_info_->GetNumLines(); i++) {
+      AMXDebugInfo::Line line = debug_info_->GetLineByIndex(i);
+      bool covered = static_cast<std::size_t>(i / 32) < coverage_lines_.size()
+        && (coverage_lines_[i / 32] & (1u << (i % 32))) != 0;
+      bool &file_line =
+        files[debug_info_->GetFileNamePtr(line.GetAddress())]
+             [line.GetNumber() + 1];
+      file_line = file_line || covered;
+    }
+  }
+
+  bool json = Options::shared().coverage_format() == COVERAGE_FORMAT_JSON;
+  std::string filename =
+    "coverage." + amx_name_ + (json ? ".json" : ".info");
+  std::ofstream file(filename.c_str(), std::ios::out | std::ios::trunc);
+  if (!file) {
+    LogDebugPrint("Could not open coverage file '%s'", filename.c_str());
+    return false;
+  }
+
+  unsigned int num_lines = 0;
+  unsigned int num_covered = 0;
+  JSONWriter writer;
+  if (json) {
+    writer.BeginObject();
+    writer.Field("script", amx_name_);
+    writer.Key("files");
+    writer.BeginArray();
+  } else {
+    file << "TN:" << amx_name_ << "\n";
+  }
+  for (std::map<std::string, std::map<int32_t, bool>>::const_iterator it =
+         files.begin();
+       it != files.end(); it++) {
+    const std::map<int32_t, bool> &lines = it->second;
+    unsigned int file_covered = 0;
+    for (std::map<int32_t, bool>::const_iterator line_it = lines.begin();
+         line_it != lines.end(); line_it++) {
+      file_covered += line_it->second ? 1 : 0;
+    }
+    if (json) {
+      writer.BeginObject();
+      writer.Field("name", it->first);
+      writer.Field("lines", static_cast<unsigned int>(lines.size()));
+      writer.Field("covered", file_covered);
+      for (int pass = 0; pass < 2; pass++) {
+        writer.Key(pass == 0 ? "hit" : "missed");
+        writer.BeginArray();
+        for (std::map<int32_t, bool>::const_iterator line_it = lines.begin();
+             line_it != lines.end(); line_it++) {
+          if (line_it->second == (pass == 0)) {
+            writer.Int(line_it->first);
+          }
+        }
+        writer.EndArray();
+      }
+      writer.EndObject();
+    } else {
+      file << "SF:" << it->first << "\n";
+      for (std::map<int32_t, bool>::const_iterator line_it = lines.begin();
+           line_it != lines.end(); line_it++) {
+        file << "DA:" << line_it->first << ","
+             << (line_it->second ? 1 : 0) << "\n";
+      }
+      file << "LF:" << lines.size() << "\n"
+           << "LH:" << file_covered << "\n"
+           << "end_of_record\n";
+    }
+    num_lines += static_cast<unsigned int>(lines.size());
+    num_covered += file_covered;
+  }
+  if (json) {
+    writer.EndArray();
+    writer.EndObject();
+    file << writer.str() << "\n";
+  }
+
+  LogDebugPrint("Coverage of %s: %u of %u lines (written to %s)",
+                amx_name_.c_str(),
+                num_covered,
+                num_lines,
+                filename.c_str());
+  return file.good();
+}
+
+void CrashDetect::CountLine() {
+  if (!debug_info_->IsLoaded()) {
+    return;
+  }
+  if (line_counts_.empty()) {
+    line_counts_.assign(debug_info_->GetNumLines(), 0);
+  }
+  int line = debug_info_->GetLineIndex(amx_.GetCip());
+  if (line >= 0 && line_counts_[line] != UINT32_MAX) {
+    line_counts_[line]++;
+  }
+}
+
+namespace {
+
+struct LineProfileEntry {
+  int32_t line;
+  uint32_t count;
+  cell address;
+};
+
+struct LineProfileFile {
+  std::string name;
+  uint64_t total;
+  std::vector<LineProfileEntry> lines;
+};
+
+bool CompareLineProfileEntries(const LineProfileEntry &a,
+                               const LineProfileEntry &b) {
+  return a.count != b.count ? a.count > b.count : a.line < b.line;
+}
+
+} // anonymous namespace
+
+bool CrashDetect::WriteLineProfile() {
+  if (!line_profile_) {
+    return false;
+  }
+
+  // Several line table entries may be for the same line (e.g. the
+  // condition of a for loop), their counts are added up.
+  std::map<std::string, std::map<int32_t, LineProfileEntry>> lines;
+  if (debug_info_->IsLoaded()) {
+    for (std::size_t i = 0; i < line_counts_.size(); i++) {
+      if (line_counts_[i] == 0) {
+        continue;
+      }
+      AMXDebugInfo::Line line =
+        debug_info_->GetLineByIndex(static_cast<int>(i));
+      int32_t number = line.GetNumber() + 1;
+      LineProfileEntry &entry =
+        lines[debug_info_->GetFileNamePtr(line.GetAddress())][number];
+      if (entry.count == 0) {
+        entry.line = number;
+        entry.address = line.GetAddress();
+      }
+      entry.count = static_cast<uint32_t>(std::min<uint64_t>(
+        static_cast<uint64_t>(entry.count) + line_counts_[i], UINT32_MAX));
+    }
+  }
+
+  std::vector<LineProfileFile> files;
+  std::vector<std::pair<const LineProfileFile*, LineProfileEntry>> top_lines;
+  for (std::map<std::string, std::map<int32_t, LineProfileEntry>>::
+         const_iterator it = lines.begin();
+       it != lines.end(); it++) {
+    LineProfileFile file;
+    file.name = it->first;
+    file.total = 0;
+    for (std::map<int32_t, LineProfileEntry>::const_iterator line_it =
+           it->second.begin();
+         line_it != it->second.end(); line_it++) {
+      file.lines.push_back(line_it->second);
+      file.total += line_it->second.count;
+    }
+    std::sort(file.lines.begin(), file.lines.end(),
+              CompareLineProfileEntries);
+    files.push_back(file);
   }
+  std::sort(files.begin(), files.end(),
+            [](const LineProfileFile &a, const LineProfileFile &b) {
+              return a.total != b.total ? a.total > b.total : a.name < b.name;
+            });
 
-  // Block errors while calling OnRuntimeError as it may result in yet
-  // another error (and for certain errors it in fact always does, e.g.
-  // stack/heap collision due to insufficient stack space for making
-  // the public call).
-  block_exec_errors_ = true;
+  std::string filename = "lineprofile." + amx_name_ + ".txt";
+  std::ofstream file(filename.c_str(), std::ios::out | std::ios::trunc);
+  if (!file) {
+    LogDebugPrint("Could not open line profile file '%s'", filename.c_str());
+    return false;
+  }
 
-  // Capture backtrace before continuing as OnRuntimError will modify the
-  // state of the AMX thus we'll end up with a different stack and possibly
-  // other things too. This also should protect from cases where something
-  // hooks logprintf (like fixes2).
-  std::stringstream bt_stream;
-  PrintAMXBacktrace(bt_stream);
+  // Files with the most executed lines first, and within each file the
+  // lines that ran the most times.
+  file << "# Line profile of " << amx_name_ << "\n";
+  for (std::size_t i = 0; i < files.size(); i++) {
+    file << "\n" << files[i].name << " (" << files[i].total
+         << " lines executed)\n";
+    for (std::size_t j = 0; j < files[i].lines.size(); j++) {
+      const LineProfileEntry &entry = files[i].lines[j];
+      file << std::setw(12) << entry.count << "  "
+           << std::setw(6) << entry.line << "  "
+           << debug_info_->GetFunctionNamePtr(entry.address) << "\n";
+      top_lines.push_back(std::make_pair(&files[i], entry));
+    }
+  }
 
-  // Remember values of AMX registers before calling OnRuntimeError().
-  AMX amx_state = *amx_.amx();
+  std::size_t num_shown = std::min(top_lines.size(), kTraceCountsTopN);
+  std::partial_sort(
+    top_lines.begin(),
+    top_lines.begin() + num_shown,
+    top_lines.end(),
+    [](const std::pair<const LineProfileFile*, LineProfileEntry> &a,
+       const std::pair<const LineProfileFile*, LineProfileEntry> &b) {
+      return CompareLineProfileEntries(a.second, b.second);
+    });
+  LogDebugPrint("Most executed lines in %s (see %s):",
+                amx_name_.c_str(),
+                filename.c_str());
+  for (std::size_t i = 0; i < num_shown; i++) {
+    const LineProfileEntry &entry = top_lines[i].second;
+    LogDebugPrint("%12u %s:%d %s",
+                  static_cast<unsigned>(entry.count),
+                  top_lines[i].first->name.c_str(),
+                  static_cast<int>(entry.line),
+                  debug_info_->GetFunctionNamePtr(entry.address));
+  }
+  return file.good();
+}
 
-  // public OnRuntimeError(code, &bool:suppress);
-  cell callback_index = amx_.GetPublicIndex("OnRuntimeError");
-  cell suppress = 0;
+cell CrashDetect::GetErrorCount(int code) const {
+  if (code < 0) {
+    uint32_t total = 0;
+    for (ArenaHashMap<int, uint32_t>::const_iterator it =
+           error_counts_.begin();
+         it != error_counts_.end(); it++) {
+      total += it->second;
+    }
+    return static_cast<cell>(total);
+  }
+  ArenaHashMap<int, uint32_t>::const_iterator it =
+    error_counts_.find(code);
+  return it != error_counts_.end() ? static_cast<cell>(it->second) : 0;
+}
 
-  if (callback_index >= 0) {
-    if (amx_.CheckStack()) {
-      cell suppress_addr, *suppress_ptr;
-      amx_PushArray(amx_, &suppress_addr, &suppress_ptr, &suppress, 1);
-      amx_Push(amx_, error);
-      OnExec(retval, callback_index);
-      amx_Release(amx_, suppress_addr);
-      suppress = *suppress_ptr;
+cell CrashDetect::GetErrorFunction(int index, std::string &function) const {
+  if (index < 0
+      || static_cast<std::size_t>(index) >= error_functions_.size()) {
+    return -1;
+  }
+  std::vector<std::pair<cell, uint32_t>> functions(error_functions_.begin(),
+                                                   error_functions_.end());
+  std::nth_element(functions.begin(),
+                   functions.begin() + index,
+                   functions.end(),
+                   [](const std::pair<cell, uint32_t> &a,
+                      const std::pair<cell, uint32_t> &b) {
+    return a.second != b.second ? a.second > b.second : a.first < b.first;
+  });
+  const std::pair<cell, uint32_t> &entry = functions[index];
+  std::stringstream name;
+  AMXStackFramePrinter(name, *debug_info_)
+    .PrintCallerName(AMXStackFrame(amx_, 0, 0, 0, entry.first));
+  function = name.str();
+  return static_cast<cell>(entry.second);
+}
+
+// static
+void CrashDetect::WriteTraceRecord(const TraceRecord &record) {
+  CrashDetect *handler = GetHandler(record.amx);
+  if (handler != nullptr) {
+    TraceWriter::shared().Write(record,
+                                handler->trace_script_id_,
+                                handler->amx_path_);
+  }
+}
+
+// static
+void CrashDetect::WriteChromeTraceRecord(const TraceRecord &record) {
+  CrashDetect *handler = GetHandler(record.amx);
+  if (handler == nullptr) {
+    return;
+  }
+  std::string name;
+  switch (record.kind) {
+    case TraceRecord::NATIVE: {
+      const char *native_name = handler->amx_.GetNativeName(record.index);
+      name = native_name != nullptr ? native_name : "<unknown>";
+      break;
+    }
+    case TraceRecord::PUBLIC:
+    case TraceRecord::PUBLIC_RETURN: {
+      const char *public_name = record.index == AMX_EXEC_MAIN
+        ? "main"
+        : handler->amx_.GetPublicName(record.index);
+      name = public_name != nullptr ? public_name : "<unknown>";
+      break;
+    }
+    case TraceRecord::FUNCTION: {
+      AMXDebugInfo::Symbol function =
+        handler->debug_info_->GetFunction(record.caller_address);
+      name = function
+        ? function.GetName()
+        : FormatString("0x%08X",
+                       static_cast<unsigned>(record.caller_address));
+      break;
     }
   }
+  ChromeTraceWriter::shared().Write(record,
+                                    handler->trace_script_id_,
+                                    handler->amx_name_,
+                                    name);
+}
 
-  if (suppress == 0) {
-    PrintRuntimeError(amx_, amx_state, error);
-    if (error != AMX_ERR_NOTFOUND
-        && error != AMX_ERR_INDEX
-        && error != AMX_ERR_CALLBACK
-        && error != AMX_ERR_INIT) {
-      PrintStream(LogDebugPrint, bt_stream);
+// Identifies a runtime error by what it is and where it happened - the
+// current instruction and the chain of return addresses (natives and
+// publics are represented by their indexes). This doesn't need any debug
+// info so it's cheap to compute.
+uint64_t CrashDetect::GetErrorFingerprint(int error) const {
+  uint64_t fingerprint = kFingerprintBasis;
+  AddToFingerprint(fingerprint, error);
+
+  cell cip = amx_.GetCip();
+  cell frm = amx_.GetFrm();
+  AddToFingerprint(fingerprint, cip);
+
+  const AMXCallStack &call_stack = GetCallStack();
+  for (AMXCallStack::const_iterator it = call_stack.begin();
+       it != call_stack.end() && cip != 0 && it->amx() == amx_;
+       ++it) {
+    const AMXCall &call = *it;
+    if (call.IsNative()) {
+      AddToFingerprint(fingerprint, -1);
+      AddToFingerprint(fingerprint, call.index());
+    } else if (call.IsPublic()) {
+      AMXStackTrace trace = GetAMXStackTrace(
+        amx_, frm, cip, Options::shared().backtrace_depth());
+      while (trace.current_frame().return_address() != 0) {
+        AddToFingerprint(fingerprint, trace.current_frame().return_address());
+        if (!trace.MoveNext()) {
+          break;
+        }
+      }
+      AddToFingerprint(fingerprint, call.index());
+      frm = call.frm();
+      cip = call.cip();
     }
   }
+  return fingerprint;
+}
 
-  block_exec_errors_ = false;
-  return AMX_ERR_NONE;
+// Returns true if the error has already been printed in full and not
+// too long ago (i.e. it has repeated since then).
+bool CrashDetect::IsRepeatedError(uint64_t fingerprint) {
+  std::unordered_map<uint64_t, RepeatedError>::iterator it =
+    repeated_errors_.find(fingerprint);
+  if (it == repeated_errors_.end()) {
+    return false;
+  }
+  RepeatedError &repeated_error = it->second;
+  if (repeated_error.count == 0
+      && std::chrono::steady_clock::now() - repeated_error.since
+         >= std::chrono::seconds(Options::shared().error_repeat_time())) {
+    // It hasn't happened again: print it in full again next time.
+    repeated_errors_.erase(it);
+    return false;
+  }
+  return true;
 }
 
-int CrashDetect::OnLongCallRequest(int option, int value) {
-  if (long_call_time_ != 0) {
-    switch (option) {
-      case AMX_LCT_OPTION:
-        return LongCallOption(value);
-      case AMX_LCT_SET_TIME:
-        SetLongCallTime(static_cast<unsigned int>(value));
-        break;
-      case AMX_LCT_CHECK:
-        CheckLongCallTime();
-        break;
-    }
+void CrashDetect::AddRepeatedError(uint64_t fingerprint,
+                                   int error,
+                                   const std::string &location) {
+  if (repeated_errors_.size() >= kMaxRepeatedErrors) {
+    repeated_errors_.clear();
   }
-  return AMX_ERR_NONE;
+
+  RepeatedError &repeated_error = repeated_errors_[fingerprint];
+  repeated_error.error = error;
+  repeated_error.count = 0;
+  repeated_error.since = std::chrono::steady_clock::now();
+  repeated_error.location = location;
 }
 
-int CrashDetect::OnAddressNaughtRequest(int option) {
-  switch (option) {
-    case -1:
-      return address_naught_;
-    case 0:
-      address_naught_ = false;
-      break;
-    case 1:
-      address_naught_ = true;
-      break;
+// Returns the frame of the function where the current error happened.
+AMXStackFrame CrashDetect::GetErrorFrame() {
+  AMXStackTrace trace = GetAMXStackTrace(amx_,
+                                         amx_.GetFrm(),
+                                         amx_.GetCip(),
+                                         1);
+  AMXStackFrame frame = trace.current_frame();
+  const AMXCallStack &call_stack = GetCallStack();
+  if (frame.return_address() == 0
+      && !call_stack.IsEmpty()
+      && call_stack.Top().IsPublic()) {
+    // Not inside of any function called from the public.
+    frame.set_caller_address(
+      amx_.GetPublicAddress(call_stack.Top().index()));
   }
-  return AMX_ERR_NONE;
+  return frame;
 }
 
-// static
-void CrashDetect::OnCrash(const os::Context &context) {
-  CrashDetect *instance = nullptr;
-  if (!call_stack_.IsEmpty()) {
-    instance = GetHandler(call_stack_.Top().amx());
+// Returns the name of the function where the current error happened and
+// (if there's debug info) its source location.
+std::string CrashDetect::GetErrorLocation() {
+  AMXStackFrame frame = GetErrorFrame();
+  std::stringstream location;
+  AMXStackFramePrinter printer(location, *debug_info_, &frame_cache_);
+  printer.PrintCallerName(frame);
+  if (debug_info_->IsLoaded()) {
+    location << " at ";
+    printer.PrintSourceLocation(amx_.GetCip());
   }
-  if (instance != nullptr) {
-    LogDebugPrint("Server crashed while executing %s",\
-                  instance->amx_name_.c_str());
+  return location.str();
+}
+
+void CrashDetect::PrintRepeatedError(const RepeatedError &repeated_error) {
+  LogChannelScope log_channel(LOG_CHANNEL_ERROR);
+  long seconds = static_cast<long>(
+    std::chrono::duration_cast<std::chrono::seconds>(
+      std::chrono::steady_clock::now() - repeated_error.since).count());
+  if (IsJSONLog()) {
+    JSONWriter json;
+    BeginJSONEvent(json, "runtime_error_repeated");
+    json.Field("script", amx_name_);
+    json.Field("code", repeated_error.error);
+    json.Field("message", aux_StrError(repeated_error.error));
+    json.Field("location", repeated_error.location);
+    json.Field("count", repeated_error.count);
+    json.Field("seconds", seconds);
+    json.EndObject();
+    LogPrintJSON(json.str());
   } else {
-    LogDebugPrint("Server crashed due to an unknown error");
+    LogDebugPrint("Run time error %d: \"%s\" in %s (%s) repeated %u times "
+                  "in the last %ld seconds",
+                  repeated_error.error,
+                  aux_StrError(repeated_error.error),
+                  repeated_error.location.c_str(),
+                  amx_name_.c_str(),
+                  repeated_error.count,
+                  seconds);
   }
-  PrintAMXBacktrace();
-  PrintNativeBacktrace(context.native_context());
-  PrintRegisters(context);
-  PrintStack(context);
-  PrintLoadedModules();
 }
 
-// static
-void CrashDetect::OnInterrupt(const os::Context &context) {
-  CrashDetect *instance = nullptr;
-  if (!call_stack_.IsEmpty()) {
-    instance = GetHandler(call_stack_.Top().amx());
+// Counts the current error against its error_throttle budget and returns
+// true if it's over the budget. The site is the error code and the CIP
+// (this is per script already), nothing more expensive.
+bool CrashDetect::IsThrottledError(int error) {
+  cell cip = amx_.GetCip();
+  uint64_t key = (static_cast<uint64_t>(static_cast<uint32_t>(error)) << 32)
+                 | static_cast<uint32_t>(cip);
+  if (throttled_errors_.size() >= kMaxThrottledErrors
+      && throttled_errors_.find(key) == throttled_errors_.end()) {
+    throttled_errors_.clear();
   }
-  if (instance != nullptr) {
-    LogDebugPrint("Server received interrupt signal while executing %s",
-                  instance->amx_name_.c_str());
-  } else {
-    LogDebugPrint("Server received interrupt signal");
+
+  ThrottledError &throttled_error = throttled_errors_[key];
+  std::chrono::steady_clock::time_point now =
+    std::chrono::steady_clock::now();
+  if (now - throttled_error.since
+      >= std::chrono::seconds(Options::shared().error_throttle_time())) {
+    if (throttled_error.dropped > 0) {
+      PrintThrottledError(throttled_error);
+    }
+    throttled_error.error = error;
+    throttled_error.cip = cip;
+    throttled_error.count = 0;
+    throttled_error.dropped = 0;
+    throttled_error.since = now;
   }
-  PrintAMXBacktrace();
-  PrintNativeBacktrace(context.native_context());
+  if (throttled_error.count < Options::shared().error_throttle_count()) {
+    throttled_error.count++;
+    return false;
+  }
+  throttled_error.dropped++;
+  return true;
 }
 
-// static
-void CrashDetect::PrintTraceFrame(const AMXStackFrame &frame,
-                                  const AMXDebugInfo &debug_info) {
-  std::stringstream stream;
-  AMXStackFramePrinter printer(stream, debug_info);
-  printer.PrintCallerNameAndArguments(frame);
-  if (Options::shared().trace_filter() == nullptr
-      || Options::shared().trace_filter()->Test(stream.str())) {
-    PrintStream(LogTracePrint, stream);
+void CrashDetect::PrintThrottledError(const ThrottledError &throttled_error) {
+  LogChannelScope log_channel(LOG_CHANNEL_ERROR);
+  long seconds = static_cast<long>(
+    std::chrono::duration_cast<std::chrono::seconds>(
+      std::chrono::steady_clock::now() - throttled_error.since).count());
+  const char *function_name = "";
+  if (debug_info_->IsLoaded()) {
+    AMXDebugInfo::Symbol function =
+      debug_info_->GetFunction(throttled_error.cip);
+    if (function) {
+      function_name = function.GetNamePtr();
+    }
+  }
+  if (IsJSONLog()) {
+    JSONWriter json;
+    BeginJSONEvent(json, "runtime_error_throttled");
+    json.Field("script", amx_name_);
+    json.Field("code", throttled_error.error);
+    json.Field("message", aux_StrError(throttled_error.error));
+    json.Field("cip", static_cast<long>(throttled_error.cip));
+    if (*function_name != '\0') {
+      json.Field("function", function_name);
+    }
+    json.Field("count", throttled_error.dropped);
+    json.Field("seconds", seconds);
+    json.EndObject();
+    LogPrintJSON(json.str());
+  } else {
+    LogDebugPrint("Run time error %d: \"%s\" at %08x%s%s (%s) throttled, "
+                  "%u more in the last %ld seconds",
+                  throttled_error.error,
+                  aux_StrError(throttled_error.error),
+                  static_cast<unsigned>(throttled_error.cip),
+                  *function_name != '\0' ? " in " : "",
+                  function_name,
+                  amx_name_.c_str(),
+                  throttled_error.dropped,
+                  seconds);
   }
 }
 
 // static
-void CrashDetect::PrintRuntimeError(AMXRef amx,
-                                    const AMX &amx_state,
-                                    int error) {
-  LogDebugPrint("Run time error %d: \"%s\"", error, aux_StrError(error));
+std::vector<std::string> CrashDetect::GetRuntimeErrorDetails(
+    AMXRef amx,
+    const AMX &amx_state,
+    int error) {
+  std::vector<std::string> details;
   cell *ip = reinterpret_cast<cell*>(amx.GetCode() + amx_state.cip);
   switch (error) {
     case AMX_ERR_BOUNDS: {
-      cell opcode = *ip;
-      if (opcode == RelocateAMXOpcode(AMX_OP_BOUNDS)) {
+      int opcode = UnrelocateAMXOpcode(*ip, amx_state.flags);
+      if (opcode == AMX_OP_BOUNDS) {
         cell upper_bound = *(ip + 1);
         cell index = amx_state.pri;
         if (index < 0) {
-          LogDebugPrint(" Attempted to read/write array element at negative "
-                        "index %d", index);
+          details.push_back(FormatString(
+            "Attempted to read/write array element at negative index %d",
+            index));
         } else {
-          LogDebugPrint(" Attempted to read/write array element at index %d "
-                        "in array of size %d", index, upper_bound + 1);
+          details.push_back(FormatString(
+            "Attempted to read/write array element at index %d "
+            "in array of size %d", index, upper_bound + 1));
         }
       }
       break;
@@ -376,120 +4399,590 @@ void CrashDetect::PrintRuntimeError(AMXRef amx,
       int num_natives = amx.GetNumNatives();
       for (int i = 0; i < num_natives; ++i) {
         if (natives[i].address == 0) {
-          LogDebugPrint(" %s", amx.GetString(natives[i].nameofs));
+          details.push_back(amx.GetString(natives[i].nameofs));
         }
       }
       break;
     }
     case AMX_ERR_STACKERR:
-      LogDebugPrint(" Stack pointer (STK) is 0x%X, heap pointer (HEA) is 0x%X",
-                    amx_state.stk, amx_state.hea);
+      details.push_back(FormatString(
+        "Stack pointer (STK) is 0x%X, heap pointer (HEA) is 0x%X",
+        amx_state.stk, amx_state.hea));
       break;
     case AMX_ERR_STACKLOW:
-      LogDebugPrint(" Stack pointer (STK) is 0x%X, stack top (STP) is 0x%X",
-                    amx_state.stk, amx_state.stp);
+      details.push_back(FormatString(
+        "Stack pointer (STK) is 0x%X, stack top (STP) is 0x%X",
+        amx_state.stk, amx_state.stp));
       break;
     case AMX_ERR_HEAPLOW:
-      LogDebugPrint(" Heap pointer (HEA) is 0x%X, heap bottom (HLW) is 0x%X",
-                    amx_state.hea, amx_state.hlw);
+      details.push_back(FormatString(
+        "Heap pointer (HEA) is 0x%X, heap bottom (HLW) is 0x%X",
+        amx_state.hea, amx_state.hlw));
       break;
     case AMX_ERR_INVINSTR: {
       cell opcode = *ip;
-      LogDebugPrint(" Unknown opcode 0x%x at address 0x%08X",
-                    opcode, amx_state.cip);
+      details.push_back(FormatString(
+        "Unknown opcode 0x%x at address 0x%08X",
+        opcode, amx_state.cip));
       break;
     }
     case AMX_ERR_NATIVE: {
-      cell opcode = *(ip - 2);
-      if (opcode == RelocateAMXOpcode(AMX_OP_SYSREQ_C)) {
+      int opcode = UnrelocateAMXOpcode(*(ip - 2), amx_state.flags);
+      // SYSREQ.D takes the native's address instead of its index.
+      bool is_sysreq_d = opcode == AMX_OP_SYSREQ_D;
+      if (opcode == AMX_OP_SYSREQ_C || is_sysreq_d) {
         cell index = *(ip - 1);
-        LogDebugPrint(" %s", amx.GetNativeName(index));
+        if (is_sysreq_d) {
+          CrashDetect *handler = GetHandler(amx);
+          index = handler != nullptr
+                  ? handler->functions_.FindNativeIndex(index)
+                  : amx.FindNativeIndex(index);
+        }
+        const char *name = amx.GetNativeName(index);
+        details.push_back(name != nullptr ? name : "<unknown>");
       }
       break;
     }
   }
+  return details;
+}
+
+// static
+void CrashDetect::PrintRuntimeError(AMXRef amx,
+                                    const AMX &amx_state,
+                                    int error) {
+  LogDebugPrint("Run time error %d: \"%s\"", error, aux_StrError(error));
+  std::vector<std::string> details =
+    GetRuntimeErrorDetails(amx, amx_state, error);
+  for (std::size_t i = 0; i < details.size(); i++) {
+    LogDebugPrint(" %s", details[i].c_str());
+  }
+}
+
+std::vector<std::string> CrashDetect::GetDisassembly(cell cip) {
+  unsigned int num_around = Options::shared().disasm_instructions();
+  if (num_around == 0) {
+    return std::vector<std::string>();
+  }
+  if (disassembler_ == nullptr) {
+    disassembler_.reset(new AMXDisassembler(amx_));
+  }
+  return disassembler_->Disassemble(cip, static_cast<int>(num_around));
+}
+
+// static
+void CrashDetect::PrintDisassembly(
+    const std::vector<std::string> &disassembly) {
+  if (disassembly.empty()) {
+    return;
+  }
+  LogDebugPrint("Disassembly:");
+  for (std::size_t i = 0; i < disassembly.size(); i++) {
+    LogDebugPrint(" %s", disassembly[i].c_str());
+  }
+}
+
+// static
+void CrashDetect::WriteDisassembly(
+    JSONWriter &json,
+    const std::vector<std::string> &disassembly) {
+  if (disassembly.empty()) {
+    return;
+  }
+  json.Key("disassembly");
+  json.BeginArray();
+  for (std::size_t i = 0; i < disassembly.size(); i++) {
+    json.String(disassembly[i]);
+  }
+  json.EndArray();
+}
+
+// static
+void CrashDetect::WriteRuntimeError(const std::string &script,
+                                    AMXRef amx,
+                                    const AMX &amx_state,
+                                    int error,
+                                    const std::vector<std::string> &disassembly,
+                                    const std::string *backtrace) {
+  LogPrintJSON(FormatRuntimeError(script,
+                                  amx,
+                                  amx_state,
+                                  error,
+                                  disassembly,
+                                  backtrace,
+                                  0));
+}
+
+// The fingerprint is only included if it's not 0.
+// static
+std::string CrashDetect::FormatRuntimeError(
+    const std::string &script,
+    AMXRef amx,
+    const AMX &amx_state,
+    int error,
+    const std::vector<std::string> &disassembly,
+    const std::string *backtrace,
+    uint64_t fingerprint) {
+  JSONWriter json;
+  BeginJSONEvent(json, "runtime_error");
+  json.Field("script", script);
+  if (fingerprint != 0) {
+    json.Field("fingerprint", FormatString("%016llx",
+      static_cast<unsigned long long>(fingerprint)));
+  }
+  json.Field("code", error);
+  json.Field("message", aux_StrError(error));
+  json.Key("details");
+  json.BeginArray();
+  std::vector<std::string> details =
+    GetRuntimeErrorDetails(amx, amx_state, error);
+  for (std::size_t i = 0; i < details.size(); i++) {
+    json.String(details[i]);
+  }
+  json.EndArray();
+  WriteDisassembly(json, disassembly);
+  if (backtrace != nullptr) {
+    json.Key("backtrace");
+    json.Raw(*backtrace);
+  }
+  json.EndObject();
+  return json.str();
 }
 
 // static
 void CrashDetect::PrintAMXBacktrace() {
+  if (IsJSONLog()) {
+    JSONWriter json;
+    BeginJSONEvent(json, "backtrace");
+    json.Key("backtrace");
+    WriteAMXBacktrace(json);
+    json.EndObject();
+    LogPrintJSON(json.str());
+    return;
+  }
   std::stringstream stream;
   PrintAMXBacktrace(stream);
-  PrintStream(LogDebugPrint, stream);
+  PrintStream(stream);
 }
 
 // static
 void CrashDetect::PrintAMXBacktrace(std::ostream &stream) {
-  if (call_stack_.IsEmpty()) {
+  std::vector<AMXBacktraceFrame> frames;
+  GetAMXBacktrace(frames);
+  PrintAMXBacktrace(stream, frames);
+}
+
+// static
+void CrashDetect::PrintAMXBacktraceDeferred() {
+  if (IsJSONLog()) {
+    PrintAMXBacktrace();
     return;
   }
 
-  AMXRef amx = call_stack_.Top().amx();
-  AMXRef top_amx = amx;
+  std::vector<AMXBacktraceFrame> frames;
+  GetAMXBacktrace(frames);
+  PrintAMXBacktraceDeferred(frames);
+}
 
-  AMXCallStack calls = call_stack_;
+// static
+void CrashDetect::PrintAMXBacktraceDeferred(
+    const std::vector<AMXBacktraceFrame> &frames) {
+  std::shared_ptr<DeferredBacktrace> backtrace =
+    std::make_shared<DeferredBacktrace>();
+  backtrace->frames = frames;
+  backtrace->arguments.resize(backtrace->frames.size());
+  for (std::size_t i = 0; i < backtrace->frames.size(); i++) {
+    const AMXBacktraceFrame &frame = backtrace->frames[i];
+    if (frame.is_native || frame.num_skipped != 0) {
+      continue;
+    }
+    CrashDetect *handler = GetHandler(frame.amx);
+    // If debug info loading is deferred, do it here rather than on the log
+    // thread.
+    handler->debug_info_->IsLoaded();
+    AMXBacktraceArguments &arguments = backtrace->arguments[i];
+    arguments.num_args =
+      frame.frame.GetArgumentValues(arguments.values,
+                                    AMXArgumentData::kMaxArgs);
+    frame.frame.GetArgumentData(
+      *handler->debug_info_,
+      arguments.values,
+      std::min<cell>(arguments.num_args, AMXArgumentData::kMaxArgs),
+      &arguments.data,
+      &handler->frame_cache_);
+  }
 
-  cell cip = top_amx.GetCip();
-  cell frm = top_amx.GetFrm();
-  int level = 0;
+  LogDebugPrintDeferred([backtrace]() {
+    std::stringstream stream;
+    PrintAMXBacktrace(stream, backtrace->frames, &backtrace->arguments);
+    return stream.str();
+  });
+}
 
-  if (!calls.IsEmpty() && cip != 0) {
+// static
+void CrashDetect::PrintAMXBacktrace(
+    std::ostream &stream,
+    const std::vector<AMXBacktraceFrame> &frames,
+    const std::vector<AMXBacktraceArguments> *arguments) {
+  if (!frames.empty()) {
     stream << "AMX backtrace:";
   }
 
-  while (!calls.IsEmpty() && cip != 0 && amx == top_amx) {
-    AMXCall call = calls.Pop();
+  // Stop when the stream can't take any more (GetBacktrace() writes
+  // directly into a fixed size array).
+  std::string text;
+  text.reserve(256);
+  std::size_t level = 0;
+  AMX *prev_amx = nullptr;
+  for (std::size_t i = 0; i < frames.size() && stream; i++, level++) {
+    const AMXBacktraceFrame &frame = frames[i];
+    AMXRef amx = frame.amx;
+
+    // the script that made the call into the previous one
+    if (frame.num_skipped == 0) {
+      if (prev_amx != nullptr && amx != prev_amx) {
+        stream << "\n--- called from " << GetHandler(amx)->amx_name_;
+      }
+      prev_amx = amx;
+    }
+
+    // frames left out by backtrace_head/backtrace_tail
+    if (frame.num_skipped != 0) {
+      stream << "\n... " << frame.num_skipped << " frames skipped";
+      level += frame.num_skipped - 1;
+    }
 
     // native function
-    if (call.IsNative()) {
-      const char *name = amx.GetNativeName(call.index());
-      stream << "\n#" << level++
+    else if (frame.is_native) {
+      const char *name = amx.GetNativeName(frame.native_index);
+      stream << "\n#" << level
              << " native "
              << (name != nullptr ? name : "<unknown>") << " ()";
-      std::string module = os::GetModuleName(
-        reinterpret_cast<void*>(amx.GetNativeAddress(call.index())));
+      std::string module = Symbolizer::shared().Resolve(
+        reinterpret_cast<void*>(amx.GetNativeAddress(frame.native_index)))
+        .module;
       if (!module.empty()) {
         stream << " in " << fileutils::GetFileName(module);
       }
     }
 
     // public function
-    else if (call.IsPublic()) {
+    else {
       CrashDetect *handler = GetHandler(amx);
 
-      AMXStackTrace trace = GetAMXStackTrace(amx, frm, cip, 100);
-      std::deque<AMXStackFrame> frames;
+      // Format the frame into a string and write it to the stream at once.
+      text.clear();
+      if (arguments != nullptr) {
+        const AMXBacktraceArguments &args = (*arguments)[i];
+        AMXStackFramePrinter(text,
+                             *handler->debug_info_,
+                             &handler->backtrace_frame_cache_)
+          .Print(frame.frame,
+                 args.values,
+                 std::min<cell>(args.num_args, AMXArgumentData::kMaxArgs),
+                 args.num_args,
+                 &args.data);
+      } else {
+        AMXStackFramePrinter(text,
+                             *handler->debug_info_,
+                             &handler->frame_cache_)
+          .Print(frame.frame);
+      }
+      stream << "\n#" << level << " " << text;
+
+      if (!handler->debug_info_->IsLoaded()) {
+        stream << " in " << handler->amx_name_;
+      }
+    }
+  }
+}
+
+// With backtrace_head or backtrace_tail only that many frames at the
+// start and at the end of the backtrace are kept, with a marker frame for
+// the ones in between, so deep recursion doesn't have to be printed in
+// full (but the whole chain is still walked to find the outer frames).
+// static
+void CrashDetect::GetAMXBacktrace(std::vector<AMXBacktraceFrame> &frames,
+                                  bool full) {
+  const AMXCallStack &call_stack = GetCallStack();
+  if (call_stack.IsEmpty()) {
+    return;
+  }
+
+  AMXRef amx = call_stack.Top().amx();
+  AMXRef top_amx = amx;
+
+  cell cip = top_amx.GetCip();
+  cell frm = top_amx.GetFrm();
+
+  std::size_t head = full ? 0 : Options::shared().backtrace_head();
+  std::size_t tail = full ? 0 : Options::shared().backtrace_tail();
+  bool trim = head != 0 || tail != 0;
+  std::vector<AMXBacktraceFrame> tail_frames;
+  std::size_t tail_start = 0;
+  std::size_t num_skipped = 0;
+
+  // Returns the frame where it's stored, or nullptr if it's skipped.
+  auto add_frame = [&](const AMXBacktraceFrame &frame)
+      -> AMXBacktraceFrame * {
+    if (!trim || frames.size() < head) {
+      frames.push_back(frame);
+      return &frames.back();
+    }
+    if (tail == 0) {
+      num_skipped++;
+      return nullptr;
+    }
+    if (tail_frames.size() < tail) {
+      tail_frames.push_back(frame);
+      return &tail_frames.back();
+    }
+    // The oldest of the tail frames is dropped.
+    AMXBacktraceFrame &slot = tail_frames[tail_start];
+    slot = frame;
+    tail_start = (tail_start + 1) % tail;
+    num_skipped++;
+    return &slot;
+  };
+
+  // The script may be in a native called via SYSREQ.D at the moment.
+  if (call_stack.Top().IsPublic()) {
+    cell native_index = GetDirectNativeCall(top_amx);
+    if (native_index >= 0) {
+      add_frame(AMXBacktraceFrame(top_amx, native_index));
+    }
+  }
+
+  // Calls made through CallRemoteFunction() and the like put the calls of
+  // several scripts on the call stack. Each script's frames are walked from
+  // where that script was when it made the call into the next one: its
+  // current registers the first time it's seen, or where it was left off
+  // if it's been seen before (because it's been called back into).
+  struct ScriptState {
+    AMX *amx;
+    cell frm;
+    cell cip;
+  };
+  std::vector<ScriptState> script_states;
+
+  int max_depth = static_cast<int>(Options::shared().backtrace_depth());
+  for (AMXCallStack::const_iterator it = call_stack.begin();
+       it != call_stack.end();
+       ++it) {
+    const AMXCall &call = *it;
+
+    if (call.amx() != amx) {
+      ScriptState state = {amx.amx(), frm, cip};
+      script_states.push_back(state);
+      amx = call.amx();
+      frm = amx.GetFrm();
+      cip = amx.GetCip();
+      bool resumed = false;
+      for (std::size_t i = script_states.size(); i-- > 0; ) {
+        if (script_states[i].amx == amx.amx()) {
+          frm = script_states[i].frm;
+          cip = script_states[i].cip;
+          resumed = true;
+          break;
+        }
+      }
+      if (!resumed && call.IsPublic()) {
+        cell native_index = GetDirectNativeCall(amx);
+        if (native_index >= 0) {
+          add_frame(AMXBacktraceFrame(amx, native_index));
+        }
+      }
+    }
+    if (cip == 0) {
+      // This script isn't running any code (the call came from the
+      // server), only calls of other scripts may follow.
+      continue;
+    }
+
+    // native function
+    if (call.IsNative()) {
+      add_frame(AMXBacktraceFrame(amx, call.index()));
+    }
+
+    // public function
+    else if (call.IsPublic()) {
+      AMXStackTrace trace = GetAMXStackTrace(amx, frm, cip, max_depth);
+      AMXBacktraceFrame *last_frame = nullptr;
+      bool have_frames = false;
 
       while (trace.current_frame().return_address() != 0) {
-        frames.push_back(trace.current_frame());
+        last_frame = add_frame(trace.current_frame());
+        have_frames = true;
         if (!trace.MoveNext()) {
           break;
         }
       }
 
       cell entry_point = amx.GetPublicAddress(call.index());
-      if (frames.empty()) {
+      if (!have_frames) {
         AMXStackFrame fake_frame(amx, frm, 0, 0, entry_point);
-        frames.push_front(fake_frame);
-      } else {
-        frames.back().set_caller_address(entry_point);
+        add_frame(fake_frame);
+      } else if (last_frame != nullptr) {
+        last_frame->frame.set_caller_address(entry_point);
+      }
+
+      frm = call.frm();
+      cip = call.cip();
+    }
+  }
+
+  if (num_skipped > 0 || !tail_frames.empty()) {
+    if (num_skipped > 0) {
+      AMXBacktraceFrame marker(top_amx, -1);
+      marker.num_skipped = num_skipped;
+      frames.push_back(marker);
+    }
+    frames.insert(frames.end(),
+                  tail_frames.begin() + tail_start,
+                  tail_frames.end());
+    frames.insert(frames.end(),
+                  tail_frames.begin(),
+                  tail_frames.begin() + tail_start);
+  }
+}
+
+// static
+void CrashDetect::GetAMXFrameInfo(std::vector<AMXFrameInfo> &frames) {
+  std::vector<AMXBacktraceFrame> bt_frames;
+  GetAMXBacktrace(bt_frames, true);
+
+  std::size_t first = 0;
+  if (!bt_frames.empty() && bt_frames[0].is_native) {
+    first = 1;
+  }
+  frames.reserve(bt_frames.size() - first);
+  for (std::size_t i = first; i < bt_frames.size(); i++) {
+    const AMXBacktraceFrame &bt_frame = bt_frames[i];
+    if (bt_frame.amx != bt_frames[0].amx) {
+      // Addresses in other scripts mean nothing to the caller.
+      break;
+    }
+    AMXFrameInfo frame;
+    if (bt_frame.is_native) {
+      frame.address = 0;
+      frame.function = -1;
+      frame.native_index = bt_frame.native_index;
+      frame.line = 0;
+    } else {
+      const AMXDebugInfo &debug_info = *GetHandler(bt_frame.amx)->debug_info_;
+      frame.address = bt_frame.frame.return_address();
+      frame.function = bt_frame.frame.caller_address();
+      frame.native_index = -1;
+      frame.line = 0;
+      if (debug_info.IsLoaded() && frame.address != 0) {
+        frame.line = debug_info.GetLineNumber(frame.address) + 1;
       }
+    }
+    frames.push_back(frame);
+  }
+}
+
+// static
+bool CrashDetect::GetAMXCallerInfo(std::size_t depth,
+                                   std::string &function,
+                                   std::string &file,
+                                   cell &line) {
+  std::vector<AMXBacktraceFrame> bt_frames;
+  GetAMXBacktrace(bt_frames, true);
+
+  if (!bt_frames.empty() && bt_frames[0].is_native) {
+    depth++;
+  }
+  if (depth >= bt_frames.size()) {
+    return false;
+  }
+
+  const AMXBacktraceFrame &bt_frame = bt_frames[depth];
+  function.clear();
+  file.clear();
+  line = 0;
+  if (bt_frame.is_native) {
+    const char *name = bt_frame.amx.GetNativeName(bt_frame.native_index);
+    if (name != nullptr) {
+      function = name;
+    }
+  } else {
+    CrashDetect *handler = GetHandler(bt_frame.amx);
+    const AMXDebugInfo &debug_info = *handler->debug_info_;
+    std::stringstream name;
+    AMXStackFramePrinter(name, debug_info, &handler->frame_cache_)
+      .PrintCallerName(bt_frame.frame);
+    function = name.str();
+    cell address = bt_frame.frame.return_address();
+    if (debug_info.IsLoaded() && address != 0) {
+      file = debug_info.GetFileNamePtr(address);
+      line = debug_info.GetLineNumber(address) + 1;
+    }
+  }
+  return true;
+}
 
-      for (std::deque<AMXStackFrame>::const_iterator it = frames.begin();
-           it != frames.end(); it++) {
-        const AMXStackFrame &frame = *it;
+// static
+void CrashDetect::WriteAMXBacktrace(JSONWriter &json) {
+  std::vector<AMXBacktraceFrame> frames;
+  GetAMXBacktrace(frames);
+  WriteAMXBacktrace(json, frames);
+}
 
-        stream << "\n#" << level++ << " ";
-        frame.Print(stream, handler->debug_info_);
+// static
+void CrashDetect::WriteAMXBacktrace(
+    JSONWriter &json,
+    const std::vector<AMXBacktraceFrame> &frames) {
+  json.BeginArray();
+  AMX *prev_amx = nullptr;
+  for (std::size_t i = 0; i < frames.size(); i++) {
+    const AMXBacktraceFrame &frame = frames[i];
+    AMXRef amx = frame.amx;
 
-        if (!handler->debug_info_.IsLoaded()) {
-          stream << " in " << handler->amx_name_;
-        }
+    if (frame.num_skipped == 0) {
+      if (prev_amx != nullptr && amx != prev_amx) {
+        json.BeginObject();
+        json.Field("called_from", GetHandler(amx)->amx_name_);
+        json.EndObject();
       }
+      prev_amx = amx;
+    }
 
-      frm = call.frm();
-      cip = call.cip();
+    json.BeginObject();
+    if (frame.num_skipped != 0) {
+      json.Field("skipped", static_cast<unsigned long>(frame.num_skipped));
+    } else if (frame.is_native) {
+      const char *name = amx.GetNativeName(frame.native_index);
+      json.Field("native", name != nullptr ? name : "<unknown>");
+      std::string module = Symbolizer::shared().Resolve(
+        reinterpret_cast<void*>(amx.GetNativeAddress(frame.native_index)))
+        .module;
+      if (!module.empty()) {
+        json.Field("module", fileutils::GetFileName(module));
+      }
+    } else {
+      CrashDetect *handler = GetHandler(amx);
+      std::stringstream function;
+      std::stringstream arguments;
+      AMXStackFramePrinter(function,
+                           *handler->debug_info_,
+                           &handler->frame_cache_)
+        .PrintCallerName(frame.frame);
+      AMXStackFramePrinter(arguments,
+                           *handler->debug_info_,
+                           &handler->frame_cache_)
+        .PrintArgumentList(frame.frame);
+      json.Field("script", handler->amx_name_);
+      json.Field("function", function.str());
+      json.Field("arguments", arguments.str());
+      json.Field("address", frame.frame.return_address());
+      WriteSourceLocation(json,
+                          *handler->debug_info_,
+                          frame.frame.return_address());
     }
+    json.EndObject();
   }
+  json.EndArray();
 }
 
 // static
@@ -512,24 +5005,151 @@ void CrashDetect::PrintRegisters(const os::Context &context) {
                 registers.eflags);
 }
 
+namespace {
+
+// The stack and the text printed from it are kept in static buffers, so
+// that printing them doesn't need the heap or much stack, which may both
+// be in a bad state after a crash.
+const std::size_t kMaxStackDumpCells = 16 * 1024;
+const std::size_t kStackDumpCellsPerLine = 4;
+const std::size_t kStackDumpTextSize = 16 * 1024;
+const std::size_t kStackDumpMaxLineLength = 1024;
+
+os::uint32_t stack_dump[kMaxStackDumpCells];
+char stack_dump_text[kStackDumpTextSize];
+
+const char *GetFileNamePtr(const char *path) {
+  const char *name = path;
+  for (const char *c = path; *c != '\0'; c++) {
+    if (*c == '/' || *c == '\\') {
+      name = c + 1;
+    }
+  }
+  return name;
+}
+
+std::size_t AppendFormat(char *buffer,
+                         std::size_t size,
+                         std::size_t length,
+                         const char *format,
+                         ...) {
+  if (length + 1 >= size) {
+    return length;
+  }
+  std::va_list va;
+  va_start(va, format);
+  int result = std::vsnprintf(buffer + length, size - length, format, va);
+  va_end(va);
+  if (result < 0) {
+    return length;
+  }
+  return std::min(length + static_cast<std::size_t>(result), size - 1);
+}
+
+} // anonymous namespace
+
+// Returns the length of the description, or 0 if the address isn't in the
+// code of this script.
+std::size_t CrashDetect::DescribeCodeAddress(char *buffer,
+                                             std::size_t size,
+                                             uint32_t address) const {
+  cell cip;
+  void *pointer = reinterpret_cast<void *>(static_cast<uintptr_t>(address));
+  const AMX_HEADER *hdr = amx_.GetHeader();
+  uintptr_t code_start = reinterpret_cast<uintptr_t>(amx_.GetCode());
+  uintptr_t code_end = code_start + (hdr->dat - hdr->cod);
+  if (address >= code_start && address < code_end) {
+    cip = static_cast<cell>(address - code_start);
+  } else if (jit_ == nullptr
+             || amx_JitGetCip(jit_, pointer, &cip) != AMX_ERR_NONE) {
+    return 0;
+  }
+  std::size_t length = AppendFormat(buffer, size, 0, "%s@%08x",
+                                    amx_name_.c_str(),
+                                    static_cast<unsigned>(cip));
+  if (debug_info_->IsLoaded()) {
+    AMXDebugInfo::Symbol function = debug_info_->GetFunction(cip);
+    if (function) {
+      length = AppendFormat(buffer, size, length, " %s",
+                            function.GetNamePtr());
+    }
+  }
+  return length;
+}
+
+// Cells that point into a loaded module or the code of the crashed script
+// are annotated with what they point to, they may be return addresses.
 // static
-void CrashDetect::PrintStack(const os::Context &context) {
+void CrashDetect::PrintStack(const os::Context &context,
+                             const CrashDetect *instance) {
   os::Context::Registers registers = context.GetRegisters();
-  os::uint32_t *stack_ptr = reinterpret_cast<os::uint32_t *>(registers.esp);
+  const void *stack_ptr =
+    reinterpret_cast<const void *>(static_cast<uintptr_t>(registers.esp));
   if (stack_ptr == nullptr) {
     return;
   }
 
-  LogDebugPrint("Stack:");
+  std::size_t num_cells = std::min<std::size_t>(
+    Options::shared().crash_stack_size(), kMaxStackDumpCells);
+  num_cells = os::ReadMemory(stack_dump,
+                             stack_ptr,
+                             num_cells * sizeof(*stack_dump))
+              / sizeof(*stack_dump);
+  if (num_cells == 0) {
+    return;
+  }
 
-  for (int i = 0; i < 256; i += 8) {
-    LogDebugPrint("ESP+%08x: %08x %08x %08x %08x",
-                  i * sizeof(*stack_ptr),
-                  stack_ptr[i],
-                  stack_ptr[i + 1],
-                  stack_ptr[i + 2],
-                  stack_ptr[i + 3]);
+  std::size_t length = AppendFormat(stack_dump_text,
+                                    kStackDumpTextSize,
+                                    0,
+                                    "Stack:\n");
+  for (std::size_t i = 0; i < num_cells; i += kStackDumpCellsPerLine) {
+    if (kStackDumpTextSize - length <= kStackDumpMaxLineLength) {
+      LogDebugPrintLines(stack_dump_text, length);
+      length = 0;
+    }
+    std::size_t line_size = length + kStackDumpMaxLineLength;
+    std::size_t line_end = std::min(i + kStackDumpCellsPerLine, num_cells);
+    length = AppendFormat(stack_dump_text, line_size, length,
+                          "ESP+%08x:",
+                          static_cast<unsigned>(i * sizeof(*stack_dump)));
+    for (std::size_t j = i; j < line_end; j++) {
+      length = AppendFormat(stack_dump_text, line_size, length,
+                            " %08x", stack_dump[j]);
+    }
+    bool annotated = false;
+    for (std::size_t j = i; j < line_end; j++) {
+      char description[256];
+      std::size_t description_length = 0;
+      if (instance != nullptr) {
+        description_length = instance->DescribeCodeAddress(
+          description, sizeof(description), stack_dump[j]);
+      }
+      if (description_length == 0) {
+        os::uint32_t offset;
+        const char *module = ModuleTable::shared().FindModuleName(
+          reinterpret_cast<void *>(static_cast<uintptr_t>(stack_dump[j])),
+          offset);
+        if (module == nullptr) {
+          continue;
+        }
+        AppendFormat(description, sizeof(description), 0, "%s+%x",
+                     GetFileNamePtr(module),
+                     static_cast<unsigned>(offset));
+      }
+      length = AppendFormat(stack_dump_text, line_size, length,
+                            "%s%u: %s",
+                            annotated ? ", " : " (",
+                            static_cast<unsigned>(j - i),
+                            description);
+      annotated = true;
+    }
+    if (annotated) {
+      length = AppendFormat(stack_dump_text, line_size, length, ")");
+    }
+    length = AppendFormat(stack_dump_text, line_size + 1, length, "\n");
   }
+  LogDebugPrintLines(stack_dump_text, length);
 }
 
 // static
@@ -537,7 +5157,7 @@ void CrashDetect::PrintLoadedModules() {
   LogDebugPrint("Loaded modules:");
 
   std::vector<os::Module> modules;
-  os::GetLoadedModules(modules);
+  ModuleTable::shared().GetModules(modules);
 
   for (std::vector<os::Module>::const_iterator it = modules.begin();
        it != modules.end(); it++) {
@@ -549,79 +5169,627 @@ void CrashDetect::PrintLoadedModules() {
   }
 }
 
+// static
+AMXCallStack *CrashDetect::CreateCallStack() {
+  // This is the first time the thread runs AMX code (or gets ready to).
+  os::SetUpCrashStack();
+  own_call_stack_.reset(new AMXCallStack);
+  return own_call_stack_.get();
+}
+
 // static
 void CrashDetect::Push(AMXCall call) {
-  if (call_stack_.IsEmpty()) {
-    long_call_time_next_ =
-        std::chrono::high_resolution_clock::now() + long_call_time_current_;
+  AMXCallStack &call_stack = GetCallStack();
+  if (call_stack.IsEmpty()) {
+    if (call_time_limits_) {
+      CrashDetect *handler = GetHandler(call.amx());
+      LongCallWatchdog::shared().SetThreadTimeLimit(
+        std::chrono::microseconds(
+          handler != nullptr ? handler->GetCallTimeLimit(call) : -1));
+    }
+    LongCallWatchdog::shared().BeginCall();
+    if (Options::shared().tick_budget() != 0
+        && &call_stack == main_call_stack_) {
+      tick_call_start_ = fastclock::Now();
+    }
+    if (&call_stack == main_call_stack_) {
+      long_call_natives_.clear();
+    }
+  } else if (track_native_time_
+             && call.IsPublic()
+             && call_stack.Top().IsNative()) {
+    // A native is calling a public: the public's own time is script time.
+    AddLongCallNativeTime(call_stack.Top(),
+                          LongCallWatchdog::shared().EndNative());
+  }
+  call_stack.Push(call);
+  if (FlightRecorder::shared().IsEnabled()) {
+    FlightRecorder::shared().Record(call.IsNative()
+                                      ? FlightRecorder::NATIVE_CALL
+                                      : FlightRecorder::PUBLIC_CALL,
+                                    call.amx(),
+                                    call.index());
+  }
+  if (track_native_time_ && call.IsNative()) {
+    LongCallWatchdog::shared().BeginNative();
   }
-  call_stack_.Push(call);
 }
 
 // static
 AMXCall CrashDetect::Pop() {
-  AMXCall call = call_stack_.Pop();
-  if (call_stack_.IsEmpty()) {
-    long_call_time_next_ =
-        std::chrono::high_resolution_clock::time_point::max();
+  AMXCallStack &call_stack = GetCallStack();
+  AMXCall call = call_stack.Pop();
+  if (FlightRecorder::shared().IsEnabled()) {
+    FlightRecorder::shared().Record(call.IsNative()
+                                      ? FlightRecorder::NATIVE_RETURN
+                                      : FlightRecorder::PUBLIC_RETURN,
+                                    call.amx(),
+                                    call.index());
+  }
+  if (track_native_time_) {
+    if (call.IsNative()) {
+      AddLongCallNativeTime(call, LongCallWatchdog::shared().EndNative());
+    } else if (!call_stack.IsEmpty() && call_stack.Top().IsNative()) {
+      LongCallWatchdog::shared().BeginNative();
+    }
+  }
+  if (call_stack.IsEmpty()) {
+    if (long_call_profiling_ && &call_stack == main_call_stack_) {
+      EndLongCallProfile();
+    }
+    LongCallWatchdog::shared().EndCall();
+    if (Options::shared().tick_budget() != 0
+        && &call_stack == main_call_stack_) {
+      EndTickCall(call);
+    }
+    if (&call_stack == main_call_stack_) {
+      HangWatchdog::shared().Heartbeat();
+    }
   }
   return call;
 }
 
+// static
+void CrashDetect::AddLongCallNativeTime(const AMXCall &call, int64_t time) {
+  if (&GetCallStack() != main_call_stack_) {
+    return;
+  }
+  AMX *amx = call.amx();
+  // A call usually sticks to a handful of natives, and the one that has
+  // just returned is likely to be called again.
+  for (std::size_t i = long_call_natives_.size(); i-- > 0; ) {
+    LongCallNative &native = long_call_natives_[i];
+    if (native.amx == amx && native.index == call.index()) {
+      native.time += time;
+      return;
+    }
+  }
+  LongCallNative native = {amx, call.index(), time};
+  long_call_natives_.push_back(native);
+}
+
+// static
+void CrashDetect::GetLongCallModuleTimes(
+    std::vector<std::pair<std::string, int64_t>> &modules) {
+  modules.clear();
+  if (&GetCallStack() != main_call_stack_) {
+    return;
+  }
+  std::unordered_map<std::string, int64_t> times;
+  for (std::size_t i = 0; i < long_call_natives_.size(); i++) {
+    const LongCallNative &native = long_call_natives_[i];
+    std::string module;
+    if (CrashDetect *handler = GetHandler(native.amx)) {
+      module = fileutils::GetFileName(
+        ModuleTable::shared().GetModuleName(reinterpret_cast<void*>(
+          handler->amx_.GetNativeAddress(native.index))));
+    }
+    times[module.empty() ? "<unknown>" : module] += native.time;
+  }
+  modules.assign(times.begin(), times.end());
+  std::sort(modules.begin(), modules.end(),
+            [](const std::pair<std::string, int64_t> &a,
+               const std::pair<std::string, int64_t> &b) {
+              return a.second > b.second;
+            });
+}
+
+// static
+void CrashDetect::CheckIntegrity(int64_t deadline) {
+  ForEachHandler([deadline](CrashDetect *handler) {
+    handler->CheckScriptIntegrity(deadline);
+  });
+}
+
+void CrashDetect::CheckScriptIntegrity(int64_t deadline) {
+  if (!integrity_checker_) {
+    return;
+  }
+
+  // Between ticks no script is running (unless it's sleeping), so the heap
+  // and the stack should be within their bounds and not overlap.
+  cell hea = amx_.GetHea();
+  cell stk = amx_.GetStk();
+  bool registers_ok = amx_.GetHlw() <= hea && hea <= stk
+                      && stk <= amx_.GetStp();
+  if (!registers_ok && !bad_registers_reported_) {
+    ReportCorruption("HEA and STK out of bounds", hea, stk);
+  }
+  bad_registers_reported_ = !registers_ok;
+
+  std::size_t num_blocks = integrity_checker_->GetNumBlocks();
+  for (std::size_t i = 0; i < num_blocks; i++) {
+    std::size_t block;
+    if (!integrity_checker_->CheckNextBlock(block)) {
+      ReportCorruption(
+        integrity_checker_->IsHeaderBlock(block) ? "AMX header changed"
+                                                 : "code changed",
+        integrity_checker_->GetBlockStart(block),
+        integrity_checker_->GetBlockEnd(block));
+    }
+    if (fastclock::Now() >= deadline) {
+      break;
+    }
+  }
+}
+
+// The flight recorder shows what ran up to now, which is the closest one
+// can get to what did it.
+void CrashDetect::ReportCorruption(const char *what, cell start, cell end) {
+  Metrics::shared().CountError(AMX_ERR_MEMACCESS);
+  if (IsJSONLog()) {
+    JSONWriter json;
+    BeginJSONEvent(json, "memory_corruption");
+    json.Field("script", amx_name_);
+    json.Field("what", what);
+    json.Field("start", static_cast<long long>(start));
+    json.Field("end", static_cast<long long>(end));
+    json.Field("tick", static_cast<long long>(tick_count_));
+    if (FlightRecorder::shared().IsEnabled()) {
+      json.Key("flight_recorder");
+      WriteFlightRecorder(json);
+    }
+    json.EndObject();
+    LogPrintJSON(json.str());
+    return;
+  }
+  LogDebugPrint("Memory corruption in %s detected at tick %llu: %s "
+                "(0x%08X - 0x%08X)",
+                amx_name_.c_str(),
+                static_cast<unsigned long long>(tick_count_),
+                what,
+                static_cast<unsigned>(start),
+                static_cast<unsigned>(end));
+  PrintFlightRecorder();
+}
+
+// static
+void CrashDetect::EndTickCall(const AMXCall &call) {
+  int64_t time = fastclock::Now() - tick_call_start_;
+  tick_time_ += time;
+  uint64_t key = (static_cast<uint64_t>(reinterpret_cast<uintptr_t>(
+                    static_cast<AMX*>(call.amx()))) << 32)
+               | static_cast<uint32_t>(call.index());
+  TickCall &tick_call = tick_calls_[key];
+  if (tick_call.calls == 0) {
+    tick_call.amx = call.amx();
+    tick_call.index = call.index();
+    tick_call.time = 0;
+  }
+  tick_call.calls++;
+  tick_call.time += time;
+}
+
+// static
+void CrashDetect::OnProcessTick() {
+  HangWatchdog::shared().Heartbeat();
+  tick_count_++;
+  if (IsWatchHitPending()) {
+    ReportWatchHits();
+  }
+  RunIdleJobs();
+  if (!startup_done_) {
+    // Scripts loaded after this (e.g. filterscripts loaded with an RCON
+    // command) don't count towards startup anymore.
+    startup_done_ = true;
+    if (Options::shared().startup_timing()) {
+      PrintStartupTimes();
+    }
+  }
+  if (Metrics::shared().IsSnapshotPending()) {
+    std::string lines;
+    ForEachHandler([&lines](CrashDetect *handler) {
+      handler->WriteMetrics(lines);
+    });
+    Metrics::shared().PostSnapshot(lines);
+  }
+  if (StatsSegment::shared().IsOpen()) {
+    int64_t now = fastclock::Now();
+    if (now >= stats_next_update_) {
+      stats_next_update_ =
+        now + static_cast<int64_t>(Options::shared().stats_interval()) * 1000;
+      UpdateStats();
+    }
+  }
+
+  unsigned int budget = Options::shared().tick_budget();
+  if (budget == 0) {
+    return;
+  }
+  if (tick_time_ > static_cast<int64_t>(budget)) {
+    // Printing every tick would flood the log if the server is constantly
+    // over budget, so only one tick per second is reported in full.
+    int64_t now = fastclock::Now();
+    if (now - last_tick_report_ >= 1000000) {
+      PrintTickReport();
+      last_tick_report_ = now;
+      ticks_over_budget_ = 0;
+    } else {
+      ticks_over_budget_++;
+    }
+  }
+  tick_time_ = 0;
+  tick_calls_.clear();
+}
+
+// static
+void CrashDetect::RunIdleJobs() {
+  int64_t idle_time = Options::shared().idle_budget();
+  // With tick_budget the time that scripts took in this tick is known, and
+  // idle jobs only get what's left of it.
+  unsigned int tick_budget = Options::shared().tick_budget();
+  if (tick_budget != 0) {
+    idle_time = std::min(idle_time,
+                         static_cast<int64_t>(tick_budget) - tick_time_);
+  }
+  if (idle_time > 0) {
+    IdleScheduler::shared().RunMainJobs(fastclock::Now() + idle_time);
+  }
+}
+
+// static
+void CrashDetect::PrintTickReport() {
+  std::vector<const TickCall *> calls;
+  for (std::unordered_map<uint64_t, TickCall>::const_iterator it =
+         tick_calls_.begin();
+       it != tick_calls_.end(); it++) {
+    calls.push_back(&it->second);
+  }
+  std::sort(calls.begin(), calls.end(),
+            [](const TickCall *a, const TickCall *b) {
+              return a->time > b->time;
+            });
+
+  LogDebugPrint("Server tick took %.3f ms in scripts (budget is %.3f ms, "
+                "%u more ticks over budget since the last report):",
+                tick_time_ / 1000.0,
+                Options::shared().tick_budget() / 1000.0,
+                ticks_over_budget_);
+  for (std::size_t i = 0; i < calls.size() && i < kTraceCountsTopN; i++) {
+    const TickCall &call = *calls[i];
+    CrashDetect *handler = GetHandler(call.amx);
+    const char *name = nullptr;
+    if (handler != nullptr) {
+      name = call.index == AMX_EXEC_MAIN
+        ? "main"
+        : handler->amx_.GetPublicName(call.index);
+    }
+    LogDebugPrint("%10.3f ms %6u calls %s: %s",
+                  call.time / 1000.0,
+                  call.calls,
+                  handler != nullptr ? handler->amx_name_.c_str()
+                                     : "<unknown>",
+                  name != nullptr ? name : "<unknown>");
+  }
+}
+
 void CrashDetect::PrintNativeBacktrace(const os::Context &context) {
+  if (IsJSONLog()) {
+    JSONWriter json;
+    BeginJSONEvent(json, "native_backtrace");
+    json.Key("native_backtrace");
+    WriteNativeBacktrace(json, context);
+    json.EndObject();
+    LogPrintJSON(json.str());
+    return;
+  }
   std::stringstream stream;
   PrintNativeBacktrace(stream, context);
-  PrintStream(LogDebugPrint, stream);
+  PrintStream(stream);
 }
 
 // static
 void CrashDetect::PrintNativeBacktrace(std::ostream &stream,
                                        const os::Context &context) {
-  std::vector<StackFrame> frames;
-  GetStackTrace(frames, context.native_context());
+  void *trace[kMaxStackFrames];
+  int length = CaptureStackTrace(trace,
+                                 kMaxStackFrames,
+                                 context.native_context());
+  std::vector<SymbolizedFrame> frames;
+  Symbolizer::shared().Resolve(trace, length, frames);
+  PrintNativeBacktrace(stream, frames);
+}
 
+// static
+void CrashDetect::PrintNativeBacktrace(
+    std::ostream &stream,
+    const std::vector<SymbolizedFrame> &frames) {
   if (!frames.empty()) {
     stream << "Native backtrace:";
 
     int level = 0;
-    for (std::vector<StackFrame>::const_iterator it = frames.begin();
-         it != frames.end(); it++) {
-      const StackFrame &frame = *it;
+    for (std::vector<SymbolizedFrame>::const_iterator it = frames.begin();
+         it != frames.end() && stream; it++) {
+      const SymbolizedFrame &frame = *it;
 
       stream << "\n#" << level++ << " ";
-      frame.Print(stream);
+      StackFrame(frame.address, frame.function).Print(stream);
 
-      std::string module = os::GetModuleName(frame.return_address());
-      if (!module.empty()) {
-        stream << " in " << fileutils::GetRelativePath(module);
+      if (!frame.module.empty()) {
+        stream << " in " << fileutils::GetRelativePath(frame.module);
       }
     }
   }
 }
 
+// static
+void CrashDetect::PrintNativeBacktraceDeferred(const os::Context &context) {
+  if (IsJSONLog()) {
+    PrintNativeBacktrace(context);
+    return;
+  }
+
+  std::shared_ptr<std::vector<void *>> trace =
+    std::make_shared<std::vector<void *>>(kMaxStackFrames);
+  trace->resize(CaptureStackTrace(trace->data(),
+                                  kMaxStackFrames,
+                                  context.native_context()));
+
+  LogDebugPrintDeferred([trace]() {
+    std::vector<SymbolizedFrame> frames;
+    Symbolizer::shared().Resolve(trace->data(),
+                                 static_cast<int>(trace->size()),
+                                 frames);
+    std::stringstream stream;
+    PrintNativeBacktrace(stream, frames);
+    return stream.str();
+  });
+}
+
+// static
+void CrashDetect::PrintReportBacktraces(const os::Context *context) {
+  if (Options::shared().backtrace_async()) {
+    PrintAMXBacktraceDeferred();
+    if (context != nullptr) {
+      PrintNativeBacktraceDeferred(*context);
+    }
+  } else {
+    PrintAMXBacktrace();
+    if (context != nullptr) {
+      PrintNativeBacktrace(*context);
+    }
+  }
+}
+
+// static
+void CrashDetect::PrintNativeBacktrace(void *const *frames, int num_frames) {
+  if (num_frames == 0) {
+    return;
+  }
+  LogDebugPrint("Native backtrace:");
+  for (int i = 0; i < num_frames; i++) {
+    const char *name = FindSymbolName(frames[i]);
+    const char *module = ModuleTable::shared().FindModuleName(frames[i]);
+    LogDebugPrint("#%d %08lx in %s ()%s%s",
+                  i,
+                  static_cast<unsigned long>(
+                    reinterpret_cast<std::uintptr_t>(frames[i])),
+                  name != nullptr && name[0] != '\0' ? name : "??",
+                  module != nullptr ? " in " : "",
+                  module != nullptr ? module : "");
+  }
+}
+
+// static
+void CrashDetect::WriteNativeBacktrace(JSONWriter &json,
+                                       const os::Context &context) {
+  void *trace[kMaxStackFrames];
+  int length = CaptureStackTrace(trace,
+                                 kMaxStackFrames,
+                                 context.native_context());
+  std::vector<SymbolizedFrame> frames;
+  Symbolizer::shared().Resolve(trace, length, frames);
+  WriteNativeBacktrace(json, frames);
+}
+
+// static
+void CrashDetect::WriteNativeBacktrace(
+    JSONWriter &json,
+    const std::vector<SymbolizedFrame> &frames) {
+  json.BeginArray();
+  for (std::vector<SymbolizedFrame>::const_iterator it = frames.begin();
+       it != frames.end(); it++) {
+    const SymbolizedFrame &frame = *it;
+    json.BeginObject();
+    json.Field("address",
+               static_cast<unsigned long>(
+                 reinterpret_cast<std::uintptr_t>(frame.address)));
+    if (!frame.function.empty()) {
+      json.Field("function", frame.function);
+    }
+    if (!frame.module.empty()) {
+      json.Field("module", fileutils::GetRelativePath(frame.module));
+    }
+    json.EndObject();
+  }
+  json.EndArray();
+}
+
+// static
+void CrashDetect::WriteNativeBacktrace(JSONWriter &json,
+                                       void *const *trace,
+                                       int length) {
+  // Not through the symbolizer: it takes a lock that the crashed thread
+  // may be holding.
+  std::vector<SymbolizedFrame> frames(length);
+  for (int i = 0; i < length; i++) {
+    const char *name = FindSymbolName(trace[i]);
+    frames[i].address = trace[i];
+    frames[i].function = name != nullptr ? name : "";
+    frames[i].module = ModuleTable::shared().GetModuleName(trace[i]);
+  }
+  WriteNativeBacktrace(json, frames);
+}
+
+// static
+void CrashDetect::WriteRegisters(JSONWriter &json,
+                                 const os::Context &context) {
+  os::Context::Registers registers = context.GetRegisters();
+  json.BeginObject();
+  json.Field("eax", registers.eax);
+  json.Field("ebx", registers.ebx);
+  json.Field("ecx", registers.ecx);
+  json.Field("edx", registers.edx);
+  json.Field("esi", registers.esi);
+  json.Field("edi", registers.edi);
+  json.Field("ebp", registers.ebp);
+  json.Field("esp", registers.esp);
+  json.Field("eip", registers.eip);
+  json.Field("eflags", registers.eflags);
+  json.EndObject();
+}
+
+// static
+void CrashDetect::WriteLoadedModules(JSONWriter &json) {
+  std::vector<os::Module> modules;
+  ModuleTable::shared().GetModules(modules);
+
+  json.BeginArray();
+  for (std::vector<os::Module>::const_iterator it = modules.begin();
+       it != modules.end(); it++) {
+    const os::Module &module = *it;
+    json.BeginObject();
+    json.Field("name", module.name());
+    json.Field("base", module.base_address());
+    json.Field("size", module.size());
+    json.EndObject();
+  }
+  json.EndArray();
+}
+
+// static
+void CrashDetect::GetFlightRecorderEventInfo(
+    const FlightRecorder::Event &event,
+    const char *&action,
+    const char *&name,
+    const char *&script) {
+  static const char *const kActions[] = {
+    "call public",
+    "return from public",
+    "call native",
+    "return from native"
+  };
+  action = kActions[event.type()];
+  name = nullptr;
+  script = "<unloaded>";
+  // The script may be gone by now.
+  CrashDetect *handler = event.amx != nullptr ? GetHandler(event.amx)
+                                              : nullptr;
+  if (handler != nullptr) {
+    script = handler->amx_name_.c_str();
+    if (event.type() == FlightRecorder::NATIVE_CALL
+        || event.type() == FlightRecorder::NATIVE_RETURN) {
+      name = handler->amx_.GetNativeName(event.index);
+    } else if (event.index == AMX_EXEC_MAIN) {
+      name = "main";
+    } else {
+      name = handler->amx_.GetPublicName(event.index);
+    }
+  }
+  if (name == nullptr) {
+    name = "<unknown>";
+  }
+}
+
+// static
+void CrashDetect::PrintFlightRecorder() {
+  const FlightRecorder &recorder = FlightRecorder::shared();
+  std::size_t num_events = recorder.GetNumEvents();
+  if (num_events == 0) {
+    return;
+  }
+  uint32_t newest_time = recorder.GetEvent(0).time();
+  LogDebugPrint("Last %u calls and returns:",
+                static_cast<unsigned int>(num_events));
+  for (std::size_t age = num_events; age-- > 0; ) {
+    const FlightRecorder::Event &event = recorder.GetEvent(age);
+    const char *action;
+    const char *name;
+    const char *script;
+    GetFlightRecorderEventInfo(event, action, name, script);
+    uint32_t time_ago =
+      (newest_time - event.time()) & FlightRecorder::kTimeMask;
+    LogDebugPrint("%10.3f ms ago %s %s (%s)",
+                  time_ago / 1000.0,
+                  action,
+                  name,
+                  script);
+  }
+}
+
+// static
+void CrashDetect::WriteFlightRecorder(JSONWriter &json) {
+  const FlightRecorder &recorder = FlightRecorder::shared();
+  std::size_t num_events = recorder.GetNumEvents();
+  uint32_t newest_time =
+    num_events != 0 ? recorder.GetEvent(0).time() : 0;
+  json.BeginArray();
+  for (std::size_t age = num_events; age-- > 0; ) {
+    const FlightRecorder::Event &event = recorder.GetEvent(age);
+    const char *action;
+    const char *name;
+    const char *script;
+    GetFlightRecorderEventInfo(event, action, name, script);
+    json.BeginObject();
+    json.Field("event", action);
+    json.Field("name", name);
+    json.Field("script", script);
+    json.Field("time_ago", static_cast<long long>(
+      (newest_time - event.time()) & FlightRecorder::kTimeMask));
+    json.EndObject();
+  }
+  json.EndArray();
+}
+
+// static
+const char *CrashDetect::GetScriptPath(AMX *amx) {
+  CrashDetect *handler = GetHandler(amx);
+  return handler != nullptr ? handler->amx_path_.c_str() : nullptr;
+}
+
 // static
 void CrashDetect::SetLongCallTime(unsigned int time) {
-  long_call_time_current_ = std::chrono::microseconds(time);
+  LongCallWatchdog::shared().SetTimeLimit(std::chrono::microseconds(time));
 }
 
 // static
 unsigned int CrashDetect::LongCallOption(int option) {
+  LongCallWatchdog &watchdog = LongCallWatchdog::shared();
   switch (option) {
     case AMX_LCT_OPTION_CURRENT:
-      return static_cast<unsigned int>(long_call_time_current_.count());
+      return static_cast<unsigned int>(watchdog.GetThreadTimeLimit().count());
     // case AMX_LCT_OPTION_ORIGINAL:
     //   return CrashDetect::long_call_time_;
     case AMX_LCT_OPTION_ACTIVE:
-      return long_call_time_running_;
+      return watchdog.IsEnabled();
     case AMX_LCT_OPTION_RESTART:
-      long_call_time_next_ =
-          std::chrono::high_resolution_clock::now() + long_call_time_current_;
+      watchdog.BeginCall();
       break;
     case AMX_LCT_OPTION_DISABLE:
-      long_call_time_running_ = false;
+      watchdog.SetEnabled(false);
       break;
     case AMX_LCT_OPTION_ENABLE:
-      long_call_time_running_ = long_call_time_ != 0;
+      watchdog.SetEnabled(long_call_checks_);
       break;
     case AMX_LCT_OPTION_RESET:
       SetLongCallTime(long_call_time_);
@@ -632,14 +5800,279 @@ unsigned int CrashDetect::LongCallOption(int option) {
 
 // static
 void CrashDetect::CheckLongCallTime(void) {
-  if (!long_call_time_running_) {
-    return;
+  // The watchdog thread keeps track of time, so this is cheap enough to be
+  // called from the VM loop. Each call is reported only once.
+  LongCallWatchdog &watchdog = LongCallWatchdog::shared();
+  if (long_call_profiling_) {
+    const AMXCallStack &call_stack = GetCallStack();
+    if (!call_stack.IsEmpty()) {
+      SampleLongCall(GetHandler(call_stack.Top().amx()), -1);
+    }
   }
-  if (long_call_time_next_ < std::chrono::high_resolution_clock::now()) {
-    // Disable repeat stack dumps by setting this WAY in the future.
-    long_call_time_next_ =
-        std::chrono::high_resolution_clock::time_point::max();
+  if (watchdog.TakeExpired() && watchdog.IsEnabled()) {
+    Metrics::shared().CountLongCall();
+    // Keep sampling the call until it returns.
+    if (Options::shared().long_call_profile()
+        && &GetCallStack() == main_call_stack_) {
+      long_call_profiling_ = true;
+      long_call_next_sample_ = fastclock::Now();
+      long_call_samples_.clear();
+    }
+    if (&GetCallStack() == main_call_stack_) {
+      long_call_pending_ = true;
+    }
+    long long duration = watchdog.GetCallDuration().count();
+    long long native_time = watchdog.GetCallNativeTime().count();
+    std::vector<std::pair<std::string, int64_t>> modules;
+    GetLongCallModuleTimes(modules);
+    if (IsJSONLog()) {
+      JSONWriter json;
+      BeginJSONEvent(json, "long_call");
+      const AMXCallStack &call_stack = GetCallStack();
+      if (!call_stack.IsEmpty()) {
+        if (CrashDetect *handler = GetHandler(call_stack.Top().amx())) {
+          json.Field("script", handler->amx_name_);
+        }
+      }
+      json.Field("duration", duration);
+      json.Field("script_time", duration - native_time);
+      json.Field("native_time", native_time);
+      json.Field("limit",
+                 static_cast<long long>(watchdog.GetThreadTimeLimit().count()));
+      json.Key("native_modules");
+      json.BeginArray();
+      for (std::size_t i = 0; i < modules.size(); i++) {
+        json.BeginObject();
+        json.Field("module", modules[i].first);
+        json.Field("time", static_cast<long long>(modules[i].second));
+        json.EndObject();
+      }
+      json.EndArray();
+      json.Key("backtrace");
+      WriteAMXBacktrace(json);
+      if (FlightRecorder::shared().IsEnabled()) {
+        json.Key("flight_recorder");
+        WriteFlightRecorder(json);
+      }
+      json.EndObject();
+      LogPrintJSON(json.str());
+      return;
+    }
     LogDebugPrint("Long callback execution detected (hang or performance issue)");
-    PrintAMXBacktrace();
+    PrintReportBacktraces();
+    PrintFlightRecorder();
+    // The split is only printed if it decides what the limit applies to,
+    // so that the usual warning stays as it has always been.
+    if (watchdog.GetBudget() != LongCallWatchdog::BUDGET_TOTAL) {
+      LogDebugPrint("Call time so far: %.3f ms (%.3f ms in script, %.3f ms "
+                    "in natives)",
+                    duration / 1000.0,
+                    (duration - native_time) / 1000.0,
+                    native_time / 1000.0);
+      for (std::size_t i = 0; i < modules.size(); i++) {
+        LogDebugPrint("%12.3f ms in natives of %s",
+                      modules[i].second / 1000.0,
+                      modules[i].first.c_str());
+      }
+    }
+  }
+}
+
+// static
+void CrashDetect::SampleLongCall(CrashDetect *handler, cell native_index) {
+  if (&GetCallStack() != main_call_stack_) {
+    return;
+  }
+  int64_t now = fastclock::Now();
+  if (handler == nullptr
+      || now < long_call_next_sample_
+      || long_call_samples_.size() >= kMaxLongCallSamples) {
+    return;
+  }
+  long_call_next_sample_ =
+    now + Options::shared().long_call_profile_interval();
+  long_call_samples_.push_back(ProfileSample());
+  handler->FillProfileSample(long_call_samples_.back(), native_index);
+}
+
+// Prints where the call that has been reported as a long call spent its
+// time from then on. Called when it returns.
+// static
+void CrashDetect::EndLongCallProfile() {
+  long_call_profiling_ = false;
+
+  std::unordered_map<std::string, unsigned int> stacks;
+  std::vector<std::string> frames;
+  for (std::size_t i = 0; i < long_call_samples_.size(); i++) {
+    frames.clear();
+    ResolveProfileSample(long_call_samples_[i], frames);
+    std::string stack;
+    for (std::size_t j = 0; j < frames.size(); j++) {
+      if (j > 0) {
+        stack += ';';
+      }
+      stack += frames[j];
+    }
+    stacks[stack]++;
+  }
+  std::vector<std::pair<std::string, unsigned int>> sorted_stacks(
+    stacks.begin(), stacks.end());
+  std::size_t num_shown = std::min(sorted_stacks.size(), kLongCallTopN);
+  std::partial_sort(sorted_stacks.begin(),
+                    sorted_stacks.begin() + num_shown,
+                    sorted_stacks.end(),
+                    [](const std::pair<std::string, unsigned int> &a,
+                       const std::pair<std::string, unsigned int> &b) {
+                      return a.second > b.second;
+                    });
+
+  std::size_t num_samples = long_call_samples_.size();
+  long long duration = LongCallWatchdog::shared().GetCallDuration().count();
+  long long native_time =
+    LongCallWatchdog::shared().GetCallNativeTime().count();
+  long_call_samples_.clear();
+
+  if (IsJSONLog()) {
+    JSONWriter json;
+    BeginJSONEvent(json, "long_call_profile");
+    json.Field("duration", duration);
+    json.Field("script_time", duration - native_time);
+    json.Field("native_time", native_time);
+    json.Field("samples", static_cast<long long>(num_samples));
+    json.Key("stacks");
+    json.BeginArray();
+    for (std::size_t i = 0; i < num_shown; i++) {
+      json.BeginObject();
+      json.Field("stack", sorted_stacks[i].first);
+      json.Field("samples", static_cast<long long>(sorted_stacks[i].second));
+      json.EndObject();
+    }
+    json.EndArray();
+    json.EndObject();
+    LogPrintJSON(json.str());
+    return;
+  }
+
+  LogDebugPrint("Long call returned after %.3f ms (%.3f ms in script, "
+                "%.3f ms in natives), %u samples since it was reported:",
+                duration / 1000.0,
+                (duration - native_time) / 1000.0,
+                native_time / 1000.0,
+                static_cast<unsigned int>(num_samples));
+  for (std::size_t i = 0; i < num_shown; i++) {
+    LogDebugPrint("%6u %5.1f%% %s",
+                  sorted_stacks[i].second,
+                  100.0 * sorted_stacks[i].second / num_samples,
+                  sorted_stacks[i].first.c_str());
+  }
+}
+
+// Runs on the watchdog thread when the current call has been running past
+// the limit and the VM hasn't noticed. Script state can't be safely looked
+// at from here, so there's no backtrace; it's printed once the VM gets
+// control back.
+// static
+void CrashDetect::OnLongCallStuck(std::chrono::microseconds duration) {
+  if (IsJSONLog()) {
+    JSONWriter json;
+    BeginJSONEvent(json, "long_call_stuck");
+    json.Field("duration", static_cast<long long>(duration.count()));
+    json.EndObject();
+    LogPrintJSON(json.str());
+    return;
+  }
+  LogDebugPrint("Long callback execution detected: still running after "
+                "%lld ms, probably stuck in a native function",
+                static_cast<long long>(duration.count() / 1000));
+}
+
+namespace {
+
+struct HangStackTrace {
+  void *frames[kMaxStackFrames];
+  int num_frames;
+  // The server thread's call stack, and the script on top of it once
+  // captured.
+  const AMXCallStack *call_stack;
+  AMX *amx;
+};
+
+HangStackTrace hang_stack_trace;
+
+void CaptureHangStackTrace(const os::Context &context, void *data) {
+  HangStackTrace *trace = static_cast<HangStackTrace *>(data);
+  trace->num_frames = CaptureStackTrace(trace->frames,
+                                        kMaxStackFrames,
+                                        context.native_context());
+  if (trace->call_stack != nullptr && !trace->call_stack->IsEmpty()) {
+    trace->amx = trace->call_stack->Top().amx();
+  }
+}
+
+} // anonymous namespace
+
+// Called on the hang watchdog thread.
+// static
+void CrashDetect::OnHang(std::chrono::microseconds duration) {
+  // The server thread is only stopped while this captures its state, and
+  // may be running scripts again by the time we print anything, so the AMX
+  // backtrace is left to long call checks (see long_call_time).
+  hang_stack_trace.num_frames = 0;
+  hang_stack_trace.call_stack = main_call_stack_;
+  hang_stack_trace.amx = nullptr;
+  bool stopped = os::InspectMainThread(CaptureHangStackTrace,
+                                       &hang_stack_trace);
+
+  // Only compare the pointer: the script may have been unloaded since.
+  std::string script_name;
+  if (stopped && hang_stack_trace.amx != nullptr) {
+    ForEachHandler([&script_name](CrashDetect *handler) {
+      if (handler->amx() == hang_stack_trace.amx) {
+        script_name = handler->amx_name_;
+      }
+    });
+  }
+  if (IsJSONLog()) {
+    JSONWriter json;
+    BeginJSONEvent(json, "hang");
+    json.Field("duration", static_cast<long long>(duration.count()));
+    if (!script_name.empty()) {
+      json.Field("script", script_name);
+    }
+    json.Key("native_backtrace");
+    WriteNativeBacktrace(json,
+                         hang_stack_trace.frames,
+                         hang_stack_trace.num_frames);
+    json.EndObject();
+    LogPrintJSON(json.str());
+    return;
+  }
+  if (!script_name.empty()) {
+    LogDebugPrint("Server thread hasn't responded for %lld seconds, "
+                  "executing %s",
+                  static_cast<long long>(duration.count() / 1000000),
+                  script_name.c_str());
+  } else {
+    LogDebugPrint("Server thread hasn't responded for %lld seconds",
+                  static_cast<long long>(duration.count() / 1000000));
+  }
+  if (stopped) {
+    PrintNativeBacktrace(hang_stack_trace.frames, hang_stack_trace.num_frames);
+  } else {
+    LogDebugPrint("Could not get the native backtrace of the server thread");
+  }
+}
+
+// static
+void CrashDetect::OnHangRecover(std::chrono::microseconds duration) {
+  if (IsJSONLog()) {
+    JSONWriter json;
+    BeginJSONEvent(json, "hang_recover");
+    json.Field("duration", static_cast<long long>(duration.count()));
+    json.EndObject();
+    LogPrintJSON(json.str());
+    return;
   }
+  LogDebugPrint("Server thread is responding again after %lld seconds",
+                static_cast<long long>(duration.count() / 1000000));
 }
@@ -25,21 +25,40 @@
 #ifndef CRASHDETECT_H
 #define CRASHDETECT_H
 
+#include <atomic>
 #include <cstdarg>
 #include <cstdio>
 #include <cstdio>
 #include <chrono>
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <amx/amxjit.h>
 #include "amxcallstack.h"
 #include "amxdebuginfo.h"
+#include "amxdisassembler.h"
+#include "amxfunctiontable.h"
 #include "amxhandler.h"
+#include "amxintegritychecker.h"
 #include "amxref.h"
+#include "amxstacktrace.h"
+#include "arena.h"
+#include "flightrecorder.h"
+#include "latencyhistogram.h"
+#include "os.h"
+#include "profiler.h"
 #include "regexp.h"
+#include "topkcounter.h"
+#include "tracebuffer.h"
+#include "tracesampler.h"
 
-class AMXStackFrame;
-
-namespace os {
-  class Context;
-}
+class JSONWriter;
+struct NativeSignature;
+class StatsSegment;
+struct SymbolizedFrame;
 
 class CrashDetect: public AMXHandler<CrashDetect> {
  public:
@@ -48,61 +67,884 @@ class CrashDetect: public AMXHandler<CrashDetect> {
   int Load();
   int Unload();
 
-  int OnDebugHook();
-  int OnCallback(cell index, cell *result, cell *params);
+  // Installs the debug hook and native callback that match the currently
+  // enabled trace features, so that disabled ones cost nothing.
+  void InstallHooks();
+
+  // Print the opcode_counts and block_counts statistics of this script.
+  // Return false if the respective counts aren't being collected.
+  bool PrintOpcodeCounts();
+  bool PrintBlockCounts();
+
+  // Prints the stack_usage statistics of this script. Returns false if
+  // stack_usage is off.
+  bool PrintStackUsage();
+  // Returns the smallest distance between the stack and the heap seen
+  // during the public (in bytes), or -1 if it hasn't run or stack_usage is
+  // off.
+  cell GetStackWatermark(const char *public_name) const;
+
+  // Prints callback_stats for the publics of this script that have taken the
+  // most time. Returns false if callback_stats is off.
+  bool PrintCallbackStats();
+  // Returns the number of calls to the public recorded by callback_stats
+  // and sets the 50th and 99th percentile and maximum of their duration (in
+  // microseconds).
+  cell GetCallbackStats(const char *public_name,
+                        cell &p50,
+                        cell &p99,
+                        cell &max) const;
+
+  // Prints argument_stats for this script: the publics and first arguments
+  // (usually player IDs) that have taken the most time. Returns false if
+  // argument_stats is off.
+  bool PrintArgumentStats();
+  // Returns the time spent in the index-th most expensive public and
+  // first argument pair and sets the rest, or -1 if there are fewer pairs
+  // than that or argument_stats is off.
+  int64_t GetArgumentStats(int index,
+                           std::string &public_name,
+                           cell &argument,
+                           cell &calls) const;
+
+  // Prints the native call sites of this script that have taken the most
+  // time for native_site_stats. Returns false if it's off.
+  bool PrintNativeSiteStats();
+
+  // Prints dispatch_stats for this script: the publics it has run through
+  // natives like CallRemoteFunction() and how many scripts each call
+  // reached, and how often its own publics were called from inside other
+  // calls. Returns false if dispatch_stats is off.
+  bool PrintDispatchStats();
+
+  // Prints file_stats for this script: profiler samples, function calls
+  // and native call time added up by the source file they belong to.
+  // Returns false if it's off or the script has no debug info.
+  bool PrintFileStats();
+
+  // Prints the native call sites of this script that have most often
+  // repeated a call made earlier in the same top-level call, with the same
+  // arguments. Returns false if redundant_natives is off.
+  bool PrintRedundantNatives();
+
+  // Prints timer_stats for the timer publics of this script that have
+  // taken the most time. Returns false if timer_stats is off.
+  bool PrintTimerStats();
+
+  // Prints native_stats for this script: the natives that took the most
+  // time and the total for each plugin that they come from. Returns false
+  // if native_stats is off.
+  bool PrintNativeStats();
+
+  // Writes the profile callgraph data of this script to a callgrind file.
+  // Returns false if it isn't being collected or the file can't be opened.
+  bool WriteCallGraph();
+
+  // Writes the lines of this script that have run so far to a coverage
+  // file. Returns false if coverage is off or the file can't be opened.
+  bool WriteCoverage();
+
+  // Writes how many times each line of this script has run to a file and
+  // prints the busiest lines. Returns false if line_profile is off or the
+  // file can't be opened.
+  bool WriteLineProfile();
+
+  // Prints the places in this script that used the most heap space for
+  // heap_profile. Returns false if heap_profile is off.
+  bool PrintHeapProfile();
+  // Returns the peak heap use (in bytes) of the index-th biggest consumer
+  // and sets location to its file and line, or returns -1 if there are
+  // fewer consumers than that or heap_profile is off.
+  cell GetHeapConsumer(int index, std::string &location) const;
+
+  // Returns how many runtime errors with this code have happened in this
+  // script, or all of them if code is -1.
+  cell GetErrorCount(int code) const;
+  // Returns the number of runtime errors in the function that has had the
+  // index-th most and sets function to its name, or returns -1 if fewer
+  // functions have had errors.
+  cell GetErrorFunction(int index, std::string &function) const;
+
+  // The parts of loading a script that are timed for startup_timing.
+  // LOAD_NATIVES is measured by the caller since natives are registered
+  // after Load().
+  enum LoadStage {
+    LOAD_FIND_PATH,
+    LOAD_DEBUG_INFO,
+    LOAD_SETUP,
+    LOAD_NATIVES,
+    LOAD_STAGE_COUNT
+  };
+  void AddLoadTime(LoadStage stage, int64_t time);
+  // Logs how long each stage of loading this script took, if
+  // startup_timing is on.
+  void PrintLoadTimes() const;
+  // Returns the time spent in the stage (in microseconds) for this script,
+  // or for all scripts loaded so far if total is true. A stage of -1 means
+  // all of the stages together, plus the plugin's own start-up if total is
+  // true. Returns -1 if the stage is invalid.
+  int64_t GetLoadTime(int stage, bool total) const;
+
+  // Sets the long call time limit for calls to the public in microseconds,
+  // overriding long_call_time, or removes it if time is negative. Returns
+  // false if there is no such public.
+  bool SetPublicLongCallTime(const char *public_name, int64_t time);
+
+  // Sets hardware watchpoints on num_cells cells of data starting at
+  // address, one per cell. Returns false if there aren't enough free ones,
+  // if the memory isn't the script's or if this isn't the server thread.
+  bool Watch(cell address, cell num_cells);
+  void Unwatch(cell address, cell num_cells);
+
+  // Appends the per-script metrics (see Metrics) to lines.
+  void WriteMetrics(std::string &lines) const;
+  // Adds this script's entries to the statistics segment (see
+  // StatsSegment).
+  void WriteStats(StatsSegment &stats) const;
+
   int OnExec(cell *retval, int index);
   int OnExecError(int index, cell *retval, int error);
   int OnLongCallRequest(int option, int value);
   int OnAddressNaughtRequest(int option);
+  int OnFunctionRequest(int event);
 
  public:
   static void PluginLoad();
   static void PluginUnload();
 
+  // AMX flags that select the variant of amx_Exec() that scripts run with.
+  // They must be set while the AMX is being relocated.
+  static uint16_t GetExecFlags();
+
+  // The server's amx_Callback(). Scripts whose callback hasn't been
+  // replaced by another plugin get their natives called directly.
+  static void SetVMCallback(AMX_CALLBACK callback);
+
+  // Changes the trace flags and filter of all scripts at runtime.
+  static void SetTrace(const std::string &flags,
+                       const std::vector<std::string> &filter_patterns);
+
+  // Re-reads server.cfg and applies the settings that can be changed
+  // without a restart. Returns false if nothing has changed.
+  static bool ReloadOptions();
+
+  // Control the profiler at runtime, regardless of the profiler setting.
+  // An interval of 0 or an empty filename means the one from server.cfg.
+  // StopProfiler() writes the profile and prints a summary; DumpProfile()
+  // does the same but keeps it running. All of them return false if the
+  // profiler is already running (or isn't, for the other two).
+  static bool StartProfiler(unsigned int interval, const std::string &filename);
+  static bool StopProfiler();
+  static bool DumpProfile();
+
+  // Checks the time that scripts have taken since the last server tick
+  // against tick_budget.
+  static void OnProcessTick();
+
+  // The time it took for the plugin itself to load (in microseconds),
+  // which is added to the total logged by startup_timing.
+  static void SetPluginLoadTime(int64_t time);
+
   static void OnCrash(const os::Context &context);
   static void OnInterrupt(const os::Context &context);
+  static void OnWatch(const os::Context &context, int slot);
+  // Prints the writes recorded by OnWatch() since the last call.
+  static void ReportWatchHits();
+  static bool IsWatchHitPending() {
+    return watch_hit_pending_.load(std::memory_order_relaxed);
+  }
 
   static void PrintAMXBacktrace();
   static void PrintAMXBacktrace(std::ostream &stream);
+  // Same as PrintAMXBacktrace() but only the frames and their arguments are
+  // captured here; they are formatted later by the log thread (see
+  // backtrace_async).
+  static void PrintAMXBacktraceDeferred();
+
+  // A frame of the AMX backtrace as the GetBacktraceFrames() native sees
+  // it. Nothing is looked up by name.
+  struct AMXFrameInfo {
+    cell address;       // the instruction the frame is at (0 for natives)
+    cell function;      // the address of the function (-1 for natives)
+    cell native_index;  // -1 for script functions
+    cell line;          // 1-based, 0 if there's no debug info
+  };
+  // Get the AMX backtrace without the native that is being called (the
+  // natives above only make sense when called from a script).
+  static void GetAMXFrameInfo(std::vector<AMXFrameInfo> &frames);
+  // Gets the name, file and line of the depth-th function in the AMX
+  // backtrace, not counting the native that is being called. Returns false
+  // if the backtrace isn't that deep.
+  static bool GetAMXCallerInfo(std::size_t depth,
+                               std::string &function,
+                               std::string &file,
+                               cell &line);
 
   static void PrintNativeBacktrace(const os::Context &context);
   static void PrintNativeBacktrace(std::ostream &stream,
                                    const os::Context &context);
+  static void PrintNativeBacktrace(std::ostream &stream,
+                                   const std::vector<SymbolizedFrame> &frames);
+  // Captures the return addresses and leaves looking up their names to the
+  // log thread, like PrintAMXBacktraceDeferred().
+  static void PrintNativeBacktraceDeferred(const os::Context &context);
+  // Prints return addresses captured by CaptureStackTrace() without
+  // allocating memory, for the crash handler.
+  static void PrintNativeBacktrace(void *const *frames, int num_frames);
 
  private:
-  static void PrintTraceFrame(const AMXStackFrame &frame,
-                              const AMXDebugInfo &debug_info);
+  // A frame of an AMX backtrace: a native function or a script function,
+  // or (if num_skipped isn't 0) a marker for frames that were left out.
+  struct AMXBacktraceFrame {
+    AMXBacktraceFrame(AMXRef amx, cell native_index)
+      : amx(amx),
+        is_native(true),
+        native_index(native_index),
+        frame(amx, 0),
+        num_skipped(0) {}
+    AMXBacktraceFrame(const AMXStackFrame &frame)
+      : amx(frame.amx()),
+        is_native(false),
+        native_index(-1),
+        frame(frame),
+        num_skipped(0) {}
+    AMXRef amx;
+    bool is_native;
+    cell native_index;
+    AMXStackFrame frame;
+    std::size_t num_skipped;
+  };
+
+  // Arguments of a script function in a backtrace, copied off the stack so
+  // that the frame can be printed after the function has returned.
+  struct AMXBacktraceArguments {
+    cell num_args;
+    cell values[AMXArgumentData::kMaxArgs];
+    AMXArgumentData data;
+  };
+
+  struct DeferredBacktrace {
+    std::vector<AMXBacktraceFrame> frames;
+    std::vector<AMXBacktraceArguments> arguments;
+  };
+
+  // A runtime error that has already been printed in full (see
+  // error_repeat_time). Only the number of repeats is printed from then on.
+  struct RepeatedError {
+    int error;
+    unsigned int count;
+    std::chrono::steady_clock::time_point since;
+    std::string location;
+  };
+
+  // Runtime errors with the same code at the same instruction, counted
+  // for error_throttle.
+  struct ThrottledError {
+    int error;
+    cell cip;
+    unsigned int count;
+    unsigned int dropped;
+    std::chrono::steady_clock::time_point since;
+  };
+
+  // A function or native that is running, for profile callgraph.
+  struct CallGraphFrame {
+    cell function;  // code address, or -1 - index for natives
+    cell frame;
+    cell return_address;
+    int64_t start;
+    int64_t child_time;
+  };
+  struct CallGraphNode {
+    CallGraphNode(): calls(0), inclusive(0), exclusive(0), active(0) {}
+    uint64_t calls;
+    int64_t inclusive;
+    int64_t exclusive;
+    int active;  // how many times it's on the stack (for recursion)
+  };
+  struct CallGraphEdge {
+    CallGraphEdge(): calls(0), time(0) {}
+    uint64_t calls;
+    int64_t time;
+  };
+
+  // Top-level calls of a public during the current server tick.
+  struct TickCall {
+    AMX *amx;
+    cell index;
+    unsigned int calls;
+    int64_t time;
+  };
+
+  // Time spent in a native during the current call on the server thread.
+  struct LongCallNative {
+    AMX *amx;
+    cell index;
+    int64_t time;
+  };
+
+  // An entry of the native table, with the native's trace_mode counts
+  // statistics kept next to it.
+  enum NativeTraceFlags {
+    NATIVE_TRACE_CHECKED = 0x01,
+    NATIVE_TRACE_ON = 0x02,
+    // SetTimer() or SetTimerEx(), for trace t and timer_stats.
+    NATIVE_TRACE_SETS_TIMER = 0x04,
+    // KillTimer(), for timer_stats.
+    NATIVE_TRACE_KILLS_TIMER = 0x08
+  };
+
+  // A running timer for timer_stats. Timers of the same public are ordered
+  // by when they are due, so the one that fires next is the first of them.
+  struct Timer {
+    cell public_index;
+    int64_t interval;  // in microseconds
+    bool repeating;
+    std::multimap<int64_t, cell>::iterator due;
+  };
+  // Native calls made at one place for redundant_natives.
+  struct RedundantNativeSite {
+    cell index;
+    uint32_t calls;
+    uint32_t repeats;
+  };
+
+  // Sampled native calls made at one place for native_site_stats.
+  struct NativeSite {
+    cell index;
+    uint32_t calls;
+    int64_t time;
+  };
+
+  // A native call that may run publics, e.g. CallRemoteFunction(). The
+  // publics add themselves to it while it's on top of the call stack.
+  struct Dispatch {
+    uint32_t num_calls;
+    int64_t call_time;
+    const char *public_name;  // of the first public called
+  };
+
+  // Native calls of this script that ran publics with the same name, for
+  // dispatch_stats. The overhead is the part of the time not spent in the
+  // publics themselves: finding them, pushing arguments, and so on.
+  struct DispatchStats {
+    cell native_index;
+    uint32_t dispatches;
+    uint32_t num_calls;
+    uint32_t max_calls;
+    int64_t time;
+    int64_t call_time;
+  };
+
+  // Calls of a public made while another public was running, by whether
+  // it was called from a native or straight from the outer public (e.g. by
+  // a plugin hooking it).
+  struct NestedCalls {
+    uint32_t native_calls;
+    int64_t native_time;
+    uint32_t public_calls;
+    int64_t public_time;
+  };
+
+  struct TimerPublic {
+    std::multimap<int64_t, cell> due;  // due time -> timer ID
+    LatencyHistogram cost;
+    // How far from the interval the timer has fired.
+    LatencyHistogram jitter;
+  };
+
+  struct NativeSlot {
+    AMX_NATIVE function;
+    uint32_t calls;
+    int64_t time; // in microseconds
+  };
+
+  static int AMXAPI DebugHook(AMX *amx);
+  template<bool TraceNatives>
+  static int AMXAPI Callback(AMX *amx, cell index, cell *result, cell *params);
+  template<bool TraceNatives>
+  static int CallbackWithStats(CrashDetect *handler,
+                               cell index,
+                               cell *result,
+                               cell *params);
+  template<bool TraceNatives>
+  static int CallbackWithCallGraph(CrashDetect *handler,
+                                   cell index,
+                                   cell *result,
+                                   cell *params);
+
+  static cell GetDirectNativeCall(AMXRef amx);
+
+  void FillProfileSample(ProfileSample &sample, cell native_index) const;
+  void TakeProfileSample(cell native_index);
+  static void ResolveProfileSample(const ProfileSample &sample,
+                                   std::vector<std::string> &frames);
+
+  void UpdateCallGraph();
+  void PushCallGraphFrame(cell function, cell frame, cell return_address);
+  void PopCallGraphFrame();
+  void GetCallGraphName(cell function,
+                        std::string &file_name,
+                        std::string &name) const;
+
+  void InitCallbackStats();
+  void InitArgumentStats();
+
+  void InitStackUsage();
+  void PrintStackRecommendation(cell total, cell peak) const;
+  void SampleStackSpace();
+
+  void UpdateCoverage();
+  void CountLine();
+
+  void SampleHeap();
+  void GetHeapSites(std::vector<cell> &sites) const;
+  // Returns file:line of the address, or just the address if the script
+  // has no debug info.
+  std::string GetCodeLocation(cell address) const;
+
+  void CheckRedundantNativeCall(cell index, const cell *params);
+  void AddNativeSiteTime(cell index, cell cip, int64_t time);
+  void AddDispatch(cell index, const Dispatch &dispatch, int64_t time);
+
+  void InitNatives();
+  void WritePerfMap();
+  int CallNative(cell index, cell *result, cell *params);
+  int CallNativeTimed(cell index, cell *result, cell *params);
+  void ResetNativeCounts();
+  void PatchSysreqD(cell index, AMX_NATIVE native);
+
+  int OnDebugHook();
+  template<bool TraceNatives>
+  int OnCallback(cell index, cell *result, cell *params);
+
+  void PrintTraceFrame(TraceRecord::Kind kind, const AMXStackFrame &frame);
+  void PrintNativeTrace(cell index,
+                        const cell *values,
+                        cell num_args,
+                        const AMXArgumentData *data) const;
+
+  void PushTraceRecord(TraceRecord::Kind kind,
+                       cell index,
+                       const AMXStackFrame &frame);
+  void PushNativeTraceRecord(cell index,
+                             const cell *params,
+                             cell retval,
+                             int64_t start_time);
+  void PushReturnTraceRecord(cell index);
+
+  static void InitLongCallChecks();
+  void InitScriptLongCallTime();
+  int64_t GetCallTimeLimit(const AMXCall &call) const;
+  static void StartTraceOutput();
+  void InitTrace();
+  void InitTraceFilter();
+  unsigned char GetNativeTraceFlags(cell index);
+  const NativeSignature *GetNativeSignature(cell index) const;
+  bool IsNativeTraced(cell index);
+  bool IsPublicTraced(cell index) const;
+  void AddTimerPublic(const cell *params);
+  void AddTimer(const cell *params, cell id);
+  void RemoveTimer(cell id);
+  TimerPublic *FireTimer(cell index);
+  bool IsFunctionTraced(const AMXStackFrame &frame);
+  bool IsFileTraced(cell address) const;
+  void InitTraceSampler();
+  bool SampleFunctionCall();
+  void TraceFunctionCall();
+  void HandleRconCommand();
+  void InitTraceCounts();
+  void CountFunctionCall();
+  void PrintTraceCounts();
+  void InitExecCounts();
+  static void FormatTraceRecord(const TraceRecord &record);
+  static void WriteTraceRecord(const TraceRecord &record);
+  static void WriteChromeTraceRecord(const TraceRecord &record);
+  static std::vector<std::string> GetRuntimeErrorDetails(
+    AMXRef amx,
+    const AMX &amx_state,
+    int error);
   static void PrintRuntimeError(AMXRef amx, const AMX &amx_state, int error);
+  // Instructions around CIP for runtime error and crash reports (see
+  // disasm_instructions), empty if turned off.
+  std::vector<std::string> GetDisassembly(cell cip);
+  static void PrintDisassembly(const std::vector<std::string> &disassembly);
+  static void WriteDisassembly(JSONWriter &json,
+                               const std::vector<std::string> &disassembly);
   static void PrintRegisters(const os::Context &context);
-  static void PrintStack(const os::Context &context);
+  static void PrintStack(const os::Context &context,
+                         const CrashDetect *instance);
+  std::size_t DescribeCodeAddress(char *buffer,
+                                  std::size_t size,
+                                  uint32_t address) const;
   static void PrintLoadedModules();
+
+  // Used for crashdetect_log_format jsonl (see also PrintAMXBacktrace()
+  // and friends, which write JSON in that case).
+  // If full is true, backtrace_head and backtrace_tail are ignored.
+  static void GetAMXBacktrace(std::vector<AMXBacktraceFrame> &frames,
+                              bool full = false);
+  static void WriteAMXBacktrace(JSONWriter &json);
+  // Format a backtrace captured earlier with GetAMXBacktrace(). The script
+  // stack must still be where it was (only the registers may change),
+  // unless the arguments of the frames have been captured as well.
+  static void PrintAMXBacktrace(
+    std::ostream &stream,
+    const std::vector<AMXBacktraceFrame> &frames,
+    const std::vector<AMXBacktraceArguments> *arguments = nullptr);
+  static void PrintAMXBacktraceDeferred(
+    const std::vector<AMXBacktraceFrame> &frames);
+  // Print the AMX backtrace, and the native one if there's a context, for
+  // one of our own reports. With backtrace_async this is deferred like
+  // PrintBacktrace().
+  static void PrintReportBacktraces(const os::Context *context = nullptr);
+  static void WriteAMXBacktrace(JSONWriter &json,
+                                const std::vector<AMXBacktraceFrame> &frames);
+  static void WriteNativeBacktrace(JSONWriter &json,
+                                   const os::Context &context);
+  static void WriteNativeBacktrace(JSONWriter &json,
+                                   const std::vector<SymbolizedFrame> &frames);
+  // For the crash and hang handlers.
+  static void WriteNativeBacktrace(JSONWriter &json,
+                                   void *const *trace,
+                                   int length);
+  static void WriteRegisters(JSONWriter &json, const os::Context &context);
+  static void WriteLoadedModules(JSONWriter &json);
+  // Print or write the calls and returns kept by the flight recorder,
+  // oldest first. Nothing is printed if it's off.
+  static void PrintFlightRecorder();
+  static void WriteFlightRecorder(JSONWriter &json);
+  static void GetFlightRecorderEventInfo(const FlightRecorder::Event &event,
+                                         const char *&action,
+                                         const char *&name,
+                                         const char *&script);
+  static const char *GetScriptPath(AMX *amx);
+  uint64_t GetErrorFingerprint(int error) const;
+  bool IsRepeatedError(uint64_t fingerprint);
+  void AddRepeatedError(uint64_t fingerprint,
+                        int error,
+                        const std::string &location);
+  std::string GetErrorLocation();
+  AMXStackFrame GetErrorFrame();
+  void PrintRepeatedError(const RepeatedError &repeated_error);
+  bool IsThrottledError(int error);
+  void PrintThrottledError(const ThrottledError &throttled_error);
+  cell CallOnRuntimeError(cell *retval, int error);
+  void CallOnLongCall(int index, std::chrono::microseconds duration);
+  static void WriteRuntimeError(const std::string &script,
+                                AMXRef amx,
+                                const AMX &amx_state,
+                                int error,
+                                const std::vector<std::string> &disassembly,
+                                const std::string *backtrace);
+  static std::string FormatRuntimeError(
+    const std::string &script,
+    AMXRef amx,
+    const AMX &amx_state,
+    int error,
+    const std::vector<std::string> &disassembly,
+    const std::string *backtrace,
+    uint64_t fingerprint);
+  static AMXCallStack &GetCallStack() {
+    if (call_stack_ == nullptr) {
+      call_stack_ = CreateCallStack();
+    }
+    return *call_stack_;
+  }
+  static AMXCallStack *CreateCallStack();
   static void Push(AMXCall call);
   static AMXCall Pop();
 
+  static void EndTickCall(const AMXCall &call);
+
+  // Runs integrity_check on each script until the deadline (fastclock
+  // time) passes, but checks at least one block of each.
+  static void CheckIntegrity(int64_t deadline);
+  void CheckScriptIntegrity(int64_t deadline);
+  void ReportCorruption(const char *what, cell start, cell end);
+
+  // Adds time spent in the native to its module's share of the current
+  // call, see GetLongCallModuleTimes().
+  static void AddLongCallNativeTime(const AMXCall &call, int64_t time);
+  // Native time of the current call by module, highest first. Only known
+  // for calls on the server thread.
+  static void GetLongCallModuleTimes(
+    std::vector<std::pair<std::string, int64_t>> &modules);
+  static void RunIdleJobs();
+  static void PrintTickReport();
+
+  // Logs the total loading time of the scripts loaded before the first
+  // server tick.
+  static void PrintStartupTimes();
+
+  // Rewrites the statistics segment, if stats_segment is on.
+  static void UpdateStats();
+
   static void SetLongCallTime(unsigned int time);
   static unsigned int LongCallOption(int option);
   static void CheckLongCallTime(void);
+  static void SampleLongCall(CrashDetect *handler, cell native_index);
+  static void EndLongCallProfile();
+  static void OnLongCallStuck(std::chrono::microseconds duration);
+  static void OnHang(std::chrono::microseconds duration);
+  static void OnHangRecover(std::chrono::microseconds duration);
 
  private:
   CrashDetect(AMX *amx);
 
  private:
   AMXRef amx_;
-  AMXDebugInfo debug_info_;
+  // Backs the per-script counters below that only grow while the script is
+  // loaded, so that they're freed all at once when it's unloaded. Must be
+  // declared before them.
+  Arena arena_;
+  std::shared_ptr<AMXDebugInfo> debug_info_;
+  // Set if the script has debug info, which may not be loaded yet (see
+  // debug_info_lazy).
+  bool has_debug_info_;
+  AMXStackFrameCache frame_cache_;
+  // Built in Load(), so that publics and natives can be found without
+  // scanning the AMX header.
+  mutable AMXFunctionTable functions_;
+  // Used only by FormatTraceRecord() which runs on the trace buffer thread.
+  AMXStackFrameCache trace_frame_cache_;
+  // Used only for backtraces formatted by the log thread.
+  AMXStackFrameCache backtrace_frame_cache_;
+  // The stack as of the last profile sample, and the public it was taken
+  // in (see FillProfileSample()).
+  mutable AMXStackWalkCache profile_walk_cache_;
+  mutable cell profile_walk_public_;
   AMX_DEBUG prev_debug_;
   AMX_CALLBACK prev_callback_;
+  // Natives of the script indexed by native index, filled in as they are
+  // registered. Used instead of prev_callback_ if call_natives_directly_
+  // is set.
+  std::vector<NativeSlot> natives_;
+  bool call_natives_directly_;
+  std::chrono::steady_clock::time_point native_stats_next_print_;
+  // Native code of the script if the jit option is on and it compiled.
+  AMX_JIT *jit_;
+  // Created on the first runtime error or crash.
+  std::unique_ptr<AMXDisassembler> disassembler_;
   cell last_frame_;
+  // Set if function tracing and the call graph are driven by the VM's
+  // function entry and return events (see OnFunctionRequest()) rather than
+  // the debug hook.
+  bool function_hook_;
   std::string amx_path_;
   std::string amx_name_;
   bool block_exec_errors_;
   bool address_naught_;
+  uint32_t trace_script_id_;
+  // The trace flags of this script, which may differ from the global ones
+  // (see Options::GetScriptTraceFlags()).
+  unsigned int trace_flags_;
+  // The script's own long_call_time in microseconds, or -1.
+  int64_t script_long_call_time_;
+  // Time limits set with SetPublicLongCallTime(), indexed by public index
+  // plus one (for main()), or -1. Empty if there are none.
+  std::vector<int64_t> public_long_call_times_;
+  // What to do on each native call (NativeTraceFlags), decided on the
+  // first call because the native may not be registered before that.
+  // Empty unless natives or timers are traced.
+  std::vector<unsigned char> native_trace_table_;
+  // The signature of each native from trace_native_signatures, or nullptr.
+  // Set up when the script is loaded and read by the trace formatter.
+  std::vector<const NativeSignature *> native_signatures_;
+  // Whether each public is traced, indexed by public index plus one (for
+  // main()). Timer callbacks are added as timers are set. Empty unless
+  // publics or timers are traced.
+  std::vector<bool> public_trace_table_;
+  // Results of trace_filter (if it only looks at names) and trace_files
+  // for each function address: 0 = not tested yet, 1 = traced, 2 =
+  // filtered out. Empty if there's nothing to check.
+  std::vector<unsigned char> function_trace_filter_;
+  // Used for trace_sample and trace_rate, indexed by native index, public
+  // index and function code slot respectively.
+  TraceSampler native_trace_sampler_;
+  TraceSampler public_trace_sampler_;
+  TraceSampler function_trace_sampler_;
+  // Call counts for trace_mode counts, indexed by public index and debug
+  // info function index respectively (natives are counted in natives_).
+  std::vector<uint32_t> public_call_counts_;
+  std::vector<uint32_t> function_call_counts_;
+  std::chrono::steady_clock::time_point trace_counts_start_;
+  std::chrono::steady_clock::time_point trace_counts_next_print_;
+  // How many times each opcode has run, indexed by opcode (including
+  // superinstructions), and how many times each address has been jumped
+  // to or called, indexed by CIP / sizeof(cell). Empty unless the script
+  // runs in the counting VM and opcode_counts / block_counts is on.
+  std::vector<uint64_t> opcode_counts_;
+  std::vector<uint64_t> target_counts_;
+  AMX_EXEC_COUNTS exec_counts_;
+  // Smallest STK - HEA seen during each public for stack_usage, indexed by
+  // public index + 1 (0 is main). Empty if stack_usage is off.
+  std::vector<cell> stack_space_;
+  // Index of stack_space_ for the outermost public that is running in this
+  // script, or -1.
+  int stack_usage_slot_;
+  std::chrono::steady_clock::time_point stack_usage_next_print_;
+  // How long each public takes for callback_stats, indexed by public index
+  // + 1 (0 is main). The histograms are created on first call. Empty if
+  // callback_stats is off.
+  std::vector<std::unique_ptr<LatencyHistogram>> callback_stats_;
+  // The part of the total time of each public that was spent in natives.
+  std::vector<int64_t> callback_native_time_;
+  // Checks that the header and code of the script stay the same, for
+  // integrity_check. Null if it's off. The registers are only reported
+  // once, while they stay broken.
+  std::unique_ptr<AMXIntegrityChecker> integrity_checker_;
+  bool bad_registers_reported_;
+  // Time spent in publics by public index and first argument, for
+  // argument_stats. Null if it's off.
+  std::unique_ptr<TopKCounter> argument_stats_;
+  std::chrono::steady_clock::time_point argument_stats_next_print_;
+  // For redundant_natives: the hashes of the native calls (index and
+  // arguments) seen in sampled top-level calls, mapped to the number of
+  // the top-level call, and how many calls at each call site were repeats.
+  // One in redundant_natives_ top-level calls is sampled.
+  unsigned int redundant_natives_;
+  bool redundant_natives_sampled_;
+  uint32_t redundant_natives_call_;
+  std::unordered_map<uint64_t, uint32_t> native_call_hashes_;
+  ArenaHashMap<cell, RedundantNativeSite> redundant_native_sites_;
+  // Native calls timed for native_site_stats by the CIP they were made
+  // from, one in native_site_stats_ calls.
+  unsigned int native_site_stats_;
+  unsigned int native_site_counter_;
+  ArenaHashMap<cell, NativeSite> native_sites_;
+  // For dispatch_stats: dispatches made by this script by the name of the
+  // public they ran, and nested calls of its publics by public index.
+  bool dispatch_stats_;
+  std::unordered_map<std::string, DispatchStats> dispatches_;
+  std::vector<NestedCalls> nested_calls_;
+  // Timers started by this script by their IDs, and how the ones of each
+  // public have done, for timer_stats.
+  bool timer_stats_;
+  std::unordered_map<cell, Timer> timers_;
+  std::unordered_map<cell, TimerPublic> timer_publics_;
+  std::chrono::steady_clock::time_point callback_stats_next_print_;
+  // Data for profile callgraph, which is only collected if the script has
+  // debug info. Functions are detected by the debug hook (or the VM's
+  // function entry and return events) as their frames appear and
+  // disappear. Frames below callgraph_base_ belong to outer publics (and
+  // the natives that called them). Edges are keyed by caller << 32 | callee.
+  bool callgraph_;
+  std::vector<CallGraphFrame> callgraph_stack_;
+  std::size_t callgraph_base_;
+  cell callgraph_public_;
+  ArenaHashMap<cell, CallGraphNode> callgraph_nodes_;
+  ArenaHashMap<uint64_t, CallGraphEdge> callgraph_edges_;
+  // Largest amount of heap space in use (relative to the start of the
+  // outermost public) seen at each instruction for heap_profile, and in
+  // how many outermost public calls it was in use there at all. HEA is
+  // sampled on each line (if there's debug info) and native call.
+  struct HeapSite {
+    cell peak;
+    uint32_t calls;
+    uint32_t last_call;
+  };
+  bool heap_profile_;
+  // HEA at the start of the outermost public running in this script, or -1.
+  cell heap_base_;
+  uint32_t heap_call_;
+  ArenaHashMap<cell, HeapSite> heap_sites_;
+  // Lines that have run at least once for coverage, one bit per entry in
+  // the line index of the debug info. coverage_cips_ has a bit per code
+  // cell, so that the debug hook only looks up each address once.
+  bool coverage_;
+  std::vector<uint32_t> coverage_cips_;
+  std::vector<uint32_t> coverage_lines_;
+  // How many times each entry in the line index has run for line_profile.
+  // The counts stop at the maximum instead of wrapping around.
+  bool line_profile_;
+  std::vector<uint32_t> line_counts_;
+  // Profiler samples by the innermost function they were taken in, for
+  // file_stats. Calls and native time come from profile callgraph and
+  // native_site_stats; they're all mapped to files when printed.
+  bool file_stats_;
+  ArenaHashMap<cell, uint64_t> file_stats_samples_;
+  int64_t load_times_[LOAD_STAGE_COUNT];
+  // Runtime errors seen in the last error_repeat_time seconds, keyed by
+  // GetErrorFingerprint().
+  std::unordered_map<uint64_t, RepeatedError> repeated_errors_;
+  // Runtime errors by code and by the address of the function where they
+  // happened, whether they're printed or not.
+  ArenaHashMap<int, uint32_t> error_counts_;
+  ArenaHashMap<cell, uint32_t> error_functions_;
+  // Runtime errors counted by error_throttle, keyed by code and CIP.
+  std::unordered_map<uint64_t, ThrottledError> throttled_errors_;
 
  private:
-  static AMXCallStack call_stack_;
+  // Scripts may be run from other threads by some plugins, so each thread
+  // has its own call stack, which is freed when the thread exits.
+  // call_stack_ is normally the thread's own stack, but the interrupt
+  // handler borrows the server thread's.
+  static thread_local AMXCallStack *call_stack_;
+  static thread_local std::unique_ptr<AMXCallStack> own_call_stack_;
+  // The stack of the thread that loaded the plugin, i.e. the server thread.
+  static AMXCallStack *main_call_stack_;
   static unsigned int long_call_time_;
-  static std::chrono::microseconds long_call_time_current_;
-  static std::chrono::high_resolution_clock::time_point long_call_time_next_;
-  static bool long_call_time_running_;
+  // Whether long_call_time is non-zero for the server or any script.
+  static bool long_call_checks_;
+  // Whether the time limit has to be set for each top-level call, because
+  // some script or public has its own.
+  static bool call_time_limits_;
+  // Whether time spent in natives is tracked separately, for long call
+  // checks and callback_stats.
+  static bool track_native_time_;
+  static std::vector<LongCallNative> long_call_natives_;
+  // The innermost native call of this thread being watched for dispatches,
+  // or null.
+  static thread_local Dispatch *dispatch_;
+  static AMX_CALLBACK vm_callback_;
+  // For tick_budget, only updated on the server thread. Calls are keyed by
+  // the AMX and public index.
+  static int64_t tick_call_start_;
+  static int64_t tick_time_;
+  static std::unordered_map<uint64_t, TickCall> tick_calls_;
+  static unsigned int ticks_over_budget_;
+  static int64_t last_tick_report_;
+  // When the statistics segment is due to be updated next.
+  static int64_t stats_next_update_;
+  // Server ticks since the plugin was loaded.
+  static uint64_t tick_count_;
+
+  static int64_t plugin_load_time_;
+  static int64_t startup_times_[LOAD_STAGE_COUNT];
+  static unsigned int startup_scripts_;
+  static bool startup_done_;
+  // Samples of the current call for long_call_profile, taken after it has
+  // been reported as a long call. Only used on the server thread.
+  static bool long_call_profiling_;
+  static int64_t long_call_next_sample_;
+  static std::vector<ProfileSample> long_call_samples_;
+  // Set when the current call on the server thread has been reported as a
+  // long call, so that OnCrashDetectLongCall is called once it returns.
+  static bool long_call_pending_;
+  static std::atomic<uint32_t> next_trace_script_id_;
+  // Set by CrashDetectWatch() on the server thread, by slot. amx is null if
+  // the slot is free. data points to the watched cell so that OnWatch()
+  // doesn't have to look up the script.
+  struct Watchpoint {
+    AMX *amx;
+    cell address;
+    const cell *data;
+  };
+  static Watchpoint watchpoints_[os::kNumWatchpoints];
+  // Filled in by OnWatch(), which runs in a signal (or exception) handler
+  // and can't print anything, and reported by ReportWatchHits() at the next
+  // native call, long call check or server tick. writes is the number of
+  // writes since the last report, 0 if there's nothing to report.
+  struct WatchHit {
+    std::atomic<uint32_t> writes;
+    AMX *amx;
+    cell address;
+    cell value;
+    uint32_t code_address;
+  };
+  static WatchHit watch_hits_[os::kNumWatchpoints];
+  static std::atomic<bool> watch_hit_pending_;
 };
 
 #endif // !CRASHDETECT_H
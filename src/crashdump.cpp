@@ -0,0 +1,372 @@
+// Copyright (c) 2026 Zeex
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <vector>
+#ifdef _WIN32
+  #include <io.h>
+  #include <fcntl.h>
+  #include <process.h>
+  #include <sys/stat.h>
+#else
+  #include <fcntl.h>
+  #include <unistd.h>
+#endif
+#include "amxcallstack.h"
+#include "crashdump.h"
+#include "moduletable.h"
+#include "os.h"
+
+// File format (all integers are little-endian):
+//
+//   header:  "CDCD", u8 version, u8 cell size, i64 time of the crash (Unix
+//            time)
+//
+// followed by sections until the end of the file, each of which starts with
+// a u32 type and a u32 size of the data that follows:
+//
+//   0x01 registers:  u32 x 10 (eax, ebx, ecx, edx, esi, edi, ebp, esp, eip,
+//                    eflags)
+//   0x02 native backtrace:  u32 number of frames, u32 return address x n
+//   0x03 native stack:  u32 address (the value of esp), bytes
+//   0x04 modules:  u32 number of modules, then for each one u32 base
+//                  address, u32 size, u16 path length, path
+//   0x05 script:  u32 id, u16 path length, path, u32 header size, AMX
+//                 header, i32 cip, frm, stk, hea, hlw, stp,
+//                 u32 heap size, heap (starting at hlw),
+//                 u32 stack size, stack (starting at stk)
+//   0x06 AMX call stack:  u32 number of calls, then for each one starting
+//                         with the most recent: u8 type (0 = native,
+//                         1 = public), u32 script id, i32 index, i32 frm,
+//                         i32 cip
+//
+// Unreadable memory in the native stack, heap and stack sections is
+// replaced with zeros.
+
+namespace {
+
+const unsigned char kMagic[4] = {'C', 'D', 'C', 'D'};
+const unsigned char kVersion = 1;
+
+enum SectionType {
+  SECTION_REGISTERS = 0x01,
+  SECTION_NATIVE_BACKTRACE = 0x02,
+  SECTION_NATIVE_STACK = 0x03,
+  SECTION_MODULES = 0x04,
+  SECTION_SCRIPT = 0x05,
+  SECTION_CALL_STACK = 0x06
+};
+
+// Scripts running in a crazy number of nested calls aren't all worth
+// dumping.
+const std::size_t kMaxScripts = 32;
+const std::size_t kMaxCalls = 256;
+
+// Limits the size of the heap and stack of a single script in the dump.
+const std::size_t kMaxRegionSize = 1024 * 1024;
+
+const std::size_t kMaxPathLength = 1024;
+
+std::size_t GetPathLength(const char *path) {
+  return path != nullptr ? std::min(std::strlen(path), kMaxPathLength) : 0;
+}
+
+} // anonymous namespace
+
+CrashDump::CrashDump()
+  : fd_(-1),
+    failed_(false),
+    size_(0)
+{
+  path_[0] = '\0';
+}
+
+void CrashDump::SetDirectory(const std::string &directory) {
+  directory_ = directory;
+}
+
+const char *CrashDump::Write(const os::Context &context,
+                             void *const *frames,
+                             int num_frames,
+                             const AMXCallStack &call_stack,
+                             const char *(*get_script_path)(AMX *amx)) {
+  if (directory_.empty()) {
+    return nullptr;
+  }
+
+  std::time_t now = std::time(nullptr);
+  #ifdef _WIN32
+    int pid = _getpid();
+  #else
+    int pid = static_cast<int>(getpid());
+  #endif
+  std::snprintf(path_, sizeof(path_), "%s/crashdetect-%ld-%d.dump",
+                directory_.c_str(),
+                static_cast<long>(now),
+                pid);
+  #ifdef _WIN32
+    fd_ = _open(path_,
+                _O_WRONLY | _O_CREAT | _O_TRUNC | _O_BINARY,
+                _S_IREAD | _S_IWRITE);
+  #else
+    fd_ = open(path_, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  #endif
+  if (fd_ < 0) {
+    return nullptr;
+  }
+  failed_ = false;
+  size_ = 0;
+
+  PutData(kMagic, sizeof(kMagic));
+  PutUInt8(kVersion);
+  PutUInt8(sizeof(cell));
+  PutInt64(static_cast<int64_t>(now));
+
+  os::Context::Registers registers = context.GetRegisters();
+  BeginSection(SECTION_REGISTERS, 10 * 4);
+  PutUInt32(registers.eax);
+  PutUInt32(registers.ebx);
+  PutUInt32(registers.ecx);
+  PutUInt32(registers.edx);
+  PutUInt32(registers.esi);
+  PutUInt32(registers.edi);
+  PutUInt32(registers.ebp);
+  PutUInt32(registers.esp);
+  PutUInt32(registers.eip);
+  PutUInt32(registers.eflags);
+
+  BeginSection(SECTION_NATIVE_BACKTRACE, 4 + num_frames * 4);
+  PutUInt32(static_cast<uint32_t>(num_frames));
+  for (int i = 0; i < num_frames; i++) {
+    PutUInt32(static_cast<uint32_t>(reinterpret_cast<uintptr_t>(frames[i])));
+  }
+
+  if (registers.esp != 0) {
+    std::size_t stack_size = os::ReadMemory(
+      native_stack_,
+      reinterpret_cast<const void *>(static_cast<uintptr_t>(registers.esp)),
+      kNativeStackSize);
+    BeginSection(SECTION_NATIVE_STACK, 4 + stack_size);
+    PutUInt32(registers.esp);
+    PutData(native_stack_, stack_size);
+  }
+
+  ModuleTable::shared().VisitModules(
+    [this](const std::vector<os::Module> &modules) {
+      std::size_t size = 4;
+      for (std::size_t i = 0; i < modules.size(); i++) {
+        size += 4 + 4 + 2 + GetPathLength(modules[i].name().c_str());
+      }
+      BeginSection(SECTION_MODULES, size);
+      PutUInt32(static_cast<uint32_t>(modules.size()));
+      for (std::size_t i = 0; i < modules.size(); i++) {
+        const char *name = modules[i].name().c_str();
+        PutUInt32(modules[i].base_address());
+        PutUInt32(modules[i].size());
+        PutString(name, GetPathLength(name));
+      }
+    });
+
+  // Each script is dumped once, however many times it appears in the call
+  // stack.
+  AMX *scripts[kMaxScripts];
+  std::size_t num_scripts = 0;
+  std::size_t num_calls = 0;
+  for (AMXCallStack::const_iterator it = call_stack.begin();
+       it != call_stack.end() && num_calls < kMaxCalls; ++it, num_calls++) {
+    AMX *amx = it->amx();
+    if (std::find(scripts, scripts + num_scripts, amx)
+          == scripts + num_scripts
+        && num_scripts < kMaxScripts) {
+      scripts[num_scripts++] = amx;
+    }
+  }
+  for (std::size_t i = 0; i < num_scripts; i++) {
+    WriteScript(static_cast<uint32_t>(i),
+                scripts[i],
+                get_script_path(scripts[i]));
+  }
+
+  BeginSection(SECTION_CALL_STACK, 4 + num_calls * (1 + 4 * 4));
+  PutUInt32(static_cast<uint32_t>(num_calls));
+  std::size_t call_index = 0;
+  for (AMXCallStack::const_iterator it = call_stack.begin();
+       it != call_stack.end() && call_index < num_calls;
+       ++it, call_index++) {
+    AMX *amx = it->amx();
+    std::size_t id = std::find(scripts, scripts + num_scripts, amx) - scripts;
+    PutUInt8(it->IsPublic() ? 1 : 0);
+    PutUInt32(id < num_scripts ? static_cast<uint32_t>(id) : UINT32_MAX);
+    PutUInt32(static_cast<uint32_t>(it->index()));
+    PutUInt32(static_cast<uint32_t>(it->frm()));
+    PutUInt32(static_cast<uint32_t>(it->cip()));
+  }
+
+  Flush();
+  #ifdef _WIN32
+    _close(fd_);
+  #else
+    close(fd_);
+  #endif
+  fd_ = -1;
+  return failed_ ? nullptr : path_;
+}
+
+void CrashDump::WriteScript(uint32_t id, AMX *amx, const char *path) {
+  AMX_HEADER header;
+  std::memset(&header, 0, sizeof(header));
+  os::ReadMemory(&header, amx->base, sizeof(header));
+  const unsigned char *data = amx->data != nullptr
+    ? amx->data
+    : amx->base + header.dat;
+
+  // The heap grows up from hlw, the stack grows down from stp, so the
+  // interesting part of the stack is the one closest to stk.
+  std::size_t heap_size = 0;
+  if (amx->hea > amx->hlw) {
+    heap_size = std::min<std::size_t>(amx->hea - amx->hlw, kMaxRegionSize);
+  }
+  std::size_t stack_size = 0;
+  if (amx->stp > amx->stk) {
+    stack_size = std::min<std::size_t>(amx->stp - amx->stk, kMaxRegionSize);
+  }
+
+  std::size_t path_length = GetPathLength(path);
+  BeginSection(SECTION_SCRIPT,
+               4 + 2 + path_length
+               + 4 + sizeof(header)
+               + 6 * 4
+               + 4 + heap_size
+               + 4 + stack_size);
+  PutUInt32(id);
+  PutString(path, path_length);
+  PutUInt32(sizeof(header));
+  PutData(&header, sizeof(header));
+  PutUInt32(static_cast<uint32_t>(amx->cip));
+  PutUInt32(static_cast<uint32_t>(amx->frm));
+  PutUInt32(static_cast<uint32_t>(amx->stk));
+  PutUInt32(static_cast<uint32_t>(amx->hea));
+  PutUInt32(static_cast<uint32_t>(amx->hlw));
+  PutUInt32(static_cast<uint32_t>(amx->stp));
+  PutUInt32(static_cast<uint32_t>(heap_size));
+  PutMemory(data + amx->hlw, heap_size);
+  PutUInt32(static_cast<uint32_t>(stack_size));
+  PutMemory(data + amx->stk, stack_size);
+}
+
+void CrashDump::BeginSection(uint32_t type, std::size_t size) {
+  PutUInt32(type);
+  PutUInt32(static_cast<uint32_t>(size));
+}
+
+void CrashDump::PutData(const void *data, std::size_t size) {
+  const unsigned char *bytes = static_cast<const unsigned char *>(data);
+  while (size > 0) {
+    if (size_ == kBufferSize) {
+      Flush();
+    }
+    std::size_t chunk = std::min(size, kBufferSize - size_);
+    std::memcpy(buffer_ + size_, bytes, chunk);
+    size_ += chunk;
+    bytes += chunk;
+    size -= chunk;
+  }
+}
+
+void CrashDump::PutUInt8(uint8_t value) {
+  PutData(&value, 1);
+}
+
+void CrashDump::PutUInt16(uint16_t value) {
+  unsigned char bytes[2] = {
+    static_cast<unsigned char>(value),
+    static_cast<unsigned char>(value >> 8)
+  };
+  PutData(bytes, sizeof(bytes));
+}
+
+void CrashDump::PutUInt32(uint32_t value) {
+  unsigned char bytes[4];
+  for (int i = 0; i < 4; i++) {
+    bytes[i] = static_cast<unsigned char>(value >> (i * 8));
+  }
+  PutData(bytes, sizeof(bytes));
+}
+
+void CrashDump::PutInt64(int64_t value) {
+  unsigned char bytes[8];
+  for (int i = 0; i < 8; i++) {
+    bytes[i] = static_cast<unsigned char>(static_cast<uint64_t>(value)
+                                          >> (i * 8));
+  }
+  PutData(bytes, sizeof(bytes));
+}
+
+void CrashDump::PutString(const char *string, std::size_t length) {
+  PutUInt16(static_cast<uint16_t>(length));
+  PutData(string, length);
+}
+
+void CrashDump::PutMemory(const void *address, std::size_t size) {
+  const unsigned char *from = static_cast<const unsigned char *>(address);
+  while (size > 0) {
+    if (size_ == kBufferSize) {
+      Flush();
+    }
+    std::size_t chunk = std::min(size, kBufferSize - size_);
+    std::size_t copied = os::ReadMemory(buffer_ + size_, from, chunk);
+    std::memset(buffer_ + size_ + copied, 0, chunk - copied);
+    size_ += chunk;
+    from += chunk;
+    size -= chunk;
+  }
+}
+
+void CrashDump::Flush() {
+  const unsigned char *data = buffer_;
+  std::size_t size = size_;
+  while (size > 0 && !failed_) {
+    #ifdef _WIN32
+      int result = _write(fd_, data, static_cast<unsigned int>(size));
+    #else
+      ssize_t result = write(fd_, data, size);
+    #endif
+    if (result <= 0) {
+      failed_ = true;
+      break;
+    }
+    data += result;
+    size -= static_cast<std::size_t>(result);
+  }
+  size_ = 0;
+}
+
+// static
+CrashDump &CrashDump::shared() {
+  static CrashDump instance;
+  return instance;
+}
@@ -0,0 +1,98 @@
+// Copyright (c) 2026 Zeex
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef CRASHDUMP_H
+#define CRASHDUMP_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <amx/amx.h>
+
+namespace os {
+  class Context;
+}
+
+class AMXCallStack;
+
+// Writes a binary snapshot of the state of the server when it crashes (see
+// the crash_dump option): registers, the native stack and backtrace,
+// loaded modules, the AMX call stack and the stack and heap of each script
+// on it. It's meant to be decoded offline with tools/decodecrash.py.
+//
+// Everything that needs memory is set up beforehand, so writing a dump
+// doesn't allocate and does little more than a few write() calls.
+class CrashDump {
+ public:
+  // Dumps are named crashdetect-<time>-<pid>.dump. An empty directory
+  // turns them off.
+  void SetDirectory(const std::string &directory);
+  bool IsEnabled() const { return !directory_.empty(); }
+
+  // frames are the return addresses captured by CaptureStackTrace().
+  // get_script_path returns the file that a script was loaded from (or an
+  // empty string). Returns the path of the dump or nullptr if it couldn't
+  // be written.
+  const char *Write(const os::Context &context,
+                    void *const *frames,
+                    int num_frames,
+                    const AMXCallStack &call_stack,
+                    const char *(*get_script_path)(AMX *amx));
+
+  static CrashDump &shared();
+
+ private:
+  CrashDump();
+
+  CrashDump(const CrashDump &) = delete;
+  CrashDump &operator=(const CrashDump &) = delete;
+
+  void BeginSection(uint32_t type, std::size_t size);
+  void PutData(const void *data, std::size_t size);
+  void PutUInt8(uint8_t value);
+  void PutUInt16(uint16_t value);
+  void PutUInt32(uint32_t value);
+  void PutInt64(int64_t value);
+  void PutString(const char *string, std::size_t length);
+  // Copies memory that may be unreadable, with zeros in place of the part
+  // that can't be read.
+  void PutMemory(const void *address, std::size_t size);
+  void Flush();
+
+  void WriteScript(uint32_t id, AMX *amx, const char *path);
+
+ private:
+  static const std::size_t kBufferSize = 65536;
+  static const std::size_t kNativeStackSize = 65536;
+
+  std::string directory_;
+  int fd_;
+  bool failed_;
+  char path_[1024];
+  unsigned char buffer_[kBufferSize];
+  std::size_t size_;
+  unsigned char native_stack_[kNativeStackSize];
+};
+
+#endif // !CRASHDUMP_H
@@ -0,0 +1,247 @@
+// Copyright (c) 2026 Zeex
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include "errorreporter.h"
+#include "log.h"
+#include "threadpolicy.h"
+
+namespace {
+
+const std::size_t kMaxQueuedReports = 256;
+
+// Fingerprints that haven't been seen for a while are forgotten once there
+// are this many of them.
+const std::size_t kMaxFingerprints = 4096;
+
+// A datagram can't be larger than this over IPv4.
+const std::size_t kMaxReportSize = 65507;
+
+std::size_t AppendJSONString(char *buffer,
+                             std::size_t size,
+                             std::size_t length,
+                             const char *s) {
+  if (length + 2 >= size) {
+    return length;
+  }
+  buffer[length++] = '"';
+  for (; *s != '\0' && length + 3 < size; s++) {
+    unsigned char c = static_cast<unsigned char>(*s);
+    if (c == '"' || c == '\\') {
+      buffer[length++] = '\\';
+      buffer[length++] = static_cast<char>(c);
+    } else if (c >= 0x20) {
+      buffer[length++] = static_cast<char>(c);
+    }
+  }
+  buffer[length++] = '"';
+  buffer[length] = '\0';
+  return length;
+}
+
+std::size_t AppendString(char *buffer,
+                         std::size_t size,
+                         std::size_t length,
+                         const char *s) {
+  std::size_t s_length = std::min(std::strlen(s), size - 1 - length);
+  std::memcpy(buffer + length, s, s_length);
+  length += s_length;
+  buffer[length] = '\0';
+  return length;
+}
+
+std::size_t AppendNumber(char *buffer,
+                         std::size_t size,
+                         std::size_t length,
+                         const char *format,
+                         unsigned long long value) {
+  if (length + 1 >= size) {
+    return length;
+  }
+  int result = std::snprintf(buffer + length, size - length, format, value);
+  if (result < 0) {
+    return length;
+  }
+  return std::min(length + static_cast<std::size_t>(result), size - 1);
+}
+
+} // anonymous namespace
+
+ErrorReporter::ErrorReporter()
+  : interval_(0),
+    running_(false),
+    stop_thread_(false),
+    num_dropped_(0)
+{
+}
+
+ErrorReporter::~ErrorReporter() {
+  Stop();
+}
+
+bool ErrorReporter::Start(const std::string &host,
+                          const std::string &port,
+                          std::chrono::seconds interval) {
+  if (running_) {
+    return true;
+  }
+  if (!socket_.Open(host, port)) {
+    LogDebugPrint("Could not open report collector address %s:%s",
+                  host.c_str(), port.c_str());
+    return false;
+  }
+  interval_ = interval;
+  stop_thread_ = false;
+  thread_ = std::thread(&ErrorReporter::Run, this);
+  running_ = true;
+  return true;
+}
+
+void ErrorReporter::Stop() {
+  if (!running_) {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_thread_ = true;
+  }
+  cond_var_.notify_all();
+  thread_.join();
+  running_ = false;
+  socket_.Close();
+  if (num_dropped_ > 0) {
+    LogDebugPrint("Dropped %lu error reports because the queue was full",
+                  num_dropped_);
+  }
+}
+
+bool ErrorReporter::IsRateLimitedLocked(
+    uint64_t fingerprint,
+    std::chrono::steady_clock::time_point now) const {
+  std::unordered_map<uint64_t,
+                     std::chrono::steady_clock::time_point>::const_iterator
+    it = last_reports_.find(fingerprint);
+  return it != last_reports_.end() && now - it->second < interval_;
+}
+
+bool ErrorReporter::IsRateLimited(uint64_t fingerprint) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return IsRateLimitedLocked(fingerprint, std::chrono::steady_clock::now());
+}
+
+void ErrorReporter::Report(uint64_t fingerprint, const std::string &report) {
+  if (!running_ || report.size() > kMaxReportSize) {
+    return;
+  }
+  std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (IsRateLimitedLocked(fingerprint, now)) {
+      return;
+    }
+    if (queue_.size() >= kMaxQueuedReports) {
+      num_dropped_++;
+      return;
+    }
+    if (last_reports_.size() >= kMaxFingerprints) {
+      for (std::unordered_map<uint64_t,
+                              std::chrono::steady_clock::time_point>::iterator
+             it = last_reports_.begin();
+           it != last_reports_.end(); ) {
+        if (now - it->second >= interval_) {
+          it = last_reports_.erase(it);
+        } else {
+          ++it;
+        }
+      }
+    }
+    last_reports_[fingerprint] = now;
+    queue_.push_back(report);
+  }
+  cond_var_.notify_one();
+}
+
+void ErrorReporter::ReportCrash(const char *script,
+                                void *const *frames,
+                                int num_frames,
+                                const char *dump_path) {
+  if (!running_) {
+    return;
+  }
+  // Should the crash happen while another thread is building a report it
+  // doesn't matter, this buffer is only used here.
+  const std::size_t size = sizeof(crash_report_);
+  std::size_t length = 0;
+  length = AppendNumber(crash_report_, size, length,
+                        "{\"time\":%llu,\"type\":\"crash\"",
+                        static_cast<unsigned long long>(std::time(nullptr))
+                          * 1000);
+  if (script != nullptr) {
+    length = AppendString(crash_report_, size, length, ",\"script\":");
+    length = AppendJSONString(crash_report_, size, length, script);
+  }
+  if (dump_path != nullptr) {
+    length = AppendString(crash_report_, size, length, ",\"dump\":");
+    length = AppendJSONString(crash_report_, size, length, dump_path);
+  }
+  length = AppendString(crash_report_, size, length,
+                        ",\"native_backtrace\":[");
+  for (int i = 0; i < num_frames; i++) {
+    length = AppendNumber(crash_report_, size, length,
+                          i > 0 ? ",%llu" : "%llu",
+                          static_cast<unsigned long long>(
+                            reinterpret_cast<uintptr_t>(frames[i])));
+  }
+  length = AppendString(crash_report_, size, length, "]}");
+  socket_.Send(crash_report_, length);
+}
+
+void ErrorReporter::Run() {
+  ApplyThreadPolicy(THREAD_CLASS_LOG);
+  std::unique_lock<std::mutex> lock(mutex_);
+  for (;;) {
+    cond_var_.wait(lock, [this]() {
+      return stop_thread_ || !queue_.empty();
+    });
+    // Whatever is still queued on shutdown is sent anyway.
+    if (queue_.empty()) {
+      break;
+    }
+    std::string report;
+    report.swap(queue_.front());
+    queue_.pop_front();
+    lock.unlock();
+    socket_.Send(report.data(), report.size());
+    lock.lock();
+  }
+}
+
+// static
+ErrorReporter &ErrorReporter::shared() {
+  static ErrorReporter instance;
+  return instance;
+}
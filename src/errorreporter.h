@@ -0,0 +1,95 @@
+// Copyright (c) 2026 Zeex
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef ERRORREPORTER_H
+#define ERRORREPORTER_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include "udpsocket.h"
+
+// Sends runtime error and crash reports to a central collector over UDP,
+// one JSON object per datagram. Runtime errors are queued and sent by a
+// thread of its own so that the server never waits for the network; the
+// queue is bounded and reports that don't fit are dropped. The same error
+// (by fingerprint) is sent at most once per interval.
+class ErrorReporter {
+ public:
+  bool Start(const std::string &host,
+             const std::string &port,
+             std::chrono::seconds interval);
+  void Stop();
+
+  bool IsRunning() const { return running_; }
+
+  // Tells whether a report for this fingerprint would be dropped by the
+  // rate limit right now, to avoid building it in the first place.
+  bool IsRateLimited(uint64_t fingerprint);
+
+  // Queues a report unless it's rate limited.
+  void Report(uint64_t fingerprint, const std::string &report);
+
+  // Sends a crash report right away from the crash handler and doesn't
+  // allocate memory. script may be nullptr.
+  void ReportCrash(const char *script,
+                   void *const *frames,
+                   int num_frames,
+                   const char *dump_path);
+
+  static ErrorReporter &shared();
+
+ private:
+  ErrorReporter();
+  ~ErrorReporter();
+
+  ErrorReporter(const ErrorReporter &) = delete;
+  ErrorReporter &operator=(const ErrorReporter &) = delete;
+
+  bool IsRateLimitedLocked(uint64_t fingerprint,
+                           std::chrono::steady_clock::time_point now) const;
+  void Run();
+
+ private:
+  UDPSocket socket_;
+  std::chrono::seconds interval_;
+  bool running_;
+  bool stop_thread_;
+  std::mutex mutex_;
+  std::condition_variable cond_var_;
+  std::deque<std::string> queue_;
+  std::unordered_map<uint64_t, std::chrono::steady_clock::time_point>
+    last_reports_;
+  unsigned long num_dropped_;
+  std::thread thread_;
+  char crash_report_[8192];
+};
+
+#endif // !ERRORREPORTER_H
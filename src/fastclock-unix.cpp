@@ -0,0 +1,132 @@
+// Copyright (c) 2026 Zeex
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <time.h>
+#if defined __i386__ || defined __x86_64__
+  #include <cpuid.h>
+  #include <x86intrin.h>
+  #define FASTCLOCK_HAVE_TSC
+#endif
+#include "fastclock.h"
+
+namespace {
+
+#ifdef CLOCK_MONOTONIC_COARSE
+  const clockid_t kFallbackClock = CLOCK_MONOTONIC_COARSE;
+#else
+  const clockid_t kFallbackClock = CLOCK_MONOTONIC;
+#endif
+
+// How long the TSC is measured against the system clock.
+const int64_t kCalibrationTime = 10000;
+
+int64_t GetClockTime(clockid_t clock) {
+  timespec ts;
+  clock_gettime(clock, &ts);
+  return static_cast<int64_t>(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+}
+
+#ifdef FASTCLOCK_HAVE_TSC
+
+// An invariant TSC runs at a constant rate regardless of frequency scaling
+// and power states, and is synchronized between cores.
+bool HasInvariantTSC() {
+  unsigned int eax, ebx, ecx, edx;
+  if (__get_cpuid(0x80000000, &eax, &ebx, &ecx, &edx) == 0
+      || eax < 0x80000007) {
+    return false;
+  }
+  __get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx);
+  return (edx & (1 << 8)) != 0;
+}
+
+#endif
+
+class Clock {
+ public:
+  Clock()
+    : use_tsc_(false),
+      tsc_base_(0),
+      time_base_(0),
+      ticks_per_us_(0)
+  {
+    #ifdef FASTCLOCK_HAVE_TSC
+      if (HasInvariantTSC()) {
+        Calibrate();
+      }
+    #endif
+  }
+
+  int64_t Now() const {
+    #ifdef FASTCLOCK_HAVE_TSC
+      if (use_tsc_) {
+        return time_base_
+               + static_cast<int64_t>((__rdtsc() - tsc_base_) / ticks_per_us_);
+      }
+    #endif
+    return GetClockTime(kFallbackClock);
+  }
+
+ private:
+  #ifdef FASTCLOCK_HAVE_TSC
+    void Calibrate() {
+      int64_t start_time = GetClockTime(CLOCK_MONOTONIC);
+      unsigned long long start_tsc = __rdtsc();
+      int64_t time;
+      while ((time = GetClockTime(CLOCK_MONOTONIC)) - start_time
+             < kCalibrationTime) {
+        // busy wait
+      }
+      unsigned long long tsc = __rdtsc();
+      if (tsc <= start_tsc) {
+        return;
+      }
+      tsc_base_ = tsc;
+      time_base_ = time;
+      ticks_per_us_ =
+        static_cast<double>(tsc - start_tsc) / (time - start_time);
+      use_tsc_ = true;
+    }
+  #endif
+
+  bool use_tsc_;
+  unsigned long long tsc_base_;
+  int64_t time_base_;
+  double ticks_per_us_;
+};
+
+// Calibrated once when the plugin is loaded rather than on first use so
+// that the VM thread doesn't have to wait for it and Now() doesn't need a
+// thread-safe initialization check.
+Clock clock_instance;
+
+} // anonymous namespace
+
+namespace fastclock {
+
+int64_t Now() {
+  return clock_instance.Now();
+}
+
+} // namespace fastclock
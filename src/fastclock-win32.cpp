@@ -0,0 +1,69 @@
+// Copyright (c) 2026 Zeex
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <windows.h>
+#include "fastclock.h"
+
+namespace {
+
+// QueryPerformanceCounter() already uses the TSC where it's reliable and
+// doesn't need a system call then.
+class Clock {
+ public:
+  Clock(): frequency_(0) {
+    LARGE_INTEGER frequency;
+    if (QueryPerformanceFrequency(&frequency)) {
+      frequency_ = frequency.QuadPart;
+    }
+  }
+
+  int64_t Now() const {
+    if (frequency_ == 0) {
+      // Never happens on XP and later. GetTickCount64() would be better but
+      // it's not there on XP, which is what we build for.
+      return static_cast<int64_t>(GetTickCount()) * 1000;
+    }
+    LARGE_INTEGER counter;
+    QueryPerformanceCounter(&counter);
+    // Split the conversion to avoid overflow.
+    int64_t seconds = counter.QuadPart / frequency_;
+    int64_t remainder = counter.QuadPart % frequency_;
+    return seconds * 1000000 + remainder * 1000000 / frequency_;
+  }
+
+ private:
+  int64_t frequency_;
+};
+
+Clock clock_instance;
+
+} // anonymous namespace
+
+namespace fastclock {
+
+int64_t Now() {
+  return clock_instance.Now();
+}
+
+} // namespace fastclock
@@ -22,13 +22,17 @@
 // ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
 // POSSIBILITY OF SUCH DAMAGE.
 
+#include <cstring>
 #include <string>
 #include <vector>
 
 #include <dirent.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <fnmatch.h>
 #include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include "fileutils.h"
 
@@ -55,6 +59,54 @@ void GetDirectoryFiles(const std::string &directory, const std::string &pattern,
   }
 }
 
+void GetDirectoryFiles(const std::string &directory,
+                       const std::string &pattern,
+                       std::vector<FileInfo> &files)
+{
+  DIR *dp;
+  if ((dp = opendir(directory.c_str())) != nullptr) {
+    struct dirent *dirp;
+    while ((dirp = readdir(dp)) != nullptr) {
+      if (fnmatch(pattern.c_str(),
+                  dirp->d_name,
+                  FNM_CASEFOLD | FNM_NOESCAPE | FNM_PERIOD) != 0) {
+        continue;
+      }
+      struct stat attrib;
+      if (fstatat(dirfd(dp), dirp->d_name, &attrib, 0) == 0
+          && S_ISREG(attrib.st_mode)) {
+        FileInfo info;
+        info.name = dirp->d_name;
+        info.size = static_cast<std::size_t>(attrib.st_size);
+        info.mtime = attrib.st_mtime;
+        files.push_back(info);
+      }
+    }
+    closedir(dp);
+  }
+}
+
+void GetSubdirectories(const std::string &directory,
+                       std::vector<std::string> &subdirectories)
+{
+  DIR *dp;
+  if ((dp = opendir(directory.c_str())) != nullptr) {
+    struct dirent *dirp;
+    while ((dirp = readdir(dp)) != nullptr) {
+      if (std::strcmp(dirp->d_name, ".") == 0
+          || std::strcmp(dirp->d_name, "..") == 0) {
+        continue;
+      }
+      std::string path = directory + kNativePathSepString + dirp->d_name;
+      struct stat attrib;
+      if (lstat(path.c_str(), &attrib) == 0 && S_ISDIR(attrib.st_mode)) {
+        subdirectories.push_back(dirp->d_name);
+      }
+    }
+    closedir(dp);
+  }
+}
+
 std::string GetCurrentWorkingtDirectory() {
   std::vector<char> buffer(256);
   while (getcwd(&buffer[0], buffer.size()) == 0 &&
@@ -64,4 +116,34 @@ std::string GetCurrentWorkingtDirectory() {
   return std::string(&buffer[0]);
 }
 
+bool MappedFile::Map(const std::string &path) {
+  Unmap();
+
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) == 0 && st.st_size > 0) {
+    void *data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data != MAP_FAILED) {
+      data_ = data;
+      size_ = static_cast<std::size_t>(st.st_size);
+    }
+  }
+
+  // The mapping stays valid after the descriptor is closed.
+  close(fd);
+  return data_ != nullptr;
+}
+
+void MappedFile::Unmap() {
+  if (data_ != nullptr) {
+    munmap(data_, size_);
+    data_ = nullptr;
+    size_ = 0;
+  }
+}
+
 } // namespace fileutils
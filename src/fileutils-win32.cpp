@@ -25,6 +25,7 @@
 #ifndef WIN32_LEAN_AND_MEAN
   #define WIN32_LEAN_AND_MEAN
 #endif
+#include <cstring>
 #include <string>
 #include <vector>
 #include <windows.h>
@@ -62,6 +63,70 @@ void GetDirectoryFiles(const std::string &directory, const std::string &pattern,
   FindClose(hFindFile);
 }
 
+void GetDirectoryFiles(const std::string &directory,
+                       const std::string &pattern,
+                       std::vector<FileInfo> &files)
+{
+  std::string fileName;
+  fileName.append(directory);
+  fileName.append(kNativePathSepString);
+  fileName.append(pattern);
+
+  WIN32_FIND_DATA findFileData;
+
+  HANDLE hFindFile = FindFirstFile(fileName.c_str(), &findFileData);
+  if (hFindFile == INVALID_HANDLE_VALUE) {
+    return;
+  }
+
+  do {
+    if (!(findFileData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)) {
+      ULARGE_INTEGER size;
+      size.LowPart = findFileData.nFileSizeLow;
+      size.HighPart = findFileData.nFileSizeHigh;
+      // FILETIME counts 100 ns intervals since 1601-01-01.
+      ULARGE_INTEGER time;
+      time.LowPart = findFileData.ftLastWriteTime.dwLowDateTime;
+      time.HighPart = findFileData.ftLastWriteTime.dwHighDateTime;
+      FileInfo info;
+      info.name = findFileData.cFileName;
+      info.size = static_cast<std::size_t>(size.QuadPart);
+      info.mtime = static_cast<std::time_t>(
+        (time.QuadPart - 116444736000000000ULL) / 10000000ULL);
+      files.push_back(info);
+    }
+  } while (FindNextFile(hFindFile, &findFileData));
+
+  FindClose(hFindFile);
+}
+
+void GetSubdirectories(const std::string &directory,
+                       std::vector<std::string> &subdirectories)
+{
+  std::string fileName;
+  fileName.append(directory);
+  fileName.append(kNativePathSepString);
+  fileName.append("*");
+
+  WIN32_FIND_DATA findFileData;
+
+  HANDLE hFindFile = FindFirstFile(fileName.c_str(), &findFileData);
+  if (hFindFile == INVALID_HANDLE_VALUE) {
+    return;
+  }
+
+  do {
+    if ((findFileData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+        && !(findFileData.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT)
+        && std::strcmp(findFileData.cFileName, ".") != 0
+        && std::strcmp(findFileData.cFileName, "..") != 0) {
+      subdirectories.push_back(findFileData.cFileName);
+    }
+  } while (FindNextFile(hFindFile, &findFileData));
+
+  FindClose(hFindFile);
+}
+
 std::string GetCurrentWorkingtDirectory() {
   DWORD size = GetCurrentDirectoryA(0, nullptr);
   std::vector<char> buffer(size);
@@ -69,4 +134,49 @@ std::string GetCurrentWorkingtDirectory() {
   return std::string(&buffer[0]);
 }
 
+bool MappedFile::Map(const std::string &path) {
+  Unmap();
+
+  HANDLE file = CreateFileA(path.c_str(),
+                            GENERIC_READ,
+                            FILE_SHARE_READ,
+                            nullptr,
+                            OPEN_EXISTING,
+                            FILE_ATTRIBUTE_NORMAL,
+                            nullptr);
+  if (file == INVALID_HANDLE_VALUE) {
+    return false;
+  }
+
+  LARGE_INTEGER file_size;
+  if (GetFileSizeEx(file, &file_size) && file_size.QuadPart > 0) {
+    HANDLE mapping = CreateFileMappingA(file,
+                                        nullptr,
+                                        PAGE_READONLY,
+                                        0,
+                                        0,
+                                        nullptr);
+    if (mapping != nullptr) {
+      void *data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+      if (data != nullptr) {
+        data_ = data;
+        size_ = static_cast<std::size_t>(file_size.QuadPart);
+      }
+      // The view keeps the mapping object alive.
+      CloseHandle(mapping);
+    }
+  }
+
+  CloseHandle(file);
+  return data_ != nullptr;
+}
+
+void MappedFile::Unmap() {
+  if (data_ != nullptr) {
+    UnmapViewOfFile(data_);
+    data_ = nullptr;
+    size_ = 0;
+  }
+}
+
 } // namespace fileutils
@@ -73,6 +73,25 @@ std::time_t GetModificationTime(const std::string &path) {
   return 0;
 }
 
+std::size_t GetFileSize(const std::string &path) {
+  struct stat attrib;
+  if (stat(path.c_str(), &attrib) == 0) {
+    return static_cast<std::size_t>(attrib.st_size);
+  }
+  return 0;
+}
+
+bool GetFileInfo(const std::string &path, FileInfo &info) {
+  struct stat attrib;
+  if (stat(path.c_str(), &attrib) != 0) {
+    return false;
+  }
+  info.name = GetFileName(path);
+  info.size = static_cast<std::size_t>(attrib.st_size);
+  info.mtime = attrib.st_mtime;
+  return true;
+}
+
 std::string GetRelativePath(std::string path) {
   return GetRelativePath(path, GetCurrentWorkingtDirectory());
 }
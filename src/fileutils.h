@@ -25,6 +25,7 @@
 #ifndef FILEUTILS_H
 #define FILEUTILS_H
 
+#include <cstddef>
 #include <ctime>
 #include <string>
 #include <vector>
@@ -43,16 +44,59 @@ std::string GetFileExtension(const std::string &path);
 const char *GetFileExtensionPtr(const char *path);
 
 std::time_t GetModificationTime(const std::string &path);
+std::size_t GetFileSize(const std::string &path);
+
+struct FileInfo {
+  std::string name;
+  std::size_t size;
+  std::time_t mtime;
+};
+
+// Gets the size and modification time of a file with a single stat().
+bool GetFileInfo(const std::string &path, FileInfo &info);
 
 void GetDirectoryFiles(const std::string &directory,
                        const std::string &pattern,
                        std::vector<std::string> &files);
 
+// Same as above but also gets the size and modification time of each file
+// while listing the directory, which saves a separate stat() per file
+// (on Windows they come with the listing itself).
+void GetDirectoryFiles(const std::string &directory,
+                       const std::string &pattern,
+                       std::vector<FileInfo> &files);
+
+// Gets the names of the directories in a directory, not including "." and
+// "..", or symbolic links (so that following them can't go in circles).
+void GetSubdirectories(const std::string &directory,
+                       std::vector<std::string> &subdirectories);
+
 std::string GetRelativePath(std::string path);
 std::string GetRelativePath(std::string path, const std::string &dir);
 
 std::string GetCurrentWorkingtDirectory();
 
+// A read-only view of an entire file mapped into memory.
+class MappedFile {
+ public:
+  MappedFile(): data_(nullptr), size_(0) {}
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+  ~MappedFile() { Unmap(); }
+
+  bool Map(const std::string &path);
+  void Unmap();
+
+  bool IsMapped() const { return data_ != nullptr; }
+
+  const void *data() const { return data_; }
+  std::size_t size() const { return size_; }
+
+ private:
+  void *data_;
+  std::size_t size_;
+};
+
 } // namespace fileutils
 
 #endif // !FILEUTILS_H
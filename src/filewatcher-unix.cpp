@@ -0,0 +1,154 @@
+// Copyright (c) 2026 Zeex
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+#include "filewatcher.h"
+
+namespace {
+
+const uint32_t kListingEvents =
+  IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO;
+const uint32_t kEvents =
+  kListingEvents | IN_CLOSE_WRITE | IN_MODIFY | IN_ATTRIB
+  | IN_DELETE_SELF | IN_MOVE_SELF;
+
+} // anonymous namespace
+
+struct FileWatcher::Platform {
+  Platform(): fd(-1) {
+    wake_fds[0] = -1;
+    wake_fds[1] = -1;
+  }
+
+  int fd;
+  int wake_fds[2];
+  // Watch descriptors, indexed like directories_.
+  std::vector<int> watches;
+};
+
+bool FileWatcher::AddWatch(const std::string &path) {
+  if (platform_ == nullptr) {
+    platform_ = new Platform;
+  }
+  if (platform_->fd < 0) {
+    platform_->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (platform_->fd < 0) {
+      return false;
+    }
+    // Wake() writes to this to stop the thread.
+    if (pipe(platform_->wake_fds) != 0) {
+      close(platform_->fd);
+      platform_->fd = -1;
+      return false;
+    }
+  }
+  int watch = inotify_add_watch(platform_->fd, path.c_str(), kEvents);
+  if (watch < 0) {
+    return false;
+  }
+  platform_->watches.push_back(watch);
+  return true;
+}
+
+void FileWatcher::Run() {
+  Platform &platform = *platform_;
+
+  // Big enough for a few hundred events at once.
+  std::vector<char> buffer(64 * 1024);
+  for (;;) {
+    struct pollfd fds[2];
+    fds[0].fd = platform.fd;
+    fds[0].events = POLLIN;
+    fds[1].fd = platform.wake_fds[0];
+    fds[1].events = POLLIN;
+    if (poll(fds, 2, -1) < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      break;
+    }
+    if (fds[1].revents != 0) {
+      break;
+    }
+
+    ssize_t size = read(platform.fd, &buffer[0], buffer.size());
+    if (size <= 0) {
+      continue;
+    }
+    for (ssize_t offset = 0; offset < size; ) {
+      const struct inotify_event *event =
+        reinterpret_cast<const struct inotify_event *>(&buffer[offset]);
+      offset += sizeof(struct inotify_event) + event->len;
+
+      if (event->mask & IN_Q_OVERFLOW) {
+        for (std::size_t i = 0; i < platform.watches.size(); i++) {
+          OnOverflow(i);
+        }
+        continue;
+      }
+      for (std::size_t i = 0; i < platform.watches.size(); i++) {
+        if (platform.watches[i] != event->wd) {
+          continue;
+        }
+        if (event->mask & (IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED)) {
+          OnOverflow(i);
+        } else if (event->len > 0) {
+          OnChange(i, event->name, (event->mask & kListingEvents) != 0);
+        }
+        break;
+      }
+    }
+  }
+}
+
+void FileWatcher::Wake() {
+  if (platform_ != nullptr && platform_->wake_fds[1] >= 0) {
+    char byte = 0;
+    while (write(platform_->wake_fds[1], &byte, 1) < 0 && errno == EINTR) {
+    }
+  }
+}
+
+void FileWatcher::Close() {
+  if (platform_ == nullptr) {
+    return;
+  }
+  if (platform_->fd >= 0) {
+    close(platform_->fd);
+  }
+  for (int i = 0; i < 2; i++) {
+    if (platform_->wake_fds[i] >= 0) {
+      close(platform_->wake_fds[i]);
+    }
+  }
+  delete platform_;
+  platform_ = nullptr;
+}
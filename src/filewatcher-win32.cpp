@@ -0,0 +1,204 @@
+// Copyright (c) 2026 Zeex
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef WIN32_LEAN_AND_MEAN
+  #define WIN32_LEAN_AND_MEAN
+#endif
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <windows.h>
+#include "filewatcher.h"
+
+namespace {
+
+const DWORD kNotifyFilter = FILE_NOTIFY_CHANGE_FILE_NAME
+                          | FILE_NOTIFY_CHANGE_LAST_WRITE
+                          | FILE_NOTIFY_CHANGE_SIZE;
+
+const DWORD kBufferSize = 64 * 1024;
+
+std::string NarrowString(const WCHAR *s, int length) {
+  int size = WideCharToMultiByte(CP_ACP, 0, s, length,
+                                 nullptr, 0, nullptr, nullptr);
+  std::string result(size, '\0');
+  if (size > 0) {
+    WideCharToMultiByte(CP_ACP, 0, s, length,
+                        &result[0], size, nullptr, nullptr);
+  }
+  return result;
+}
+
+} // anonymous namespace
+
+struct FileWatcher::Platform {
+  struct Watch {
+    HANDLE directory;
+    OVERLAPPED overlapped;
+    std::vector<DWORD> buffer;  // DWORD-aligned, as required
+  };
+
+  Platform(): stop_event(CreateEvent(nullptr, TRUE, FALSE, nullptr)) {}
+
+  HANDLE stop_event;
+  // Indexed like directories_.
+  std::vector<Watch *> watches;
+};
+
+bool FileWatcher::AddWatch(const std::string &path) {
+  if (platform_ == nullptr) {
+    platform_ = new Platform;
+  }
+  if (platform_->stop_event == nullptr) {
+    return false;
+  }
+  HANDLE directory = CreateFileA(path.c_str(),
+                                 FILE_LIST_DIRECTORY,
+                                 FILE_SHARE_READ
+                                 | FILE_SHARE_WRITE
+                                 | FILE_SHARE_DELETE,
+                                 nullptr,
+                                 OPEN_EXISTING,
+                                 FILE_FLAG_BACKUP_SEMANTICS
+                                 | FILE_FLAG_OVERLAPPED,
+                                 nullptr);
+  if (directory == INVALID_HANDLE_VALUE) {
+    return false;
+  }
+  HANDLE event = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+  if (event == nullptr) {
+    CloseHandle(directory);
+    return false;
+  }
+  Platform::Watch *watch = new Platform::Watch;
+  watch->directory = directory;
+  ZeroMemory(&watch->overlapped, sizeof(watch->overlapped));
+  watch->overlapped.hEvent = event;
+  watch->buffer.resize(kBufferSize / sizeof(DWORD));
+  platform_->watches.push_back(watch);
+  return true;
+}
+
+void FileWatcher::Run() {
+  Platform &platform = *platform_;
+
+  // The reads have to be started on this thread: pending I/O is cancelled
+  // when the thread that started it exits.
+  std::vector<HANDLE> events;
+  bool started = true;
+  for (std::size_t i = 0; i < platform.watches.size() && started; i++) {
+    Platform::Watch *watch = platform.watches[i];
+    started = ReadDirectoryChangesW(watch->directory,
+                                    &watch->buffer[0],
+                                    kBufferSize,
+                                    FALSE,
+                                    kNotifyFilter,
+                                    nullptr,
+                                    &watch->overlapped,
+                                    nullptr) != FALSE;
+    events.push_back(watch->overlapped.hEvent);
+  }
+  events.push_back(platform.stop_event);
+
+  while (started) {
+    DWORD result = WaitForMultipleObjects(static_cast<DWORD>(events.size()),
+                                          &events[0],
+                                          FALSE,
+                                          INFINITE);
+    if (result >= WAIT_OBJECT_0 + events.size() - 1) {
+      break;
+    }
+
+    std::size_t index = result - WAIT_OBJECT_0;
+    Platform::Watch *watch = platform.watches[index];
+    DWORD size = 0;
+    if (!GetOverlappedResult(watch->directory,
+                             &watch->overlapped,
+                             &size,
+                             FALSE)) {
+      break;
+    }
+    if (size == 0) {
+      // The buffer was too small to hold all the changes.
+      OnOverflow(index);
+    } else {
+      const char *data = reinterpret_cast<const char *>(&watch->buffer[0]);
+      for (DWORD offset = 0; ; ) {
+        const FILE_NOTIFY_INFORMATION *info =
+          reinterpret_cast<const FILE_NOTIFY_INFORMATION *>(data + offset);
+        std::string name = NarrowString(
+          info->FileName,
+          static_cast<int>(info->FileNameLength / sizeof(WCHAR)));
+        OnChange(index, name, info->Action != FILE_ACTION_MODIFIED);
+        if (info->NextEntryOffset == 0) {
+          break;
+        }
+        offset += info->NextEntryOffset;
+      }
+    }
+
+    if (!ReadDirectoryChangesW(watch->directory,
+                               &watch->buffer[0],
+                               kBufferSize,
+                               FALSE,
+                               kNotifyFilter,
+                               nullptr,
+                               &watch->overlapped,
+                               nullptr)) {
+      OnOverflow(index);
+      break;
+    }
+  }
+
+  // Wait for the reads to be cancelled before their buffers can be freed.
+  for (std::size_t i = 0; i < platform.watches.size(); i++) {
+    Platform::Watch *watch = platform.watches[i];
+    DWORD size;
+    CancelIo(watch->directory);
+    GetOverlappedResult(watch->directory, &watch->overlapped, &size, TRUE);
+  }
+}
+
+void FileWatcher::Wake() {
+  if (platform_ != nullptr && platform_->stop_event != nullptr) {
+    SetEvent(platform_->stop_event);
+  }
+}
+
+void FileWatcher::Close() {
+  if (platform_ == nullptr) {
+    return;
+  }
+  for (std::size_t i = 0; i < platform_->watches.size(); i++) {
+    Platform::Watch *watch = platform_->watches[i];
+    CloseHandle(watch->directory);
+    CloseHandle(watch->overlapped.hEvent);
+    delete watch;
+  }
+  if (platform_->stop_event != nullptr) {
+    CloseHandle(platform_->stop_event);
+  }
+  delete platform_;
+  platform_ = nullptr;
+}
@@ -0,0 +1,173 @@
+// Copyright (c) 2026 Zeex
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <algorithm>
+#include "filewatcher.h"
+#include "threadpolicy.h"
+
+namespace {
+
+// Paths may come with either kind of separator on Windows (e.g. from fopen()
+// and from AMX_PATH).
+std::string NormalizePath(const std::string &path) {
+  std::string result = path;
+  std::replace(result.begin(), result.end(), '\\', '/');
+  while (result.length() > 1 && result[result.length() - 1] == '/') {
+    result.erase(result.length() - 1);
+  }
+  return result;
+}
+
+} // anonymous namespace
+
+FileWatcher::FileWatcher()
+  : platform_(nullptr),
+    version_(0),
+    overflow_version_(0),
+    running_(false)
+{
+}
+
+FileWatcher::~FileWatcher() {
+  Stop();
+}
+
+bool FileWatcher::Watch(const std::string &path) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (running_ || FindDirectory(path) != nullptr) {
+    return false;
+  }
+  if (!AddWatch(path)) {
+    return false;
+  }
+  Directory directory;
+  directory.path = NormalizePath(path);
+  directory.listing_changed = false;
+  directory.overflow = false;
+  directories_.push_back(directory);
+  return true;
+}
+
+void FileWatcher::Start() {
+  if (running_ || directories_.empty()) {
+    return;
+  }
+  running_ = true;
+  thread_ = std::thread([this]() {
+    ApplyThreadPolicy(THREAD_CLASS_LOG);
+    Run();
+    // Changes aren't seen anymore if the thread stopped on its own.
+    running_ = false;
+  });
+}
+
+void FileWatcher::Stop() {
+  if (thread_.joinable()) {
+    Wake();
+    thread_.join();
+  }
+  running_ = false;
+  Close();
+  std::lock_guard<std::mutex> lock(mutex_);
+  directories_.clear();
+  file_versions_.clear();
+}
+
+FileWatcher::Directory *FileWatcher::FindDirectory(const std::string &path) {
+  std::string normalized_path = NormalizePath(path);
+  for (std::size_t i = 0; i < directories_.size(); i++) {
+    if (directories_[i].path == normalized_path) {
+      return &directories_[i];
+    }
+  }
+  return nullptr;
+}
+
+void FileWatcher::OnChange(std::size_t index,
+                           const std::string &name,
+                           bool listing) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  Directory &directory = directories_[index];
+  if (std::find(directory.changed.begin(),
+                directory.changed.end(),
+                name) == directory.changed.end()) {
+    directory.changed.push_back(name);
+  }
+  if (listing) {
+    directory.listing_changed = true;
+  }
+  file_versions_[directory.path + "/" + name] = ++version_;
+}
+
+void FileWatcher::OnOverflow(std::size_t index) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  directories_[index].overflow = true;
+  overflow_version_ = ++version_;
+}
+
+bool FileWatcher::TakeChanges(const std::string &path,
+                              std::vector<std::string> &names,
+                              bool &listing_changed) {
+  names.clear();
+  listing_changed = false;
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  Directory *directory = FindDirectory(path);
+  if (directory == nullptr) {
+    return false;
+  }
+  bool complete = running_ && !directory->overflow;
+  if (complete) {
+    names.swap(directory->changed);
+    listing_changed = directory->listing_changed;
+  }
+  directory->changed.clear();
+  directory->listing_changed = false;
+  directory->overflow = false;
+  return complete;
+}
+
+bool FileWatcher::GetFileVersion(const std::string &path, uint32_t &version) {
+  std::string normalized_path = NormalizePath(path);
+  std::string::size_type last_sep = normalized_path.find_last_of('/');
+  std::string dir = last_sep != std::string::npos
+    ? normalized_path.substr(0, last_sep)
+    : std::string(".");
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!running_ || FindDirectory(dir) == nullptr) {
+    return false;
+  }
+  std::unordered_map<std::string, uint32_t>::const_iterator it =
+    file_versions_.find(normalized_path);
+  version = it != file_versions_.end() ? it->second : 0;
+  version = std::max(version, overflow_version_);
+  return true;
+}
+
+// static
+FileWatcher &FileWatcher::shared() {
+  static FileWatcher instance;
+  return instance;
+}
@@ -0,0 +1,107 @@
+// Copyright (c) 2026 Zeex
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef FILEWATCHER_H
+#define FILEWATCHER_H
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Watches directories for changes on a separate thread (with inotify on
+// Linux and ReadDirectoryChangesW on Windows), so that caches of file
+// contents only have to be checked when something has actually changed
+// rather than calling stat() on every file each time.
+class FileWatcher {
+ public:
+  // Adds a directory to watch (not recursively). Directories must be added
+  // before Start(). Returns false if watching isn't supported or the
+  // directory can't be watched.
+  bool Watch(const std::string &path);
+
+  void Start();
+  void Stop();
+
+  bool IsRunning() const { return running_; }
+
+  // Sets names to the files in the directory that have changed since the
+  // last call (there should only be one caller per directory), and
+  // listing_changed to whether any were added, removed or renamed. Returns
+  // false if the directory isn't being watched or some changes may have
+  // been missed, in which case the caller should check every file.
+  bool TakeChanges(const std::string &path,
+                   std::vector<std::string> &names,
+                   bool &listing_changed);
+
+  // Sets version to a number that is different every time the file changes
+  // and returns true, or returns false if its directory isn't being watched.
+  bool GetFileVersion(const std::string &path, uint32_t &version);
+
+  static FileWatcher &shared();
+
+ private:
+  FileWatcher();
+  ~FileWatcher();
+
+  FileWatcher(const FileWatcher &) = delete;
+  FileWatcher &operator=(const FileWatcher &) = delete;
+
+  struct Directory {
+    std::string path;
+    std::vector<std::string> changed;
+    bool listing_changed;
+    bool overflow;
+  };
+
+  Directory *FindDirectory(const std::string &path);
+
+  // Called by the platform code on the watcher thread.
+  void OnChange(std::size_t index, const std::string &name, bool listing);
+  void OnOverflow(std::size_t index);
+
+  // Implemented in filewatcher-unix.cpp and filewatcher-win32.cpp.
+  struct Platform;
+  bool AddWatch(const std::string &path);
+  void Run();
+  void Wake();
+  void Close();
+
+ private:
+  // Created by AddWatch() and freed by Close().
+  Platform *platform_;
+  std::mutex mutex_;
+  std::vector<Directory> directories_;
+  std::unordered_map<std::string, uint32_t> file_versions_;
+  uint32_t version_;
+  // Version given to every file after changes were missed.
+  uint32_t overflow_version_;
+  std::atomic<bool> running_;
+  std::thread thread_;
+};
+
+#endif // !FILEWATCHER_H
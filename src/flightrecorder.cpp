@@ -0,0 +1,175 @@
+// Copyright (c) 2026 Zeex
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <cstring>
+#include "fastclock.h"
+#include "flightrecorder.h"
+
+// The file starts with a FileHeader, followed by kMaxScripts FileScripts
+// and then the events themselves, exactly as they're laid out in memory.
+// Everything is in the byte order of the machine the server runs on.
+struct FlightRecorder::FileHeader {
+  char magic[4]; // "CDFR"
+  uint32_t version;
+  uint32_t capacity;
+  uint32_t event_size;
+  uint32_t pointer_size;
+  uint32_t max_scripts;
+  std::atomic<uint32_t> next;
+  uint32_t reserved;
+};
+
+struct FlightRecorder::FileScript {
+  uint64_t amx;
+  char path[kMaxScriptPathLength + 1];
+};
+
+namespace {
+
+const uint32_t kFileVersion = 1;
+
+} // anonymous namespace
+
+const uint32_t FlightRecorder::kTimeMask;
+const std::size_t FlightRecorder::kMaxScripts;
+const std::size_t FlightRecorder::kMaxScriptPathLength;
+
+FlightRecorder::FlightRecorder()
+  : events_(nullptr),
+    capacity_(0),
+    mask_(0),
+    next_(&local_next_),
+    local_next_(0),
+    scripts_(nullptr),
+    next_script_(0)
+{
+}
+
+// static
+FlightRecorder &FlightRecorder::shared() {
+  static FlightRecorder recorder;
+  return recorder;
+}
+
+bool FlightRecorder::SetCapacity(std::size_t capacity,
+                                 const std::string &path) {
+  std::size_t size = 0;
+  if (capacity > 0) {
+    size = 1;
+    while (size < capacity && size < (1u << 24)) {
+      size <<= 1;
+    }
+  }
+
+  file_.Close();
+  scripts_ = nullptr;
+  next_script_ = 0;
+  storage_.clear();
+  next_ = &local_next_;
+
+  bool ok = true;
+  if (size > 0 && !path.empty()) {
+    ok = CreateRingFile(size, path);
+  }
+  if (!file_.IsOpen()) {
+    Event empty = {nullptr, 0, 0};
+    storage_.assign(size, empty);
+    events_ = storage_.empty() ? nullptr : storage_.data();
+  }
+  capacity_ = size;
+  mask_ = static_cast<uint32_t>(size - 1);
+  next_->store(0, std::memory_order_relaxed);
+  return ok;
+}
+
+bool FlightRecorder::CreateRingFile(std::size_t capacity,
+                                const std::string &path) {
+  std::size_t size = sizeof(FileHeader)
+                   + sizeof(FileScript) * kMaxScripts
+                   + sizeof(Event) * capacity;
+  if (!file_.Create(path, size)) {
+    return false;
+  }
+
+  // The mapping is zero-filled, so only the non-zero fields need to be set.
+  char *data = static_cast<char *>(file_.data());
+  FileHeader *header = reinterpret_cast<FileHeader *>(data);
+  header->version = kFileVersion;
+  header->capacity = static_cast<uint32_t>(capacity);
+  header->event_size = sizeof(Event);
+  header->pointer_size = sizeof(void *);
+  header->max_scripts = static_cast<uint32_t>(kMaxScripts);
+  // The decoder ignores files without the magic, so write it last.
+  std::memcpy(header->magic, "CDFR", sizeof(header->magic));
+
+  scripts_ = reinterpret_cast<FileScript *>(data + sizeof(FileHeader));
+  events_ = reinterpret_cast<Event *>(
+    data + sizeof(FileHeader) + sizeof(FileScript) * kMaxScripts);
+  next_ = &header->next;
+  return true;
+}
+
+void FlightRecorder::AddScript(AMX *amx, const std::string &path) {
+  if (scripts_ == nullptr) {
+    return;
+  }
+  uint64_t key = reinterpret_cast<uintptr_t>(amx);
+  // A new script may get the address of one that was unloaded; its entry
+  // is replaced so that the decoder doesn't confuse the two. Events of the
+  // old script that are still in the ring will be attributed to the new
+  // one, though.
+  FileScript *script = nullptr;
+  for (std::size_t i = 0; i < kMaxScripts; i++) {
+    if (scripts_[i].amx == key) {
+      script = &scripts_[i];
+      break;
+    }
+  }
+  if (script == nullptr) {
+    script = &scripts_[next_script_];
+    next_script_ = (next_script_ + 1) % kMaxScripts;
+  }
+  std::size_t length = path.size() < kMaxScriptPathLength
+                       ? path.size()
+                       : kMaxScriptPathLength;
+  std::memset(script->path, 0, sizeof(script->path));
+  std::memcpy(script->path, path.data(), length);
+  script->amx = key;
+}
+
+std::size_t FlightRecorder::GetNumEvents() const {
+  uint32_t count = next_->load(std::memory_order_relaxed);
+  return count < capacity_ ? count : capacity_;
+}
+
+const FlightRecorder::Event &FlightRecorder::GetEvent(std::size_t age) const {
+  uint32_t position = next_->load(std::memory_order_relaxed)
+    - 1 - static_cast<uint32_t>(age);
+  return events_[position & mask_];
+}
+
+// static
+uint32_t FlightRecorder::GetTime() {
+  return static_cast<uint32_t>(fastclock::Now()) & kTimeMask;
+}
@@ -0,0 +1,128 @@
+// Copyright (c) 2026 Zeex
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef FLIGHTRECORDER_H
+#define FLIGHTRECORDER_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <amx/amx.h>
+#include "mappedfile.h"
+
+// Remembers the last few public and native calls and returns of all
+// scripts, so that crashes and errors can show what led up to them even
+// when nothing is being traced. Events are written to a fixed-size ring
+// without locking or formatting anything; they are only decoded when
+// they're printed. Threads share the ring, so an event written by another
+// thread at the same time may come out garbled.
+//
+// The ring can also be kept in a memory-mapped file rather than in the
+// heap. The system writes it back to the file by itself, so it can still
+// be read with tools/decodeflight.py after the server is killed or dies
+// in a way that leaves no chance to print anything.
+class FlightRecorder {
+ public:
+  enum EventType {
+    PUBLIC_CALL,
+    PUBLIC_RETURN,
+    NATIVE_CALL,
+    NATIVE_RETURN
+  };
+
+  struct Event {
+    AMX *amx;
+    cell index;
+    // The lowest 30 bits of fastclock::Now() and the type.
+    uint32_t time_and_type;
+
+    EventType type() const
+      { return static_cast<EventType>(time_and_type & 3); }
+    uint32_t time() const
+      { return time_and_type >> 2; }
+  };
+
+  static const uint32_t kTimeMask = 0x3FFFFFFF;
+  static const std::size_t kMaxScripts = 64;
+  static const std::size_t kMaxScriptPathLength = 247;
+
+  // Must be called before anything is recorded. The capacity is rounded up
+  // to a power of two, 0 turns the recorder off. If a path is given, the
+  // events are kept in that file; when the file can't be created this
+  // returns false and they are kept in memory instead.
+  bool SetCapacity(std::size_t capacity,
+                   const std::string &path = std::string());
+
+  bool IsEnabled() const { return capacity_ != 0; }
+  bool IsFileBacked() const { return file_.IsOpen(); }
+
+  // Remembers the path of a script in the file so that the decoder can
+  // find its public and native names. Does nothing without a file.
+  void AddScript(AMX *amx, const std::string &path);
+
+  void Record(EventType type, AMX *amx, cell index) {
+    uint32_t position = next_->fetch_add(1, std::memory_order_relaxed);
+    Event &event = events_[position & mask_];
+    event.amx = amx;
+    event.index = index;
+    event.time_and_type = (GetTime() << 2) | type;
+  }
+
+  // The number of events that can be read with GetEvent(). It's smaller
+  // than the capacity until the ring fills up.
+  std::size_t GetNumEvents() const;
+  // Returns the age-th newest event (0 being the newest).
+  const Event &GetEvent(std::size_t age) const;
+
+  static FlightRecorder &shared();
+
+ private:
+  FlightRecorder();
+
+  FlightRecorder(const FlightRecorder &) = delete;
+  FlightRecorder &operator=(const FlightRecorder &) = delete;
+
+  static uint32_t GetTime();
+
+  struct FileHeader;
+  struct FileScript;
+
+  bool CreateRingFile(std::size_t capacity, const std::string &path);
+
+ private:
+  Event *events_;
+  std::size_t capacity_;
+  uint32_t mask_;
+  // Points to local_next_ or into the file header.
+  std::atomic<uint32_t> *next_;
+  std::atomic<uint32_t> local_next_;
+  std::vector<Event> storage_;
+  MappedFile file_;
+  FileScript *scripts_;
+  std::size_t next_script_;
+};
+
+#endif // !FLIGHTRECORDER_H
@@ -0,0 +1,123 @@
+// Copyright (c) 2026 Zeex
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <algorithm>
+#include "hangwatchdog.h"
+#include "threadpolicy.h"
+
+namespace {
+
+// A hang may be reported up to 1/kChecksPerTimeout later than it should.
+const int64_t kChecksPerTimeout = 10;
+
+const std::chrono::milliseconds kMinCheckInterval(10);
+const std::chrono::milliseconds kMaxCheckInterval(1000);
+
+} // anonymous namespace
+
+HangWatchdog::HangWatchdog()
+  : timeout_(0),
+    hang_handler_(nullptr),
+    recover_handler_(nullptr),
+    last_heartbeat_(0),
+    stop_thread_(false)
+{
+}
+
+HangWatchdog::~HangWatchdog() {
+  Stop();
+}
+
+// static
+HangWatchdog &HangWatchdog::shared() {
+  static HangWatchdog watchdog;
+  return watchdog;
+}
+
+void HangWatchdog::Start(std::chrono::microseconds timeout,
+                         HangHandler hang_handler,
+                         RecoverHandler recover_handler) {
+  if (thread_.joinable()) {
+    return;
+  }
+  timeout_ = timeout;
+  hang_handler_ = hang_handler;
+  recover_handler_ = recover_handler;
+  stop_thread_ = false;
+  thread_ = std::thread(&HangWatchdog::Run, this);
+}
+
+void HangWatchdog::Stop() {
+  if (!thread_.joinable()) {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_thread_ = true;
+  }
+  cond_var_.notify_all();
+  thread_.join();
+}
+
+void HangWatchdog::Run() {
+  ApplyThreadPolicy(THREAD_CLASS_WATCHDOG);
+  std::chrono::microseconds interval = timeout_ / kChecksPerTimeout;
+  interval = std::max<std::chrono::microseconds>(interval, kMinCheckInterval);
+  interval = std::min<std::chrono::microseconds>(interval, kMaxCheckInterval);
+
+  // The heartbeat of the hang that has been reported, or 0.
+  int64_t hang_heartbeat = 0;
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (!stop_thread_) {
+    cond_var_.wait_for(lock, interval);
+    if (stop_thread_) {
+      break;
+    }
+    int64_t heartbeat = last_heartbeat_.load(std::memory_order_relaxed);
+    if (heartbeat == 0) {
+      continue;
+    }
+    int64_t now = fastclock::Now();
+    if (hang_heartbeat != 0) {
+      if (heartbeat != hang_heartbeat) {
+        if (recover_handler_ != nullptr) {
+          lock.unlock();
+          recover_handler_(
+            std::chrono::microseconds(heartbeat - hang_heartbeat));
+          lock.lock();
+        }
+        hang_heartbeat = 0;
+      }
+      continue;
+    }
+    if (now - heartbeat >= timeout_.count()) {
+      hang_heartbeat = heartbeat;
+      if (hang_handler_ != nullptr) {
+        lock.unlock();
+        hang_handler_(std::chrono::microseconds(now - heartbeat));
+        lock.lock();
+      }
+    }
+  }
+}
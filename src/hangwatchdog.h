@@ -0,0 +1,82 @@
+// Copyright (c) 2026 Zeex
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef HANGWATCHDOG_H
+#define HANGWATCHDOG_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include "fastclock.h"
+
+// Notices when the server thread stops making progress: it hasn't finished
+// a tick or returned from a top-level call into a script for longer than the
+// timeout. Unlike LongCallWatchdog this doesn't depend on the VM checking
+// for anything, so it also catches hangs inside natives and other plugins.
+// The server thread reports progress with Heartbeat(); the watchdog only
+// starts paying attention after the first one.
+class HangWatchdog {
+ public:
+  // Called on the watchdog thread once per hang.
+  typedef void (*HangHandler)(std::chrono::microseconds duration);
+  // Called on the watchdog thread when a reported hang is over.
+  typedef void (*RecoverHandler)(std::chrono::microseconds duration);
+
+  void Start(std::chrono::microseconds timeout,
+             HangHandler hang_handler,
+             RecoverHandler recover_handler);
+  void Stop();
+
+  bool IsRunning() const { return thread_.joinable(); }
+
+  void Heartbeat() {
+    last_heartbeat_.store(fastclock::Now(), std::memory_order_relaxed);
+  }
+
+  static HangWatchdog &shared();
+
+ private:
+  HangWatchdog();
+  ~HangWatchdog();
+
+  HangWatchdog(const HangWatchdog &) = delete;
+  HangWatchdog &operator=(const HangWatchdog &) = delete;
+
+  void Run();
+
+ private:
+  std::chrono::microseconds timeout_;
+  HangHandler hang_handler_;
+  RecoverHandler recover_handler_;
+  std::atomic<int64_t> last_heartbeat_;  // fastclock::Now() time, or 0
+  bool stop_thread_;
+  std::mutex mutex_;
+  std::condition_variable cond_var_;
+  std::thread thread_;
+};
+
+#endif // !HANGWATCHDOG_H
@@ -0,0 +1,73 @@
+// Copyright (c) 2026 Zeex
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <utility>
+#include "fastclock.h"
+#include "idlescheduler.h"
+#include "workqueue.h"
+
+void IdleScheduler::PostBackground(std::function<void()> job) {
+  WorkQueue::shared().Submit(std::move(job));
+}
+
+void IdleScheduler::PostMain(MainJob job) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  main_jobs_.push_back(std::move(job));
+}
+
+void IdleScheduler::RunMainJobs(int64_t deadline) {
+  // Jobs posted while running (including the unfinished ones that are put
+  // back) wait for the next tick.
+  std::size_t num_jobs;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    num_jobs = main_jobs_.size();
+  }
+  for (std::size_t i = 0; i < num_jobs && fastclock::Now() < deadline; i++) {
+    MainJob job;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (main_jobs_.empty()) {
+        break;
+      }
+      job = std::move(main_jobs_.front());
+      main_jobs_.pop_front();
+    }
+    if (!job(deadline)) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      main_jobs_.push_back(std::move(job));
+    }
+  }
+}
+
+void IdleScheduler::Clear() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  main_jobs_.clear();
+}
+
+// static
+IdleScheduler &IdleScheduler::shared() {
+  static IdleScheduler instance;
+  return instance;
+}
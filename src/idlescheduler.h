@@ -0,0 +1,70 @@
+// Copyright (c) 2026 Zeex
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef IDLESCHEDULER_H
+#define IDLESCHEDULER_H
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+
+// Runs maintenance work (integrity checks, exports and the like) where it
+// doesn't get in the way of scripts. Jobs that don't touch AMX memory go
+// to the worker threads of WorkQueue. Jobs that do are run on the server
+// thread from ProcessTick, a little at a time, within the time left of
+// each tick (see idle_budget).
+class IdleScheduler {
+ public:
+  // A job for the server thread is given the time (see fastclock) by which
+  // it should return. It returns true if it's done, or false to be called
+  // again on a later tick. Jobs can be posted from any thread but must not
+  // keep pointers to script handlers: a script may be unloaded between two
+  // ticks.
+  typedef std::function<bool(int64_t deadline)> MainJob;
+
+  void PostBackground(std::function<void()> job);
+  void PostMain(MainJob job);
+
+  // Gives each queued job a turn, in the order they were posted, until the
+  // deadline. Jobs that are not done go to the back of the queue. Called
+  // on the server thread.
+  void RunMainJobs(int64_t deadline);
+
+  // Drops the jobs queued for the server thread.
+  void Clear();
+
+  static IdleScheduler &shared();
+
+ private:
+  IdleScheduler() {}
+
+  IdleScheduler(const IdleScheduler &) = delete;
+  IdleScheduler &operator=(const IdleScheduler &) = delete;
+
+  std::mutex mutex_;
+  std::deque<MainJob> main_jobs_;
+};
+
+#endif // !IDLESCHEDULER_H
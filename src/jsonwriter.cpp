@@ -0,0 +1,138 @@
+// Copyright (c) 2026 Zeex
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <cstdio>
+#include <cstring>
+#include "jsonwriter.h"
+
+JSONWriter::JSONWriter()
+  : after_key_(false)
+{
+}
+
+void JSONWriter::BeginObject() {
+  BeginValue();
+  json_.push_back('{');
+  has_elements_.push_back(false);
+}
+
+void JSONWriter::EndObject() {
+  json_.push_back('}');
+  has_elements_.pop_back();
+}
+
+void JSONWriter::BeginArray() {
+  BeginValue();
+  json_.push_back('[');
+  has_elements_.push_back(false);
+}
+
+void JSONWriter::EndArray() {
+  json_.push_back(']');
+  has_elements_.pop_back();
+}
+
+void JSONWriter::Key(const char *key) {
+  BeginValue();
+  json_.push_back('"');
+  AppendEscaped(key, std::strlen(key));
+  json_.append("\":");
+  after_key_ = true;
+}
+
+void JSONWriter::String(const char *value) {
+  BeginValue();
+  json_.push_back('"');
+  AppendEscaped(value, std::strlen(value));
+  json_.push_back('"');
+}
+
+void JSONWriter::String(const std::string &value) {
+  BeginValue();
+  json_.push_back('"');
+  AppendEscaped(value.data(), value.length());
+  json_.push_back('"');
+}
+
+void JSONWriter::Int(long long value) {
+  BeginValue();
+  json_.append(std::to_string(value));
+}
+
+void JSONWriter::Bool(bool value) {
+  BeginValue();
+  json_.append(value ? "true" : "false");
+}
+
+void JSONWriter::Raw(const std::string &json) {
+  BeginValue();
+  json_.append(json);
+}
+
+void JSONWriter::BeginValue() {
+  if (after_key_) {
+    after_key_ = false;
+    return;
+  }
+  if (!has_elements_.empty()) {
+    if (has_elements_.back()) {
+      json_.push_back(',');
+    }
+    has_elements_.back() = true;
+  }
+}
+
+void JSONWriter::AppendEscaped(const char *s, std::string::size_type length) {
+  for (std::string::size_type i = 0; i < length; i++) {
+    char c = s[i];
+    switch (c) {
+      case '"':
+        json_.append("\\\"");
+        break;
+      case '\\':
+        json_.append("\\\\");
+        break;
+      case '\n':
+        json_.append("\\n");
+        break;
+      case '\r':
+        json_.append("\\r");
+        break;
+      case '\t':
+        json_.append("\\t");
+        break;
+      default:
+        // Pawn strings aren't necessarily valid UTF-8, so bytes outside of
+        // ASCII are escaped as if they were Latin-1.
+        unsigned char uc = static_cast<unsigned char>(c);
+        if (uc < 0x20 || uc >= 0x80) {
+          char buffer[8];
+          std::snprintf(buffer, sizeof(buffer), "\\u%04x", uc);
+          json_.append(buffer);
+        } else {
+          json_.push_back(c);
+        }
+    }
+  }
+}
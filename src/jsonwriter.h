@@ -0,0 +1,90 @@
+// Copyright (c) 2026 Zeex
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef JSONWRITER_H
+#define JSONWRITER_H
+
+#include <string>
+#include <vector>
+
+// Builds a single-line JSON document, e.g.:
+//
+//   JSONWriter json;
+//   json.BeginObject();
+//   json.Field("code", 4);
+//   json.Key("frames");
+//   json.BeginArray();
+//   ...
+//   json.EndArray();
+//   json.EndObject();
+//
+// Commas are inserted automatically.
+class JSONWriter {
+ public:
+  JSONWriter();
+
+  const std::string &str() const { return json_; }
+
+  void BeginObject();
+  void EndObject();
+  void BeginArray();
+  void EndArray();
+
+  void Key(const char *key);
+
+  void String(const char *value);
+  void String(const std::string &value);
+  void Int(long long value);
+  void Bool(bool value);
+
+  // Inserts a value produced by another JSONWriter.
+  void Raw(const std::string &json);
+
+  template<typename T>
+  void Field(const char *key, const T &value) {
+    Key(key);
+    Value(value);
+  }
+
+ private:
+  void Value(const char *value) { String(value); }
+  void Value(const std::string &value) { String(value); }
+  void Value(bool value) { Bool(value); }
+  void Value(int value) { Int(value); }
+  void Value(long value) { Int(value); }
+  void Value(long long value) { Int(value); }
+  void Value(unsigned int value) { Int(value); }
+  void Value(unsigned long value) { Int(static_cast<long long>(value)); }
+
+  void BeginValue();
+  void AppendEscaped(const char *s, std::string::size_type length);
+
+ private:
+  std::string json_;
+  // Whether the object or array at each level already has an element.
+  std::vector<bool> has_elements_;
+  bool after_key_;
+};
+
+#endif // !JSONWRITER_H
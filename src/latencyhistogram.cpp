@@ -0,0 +1,109 @@
+// Copyright (c) 2026 Zeex
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <algorithm>
+#include <cmath>
+#include "latencyhistogram.h"
+
+const int LatencyHistogram::kNumBuckets;
+
+LatencyHistogram::LatencyHistogram() {
+  Reset();
+}
+
+void LatencyHistogram::Record(int64_t value) {
+  if (value < 0) {
+    value = 0;
+  }
+  buckets_[GetBucket(value)]++;
+  count_++;
+  sum_ += value;
+  if (value > max_) {
+    max_ = value;
+  }
+}
+
+void LatencyHistogram::Reset() {
+  count_ = 0;
+  sum_ = 0;
+  max_ = 0;
+  std::fill(buckets_, buckets_ + kNumBuckets, 0);
+}
+
+void LatencyHistogram::Merge(const LatencyHistogram &other) {
+  for (int i = 0; i < kNumBuckets; i++) {
+    buckets_[i] += other.buckets_[i];
+  }
+  count_ += other.count_;
+  sum_ += other.sum_;
+  max_ = std::max(max_, other.max_);
+}
+
+int64_t LatencyHistogram::GetPercentile(double percentile) const {
+  if (count_ == 0) {
+    return 0;
+  }
+  uint64_t rank = static_cast<uint64_t>(
+    std::ceil(count_ * std::min(std::max(percentile, 0.0), 100.0) / 100.0));
+  if (rank == 0) {
+    rank = 1;
+  }
+  uint64_t seen = 0;
+  for (int i = 0; i < kNumBuckets; i++) {
+    seen += buckets_[i];
+    if (seen >= rank) {
+      if (i == kNumBuckets - 1) {
+        break;
+      }
+      return std::min(GetBucketUpperBound(i), max_);
+    }
+  }
+  return max_;
+}
+
+// static
+int LatencyHistogram::GetBucket(int64_t value) {
+  if (value < 16) {
+    return static_cast<int>(value);
+  }
+  int exponent = 4;
+  while (exponent < 39 && (value >> (exponent + 1)) != 0) {
+    exponent++;
+  }
+  if ((value >> (exponent + 1)) != 0) {
+    return kNumBuckets - 1;  // over 2^40 us, i.e. almost two weeks
+  }
+  int mantissa = static_cast<int>((value >> (exponent - 3)) & 7);
+  return 16 + (exponent - 4) * 8 + mantissa;
+}
+
+// static
+int64_t LatencyHistogram::GetBucketUpperBound(int bucket) {
+  if (bucket < 16) {
+    return bucket;
+  }
+  int exponent = 4 + (bucket - 16) / 8;
+  int mantissa = (bucket - 16) % 8;
+  return ((static_cast<int64_t>(9 + mantissa)) << (exponent - 3)) - 1;
+}
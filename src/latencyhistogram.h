@@ -0,0 +1,65 @@
+// Copyright (c) 2026 Zeex
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef LATENCYHISTOGRAM_H
+#define LATENCYHISTOGRAM_H
+
+#include <cstdint>
+
+// Counts durations (in microseconds) in logarithmic buckets: values below
+// 16 get a bucket each, and every power of two above that is split into 8
+// buckets, so percentiles are accurate to about 12%, however large the
+// values are.
+class LatencyHistogram {
+ public:
+  LatencyHistogram();
+
+  void Record(int64_t value);
+  void Reset();
+
+  // Adds all values recorded by another histogram to this one.
+  void Merge(const LatencyHistogram &other);
+
+  uint64_t count() const { return count_; }
+  int64_t sum() const { return sum_; }
+  int64_t max() const { return max_; }
+
+  // Returns the upper bound of the bucket that contains the percentile-th
+  // value (0-100), or 0 if nothing has been recorded.
+  int64_t GetPercentile(double percentile) const;
+
+ private:
+  static const int kNumBuckets = 16 + 36 * 8;
+
+  static int GetBucket(int64_t value);
+  static int64_t GetBucketUpperBound(int bucket);
+
+ private:
+  uint64_t count_;
+  int64_t sum_;
+  int64_t max_;
+  uint32_t buckets_[kNumBuckets];
+};
+
+#endif // !LATENCYHISTOGRAM_H
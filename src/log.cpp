@@ -46,33 +46,366 @@
 // ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
 // POSSIBILITY OF SUCH DAMAGE.
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <ctime>
 #include <cstdio>
 #include <cstring>
-#include <queue>
+#include <cstdlib>
+#include <cerrno>
 #include <mutex>
 #include <thread>
 #include <condition_variable>
+#include <deque>
+#include <functional>
 #include <memory>
+#include <utility>
+#include <vector>
+#ifdef _WIN32
+  #include <io.h>
+#else
+  #include <unistd.h>
+#endif
+#include "jsonwriter.h"
 #include "log.h"
 #include "logprintf.h"
 #include "options.h"
+#include "threadpolicy.h"
+#include "udpsocket.h"
 
 namespace {
 
 const size_t BUFFER_SIZE = 8192; // 8 kb buffer
 
-class Log {
+// Size of each thread's trace ring, in bytes.
+const size_t TRACE_RING_SIZE = 1024 * 1024;
+
+// Number of entries the log queue can hold before it starts spilling into
+// the overflow list, and the initial size of an entry's buffer.
+const size_t QUEUE_SLOTS = 1024;
+const size_t SLOT_SIZE = 1024;
+
+// Longer lines are cut (this must be well below TRACE_RING_SIZE).
+const size_t MAX_LINE_LENGTH = 64 * 1024;
+
+// Whatever the flush policy, the log file is flushed at least this often
+// when there's something to flush.
+const std::chrono::milliseconds MAX_FLUSH_DELAY(1000);
+
+// How often the number of lines dropped because the queue was full is
+// reported.
+const std::chrono::seconds DROP_REPORT_INTERVAL(10);
+
+// Size of the buffer used for formatting lines in crash mode.
+const size_t CRASH_BUFFER_SIZE = 4096;
+
+// Lines printed together with LogDebugPrintLines() in crash mode are
+// collected into a buffer of this size before being written out.
+const size_t CRASH_BLOCK_SIZE = 16 * 1024;
+
+// How long Flush() waits for the log thread before giving up.
+const std::chrono::milliseconds FLUSH_TIMEOUT(1000);
+
+// Largest datagram sent to the network sink; this keeps them from being
+// fragmented on a typical Ethernet link.
+const size_t MAX_DATAGRAM_SIZE = 1400;
+
+// Prefix of syslog messages (facility "user", severity "informational").
+const char SYSLOG_PREFIX[] = "<14>crashdetect: ";
+
+// Text buffer that only ever grows, so that once a long line has been seen
+// the memory is reused for the following ones.
+class LineBuffer {
  public:
-  Log() : file_(nullptr), buffer_(new char[BUFFER_SIZE]), stop_thread_(false) {
-    const std::string &filename = Options::shared().log_path();
-    if (!filename.empty()) {
-      file_ = std::fopen(filename.c_str(), "a");
-      if (file_ != nullptr) {
-        std::setvbuf(file_, buffer_.get(), _IOFBF, BUFFER_SIZE);
+  LineBuffer(size_t size): data_(new char[size]), size_(size) {}
+
+  char *data() { return data_.get(); }
+  const char *data() const { return data_.get(); }
+  size_t size() const { return size_; }
+
+  // Makes room for at least size bytes. The old contents are discarded.
+  void Reserve(size_t size) {
+    if (size > size_) {
+      data_.reset(new char[size]);
+      size_ = size;
+    }
+  }
+
+ private:
+  std::unique_ptr<char[]> data_;
+  size_t size_;
+};
+
+// Bounded lock-free queue of fixed-size text slots with any number of
+// producers and one consumer. Each slot has a sequence number that tells
+// whose turn it is to use it (see Dmitry Vyukov's bounded MPMC queue).
+class SlotQueue {
+ public:
+  SlotQueue(size_t num_slots)
+    : slots_(new Slot[num_slots]),
+      mask_(num_slots - 1),
+      enqueue_pos_(0),
+      dequeue_pos_(0)
+  {
+    for (size_t i = 0; i < num_slots; i++) {
+      slots_[i].sequence.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  SlotQueue(const SlotQueue &) = delete;
+  SlotQueue &operator=(const SlotQueue &) = delete;
+
+  // Lets func write an entry straight into a free slot's buffer (which it
+  // may grow) and return its length. Returns false without calling func if
+  // the queue is full. See LogEntry for what prefix means.
+  template<typename Func>
+  bool TryPush(const char *prefix, Func func) {
+    size_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+    Slot *slot;
+    for (;;) {
+      slot = &slots_[pos & mask_];
+      size_t sequence = slot->sequence.load(std::memory_order_acquire);
+      std::ptrdiff_t diff = static_cast<std::ptrdiff_t>(sequence - pos);
+      if (diff == 0) {
+        if (enqueue_pos_.compare_exchange_weak(pos, pos + 1,
+                                               std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (diff < 0) {
+        return false;
+      } else {
+        pos = enqueue_pos_.load(std::memory_order_relaxed);
       }
     }
-    if (file_ != nullptr) {
+    slot->prefix = prefix;
+    slot->length = func(slot->text);
+    slot->sequence.store(pos + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Passes the oldest entry to func and removes it from the queue. Must
+  // only be called by the consumer.
+  template<typename Func>
+  bool Pop(Func func) {
+    Slot *slot = &slots_[dequeue_pos_ & mask_];
+    if (slot->sequence.load(std::memory_order_acquire) != dequeue_pos_ + 1) {
+      return false;
+    }
+    func(slot->prefix, slot->text.data(), slot->length);
+    slot->sequence.store(dequeue_pos_ + mask_ + 1, std::memory_order_release);
+    dequeue_pos_++;
+    return true;
+  }
+
+  bool IsEmpty() const {
+    const Slot *slot = &slots_[dequeue_pos_ & mask_];
+    return slot->sequence.load(std::memory_order_acquire) != dequeue_pos_ + 1;
+  }
+
+ private:
+  struct Slot {
+    Slot(): text(SLOT_SIZE) {}
+    std::atomic<size_t> sequence;
+    const char *prefix;
+    size_t length;
+    LineBuffer text;
+  };
+
+  std::unique_ptr<Slot[]> slots_;
+  size_t mask_;
+  std::atomic<size_t> enqueue_pos_;
+  size_t dequeue_pos_;
+};
+
+// An entry of the overflow list. Normally the text is a line that is ready
+// to be written, but if prefix is set, it's a whole report printed with
+// PrintLines() that's still missing the time stamp and prefix on each line.
+// Those are added by the log thread and the lines are written together.
+struct LogEntry {
+  LogEntry(const char *prefix, const char *text, size_t length)
+    : prefix(prefix),
+      text(text, length)
+  {
+  }
+  const char *prefix;
+  std::string text;
+};
+
+// The prefix of entries added with PrintDeferred(). Their text is a pointer
+// to a DeferredEntry, which the log thread formats and then deletes.
+const char DEFERRED_PREFIX[] = "";
+
+struct DeferredEntry {
+  const char *prefix;
+  std::function<std::string()> format;
+};
+
+// Lock-free single-producer single-consumer ring of characters. Trace
+// lines are written to it by the thread that prints them and read by the
+// trace thread.
+class CharRing {
+ public:
+  CharRing(size_t size)
+    : data_(new char[size]),
+      size_(size),
+      head_(0),
+      tail_(0)
+  {
+  }
+
+  CharRing(const CharRing &) = delete;
+  CharRing &operator=(const CharRing &) = delete;
+
+  // Returns false if there's not enough room for the whole string.
+  bool TryWrite(const char *data, size_t length) {
+    size_t head = head_.load(std::memory_order_relaxed);
+    size_t tail = tail_.load(std::memory_order_acquire);
+    if (size_ - (head - tail) < length) {
+      return false;
+    }
+    size_t offset = head % size_;
+    size_t first = std::min(length, size_ - offset);
+    std::memcpy(data_.get() + offset, data, first);
+    std::memcpy(data_.get(), data + first, length - first);
+    head_.store(head + length, std::memory_order_release);
+    return true;
+  }
+
+  bool IsEmpty() const {
+    return head_.load(std::memory_order_acquire)
+           == tail_.load(std::memory_order_acquire);
+  }
+
+  // Passes everything written so far to func in one or two chunks.
+  template<typename Func>
+  bool Read(Func func) {
+    size_t head = head_.load(std::memory_order_acquire);
+    size_t tail = tail_.load(std::memory_order_relaxed);
+    if (head == tail) {
+      return false;
+    }
+    size_t length = head - tail;
+    size_t offset = tail % size_;
+    size_t first = std::min(length, size_ - offset);
+    func(data_.get() + offset, first);
+    if (first < length) {
+      func(data_.get(), length - first);
+    }
+    tail_.store(head, std::memory_order_release);
+    return true;
+  }
+
+ private:
+  std::unique_ptr<char[]> data_;
+  size_t size_;
+  std::atomic<size_t> head_;
+  std::atomic<size_t> tail_;
+};
+
+// Collects lines written to the network sink and sends them in as few
+// datagrams as possible. Sending never waits: when the socket can't take a
+// datagram it is simply lost. Each writing thread has a batcher of its own.
+class SinkBatcher {
+ public:
+  SinkBatcher(UDPSocket &socket, bool syslog)
+    : socket_(socket),
+      syslog_(syslog)
+  {
+  }
+
+  // Data may end in the middle of a line; the remainder is kept until the
+  // rest of it comes in.
+  void Write(const char *data, size_t size) {
+    pending_.append(data, size);
+  }
+
+  // Sends all complete lines collected so far.
+  void Send() {
+    size_t begin = 0;
+    size_t end;
+    while ((end = pending_.find('\n', begin)) != std::string::npos) {
+      if (syslog_) {
+        // One message per datagram, without the trailing newline.
+        datagram_.assign(SYSLOG_PREFIX);
+        datagram_.append(pending_, begin, end - begin);
+        SendDatagram();
+      } else {
+        size_t length = end - begin + 1;
+        if (datagram_.size() + length > MAX_DATAGRAM_SIZE) {
+          SendDatagram();
+        }
+        datagram_.append(pending_, begin, length);
+      }
+      begin = end + 1;
+    }
+    pending_.erase(0, begin);
+    SendDatagram();
+  }
+
+ private:
+  void SendDatagram() {
+    if (!datagram_.empty()) {
+      socket_.Send(datagram_.data(), datagram_.size());
+      datagram_.clear();
+    }
+  }
+
+  UDPSocket &socket_;
+  bool syslog_;
+  std::string pending_;
+  std::string datagram_;
+};
+
+// Each channel (see LogChannel) that is enabled has a Log of its own, with
+// its own queue, threads, file and sink, so that a flood of lines in one of
+// them doesn't hold up the others.
+class Log {
+ public:
+  explicit Log(const LogChannelOptions &channel)
+    : file_(nullptr),
+      buffer_(new char[BUFFER_SIZE]),
+      use_file_(false),
+      json_(Options::shared().log_format() == LOG_FORMAT_JSONL),
+      file_size_(0),
+      max_file_size_(Options::shared().log_max_size()),
+      keep_files_(Options::shared().log_keep()),
+      compression_(Options::shared().log_compress()),
+      queue_(QUEUE_SLOTS),
+      max_overflow_size_(Options::shared().log_queue_size()),
+      overflow_policy_(Options::shared().log_queue_policy()),
+      overflow_size_(0),
+      has_overflow_(false),
+      dropped_lines_(0),
+      reported_dropped_lines_(0),
+      last_drop_report_time_(std::chrono::steady_clock::now()),
+      consumer_waiting_(false),
+      flush_policy_(Options::shared().log_flush_policy()),
+      flush_value_(Options::shared().log_flush_value()),
+      entry_line_(SLOT_SIZE),
+      pending_entries_(0),
+      pending_bytes_(0),
+      last_flush_time_(std::chrono::steady_clock::now()),
+      flush_requests_(0),
+      flushed_requests_(0),
+      stop_thread_(false),
+      stop_trace_thread_(false),
+      crash_mode_(false),
+      crash_fd_(-1),
+      use_sink_(false),
+      sink_syslog_(channel.sink_type == LOG_SINK_SYSLOG),
+      sink_batcher_(sink_, sink_syslog_),
+      trace_sink_batcher_(sink_, sink_syslog_)
+  {
+    crash_lock_.clear();
+    path_ = channel.path;
+    if (!path_.empty()) {
+      use_file_ = OpenFile();
+    }
+    if (channel.sink_type != LOG_SINK_NONE) {
+      use_sink_ = sink_.Open(channel.sink_host, channel.sink_port);
+    }
+    if (use_file_) {
       time_format_ = Options::shared().log_time_format();
     }
     log_thread_ = std::thread(&Log::ProcessQueue, this);
@@ -83,11 +416,18 @@ class Log {
 
   ~Log() {
     {
-      std::unique_lock<std::mutex> lock(mutex_);
+      std::lock_guard<std::mutex> lock(mutex_);
       stop_thread_ = true;
       cond_var_.notify_all();
     }
     log_thread_.join();
+    if (trace_thread_.joinable()) {
+      stop_trace_thread_ = true;
+      trace_thread_.join();
+    }
+    if (compress_thread_.joinable()) {
+      compress_thread_.join();
+    }
     if (file_ != nullptr) {
       std::fflush(file_); // flush that buffer
       std::fclose(file_);
@@ -95,70 +435,1109 @@ class Log {
   }
 
   void PrintV(const char *prefix, const char *format, std::va_list va) {
-    std::string new_format;
-    if (!time_format_.empty()) {
-      char time_buffer[64];
-      std::time_t time = std::time(nullptr);
-      std::strftime(time_buffer,
-                    sizeof(time_buffer),
-                    time_format_.c_str(),
-                    std::localtime(&time));
-      new_format.append(time_buffer);
-      new_format.append(" ");
-    }
-    new_format.append(prefix);
-    new_format.append(format);
-    new_format.append("\n");
-
-    char buffer[1024];
-    std::vsnprintf(buffer, sizeof(buffer), new_format.c_str(), va);
+    if (crash_mode_ && !json_) {
+      PrintCrashV(prefix, format, va);
+      return;
+    }
+    if (json_) {
+      PrintLine(FormatJSONMessageV(prefix, format, va));
+      return;
+    }
+    Push([&](LineBuffer &buffer) {
+      return FormatLineV(buffer, prefix, format, va);
+    });
+  }
+
+  // Prints each line of text (separated by '\n') as if by PrintV(), but
+  // keeps them together: they are queued as a single entry so that lines
+  // printed by other threads can't get in between, and the log thread adds
+  // the time stamp and prefix to each of them. In crash mode they are
+  // written out in one go.
+  void PrintLines(const char *prefix, const char *text, size_t length) {
+    const char *end = text + length;
+    if (!crash_mode_ && !json_ && length > 0 && length < MAX_LINE_LENGTH) {
+      Push(prefix, [&](LineBuffer &buffer) {
+        buffer.Reserve(length);
+        std::memcpy(buffer.data(), text, length);
+        return length;
+      });
+      return;
+    }
+    if (!crash_mode_ || json_) {
+      while (text < end) {
+        const char *line_end = FindLineEnd(text, end);
+        PrintFormatted(prefix, "%.*s", static_cast<int>(line_end - text), text);
+        text = line_end + 1;
+      }
+      return;
+    }
+    while (crash_lock_.test_and_set(std::memory_order_acquire)) {
+      std::this_thread::yield();
+    }
+    size_t block_length = 0;
+    while (text < end) {
+      if (CRASH_BLOCK_SIZE - block_length < CRASH_BUFFER_SIZE) {
+        WriteCrashOutput(crash_block_, block_length, false);
+        block_length = 0;
+      }
+      const char *line_end = FindLineEnd(text, end);
+      char *line = crash_block_ + block_length;
+      size_t line_length = std::min(
+        FormatLine(line, CRASH_BUFFER_SIZE, prefix,
+                   "%.*s", static_cast<int>(line_end - text), text),
+        CRASH_BUFFER_SIZE - 1);
+      if (use_sink_) {
+        SendCrashDatagram(line, line_length, false);
+      }
+      block_length += line_length;
+      text = line_end + 1;
+    }
+    WriteCrashOutput(crash_block_, block_length, false);
+    crash_lock_.clear(std::memory_order_release);
+  }
+
+  // Queues a multi-line entry like PrintLines() does, except that its text
+  // is made by format on the log thread.
+  void PrintDeferred(const char *prefix, std::function<std::string()> format) {
+    if (crash_mode_ || json_) {
+      std::string text = format();
+      PrintLines(prefix, text.data(), text.length());
+      return;
+    }
+    DeferredEntry *entry = new DeferredEntry;
+    entry->prefix = prefix;
+    entry->format = std::move(format);
+    Push(DEFERRED_PREFIX, [&](LineBuffer &buffer) {
+      std::memcpy(buffer.data(), &entry, sizeof(entry));
+      return sizeof(entry);
+    });
+  }
+
+  // Prints a line as is, without the time stamp and prefix.
+  void PrintLine(const std::string &line) {
+    if (crash_mode_) {
+      WriteCrash(line.data(), line.length(), true);
+      return;
+    }
+    Push([&](LineBuffer &buffer) {
+      return CopyLine(buffer, line);
+    });
+  }
+
+  // Adds an entry written into a buffer by format (which returns its length)
+  // to the queue.
+  template<typename Format>
+  void Push(Format format) {
+    Push(nullptr, format);
+  }
+
+  // Same as above but lets the entry span multiple lines that are to be
+  // prefixed by the log thread (see LogEntry).
+  template<typename Format>
+  void Push(const char *prefix, Format format) {
+    // Once the queue has overflowed, keep adding to the overflow list until
+    // it's written out so that entries stay in order.
+    if (has_overflow_ || !queue_.TryPush(prefix, format)) {
+      // The writer can't keep up: rather than waiting for it, put the entry
+      // aside. It will be written after what's currently in the queue.
+      LineBuffer &buffer = GetThreadLineBuffer();
+      size_t length = format(buffer);
+      std::unique_lock<std::mutex> lock(overflow_mutex_);
+      if (MakeRoomInOverflow(lock, length)) {
+        overflow_.emplace_back(prefix, buffer.data(), length);
+        overflow_size_ += length;
+        has_overflow_ = true;
+      } else {
+        dropped_lines_ += DiscardEntry(prefix, buffer.data(), length);
+      }
+    }
+
+    // Only wake up the log thread if it's actually waiting.
+    if (consumer_waiting_) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      cond_var_.notify_one();
+    }
+  }
 
+  // Returns the number of lines dropped so far because the queue was full.
+  unsigned long GetDroppedLines() const {
+    return dropped_lines_;
+  }
+
+  size_t GetQueuedBytes() {
+    std::lock_guard<std::mutex> lock(overflow_mutex_);
+    return overflow_size_;
+  }
+
+  // Waits until everything printed so far has been written to the log file
+  // and flushed to disk (but not longer than FLUSH_TIMEOUT).
+  void Flush() {
+    if (crash_mode_) {
+      return;
+    }
+    std::chrono::steady_clock::time_point deadline =
+      std::chrono::steady_clock::now() + FLUSH_TIMEOUT;
+
+    unsigned int request = ++flush_requests_;
     {
       std::lock_guard<std::mutex> lock(mutex_);
-      log_queue_.emplace(buffer);
+      cond_var_.notify_one();
+    }
+    while (static_cast<int>(flushed_requests_ - request) < 0
+           && std::chrono::steady_clock::now() < deadline) {
+      std::this_thread::yield();
+    }
+
+    for (;;) {
+      bool empty = true;
+      {
+        std::lock_guard<std::mutex> lock(trace_rings_mutex_);
+        for (size_t i = 0; i < trace_rings_.size(); i++) {
+          empty = empty && trace_rings_[i]->IsEmpty();
+        }
+      }
+      if (empty || std::chrono::steady_clock::now() >= deadline) {
+        break;
+      }
+      std::this_thread::yield();
+    }
+
+    if (use_file_) {
+      std::lock_guard<std::mutex> lock(file_mutex_);
+      if (file_ != nullptr) {
+        std::fflush(file_);
+      }
+    }
+  }
+
+  // Same as PrintV() but goes through the calling thread's trace ring
+  // instead of the queue, so it never waits on a lock or wakes up another
+  // thread. The trace thread polls the rings and writes out whatever has
+  // accumulated in one go.
+  void PrintTraceV(const char *prefix, const char *format, std::va_list va) {
+    if (crash_mode_ && !json_) {
+      PrintCrashV(prefix, format, va);
+      return;
+    }
+    if (json_) {
+      PrintTraceLine(FormatJSONMessageV(prefix, format, va));
+      return;
+    }
+    LineBuffer &buffer = GetThreadLineBuffer();
+    WriteTraceRing(buffer, FormatLineV(buffer, prefix, format, va));
+  }
+
+  void PrintTraceLine(const std::string &line) {
+    if (crash_mode_) {
+      WriteCrash(line.data(), line.length(), true);
+      return;
+    }
+    LineBuffer &buffer = GetThreadLineBuffer();
+    WriteTraceRing(buffer, CopyLine(buffer, line));
+  }
+
+  // Called when the server has crashed (or is about to exit). Writes out
+  // what's in the queue and the trace rings, then makes every following
+  // line bypass them and go straight to the log file (and stderr) with
+  // write(). Doesn't wait for the log thread longer than FLUSH_TIMEOUT in
+  // case it's the one that crashed.
+  void EnterCrashMode() {
+    if (crash_mode_) {
+      return;
+    }
+    Flush();
+    if (use_file_) {
+      // The crash could have happened while the file was locked.
+      std::chrono::steady_clock::time_point deadline =
+        std::chrono::steady_clock::now() + FLUSH_TIMEOUT;
+      bool locked;
+      while (!(locked = file_mutex_.try_lock())
+             && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::yield();
+      }
+      if (file_ != nullptr) {
+        std::fflush(file_);
+        #ifdef _WIN32
+          crash_fd_ = _fileno(file_);
+        #else
+          crash_fd_ = fileno(file_);
+        #endif
+      }
+      crash_mode_ = true;
+      if (locked) {
+        file_mutex_.unlock();
+      }
+    } else {
+      crash_mode_ = true;
     }
-    cond_var_.notify_one();
   }
 
  private:
-  void ProcessQueue() {
-    std::unique_lock<std::mutex> lock(mutex_);
-    while (!stop_thread_) {
-      cond_var_.wait(lock, [this] { return !log_queue_.empty() || stop_thread_; });
-      while (!log_queue_.empty()) {
-        const std::string &log_entry = log_queue_.front();
+  // Formats a line into a preallocated buffer, without allocating memory,
+  // and writes it out with WriteCrash().
+  void PrintCrashV(const char *prefix, const char *format, std::va_list va) {
+    while (crash_lock_.test_and_set(std::memory_order_acquire)) {
+      std::this_thread::yield();
+    }
+    size_t length = std::min(
+      FormatLineV(crash_buffer_, sizeof(crash_buffer_), prefix, format, va),
+      sizeof(crash_buffer_) - 1);
+    WriteCrashLocked(crash_buffer_, length, false);
+    crash_lock_.clear(std::memory_order_release);
+  }
+
+  void WriteCrash(const char *text, size_t length, bool add_newline) {
+    while (crash_lock_.test_and_set(std::memory_order_acquire)) {
+      std::this_thread::yield();
+    }
+    WriteCrashLocked(text, length, add_newline);
+    crash_lock_.clear(std::memory_order_release);
+  }
+
+  void WriteCrashLocked(const char *text, size_t length, bool add_newline) {
+    if (use_sink_) {
+      SendCrashDatagram(text, length, add_newline);
+    }
+    WriteCrashOutput(text, length, add_newline);
+  }
+
+  // Same as WriteCrashLocked() but doesn't send anything to the sink.
+  void WriteCrashOutput(const char *text, size_t length, bool add_newline) {
+    if (length == 0 && !add_newline) {
+      return;
+    }
+    if (crash_fd_ >= 0) {
+      WriteFD(crash_fd_, text, length);
+      WriteFD(2, text, length);
+      if (add_newline) {
+        WriteFD(crash_fd_, "\n", 1);
+        WriteFD(2, "\n", 1);
+      }
+    } else {
+      logprintf("%.*s", static_cast<int>(length), text);
+    }
+  }
+
+  // Sends a line to the network sink right away, one datagram per line.
+  // Must be called with crash_lock_ held.
+  void SendCrashDatagram(const char *text, size_t length, bool add_newline) {
+    size_t size = 0;
+    if (sink_syslog_) {
+      std::memcpy(crash_datagram_, SYSLOG_PREFIX, sizeof(SYSLOG_PREFIX) - 1);
+      size = sizeof(SYSLOG_PREFIX) - 1;
+      if (length > 0 && text[length - 1] == '\n') {
+        length--;
+      }
+      add_newline = false;
+    }
+    length = std::min(length, sizeof(crash_datagram_) - size - 1);
+    std::memcpy(crash_datagram_ + size, text, length);
+    size += length;
+    if (add_newline) {
+      crash_datagram_[size++] = '\n';
+    }
+    sink_.Send(crash_datagram_, size);
+  }
+
+  static void WriteFD(int fd, const char *data, size_t size) {
+    while (size > 0) {
+      #ifdef _WIN32
+        int n = _write(fd, data, static_cast<unsigned int>(size));
+      #else
+        ssize_t n = write(fd, data, size);
+        if (n < 0 && errno == EINTR) {
+          continue;
+        }
+      #endif
+      if (n <= 0) {
+        break;
+      }
+      data += n;
+      size -= static_cast<size_t>(n);
+    }
+  }
+
+  void WriteTraceRing(const LineBuffer &buffer, size_t length) {
+    CharRing *ring = GetThreadTraceRing();
+    while (!ring->TryWrite(buffer.data(), length)) {
+      std::this_thread::yield();
+    }
+  }
+
+  // Returns the current time formatted with time_format_ and followed by a
+  // space. The result is cached by each thread until the next second so that
+  // strftime() and localtime() (which takes a global lock) aren't called for
+  // every line.
+  const char *GetTimeStamp(size_t *length) {
+    static thread_local std::time_t cached_time = -1;
+    static thread_local char time_stamp[64];
+    static thread_local size_t time_stamp_length = 0;
+
+    std::time_t time = std::time(nullptr);
+    if (time != cached_time) {
+      std::tm tm;
+      #ifdef _WIN32
+        localtime_s(&tm, &time);
+      #else
+        localtime_r(&time, &tm);
+      #endif
+      time_stamp_length = std::strftime(time_stamp,
+                                        sizeof(time_stamp) - 1,
+                                        time_format_.c_str(),
+                                        &tm);
+      time_stamp[time_stamp_length++] = ' ';
+      cached_time = time;
+    }
+    *length = time_stamp_length;
+    return time_stamp;
+  }
+
+  // Applies crashdetect_log_queue_policy when adding length bytes to the
+  // overflow list would take it over crashdetect_log_queue_size. Returns
+  // false if the entry should be dropped. May temporarily unlock lock.
+  bool MakeRoomInOverflow(std::unique_lock<std::mutex> &lock, size_t length) {
+    if (max_overflow_size_ == 0) {
+      return true;
+    }
+    switch (overflow_policy_) {
+      case LOG_QUEUE_DROP_NEWEST:
+        return overflow_size_ + length <= max_overflow_size_;
+      case LOG_QUEUE_DROP_OLDEST:
+        while (!overflow_.empty()
+               && overflow_size_ + length > max_overflow_size_) {
+          const LogEntry &entry = overflow_.front();
+          overflow_size_ -= entry.text.size();
+          dropped_lines_ += DiscardEntry(entry.prefix,
+                                         entry.text.data(),
+                                         entry.text.size());
+          overflow_.pop_front();
+        }
+        return length <= max_overflow_size_;
+      case LOG_QUEUE_BLOCK:
+        // Wait for the log thread to take the overflow list (unless it's
+        // already gone, e.g. on shutdown).
+        while (!overflow_.empty()
+               && overflow_size_ + length > max_overflow_size_
+               && !stop_thread_) {
+          lock.unlock();
+          {
+            std::lock_guard<std::mutex> wake_lock(mutex_);
+            cond_var_.notify_one();
+          }
+          std::this_thread::sleep_for(std::chrono::milliseconds(1));
+          lock.lock();
+        }
+        return true;
+    }
+    return true;
+  }
+
+  // Writes how many lines have been dropped since the last report, if any.
+  // Called by the log thread.
+  void ReportDroppedLines() {
+    unsigned long dropped_lines = dropped_lines_;
+    if (dropped_lines == reported_dropped_lines_) {
+      return;
+    }
+    std::chrono::steady_clock::time_point now =
+      std::chrono::steady_clock::now();
+    if (now - last_drop_report_time_ < DROP_REPORT_INTERVAL
+        && !stop_thread_) {
+      return;
+    }
+    WriteMessage("[debug] ",
+                 "Dropped %lu log lines in the last %ld seconds "
+                 "(log queue is full)",
+                 dropped_lines - reported_dropped_lines_,
+                 static_cast<long>(
+                   std::chrono::duration_cast<std::chrono::seconds>(
+                     now - last_drop_report_time_).count()));
+    reported_dropped_lines_ = dropped_lines;
+    last_drop_report_time_ = now;
+  }
+
+  // Formats a message and writes it out directly instead of putting it in
+  // the queue. Only for use by the log thread.
+  void WriteMessage(const char *prefix, const char *format, ...) {
+    std::va_list va;
+    va_start(va, format);
+    if (json_) {
+      std::string line = FormatJSONMessageV(prefix, format, va);
+      line.push_back('\n');
+      WriteEntry(line.data(), line.length());
+    } else {
+      LineBuffer buffer(SLOT_SIZE);
+      size_t length = FormatLineV(buffer, prefix, format, va);
+      WriteEntry(buffer.data(), length);
+    }
+    va_end(va);
+  }
+
+  // Copies line into buffer followed by a newline and returns its length.
+  size_t CopyLine(LineBuffer &buffer, const std::string &line) {
+    size_t length = std::min(line.length(), MAX_LINE_LENGTH - 2);
+    buffer.Reserve(length + 2);
+    std::memcpy(buffer.data(), line.data(), length);
+    buffer.data()[length++] = '\n';
+    buffer.data()[length] = '\0';
+    return length;
+  }
+
+  // Wraps a message printed with LogDebugPrint() or LogTracePrint() into a
+  // JSON object for crashdetect_log_format jsonl: the prefix ("[debug] ")
+  // becomes the level.
+  std::string FormatJSONMessageV(const char *prefix,
+                                 const char *format,
+                                 std::va_list va) {
+    std::string message;
+    std::va_list args;
+    va_copy(args, va);
+    int length = std::vsnprintf(nullptr, 0, format, args);
+    va_end(args);
+    if (length > 0) {
+      message.resize(static_cast<size_t>(length) + 1);
+      va_copy(args, va);
+      std::vsnprintf(&message[0], message.size(), format, args);
+      va_end(args);
+      message.resize(static_cast<size_t>(length));
+    }
+
+    std::string level(prefix);
+    level.erase(std::remove(level.begin(), level.end(), '['), level.end());
+    level = level.substr(0, level.find(']'));
+
+    JSONWriter json;
+    json.BeginObject();
+    json.Field("time", LogGetTime());
+    json.Field("type", "message");
+    json.Field("level", level);
+    json.Field("message", message);
+    json.EndObject();
+    return json.str();
+  }
+
+  // Formats a log line into buffer, growing it if needed, and returns its
+  // length. The message is normally formatted only once: only if it didn't
+  // fit is the buffer resized and the message formatted again.
+  size_t FormatLineV(LineBuffer &buffer,
+                     const char *prefix,
+                     const char *format,
+                     std::va_list va) {
+    size_t length = FormatLineV(buffer.data(),
+                                buffer.size(),
+                                prefix,
+                                format,
+                                va);
+    if (length + 1 > buffer.size() && buffer.size() < MAX_LINE_LENGTH) {
+      buffer.Reserve(std::min(length + 1, MAX_LINE_LENGTH));
+      length = FormatLineV(buffer.data(), buffer.size(), prefix, format, va);
+    }
+    return std::min(length, buffer.size() - 1);
+  }
+
+  // Returns how many lines an entry would be written as.
+  static unsigned long CountLines(const char *prefix,
+                                  const char *text,
+                                  size_t length) {
+    if (prefix == nullptr) {
+      return 1;
+    }
+    const char *end = text + length;
+    unsigned long count = 0;
+    while (text < end) {
+      text = FindLineEnd(text, end) + 1;
+      count++;
+    }
+    return count;
+  }
+
+  // Same as CountLines() for an entry that is dropped. Deferred entries
+  // are freed without being formatted and count as one line.
+  static unsigned long DiscardEntry(const char *prefix,
+                                    const char *text,
+                                    size_t length) {
+    if (prefix == DEFERRED_PREFIX) {
+      delete TakeDeferredEntry(text, length);
+      return 1;
+    }
+    return CountLines(prefix, text, length);
+  }
+
+  static DeferredEntry *TakeDeferredEntry(const char *text, size_t length) {
+    DeferredEntry *entry = nullptr;
+    if (length == sizeof(entry)) {
+      std::memcpy(&entry, text, sizeof(entry));
+    }
+    return entry;
+  }
+
+  static const char *FindLineEnd(const char *text, const char *end) {
+    const char *newline = static_cast<const char *>(
+      std::memchr(text, '\n', end - text));
+    return newline != nullptr ? newline : end;
+  }
+
+  void PrintFormatted(const char *prefix, const char *format, ...) {
+    std::va_list va;
+    va_start(va, format);
+    PrintV(prefix, format, va);
+    va_end(va);
+  }
+
+  size_t FormatLine(LineBuffer &buffer,
+                    const char *prefix,
+                    const char *format,
+                    ...) {
+    std::va_list va;
+    va_start(va, format);
+    size_t length = FormatLineV(buffer, prefix, format, va);
+    va_end(va);
+    return length;
+  }
+
+  size_t FormatLine(char *buffer,
+                    size_t size,
+                    const char *prefix,
+                    const char *format,
+                    ...) {
+    std::va_list va;
+    va_start(va, format);
+    size_t length = FormatLineV(buffer, size, prefix, format, va);
+    va_end(va);
+    return length;
+  }
+
+  // Formats a log line (time stamp, prefix, message and a newline) and
+  // returns the length it would have, not counting the terminating NUL.
+  // Lines that don't fit into the buffer are cut but still end with a
+  // newline.
+  size_t FormatLineV(char *buffer,
+                     size_t size,
+                     const char *prefix,
+                     const char *format,
+                     std::va_list va) {
+    // Leave room for the newline and NUL.
+    size_t max_length = size - 2;
+    size_t length = 0;
+
+    if (!time_format_.empty()) {
+      size_t time_stamp_length;
+      const char *time_stamp = GetTimeStamp(&time_stamp_length);
+      length = std::min(time_stamp_length, max_length);
+      std::memcpy(buffer, time_stamp, length);
+    }
+
+    size_t prefix_length = std::min(std::strlen(prefix), max_length - length);
+    std::memcpy(buffer + length, prefix, prefix_length);
+    length += prefix_length;
+
+    // vsnprintf() may be called again if the line doesn't fit, so use a copy.
+    std::va_list args;
+    va_copy(args, va);
+    int message_length = std::vsnprintf(buffer + length,
+                                        max_length - length + 1,
+                                        format,
+                                        args);
+    va_end(args);
+
+    size_t full_length = length + 1;
+    if (message_length > 0) {
+      full_length += static_cast<size_t>(message_length);
+      length += std::min(static_cast<size_t>(message_length),
+                         max_length - length);
+    }
+
+    buffer[length++] = '\n';
+    buffer[length] = '\0';
+    return full_length;
+  }
+
+  bool OpenFile() {
+    file_ = std::fopen(path_.c_str(), "a");
+    if (file_ == nullptr) {
+      return false;
+    }
+    std::setvbuf(file_, buffer_.get(), _IOFBF, BUFFER_SIZE);
+    std::fseek(file_, 0, SEEK_END);
+    long size = std::ftell(file_);
+    file_size_ = size > 0 ? static_cast<size_t>(size) : 0;
+    return true;
+  }
+
+  // Must be called with file_mutex_ locked.
+  void WriteFile(const char *data, size_t size) {
+    if (crash_mode_) {
+      // Something was still queued: keep the order with crash output.
+      WriteCrash(data, size, false);
+      return;
+    }
+    if (file_ != nullptr) {
+      std::fwrite(data, 1, size, file_);
+      file_size_ += size;
+    }
+  }
+
+  // Starts a new log file once the current one has reached the maximum size
+  // (crashdetect_log_max_size). Old files are renamed to <name>.1, <name>.2
+  // and so on, and only the last crashdetect_log_keep of them are kept. Must
+  // be called with file_mutex_ locked and only in between complete lines.
+  void RotateFileIfNeeded() {
+    if (max_file_size_ == 0
+        || file_size_ < max_file_size_
+        || file_ == nullptr) {
+      return;
+    }
+
+    std::fclose(file_);
+    file_ = nullptr;
+
+    // Files are renamed only after the previous one has been compressed.
+    if (compress_thread_.joinable()) {
+      compress_thread_.join();
+    }
+
+    if (keep_files_ == 0) {
+      std::remove(path_.c_str());
+    } else {
+      const char *extension = GetCompressedFileExtension();
+      std::remove(GetRotatedFileName(keep_files_, extension).c_str());
+      for (unsigned int i = keep_files_ - 1; i >= 1; i--) {
+        std::rename(GetRotatedFileName(i, extension).c_str(),
+                    GetRotatedFileName(i + 1, extension).c_str());
+      }
+      std::string rotated_path = GetRotatedFileName(1, "");
+      std::remove(rotated_path.c_str());
+      std::rename(path_.c_str(), rotated_path.c_str());
+      if (compression_ != LOG_COMPRESSION_NONE) {
+        compress_thread_ = std::thread(&Log::CompressFile, this, rotated_path);
+      }
+    }
+
+    OpenFile();
+  }
+
+  std::string GetRotatedFileName(unsigned int index, const char *extension) {
+    return path_ + "." + std::to_string(index) + extension;
+  }
+
+  const char *GetCompressedFileExtension() const {
+    switch (compression_) {
+      case LOG_COMPRESSION_GZIP:
+        return ".gz";
+      case LOG_COMPRESSION_ZSTD:
+        return ".zst";
+      default:
+        return "";
+    }
+  }
+
+  // Compresses a rotated log file in place with an external gzip or zstd
+  // command running at the lowest priority.
+  void CompressFile(std::string path) {
+    ApplyThreadPolicy(THREAD_CLASS_LOG);
+    std::string command;
+    #ifdef _WIN32
+      command = "start \"\" /b /low /wait ";
+    #else
+      command = "nice -n 19 ";
+    #endif
+    switch (compression_) {
+      case LOG_COMPRESSION_GZIP:
+        command += "gzip -f \"" + path + "\"";
+        break;
+      case LOG_COMPRESSION_ZSTD:
+        command += "zstd -q -f --rm \"" + path + "\"";
+        break;
+      default:
+        return;
+    }
+    std::system(command.c_str());
+  }
+
+  // Writes an entry taken from the queue or the overflow list. Multi-line
+  // entries are split into lines here, each with its own time stamp and
+  // prefix.
+  void WriteEntry(const char *prefix, const char *text, size_t length) {
+    if (prefix == nullptr) {
+      WriteEntry(text, length);
+      return;
+    }
+    if (prefix == DEFERRED_PREFIX) {
+      std::unique_ptr<DeferredEntry> entry(TakeDeferredEntry(text, length));
+      if (entry) {
+        std::string deferred_text = entry->format();
+        WriteEntry(entry->prefix, deferred_text.data(), deferred_text.size());
+      }
+      return;
+    }
+    const char *end = text + length;
+    while (text < end) {
+      const char *line_end = FindLineEnd(text, end);
+      size_t line_length = FormatLine(entry_line_,
+                                      prefix,
+                                      "%.*s",
+                                      static_cast<int>(line_end - text),
+                                      text);
+      WriteEntry(entry_line_.data(), line_length);
+      text = line_end + 1;
+    }
+  }
+
+  // Entries are collected into batch_ and written with a single fwrite()
+  // once the queue has been drained.
+  void WriteEntry(const char *text, size_t length) {
+    if (use_sink_) {
+      sink_batcher_.Write(text, length);
+    }
+    if (use_file_) {
+      batch_.append(text, length);
+      pending_entries_++;
+      pending_bytes_ += length;
+    } else {
+      logprintf("%s", std::string(text, length).c_str());
+    }
+  }
+
+  void WriteBatch() {
+    if (use_sink_) {
+      sink_batcher_.Send();
+    }
+    if (!batch_.empty()) {
+      std::lock_guard<std::mutex> lock(file_mutex_);
+      WriteFile(batch_.data(), batch_.size());
+      RotateFileIfNeeded();
+      batch_.clear();
+    }
+  }
+
+  bool ShouldFlush(bool force) const {
+    if (pending_entries_ == 0) {
+      return false;
+    }
+    if (force) {
+      return true;
+    }
+    std::chrono::steady_clock::duration since_last_flush =
+      std::chrono::steady_clock::now() - last_flush_time_;
+    if (since_last_flush >= MAX_FLUSH_DELAY) {
+      return true;
+    }
+    switch (flush_policy_) {
+      case LOG_FLUSH_BATCH:
+        return true;
+      case LOG_FLUSH_ENTRIES:
+        return pending_entries_ >= flush_value_;
+      case LOG_FLUSH_BYTES:
+        return pending_bytes_ >= flush_value_;
+      case LOG_FLUSH_INTERVAL:
+        return since_last_flush >= std::chrono::milliseconds(flush_value_);
+    }
+    return true;
+  }
+
+  void FlushIfNeeded(bool force) {
+    if (use_file_ && ShouldFlush(force)) {
+      {
+        std::lock_guard<std::mutex> lock(file_mutex_);
         if (file_ != nullptr) {
-          std::fwrite(log_entry.data(), 1, log_entry.size(), file_);
-          std::fflush(file_); // flush that shit
+          std::fflush(file_);
+        }
+      }
+      pending_entries_ = 0;
+      pending_bytes_ = 0;
+      last_flush_time_ = std::chrono::steady_clock::now();
+    }
+  }
+
+  bool WriteQueue() {
+    bool written = false;
+    while (queue_.Pop([this](const char *prefix,
+                             const char *text,
+                             size_t length) {
+      WriteEntry(prefix, text, length);
+    })) {
+      written = true;
+    }
+    if (has_overflow_) {
+      std::deque<LogEntry> overflow;
+      {
+        std::lock_guard<std::mutex> lock(overflow_mutex_);
+        overflow.swap(overflow_);
+        overflow_size_ = 0;
+        has_overflow_ = false;
+      }
+      for (size_t i = 0; i < overflow.size(); i++) {
+        WriteEntry(overflow[i].prefix,
+                   overflow[i].text.data(),
+                   overflow[i].text.size());
+      }
+      written = written || !overflow.empty();
+    }
+    ReportDroppedLines();
+    WriteBatch();
+    return written;
+  }
+
+  void ProcessQueue() {
+    ApplyThreadPolicy(THREAD_CLASS_LOG);
+    std::chrono::milliseconds wait_time(100);
+    if (flush_policy_ == LOG_FLUSH_INTERVAL) {
+      wait_time = std::min(wait_time, std::chrono::milliseconds(flush_value_));
+    }
+    for (;;) {
+      bool stop = stop_thread_;
+      unsigned int flush_request = flush_requests_;
+      bool written = WriteQueue();
+      FlushIfNeeded(flush_request != flushed_requests_);
+      flushed_requests_ = flush_request;
+      if (written) {
+        continue;
+      }
+      if (stop) {
+        break;
+      }
+      std::unique_lock<std::mutex> lock(mutex_);
+      consumer_waiting_ = true;
+      // The timeout is mostly a safety net; producers wake us up when they
+      // see consumer_waiting_ set. It also lets delayed flushes happen.
+      cond_var_.wait_for(lock, wait_time, [this] {
+        return stop_thread_
+               || has_overflow_
+               || !queue_.IsEmpty()
+               || flush_requests_ != flushed_requests_;
+      });
+      consumer_waiting_ = false;
+    }
+  }
+
+  LineBuffer &GetThreadLineBuffer() {
+    static thread_local LineBuffer buffer(SLOT_SIZE);
+    return buffer;
+  }
+
+  CharRing *GetThreadTraceRing() {
+    // Rings live as long as the log, so it's safe to keep a pointer to it.
+    static thread_local CharRing *ring = nullptr;
+    if (ring == nullptr) {
+      std::lock_guard<std::mutex> lock(trace_rings_mutex_);
+      trace_rings_.emplace_back(new CharRing(TRACE_RING_SIZE));
+      ring = trace_rings_.back().get();
+      if (!trace_thread_.joinable()) {
+        trace_thread_ = std::thread(&Log::ProcessTraceRings, this);
+      }
+    }
+    return ring;
+  }
+
+  bool WriteTraceRings() {
+    bool written = false;
+    std::lock_guard<std::mutex> lock(trace_rings_mutex_);
+    // Keep the file locked until all rings have been read, otherwise the log
+    // thread could write in between the two parts of a wrapped-around line.
+    std::unique_lock<std::mutex> file_lock(file_mutex_, std::defer_lock);
+    if (use_file_) {
+      file_lock.lock();
+    }
+    for (size_t i = 0; i < trace_rings_.size(); i++) {
+      written |= trace_rings_[i]->Read([this](const char *data, size_t size) {
+        if (use_sink_) {
+          trace_sink_batcher_.Write(data, size);
+        }
+        if (use_file_) {
+          WriteFile(data, size);
         } else {
-          logprintf("%s", log_entry.c_str());
+          // logprintf() needs whole lines.
+          trace_line_.append(data, size);
+          size_t begin = 0;
+          size_t end;
+          while ((end = trace_line_.find('\n', begin)) != std::string::npos) {
+            logprintf("%s", trace_line_.substr(begin, end - begin + 1).c_str());
+            begin = end + 1;
+          }
+          trace_line_.erase(0, begin);
         }
-        log_queue_.pop();
+      });
+    }
+    if (written && file_ != nullptr) {
+      std::fflush(file_);
+      RotateFileIfNeeded();
+    }
+    if (written && use_sink_) {
+      trace_sink_batcher_.Send();
+    }
+    return written;
+  }
+
+  void ProcessTraceRings() {
+    ApplyThreadPolicy(THREAD_CLASS_LOG);
+    while (!stop_trace_thread_) {
+      if (!WriteTraceRings()) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
       }
     }
+    WriteTraceRings();
   }
 
   std::FILE *file_;
   std::unique_ptr<char[]> buffer_;
+  std::string path_;
+  bool use_file_;
+  bool json_;
+  std::mutex file_mutex_;
+  size_t file_size_;
+  unsigned int max_file_size_;
+  unsigned int keep_files_;
+  LogCompression compression_;
+  std::thread compress_thread_;
   std::string time_format_;
-  std::queue<std::string> log_queue_;
+  SlotQueue queue_;
+  std::deque<LogEntry> overflow_;
+  std::mutex overflow_mutex_;
+  size_t max_overflow_size_;
+  LogQueuePolicy overflow_policy_;
+  size_t overflow_size_;
+  std::atomic<bool> has_overflow_;
+  std::atomic<unsigned long> dropped_lines_;
+  unsigned long reported_dropped_lines_;
+  std::chrono::steady_clock::time_point last_drop_report_time_;
+  std::atomic<bool> consumer_waiting_;
+  LogFlushPolicy flush_policy_;
+  unsigned int flush_value_;
+  std::string batch_;
+  LineBuffer entry_line_;
+  unsigned int pending_entries_;
+  size_t pending_bytes_;
+  std::chrono::steady_clock::time_point last_flush_time_;
+  std::atomic<unsigned int> flush_requests_;
+  std::atomic<unsigned int> flushed_requests_;
   std::mutex mutex_;
   std::condition_variable cond_var_;
   std::thread log_thread_;
-  bool stop_thread_;
+  std::atomic<bool> stop_thread_;
+  std::vector<std::unique_ptr<CharRing>> trace_rings_;
+  std::mutex trace_rings_mutex_;
+  std::string trace_line_;
+  std::thread trace_thread_;
+  std::atomic<bool> stop_trace_thread_;
+  std::atomic<bool> crash_mode_;
+  int crash_fd_;
+  std::atomic_flag crash_lock_;
+  char crash_buffer_[CRASH_BUFFER_SIZE];
+  char crash_block_[CRASH_BLOCK_SIZE];
+  UDPSocket sink_;
+  bool use_sink_;
+  bool sink_syslog_;
+  SinkBatcher sink_batcher_;
+  SinkBatcher trace_sink_batcher_;
+  char crash_datagram_[sizeof(SYSLOG_PREFIX) + CRASH_BUFFER_SIZE];
+};
+
+class LogChannels {
+ public:
+  LogChannels() {
+    for (int i = 0; i < LOG_CHANNEL_COUNT; i++) {
+      const LogChannelOptions &options =
+        Options::shared().log_channel(static_cast<LogChannel>(i));
+      if (options.enabled) {
+        logs_[i].reset(new Log(options));
+      }
+    }
+  }
+
+  Log &Get(LogChannel channel) {
+    return logs_[channel] ? *logs_[channel] : *logs_[LOG_CHANNEL_MAIN];
+  }
+
+  // Calls func for the Log of every enabled channel.
+  template<typename Func>
+  void ForEach(Func func) {
+    for (int i = 0; i < LOG_CHANNEL_COUNT; i++) {
+      if (logs_[i]) {
+        func(*logs_[i]);
+      }
+    }
+  }
+
+ private:
+  std::unique_ptr<Log> logs_[LOG_CHANNEL_COUNT];
 };
 
+LogChannels &GetLogChannels() {
+  static LogChannels channels;
+  return channels;
+}
+
+thread_local LogChannel current_channel = LOG_CHANNEL_MAIN;
+
+Log &GetLog() {
+  return GetLogChannels().Get(current_channel);
+}
+
+Log &GetTraceLog() {
+  return GetLogChannels().Get(LOG_CHANNEL_TRACE);
+}
+
+} // anonymous namespace
+
+LogChannelScope::LogChannelScope(LogChannel channel)
+  : previous_(current_channel)
+{
+  current_channel = channel;
+}
+
+LogChannelScope::~LogChannelScope() {
+  current_channel = previous_;
 }
 
 void LogPrintV(const char *prefix, const char *format, std::va_list va) {
-  static Log global_log;
-  global_log.PrintV(prefix, format, va);
+  GetLog().PrintV(prefix, format, va);
+}
+
+long long LogGetTime() {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+    std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+void LogPrintJSON(const std::string &json) {
+  GetLog().PrintLine(json);
+}
+
+void LogTraceJSON(const std::string &json) {
+  GetTraceLog().PrintTraceLine(json);
+}
+
+unsigned long LogGetDroppedLines() {
+  unsigned long dropped_lines = 0;
+  GetLogChannels().ForEach([&](Log &log) {
+    dropped_lines += log.GetDroppedLines();
+  });
+  return dropped_lines;
+}
+
+void LogEnterCrashMode() {
+  GetLogChannels().ForEach([](Log &log) {
+    log.EnterCrashMode();
+  });
+}
+
+std::size_t LogGetQueuedBytes() {
+  std::size_t queued_bytes = 0;
+  GetLogChannels().ForEach([&](Log &log) {
+    queued_bytes += log.GetQueuedBytes();
+  });
+  return queued_bytes;
+}
+
+void LogFlush() {
+  GetLogChannels().ForEach([](Log &log) {
+    log.Flush();
+  });
 }
 
 void LogTracePrint(const char *format, ...) {
   std::va_list va;
   va_start(va, format);
-  LogPrintV("[trace] ", format, va);
+  GetTraceLog().PrintTraceV("[trace] ", format, va);
   va_end(va);
 }
 
@@ -169,3 +1548,11 @@ void LogDebugPrint(const char *format, ...) {
   va_end(va);
 }
 
+void LogDebugPrintLines(const char *text, std::size_t length) {
+  GetLog().PrintLines("[debug] ", text, length);
+}
+
+void LogDebugPrintDeferred(std::function<std::string()> format) {
+  GetLog().PrintDeferred("[debug] ", std::move(format));
+}
+
@@ -26,9 +26,67 @@
 #define LOG_H
 
 #include <cstdarg>
+#include <cstddef>
+#include <functional>
+#include <string>
+#include "options.h"
 
 void LogPrintV(const char *prefix, const char *format, std::va_list va);
 void LogTracePrint(const char *format, ...);
 void LogDebugPrint(const char *format, ...);
 
+// Prints several lines at once, separated by '\n', the same way as
+// LogDebugPrint() would print each of them. The lines are queued as one
+// entry, so they always end up next to each other in the log. In crash mode
+// they are written out in one go. Doesn't allocate memory in crash mode.
+void LogDebugPrintLines(const char *text, std::size_t length);
+
+// Same as LogDebugPrintLines() but the text is made by format, which is
+// called by the log thread when it gets to the entry. This is for reports
+// that are expensive to format. In crash mode and with jsonl output format
+// is called right away.
+void LogDebugPrintDeferred(std::function<std::string()> format);
+
+// Used with crashdetect_log_format jsonl: write a JSON object as a line of
+// its own, without a time stamp or prefix. LogTraceJSON() goes through the
+// same path as LogTracePrint(). The "time" field of each object should be
+// set to LogGetTime() (milliseconds since the Unix epoch).
+void LogPrintJSON(const std::string &json);
+void LogTraceJSON(const std::string &json);
+long long LogGetTime();
+
+// Returns how many lines have been dropped because a log queue was full
+// (see crashdetect_log_queue_size), in all channels together.
+unsigned long LogGetDroppedLines();
+
+// Returns the size of the text waiting in the overflow list, i.e. on top of
+// what fits in the fixed-size part of the queue (this is what is limited by
+// crashdetect_log_queue_size), summed over all channels.
+std::size_t LogGetQueuedBytes();
+
+// Sends everything the calling thread prints, other than traces, to the
+// given channel for as long as it exists (scopes can be nested). Channels
+// that are not enabled print to the main log. Traces always go to
+// LOG_CHANNEL_TRACE.
+class LogChannelScope {
+ public:
+  explicit LogChannelScope(LogChannel channel);
+  ~LogChannelScope();
+
+  LogChannelScope(const LogChannelScope &) = delete;
+  LogChannelScope &operator=(const LogChannelScope &) = delete;
+
+ private:
+  LogChannel previous_;
+};
+
+// Makes sure that everything printed so far, to any channel, is written
+// out.
+void LogFlush();
+
+// Writes out everything printed so far (in all channels) and switches to
+// writing each following line immediately, bypassing the log threads. Used
+// when the server is about to die, e.g. after a crash.
+void LogEnterCrashMode();
+
 #endif
@@ -0,0 +1,256 @@
+// Copyright (c) 2026 Zeex
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <algorithm>
+#include "longcallwatchdog.h"
+#include "threadpolicy.h"
+
+namespace {
+
+// The watchdog looks at the current call this many times per time limit,
+// so a call may be reported up to 1/kChecksPerLimit later than it should.
+// It's not that precise anyway with a coarse clock.
+const int64_t kChecksPerLimit = 10;
+
+const std::chrono::milliseconds kMinCheckInterval(1);
+const std::chrono::milliseconds kMaxCheckInterval(100);
+
+// How long the VM has to notice an expired call before the watchdog
+// decides it's stuck in a native.
+const std::chrono::seconds kStuckDelay(1);
+
+// Some Windows toolchains destroy the thread_local objects of the thread
+// that exits the process after the static ones, so the watchdog may be
+// gone by the time its timer owner is.
+std::atomic<bool> watchdog_destroyed(false);
+
+} // anonymous namespace
+
+LongCallWatchdog::LongCallWatchdog()
+  : stuck_handler_(nullptr),
+    enabled_(false),
+    time_limit_(0),
+    budget_(BUDGET_TOTAL),
+    stop_thread_(false)
+{
+}
+
+LongCallWatchdog::ThreadTimer::ThreadTimer()
+  : call_id(0),
+    in_call(false),
+    expired_call_id(0),
+    call_start(0),
+    time_limit(-1),
+    native_time(0),
+    native_start(0),
+    call_native_time(0),
+    tracking(false),
+    tracked_call_id(0),
+    expire_time(0),
+    stuck_reported(false)
+{
+}
+
+// static
+thread_local LongCallWatchdog::ThreadTimer *LongCallWatchdog::thread_timer_;
+
+// static
+thread_local LongCallWatchdog::ThreadTimerOwner
+  LongCallWatchdog::thread_timer_owner_;
+
+LongCallWatchdog::ThreadTimerOwner::~ThreadTimerOwner() {
+  if (timer != nullptr && !watchdog_destroyed.load()) {
+    watchdog->DestroyThreadTimer(timer);
+  }
+}
+
+LongCallWatchdog::~LongCallWatchdog() {
+  Stop();
+  // There's only the shared() one.
+  watchdog_destroyed = true;
+}
+
+// static
+LongCallWatchdog &LongCallWatchdog::shared() {
+  static LongCallWatchdog watchdog;
+  return watchdog;
+}
+
+void LongCallWatchdog::Start(StuckHandler stuck_handler) {
+  if (thread_.joinable()) {
+    return;
+  }
+  stuck_handler_ = stuck_handler;
+  stop_thread_ = false;
+  thread_ = std::thread(&LongCallWatchdog::Run, this);
+}
+
+void LongCallWatchdog::Stop() {
+  if (!thread_.joinable()) {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_thread_ = true;
+  }
+  cond_var_.notify_all();
+  thread_.join();
+}
+
+void LongCallWatchdog::SetEnabled(bool enabled) {
+  enabled_.store(enabled, std::memory_order_relaxed);
+}
+
+std::chrono::microseconds LongCallWatchdog::GetTimeLimit() const {
+  return std::chrono::microseconds(
+    time_limit_.load(std::memory_order_relaxed));
+}
+
+void LongCallWatchdog::SetTimeLimit(std::chrono::microseconds limit) {
+  time_limit_.store(limit.count(), std::memory_order_relaxed);
+}
+
+LongCallWatchdog::ThreadTimer *LongCallWatchdog::CreateThreadTimer() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  timers_.push_back(std::unique_ptr<ThreadTimer>(new ThreadTimer));
+  thread_timer_owner_.watchdog = this;
+  thread_timer_owner_.timer = timers_.back().get();
+  return timers_.back().get();
+}
+
+void LongCallWatchdog::DestroyThreadTimer(ThreadTimer *timer) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (std::size_t i = 0; i < timers_.size(); i++) {
+    if (timers_[i].get() == timer) {
+      timers_.erase(timers_.begin() + i);
+      break;
+    }
+  }
+}
+
+std::chrono::microseconds LongCallWatchdog::GetThreadTimeLimit() {
+  int64_t limit =
+    GetThreadTimer().time_limit.load(std::memory_order_relaxed);
+  return limit >= 0 ? std::chrono::microseconds(limit) : GetTimeLimit();
+}
+
+std::chrono::microseconds LongCallWatchdog::GetCallDuration() {
+  ThreadTimer &timer = GetThreadTimer();
+  return std::chrono::microseconds(
+    fastclock::Now() - timer.call_start.load(std::memory_order_relaxed));
+}
+
+std::chrono::microseconds LongCallWatchdog::GetCallNativeTime() {
+  ThreadTimer &timer = GetThreadTimer();
+  return std::chrono::microseconds(
+    GetNativeTime(timer)
+    - timer.call_native_time.load(std::memory_order_relaxed));
+}
+
+void LongCallWatchdog::Run() {
+  ApplyThreadPolicy(THREAD_CLASS_WATCHDOG);
+  std::unique_lock<std::mutex> lock(mutex_);
+  // The shortest limit seen on the last round, including the per-thread
+  // ones, decides how often to check.
+  int64_t min_time_limit = time_limit_.load(std::memory_order_relaxed);
+  while (!stop_thread_) {
+    std::chrono::microseconds interval = kMaxCheckInterval;
+    if (min_time_limit > 0) {
+      interval = std::chrono::microseconds(min_time_limit / kChecksPerLimit);
+      interval =
+        std::max<std::chrono::microseconds>(interval, kMinCheckInterval);
+      interval =
+        std::min<std::chrono::microseconds>(interval, kMaxCheckInterval);
+    }
+    cond_var_.wait_for(lock, interval);
+
+    int64_t time_limit = time_limit_.load(std::memory_order_relaxed);
+    min_time_limit = time_limit;
+    // Timers may be added or removed while the lock is released in
+    // Check(), which at worst makes this skip one until the next round.
+    for (std::size_t i = 0; i < timers_.size() && !stop_thread_; i++) {
+      int64_t limit =
+        timers_[i]->time_limit.load(std::memory_order_relaxed);
+      if (limit < 0) {
+        limit = time_limit;
+      }
+      if (limit > 0 && (min_time_limit <= 0 || limit < min_time_limit)) {
+        min_time_limit = limit;
+      }
+      Check(*timers_[i], limit, lock);
+    }
+  }
+}
+
+void LongCallWatchdog::Check(ThreadTimer &timer,
+                             int64_t time_limit,
+                             std::unique_lock<std::mutex> &lock) {
+  if (!timer.in_call.load(std::memory_order_acquire)) {
+    timer.tracking = false;
+    return;
+  }
+
+  int64_t now = fastclock::Now();
+  unsigned int call_id = timer.call_id.load(std::memory_order_acquire);
+  if (!timer.tracking || call_id != timer.tracked_call_id) {
+    // A new call has started since the last check (or the timer was
+    // restarted).
+    timer.tracking = true;
+    timer.tracked_call_id = call_id;
+    timer.expire_time = 0;
+    timer.stuck_reported = false;
+  }
+
+  if (!enabled_.load(std::memory_order_relaxed) || time_limit <= 0) {
+    return;
+  }
+  int64_t duration = now - timer.call_start.load(std::memory_order_relaxed);
+  if (timer.expire_time == 0) {
+    int64_t budget_time = duration;
+    int budget = budget_.load(std::memory_order_relaxed);
+    if (budget != BUDGET_TOTAL) {
+      int64_t native_time = GetNativeTime(timer, now)
+        - timer.call_native_time.load(std::memory_order_relaxed);
+      budget_time = budget == BUDGET_NATIVES ? native_time
+                                             : duration - native_time;
+    }
+    if (budget_time >= time_limit) {
+      timer.expire_time = now;
+      timer.expired_call_id.store(timer.tracked_call_id,
+                                  std::memory_order_release);
+    }
+  } else if (!timer.stuck_reported
+             && timer.expired_call_id.load(std::memory_order_relaxed)
+                == timer.tracked_call_id
+             && now - timer.expire_time >=
+                std::chrono::microseconds(kStuckDelay).count()) {
+    timer.stuck_reported = true;
+    if (stuck_handler_ != nullptr) {
+      // The timer may be gone once the lock is released.
+      lock.unlock();
+      stuck_handler_(std::chrono::microseconds(duration));
+      lock.lock();
+    }
+  }
+}
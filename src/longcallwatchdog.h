@@ -0,0 +1,221 @@
+// Copyright (c) 2026 Zeex
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef LONGCALLWATCHDOG_H
+#define LONGCALLWATCHDOG_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "fastclock.h"
+
+// Times top-level calls on a thread of its own. The VM threads only report
+// when calls begin (which reads fastclock) and end, and poll TakeExpired()
+// every now and then. Each VM thread gets its own timer.
+class LongCallWatchdog {
+ public:
+  // Called on the watchdog thread if a call has exceeded the time limit and
+  // the VM still hasn't checked for that a while later, which means that
+  // it's probably stuck in a native function.
+  typedef void (*StuckHandler)(std::chrono::microseconds duration);
+
+  // What the time limit applies to: the whole call, only the time spent
+  // running script code or only the time spent in natives.
+  enum Budget {
+    BUDGET_TOTAL,
+    BUDGET_SCRIPT,
+    BUDGET_NATIVES
+  };
+
+  void Start(StuckHandler stuck_handler);
+  void Stop();
+
+  bool IsEnabled() const { return enabled_.load(std::memory_order_relaxed); }
+  void SetEnabled(bool enabled);
+
+  Budget GetBudget() const
+    { return static_cast<Budget>(budget_.load(std::memory_order_relaxed)); }
+  void SetBudget(Budget budget)
+    { budget_.store(budget, std::memory_order_relaxed); }
+
+  std::chrono::microseconds GetTimeLimit() const;
+  void SetTimeLimit(std::chrono::microseconds limit);
+
+  // Replaces the time limit for calls made by the current thread, e.g. for
+  // scripts with their own long_call_time. A negative limit restores the
+  // one set with SetTimeLimit().
+  void SetThreadTimeLimit(std::chrono::microseconds limit) {
+    GetThreadTimer().time_limit.store(limit.count(),
+                                      std::memory_order_relaxed);
+  }
+
+  // The limit that applies to calls made by the current thread.
+  std::chrono::microseconds GetThreadTimeLimit();
+
+  // Also used to restart the timer for the current call.
+  void BeginCall() {
+    ThreadTimer &timer = GetThreadTimer();
+    timer.call_start.store(fastclock::Now(), std::memory_order_relaxed);
+    timer.call_native_time.store(GetNativeTime(timer),
+                                 std::memory_order_relaxed);
+    timer.call_id.fetch_add(1, std::memory_order_release);
+    timer.in_call.store(true, std::memory_order_release);
+  }
+  void EndCall() {
+    GetThreadTimer().in_call.store(false, std::memory_order_release);
+  }
+
+  // Mark the time spent in natives by the current thread, which is counted
+  // separately from script code. Natives that run publics should end their
+  // time while the public is running and begin it again when it returns.
+  // EndNative() returns how long it's been since BeginNative().
+  void BeginNative() {
+    GetThreadTimer().native_start.store(fastclock::Now(),
+                                        std::memory_order_relaxed);
+  }
+  int64_t EndNative() {
+    ThreadTimer &timer = GetThreadTimer();
+    int64_t start = timer.native_start.load(std::memory_order_relaxed);
+    if (start == 0) {
+      return 0;
+    }
+    int64_t time = fastclock::Now() - start;
+    timer.native_time.store(
+      timer.native_time.load(std::memory_order_relaxed) + time,
+      std::memory_order_relaxed);
+    timer.native_start.store(0, std::memory_order_relaxed);
+    return time;
+  }
+
+  // The total time the current thread has spent in natives so far, which
+  // can be subtracted to time a part of a call.
+  int64_t GetNativeTime() { return GetNativeTime(GetThreadTimer()); }
+
+  // Returns true once per call that has exceeded the time limit.
+  bool TakeExpired() {
+    ThreadTimer &timer = GetThreadTimer();
+    unsigned int call_id = timer.call_id.load(std::memory_order_relaxed);
+    if (timer.expired_call_id.load(std::memory_order_acquire) != call_id) {
+      return false;
+    }
+    timer.expired_call_id.store(0, std::memory_order_relaxed);
+    return true;
+  }
+
+  // How long the current call on this thread has been running, as seen by
+  // the watchdog.
+  std::chrono::microseconds GetCallDuration();
+  // The part of it spent in natives.
+  std::chrono::microseconds GetCallNativeTime();
+
+  static LongCallWatchdog &shared();
+
+ private:
+  LongCallWatchdog();
+  ~LongCallWatchdog();
+
+  LongCallWatchdog(const LongCallWatchdog &) = delete;
+  LongCallWatchdog &operator=(const LongCallWatchdog &) = delete;
+
+  // Calls made by each thread that runs scripts are timed separately.
+  // The first half is written by that thread, the rest is only touched by
+  // the watchdog thread.
+  struct ThreadTimer {
+    ThreadTimer();
+
+    // Calls are numbered from 1, call_id is the current (or last) one.
+    std::atomic<unsigned int> call_id;
+    std::atomic<bool> in_call;
+    // The call that has exceeded the time limit and hasn't been taken yet,
+    // or 0.
+    std::atomic<unsigned int> expired_call_id;
+    std::atomic<int64_t> call_start;  // fastclock::Now() time
+    std::atomic<int64_t> time_limit;  // microseconds, or -1
+    // Time spent in natives (only written by the VM thread, so there's no
+    // need for read-modify-write), the start of the current native or 0,
+    // and native_time at the start of the current call.
+    std::atomic<int64_t> native_time;
+    std::atomic<int64_t> native_start;
+    std::atomic<int64_t> call_native_time;
+
+    bool tracking;
+    unsigned int tracked_call_id;
+    int64_t expire_time;
+    bool stuck_reported;
+  };
+
+  // Removes the thread's timer from the watchdog when the thread exits.
+  struct ThreadTimerOwner {
+    ~ThreadTimerOwner();
+    LongCallWatchdog *watchdog;
+    ThreadTimer *timer;
+  };
+
+  ThreadTimer &GetThreadTimer() {
+    if (thread_timer_ == nullptr) {
+      thread_timer_ = CreateThreadTimer();
+    }
+    return *thread_timer_;
+  }
+  ThreadTimer *CreateThreadTimer();
+  void DestroyThreadTimer(ThreadTimer *timer);
+
+  // The watchdog thread may see native_time and native_start at slightly
+  // different moments, which makes the result off by one native at worst.
+  static int64_t GetNativeTime(const ThreadTimer &timer, int64_t now = 0) {
+    int64_t time = timer.native_time.load(std::memory_order_relaxed);
+    int64_t start = timer.native_start.load(std::memory_order_relaxed);
+    if (start != 0) {
+      time += (now != 0 ? now : fastclock::Now()) - start;
+    }
+    return time;
+  }
+
+  void Run();
+  void Check(ThreadTimer &timer,
+             int64_t time_limit,
+             std::unique_lock<std::mutex> &lock);
+
+ private:
+  StuckHandler stuck_handler_;
+  std::atomic<bool> enabled_;
+  std::atomic<int64_t> time_limit_;  // microseconds
+  std::atomic<int> budget_;
+  // One per thread that has made calls, destroyed when the thread exits.
+  std::vector<std::unique_ptr<ThreadTimer>> timers_;
+  bool stop_thread_;
+  std::mutex mutex_;
+  std::condition_variable cond_var_;
+  std::thread thread_;
+
+  static thread_local ThreadTimer *thread_timer_;
+  static thread_local ThreadTimerOwner thread_timer_owner_;
+};
+
+#endif // !LONGCALLWATCHDOG_H
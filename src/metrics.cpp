@@ -0,0 +1,243 @@
+// Copyright (c) 2026 Zeex
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include "log.h"
+#include "metrics.h"
+#include "threadpolicy.h"
+
+namespace {
+
+// Lines are packed into datagrams of at most this size, which fits in a
+// single Ethernet frame.
+const std::size_t kMaxDatagramSize = 1432;
+
+} // anonymous namespace
+
+const int Metrics::kNumErrorCodes;
+
+Metrics::Metrics()
+  : interval_(0),
+    running_(false),
+    stop_thread_(false),
+    has_snapshot_(false),
+    snapshot_pending_(false),
+    long_calls_(0),
+    sent_long_calls_(0),
+    sent_dropped_lines_(0)
+{
+  for (int i = 0; i < kNumErrorCodes; i++) {
+    errors_[i] = 0;
+    sent_errors_[i] = 0;
+  }
+}
+
+Metrics::~Metrics() {
+  Stop();
+}
+
+bool Metrics::Start(const std::string &host,
+                    const std::string &port,
+                    std::chrono::seconds interval,
+                    const std::string &prefix) {
+  if (running_) {
+    return true;
+  }
+  if (!socket_.Open(host, port)) {
+    LogDebugPrint("Could not open metrics address %s:%s",
+                  host.c_str(), port.c_str());
+    return false;
+  }
+  interval_ = std::max(interval, std::chrono::seconds(1));
+  prefix_ = prefix;
+  if (!prefix_.empty()) {
+    prefix_ += '.';
+  }
+  stop_thread_ = false;
+  thread_ = std::thread(&Metrics::Run, this);
+  running_ = true;
+  return true;
+}
+
+void Metrics::Stop() {
+  if (!running_) {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_thread_ = true;
+  }
+  cond_var_.notify_all();
+  thread_.join();
+  running_ = false;
+  snapshot_pending_ = false;
+  socket_.Close();
+}
+
+void Metrics::PostSnapshot(std::string lines) {
+  snapshot_pending_.store(false, std::memory_order_relaxed);
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    snapshot_.swap(lines);
+    has_snapshot_ = true;
+  }
+  cond_var_.notify_one();
+}
+
+void Metrics::AppendGauge(std::string &lines,
+                          const std::string &name,
+                          int64_t value) const {
+  char value_string[32];
+  std::snprintf(value_string, sizeof(value_string), ":%lld|g\n",
+                static_cast<long long>(value));
+  lines.append(prefix_);
+  lines.append(name);
+  lines.append(value_string);
+}
+
+// Counters are sent as the difference from the last time, as StatsD
+// expects.
+void Metrics::AppendCounter(std::string &lines,
+                            const std::string &name,
+                            uint64_t value,
+                            uint64_t &last_value) const {
+  if (value == last_value) {
+    return;
+  }
+  char value_string[32];
+  std::snprintf(value_string, sizeof(value_string), ":%llu|c\n",
+                static_cast<unsigned long long>(value - last_value));
+  lines.append(prefix_);
+  lines.append(name);
+  lines.append(value_string);
+  last_value = value;
+}
+
+// static
+std::string Metrics::SanitizeName(const std::string &name) {
+  std::string result = name;
+  for (std::size_t i = 0; i < result.length(); i++) {
+    unsigned char c = static_cast<unsigned char>(result[i]);
+    if (!std::isalnum(c) && c != '_') {
+      result[i] = '_';
+    }
+  }
+  return result;
+}
+
+void Metrics::SendCounters() {
+  std::string lines;
+  for (int i = 0; i < kNumErrorCodes; i++) {
+    AppendCounter(lines,
+                  "errors." + std::to_string(i),
+                  errors_[i].load(std::memory_order_relaxed),
+                  sent_errors_[i]);
+  }
+  AppendCounter(lines,
+                "long_calls",
+                long_calls_.load(std::memory_order_relaxed),
+                sent_long_calls_);
+  AppendCounter(lines,
+                "log.dropped_lines",
+                LogGetDroppedLines(),
+                sent_dropped_lines_);
+  AppendGauge(lines,
+              "log.queued_bytes",
+              static_cast<int64_t>(LogGetQueuedBytes()));
+  Send(lines);
+}
+
+void Metrics::Send(const std::string &lines) {
+  std::string::size_type begin = 0;
+  while (begin < lines.length()) {
+    // Cut at the last line that fits. A line longer than a datagram is sent
+    // on its own.
+    std::string::size_type end = begin + kMaxDatagramSize;
+    if (end >= lines.length()) {
+      end = lines.length();
+    } else {
+      std::string::size_type newline = lines.rfind('\n', end - 1);
+      if (newline != std::string::npos && newline >= begin) {
+        end = newline + 1;
+      } else {
+        end = lines.find('\n', begin);
+        end = end == std::string::npos ? lines.length() : end + 1;
+      }
+    }
+    // Drop the trailing newline, some servers don't like empty lines.
+    std::size_t size = end - begin;
+    if (lines[end - 1] == '\n') {
+      size--;
+    }
+    socket_.Send(lines.data() + begin, size);
+    begin = end;
+  }
+}
+
+void Metrics::Run() {
+  ApplyThreadPolicy(THREAD_CLASS_LOG);
+  std::unique_lock<std::mutex> lock(mutex_);
+  std::chrono::steady_clock::time_point next_send =
+    std::chrono::steady_clock::now() + interval_;
+  while (!stop_thread_) {
+    cond_var_.wait_until(lock, next_send, [this]() {
+      return stop_thread_ || has_snapshot_;
+    });
+    if (stop_thread_) {
+      break;
+    }
+    if (has_snapshot_) {
+      std::string lines;
+      lines.swap(snapshot_);
+      has_snapshot_ = false;
+      lock.unlock();
+      Send(lines);
+      lock.lock();
+      continue;
+    }
+    std::chrono::steady_clock::time_point now =
+      std::chrono::steady_clock::now();
+    if (now < next_send) {
+      continue;
+    }
+    next_send += interval_;
+    if (next_send < now) {
+      next_send = now + interval_;
+    }
+    // If the server thread is stuck, the per-script part just doesn't
+    // come, but the counters are still sent.
+    snapshot_pending_.store(true, std::memory_order_relaxed);
+    lock.unlock();
+    SendCounters();
+    lock.lock();
+  }
+}
+
+// static
+Metrics &Metrics::shared() {
+  static Metrics instance;
+  return instance;
+}
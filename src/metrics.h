@@ -0,0 +1,127 @@
+// Copyright (c) 2026 Zeex
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include "udpsocket.h"
+
+// Sends counters and gauges to a StatsD server over UDP every interval.
+// Global counters are atomics that the VM threads bump with relaxed stores
+// and the metrics thread reads on its own. Per-script figures live in data
+// that only the server thread may touch, so the metrics thread asks for
+// them (see IsSnapshotPending()) and the server thread hands them over as
+// text at the end of the next tick.
+class Metrics {
+ public:
+  static const int kNumErrorCodes = 32;
+
+  bool Start(const std::string &host,
+             const std::string &port,
+             std::chrono::seconds interval,
+             const std::string &prefix);
+  void Stop();
+
+  bool IsRunning() const { return running_; }
+
+  // Counted whether the metrics thread is running or not, it's cheap.
+  void CountError(int code) {
+    if (code >= 0 && code < kNumErrorCodes) {
+      errors_[code].fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+  void CountLongCall() {
+    long_calls_.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  uint64_t GetErrorCount(int code) const {
+    return errors_[code].load(std::memory_order_relaxed);
+  }
+  uint64_t GetLongCallCount() const {
+    return long_calls_.load(std::memory_order_relaxed);
+  }
+
+  // Checked by the server thread on every tick, so it must be cheap.
+  bool IsSnapshotPending() const {
+    return snapshot_pending_.load(std::memory_order_relaxed);
+  }
+  // Sends the lines built with AppendGauge().
+  void PostSnapshot(std::string lines);
+
+  // Appends a StatsD gauge to lines. The name gets the prefix in front.
+  void AppendGauge(std::string &lines,
+                   const std::string &name,
+                   int64_t value) const;
+
+  // Replaces everything but letters, digits and '_' with '_' so that the
+  // result can be used as a part of a metric name.
+  static std::string SanitizeName(const std::string &name);
+
+  static Metrics &shared();
+
+ private:
+  Metrics();
+  ~Metrics();
+
+  Metrics(const Metrics &) = delete;
+  Metrics &operator=(const Metrics &) = delete;
+
+  void AppendCounter(std::string &lines,
+                     const std::string &name,
+                     uint64_t value,
+                     uint64_t &last_value) const;
+  void SendCounters();
+  void Send(const std::string &lines);
+  void Run();
+
+ private:
+  UDPSocket socket_;
+  std::chrono::seconds interval_;
+  std::string prefix_;
+  bool running_;
+  bool stop_thread_;
+  std::mutex mutex_;
+  std::condition_variable cond_var_;
+  std::string snapshot_;
+  bool has_snapshot_;
+  std::thread thread_;
+
+  std::atomic<bool> snapshot_pending_;
+  std::atomic<uint64_t> errors_[kNumErrorCodes];
+  std::atomic<uint64_t> long_calls_;
+
+  // The values sent last time, only touched by the metrics thread.
+  uint64_t sent_errors_[kNumErrorCodes];
+  uint64_t sent_long_calls_;
+  uint64_t sent_dropped_lines_;
+};
+
+#endif // !METRICS_H
@@ -0,0 +1,150 @@
+// Copyright (c) 2026 Zeex
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <algorithm>
+#include <chrono>
+#include "moduletable.h"
+
+namespace {
+
+uint32_t GetSeconds() {
+  return static_cast<uint32_t>(
+    std::chrono::duration_cast<std::chrono::seconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+} // anonymous namespace
+
+ModuleTable::ModuleTable()
+  : loaded_(false),
+    generation_(0),
+    update_time_(0)
+{
+}
+
+std::string ModuleTable::GetModuleName(void *address) {
+  if (address == nullptr) {
+    return std::string();
+  }
+  // This may be called from the crash handler while another thread (or
+  // the same one) is holding the lock.
+  std::unique_lock<std::mutex> lock(mutex_, std::try_to_lock);
+  if (!lock.owns_lock()) {
+    return os::GetModuleName(address);
+  }
+  uint32_t value = static_cast<uint32_t>(reinterpret_cast<uintptr_t>(address));
+  const os::Module *module = loaded_ ? FindModule(value) : nullptr;
+  if (module == nullptr && (!loaded_ || IsOutdated())) {
+    Update();
+    module = FindModule(value);
+  }
+  return module != nullptr ? module->name() : std::string();
+}
+
+const char *ModuleTable::FindModuleName(void *address) {
+  uint32_t offset;
+  return FindModuleName(address, offset);
+}
+
+const char *ModuleTable::FindModuleName(void *address, uint32_t &offset) {
+  std::unique_lock<std::mutex> lock(mutex_, std::try_to_lock);
+  if (!lock.owns_lock() || !loaded_) {
+    return nullptr;
+  }
+  uint32_t value = static_cast<uint32_t>(reinterpret_cast<uintptr_t>(address));
+  const os::Module *module = FindModule(value);
+  if (module == nullptr) {
+    return nullptr;
+  }
+  offset = value - module->base_address();
+  return module->name().c_str();
+}
+
+bool ModuleTable::IsModuleAddress(void *address) {
+  std::unique_lock<std::mutex> lock(mutex_, std::try_to_lock);
+  if (!lock.owns_lock() || !loaded_) {
+    return true;
+  }
+  uint32_t value = static_cast<uint32_t>(reinterpret_cast<uintptr_t>(address));
+  return FindModule(value) != nullptr;
+}
+
+void ModuleTable::Refresh() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!loaded_ || IsOutdated()) {
+    Update();
+  }
+}
+
+void ModuleTable::GetModules(std::vector<os::Module> &modules) {
+  std::unique_lock<std::mutex> lock(mutex_, std::try_to_lock);
+  if (!lock.owns_lock()) {
+    os::GetLoadedModules(modules);
+    return;
+  }
+  if (!loaded_ || IsOutdated()) {
+    Update();
+  }
+  modules = modules_;
+}
+
+bool ModuleTable::IsOutdated() const {
+  if (generation_ != 0) {
+    return os::GetModuleGeneration() != generation_;
+  }
+  return GetSeconds() != update_time_;
+}
+
+void ModuleTable::Update() {
+  generation_ = os::GetModuleGeneration();
+  update_time_ = GetSeconds();
+  os::GetLoadedModules(modules_);
+  std::sort(modules_.begin(), modules_.end(),
+            [](const os::Module &a, const os::Module &b) {
+              return a.base_address() < b.base_address();
+            });
+  loaded_ = true;
+}
+
+const os::Module *ModuleTable::FindModule(uint32_t address) const {
+  std::vector<os::Module>::const_iterator it = std::upper_bound(
+    modules_.begin(), modules_.end(), address,
+    [](uint32_t address, const os::Module &module) {
+      return address < module.base_address();
+    });
+  if (it == modules_.begin()) {
+    return nullptr;
+  }
+  --it;
+  if (address - it->base_address() >= it->size() || it->name().empty()) {
+    return nullptr;
+  }
+  return &*it;
+}
+
+// static
+ModuleTable &ModuleTable::shared() {
+  static ModuleTable instance;
+  return instance;
+}
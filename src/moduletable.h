@@ -0,0 +1,96 @@
+// Copyright (c) 2026 Zeex
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef MODULETABLE_H
+#define MODULETABLE_H
+
+#include <mutex>
+#include <string>
+#include <vector>
+#include "os.h"
+
+// A sorted copy of the list of loaded modules, for looking up lots of
+// addresses without asking the system (and taking the loader lock) for each
+// one. The list is read again when a lookup fails and the set of modules has
+// changed since (see os::GetModuleGeneration()). On systems that don't keep
+// a generation count this happens at most once a second.
+class ModuleTable {
+ public:
+  // Returns the path of the module that contains the address, like
+  // os::GetModuleName().
+  std::string GetModuleName(void *address);
+
+  // Same as GetModuleName() but only looks at the copy of the list made
+  // earlier and doesn't allocate memory, for use in the crash handler.
+  // Returns nullptr if the address isn't in a known module.
+  const char *FindModuleName(void *address);
+  // Also stores the offset of the address from the start of the module.
+  const char *FindModuleName(void *address, uint32_t &offset);
+
+  // Tells whether the address is in a known module, the same way as
+  // FindModuleName(). If the list is being updated by another thread at the
+  // moment this can't be checked and returns true.
+  bool IsModuleAddress(void *address);
+
+  // Reads the list of modules again if it has changed, so that
+  // FindModuleName() knows about them.
+  void Refresh();
+
+  // Calls visitor with the copy of the list (sorted by address) without
+  // allocating memory, the same way as FindModuleName(). Returns false if
+  // the list isn't available.
+  template<typename Visitor>
+  bool VisitModules(Visitor visitor) {
+    std::unique_lock<std::mutex> lock(mutex_, std::try_to_lock);
+    if (!lock.owns_lock() || !loaded_) {
+      return false;
+    }
+    visitor(static_cast<const std::vector<os::Module> &>(modules_));
+    return true;
+  }
+
+  // Copies the list of modules, sorted by address.
+  void GetModules(std::vector<os::Module> &modules);
+
+  static ModuleTable &shared();
+
+ private:
+  ModuleTable();
+
+  ModuleTable(const ModuleTable &) = delete;
+  ModuleTable &operator=(const ModuleTable &) = delete;
+
+  bool IsOutdated() const;
+  void Update();
+  const os::Module *FindModule(uint32_t address) const;
+
+ private:
+  std::mutex mutex_;
+  std::vector<os::Module> modules_;
+  bool loaded_;
+  unsigned long generation_;
+  uint32_t update_time_;  // seconds, only used if there's no generation
+};
+
+#endif // !MODULETABLE_H
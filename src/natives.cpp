@@ -22,22 +22,83 @@
 // ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
 // POSSIBILITY OF SUCH DAMAGE.
 
-#include <sstream>
+#include <limits>
+#include <ostream>
+#include <streambuf>
+#include <string>
+#include <vector>
+#include "amxref.h"
 #include "crashdetect.h"
+#include "log.h"
 #include "natives.h"
+#include "options.h"
 #include "os.h"
 
 namespace {
 
+// Writes an unpacked string straight into an AMX array, the way
+// amx_SetString() would, and fails once the array is full so that the
+// stream writing into it can stop early.
+class AMXStringBuf : public std::streambuf {
+ public:
+  AMXStringBuf(cell *dest, cell size)
+    : dest_(dest),
+      max_length_(size > 0 ? size - 1 : 0),
+      length_(0) {
+    if (size > 0) {
+      dest_[0] = 0;
+    }
+  }
+
+  ~AMXStringBuf() {
+    if (max_length_ > 0) {
+      dest_[length_] = 0;
+    }
+  }
+
+ protected:
+  int_type overflow(int_type c) override {
+    if (traits_type::eq_int_type(c, traits_type::eof())) {
+      return traits_type::not_eof(c);
+    }
+    if (length_ >= max_length_) {
+      return traits_type::eof();
+    }
+    dest_[length_++] = static_cast<cell>(traits_type::to_char_type(c));
+    return c;
+  }
+
+  std::streamsize xsputn(const char *s, std::streamsize n) override {
+    std::streamsize count = 0;
+    while (count < n && length_ < max_length_) {
+      dest_[length_++] = static_cast<cell>(s[count++]);
+    }
+    return count;
+  }
+
+ private:
+  cell *dest_;
+  cell max_length_;
+  cell length_;
+};
+
 // native PrintAmxBacktrace();
 cell AMX_NATIVE_CALL PrintBacktrace(AMX *amx, cell *params) {
-  CrashDetect::PrintAMXBacktrace();
+  if (Options::shared().backtrace_async()) {
+    CrashDetect::PrintAMXBacktraceDeferred();
+  } else {
+    CrashDetect::PrintAMXBacktrace();
+  }
   return 1;
 }
 
 // native PrintNativeBacktrace();
 cell AMX_NATIVE_CALL PrintNativeBacktrace(AMX *amx, cell *params) {
-  CrashDetect::PrintNativeBacktrace(os::Context());
+  if (Options::shared().backtrace_async()) {
+    CrashDetect::PrintNativeBacktraceDeferred(os::Context());
+  } else {
+    CrashDetect::PrintNativeBacktrace(os::Context());
+  }
   return 1;
 }
 
@@ -48,10 +109,10 @@ cell AMX_NATIVE_CALL GetBacktrace(AMX *amx, cell *params) {
 
   cell *string_ptr;
   if (amx_GetAddr(amx, string, &string_ptr) == AMX_ERR_NONE) {
-    std::stringstream stream;
+    AMXStringBuf buffer(string_ptr, size);
+    std::ostream stream(&buffer);
     CrashDetect::PrintAMXBacktrace(stream);
-    return amx_SetString(string_ptr, stream.str().c_str(),
-                         0, 0, size) == AMX_ERR_NONE;
+    return 1;
   }
 
   return 0;
@@ -64,23 +125,373 @@ cell AMX_NATIVE_CALL GetNativeBacktrace(AMX *amx, cell *params) {
 
   cell *string_ptr;
   if (amx_GetAddr(amx, string, &string_ptr) == AMX_ERR_NONE) {
-    std::stringstream stream;
+    AMXStringBuf buffer(string_ptr, size);
+    std::ostream stream(&buffer);
     CrashDetect::PrintNativeBacktrace(stream, nullptr);
-    return amx_SetString(string_ptr, stream.str().c_str(),
-                         0, 0, size) == AMX_ERR_NONE;
+    return 1;
+  }
+
+  return 0;
+}
+
+// native GetBacktraceFrames(frames[][E_CD_FRAME], max = sizeof(frames));
+cell AMX_NATIVE_CALL GetBacktraceFrames(AMX *amx, cell *params) {
+  // The number of cells in each row (E_CD_FRAME).
+  const cell kRowSize = 4;
+
+  // The array is max rows, preceded by the indirection vector; make sure
+  // all of it is in the script's memory before writing anything.
+  cell max = params[2];
+  cell *last_ptr;
+  if (max <= 0
+      || max > std::numeric_limits<cell>::max()
+               / static_cast<cell>(sizeof(cell) * (kRowSize + 1))
+      || amx_GetAddr(amx,
+                     params[1] + (max * (kRowSize + 1) - 1) * sizeof(cell),
+                     &last_ptr) != AMX_ERR_NONE) {
+    return 0;
+  }
+
+  std::vector<CrashDetect::AMXFrameInfo> frames;
+  CrashDetect::GetAMXFrameInfo(frames);
+
+  cell count = 0;
+  for (; count < max && count < static_cast<cell>(frames.size()); count++) {
+    // Each row is found through the indirection vector at the start of
+    // the array, which could have been changed to point anywhere.
+    cell index_addr = params[1] + count * sizeof(cell);
+    cell *index_ptr, *row_ptr;
+    if (amx_GetAddr(amx, index_addr, &index_ptr) != AMX_ERR_NONE
+        || amx_GetAddr(amx, index_addr + *index_ptr, &row_ptr)
+           != AMX_ERR_NONE
+        || amx_GetAddr(amx,
+                       index_addr + *index_ptr
+                         + (kRowSize - 1) * sizeof(cell),
+                       &last_ptr) != AMX_ERR_NONE) {
+      break;
+    }
+    const CrashDetect::AMXFrameInfo &frame = frames[count];
+    row_ptr[0] = frame.address;
+    row_ptr[1] = frame.function;
+    row_ptr[2] = frame.native_index;
+    row_ptr[3] = frame.line;
+  }
+  return count;
+}
+
+// native bool:GetCallerInfo(depth, function[], file[], &line,
+//                           function_size = sizeof(function),
+//                           file_size = sizeof(file));
+cell AMX_NATIVE_CALL GetCallerInfo(AMX *amx, cell *params) {
+  cell *function_ptr, *file_ptr, *line_ptr;
+  if (params[1] < 0
+      || amx_GetAddr(amx, params[2], &function_ptr) != AMX_ERR_NONE
+      || amx_GetAddr(amx, params[3], &file_ptr) != AMX_ERR_NONE
+      || amx_GetAddr(amx, params[4], &line_ptr) != AMX_ERR_NONE) {
+    return 0;
+  }
+  std::string function;
+  std::string file;
+  cell line;
+  if (!CrashDetect::GetAMXCallerInfo(static_cast<std::size_t>(params[1]),
+                                     function,
+                                     file,
+                                     line)) {
+    return 0;
   }
+  amx_SetString(function_ptr, function.c_str(), 0, 0, params[5]);
+  amx_SetString(file_ptr, file.c_str(), 0, 0, params[6]);
+  *line_ptr = line;
+  return 1;
+}
+
+// native SetCrashDetectTrace(const flags[], const filter[] = "");
+cell AMX_NATIVE_CALL SetTrace(AMX *amx, cell *params) {
+  AMXRef amx_ref(amx);
+  std::string flags = amx_ref.GetDataString(params[1]);
+  std::string filter = amx_ref.GetDataString(params[2]);
+
+  std::vector<std::string> filter_patterns;
+  if (!filter.empty()) {
+    filter_patterns.push_back(filter);
+  }
+  CrashDetect::SetTrace(flags, filter_patterns);
+  return 1;
+}
+
+// native bool:ReloadCrashDetectSettings();
+cell AMX_NATIVE_CALL ReloadSettings(AMX *amx, cell *params) {
+  return CrashDetect::ReloadOptions();
+}
+
+// native bool:CrashDetectProfilerStart(interval = 0, const filename[] = "");
+cell AMX_NATIVE_CALL ProfilerStart(AMX *amx, cell *params) {
+  std::string filename = AMXRef(amx).GetDataString(params[2]);
+  unsigned int interval = params[1] > 0 ? params[1] : 0;
+  return CrashDetect::StartProfiler(interval, filename);
+}
+
+// native bool:CrashDetectProfilerStop();
+cell AMX_NATIVE_CALL ProfilerStop(AMX *amx, cell *params) {
+  return CrashDetect::StopProfiler();
+}
 
+// native bool:CrashDetectProfilerDump();
+cell AMX_NATIVE_CALL ProfilerDump(AMX *amx, cell *params) {
+  return CrashDetect::DumpProfile();
+}
+
+// native bool:CrashDetectSetLongCallTimeForPublic(const name[], us_time);
+cell AMX_NATIVE_CALL SetLongCallTimeForPublic(AMX *amx, cell *params) {
+  CrashDetect *handler = CrashDetect::GetHandler(amx);
+  if (handler == nullptr) {
+    return 0;
+  }
+  std::string name = AMXRef(amx).GetDataString(params[1]);
+  return handler->SetPublicLongCallTime(name.c_str(), params[2]);
+}
+
+// native bool:CrashDetectWatch(&{Float, _}:variable, cells = 1);
+cell AMX_NATIVE_CALL Watch(AMX *amx, cell *params) {
+  CrashDetect *handler = CrashDetect::GetHandler(amx);
+  return handler != nullptr && handler->Watch(params[1], params[2]);
+}
+
+// native CrashDetectUnwatch(&{Float, _}:variable, cells = 1);
+cell AMX_NATIVE_CALL Unwatch(AMX *amx, cell *params) {
+  CrashDetect *handler = CrashDetect::GetHandler(amx);
+  if (handler != nullptr) {
+    handler->Unwatch(params[1], params[2]);
+  }
   return 0;
 }
 
+// native GetCrashDetectDroppedLines();
+cell AMX_NATIVE_CALL GetDroppedLines(AMX *amx, cell *params) {
+  return static_cast<cell>(LogGetDroppedLines());
+}
+
+// native PrintOpcodeCounts();
+cell AMX_NATIVE_CALL PrintOpcodeCounts(AMX *amx, cell *params) {
+  CrashDetect *handler = CrashDetect::GetHandler(amx);
+  return handler != nullptr && handler->PrintOpcodeCounts();
+}
+
+// native PrintBlockCounts();
+cell AMX_NATIVE_CALL PrintBlockCounts(AMX *amx, cell *params) {
+  CrashDetect *handler = CrashDetect::GetHandler(amx);
+  return handler != nullptr && handler->PrintBlockCounts();
+}
+
+// native PrintStackUsage();
+cell AMX_NATIVE_CALL PrintStackUsage(AMX *amx, cell *params) {
+  CrashDetect *handler = CrashDetect::GetHandler(amx);
+  return handler != nullptr && handler->PrintStackUsage();
+}
+
+// native GetStackWatermark(const function[]);
+cell AMX_NATIVE_CALL GetStackWatermark(AMX *amx, cell *params) {
+  CrashDetect *handler = CrashDetect::GetHandler(amx);
+  if (handler == nullptr) {
+    return -1;
+  }
+  std::string name = AMXRef(amx).GetDataString(params[1]);
+  return handler->GetStackWatermark(name.c_str());
+}
+
+// native PrintNativeStats();
+cell AMX_NATIVE_CALL PrintNativeStats(AMX *amx, cell *params) {
+  CrashDetect *handler = CrashDetect::GetHandler(amx);
+  return handler != nullptr && handler->PrintNativeStats();
+}
+
+// native PrintArgumentStats();
+cell AMX_NATIVE_CALL PrintArgumentStats(AMX *amx, cell *params) {
+  CrashDetect *handler = CrashDetect::GetHandler(amx);
+  return handler != nullptr && handler->PrintArgumentStats();
+}
+
+// native GetCrashDetectArgumentStats(index, &argument, &calls, function[],
+//                                    size = sizeof(function));
+cell AMX_NATIVE_CALL GetArgumentStats(AMX *amx, cell *params) {
+  CrashDetect *handler = CrashDetect::GetHandler(amx);
+  cell *argument_ptr;
+  cell *calls_ptr;
+  cell *function_ptr;
+  if (handler == nullptr
+      || amx_GetAddr(amx, params[2], &argument_ptr) != AMX_ERR_NONE
+      || amx_GetAddr(amx, params[3], &calls_ptr) != AMX_ERR_NONE
+      || amx_GetAddr(amx, params[4], &function_ptr) != AMX_ERR_NONE) {
+    return -1;
+  }
+  std::string function;
+  int64_t time =
+    handler->GetArgumentStats(params[1], function, *argument_ptr, *calls_ptr);
+  if (time >= 0) {
+    amx_SetString(function_ptr, function.c_str(), 0, 0, params[5]);
+  }
+  return static_cast<cell>(time);
+}
+
+// native PrintNativeSiteStats();
+cell AMX_NATIVE_CALL PrintNativeSiteStats(AMX *amx, cell *params) {
+  CrashDetect *handler = CrashDetect::GetHandler(amx);
+  return handler != nullptr && handler->PrintNativeSiteStats();
+}
+
+// native PrintDispatchStats();
+cell AMX_NATIVE_CALL PrintDispatchStats(AMX *amx, cell *params) {
+  CrashDetect *handler = CrashDetect::GetHandler(amx);
+  return handler != nullptr && handler->PrintDispatchStats();
+}
+
+// native PrintFileStats();
+cell AMX_NATIVE_CALL PrintFileStats(AMX *amx, cell *params) {
+  CrashDetect *handler = CrashDetect::GetHandler(amx);
+  return handler != nullptr && handler->PrintFileStats();
+}
+
+// native PrintRedundantNatives();
+cell AMX_NATIVE_CALL PrintRedundantNatives(AMX *amx, cell *params) {
+  CrashDetect *handler = CrashDetect::GetHandler(amx);
+  return handler != nullptr && handler->PrintRedundantNatives();
+}
+
+// native PrintTimerStats();
+cell AMX_NATIVE_CALL PrintTimerStats(AMX *amx, cell *params) {
+  CrashDetect *handler = CrashDetect::GetHandler(amx);
+  return handler != nullptr && handler->PrintTimerStats();
+}
+
+// native WriteCallGraph();
+cell AMX_NATIVE_CALL WriteCallGraph(AMX *amx, cell *params) {
+  CrashDetect *handler = CrashDetect::GetHandler(amx);
+  return handler != nullptr && handler->WriteCallGraph();
+}
+
+// native WriteCoverage();
+cell AMX_NATIVE_CALL WriteCoverage(AMX *amx, cell *params) {
+  CrashDetect *handler = CrashDetect::GetHandler(amx);
+  return handler != nullptr && handler->WriteCoverage();
+}
+
+// native WriteLineProfile();
+cell AMX_NATIVE_CALL WriteLineProfile(AMX *amx, cell *params) {
+  CrashDetect *handler = CrashDetect::GetHandler(amx);
+  return handler != nullptr && handler->WriteLineProfile();
+}
+
+// native PrintHeapProfile();
+cell AMX_NATIVE_CALL PrintHeapProfile(AMX *amx, cell *params) {
+  CrashDetect *handler = CrashDetect::GetHandler(amx);
+  return handler != nullptr && handler->PrintHeapProfile();
+}
+
+// native GetHeapConsumer(index, location[], size = sizeof(location));
+cell AMX_NATIVE_CALL GetHeapConsumer(AMX *amx, cell *params) {
+  CrashDetect *handler = CrashDetect::GetHandler(amx);
+  cell *location_ptr;
+  if (handler == nullptr
+      || amx_GetAddr(amx, params[2], &location_ptr) != AMX_ERR_NONE) {
+    return -1;
+  }
+  std::string location;
+  cell peak = handler->GetHeapConsumer(params[1], location);
+  if (peak >= 0) {
+    amx_SetString(location_ptr, location.c_str(), 0, 0, params[3]);
+  }
+  return peak;
+}
+
+// native GetCrashDetectErrorCount(code = -1);
+cell AMX_NATIVE_CALL GetErrorCount(AMX *amx, cell *params) {
+  CrashDetect *handler = CrashDetect::GetHandler(amx);
+  if (handler == nullptr) {
+    return 0;
+  }
+  return handler->GetErrorCount(params[1]);
+}
+
+// native GetCrashDetectErrorFunction(index, function[],
+//                                    size = sizeof(function));
+cell AMX_NATIVE_CALL GetErrorFunction(AMX *amx, cell *params) {
+  CrashDetect *handler = CrashDetect::GetHandler(amx);
+  cell *function_ptr;
+  if (handler == nullptr
+      || amx_GetAddr(amx, params[2], &function_ptr) != AMX_ERR_NONE) {
+    return -1;
+  }
+  std::string function;
+  cell count = handler->GetErrorFunction(params[1], function);
+  if (count >= 0) {
+    amx_SetString(function_ptr, function.c_str(), 0, 0, params[3]);
+  }
+  return count;
+}
+
+// native GetCrashDetectLoadTime(stage = -1, bool:total = false);
+cell AMX_NATIVE_CALL GetLoadTime(AMX *amx, cell *params) {
+  CrashDetect *handler = CrashDetect::GetHandler(amx);
+  if (handler == nullptr) {
+    return -1;
+  }
+  return static_cast<cell>(handler->GetLoadTime(params[1], params[2] != 0));
+}
+
+// native GetCrashDetectCallbackStats(const function[], &p50, &p99, &max);
+cell AMX_NATIVE_CALL GetCallbackStats(AMX *amx, cell *params) {
+  CrashDetect *handler = CrashDetect::GetHandler(amx);
+  cell *p50_ptr, *p99_ptr, *max_ptr;
+  if (handler == nullptr
+      || amx_GetAddr(amx, params[2], &p50_ptr) != AMX_ERR_NONE
+      || amx_GetAddr(amx, params[3], &p99_ptr) != AMX_ERR_NONE
+      || amx_GetAddr(amx, params[4], &max_ptr) != AMX_ERR_NONE) {
+    return 0;
+  }
+  std::string name = AMXRef(amx).GetDataString(params[1]);
+  return handler->GetCallbackStats(name.c_str(), *p50_ptr, *p99_ptr, *max_ptr);
+}
+
 const AMX_NATIVE_INFO natives[] = {
-  {"PrintBacktrace",       PrintBacktrace},
-  {"PrintNativeBacktrace", PrintNativeBacktrace},
-  {"GetBacktrace",         GetBacktrace},
-  {"GetNativeBacktrace",   GetNativeBacktrace},
+  {"PrintBacktrace",             PrintBacktrace},
+  {"PrintNativeBacktrace",       PrintNativeBacktrace},
+  {"GetBacktrace",               GetBacktrace},
+  {"GetNativeBacktrace",         GetNativeBacktrace},
+  {"GetBacktraceFrames",         GetBacktraceFrames},
+  {"GetCallerInfo",              GetCallerInfo},
+  {"SetCrashDetectTrace",        SetTrace},
+  {"ReloadCrashDetectSettings",  ReloadSettings},
+  {"CrashDetectProfilerStart",   ProfilerStart},
+  {"CrashDetectProfilerStop",    ProfilerStop},
+  {"CrashDetectProfilerDump",    ProfilerDump},
+  {"CrashDetectSetLongCallTimeForPublic", SetLongCallTimeForPublic},
+  {"CrashDetectWatch",           Watch},
+  {"CrashDetectUnwatch",         Unwatch},
+  {"GetCrashDetectDroppedLines", GetDroppedLines},
+  {"PrintOpcodeCounts",          PrintOpcodeCounts},
+  {"PrintBlockCounts",           PrintBlockCounts},
+  {"PrintStackUsage",            PrintStackUsage},
+  {"GetStackWatermark",          GetStackWatermark},
+  {"GetCrashDetectCallbackStats", GetCallbackStats},
+  {"PrintNativeStats",           PrintNativeStats},
+  {"PrintTimerStats",            PrintTimerStats},
+  {"PrintRedundantNatives",      PrintRedundantNatives},
+  {"PrintNativeSiteStats",       PrintNativeSiteStats},
+  {"PrintDispatchStats",         PrintDispatchStats},
+  {"PrintFileStats",             PrintFileStats},
+  {"PrintArgumentStats",         PrintArgumentStats},
+  {"GetCrashDetectArgumentStats", GetArgumentStats},
+  {"WriteCallGraph",             WriteCallGraph},
+  {"WriteCoverage",              WriteCoverage},
+  {"WriteLineProfile",           WriteLineProfile},
+  {"PrintHeapProfile",           PrintHeapProfile},
+  {"GetHeapConsumer",            GetHeapConsumer},
+  {"GetCrashDetectLoadTime",     GetLoadTime},
+  {"GetCrashDetectErrorCount",   GetErrorCount},
+  {"GetCrashDetectErrorFunction", GetErrorFunction},
   // Backwards compatibility:
-  {"PrintAmxBacktrace",    PrintBacktrace},
-  {"GetAmxBacktrace",      GetBacktrace}
+  {"PrintAmxBacktrace",          PrintBacktrace},
+  {"GetAmxBacktrace",            GetBacktrace}
 };
 
 } // anonymous namespace
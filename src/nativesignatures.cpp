@@ -0,0 +1,109 @@
+// Copyright (c) 2026 Zeex
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <fstream>
+#include <sstream>
+#include "nativesignatures.h"
+
+NativeSignatureTable::NativeSignatureTable() {
+}
+
+bool NativeSignatureTable::Load(const std::string &filename) {
+  std::ifstream file(filename.c_str());
+  if (!file.is_open()) {
+    return false;
+  }
+
+  std::unordered_map<std::string, NativeSignature> signatures;
+  std::string line;
+  while (std::getline(file, line)) {
+    std::istringstream stream(line);
+    NativeSignature signature;
+    if (!(stream >> signature.name) || signature.name[0] == '#') {
+      continue;
+    }
+    std::string text;
+    while (stream >> text) {
+      NativeParam param;
+      if (text == "...") {
+        break;
+      }
+      if (!ParseParam(text, param)) {
+        return false;
+      }
+      signature.params.push_back(param);
+    }
+    signatures[signature.name] = signature;
+  }
+
+  signatures_.swap(signatures);
+  return true;
+}
+
+const NativeSignature *NativeSignatureTable::Find(const char *name) const {
+  std::unordered_map<std::string, NativeSignature>::const_iterator it =
+    signatures_.find(name);
+  if (it == signatures_.end()) {
+    return nullptr;
+  }
+  return &it->second;
+}
+
+// static
+bool NativeSignatureTable::ParseParam(const std::string &text,
+                                      NativeParam &param) {
+  if (text.length() < 3 || text[1] != ':') {
+    return false;
+  }
+  switch (text[0]) {
+    case 'v':
+      param.kind = NativeParam::VALUE;
+      break;
+    case 'r':
+      param.kind = NativeParam::REFERENCE;
+      break;
+    case 'a':
+      param.kind = NativeParam::ARRAY;
+      break;
+    case 's':
+      param.kind = NativeParam::STRING;
+      break;
+    default:
+      return false;
+  }
+  std::string::size_type colon = text.find(':', 2);
+  if (colon != std::string::npos) {
+    param.tag = text.substr(2, colon - 2);
+    param.name = text.substr(colon + 1);
+  } else {
+    param.name = text.substr(2);
+  }
+  return !param.name.empty();
+}
+
+// static
+NativeSignatureTable &NativeSignatureTable::shared() {
+  static NativeSignatureTable instance;
+  return instance;
+}
@@ -0,0 +1,87 @@
+// Copyright (c) 2026 Zeex
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef NATIVESIGNATURES_H
+#define NATIVESIGNATURES_H
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+struct NativeParam {
+  enum Kind {
+    VALUE,
+    REFERENCE,
+    ARRAY,
+    STRING      // a one-dimensional array without tags
+  };
+
+  Kind kind;
+  std::string tag;   // empty if there's no tag
+  std::string name;
+};
+
+struct NativeSignature {
+  std::string name;
+  // Variable arguments (...) are not included, they are printed as raw
+  // values.
+  std::vector<NativeParam> params;
+};
+
+// Native declarations read from a file made with wrap_natives.py --table
+// out of the server's include files, so that natives can be traced with
+// their arguments like normal functions. Each line describes one native:
+//
+//   <name> <kind>:[<tag>:]<param> ...
+//
+// where kind is v (value), r (reference), a (array) or s (string), e.g.
+//
+//   SetPlayerPos v:playerid v:Float:x v:Float:y v:Float:z
+//   GetPlayerName v:playerid s:name v:len
+//
+// Empty lines and lines starting with '#' are ignored.
+class NativeSignatureTable {
+ public:
+  bool Load(const std::string &filename);
+
+  bool IsEmpty() const { return signatures_.empty(); }
+
+  // Returns nullptr if there's no such native in the table.
+  const NativeSignature *Find(const char *name) const;
+
+  static NativeSignatureTable &shared();
+
+ private:
+  NativeSignatureTable();
+
+  NativeSignatureTable(const NativeSignatureTable &) = delete;
+  NativeSignatureTable &operator=(const NativeSignatureTable &) = delete;
+
+  static bool ParseParam(const std::string &text, NativeParam &param);
+
+ private:
+  std::unordered_map<std::string, NativeSignature> signatures_;
+};
+
+#endif // !NATIVESIGNATURES_H
@@ -22,9 +22,15 @@
 // ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
 // POSSIBILITY OF SUCH DAMAGE.
 
+#include <algorithm>
+#include <cstdlib>
+#include <sstream>
+#include <string>
+#include <vector>
 #include <configreader.h>
 #include "options.h"
 #include "regexp.h"
+#include "stringutils.h"
 
 namespace {
 
@@ -34,43 +40,638 @@ unsigned int TraceFlagsFromString(const std::string &s) {
     switch (s[i]) {
       case 'n':
         flags |= TRACE_NATIVES;
+        break;
       case 'p':
         flags |= TRACE_PUBLICS;
+        break;
       case 'f':
         flags |= TRACE_FUNCTIONS;
+        break;
+      case 't':
+        flags |= TRACE_TIMERS;
+        break;
     }
   }
   return flags;
 }
 
+CrashDetectMode ModeFromString(const std::string &s) {
+  if (s == "lite") {
+    return MODE_LITE;
+  }
+  return MODE_DEFAULT;
+}
+
+DebugInfoLevel DebugInfoLevelFromString(const std::string &s) {
+  if (s == "lines") {
+    return DEBUG_INFO_LINES;
+  }
+  if (s == "arguments") {
+    return DEBUG_INFO_ARGUMENTS;
+  }
+  return DEBUG_INFO_FULL;
+}
+
+TraceMode TraceModeFromString(const std::string &s) {
+  if (s == "counts") {
+    return TRACE_MODE_COUNTS;
+  }
+  return TRACE_MODE_LOG;
+}
+
+TraceOutput TraceOutputFromString(const std::string &s) {
+  if (s == "binary") {
+    return TRACE_OUTPUT_BINARY;
+  }
+  if (s == "chrome") {
+    return TRACE_OUTPUT_CHROME;
+  }
+  return TRACE_OUTPUT_TEXT;
+}
+
+CoverageFormat CoverageFormatFromString(const std::string &s) {
+  if (s == "json") {
+    return COVERAGE_FORMAT_JSON;
+  }
+  return COVERAGE_FORMAT_LCOV;
+}
+
+LongCallBudget LongCallBudgetFromString(const std::string &s) {
+  if (s == "script") {
+    return LONG_CALL_BUDGET_SCRIPT;
+  }
+  if (s == "natives") {
+    return LONG_CALL_BUDGET_NATIVES;
+  }
+  return LONG_CALL_BUDGET_TOTAL;
+}
+
+LogFormat LogFormatFromString(const std::string &s) {
+  if (s == "jsonl") {
+    return LOG_FORMAT_JSONL;
+  }
+  return LOG_FORMAT_TEXT;
+}
+
+LogQueuePolicy LogQueuePolicyFromString(const std::string &s) {
+  if (s == "drop_oldest") {
+    return LOG_QUEUE_DROP_OLDEST;
+  }
+  if (s == "block") {
+    return LOG_QUEUE_BLOCK;
+  }
+  return LOG_QUEUE_DROP_NEWEST;
+}
+
+LogCompression LogCompressionFromString(const std::string &s) {
+  if (s == "gzip") {
+    return LOG_COMPRESSION_GZIP;
+  }
+  if (s == "zstd") {
+    return LOG_COMPRESSION_ZSTD;
+  }
+  return LOG_COMPRESSION_NONE;
+}
+
+// Parses "udp://host:port" or "syslog://host[:port]"; IPv6 addresses must
+// be enclosed in brackets. Anything else means LOG_SINK_NONE.
+void LogSinkFromString(const std::string &s,
+                       LogSinkType &type,
+                       std::string &host,
+                       std::string &port) {
+  type = LOG_SINK_NONE;
+  host.clear();
+  port.clear();
+
+  std::string::size_type scheme_end = s.find("://");
+  if (scheme_end == std::string::npos) {
+    return;
+  }
+  std::string scheme = s.substr(0, scheme_end);
+  std::string address = s.substr(scheme_end + 3);
+
+  std::string::size_type port_start;
+  if (!address.empty() && address[0] == '[') {
+    std::string::size_type host_end = address.find(']');
+    if (host_end == std::string::npos) {
+      return;
+    }
+    host = address.substr(1, host_end - 1);
+    port_start = address.find(':', host_end);
+  } else {
+    port_start = address.rfind(':');
+    host = address.substr(0, port_start);
+  }
+  if (port_start != std::string::npos) {
+    port = address.substr(port_start + 1);
+  }
+  if (host.empty()) {
+    return;
+  }
+
+  if (scheme == "udp" && !port.empty()) {
+    type = LOG_SINK_UDP;
+  } else if (scheme == "syslog") {
+    type = LOG_SINK_SYSLOG;
+    if (port.empty()) {
+      port = "514";
+    }
+  }
+}
+
+// Parses "<entries|bytes|ms> <n>"; anything else means LOG_FLUSH_BATCH.
+void LogFlushPolicyFromString(const std::string &s,
+                              LogFlushPolicy &policy,
+                              unsigned int &value) {
+  policy = LOG_FLUSH_BATCH;
+  value = 0;
+
+  std::istringstream stream(s);
+  std::string name;
+  unsigned long n;
+  if (!(stream >> name >> n) || n == 0) {
+    return;
+  }
+  if (name == "entries") {
+    policy = LOG_FLUSH_ENTRIES;
+  } else if (name == "bytes") {
+    policy = LOG_FLUSH_BYTES;
+  } else if (name == "ms") {
+    policy = LOG_FLUSH_INTERVAL;
+  } else {
+    return;
+  }
+  value = static_cast<unsigned int>(n);
+}
+
+// Parses "<count>/<seconds>"; anything else means no throttling.
+void ErrorThrottleFromString(const std::string &s,
+                             unsigned int &count,
+                             unsigned int &seconds) {
+  count = 0;
+  seconds = 0;
+
+  std::istringstream stream(s);
+  unsigned long n, t;
+  char slash;
+  if (!(stream >> n >> slash >> t) || slash != '/' || n == 0 || t == 0) {
+    return;
+  }
+  count = static_cast<unsigned int>(n);
+  seconds = static_cast<unsigned int>(t);
+}
+
+// Paths are compared with forward slashes on all platforms.
+std::string NormalizePath(std::string path) {
+  std::replace(path.begin(), path.end(), '\\', '/');
+  return path;
+}
+
 } // namespace
 
 Options::Options():
+  mode_(MODE_DEFAULT),
   trace_flags_(0),
-  trace_filter_(nullptr)
+  trace_filter_(nullptr),
+  trace_filter_names_only_(false),
+  trace_mode_(TRACE_MODE_LOG),
+  trace_interval_(60),
+  trace_sample_(0),
+  trace_rate_(0),
+  trace_output_(TRACE_OUTPUT_TEXT),
+  log_format_(LOG_FORMAT_TEXT),
+  log_queue_size_(0),
+  log_queue_policy_(LOG_QUEUE_DROP_NEWEST),
+  log_flush_policy_(LOG_FLUSH_BATCH),
+  log_flush_value_(0),
+  log_max_size_(0),
+  log_keep_(0),
+  log_compress_(LOG_COMPRESSION_NONE),
+  log_sink_type_(LOG_SINK_NONE)
 {
   ConfigReader server_cfg("server.cfg");
 
+  // Lite mode only changes the defaults of the settings below, so any of
+  // them can still be turned back on explicitly.
+  mode_ = ModeFromString(server_cfg.GetValueWithDefault("crashdetect_mode"));
+  bool lite = mode_ == MODE_LITE;
+
   trace_flags_ = TraceFlagsFromString(server_cfg.GetValueWithDefault("trace"));
-  std::string trace_filter_pattern =
-    server_cfg.GetValueWithDefault("trace_filter");
-  if (!trace_filter_pattern.empty()) {
-    trace_filter_ = new RegExp(trace_filter_pattern);
+  // Several patterns can be given as trace_filter, trace_filter2,
+  // trace_filter3 and so on (server.cfg only keeps one value per key).
+  std::vector<std::string> trace_filter_patterns;
+  for (int i = 1; ; i++) {
+    std::string key = "trace_filter";
+    if (i > 1) {
+      key += std::to_string(i);
+    }
+    std::string pattern = server_cfg.GetValueWithDefault(key);
+    if (pattern.empty()) {
+      break;
+    }
+    trace_filter_patterns.push_back(pattern);
   }
+  SetTraceFilter(trace_filter_patterns);
+  trace_native_modules_ =
+    server_cfg.GetValues<std::string>("trace_native_modules");
+  trace_publics_ = server_cfg.GetValues<std::string>("trace_publics");
+  trace_files_ = server_cfg.GetValues<std::string>("trace_files");
+  trace_mode_ =
+    TraceModeFromString(server_cfg.GetValueWithDefault("trace_mode"));
+  trace_interval_ = server_cfg.GetValueWithDefault("trace_interval", 60U);
+  trace_sample_ = server_cfg.GetValueWithDefault("trace_sample", 0U);
+  trace_rate_ = server_cfg.GetValueWithDefault("trace_rate", 0U);
+  trace_async_ = server_cfg.GetValueWithDefault("trace_async", false);
+  trace_output_ =
+    TraceOutputFromString(server_cfg.GetValueWithDefault("trace_output"));
+  trace_file_ =
+    server_cfg.GetValueWithDefault("trace_file",
+                                   std::string(
+                                     trace_output_ == TRACE_OUTPUT_CHROME
+                                     ? "crashdetect_trace.json"
+                                     : "crashdetect_trace.bin"));
+  trace_native_signatures_ =
+    server_cfg.GetValueWithDefault("trace_native_signatures");
 
   log_path_ = server_cfg.GetValueWithDefault("crashdetect_log");
   log_time_format_ =
     server_cfg.GetValueWithDefault("logtimeformat", "[%H:%M:%S]");
+  log_format_ = LogFormatFromString(
+    server_cfg.GetValueWithDefault("crashdetect_log_format"));
+  log_queue_size_ =
+    server_cfg.GetValueWithDefault("crashdetect_log_queue_size", 16777216U);
+  log_queue_policy_ = LogQueuePolicyFromString(
+    server_cfg.GetValueWithDefault("crashdetect_log_queue_policy"));
+  LogFlushPolicyFromString(
+    server_cfg.GetValueWithDefault("crashdetect_log_flush"),
+    log_flush_policy_,
+    log_flush_value_);
+  log_max_size_ =
+    server_cfg.GetValueWithDefault("crashdetect_log_max_size", 0U);
+  log_keep_ = server_cfg.GetValueWithDefault("crashdetect_log_keep", 5U);
+  log_compress_ = LogCompressionFromString(
+    server_cfg.GetValueWithDefault("crashdetect_log_compress"));
+  LogSinkFromString(
+    server_cfg.GetValueWithDefault("crashdetect_log_sink"),
+    log_sink_type_,
+    log_sink_host_,
+    log_sink_port_);
+
+  LogChannelOptions &main_log = log_channels_[LOG_CHANNEL_MAIN];
+  main_log.enabled = true;
+  main_log.path = log_path_;
+  main_log.sink_type = log_sink_type_;
+  main_log.sink_host = log_sink_host_;
+  main_log.sink_port = log_sink_port_;
+  static const char *const kLogChannelNames[] = {
+    nullptr,
+    "crashdetect_trace_log",
+    "crashdetect_error_log",
+    "crashdetect_crash_log"
+  };
+  for (int i = LOG_CHANNEL_MAIN + 1; i < LOG_CHANNEL_COUNT; i++) {
+    std::string name = kLogChannelNames[i];
+    LogChannelOptions &channel = log_channels_[i];
+    channel.path = server_cfg.GetValueWithDefault(name);
+    LogSinkFromString(
+      server_cfg.GetValueWithDefault(name + "_sink"),
+      channel.sink_type,
+      channel.sink_host,
+      channel.sink_port);
+    channel.enabled = !channel.path.empty()
+                      || channel.sink_type != LOG_SINK_NONE;
+    // A channel with only a file of its own still goes to the main sink.
+    if (channel.sink_type == LOG_SINK_NONE) {
+      channel.sink_type = main_log.sink_type;
+      channel.sink_host = main_log.sink_host;
+      channel.sink_port = main_log.sink_port;
+    }
+  }
+
+  // Only plain UDP makes sense for reports.
+  LogSinkType report_collector_type;
+  LogSinkFromString(
+    server_cfg.GetValueWithDefault("report_collector"),
+    report_collector_type,
+    report_collector_host_,
+    report_collector_port_);
+  if (report_collector_type != LOG_SINK_UDP) {
+    report_collector_host_.clear();
+    report_collector_port_.clear();
+  }
+  report_interval_ = server_cfg.GetValueWithDefault("report_interval", 60U);
+
+  // StatsD is UDP only as well.
+  LogSinkType metrics_type;
+  LogSinkFromString(
+    server_cfg.GetValueWithDefault("metrics"),
+    metrics_type,
+    metrics_host_,
+    metrics_port_);
+  if (metrics_type != LOG_SINK_UDP) {
+    metrics_host_.clear();
+    metrics_port_.clear();
+  }
+  metrics_interval_ = server_cfg.GetValueWithDefault("metrics_interval", 10U);
+  metrics_prefix_ = server_cfg.GetValueWithDefault("metrics_prefix",
+                                                   std::string("crashdetect"));
+  stats_segment_ = server_cfg.GetValueWithDefault("stats_segment", false);
+  stats_interval_ = server_cfg.GetValueWithDefault("stats_interval", 1000U);
 
   long_call_time_ = server_cfg.GetValueWithDefault("long_call_time", 5000U);
+  std::vector<std::string> long_call_time_publics =
+    server_cfg.GetValues<std::string>("long_call_time_publics");
+  for (std::size_t i = 0; i < long_call_time_publics.size(); i++) {
+    const std::string &value = long_call_time_publics[i];
+    std::string::size_type eq = value.find('=');
+    if (eq == std::string::npos || eq == 0) {
+      continue;
+    }
+    long_call_time_publics_.push_back(std::make_pair(
+      value.substr(0, eq),
+      static_cast<unsigned int>(
+        std::strtoul(value.c_str() + eq + 1, nullptr, 10))));
+  }
+  long_call_budget_ = LongCallBudgetFromString(
+    server_cfg.GetValueWithDefault("long_call_budget"));
+  hang_timeout_ = server_cfg.GetValueWithDefault("hang_timeout", 0U);
+  std::vector<std::string> thread_affinity =
+    server_cfg.GetValues<std::string>("thread_affinity");
+  for (std::size_t i = 0; i < thread_affinity.size(); i++) {
+    const std::string &value = thread_affinity[i];
+    std::string::size_type eq = value.find('=');
+    ThreadClass thread_class = ThreadClassFromString(value.substr(0, eq));
+    if (eq == std::string::npos || thread_class == THREAD_CLASS_COUNT) {
+      continue;
+    }
+    std::vector<int> &cpus = thread_policies_[thread_class].cpus;
+    stringutils::SplitString(value.substr(eq + 1), ',',
+                             [&cpus](const std::string &cpu) {
+      cpus.push_back(std::atoi(cpu.c_str()));
+    });
+  }
+  std::vector<std::string> thread_priority =
+    server_cfg.GetValues<std::string>("thread_priority");
+  for (std::size_t i = 0; i < thread_priority.size(); i++) {
+    const std::string &value = thread_priority[i];
+    std::string::size_type eq = value.find('=');
+    ThreadClass thread_class = ThreadClassFromString(value.substr(0, eq));
+    if (eq == std::string::npos || thread_class == THREAD_CLASS_COUNT) {
+      continue;
+    }
+    thread_policies_[thread_class].set_niceness = true;
+    thread_policies_[thread_class].niceness =
+      std::atoi(value.c_str() + eq + 1);
+  }
+  flight_recorder_ = server_cfg.GetValueWithDefault("flight_recorder", 0U);
+  flight_recorder_file_ =
+    server_cfg.GetValueWithDefault("flight_recorder_file");
+  integrity_check_ =
+    server_cfg.GetValueWithDefault("integrity_check", false);
+  integrity_check_budget_ =
+    server_cfg.GetValueWithDefault("integrity_check_budget", 100U);
+  idle_budget_ = server_cfg.GetValueWithDefault("idle_budget", 1000U);
+  error_repeat_time_ =
+    server_cfg.GetValueWithDefault("error_repeat_time", 10U);
+  ErrorThrottleFromString(
+    server_cfg.GetValueWithDefault("error_throttle"),
+    error_throttle_count_,
+    error_throttle_time_);
+  disasm_instructions_ =
+    server_cfg.GetValueWithDefault("disasm_instructions", 3U);
+  backtrace_depth_ = server_cfg.GetValueWithDefault("backtrace_depth", 100U);
+  if (backtrace_depth_ == 0) {
+    backtrace_depth_ = 100;
+  }
+  backtrace_head_ = server_cfg.GetValueWithDefault("backtrace_head", 0U);
+  backtrace_tail_ = server_cfg.GetValueWithDefault("backtrace_tail", 0U);
+  backtrace_async_ =
+    server_cfg.GetValueWithDefault("backtrace_async", false);
+  stack_usage_ = server_cfg.GetValueWithDefault("stack_usage", false);
+  stack_usage_interval_ =
+    server_cfg.GetValueWithDefault("stack_usage_interval", 0U);
+  stack_usage_headroom_ =
+    server_cfg.GetValueWithDefault("stack_usage_headroom", 25U);
+  heap_profile_ = server_cfg.GetValueWithDefault("heap_profile", false);
+  coverage_ = server_cfg.GetValueWithDefault("coverage", false);
+  coverage_format_ = CoverageFormatFromString(
+    server_cfg.GetValueWithDefault("coverage_format"));
+  line_profile_ = server_cfg.GetValueWithDefault("line_profile", false);
+  file_stats_ = server_cfg.GetValueWithDefault("file_stats", false);
+  callback_stats_ = server_cfg.GetValueWithDefault("callback_stats", false);
+  callback_stats_interval_ =
+    server_cfg.GetValueWithDefault("callback_stats_interval", 0U);
+  timer_stats_ = server_cfg.GetValueWithDefault("timer_stats", false);
+  redundant_natives_ =
+    server_cfg.GetValueWithDefault("redundant_natives", 0U);
+  native_site_stats_ =
+    server_cfg.GetValueWithDefault("native_site_stats", 0U);
+  dispatch_stats_ =
+    server_cfg.GetValueWithDefault("dispatch_stats", false);
+  argument_stats_ =
+    server_cfg.GetValueWithDefault("argument_stats", false);
+  argument_stats_size_ =
+    server_cfg.GetValueWithDefault("argument_stats_size", 256U);
+  argument_stats_interval_ =
+    server_cfg.GetValueWithDefault("argument_stats_interval", 0U);
+  profile_callgraph_ =
+    server_cfg.GetValueWithDefault("profile") == "callgraph";
+  long_call_profile_ =
+    server_cfg.GetValueWithDefault("long_call_profile", false);
+  long_call_profile_interval_ =
+    server_cfg.GetValueWithDefault("long_call_profile_interval", 1000U);
+  tick_budget_ = server_cfg.GetValueWithDefault("tick_budget", 0U);
+  native_stats_ = server_cfg.GetValueWithDefault("native_stats", false);
+  native_stats_interval_ =
+    server_cfg.GetValueWithDefault("native_stats_interval", 0U);
+  profiler_ = server_cfg.GetValueWithDefault("profiler", false);
+  profiler_interval_ =
+    server_cfg.GetValueWithDefault("profiler_interval", 1000U);
+  profiler_file_ =
+    server_cfg.GetValueWithDefault("profiler_file", "crashdetect_profile.txt");
+  profiler_native_ = server_cfg.GetValueWithDefault("profiler_native", false);
+  crash_dump_ = server_cfg.GetValueWithDefault("crash_dump");
+  crash_stack_size_ =
+    server_cfg.GetValueWithDefault("crash_stack_size", 256U);
+  startup_timing_ = server_cfg.GetValueWithDefault("startup_timing", false);
+
+  sysreq_d_ = server_cfg.GetValueWithDefault("sysreq_d", true);
+  track_cip_ = server_cfg.GetValueWithDefault("track_cip", !lite);
+  fuse_opcodes_ = server_cfg.GetValueWithDefault("fuse_opcodes", false);
+  watch_files_ = server_cfg.GetValueWithDefault("watch_files", true);
+  jit_ = server_cfg.GetValueWithDefault("jit", false);
+  perf_map_ = server_cfg.GetValueWithDefault("perf_map", false);
+  opcode_counts_ = server_cfg.GetValueWithDefault("opcode_counts", false);
+  block_counts_ = server_cfg.GetValueWithDefault("block_counts", false);
+
+  debug_info_mmap_ = server_cfg.GetValueWithDefault("debug_info_mmap", true);
+  debug_info_lazy_ = server_cfg.GetValueWithDefault("debug_info_lazy", lite);
+  debug_info_async_ =
+    server_cfg.GetValueWithDefault("debug_info_async", false);
+  debug_info_index_ = server_cfg.GetValueWithDefault("debug_info_index", false);
+  debug_info_level_ = DebugInfoLevelFromString(
+    server_cfg.GetValueWithDefault("debug_info_level"));
+
+  config_ = server_cfg.GetOptions();
+
+  // Only the settings that are looked up with GetScriptOption().
+  const ConfigReader::option_map &options = config_;
+  for (ConfigReader::option_map::const_iterator it = options.begin();
+       it != options.end(); it++) {
+    std::string::size_type dot = it->first.find('.');
+    if (dot == std::string::npos) {
+      continue;
+    }
+    ScriptOption option;
+    option.name = it->first.substr(0, dot);
+    option.pattern = NormalizePath(it->first.substr(dot + 1));
+    option.value = it->second;
+    if (option.name == "trace" || option.name == "long_call_time") {
+      script_options_.push_back(option);
+    }
+  }
 }
 
 Options::~Options() {
   delete trace_filter_;
 }
 
+bool Options::SetTrace(const std::string &flags,
+                       const std::vector<std::string> &filter_patterns) {
+  unsigned int trace_flags = TraceFlagsFromString(flags);
+  std::size_t num_script_options = script_options_.size();
+  script_options_.erase(
+    std::remove_if(script_options_.begin(), script_options_.end(),
+                   [](const ScriptOption &option) {
+                     return option.name == "trace";
+                   }),
+    script_options_.end());
+  if (trace_flags == trace_flags_
+      && filter_patterns == trace_filter_patterns_
+      && script_options_.size() == num_script_options) {
+    return false;
+  }
+  trace_flags_ = trace_flags;
+  SetTraceFilter(filter_patterns);
+  return true;
+}
+
+unsigned int Options::GetScriptTraceFlags(
+    const std::string &script_path) const {
+  const std::string *value = GetScriptOption("trace", script_path);
+  if (value == nullptr) {
+    return trace_flags_;
+  }
+  return TraceFlagsFromString(*value);
+}
+
+bool Options::GetScriptLongCallTime(const std::string &script_path,
+                                    unsigned int &time) const {
+  const std::string *value = GetScriptOption("long_call_time", script_path);
+  if (value == nullptr) {
+    return false;
+  }
+  time = static_cast<unsigned int>(std::strtoul(value->c_str(), nullptr, 10));
+  return true;
+}
+
+bool Options::HasTraceFlags() const {
+  if (trace_flags_ != 0) {
+    return true;
+  }
+  for (std::size_t i = 0; i < script_options_.size(); i++) {
+    if (script_options_[i].name == "trace"
+        && TraceFlagsFromString(script_options_[i].value) != 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool Options::HasLongCallTime() const {
+  if (long_call_time_ != 0) {
+    return true;
+  }
+  for (std::size_t i = 0; i < long_call_time_publics_.size(); i++) {
+    if (long_call_time_publics_[i].second != 0) {
+      return true;
+    }
+  }
+  for (std::size_t i = 0; i < script_options_.size(); i++) {
+    const ScriptOption &option = script_options_[i];
+    if (option.name == "long_call_time"
+        && std::strtoul(option.value.c_str(), nullptr, 10) != 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool Options::HasScriptLongCallTime() const {
+  for (std::size_t i = 0; i < script_options_.size(); i++) {
+    if (script_options_[i].name == "long_call_time") {
+      return true;
+    }
+  }
+  return false;
+}
+
+const std::string *Options::GetScriptOption(
+    const std::string &name,
+    const std::string &script_path) const {
+  if (script_path.empty()) {
+    return nullptr;
+  }
+  std::string path = NormalizePath(script_path);
+  const ScriptOption *match = nullptr;
+  for (std::size_t i = 0; i < script_options_.size(); i++) {
+    const ScriptOption &option = script_options_[i];
+    if (option.name == name
+        && stringutils::MatchWildcard(option.pattern, path)
+        && (match == nullptr
+            || option.pattern.length() > match->pattern.length())) {
+      match = &option;
+    }
+  }
+  return match != nullptr ? &match->value : nullptr;
+}
+
+void Options::SetTraceFilter(const std::vector<std::string> &patterns) {
+  delete trace_filter_;
+  trace_filter_ = nullptr;
+  trace_filter_names_only_ = false;
+  trace_filter_patterns_ = patterns;
+  if (!patterns.empty()) {
+    trace_filter_ = new RegExp(patterns);
+    // Argument values are printed as name=value, so a pattern without '='
+    // is assumed to only look at function names.
+    trace_filter_names_only_ = true;
+    for (std::size_t i = 0; i < patterns.size(); i++) {
+      if (patterns[i].find('=') != std::string::npos) {
+        trace_filter_names_only_ = false;
+      }
+    }
+  }
+}
+
+// static
+bool Options::Reload() {
+  Options *options = new Options;
+  if (options->config_ == shared().config_) {
+    delete options;
+    return false;
+  }
+  current().store(options, std::memory_order_release);
+  return true;
+}
+
 // static
 Options &Options::shared() {
-  static Options instance;
-  return instance;
+  return *current().load(std::memory_order_acquire);
+}
+
+// static
+std::atomic<Options *> &Options::current() {
+  static std::atomic<Options *> options(new Options);
+  return options;
 }
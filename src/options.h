@@ -25,30 +25,337 @@
 #ifndef OPTIONS_H
 #define OPTIONS_H
 
+#include <atomic>
+#include <map>
 #include <string>
+#include <utility>
+#include <vector>
+#include "threadpolicy.h"
 
 class RegExp;
 
+enum CrashDetectMode {
+  MODE_DEFAULT,
+  MODE_LITE
+};
+
 enum TraceFlags {
   TRACE_NONE = 0x00,
   TRACE_NATIVES = 0x01,
   TRACE_PUBLICS = 0x02,
-  TRACE_FUNCTIONS = 0x04
+  TRACE_FUNCTIONS = 0x04,
+  TRACE_TIMERS = 0x08
+};
+
+enum DebugInfoLevel {
+  DEBUG_INFO_LINES,
+  DEBUG_INFO_ARGUMENTS,
+  DEBUG_INFO_FULL
+};
+
+enum TraceMode {
+  TRACE_MODE_LOG,
+  TRACE_MODE_COUNTS
+};
+
+enum TraceOutput {
+  TRACE_OUTPUT_TEXT,
+  TRACE_OUTPUT_BINARY,
+  TRACE_OUTPUT_CHROME
+};
+
+enum CoverageFormat {
+  COVERAGE_FORMAT_LCOV,
+  COVERAGE_FORMAT_JSON
+};
+
+enum LongCallBudget {
+  LONG_CALL_BUDGET_TOTAL,
+  LONG_CALL_BUDGET_SCRIPT,
+  LONG_CALL_BUDGET_NATIVES
+};
+
+enum LogFlushPolicy {
+  LOG_FLUSH_BATCH,
+  LOG_FLUSH_ENTRIES,
+  LOG_FLUSH_BYTES,
+  LOG_FLUSH_INTERVAL
+};
+
+enum LogFormat {
+  LOG_FORMAT_TEXT,
+  LOG_FORMAT_JSONL
+};
+
+enum LogQueuePolicy {
+  LOG_QUEUE_DROP_NEWEST,
+  LOG_QUEUE_DROP_OLDEST,
+  LOG_QUEUE_BLOCK
+};
+
+enum LogCompression {
+  LOG_COMPRESSION_NONE,
+  LOG_COMPRESSION_GZIP,
+  LOG_COMPRESSION_ZSTD
+};
+
+enum LogSinkType {
+  LOG_SINK_NONE,
+  LOG_SINK_UDP,
+  LOG_SINK_SYSLOG
+};
+
+enum LogChannel {
+  LOG_CHANNEL_MAIN,
+  LOG_CHANNEL_TRACE,
+  LOG_CHANNEL_ERROR,
+  LOG_CHANNEL_CRASH,
+  LOG_CHANNEL_COUNT
+};
+
+// Where the lines printed to a log channel go. Channels other than
+// LOG_CHANNEL_MAIN are only enabled if they have a file or a sink of their
+// own, otherwise their lines go to the main log.
+struct LogChannelOptions {
+  LogChannelOptions(): enabled(false), sink_type(LOG_SINK_NONE) {}
+  bool enabled;
+  std::string path;
+  LogSinkType sink_type;
+  std::string sink_host;
+  std::string sink_port;
 };
 
 class Options {
  public:
+  CrashDetectMode mode()
+    const { return mode_; }
   unsigned int trace_flags()
     const { return trace_flags_; }
   unsigned int long_call_time()
     const { return long_call_time_; }
+  // Public names and their own long_call_time, from long_call_time_publics.
+  const std::vector<std::pair<std::string, unsigned int>> &
+    long_call_time_publics() const { return long_call_time_publics_; }
+  LongCallBudget long_call_budget()
+    const { return long_call_budget_; }
+  unsigned int hang_timeout()
+    const { return hang_timeout_; }
+  const ThreadPolicy &thread_policy(ThreadClass thread_class)
+    const { return thread_policies_[thread_class]; }
+  unsigned int flight_recorder()
+    const { return flight_recorder_; }
+  const std::string &flight_recorder_file()
+    const { return flight_recorder_file_; }
+  bool integrity_check()
+    const { return integrity_check_; }
+  unsigned int integrity_check_budget()
+    const { return integrity_check_budget_; }
+  unsigned int idle_budget()
+    const { return idle_budget_; }
+  unsigned int error_repeat_time()
+    const { return error_repeat_time_; }
+  unsigned int error_throttle_count()
+    const { return error_throttle_count_; }
+  unsigned int error_throttle_time()
+    const { return error_throttle_time_; }
   const RegExp *trace_filter()
     const { return trace_filter_; }
+  bool trace_filter_names_only()
+    const { return trace_filter_names_only_; }
+  const std::vector<std::string> &trace_native_modules()
+    const { return trace_native_modules_; }
+  const std::vector<std::string> &trace_publics()
+    const { return trace_publics_; }
+  const std::vector<std::string> &trace_files()
+    const { return trace_files_; }
+  TraceMode trace_mode()
+    const { return trace_mode_; }
+  unsigned int trace_interval()
+    const { return trace_interval_; }
+  unsigned int trace_sample()
+    const { return trace_sample_; }
+  unsigned int trace_rate()
+    const { return trace_rate_; }
+  bool trace_async()
+    const { return trace_async_; }
+  TraceOutput trace_output()
+    const { return trace_output_; }
+  const std::string &trace_file()
+    const { return trace_file_; }
+  const std::string &trace_native_signatures()
+    const { return trace_native_signatures_; }
   const std::string &log_path()
     const { return log_path_; }
   const std::string &log_time_format()
     const { return log_time_format_; }
+  LogFormat log_format()
+    const { return log_format_; }
+  unsigned int log_queue_size()
+    const { return log_queue_size_; }
+  LogQueuePolicy log_queue_policy()
+    const { return log_queue_policy_; }
+  LogFlushPolicy log_flush_policy()
+    const { return log_flush_policy_; }
+  unsigned int log_flush_value()
+    const { return log_flush_value_; }
+  unsigned int log_max_size()
+    const { return log_max_size_; }
+  unsigned int log_keep()
+    const { return log_keep_; }
+  LogCompression log_compress()
+    const { return log_compress_; }
+  LogSinkType log_sink_type()
+    const { return log_sink_type_; }
+  const std::string &log_sink_host()
+    const { return log_sink_host_; }
+  const std::string &log_sink_port()
+    const { return log_sink_port_; }
+  const LogChannelOptions &log_channel(LogChannel channel)
+    const { return log_channels_[channel]; }
+  const std::string &report_collector_host()
+    const { return report_collector_host_; }
+  const std::string &report_collector_port()
+    const { return report_collector_port_; }
+  unsigned int report_interval()
+    const { return report_interval_; }
+  const std::string &metrics_host()
+    const { return metrics_host_; }
+  const std::string &metrics_port()
+    const { return metrics_port_; }
+  unsigned int metrics_interval()
+    const { return metrics_interval_; }
+  const std::string &metrics_prefix()
+    const { return metrics_prefix_; }
+  bool stats_segment()
+    const { return stats_segment_; }
+  unsigned int stats_interval()
+    const { return stats_interval_; }
+  bool sysreq_d()
+    const { return sysreq_d_; }
+  bool track_cip()
+    const { return track_cip_; }
+  bool fuse_opcodes()
+    const { return fuse_opcodes_; }
+  bool watch_files()
+    const { return watch_files_; }
+  bool jit()
+    const { return jit_; }
+  bool perf_map()
+    const { return perf_map_; }
+  bool opcode_counts()
+    const { return opcode_counts_; }
+  bool block_counts()
+    const { return block_counts_; }
+  unsigned int disasm_instructions()
+    const { return disasm_instructions_; }
+  unsigned int backtrace_depth()
+    const { return backtrace_depth_; }
+  unsigned int backtrace_head()
+    const { return backtrace_head_; }
+  unsigned int backtrace_tail()
+    const { return backtrace_tail_; }
+  bool backtrace_async()
+    const { return backtrace_async_; }
+  bool stack_usage()
+    const { return stack_usage_; }
+  unsigned int stack_usage_interval()
+    const { return stack_usage_interval_; }
+  unsigned int stack_usage_headroom()
+    const { return stack_usage_headroom_; }
+  bool heap_profile()
+    const { return heap_profile_; }
+  bool coverage()
+    const { return coverage_; }
+  CoverageFormat coverage_format()
+    const { return coverage_format_; }
+  bool line_profile()
+    const { return line_profile_; }
+  bool file_stats()
+    const { return file_stats_; }
+  bool callback_stats()
+    const { return callback_stats_; }
+  unsigned int callback_stats_interval()
+    const { return callback_stats_interval_; }
+  bool timer_stats()
+    const { return timer_stats_; }
+  unsigned int redundant_natives()
+    const { return redundant_natives_; }
+  unsigned int native_site_stats()
+    const { return native_site_stats_; }
+  bool dispatch_stats()
+    const { return dispatch_stats_; }
+  bool argument_stats()
+    const { return argument_stats_; }
+  unsigned int argument_stats_size()
+    const { return argument_stats_size_; }
+  unsigned int argument_stats_interval()
+    const { return argument_stats_interval_; }
+  bool profile_callgraph()
+    const { return profile_callgraph_; }
+  bool long_call_profile()
+    const { return long_call_profile_; }
+  unsigned int long_call_profile_interval()
+    const { return long_call_profile_interval_; }
+  unsigned int tick_budget()
+    const { return tick_budget_; }
+  bool native_stats()
+    const { return native_stats_; }
+  unsigned int native_stats_interval()
+    const { return native_stats_interval_; }
+  bool profiler()
+    const { return profiler_; }
+  unsigned int profiler_interval()
+    const { return profiler_interval_; }
+  const std::string &profiler_file()
+    const { return profiler_file_; }
+  bool profiler_native()
+    const { return profiler_native_; }
+  const std::string &crash_dump()
+    const { return crash_dump_; }
+  unsigned int crash_stack_size()
+    const { return crash_stack_size_; }
+  bool debug_info_mmap()
+    const { return debug_info_mmap_; }
+  bool debug_info_lazy()
+    const { return debug_info_lazy_; }
+  bool debug_info_async()
+    const { return debug_info_async_; }
+  bool debug_info_index()
+    const { return debug_info_index_; }
+  DebugInfoLevel debug_info_level()
+    const { return debug_info_level_; }
+  bool startup_timing()
+    const { return startup_timing_; }
+
+  // Replaces the trace flags and filter (see the trace and trace_filter
+  // options), including the per-script trace flags. Returns false if
+  // nothing has changed.
+  bool SetTrace(const std::string &flags,
+                const std::vector<std::string> &filter_patterns);
 
+  // Per-script settings, given as "name.pattern value" in server.cfg. They
+  // fall back to the global setting if no pattern matches the script's
+  // path.
+  unsigned int GetScriptTraceFlags(const std::string &script_path) const;
+
+  // Returns false if the script doesn't have its own long_call_time.
+  bool GetScriptLongCallTime(const std::string &script_path,
+                             unsigned int &time) const;
+
+  // Whether the trace flags or long_call_time are non-zero for any script.
+  bool HasTraceFlags() const;
+  bool HasLongCallTime() const;
+
+  // Whether any script has its own long_call_time.
+  bool HasScriptLongCallTime() const;
+
+  // Reads server.cfg again and makes the new options current. Returns
+  // false if nothing has changed since the last time it was read.
+  static bool Reload();
+
+  // The current options. A reload doesn't change the object returned
+  // here, so it's safe to keep using it for a while (e.g. until the end of
+  // a call) on any thread.
   static Options &shared();
 
  private:
@@ -57,12 +364,127 @@ class Options {
   Options &operator=(const Options &options) = delete;
   ~Options();
 
+  void SetTraceFilter(const std::vector<std::string> &patterns);
+
+  struct ScriptOption {
+    std::string name;
+    std::string pattern;
+    std::string value;
+  };
+
+  // Returns the value of the named per-script setting whose pattern matches
+  // the path, or nullptr. The longest pattern wins if there are several.
+  const std::string *GetScriptOption(const std::string &name,
+                                     const std::string &script_path) const;
+
+  // Replaced options are never freed because other threads may still be
+  // reading them. They are small, and reloads are rare.
+  static std::atomic<Options *> &current();
+
  private:
+  CrashDetectMode mode_;
   unsigned int trace_flags_;
   unsigned int long_call_time_;
+  std::vector<std::pair<std::string, unsigned int>> long_call_time_publics_;
+  LongCallBudget long_call_budget_;
+  unsigned int hang_timeout_;
+  ThreadPolicy thread_policies_[THREAD_CLASS_COUNT];
+  unsigned int flight_recorder_;
+  std::string flight_recorder_file_;
+  bool integrity_check_;
+  unsigned int integrity_check_budget_;
+  unsigned int idle_budget_;
+  unsigned int error_repeat_time_;
+  unsigned int error_throttle_count_;
+  unsigned int error_throttle_time_;
   RegExp *trace_filter_;
+  std::vector<std::string> trace_filter_patterns_;
+  bool trace_filter_names_only_;
+  std::vector<std::string> trace_native_modules_;
+  std::vector<std::string> trace_publics_;
+  std::vector<std::string> trace_files_;
+  TraceMode trace_mode_;
+  unsigned int trace_interval_;
+  unsigned int trace_sample_;
+  unsigned int trace_rate_;
+  bool trace_async_;
+  TraceOutput trace_output_;
+  std::string trace_file_;
+  std::string trace_native_signatures_;
   std::string log_path_;
   std::string log_time_format_;
+  LogFormat log_format_;
+  unsigned int log_queue_size_;
+  LogQueuePolicy log_queue_policy_;
+  LogFlushPolicy log_flush_policy_;
+  unsigned int log_flush_value_;
+  unsigned int log_max_size_;
+  unsigned int log_keep_;
+  LogCompression log_compress_;
+  LogSinkType log_sink_type_;
+  std::string log_sink_host_;
+  std::string log_sink_port_;
+  LogChannelOptions log_channels_[LOG_CHANNEL_COUNT];
+  std::string report_collector_host_;
+  std::string report_collector_port_;
+  unsigned int report_interval_;
+  std::string metrics_host_;
+  std::string metrics_port_;
+  unsigned int metrics_interval_;
+  std::string metrics_prefix_;
+  bool stats_segment_;
+  unsigned int stats_interval_;
+  bool sysreq_d_;
+  bool track_cip_;
+  bool fuse_opcodes_;
+  bool watch_files_;
+  bool jit_;
+  bool perf_map_;
+  bool opcode_counts_;
+  bool block_counts_;
+  unsigned int disasm_instructions_;
+  unsigned int backtrace_depth_;
+  unsigned int backtrace_head_;
+  unsigned int backtrace_tail_;
+  bool backtrace_async_;
+  bool stack_usage_;
+  unsigned int stack_usage_interval_;
+  unsigned int stack_usage_headroom_;
+  bool heap_profile_;
+  bool coverage_;
+  CoverageFormat coverage_format_;
+  bool line_profile_;
+  bool file_stats_;
+  bool callback_stats_;
+  unsigned int callback_stats_interval_;
+  bool timer_stats_;
+  unsigned int redundant_natives_;
+  unsigned int native_site_stats_;
+  bool dispatch_stats_;
+  bool argument_stats_;
+  unsigned int argument_stats_size_;
+  unsigned int argument_stats_interval_;
+  bool profile_callgraph_;
+  bool long_call_profile_;
+  unsigned int long_call_profile_interval_;
+  unsigned int tick_budget_;
+  bool native_stats_;
+  unsigned int native_stats_interval_;
+  bool profiler_;
+  unsigned int profiler_interval_;
+  std::string profiler_file_;
+  bool profiler_native_;
+  std::string crash_dump_;
+  unsigned int crash_stack_size_;
+  bool debug_info_mmap_;
+  bool debug_info_lazy_;
+  bool debug_info_async_;
+  bool debug_info_index_;
+  DebugInfoLevel debug_info_level_;
+  bool startup_timing_;
+  std::vector<ScriptOption> script_options_;
+  // Everything read from server.cfg, to tell if it has changed.
+  std::map<std::string, std::string> config_;
 };
 
 #endif // !OPTIONS_H
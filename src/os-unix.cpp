@@ -22,13 +22,30 @@
 // ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
 // POSSIBILITY OF SUCH DAMAGE.
 
+#include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
 #include <cstring>
+#include <ctime>
+#include <mutex>
 #include <vector>
 #include <dlfcn.h>
+#include <fcntl.h>
 #include <link.h>
+#include <pthread.h>
+#include <semaphore.h>
 #include <signal.h>
 #include <ucontext.h>
+#include <unistd.h>
+#include <linux/hw_breakpoint.h>
+#include <linux/perf_event.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
 #include "os.h"
 
 extern const char *__progname;
@@ -64,17 +81,36 @@ int VisitModule(struct dl_phdr_info *info, size_t size, void *data) {
     name = __progname;
   }
 
-  uint32_t base_address = info->dlpi_addr;
-  uint32_t total_size = 0;
+  // The module spans from the start of its first loadable segment to the
+  // end of the last one.
+  uint32_t start = UINT32_MAX;
+  uint32_t end = 0;
   for (int i = 0; i < info->dlpi_phnum; i++) {
-    total_size += info->dlpi_phdr[i].p_memsz;
+    const ElfW(Phdr) &phdr = info->dlpi_phdr[i];
+    if (phdr.p_type == PT_LOAD) {
+      start = std::min<uint32_t>(start, phdr.p_vaddr);
+      end = std::max<uint32_t>(end, phdr.p_vaddr + phdr.p_memsz);
+    }
+  }
+  if (start > end) {
+    start = end = 0;
   }
 
-  Module module(name, base_address, total_size);
+  Module module(name, info->dlpi_addr + start, end - start);
   modules->push_back(module);
   return 0;
 }
 
+int GetGeneration(struct dl_phdr_info *info, size_t size, void *data) {
+  unsigned long *generation = reinterpret_cast<unsigned long *>(data);
+  if (size >= offsetof(struct dl_phdr_info, dlpi_subs)
+              + sizeof(info->dlpi_subs)) {
+    *generation = static_cast<unsigned long>(info->dlpi_adds)
+                + static_cast<unsigned long>(info->dlpi_subs);
+  }
+  return 1;  // the counters are the same for all modules
+}
+
 } // namespace
 
 void GetLoadedModules(std::vector<Module> &modules) {
@@ -93,6 +129,65 @@ std::string GetModuleName(void *address) {
   return filename;
 }
 
+unsigned long GetModuleGeneration() {
+  unsigned long generation = 0;
+  dl_iterate_phdr(GetGeneration, &generation);
+  return generation;
+}
+
+std::size_t ReadMemory(void *dest, const void *src, std::size_t size) {
+  // The kernel checks the source range for us and stops at a fault instead
+  // of sending a signal.
+  struct iovec local = {dest, size};
+  struct iovec remote = {const_cast<void *>(src), size};
+  ssize_t result = process_vm_readv(getpid(), &local, 1, &remote, 1, 0);
+  return result > 0 ? static_cast<std::size_t>(result) : 0;
+}
+
+namespace {
+
+struct StackBounds {
+  bool initialized;
+  uint32_t low;
+  uint32_t high;
+};
+
+thread_local StackBounds stack_bounds = {false, 0, 0};
+
+// For the main thread this reads /proc/self/maps, so it's done ahead of
+// time by SetUpCrashStack().
+void InitStackBounds() {
+  if (stack_bounds.initialized) {
+    return;
+  }
+  stack_bounds.initialized = true;
+  pthread_attr_t attr;
+  if (pthread_getattr_np(pthread_self(), &attr) != 0) {
+    return;
+  }
+  void *address;
+  std::size_t size;
+  if (pthread_attr_getstack(&attr, &address, &size) == 0) {
+    stack_bounds.low =
+      static_cast<uint32_t>(reinterpret_cast<uintptr_t>(address));
+    stack_bounds.high = static_cast<uint32_t>(stack_bounds.low + size);
+  }
+  pthread_attr_destroy(&attr);
+}
+
+} // namespace
+
+bool GetStackBounds(const void *sp, uint32_t &low, uint32_t &high) {
+  InitStackBounds();
+  uint32_t address = static_cast<uint32_t>(reinterpret_cast<uintptr_t>(sp));
+  if (address < stack_bounds.low || address >= stack_bounds.high) {
+    return false;
+  }
+  low = address;
+  high = stack_bounds.high;
+  return true;
+}
+
 namespace {
 
 typedef void (*SignalHandler)(int signal, siginfo_t *info, void *context);
@@ -103,7 +198,7 @@ void SetSignalHandler(int signal,
   struct sigaction action;
   sigemptyset(&action.sa_mask);
   action.sa_sigaction = handler;
-  action.sa_flags = SA_SIGINFO;
+  action.sa_flags = SA_SIGINFO | SA_ONSTACK;
   sigaction(signal, &action, prev_action);
 }
 
@@ -134,6 +229,74 @@ void SetCrashHandler(CrashHandler handler) {
 
 namespace {
 
+// SIGSTKSZ is only enough for a very simple handler. The crash report
+// walks the AMX stack, disassembles code, etc.
+const std::size_t kSignalStackSize = 256 * 1024;
+
+class SignalStack {
+ public:
+  SignalStack(): memory_(nullptr), size_(0) {}
+  SignalStack(const SignalStack &) = delete;
+  SignalStack &operator=(const SignalStack &) = delete;
+
+  ~SignalStack() {
+    if (memory_ != nullptr) {
+      stack_t stack;
+      std::memset(&stack, 0, sizeof(stack));
+      stack.ss_flags = SS_DISABLE;
+      sigaltstack(&stack, nullptr);
+      munmap(memory_, size_);
+    }
+  }
+
+  void Install() {
+    if (memory_ != nullptr) {
+      return;
+    }
+    // Don't replace a stack set up by the server or another plugin.
+    stack_t current;
+    if (sigaltstack(nullptr, &current) == 0
+        && (current.ss_flags & SS_DISABLE) == 0) {
+      return;
+    }
+    // The lowest page is left inaccessible so that overflowing this stack
+    // doesn't silently corrupt whatever happens to be mapped below it.
+    std::size_t page_size = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+    std::size_t size = kSignalStackSize + page_size;
+    void *memory = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED) {
+      return;
+    }
+    mprotect(memory, page_size, PROT_NONE);
+    stack_t stack;
+    std::memset(&stack, 0, sizeof(stack));
+    stack.ss_sp = static_cast<char *>(memory) + page_size;
+    stack.ss_size = kSignalStackSize;
+    if (sigaltstack(&stack, nullptr) != 0) {
+      munmap(memory, size);
+      return;
+    }
+    memory_ = memory;
+    size_ = size;
+  }
+
+ private:
+  void *memory_;
+  std::size_t size_;
+};
+
+thread_local SignalStack signal_stack;
+
+} // namespace
+
+void SetUpCrashStack() {
+  signal_stack.Install();
+  InitStackBounds();
+}
+
+namespace {
+
 InterruptHandler interrupt_handler;
 struct sigaction prev_sigint_action;
 
@@ -152,4 +315,164 @@ void SetInterruptHandler(InterruptHandler handler) {
   SetSignalHandler(SIGINT, HandleSIGINT, &prev_sigint_action);
 }
 
+namespace {
+
+// Realtime signals aren't used by anything else in the server, and the
+// first ones are taken by glibc itself (SIGRTMIN accounts for that).
+int GetInspectSignal() {
+  return SIGRTMIN + 4;
+}
+
+// How long to wait for the server thread to run the signal handler. It
+// may have the signal blocked.
+const int kInspectTimeout = 5;  // seconds
+
+bool main_thread_set = false;
+pthread_t main_thread;
+std::mutex inspect_mutex;
+sem_t inspect_done;
+InspectHandler inspect_handler = nullptr;
+void *inspect_data = nullptr;
+std::atomic<bool> inspect_pending(false);
+
+void HandleInspectSignal(int signal, siginfo_t *info, void *context) {
+  // A signal that arrives after InspectMainThread() has given up on it is
+  // ignored.
+  if (!inspect_pending.exchange(false)) {
+    return;
+  }
+  inspect_handler(Context(context), inspect_data);
+  sem_post(&inspect_done);
+}
+
+} // namespace
+
+void SetMainThread() {
+  main_thread = pthread_self();
+  main_thread_set = true;
+  sem_init(&inspect_done, 0, 0);
+  SetSignalHandler(GetInspectSignal(), HandleInspectSignal);
+}
+
+bool InspectMainThread(InspectHandler handler, void *data) {
+  if (!main_thread_set) {
+    return false;
+  }
+  std::lock_guard<std::mutex> lock(inspect_mutex);
+  inspect_handler = handler;
+  inspect_data = data;
+  inspect_pending.store(true);
+  if (pthread_kill(main_thread, GetInspectSignal()) != 0) {
+    inspect_pending.store(false);
+    return false;
+  }
+  struct timespec deadline;
+  clock_gettime(CLOCK_REALTIME, &deadline);
+  deadline.tv_sec += kInspectTimeout;
+  for (;;) {
+    if (sem_timedwait(&inspect_done, &deadline) == 0) {
+      return true;
+    }
+    if (errno != EINTR) {
+      break;
+    }
+  }
+  if (inspect_pending.exchange(false)) {
+    return false;
+  }
+  // The handler started just as the wait timed out.
+  while (sem_wait(&inspect_done) != 0 && errno == EINTR) {
+  }
+  return true;
+}
+
+bool SetThreadAffinity(const std::vector<int> &cpus) {
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  for (std::size_t i = 0; i < cpus.size(); i++) {
+    if (cpus[i] >= 0 && cpus[i] < CPU_SETSIZE) {
+      CPU_SET(cpus[i], &set);
+    }
+  }
+  return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+}
+
+bool SetThreadNiceness(int niceness) {
+  // On Linux each thread has its own nice value, and it's looked up by the
+  // thread ID rather than the process ID.
+  id_t tid = static_cast<id_t>(syscall(SYS_gettid));
+  return setpriority(PRIO_PROCESS, tid, niceness) == 0;
+}
+
+namespace {
+
+// User space can't set the debug registers itself, but they can be had as
+// perf event breakpoints. Each overflow of the event (every write, as the
+// sample period is 1) sends a signal to the thread that owns it.
+int GetWatchSignal() {
+  return SIGRTMIN + 5;
+}
+
+WatchHandler watch_handler = nullptr;
+int watch_fds[kNumWatchpoints] = {-1, -1, -1, -1};
+
+void HandleWatchSignal(int signal, siginfo_t *info, void *context) {
+  if (watch_handler == nullptr) {
+    return;
+  }
+  for (int slot = 0; slot < kNumWatchpoints; slot++) {
+    if (watch_fds[slot] >= 0 && watch_fds[slot] == info->si_fd) {
+      watch_handler(Context(context), slot);
+      break;
+    }
+  }
+}
+
+} // namespace
+
+void SetWatchHandler(WatchHandler handler) {
+  watch_handler = handler;
+  SetSignalHandler(GetWatchSignal(), HandleWatchSignal);
+}
+
+bool SetWatchpoint(int slot, const void *address, std::size_t size) {
+  ClearWatchpoint(slot);
+
+  struct perf_event_attr attr;
+  std::memset(&attr, 0, sizeof(attr));
+  attr.type = PERF_TYPE_BREAKPOINT;
+  attr.size = sizeof(attr);
+  attr.bp_type = HW_BREAKPOINT_W;
+  attr.bp_addr = reinterpret_cast<uintptr_t>(address);
+  attr.bp_len = size;
+  attr.sample_period = 1;
+  attr.wakeup_events = 1;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  // The calling thread, on any CPU.
+  int fd = static_cast<int>(
+    syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+  if (fd < 0) {
+    return false;
+  }
+  struct f_owner_ex owner;
+  owner.type = F_OWNER_TID;
+  owner.pid = static_cast<pid_t>(syscall(SYS_gettid));
+  if (fcntl(fd, F_SETSIG, GetWatchSignal()) != 0
+      || fcntl(fd, F_SETOWN_EX, &owner) != 0
+      || fcntl(fd, F_SETFL, O_ASYNC | O_NONBLOCK) != 0) {
+    close(fd);
+    return false;
+  }
+  watch_fds[slot] = fd;
+  return true;
+}
+
+void ClearWatchpoint(int slot) {
+  if (watch_fds[slot] >= 0) {
+    close(watch_fds[slot]);
+    watch_fds[slot] = -1;
+  }
+}
+
 } // namespace os
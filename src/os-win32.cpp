@@ -58,7 +58,7 @@ void GetLoadedModules(std::vector<Module> &modules) {
     module_entry.dwSize = sizeof(module_entry);
     if (Module32First(snapshot, &module_entry)) {
       do {
-        Module module(module_entry.szModule,
+        Module module(module_entry.szExePath,
                       (uint32_t)module_entry.modBaseAddr,
                       module_entry.modBaseSize);
         modules.push_back(module);
@@ -90,6 +90,56 @@ std::string GetModuleName(void *address) {
   return std::string(&filename[0]);
 }
 
+unsigned long GetModuleGeneration() {
+  return 0;
+}
+
+std::size_t ReadMemory(void *dest, const void *src, std::size_t size) {
+  // ReadProcessMemory() fails without copying anything if part of the range
+  // is unreadable, so go page by page.
+  const std::size_t kPageSize = 4096;
+  std::size_t copied = 0;
+  while (copied < size) {
+    const char *from = static_cast<const char *>(src) + copied;
+    std::size_t chunk = std::min(
+      kPageSize - reinterpret_cast<uintptr_t>(from) % kPageSize,
+      size - copied);
+    SIZE_T num_read = 0;
+    if (!ReadProcessMemory(GetCurrentProcess(),
+                           from,
+                           static_cast<char *>(dest) + copied,
+                           chunk,
+                           &num_read)) {
+      break;
+    }
+    copied += num_read;
+  }
+  return copied;
+}
+
+bool GetStackBounds(const void *sp, uint32_t &low, uint32_t &high) {
+  // The context may come from another thread (see SetInterruptHandler()),
+  // so this thread's stack limits can't be used.
+  MEMORY_BASIC_INFORMATION info;
+  if (VirtualQuery(sp, &info, sizeof(info)) == 0) {
+    return false;
+  }
+  const DWORD kReadable = PAGE_READONLY
+                        | PAGE_READWRITE
+                        | PAGE_WRITECOPY
+                        | PAGE_EXECUTE_READ
+                        | PAGE_EXECUTE_READWRITE
+                        | PAGE_EXECUTE_WRITECOPY;
+  if (info.State != MEM_COMMIT
+      || (info.Protect & kReadable) == 0
+      || (info.Protect & PAGE_GUARD) != 0) {
+    return false;
+  }
+  low = reinterpret_cast<uint32_t>(sp);
+  high = reinterpret_cast<uint32_t>(info.BaseAddress) + info.RegionSize;
+  return true;
+}
+
 namespace {
 
 CrashHandler crash_handler = nullptr;
@@ -118,6 +168,29 @@ void SetCrashHandler(CrashHandler handler) {
 
 namespace {
 
+// Windows runs exception filters on the stack that overflowed, with only
+// a few pages left by default. This is how much is kept available for the
+// crash report instead.
+const ULONG kStackGuarantee = 64 * 1024;
+
+typedef BOOL (WINAPI *SetThreadStackGuaranteeFunc)(PULONG size);
+
+} // namespace
+
+void SetUpCrashStack() {
+  // Not available on Windows XP.
+  static SetThreadStackGuaranteeFunc set_thread_stack_guarantee =
+    reinterpret_cast<SetThreadStackGuaranteeFunc>(
+      GetProcAddress(GetModuleHandleA("kernel32.dll"),
+                     "SetThreadStackGuarantee"));
+  if (set_thread_stack_guarantee != nullptr) {
+    ULONG size = kStackGuarantee;
+    set_thread_stack_guarantee(&size);
+  }
+}
+
+namespace {
+
 InterruptHandler interrupt_handler;
 
 struct ThreadInfo {
@@ -176,8 +249,11 @@ DWORD GetMainThreadId() {
        it != threads.end(); it++) {
     ThreadInfo &info = *it;
     HANDLE handle = GetThreadHandle(info.id, THREAD_QUERY_INFORMATION);
-    GetThreadTimes(handle, &info.creation_time, &info.exit_time,
-                           &info.kernel_time,   &info.user_time);
+    if (handle != nullptr) {
+      GetThreadTimes(handle, &info.creation_time, &info.exit_time,
+                             &info.kernel_time,   &info.user_time);
+      CloseHandle(handle);
+    }
   }
 
   threads.erase(
@@ -196,11 +272,13 @@ BOOL GetMainThreadContext(PCONTEXT context) {
     HANDLE thread_handle =
       GetThreadHandle(thread_id, THREAD_GET_CONTEXT | THREAD_SUSPEND_RESUME);
     if (thread_handle != nullptr) {
+      BOOL ok = FALSE;
       if (SuspendThread(thread_handle) != (DWORD)-1) {
-        BOOL ok = GetThreadContext(thread_handle, context);
+        ok = GetThreadContext(thread_handle, context);
         ResumeThread(thread_handle);
-        return ok;
       }
+      CloseHandle(thread_handle);
+      return ok;
     }
   }
   return FALSE;
@@ -223,4 +301,180 @@ void SetInterruptHandler(InterruptHandler handler) {
   SetConsoleCtrlHandler(ConsoleCtrlHandler, TRUE);
 }
 
+namespace {
+
+HANDLE main_thread = nullptr;
+
+} // namespace
+
+void SetMainThread() {
+  DuplicateHandle(GetCurrentProcess(),
+                  GetCurrentThread(),
+                  GetCurrentProcess(),
+                  &main_thread,
+                  THREAD_GET_CONTEXT | THREAD_SUSPEND_RESUME,
+                  FALSE,
+                  0);
+}
+
+bool InspectMainThread(InspectHandler handler, void *data) {
+  if (main_thread == nullptr || SuspendThread(main_thread) == (DWORD)-1) {
+    return false;
+  }
+  // The thread stays suspended until the handler is done, so that its
+  // stack doesn't change under it.
+  CONTEXT context = {0};
+  context.ContextFlags = CONTEXT_FULL;
+  bool ok = GetThreadContext(main_thread, &context) != FALSE;
+  if (ok) {
+    handler(Context(&context), data);
+  }
+  ResumeThread(main_thread);
+  return ok;
+}
+
+bool SetThreadAffinity(const std::vector<int> &cpus) {
+  DWORD_PTR mask = 0;
+  for (std::size_t i = 0; i < cpus.size(); i++) {
+    if (cpus[i] >= 0 && cpus[i] < static_cast<int>(sizeof(mask) * 8)) {
+      mask |= static_cast<DWORD_PTR>(1) << cpus[i];
+    }
+  }
+  return mask != 0 && SetThreadAffinityMask(GetCurrentThread(), mask) != 0;
+}
+
+bool SetThreadNiceness(int niceness) {
+  int priority;
+  if (niceness >= 10) {
+    priority = THREAD_PRIORITY_LOWEST;
+  } else if (niceness > 0) {
+    priority = THREAD_PRIORITY_BELOW_NORMAL;
+  } else if (niceness == 0) {
+    priority = THREAD_PRIORITY_NORMAL;
+  } else if (niceness > -10) {
+    priority = THREAD_PRIORITY_ABOVE_NORMAL;
+  } else {
+    priority = THREAD_PRIORITY_HIGHEST;
+  }
+  return SetThreadPriority(GetCurrentThread(), priority) != FALSE;
+}
+
+namespace {
+
+WatchHandler watch_handler = nullptr;
+// Bit n is set if DRn is ours. Only used by the thread that sets them,
+// which is also where the exceptions happen.
+DWORD watch_slots = 0;
+
+struct DebugRegisterRequest {
+  HANDLE thread;
+  int slot;
+  DWORD address;
+  std::size_t size;  // 0 to clear
+  bool ok;
+};
+
+// A thread's debug registers can only be changed through its context, and
+// not while it's running, so this is done on another thread.
+DWORD WINAPI SetDebugRegister(LPVOID param) {
+  DebugRegisterRequest *request = static_cast<DebugRegisterRequest *>(param);
+  if (SuspendThread(request->thread) == (DWORD)-1) {
+    return 0;
+  }
+  CONTEXT context = {0};
+  context.ContextFlags = CONTEXT_DEBUG_REGISTERS;
+  if (GetThreadContext(request->thread, &context)) {
+    DWORD *address_registers[] = {
+      &context.Dr0, &context.Dr1, &context.Dr2, &context.Dr3
+    };
+    // DR7 has a local enable bit for each register at 2 * n and its
+    // condition (01 = writes) and length (00 = 1, 01 = 2, 11 = 4 bytes)
+    // at 16 + 4 * n.
+    int slot = request->slot;
+    context.Dr7 &= ~((3u << (slot * 2)) | (0xFu << (16 + slot * 4)));
+    if (request->size != 0) {
+      DWORD length = request->size == 1 ? 0 : request->size == 2 ? 1 : 3;
+      *address_registers[slot] = request->address;
+      context.Dr7 |= (1u << (slot * 2))
+                     | ((1u | (length << 2)) << (16 + slot * 4));
+    }
+    request->ok = SetThreadContext(request->thread, &context) != FALSE;
+  }
+  ResumeThread(request->thread);
+  return 0;
+}
+
+bool SetCurrentThreadDebugRegister(int slot,
+                                   const void *address,
+                                   std::size_t size) {
+  DebugRegisterRequest request = {0};
+  if (!DuplicateHandle(GetCurrentProcess(),
+                       GetCurrentThread(),
+                       GetCurrentProcess(),
+                       &request.thread,
+                       THREAD_GET_CONTEXT
+                         | THREAD_SET_CONTEXT
+                         | THREAD_SUSPEND_RESUME,
+                       FALSE,
+                       0)) {
+    return false;
+  }
+  request.slot = slot;
+  request.address = reinterpret_cast<DWORD>(address);
+  request.size = size;
+  request.ok = false;
+  HANDLE helper = CreateThread(nullptr, 0, SetDebugRegister, &request, 0,
+                               nullptr);
+  if (helper != nullptr) {
+    WaitForSingleObject(helper, INFINITE);
+    CloseHandle(helper);
+  }
+  CloseHandle(request.thread);
+  return request.ok;
+}
+
+LONG CALLBACK WatchExceptionHandler(PEXCEPTION_POINTERS exception) {
+  if (exception->ExceptionRecord->ExceptionCode != EXCEPTION_SINGLE_STEP
+      || watch_handler == nullptr) {
+    return EXCEPTION_CONTINUE_SEARCH;
+  }
+  // DR6 tells which of the registers have been hit.
+  DWORD hits = exception->ContextRecord->Dr6 & watch_slots;
+  if (hits == 0) {
+    return EXCEPTION_CONTINUE_SEARCH;
+  }
+  for (int slot = 0; slot < kNumWatchpoints; slot++) {
+    if (hits & (1u << slot)) {
+      watch_handler(Context(exception->ContextRecord), slot);
+    }
+  }
+  exception->ContextRecord->Dr6 = 0;
+  return EXCEPTION_CONTINUE_EXECUTION;
+}
+
+} // namespace
+
+void SetWatchHandler(WatchHandler handler) {
+  static PVOID exception_handler = nullptr;
+  watch_handler = handler;
+  if (exception_handler == nullptr) {
+    exception_handler = AddVectoredExceptionHandler(1, WatchExceptionHandler);
+  }
+}
+
+bool SetWatchpoint(int slot, const void *address, std::size_t size) {
+  if (!SetCurrentThreadDebugRegister(slot, address, size)) {
+    return false;
+  }
+  watch_slots |= 1u << slot;
+  return true;
+}
+
+void ClearWatchpoint(int slot) {
+  if (watch_slots & (1u << slot)) {
+    SetCurrentThreadDebugRegister(slot, nullptr, 0);
+    watch_slots &= ~(1u << slot);
+  }
+}
+
 } // namespace os
@@ -25,6 +25,7 @@
 #ifndef OS_H
 #define OS_H
 
+#include <cstddef>
 #include <string>
 #include <vector>
 
@@ -47,6 +48,8 @@ class Context;
 
 typedef void (*CrashHandler)(const Context &context);
 typedef void (*InterruptHandler)(const Context &context);
+typedef void (*InspectHandler)(const Context &context, void *data);
+typedef void (*WatchHandler)(const Context &context, int slot);
 
 class Context {
  public:
@@ -108,9 +111,65 @@ class Module {
 void GetLoadedModules(std::vector<Module> &modules);
 std::string GetModuleName(void *address);
 
+// Returns a number that changes whenever a module is loaded or unloaded, or
+// 0 if the system doesn't keep track of that.
+unsigned long GetModuleGeneration();
+
+// Copies memory that may not be (entirely) readable without faulting, e.g.
+// a stack of unknown size. Stops at the first unreadable byte and returns
+// the number of bytes copied. Doesn't allocate memory.
+std::size_t ReadMemory(void *dest, const void *src, std::size_t size);
+
+// Finds the committed part of the stack that contains sp, from sp to the
+// top (stacks grow down). Returns false if sp isn't on a known stack. Only
+// the calling thread's stack is known on some systems. Doesn't allocate
+// memory once SetUpCrashStack() has been called by the thread.
+bool GetStackBounds(const void *sp, uint32_t &low, uint32_t &high);
+
 void SetCrashHandler(CrashHandler handler);
+
+// Makes sure the crash handler can run on the calling thread even if the
+// crash was caused by running out of stack, e.g. by infinite recursion.
+// Should be called once by each thread that may run AMX code.
+void SetUpCrashStack();
 void SetInterruptHandler(InterruptHandler handler);
 
+// Remembers the calling thread as the server thread for
+// InspectMainThread().
+void SetMainThread();
+
+// Stops the server thread wherever it is and calls handler with its
+// context, on that thread in a signal handler (Linux) or on the calling
+// thread while it's suspended (Windows). Either way the handler must not
+// allocate memory or take locks that the server thread may be holding.
+// Waits for the handler to return. Returns false if the thread couldn't be
+// stopped, in which case the handler isn't called.
+bool InspectMainThread(InspectHandler handler, void *data);
+
+// Lets the calling thread run only on the given CPUs, numbered from 0.
+// Returns false if the system refuses.
+bool SetThreadAffinity(const std::vector<int> &cpus);
+
+// Sets the niceness of the calling thread, from -20 (highest priority) to
+// 19 (lowest) as with nice(1). Windows only has a few priority levels, so
+// the closest one is used there. Returns false if the system refuses.
+bool SetThreadNiceness(int niceness);
+
+// Hardware watchpoints (the x86 debug registers DR0-DR3), which make the
+// CPU trap right after an instruction writes to the watched memory. They
+// apply to the thread that sets them. The handler is called on that thread
+// with the context after the write, in a signal handler (Linux) or an
+// exception handler (Windows).
+const int kNumWatchpoints = 4;
+
+void SetWatchHandler(WatchHandler handler);
+
+// Watches size bytes at address, where size is 1, 2 or 4 and address is
+// aligned to it, replacing whatever the slot watched before. Returns false
+// if the system doesn't let us (e.g. Linux with perf events disabled).
+bool SetWatchpoint(int slot, const void *address, std::size_t size);
+void ClearWatchpoint(int slot);
+
 } // namespace os
 
 #endif // !OS_H
@@ -0,0 +1,87 @@
+// Copyright (c) 2026 Zeex
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <cstdint>
+#include <cstdio>
+#ifdef _WIN32
+  #include <windows.h>
+#else
+  #include <unistd.h>
+#endif
+#include "perfmap.h"
+
+namespace {
+
+unsigned long GetProcessId() {
+  #ifdef _WIN32
+    return GetCurrentProcessId();
+  #else
+    return static_cast<unsigned long>(getpid());
+  #endif
+}
+
+} // anonymous namespace
+
+PerfMap::PerfMap()
+  : file_(nullptr),
+    opened_(false)
+{
+}
+
+PerfMap::~PerfMap() {
+  if (file_ != nullptr) {
+    std::fclose(file_);
+  }
+}
+
+void PerfMap::AddSymbol(const void *start,
+                        std::size_t size,
+                        const std::string &name) {
+  if (size == 0) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!opened_) {
+    opened_ = true;
+    char filename[64];
+    std::snprintf(filename, sizeof(filename), "/tmp/perf-%lu.map",
+                  GetProcessId());
+    file_ = std::fopen(filename, "w");
+  }
+  if (file_ == nullptr) {
+    return;
+  }
+  std::fprintf(file_, "%lx %lx %s\n",
+               static_cast<unsigned long>(reinterpret_cast<uintptr_t>(start)),
+               static_cast<unsigned long>(size),
+               name.c_str());
+  // perf may read the file while the server is still running.
+  std::fflush(file_);
+}
+
+// static
+PerfMap &PerfMap::shared() {
+  static PerfMap perf_map;
+  return perf_map;
+}
@@ -0,0 +1,57 @@
+// Copyright (c) 2026 Zeex
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef PERFMAP_H
+#define PERFMAP_H
+
+#include <cstddef>
+#include <cstdio>
+#include <mutex>
+#include <string>
+
+// Writes /tmp/perf-<pid>.map, which Linux perf reads to name addresses that
+// don't belong to any module, such as the code generated by the JIT. Each
+// line gives the start (in hex), size (in hex) and name of a symbol. The
+// file is truncated when the first symbol is added, since a previous
+// process could have had the same PID.
+class PerfMap {
+ public:
+  void AddSymbol(const void *start, std::size_t size, const std::string &name);
+
+  static PerfMap &shared();
+
+ private:
+  PerfMap();
+  ~PerfMap();
+
+  PerfMap(const PerfMap &) = delete;
+  PerfMap &operator=(const PerfMap &) = delete;
+
+ private:
+  std::mutex mutex_;
+  std::FILE *file_;
+  bool opened_;
+};
+
+#endif // !PERFMAP_H
@@ -22,7 +22,10 @@
 // ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
 // POSSIBILITY OF SUCH DAMAGE.
 
+#include <chrono>
 #include <functional>
+#include <memory>
+#include <mutex>
 #include <string>
 #ifdef _WIN32
   #include <windows.h>
@@ -33,6 +36,7 @@
 #include "amxpathfinder.h"
 #include "crashdetect.h"
 #include "fileutils.h"
+#include "filewatcher.h"
 #include "logprintf.h"
 #include "natives.h"
 #include "options.h"
@@ -40,6 +44,7 @@
 #include "plugincommon.h"
 #include "pluginversion.h"
 #include "stringutils.h"
+#include "tracebuffer.h"
 
 namespace {
 
@@ -47,7 +52,45 @@ std::vector<std::function<void()>> unload_callbacks;
 
 subhook::Hook exec_hook;
 subhook::Hook open_file_hook;
-std::string last_opened_amx_file_name;
+
+// Set while this thread is in the open file hook. Files opened from inside
+// it, e.g. when reading the header of a script, are not looked at.
+thread_local bool in_open_file_hook = false;
+
+// Only needed if subhook couldn't make a trampoline, so that threads don't
+// remove and install the hook at the same time. It's recursive because the
+// hook may be entered again while it's held (see above).
+std::recursive_mutex open_file_hook_mutex;
+
+class OpenFileHookScope {
+ public:
+  OpenFileHookScope() : nested_(in_open_file_hook) {
+    in_open_file_hook = true;
+  }
+  ~OpenFileHookScope() {
+    in_open_file_hook = nested_;
+  }
+
+  OpenFileHookScope(const OpenFileHookScope &) = delete;
+  OpenFileHookScope &operator=(const OpenFileHookScope &) = delete;
+
+  bool nested() const { return nested_; }
+
+ private:
+  bool nested_;
+};
+
+void OnOpenFile(const OpenFileHookScope &scope,
+                const char *filename,
+                bool read) {
+  if (!read || scope.nested()) {
+    return;
+  }
+  const char *ext = fileutils::GetFileExtensionPtr(filename);
+  if (ext != nullptr && stringutils::CompareIgnoreCase(ext, "amx") == 0) {
+    AMXPathFinder::shared().AddOpenedFile(filename);
+  }
+}
 
 #ifdef _WIN32
   HANDLE WINAPI CreateFileAHook(
@@ -59,11 +102,29 @@ std::string last_opened_amx_file_name;
     DWORD dwFlagsAndAttributes,
     HANDLE hTemplateFile)
   {
-    subhook::ScopedHookRemove _(&open_file_hook);
-    const char *ext = fileutils::GetFileExtensionPtr(lpFileName);
-    if (ext != nullptr && stringutils::CompareIgnoreCase(ext, "amx") == 0) {
-      last_opened_amx_file_name = lpFileName;
+    OpenFileHookScope scope;
+    OnOpenFile(scope, lpFileName, dwCreationDisposition == OPEN_EXISTING);
+
+    // Call the original function through the trampoline so that the hook
+    // doesn't have to be removed and installed again on every call. This
+    // falls back to doing that if subhook couldn't make a trampoline, one
+    // thread at a time.
+    typedef HANDLE (WINAPI *CreateFileAType)(
+      LPCSTR, DWORD, DWORD, LPSECURITY_ATTRIBUTES, DWORD, DWORD, HANDLE);
+    CreateFileAType trampoline =
+      reinterpret_cast<CreateFileAType>(open_file_hook.GetTrampoline());
+    if (trampoline != nullptr) {
+      return trampoline(
+        lpFileName,
+        dwDesiredAccess,
+        dwShareMode,
+        lpSecurityAttributes,
+        dwCreationDisposition,
+        dwFlagsAndAttributes,
+        hTemplateFile);
     }
+    std::lock_guard<std::recursive_mutex> lock(open_file_hook_mutex);
+    subhook::ScopedHookRemove _(&open_file_hook);
     return CreateFileA(
       lpFileName,
       dwDesiredAccess,
@@ -75,29 +136,32 @@ std::string last_opened_amx_file_name;
   }
 #else
   FILE *FopenHook(const char *filename, const char *mode) {
-    subhook::ScopedHookRemove _(&open_file_hook);
-    const char *ext = fileutils::GetFileExtensionPtr(filename);
-    if (ext != nullptr && stringutils::CompareIgnoreCase(ext, "amx") == 0) {
-      last_opened_amx_file_name = filename;
+    OpenFileHookScope scope;
+    OnOpenFile(scope, filename, mode[0] == 'r');
+
+    // See the comment in CreateFileAHook.
+    typedef FILE *(*FopenType)(const char *, const char *);
+    FopenType trampoline =
+      reinterpret_cast<FopenType>(open_file_hook.GetTrampoline());
+    if (trampoline != nullptr) {
+      return trampoline(filename, mode);
     }
+    std::lock_guard<std::recursive_mutex> lock(open_file_hook_mutex);
+    subhook::ScopedHookRemove _(&open_file_hook);
     return fopen(filename, mode);
   }
 #endif
 
-int AMXAPI OnDebugHook(AMX *amx) {
-  return CrashDetect::GetHandler(amx)->OnDebugHook();
-}
-
-int AMXAPI OnCallback(AMX *amx, cell index, cell *result, cell *params) {
-  CrashDetect *handler = CrashDetect::GetHandler(amx);
-  return handler->OnCallback(index, result, params);
-}
-
 int AMXAPI OnExec(AMX *amx, cell *retval, int index) {
   if (amx->flags & AMX_FLAG_BROWSE) {
+    // The server is relocating the script, this decides which opcode
+    // addresses (and hence which version of amx_Exec) it will use.
+    amx->flags |= CrashDetect::GetExecFlags();
     return amx_Exec(amx, retval, index);
   }
-  CrashDetect *handler = CrashDetect::GetHandler(amx);
+  // Scripts can be unloaded on another thread while this one is running
+  // them, so hold on to the handler until the call returns.
+  std::shared_ptr<CrashDetect> handler = CrashDetect::PinHandler(amx);
   if (handler == nullptr) {
     return amx_Exec(amx, retval, index);
   }
@@ -119,16 +183,26 @@ int AMXAPI OnAddressNaughtRequest(AMX *amx, int option) {
   return handler->OnAddressNaughtRequest(option);
 }
 
+int AMXAPI OnFunctionRequest(AMX *amx, int event) {
+  CrashDetect *handler = CrashDetect::GetHandler(amx);
+  return handler->OnFunctionRequest(event);
+}
+
 } // anonymous namespace
 
 PLUGIN_EXPORT unsigned int PLUGIN_CALL Supports() {
-  return SUPPORTS_VERSION | SUPPORTS_AMX_NATIVES;
+  return SUPPORTS_VERSION | SUPPORTS_AMX_NATIVES | SUPPORTS_PROCESS_TICK;
 }
 
 PLUGIN_EXPORT bool PLUGIN_CALL Load(void **ppData) {
+  std::chrono::steady_clock::time_point start =
+    std::chrono::steady_clock::now();
   void **exports = reinterpret_cast<void**>(ppData[PLUGIN_DATA_AMX_EXPORTS]);
   ::logprintf = (logprintf_t)ppData[PLUGIN_DATA_LOGPRINTF];
 
+  CrashDetect::SetVMCallback(
+    reinterpret_cast<AMX_CALLBACK>(exports[PLUGIN_AMX_EXPORT_Callback]));
+
   void *amx_Exec_ptr = exports[PLUGIN_AMX_EXPORT_Exec];
   void *amx_Exec_sub = subhook::ReadHookDst(amx_Exec_ptr);
 
@@ -166,10 +240,21 @@ PLUGIN_EXPORT bool PLUGIN_CALL Load(void **ppData) {
       std::bind1st(std::mem_fun(&AMXPathFinder::AddSearchPath),
                    &AMXPathFinder::shared()));
   }
+  if (Options::shared().watch_files()) {
+    AMXPathFinder::shared().WatchSearchPaths();
+    unload_callbacks.push_back([]() {
+      FileWatcher::shared().Stop();
+    });
+  }
+  AMXPathFinder::shared().StartScan();
 
   os::SetCrashHandler(CrashDetect::OnCrash);
   os::SetInterruptHandler(CrashDetect::OnInterrupt);
+  os::SetWatchHandler(CrashDetect::OnWatch);
   CrashDetect::PluginLoad();
+  CrashDetect::SetPluginLoadTime(
+    std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now() - start).count());
 
   logprintf("  CrashDetect plugin " PLUGIN_VERSION_STRING);
   return true;
@@ -184,29 +269,40 @@ PLUGIN_EXPORT void PLUGIN_CALL Unload() {
 }
 
 PLUGIN_EXPORT int PLUGIN_CALL AmxLoad(AMX *amx) {
-  if (!last_opened_amx_file_name.empty()) {
-    AMXPathFinder::shared().AddKnownFile(amx, last_opened_amx_file_name);
-  }
+  // The trace buffer thread looks up handlers while formatting records, so
+  // make sure it's idle while the handler list is modified.
+  TraceBuffer::shared().Flush();
 
   CrashDetect *handler = CrashDetect::CreateHandler(amx);
   handler->Load();
-
-  amx_SetDebugHook(amx, OnDebugHook);
-  amx_SetCallback(amx, OnCallback);
+  handler->InstallHooks();
 
   static AMX_EXT_HOOKS ext_hooks = {
     OnExecError,
     OnLongCallRequest,
-    OnAddressNaughtRequest
+    OnAddressNaughtRequest,
+    OnFunctionRequest
   };
   amx_SetExtHooks(amx, &ext_hooks);
 
+  std::chrono::steady_clock::time_point start =
+    std::chrono::steady_clock::now();
   RegisterNatives(amx);
+  handler->AddLoadTime(
+    CrashDetect::LOAD_NATIVES,
+    std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now() - start).count());
+  handler->PrintLoadTimes();
   return AMX_ERR_NONE;
 }
 
+PLUGIN_EXPORT void PLUGIN_CALL ProcessTick() {
+  CrashDetect::OnProcessTick();
+}
+
 PLUGIN_EXPORT int PLUGIN_CALL AmxUnload(AMX *amx) {
   CrashDetect::GetHandler(amx)->Unload();
   CrashDetect::DestroyHandler(amx);
+  AMXPathFinder::shared().Forget(amx);
   return AMX_ERR_NONE;
 }
@@ -0,0 +1,255 @@
+// Copyright (c) 2026 Zeex
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <algorithm>
+#include <fstream>
+#include "log.h"
+#include "profiler.h"
+#include "threadpolicy.h"
+
+namespace {
+
+// Must be a power of two.
+const std::size_t kRingSize = 1024;
+
+// The profile file is rewritten this often, so that it can be looked at
+// while the server is running.
+const std::chrono::seconds kWriteInterval(60);
+
+const std::size_t kSummaryTopN = 20;
+
+} // anonymous namespace
+
+const int ProfileSample::kMaxDepth;
+const int ProfileSample::kMaxNativeDepth;
+
+Profiler::Profiler()
+  : resolver_(nullptr),
+    interval_(0),
+    running_(false),
+    stop_thread_(false),
+    sample_pending_(false),
+    dump_pending_(false),
+    samples_(kRingSize),
+    head_(0),
+    tail_(0),
+    num_dropped_(0),
+    num_ticks_(0),
+    num_samples_(0)
+{
+}
+
+Profiler::~Profiler() {
+  Stop();
+}
+
+void Profiler::Start(Resolver resolver,
+                     std::chrono::microseconds interval,
+                     const std::string &filename) {
+  if (running_) {
+    return;
+  }
+  resolver_ = resolver;
+  interval_ = std::max(interval, std::chrono::microseconds(1));
+  filename_ = filename;
+  // Each run starts a new profile.
+  num_dropped_ = 0;
+  num_ticks_ = 0;
+  num_samples_ = 0;
+  stacks_.clear();
+  functions_.clear();
+  dump_pending_ = false;
+  stop_thread_ = false;
+  thread_ = std::thread(&Profiler::Run, this);
+  running_ = true;
+}
+
+void Profiler::Stop() {
+  if (!running_) {
+    return;
+  }
+  running_ = false;
+  sample_pending_ = false;
+  stop_thread_ = true;
+  thread_.join();
+  ProcessSamples();
+  Write();
+  PrintSummary();
+}
+
+void Profiler::Dump() {
+  if (running_) {
+    dump_pending_ = true;
+  }
+}
+
+void Profiler::Push(const ProfileSample &sample) {
+  sample_pending_.store(false, std::memory_order_relaxed);
+  std::size_t head = head_.load(std::memory_order_relaxed);
+  if (head - tail_.load(std::memory_order_acquire) >= samples_.size()) {
+    // Don't make the server wait for the profiler.
+    num_dropped_.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+  samples_[head & (samples_.size() - 1)] = sample;
+  head_.store(head + 1, std::memory_order_release);
+}
+
+void Profiler::Flush() {
+  if (!running_) {
+    return;
+  }
+  std::size_t head = head_.load(std::memory_order_acquire);
+  while (static_cast<std::ptrdiff_t>(
+           head - tail_.load(std::memory_order_acquire)) > 0) {
+    std::this_thread::yield();
+  }
+}
+
+bool Profiler::ProcessSamples() {
+  bool processed = false;
+  std::size_t tail = tail_.load(std::memory_order_relaxed);
+  while (tail != head_.load(std::memory_order_acquire)) {
+    AddSample(samples_[tail & (samples_.size() - 1)]);
+    // Like in TraceBuffer, the tail is only advanced after the sample has
+    // been resolved, Flush() relies on this.
+    tail_.store(++tail, std::memory_order_release);
+    processed = true;
+  }
+  return processed;
+}
+
+void Profiler::AddSample(const ProfileSample &sample) {
+  frames_.clear();
+  resolver_(sample, frames_);
+  if (frames_.empty()) {
+    return;
+  }
+  num_samples_++;
+
+  std::string stack;
+  for (std::size_t i = 0; i < frames_.size(); i++) {
+    if (i > 0) {
+      stack += ';';
+    }
+    stack += frames_[i];
+    // Recursive functions are only counted once per sample.
+    if (std::find(frames_.begin(), frames_.begin() + i, frames_[i])
+        == frames_.begin() + i) {
+      functions_[frames_[i]].total++;
+    }
+  }
+  functions_[frames_.back()].self++;
+  stacks_[stack]++;
+}
+
+// Folded stacks, one per line, as expected by flamegraph.pl and most other
+// flame graph tools.
+void Profiler::Write() const {
+  std::ofstream file(filename_.c_str(), std::ios::out | std::ios::trunc);
+  if (!file) {
+    LogDebugPrint("Could not open profile file '%s'", filename_.c_str());
+    return;
+  }
+  for (std::unordered_map<std::string, uint64_t>::const_iterator it =
+         stacks_.begin();
+       it != stacks_.end(); it++) {
+    file << it->first << ' ' << it->second << '\n';
+  }
+}
+
+void Profiler::PrintSummary() const {
+  std::vector<std::pair<std::string, FunctionCounts>> functions(
+    functions_.begin(), functions_.end());
+  std::size_t num_shown = std::min(functions.size(), kSummaryTopN);
+  std::partial_sort(functions.begin(),
+                    functions.begin() + num_shown,
+                    functions.end(),
+                    [](const std::pair<std::string, FunctionCounts> &a,
+                       const std::pair<std::string, FunctionCounts> &b) {
+                      return a.second.self > b.second.self;
+                    });
+
+  // Ticks without a sample are those where no script code was running
+  // (samples aren't taken inside natives called with SYSREQ.D).
+  LogDebugPrint("Profile: %llu samples in %llu ticks (%llu dropped), "
+                "written to '%s'",
+                static_cast<unsigned long long>(num_samples_),
+                static_cast<unsigned long long>(num_ticks_),
+                static_cast<unsigned long long>(num_dropped_.load()),
+                filename_.c_str());
+  if (num_samples_ == 0) {
+    return;
+  }
+  LogDebugPrint("%10s %6s %10s %6s  %s",
+                "self", "", "total", "", "function");
+  for (std::size_t i = 0; i < num_shown; i++) {
+    const FunctionCounts &counts = functions[i].second;
+    LogDebugPrint("%10llu %5.1f%% %10llu %5.1f%%  %s",
+                  static_cast<unsigned long long>(counts.self),
+                  100.0 * counts.self / num_samples_,
+                  static_cast<unsigned long long>(counts.total),
+                  100.0 * counts.total / num_samples_,
+                  functions[i].first.c_str());
+  }
+}
+
+void Profiler::Run() {
+  ApplyThreadPolicy(THREAD_CLASS_PROFILER);
+  std::chrono::steady_clock::time_point next_tick =
+    std::chrono::steady_clock::now();
+  std::chrono::steady_clock::time_point next_write =
+    next_tick + kWriteInterval;
+  while (!stop_thread_) {
+    ProcessSamples();
+    std::chrono::steady_clock::time_point now =
+      std::chrono::steady_clock::now();
+    if (dump_pending_.exchange(false)) {
+      Write();
+      PrintSummary();
+      next_write = now + kWriteInterval;
+    } else if (now >= next_write) {
+      Write();
+      next_write = now + kWriteInterval;
+    }
+    if (now < next_tick) {
+      std::this_thread::sleep_until(next_tick);
+      continue;
+    }
+    // If the previous request hasn't been taken yet there's nothing to do,
+    // the sample will be taken when the VM gets to it.
+    num_ticks_++;
+    sample_pending_.store(true, std::memory_order_relaxed);
+    next_tick += interval_;
+    if (next_tick < now) {
+      next_tick = now + interval_;
+    }
+  }
+}
+
+// static
+Profiler &Profiler::shared() {
+  static Profiler instance;
+  return instance;
+}
@@ -0,0 +1,130 @@
+// Copyright (c) 2026 Zeex
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <amx/amx.h>
+
+// A snapshot of the script call stack taken on the server thread.
+struct ProfileSample {
+  static const int kMaxDepth = 32;
+  static const int kMaxNativeDepth = 16;
+
+  AMX *amx;
+  cell native_index;  // native that was being called, or -1
+  int depth;
+  cell functions[kMaxDepth];  // starting addresses, innermost first
+  int native_depth;
+  void *native_frames[kMaxNativeDepth];  // return addresses, innermost first
+};
+
+// A sampling profiler. A thread of its own asks for a sample every interval
+// and the VM takes it at the next point where its state is consistent (see
+// IsSamplePending()). Samples go through a lock-free ring back to the
+// profiler thread, which turns them into stacks of function names using the
+// resolver and counts how many times each stack was seen.
+class Profiler {
+ public:
+  // Called on the profiler thread. Fills frames with the names of the
+  // functions in the sample, outermost first.
+  typedef void (*Resolver)(const ProfileSample &sample,
+                           std::vector<std::string> &frames);
+
+  void Start(Resolver resolver,
+             std::chrono::microseconds interval,
+             const std::string &filename);
+  // Writes the profile and prints a summary to the log.
+  void Stop();
+  // Does the same without stopping. This happens on the profiler thread
+  // shortly after the call, with the samples pushed up to that point.
+  void Dump();
+
+  bool IsRunning() const { return running_; }
+
+  // Checked by the VM thread every now and then, so it must be cheap.
+  bool IsSamplePending() const {
+    return sample_pending_.load(std::memory_order_relaxed);
+  }
+
+  // Only one thread (the server thread) may push samples.
+  void Push(const ProfileSample &sample);
+
+  // Waits until all samples pushed so far have been resolved.
+  void Flush();
+
+  static Profiler &shared();
+
+ private:
+  Profiler();
+  ~Profiler();
+
+  Profiler(const Profiler &) = delete;
+  Profiler &operator=(const Profiler &) = delete;
+
+  // Self and total sample counts of a function.
+  struct FunctionCounts {
+    FunctionCounts(): self(0), total(0) {}
+    uint64_t self;
+    uint64_t total;
+  };
+
+  bool ProcessSamples();
+  void AddSample(const ProfileSample &sample);
+  void Write() const;
+  void PrintSummary() const;
+  void Run();
+
+ private:
+  Resolver resolver_;
+  std::chrono::microseconds interval_;
+  std::string filename_;
+  std::atomic<bool> running_;
+  std::atomic<bool> stop_thread_;
+  std::atomic<bool> sample_pending_;
+  std::atomic<bool> dump_pending_;
+  std::thread thread_;
+
+  // Single-producer single-consumer ring.
+  std::vector<ProfileSample> samples_;
+  std::atomic<std::size_t> head_;
+  std::atomic<std::size_t> tail_;
+  std::atomic<uint64_t> num_dropped_;
+
+  // Only touched by the profiler thread while it is running.
+  uint64_t num_ticks_;
+  uint64_t num_samples_;
+  std::unordered_map<std::string, uint64_t> stacks_;
+  std::unordered_map<std::string, FunctionCounts> functions_;
+  std::vector<std::string> frames_;
+};
+
+#endif // !PROFILER_H
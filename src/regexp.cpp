@@ -25,36 +25,86 @@
 #include <cstring>
 #include "regexp.h"
 
-RegExp::RegExp(const std::string &pattern)
-  : re_(nullptr)
-{
-  int errornumber;
-  PCRE2_SIZE erroroffset = 0;
-  re_ = pcre2_compile(reinterpret_cast<PCRE2_SPTR8>(pattern.c_str()),
-                      PCRE2_ZERO_TERMINATED,
-                      0,
-                      &errornumber,
-                      &erroroffset,
-                      nullptr);
+namespace {
+
+// Match data is reused between calls to avoid allocating it every time.
+// Test() doesn't need the matched substrings, so the smallest possible
+// ovector is enough.
+class MatchData {
+ public:
+  MatchData() : match_data_(pcre2_match_data_create(1, nullptr)) {}
+  MatchData(const MatchData &) = delete;
+  MatchData &operator=(const MatchData &) = delete;
+  ~MatchData() { pcre2_match_data_free(match_data_); }
+
+  pcre2_match_data *get() const { return match_data_; }
+
+ private:
+  pcre2_match_data *match_data_;
+};
+
+thread_local MatchData match_data;
+
+} // anonymous namespace
+
+RegExp::RegExp(const std::string &pattern) {
+  Compile(pattern);
+}
+
+RegExp::RegExp(const std::vector<std::string> &patterns) {
+  for (std::size_t i = 0; i < patterns.size(); i++) {
+    Compile(patterns[i]);
+  }
 }
 
 RegExp::~RegExp() {
-  pcre2_code_free(re_);
+  for (std::size_t i = 0; i < codes_.size(); i++) {
+    pcre2_code_free(codes_[i].re);
+  }
 }
 
-bool RegExp::Test(const std::string &string) const {
-  if (re_ == nullptr) {
-    return false;
+void RegExp::Compile(const std::string &pattern) {
+  int errornumber;
+  PCRE2_SIZE erroroffset = 0;
+  Code code;
+  code.re = pcre2_compile(reinterpret_cast<PCRE2_SPTR8>(pattern.c_str()),
+                          PCRE2_ZERO_TERMINATED,
+                          0,
+                          &errornumber,
+                          &erroroffset,
+                          nullptr);
+  if (code.re != nullptr) {
+    // Fails harmlessly if PCRE was built without JIT support.
+    code.jit = pcre2_jit_compile(code.re, PCRE2_JIT_COMPLETE) == 0;
+    codes_.push_back(code);
   }
-  pcre2_match_data *match_data =
-      pcre2_match_data_create_from_pattern(re_, NULL);
-  int result = pcre2_match(re_,
-                           reinterpret_cast<PCRE2_SPTR8>(string.c_str()),
+}
+
+bool RegExp::Test(const std::string &string) const {
+  PCRE2_SPTR8 subject = reinterpret_cast<PCRE2_SPTR8>(string.c_str());
+  for (std::size_t i = 0; i < codes_.size(); i++) {
+    int result;
+    if (codes_[i].jit) {
+      result = pcre2_jit_match(codes_[i].re,
+                               subject,
+                               string.length(),
+                               0,
+                               0,
+                               match_data.get(),
+                               nullptr);
+    } else {
+      result = pcre2_match(codes_[i].re,
+                           subject,
                            string.length(),
                            0,
                            0,
-                           match_data,
+                           match_data.get(),
                            nullptr);
-  pcre2_match_data_free(match_data);
-  return result >= 0;
+    }
+    // 0 means the match succeeded but the ovector was too small.
+    if (result >= 0) {
+      return true;
+    }
+  }
+  return false;
 }
@@ -28,11 +28,14 @@
 #define PCRE2_CODE_UNIT_WIDTH 8
 
 #include <string>
+#include <vector>
 #include <pcre2.h>
 
 class RegExp {
  public:
   RegExp(const std::string &pattern);
+  // Matches a string if any of the patterns does.
+  RegExp(const std::vector<std::string> &patterns);
   RegExp(const RegExp &) = delete;
   RegExp &operator=(const RegExp &) = delete;
   ~RegExp();
@@ -40,7 +43,14 @@ class RegExp {
   bool Test(const std::string &string) const;
 
  private:
-  pcre2_code *re_;
+  void Compile(const std::string &pattern);
+
+ private:
+  struct Code {
+    pcre2_code *re;
+    bool jit;
+  };
+  std::vector<Code> codes_;
 };
 
 #endif // !REGEXP_H
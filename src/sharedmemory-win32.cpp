@@ -0,0 +1,76 @@
+// Copyright (c) 2026 Zeex
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <windows.h>
+#include "sharedmemory.h"
+
+SharedMemory::SharedMemory()
+  : data_(nullptr),
+    size_(0),
+    handle_(0)
+{
+}
+
+SharedMemory::~SharedMemory() {
+  Close();
+}
+
+bool SharedMemory::Create(const std::string &name, std::size_t size) {
+  Close();
+
+  // The mapping goes away with the last handle to it, so there is nothing
+  // left behind to replace.
+  std::string mapping_name = "Local\\" + name;
+  HANDLE mapping = CreateFileMappingA(INVALID_HANDLE_VALUE,
+                                      nullptr,
+                                      PAGE_READWRITE,
+                                      0,
+                                      static_cast<DWORD>(size),
+                                      mapping_name.c_str());
+  if (mapping == nullptr) {
+    return false;
+  }
+  void *data = MapViewOfFile(mapping, FILE_MAP_WRITE, 0, 0, size);
+  if (data == nullptr) {
+    CloseHandle(mapping);
+    return false;
+  }
+
+  name_ = mapping_name;
+  data_ = data;
+  size_ = size;
+  handle_ = reinterpret_cast<std::intptr_t>(mapping);
+  return true;
+}
+
+void SharedMemory::Close() {
+  if (data_ == nullptr) {
+    return;
+  }
+  UnmapViewOfFile(data_);
+  CloseHandle(reinterpret_cast<HANDLE>(handle_));
+  data_ = nullptr;
+  size_ = 0;
+  handle_ = 0;
+}
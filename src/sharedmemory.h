@@ -0,0 +1,62 @@
+// Copyright (c) 2026 Zeex
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef SHAREDMEMORY_H
+#define SHAREDMEMORY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// A named block of memory that other processes can map to read it, e.g.
+// tools that show statistics live. It's /dev/shm/<name> on Linux and a
+// named file mapping ("Local\<name>") on Windows.
+class SharedMemory {
+ public:
+  SharedMemory();
+  ~SharedMemory();
+
+  SharedMemory(const SharedMemory &) = delete;
+  SharedMemory &operator=(const SharedMemory &) = delete;
+
+  // Creates the block (replacing one left behind by a process that had the
+  // same name) and maps it. The memory is zero-filled.
+  bool Create(const std::string &name, std::size_t size);
+  // Unmaps and removes it.
+  void Close();
+
+  bool IsOpen() const { return data_ != nullptr; }
+
+  void *data() const { return data_; }
+  std::size_t size() const { return size_; }
+
+ private:
+  std::string name_;
+  void *data_;
+  std::size_t size_;
+  // HANDLE on Windows, a file descriptor everywhere else.
+  std::intptr_t handle_;
+};
+
+#endif // !SHAREDMEMORY_H
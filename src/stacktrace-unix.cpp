@@ -22,37 +22,88 @@
 // ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
 // POSSIBILITY OF SUCH DAMAGE.
 
+#include <cstdint>
 #include <string>
+#include <dlfcn.h>
 #include <execinfo.h>
 
+#include "os.h"
 #include "stacktrace.h"
 
-static const int kMaxFrames = 100;
+namespace {
 
-static std::string GetSymbolName(const std::string &symbol) {
-  std::string name;
+// If following frame pointers gives fewer frames than this, the code
+// probably doesn't use them.
+const int kMinWalkedFrames = 3;
 
-  if (!symbol.empty()) {
-    std::string::size_type lp = symbol.find('(');
-    std::string::size_type rp = symbol.find_first_of(")+-", lp);
+// The first call to backtrace() loads libgcc_s, which allocates memory.
+// Get that done while the plugin is being loaded rather than in a signal
+// handler.
+struct BacktraceInit {
+  BacktraceInit() {
+    void *frame;
+    backtrace(&frame, 1);
+  }
+} backtrace_init;
 
-    if (lp != std::string::npos && rp != std::string::npos) {
-      name = symbol.substr(lp + 1, rp - lp - 1);
-    }
+} // anonymous namespace
+
+void InitSymbols() {
+  // dladdr() doesn't need anything to be loaded in advance.
+}
+
+int CaptureStackTrace(void **frames, int max_frames, void *context) {
+  int num_frames;
+  if (context != nullptr) {
+    os::Context::Registers registers = os::Context(context).GetRegisters();
+    num_frames = WalkFramePointers(
+      frames,
+      max_frames,
+      reinterpret_cast<void *>(static_cast<uintptr_t>(registers.eip)),
+      reinterpret_cast<void *>(static_cast<uintptr_t>(registers.ebp)));
+  } else {
+    num_frames = WalkFramePointers(frames,
+                                   max_frames,
+                                   nullptr,
+                                   __builtin_frame_address(0));
+  }
+  if (num_frames >= kMinWalkedFrames) {
+    return num_frames;
   }
+  // Code compiled without frame pointers ends the walk right away, the
+  // unwind tables may still get further. backtrace() can tell a signal
+  // frame from a normal one, so it works the same with or without a
+  // context.
+  return backtrace(frames, max_frames);
+}
 
-  return name;
+int CaptureFastStackTrace(void **frames, int max_frames) {
+  return WalkFramePointers(frames,
+                           max_frames,
+                           nullptr,
+                           __builtin_frame_address(0));
 }
 
-void GetStackTrace(std::vector<StackFrame> &frames, void *context) {
-  void *trace[kMaxFrames];
+const char *FindSymbolName(void *address) {
+  Dl_info info;
+  if (dladdr(address, &info) != 0) {
+    return info.dli_sname;
+  }
+  return nullptr;
+}
 
-  int length = backtrace(trace, kMaxFrames);
-  char **symbols = backtrace_symbols(trace, length);
+void GetStackTrace(std::vector<StackFrame> &frames, void *context) {
+  void *trace[kMaxStackFrames];
+  int length = CaptureStackTrace(trace, kMaxStackFrames, context);
+  ResolveStackTrace(frames, trace, length);
+}
 
+void ResolveStackTrace(std::vector<StackFrame> &frames,
+                       void *const *trace,
+                       int length) {
   for (int i = 0; i < length; i++) {
-    if (symbols[i] != 0) {
-      std::string name = GetSymbolName(symbols[i]);
+    const char *name = FindSymbolName(trace[i]);
+    if (name != nullptr) {
       frames.push_back(StackFrame(trace[i], name));
     } else {
       frames.push_back(StackFrame(trace[i]));
@@ -22,11 +22,20 @@
 // ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
 // POSSIBILITY OF SUCH DAMAGE.
 
+#include <atomic>
 #include <cstddef>
+#include <cstdint>
 #include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
 #include <windows.h>
 #include <dbghelp.h>
+#include "moduletable.h"
 #include "stacktrace.h"
+#include "workqueue.h"
 
 namespace {
 
@@ -47,6 +56,11 @@ class DbgHelp {
       if (SymInitialize != nullptr) {
         initialized_ = SymInitialize(process_, nullptr, TRUE) != FALSE;
       }
+      if (SymGetOptions != nullptr && SymSetOptions != nullptr) {
+        DWORD options = SymGetOptions();
+        options |= SYMOPT_FAIL_CRITICAL_ERRORS;
+        SymSetOptions(options);
+      }
     }
   }
 
@@ -93,18 +107,9 @@ class DbgHelp {
   );
   SymGetModuleInfo64Ptr SymGetModuleInfo64;
 
-  typedef BOOL (WINAPI *StackWalk64Ptr)(
-    DWORD MachineType,
-    HANDLE hProcess,
-    HANDLE hThread,
-    LPSTACKFRAME64 StackFrame,
-    LPVOID ContextRecord,
-    PREAD_PROCESS_MEMORY_ROUTINE64 ReadMemoryRoutine,
-    PFUNCTION_TABLE_ACCESS_ROUTINE64 FunctionTableAccessRoutine,
-    PGET_MODULE_BASE_ROUTINE64 GetModuleBaseRoutine,
-    PTRANSLATE_ADDRESS_ROUTINE64 TranslateAddress
-  );
-  StackWalk64Ptr StackWalk64;
+  // Not available in old versions of DbgHelp.
+  typedef BOOL (WINAPI *SymRefreshModuleListPtr)(HANDLE hProcess);
+  SymRefreshModuleListPtr SymRefreshModuleList;
 
   bool is_loaded() const {
     return module_ != nullptr;
@@ -122,7 +127,7 @@ class DbgHelp {
     INIT_FUNC(SymGetOptions);
     INIT_FUNC(SymSetOptions);
     INIT_FUNC(SymGetModuleInfo64);
-    INIT_FUNC(StackWalk64);
+    INIT_FUNC(SymRefreshModuleList);
     #undef INIT_FUNC
   }
 
@@ -132,104 +137,163 @@ class DbgHelp {
   bool initialized_;
 };
 
-} // anonymous namespace
-
-void GetStackTrace(std::vector<StackFrame> &frames, void *context_ptr) {
-  CONTEXT context = {0};
-  if (context_ptr != nullptr) {
-    context = *reinterpret_cast<PCONTEXT>(context_ptr);
-  } else {
-    RtlCaptureContext(&context);
+// Keeps DbgHelp initialized for the lifetime of the plugin, since loading
+// the symbols of every module takes a while and is better not done in the
+// middle of a crash. Names that were looked up once are remembered.
+class SymbolResolver {
+ public:
+  SymbolResolver() : num_modules_(0), ready_(false) {}
+
+  SymbolResolver(const SymbolResolver &) = delete;
+  SymbolResolver &operator=(const SymbolResolver &) = delete;
+
+  // Initializes DbgHelp on the first call and tells it about newly loaded
+  // modules on the next ones.
+  void Update() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<os::Module> modules;
+    ModuleTable::shared().GetModules(modules);
+    if (!dbghelp_) {
+      dbghelp_.reset(new DbgHelp);
+      if (dbghelp_->is_initialized() && dbghelp_->SymFromAddr != nullptr) {
+        SIZE_T size = sizeof(SYMBOL_INFO) + kMaxSymbolNameLength + 1;
+        symbol_.assign(size, 0);
+        SYMBOL_INFO *symbol = reinterpret_cast<SYMBOL_INFO*>(&symbol_[0]);
+        symbol->SizeOfStruct = sizeof(*symbol);
+        symbol->MaxNameLen = kMaxSymbolNameLength;
+      }
+    } else if (modules.size() != num_modules_
+               && dbghelp_->is_initialized()
+               && dbghelp_->SymRefreshModuleList != nullptr) {
+      dbghelp_->SymRefreshModuleList(GetCurrentProcess());
+      names_.clear();
+    }
+    num_modules_ = modules.size();
+    ready_ = true;
   }
 
-  HANDLE process = GetCurrentProcess();
-  DbgHelp dbghelp(process);
-  if (!dbghelp.is_loaded()) {
-    return;
+  // Looks up the names of the functions that frames[i] belong to. Returns
+  // false without doing anything if DbgHelp isn't ready yet or another
+  // thread is using it right now.
+  bool Resolve(void *const *frames,
+               int num_frames,
+               std::vector<std::string> &names) {
+    if (!ready_) {
+      return false;
+    }
+    std::unique_lock<std::mutex> lock(mutex_, std::try_to_lock);
+    if (!lock.owns_lock()) {
+      return false;
+    }
+    names.resize(num_frames);
+    for (int i = 0; i < num_frames; i++) {
+      names[i] = GetName(frames[i]);
+    }
+    return true;
   }
 
-  STACKFRAME64 stack_frame;
-  ZeroMemory(&stack_frame, sizeof(stack_frame));
+  static SymbolResolver &shared() {
+    static SymbolResolver resolver;
+    return resolver;
+  }
 
-  // http://stackoverflow.com/a/136942/249230
-  stack_frame.AddrPC.Offset = context.Eip;
-  stack_frame.AddrReturn.Offset = context.Eip;
-  stack_frame.AddrPC.Mode = AddrModeFlat;
-  stack_frame.AddrFrame.Offset = context.Ebp;
-  stack_frame.AddrFrame.Mode = AddrModeFlat;
-  stack_frame.AddrStack.Offset = context.Esp;
-  stack_frame.AddrStack.Mode = AddrModeFlat;
+ private:
+  std::string GetName(void *address) {
+    std::unordered_map<void *, std::string>::const_iterator it =
+      names_.find(address);
+    if (it != names_.end()) {
+      return it->second;
+    }
 
-  if (dbghelp.StackWalk64 == nullptr) {
-    return;
+    // Addresses outside of any module (e.g. garbage left on the stack) are
+    // not worth asking DbgHelp about.
+    std::string name;
+    if (!symbol_.empty() && ModuleTable::shared().IsModuleAddress(address)) {
+      HANDLE process = GetCurrentProcess();
+      DWORD64 address64 = reinterpret_cast<uintptr_t>(address);
+      bool have_symbols = true;
+      if (dbghelp_->SymGetModuleInfo64 != nullptr) {
+        IMAGEHLP_MODULE64 module;
+        ZeroMemory(&module, sizeof(IMAGEHLP_MODULE64));
+        module.SizeOfStruct = sizeof(IMAGEHLP_MODULE64);
+        if (dbghelp_->SymGetModuleInfo64(process, address64, &module)) {
+          if (!module.GlobalSymbols) {
+            have_symbols = false;
+          }
+        }
+      }
+      SYMBOL_INFO *symbol = reinterpret_cast<SYMBOL_INFO*>(&symbol_[0]);
+      if (have_symbols
+          && dbghelp_->SymFromAddr(process, address64, nullptr, symbol)) {
+        name = symbol->Name;
+      }
+    }
+    names_.emplace(address, name);
+    return name;
   }
 
-  SYMBOL_INFO *symbol = nullptr;
+ private:
+  std::mutex mutex_;
+  std::unique_ptr<DbgHelp> dbghelp_;
+  std::vector<char> symbol_;
+  std::unordered_map<void *, std::string> names_;
+  std::size_t num_modules_;
+  std::atomic<bool> ready_;
+};
 
-  if (dbghelp.is_initialized()) {
-    SIZE_T size = sizeof(SYMBOL_INFO) + kMaxSymbolNameLength + 1;
-    DWORD flags = HEAP_ZERO_MEMORY | HEAP_GENERATE_EXCEPTIONS;
-    SYMBOL_INFO *symbol = static_cast<SYMBOL_INFO*>(HeapAlloc(GetProcessHeap(),
-                                                              flags,
-                                                              size));
-    if (symbol == nullptr) {
-      return;
-    }
+} // anonymous namespace
 
-    symbol->SizeOfStruct = sizeof(*symbol);
-    symbol->MaxNameLen = kMaxSymbolNameLength;
+void InitSymbols() {
+  WorkQueue::shared().Submit([]() {
+    SymbolResolver::shared().Update();
+  });
+}
 
-    if (dbghelp.SymGetOptions != nullptr && dbghelp.SymSetOptions != nullptr) {
-      DWORD options = dbghelp.SymGetOptions();
-      options |= SYMOPT_FAIL_CRITICAL_ERRORS;
-      dbghelp.SymSetOptions(options);
-    }
+int CaptureStackTrace(void **frames, int max_frames, void *context_ptr) {
+  if (context_ptr == nullptr) {
+    // Skip this function.
+    return RtlCaptureStackBackTrace(1, max_frames, frames, nullptr);
   }
 
-  while (true) {
-    DWORD64 address = stack_frame.AddrReturn.Offset;
-    if (address == 0 || address & 0x80000000) {
-      break;
-    }
+  // Follow the chain of saved EBP values of the interrupted code. This is
+  // what RtlCaptureStackBackTrace() does too, but starting from the
+  // context rather than the current frame.
+  const CONTEXT *context = reinterpret_cast<PCONTEXT>(context_ptr);
+  return WalkFramePointers(frames,
+                           max_frames,
+                           reinterpret_cast<void *>(context->Eip),
+                           reinterpret_cast<void *>(context->Ebp));
+}
 
-    bool have_symbols = true;
-    if (dbghelp.SymGetModuleInfo64) {
-      IMAGEHLP_MODULE64 module;
-      ZeroMemory(&module, sizeof(IMAGEHLP_MODULE64));
-      module.SizeOfStruct = sizeof(IMAGEHLP_MODULE64);
-      if (dbghelp.SymGetModuleInfo64(process, address, &module)) {
-        if (!module.GlobalSymbols) {
-          have_symbols = false;
-        }
-      }
-    }
+int CaptureFastStackTrace(void **frames, int max_frames) {
+  // This follows frame pointers already.
+  return RtlCaptureStackBackTrace(1, max_frames, frames, nullptr);
+}
 
-    const char *name = "";
-    if (have_symbols) {
-      if (dbghelp.is_initialized()
-          && dbghelp.SymFromAddr != nullptr
-          && symbol != nullptr) {
-        if (dbghelp.SymFromAddr(process, address, nullptr, symbol)) {
-          name = symbol->Name;
-        }
-      }
-    }
+const char *FindSymbolName(void *address) {
+  // DbgHelp allocates memory.
+  return nullptr;
+}
 
-    frames.push_back(StackFrame(reinterpret_cast<void*>(address), name));
-
-    if (!dbghelp.StackWalk64(IMAGE_FILE_MACHINE_I386,
-                             process,
-                             GetCurrentThread(),
-                             &stack_frame,
-                             (PVOID)&context,
-                             nullptr,
-                             nullptr,
-                             nullptr,
-                             nullptr)) {
-      break;
-    }
-  }
+void GetStackTrace(std::vector<StackFrame> &frames, void *context) {
+  void *trace[kMaxStackFrames];
+  int length = CaptureStackTrace(trace, kMaxStackFrames, context);
+  ResolveStackTrace(frames, trace, length);
+}
 
-  HeapFree(GetProcessHeap(), 0, symbol);
-  dbghelp.SymCleanup(process);
+void ResolveStackTrace(std::vector<StackFrame> &frames,
+                       void *const *trace,
+                       int length) {
+  // The names are looked up after the stack has been captured, with the
+  // symbols loaded in advance by InitSymbols(). If that hasn't finished,
+  // the frames are printed without names rather than waiting for it.
+  std::vector<std::string> names;
+  SymbolResolver::shared().Resolve(trace, length, names);
+
+  for (int i = 0; i < length; i++) {
+    frames.push_back(StackFrame(trace[i],
+                                i < static_cast<int>(names.size())
+                                  ? names[i]
+                                  : std::string()));
+  }
 }
@@ -22,10 +22,13 @@
 // ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
 // POSSIBILITY OF SUCH DAMAGE.
 
+#include <cstdint>
 #include <iomanip>
 #include <iostream>
 #include <sstream>
 #include <string>
+#include "moduletable.h"
+#include "os.h"
 #include "stacktrace.h"
 
 StackFrame::StackFrame(void *return_address, const std::string &callee_name)
@@ -49,3 +52,39 @@ void StackFrame::Print(std::ostream &stream) const {
     stream << " in ?? ()";
   }
 }
+
+int WalkFramePointers(void **frames,
+                      int max_frames,
+                      void *pc,
+                      void *frame) {
+  int num_frames = 0;
+  if (pc != nullptr && num_frames < max_frames) {
+    frames[num_frames++] = pc;
+  }
+
+  os::uint32_t low;
+  os::uint32_t high;
+  if (!os::GetStackBounds(frame, low, high)) {
+    return num_frames;
+  }
+  std::uintptr_t current = reinterpret_cast<std::uintptr_t>(frame);
+  while (num_frames < max_frames
+         && current % sizeof(void *) == 0
+         && current >= low
+         && current + 2 * sizeof(void *) <= high) {
+    void *const *frame_ptr = reinterpret_cast<void *const *>(current);
+    void *return_address = frame_ptr[1];
+    if (return_address == nullptr
+        || !ModuleTable::shared().IsModuleAddress(return_address)) {
+      break;
+    }
+    frames[num_frames++] = return_address;
+    std::uintptr_t next = reinterpret_cast<std::uintptr_t>(frame_ptr[0]);
+    if (next <= current) {
+      // The stack grows down, so this must be garbage.
+      break;
+    }
+    current = next;
+  }
+  return num_frames;
+}
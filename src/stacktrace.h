@@ -43,6 +43,48 @@ class StackFrame {
   std::string callee_name_;
 };
 
+// The most frames that CaptureStackTrace() and GetStackTrace() return.
+const int kMaxStackFrames = 100;
+
+// Stores the return addresses of the calling thread's stack (or of the code
+// that was interrupted, if context is a native context) in frames, and
+// returns how many there are. This doesn't allocate memory, so it can be
+// used in a crash handler even if the heap is corrupted.
+int CaptureStackTrace(void **frames, int max_frames, void *context);
+
+// Follows the chain of saved frame pointers (EBP) starting with the given
+// frame. The first frame is pc, if it's not nullptr. Each frame must be on
+// the stack and each return address in a loaded module, so the walk stops
+// at the first function that doesn't keep a frame pointer rather than going
+// off into garbage. This is much
+// cheaper than CaptureStackTrace() on Linux and doesn't allocate memory.
+int WalkFramePointers(void **frames,
+                      int max_frames,
+                      void *pc,
+                      void *frame);
+
+// Same as CaptureStackTrace() without a context, but only follows frame
+// pointers, so that it's cheap enough for the profiler.
+int CaptureFastStackTrace(void **frames, int max_frames);
+
+// Returns the name of the function that an address belongs to, or nullptr
+// if that can't be found out without allocating memory on this platform.
+const char *FindSymbolName(void *address);
+
+// Gets whatever GetStackTrace() needs for looking up function names ready
+// in the background, so that it doesn't have to be done while handling a
+// crash. Should be called again when new modules are loaded.
+void InitSymbols();
+
+// Same as CaptureStackTrace() but also looks up function names, which may
+// allocate memory.
 void GetStackTrace(std::vector<StackFrame> &frames, void *context);
 
+// Looks up the function names of addresses captured earlier, e.g. with
+// CaptureStackTrace(), and appends them to frames. This is the part of
+// GetStackTrace() that takes time, so it can be left to another thread.
+void ResolveStackTrace(std::vector<StackFrame> &frames,
+                       void *const *trace,
+                       int length);
+
 #endif // !STACKTRACE_H
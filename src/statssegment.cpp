@@ -0,0 +1,162 @@
+// Copyright (c) 2026 Zeex
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <chrono>
+#include <cstring>
+#include <string>
+#ifdef _WIN32
+  #include <windows.h>
+#else
+  #include <unistd.h>
+#endif
+#include "statssegment.h"
+
+static_assert(sizeof(StatsHeader) == 336, "StatsHeader layout changed");
+static_assert(sizeof(StatsScript) == 72, "StatsScript layout changed");
+static_assert(sizeof(StatsPublic) == 80, "StatsPublic layout changed");
+static_assert(sizeof(StatsNative) == 88, "StatsNative layout changed");
+
+namespace {
+
+unsigned long GetPid() {
+  #ifdef _WIN32
+    return GetCurrentProcessId();
+  #else
+    return static_cast<unsigned long>(getpid());
+  #endif
+}
+
+// Copies a name, cutting it short if it doesn't fit. The rest of the field
+// is zeroed so that stale characters don't show up.
+void CopyName(char *dest, std::size_t size, const char *name) {
+  std::memset(dest, 0, size);
+  std::strncpy(dest, name, size - 1);
+}
+
+} // anonymous namespace
+
+const uint32_t StatsSegment::kMaxScripts;
+const uint32_t StatsSegment::kMaxPublics;
+const uint32_t StatsSegment::kMaxNatives;
+
+StatsSegment::StatsSegment()
+  : header_(nullptr),
+    scripts_(nullptr),
+    publics_(nullptr),
+    natives_(nullptr)
+{
+}
+
+bool StatsSegment::Open() {
+  uint32_t scripts_offset = sizeof(StatsHeader);
+  uint32_t publics_offset = scripts_offset + kMaxScripts * sizeof(StatsScript);
+  uint32_t natives_offset = publics_offset + kMaxPublics * sizeof(StatsPublic);
+  uint32_t size = natives_offset + kMaxNatives * sizeof(StatsNative);
+
+  std::string name = "crashdetect-" + std::to_string(GetPid());
+  if (!memory_.Create(name, size)) {
+    return false;
+  }
+  char *data = static_cast<char *>(memory_.data());
+  header_ = reinterpret_cast<StatsHeader *>(data);
+  scripts_ = reinterpret_cast<StatsScript *>(data + scripts_offset);
+  publics_ = reinterpret_cast<StatsPublic *>(data + publics_offset);
+  natives_ = reinterpret_cast<StatsNative *>(data + natives_offset);
+
+  header_->version = kStatsVersion;
+  header_->size = size;
+  header_->pid = static_cast<uint32_t>(GetPid());
+  header_->scripts_offset = scripts_offset;
+  header_->publics_offset = publics_offset;
+  header_->natives_offset = natives_offset;
+  // The magic goes last so that readers don't look at a half-initialized
+  // header.
+  std::atomic_thread_fence(std::memory_order_release);
+  std::memcpy(header_->magic, "CDST", 4);
+  return true;
+}
+
+void StatsSegment::Close() {
+  memory_.Close();
+  header_ = nullptr;
+  scripts_ = nullptr;
+  publics_ = nullptr;
+  natives_ = nullptr;
+}
+
+// A sequence lock: readers retry if the number is odd or changes while
+// they copy the data.
+void StatsSegment::BeginUpdate() {
+  header_->sequence.fetch_add(1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  header_->num_scripts = 0;
+  header_->num_publics = 0;
+  header_->num_natives = 0;
+}
+
+void StatsSegment::EndUpdate() {
+  header_->update_time =
+    std::chrono::duration_cast<std::chrono::milliseconds>(
+      std::chrono::system_clock::now().time_since_epoch()).count();
+  header_->sequence.fetch_add(1, std::memory_order_release);
+}
+
+StatsScript *StatsSegment::AddScript(const char *name, uint32_t &index) {
+  if (header_->num_scripts >= kMaxScripts) {
+    return nullptr;
+  }
+  index = header_->num_scripts++;
+  StatsScript *script = &scripts_[index];
+  CopyName(script->name, sizeof(script->name), name);
+  script->errors = 0;
+  return script;
+}
+
+StatsPublic *StatsSegment::AddPublic(uint32_t script, const char *name) {
+  if (header_->num_publics >= kMaxPublics) {
+    return nullptr;
+  }
+  StatsPublic *entry = &publics_[header_->num_publics++];
+  std::memset(entry, 0, sizeof(*entry));
+  entry->script = script;
+  CopyName(entry->name, sizeof(entry->name), name);
+  return entry;
+}
+
+StatsNative *StatsSegment::AddNative(uint32_t script, const char *name) {
+  if (header_->num_natives >= kMaxNatives) {
+    return nullptr;
+  }
+  StatsNative *entry = &natives_[header_->num_natives++];
+  std::memset(entry, 0, sizeof(*entry));
+  entry->script = script;
+  CopyName(entry->name, sizeof(entry->name), name);
+  return entry;
+}
+
+// static
+StatsSegment &StatsSegment::shared() {
+  static StatsSegment instance;
+  return instance;
+}
@@ -0,0 +1,122 @@
+// Copyright (c) 2026 Zeex
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef STATSSEGMENT_H
+#define STATSSEGMENT_H
+
+#include <atomic>
+#include <cstdint>
+#include "sharedmemory.h"
+
+// The statistics that tools/cdtop.py shows, published in shared memory
+// named crashdetect-<pid> (see SharedMemory). The server thread rewrites
+// it every stats_interval milliseconds; readers never block it, they copy
+// the segment and try again if the sequence number was odd or has changed
+// in the meantime. All fields are little-endian and their offsets are the
+// same in 32-bit and 64-bit builds. Bump kStatsVersion on any change.
+const uint32_t kStatsVersion = 1;
+
+struct StatsHeader {
+  char magic[4];                    // "CDST"
+  uint32_t version;
+  uint32_t size;                    // of the whole segment
+  uint32_t pid;
+  std::atomic<uint32_t> sequence;   // odd while being updated
+  uint32_t num_scripts;
+  uint32_t num_publics;
+  uint32_t num_natives;
+  uint32_t scripts_offset;
+  uint32_t publics_offset;
+  uint32_t natives_offset;
+  uint32_t reserved;
+  int64_t update_time;              // Unix time in milliseconds
+  uint64_t long_calls;
+  uint64_t dropped_log_lines;
+  uint64_t log_queued_bytes;
+  uint64_t errors[32];              // by AMX error code
+};
+
+struct StatsScript {
+  char name[64];
+  uint64_t errors;
+};
+
+// Public and native figures are those of callback_stats and native_stats
+// for their current interval. Times are in microseconds.
+struct StatsPublic {
+  uint32_t script;                  // index into the scripts
+  uint32_t reserved;
+  char name[32];
+  uint64_t calls;
+  int64_t total;
+  int64_t p50;
+  int64_t p99;
+  int64_t max;
+};
+
+struct StatsNative {
+  uint32_t script;
+  uint32_t reserved;
+  char name[32];
+  char module[32];                  // plugin file name
+  uint64_t calls;
+  int64_t time;
+};
+
+class StatsSegment {
+ public:
+  static const uint32_t kMaxScripts = 64;
+  static const uint32_t kMaxPublics = 2048;
+  static const uint32_t kMaxNatives = 2048;
+
+  StatsSegment();
+
+  bool Open();
+  void Close();
+
+  bool IsOpen() const { return memory_.IsOpen(); }
+
+  // Everything in between is seen by readers at once. Only one thread may
+  // update the segment.
+  void BeginUpdate();
+  void EndUpdate();
+
+  StatsHeader &header() { return *header_; }
+
+  // Return nullptr when there's no more room.
+  StatsScript *AddScript(const char *name, uint32_t &index);
+  StatsPublic *AddPublic(uint32_t script, const char *name);
+  StatsNative *AddNative(uint32_t script, const char *name);
+
+  static StatsSegment &shared();
+
+ private:
+  SharedMemory memory_;
+  StatsHeader *header_;
+  StatsScript *scripts_;
+  StatsPublic *publics_;
+  StatsNative *natives_;
+};
+
+#endif // !STATSSEGMENT_H
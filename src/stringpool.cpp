@@ -0,0 +1,68 @@
+// Copyright (c) 2026 Zeex
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <cstring>
+#include "stringpool.h"
+
+StringPool::StringPool() {
+  Clear();
+}
+
+uint32_t StringPool::Intern(const char *s) {
+  if (*s == '\0') {
+    return 0;
+  }
+  if (ids_.empty()) {
+    // Either nothing has been added yet or Compact() threw the table away.
+    for (std::size_t id = 1; id < data_.size();
+         id += std::strlen(&data_[id]) + 1) {
+      ids_.emplace(&data_[id], static_cast<uint32_t>(id));
+    }
+  }
+  std::pair<std::unordered_map<std::string, uint32_t>::iterator, bool> result =
+    ids_.emplace(s, static_cast<uint32_t>(data_.size()));
+  if (result.second) {
+    data_.insert(data_.end(), s, s + std::strlen(s) + 1);
+  }
+  return result.first->second;
+}
+
+bool StringPool::Assign(const char *data, std::size_t size) {
+  if (size == 0 || data[0] != '\0' || data[size - 1] != '\0') {
+    return false;
+  }
+  data_.assign(data, data + size);
+  ids_.clear();
+  return true;
+}
+
+void StringPool::Compact() {
+  std::unordered_map<std::string, uint32_t>().swap(ids_);
+  data_.shrink_to_fit();
+}
+
+void StringPool::Clear() {
+  data_.assign(1, '\0');
+  ids_.clear();
+}
@@ -0,0 +1,67 @@
+// Copyright (c) 2026 Zeex
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef STRINGPOOL_H
+#define STRINGPOOL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Stores each distinct string once, one after another, and refers to them
+// by 32-bit IDs (their offsets in the pool). ID 0 is the empty string.
+class StringPool {
+ public:
+  StringPool();
+
+  // Returns the ID of the string, adding it to the pool if it's not there.
+  uint32_t Intern(const char *s);
+
+  const char *Get(uint32_t id) const
+    { return &data_[id]; }
+  bool IsValidID(uint32_t id) const
+    { return id < data_.size(); }
+
+  // The pool contents, e.g. for saving them to a file. Assign() loads them
+  // back and returns false if they don't look like a pool.
+  const char *data() const
+    { return data_.data(); }
+  std::size_t size() const
+    { return data_.size(); }
+  bool Assign(const char *data, std::size_t size);
+
+  // Frees the lookup table used by Intern() when no more strings are going
+  // to be added. It's rebuilt if Intern() is called again.
+  void Compact();
+
+  void Clear();
+
+ private:
+  std::vector<char> data_;
+  std::unordered_map<std::string, uint32_t> ids_;
+};
+
+#endif // !STRINGPOOL_H
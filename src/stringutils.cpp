@@ -67,6 +67,16 @@ std::string ToUpper(const std::string &s) {
   return TransformString(s, ::toupper);
 }
 
+std::string TrimString(const std::string &s) {
+  const char *whitespace = " \t\r\n";
+  std::string::size_type begin = s.find_first_not_of(whitespace);
+  if (begin == std::string::npos) {
+    return std::string();
+  }
+  std::string::size_type end = s.find_last_not_of(whitespace);
+  return s.substr(begin, end - begin + 1);
+}
+
 int CompareIgnoreCase(const char *s1, const char *s2) {
   return strcasecmp(s1, s2);
 }
@@ -75,4 +85,30 @@ int CompareIgnoreCase(const std::string &s1, const std::string &s2) {
   return CompareIgnoreCase(s1.c_str(), s2.c_str());
 }
 
+bool MatchWildcard(const std::string &pattern, const std::string &s) {
+  std::string::size_type p = 0;
+  std::string::size_type i = 0;
+  // Where to resume after the last '*' if the rest doesn't match.
+  std::string::size_type star = std::string::npos;
+  std::string::size_type star_i = 0;
+  while (i < s.length()) {
+    if (p < pattern.length() && (pattern[p] == '?' || pattern[p] == s[i])) {
+      p++;
+      i++;
+    } else if (p < pattern.length() && pattern[p] == '*') {
+      star = p++;
+      star_i = i;
+    } else if (star != std::string::npos) {
+      p = star + 1;
+      i = ++star_i;
+    } else {
+      return false;
+    }
+  }
+  while (p < pattern.length() && pattern[p] == '*') {
+    p++;
+  }
+  return p == pattern.length();
+}
+
 } // namespace stringutils
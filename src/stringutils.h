@@ -51,9 +51,16 @@ void SplitString(const std::string &s, char delim, Func func) {
 std::string ToLower(const std::string &s);
 std::string ToUpper(const std::string &s);
 
+// Removes leading and trailing whitespace.
+std::string TrimString(const std::string &s);
+
 int CompareIgnoreCase(const char *s1, const char *s2);
 int CompareIgnoreCase(const std::string &s1, const std::string &s2);
 
+// Matches a string against a pattern where '*' stands for any sequence of
+// characters and '?' for any single character.
+bool MatchWildcard(const std::string &pattern, const std::string &s);
+
 } // namespace stringutils
 
 #endif // !STRINGUTILS_H
@@ -0,0 +1,98 @@
+// Copyright (c) 2026 Zeex
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "moduletable.h"
+#include "stacktrace.h"
+#include "symbolizer.h"
+
+void Symbolizer::Resolve(void *const *addresses,
+                         int num_addresses,
+                         std::vector<SymbolizedFrame> &frames) {
+  frames.resize(num_addresses);
+  std::vector<int> missing;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (int i = 0; i < num_addresses; i++) {
+      SymbolizedFrame &frame = frames[i];
+      frame.address = addresses[i];
+      std::unordered_map<void *, Names>::const_iterator it =
+        names_.find(addresses[i]);
+      if (it != names_.end()) {
+        frame.function = it->second.function;
+        frame.module = it->second.module;
+      } else {
+        missing.push_back(i);
+      }
+    }
+  }
+  if (missing.empty()) {
+    return;
+  }
+
+  std::vector<void *> trace(missing.size());
+  for (std::size_t i = 0; i < missing.size(); i++) {
+    trace[i] = addresses[missing[i]];
+  }
+  std::vector<StackFrame> resolved;
+  ResolveStackTrace(resolved, trace.data(), static_cast<int>(trace.size()));
+  for (std::size_t i = 0; i < missing.size(); i++) {
+    SymbolizedFrame &frame = frames[missing[i]];
+    if (i < resolved.size()) {
+      frame.function = resolved[i].callee_name();
+    }
+    frame.module = ModuleTable::shared().GetModuleName(frame.address);
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (names_.size() + missing.size() > kMaxNames) {
+    names_.clear();
+  }
+  for (std::size_t i = 0; i < missing.size(); i++) {
+    const SymbolizedFrame &frame = frames[missing[i]];
+    // Names may be missing only because the symbols aren't ready yet (see
+    // InitSymbols()), so try again next time.
+    if (!frame.function.empty()) {
+      Names &names = names_[frame.address];
+      names.function = frame.function;
+      names.module = frame.module;
+    }
+  }
+}
+
+SymbolizedFrame Symbolizer::Resolve(void *address) {
+  std::vector<SymbolizedFrame> frames;
+  Resolve(&address, 1, frames);
+  return frames[0];
+}
+
+void Symbolizer::Clear() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  names_.clear();
+}
+
+// static
+Symbolizer &Symbolizer::shared() {
+  static Symbolizer instance;
+  return instance;
+}
@@ -0,0 +1,83 @@
+// Copyright (c) 2026 Zeex
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef SYMBOLIZER_H
+#define SYMBOLIZER_H
+
+#include <cstddef>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// A native code address with the names that go with it.
+struct SymbolizedFrame {
+  void *address;
+  std::string function;  // empty if not known
+  std::string module;    // full path, empty if not in a module
+};
+
+// Turns the raw addresses captured for reports (native backtraces, the
+// native part of profiler samples, native functions in AMX backtraces)
+// into function and module names, so that whoever captures them doesn't
+// have to look anything up. Reports that are printed from the log thread
+// or a worker thread resolve their frames there. Results are remembered,
+// so the call sites that show up in report after report are looked up
+// once. Can be used from any thread, but not from the crash handler.
+class Symbolizer {
+ public:
+  // Fills in frames[i] for addresses[i]. What isn't remembered yet is
+  // looked up without holding the lock, so a thread resolving a long
+  // batch doesn't hold up the others.
+  void Resolve(void *const *addresses,
+               int num_addresses,
+               std::vector<SymbolizedFrame> &frames);
+  SymbolizedFrame Resolve(void *address);
+
+  // Forgets everything looked up so far. Called when modules are loaded,
+  // since they may take the place of ones that have been unloaded.
+  void Clear();
+
+  static Symbolizer &shared();
+
+ private:
+  Symbolizer() {}
+
+  Symbolizer(const Symbolizer &) = delete;
+  Symbolizer &operator=(const Symbolizer &) = delete;
+
+ private:
+  struct Names {
+    std::string function;
+    std::string module;
+  };
+
+  // The memo is simply emptied when it gets this big.
+  static const std::size_t kMaxNames = 4096;
+
+  std::mutex mutex_;
+  std::unordered_map<void *, Names> names_;
+};
+
+#endif // !SYMBOLIZER_H
@@ -0,0 +1,67 @@
+// Copyright (c) 2026 Zeex
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <atomic>
+#include "log.h"
+#include "options.h"
+#include "os.h"
+#include "threadpolicy.h"
+
+namespace {
+
+const char *const kThreadClassNames[THREAD_CLASS_COUNT] = {
+  "log",
+  "watchdog",
+  "profiler",
+  "worker"
+};
+
+std::atomic<bool> failure_reported[THREAD_CLASS_COUNT];
+
+} // anonymous namespace
+
+ThreadClass ThreadClassFromString(const std::string &s) {
+  for (int i = 0; i < THREAD_CLASS_COUNT; i++) {
+    if (s == kThreadClassNames[i]) {
+      return static_cast<ThreadClass>(i);
+    }
+  }
+  return THREAD_CLASS_COUNT;
+}
+
+void ApplyThreadPolicy(ThreadClass thread_class) {
+  const ThreadPolicy &policy = Options::shared().thread_policy(thread_class);
+  bool ok = true;
+  if (!policy.cpus.empty()) {
+    ok = os::SetThreadAffinity(policy.cpus) && ok;
+  }
+  if (policy.set_niceness) {
+    ok = os::SetThreadNiceness(policy.niceness) && ok;
+  }
+  // Raising the priority usually needs extra privileges.
+  if (!ok && !failure_reported[thread_class].exchange(true)) {
+    LogDebugPrint("Could not set the CPU affinity or priority of %s threads",
+                  kThreadClassNames[thread_class]);
+  }
+}
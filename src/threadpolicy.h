@@ -0,0 +1,58 @@
+// Copyright (c) 2026 Zeex
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef THREADPOLICY_H
+#define THREADPOLICY_H
+
+#include <string>
+#include <vector>
+
+// Background threads by what they do, for thread_affinity and
+// thread_priority.
+enum ThreadClass {
+  THREAD_CLASS_LOG,       // log, trace output, metrics and error reports
+  THREAD_CLASS_WATCHDOG,  // long_call_time and hang_timeout
+  THREAD_CLASS_PROFILER,
+  THREAD_CLASS_WORKER,    // background jobs, e.g. loading debug info
+  THREAD_CLASS_COUNT
+};
+
+// Where the threads of a class run: the CPUs they may use (any if empty)
+// and their niceness, which is left alone unless set_niceness is true.
+struct ThreadPolicy {
+  ThreadPolicy(): set_niceness(false), niceness(0) {}
+  std::vector<int> cpus;
+  bool set_niceness;
+  int niceness;
+};
+
+// Returns the class named as in server.cfg ("log", "watchdog", ...) or
+// THREAD_CLASS_COUNT if there's no such class.
+ThreadClass ThreadClassFromString(const std::string &s);
+
+// Applies the policy of the class to the calling thread. Each background
+// thread calls this when it starts. Failures are logged once per class.
+void ApplyThreadPolicy(ThreadClass thread_class);
+
+#endif // !THREADPOLICY_H
@@ -0,0 +1,80 @@
+// Copyright (c) 2026 Zeex
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <algorithm>
+#include "topkcounter.h"
+
+TopKCounter::TopKCounter(std::size_t capacity)
+  : capacity_(std::max<std::size_t>(capacity, 1))
+{
+  entries_.reserve(capacity_);
+}
+
+void TopKCounter::Add(uint64_t key, int64_t weight) {
+  std::unordered_map<uint64_t, std::size_t>::iterator it = slots_.find(key);
+  if (it != slots_.end()) {
+    Entry &entry = entries_[it->second];
+    entry.weight += weight;
+    entry.count++;
+    return;
+  }
+  if (entries_.size() < capacity_) {
+    Entry entry = {key, weight, 0, 1};
+    slots_.emplace(key, entries_.size());
+    entries_.push_back(entry);
+    return;
+  }
+  // A linear scan for the minimum is fine for the few hundred slots this
+  // is used with, and only new keys get here.
+  std::size_t min_slot = 0;
+  for (std::size_t i = 1; i < entries_.size(); i++) {
+    if (entries_[i].weight < entries_[min_slot].weight) {
+      min_slot = i;
+    }
+  }
+  Entry &entry = entries_[min_slot];
+  slots_.erase(entry.key);
+  slots_.emplace(key, min_slot);
+  entry.key = key;
+  entry.error = entry.weight;
+  entry.weight += weight;
+  entry.count = 1;
+}
+
+void TopKCounter::Clear() {
+  entries_.clear();
+  slots_.clear();
+}
+
+void TopKCounter::GetTop(std::size_t n, std::vector<Entry> &entries) const {
+  entries = entries_;
+  n = std::min(n, entries.size());
+  std::partial_sort(entries.begin(),
+                    entries.begin() + n,
+                    entries.end(),
+                    [](const Entry &a, const Entry &b) {
+                      return a.weight > b.weight;
+                    });
+  entries.resize(n);
+}
@@ -0,0 +1,64 @@
+// Copyright (c) 2026 Zeex
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef TOPKCOUNTER_H
+#define TOPKCOUNTER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+// Finds the keys with the highest total weight among many more than it can
+// keep, using the Space-Saving algorithm: once all slots are taken, a new key
+// replaces the one with the lowest total and inherits it as its error. The
+// totals of keys that are kept are never too low, and any key whose real
+// total is above the lowest one is guaranteed to be kept.
+class TopKCounter {
+ public:
+  struct Entry {
+    uint64_t key;
+    int64_t weight;
+    // How much of the weight may belong to keys this one replaced.
+    int64_t error;
+    uint32_t count;
+  };
+
+  explicit TopKCounter(std::size_t capacity);
+
+  void Add(uint64_t key, int64_t weight);
+  void Clear();
+
+  std::size_t capacity() const { return capacity_; }
+
+  // Returns up to n entries with the highest weight, highest first.
+  void GetTop(std::size_t n, std::vector<Entry> &entries) const;
+
+ private:
+  std::size_t capacity_;
+  std::vector<Entry> entries_;
+  std::unordered_map<uint64_t, std::size_t> slots_;
+};
+
+#endif // !TOPKCOUNTER_H
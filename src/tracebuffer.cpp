@@ -0,0 +1,186 @@
+// Copyright (c) 2026 Zeex
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <chrono>
+#include "fastclock.h"
+#include "threadpolicy.h"
+#include "tracebuffer.h"
+
+namespace {
+
+std::size_t RoundUpToPowerOfTwo(std::size_t n) {
+  std::size_t size = 1;
+  while (size < n) {
+    size <<= 1;
+  }
+  return size;
+}
+
+int64_t start_time;
+
+} // anonymous namespace
+
+const int TraceRecord::kMaxArgs;
+
+TraceBuffer::Ring::Ring(std::size_t size)
+  : records_(RoundUpToPowerOfTwo(size)),
+    mask_(records_.size() - 1),
+    head_(0),
+    tail_(0)
+{
+}
+
+bool TraceBuffer::Ring::TryPush(const TraceRecord &record) {
+  std::size_t head = head_.load(std::memory_order_relaxed);
+  if (head - tail_.load(std::memory_order_acquire) >= records_.size()) {
+    return false;
+  }
+  records_[head & mask_] = record;
+  head_.store(head + 1, std::memory_order_release);
+  return true;
+}
+
+const TraceRecord *TraceBuffer::Ring::Front() const {
+  std::size_t tail = tail_.load(std::memory_order_relaxed);
+  if (tail == head_.load(std::memory_order_acquire)) {
+    return nullptr;
+  }
+  return &records_[tail & mask_];
+}
+
+void TraceBuffer::Ring::PopFront() {
+  // The tail is only advanced after the record has been formatted, this
+  // is what Flush() relies on.
+  tail_.store(tail_.load(std::memory_order_relaxed) + 1,
+              std::memory_order_release);
+}
+
+TraceBuffer::TraceBuffer()
+  : formatter_(nullptr),
+    ring_size_(0),
+    running_(false),
+    stop_thread_(false)
+{
+}
+
+TraceBuffer::~TraceBuffer() {
+  Stop();
+}
+
+void TraceBuffer::Start(Formatter formatter, std::size_t ring_size) {
+  if (running_) {
+    return;
+  }
+  formatter_ = formatter;
+  ring_size_ = ring_size > 0 ? ring_size : 1;
+  start_time = fastclock::Now();
+  stop_thread_ = false;
+  thread_ = std::thread(&TraceBuffer::Run, this);
+  running_ = true;
+}
+
+void TraceBuffer::Stop() {
+  if (!running_) {
+    return;
+  }
+  running_ = false;
+  stop_thread_ = true;
+  thread_.join();
+}
+
+int64_t TraceBuffer::GetTime() const {
+  return fastclock::Now() - start_time;
+}
+
+void TraceBuffer::Push(const TraceRecord &record) {
+  if (!running_) {
+    return;
+  }
+  Ring *ring = GetThreadRing();
+  while (!ring->TryPush(record)) {
+    std::this_thread::yield();
+  }
+}
+
+void TraceBuffer::Flush() {
+  if (!running_) {
+    return;
+  }
+  std::vector<std::pair<Ring*, std::size_t>> heads;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (std::size_t i = 0; i < rings_.size(); i++) {
+      heads.push_back(std::make_pair(rings_[i].get(), rings_[i]->head()));
+    }
+  }
+  for (std::size_t i = 0; i < heads.size(); i++) {
+    Ring *ring = heads[i].first;
+    std::size_t head = heads[i].second;
+    while (static_cast<std::ptrdiff_t>(head - ring->tail()) > 0) {
+      std::this_thread::yield();
+    }
+  }
+}
+
+TraceBuffer::Ring *TraceBuffer::GetThreadRing() {
+  // Rings are never destroyed until the plugin is unloaded, so it's safe to
+  // keep a pointer to it.
+  static thread_local Ring *ring = nullptr;
+  if (ring == nullptr) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    rings_.emplace_back(new Ring(ring_size_));
+    ring = rings_.back().get();
+  }
+  return ring;
+}
+
+bool TraceBuffer::ProcessRings() {
+  bool processed = false;
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (std::size_t i = 0; i < rings_.size(); i++) {
+    Ring *ring = rings_[i].get();
+    while (const TraceRecord *record = ring->Front()) {
+      formatter_(*record);
+      ring->PopFront();
+      processed = true;
+    }
+  }
+  return processed;
+}
+
+void TraceBuffer::Run() {
+  ApplyThreadPolicy(THREAD_CLASS_LOG);
+  while (!stop_thread_) {
+    if (!ProcessRings()) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+  }
+  ProcessRings();
+}
+
+// static
+TraceBuffer &TraceBuffer::shared() {
+  static TraceBuffer instance;
+  return instance;
+}
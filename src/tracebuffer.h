@@ -0,0 +1,127 @@
+// Copyright (c) 2026 Zeex
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef TRACEBUFFER_H
+#define TRACEBUFFER_H
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <amx/amx.h>
+#include "amxstacktrace.h"
+
+// A trace event captured on the VM thread. Records contain only raw values
+// so that creating them is cheap; turning them into text is left to the
+// formatter running on the trace buffer's own thread.
+struct TraceRecord {
+  enum Kind {
+    NATIVE,
+    PUBLIC,
+    FUNCTION,
+    PUBLIC_RETURN  // only recorded for trace_output chrome
+  };
+
+  static const int kMaxArgs = 10;
+
+  int64_t time;         // microseconds since the trace buffer was started
+  int64_t start_time;   // natives: when the call started
+  AMX *amx;
+  Kind kind;
+  cell index;           // native or public index
+  cell caller_address;  // address of the public or function being called
+  cell return_address;
+  cell frame;
+  cell num_args;        // total number of arguments, may exceed kMaxArgs
+  cell args[kMaxArgs];
+  cell retval;               // natives only
+  AMXArgumentData arg_data;  // natives: only with trace_native_signatures
+};
+
+class TraceBuffer {
+ public:
+  typedef void (*Formatter)(const TraceRecord &record);
+
+  // Starts a thread that passes records to the formatter. Each thread that
+  // calls Push() gets its own ring of ring_size records.
+  void Start(Formatter formatter, std::size_t ring_size);
+  void Stop();
+
+  bool IsRunning() const { return running_; }
+
+  // Returns the current time in the same units as TraceRecord::time.
+  int64_t GetTime() const;
+
+  // Adds a record to the calling thread's ring. If the ring is full this
+  // waits until there's enough room.
+  void Push(const TraceRecord &record);
+
+  // Waits until all records pushed so far have been formatted.
+  void Flush();
+
+  static TraceBuffer &shared();
+
+ private:
+  TraceBuffer();
+  ~TraceBuffer();
+
+  TraceBuffer(const TraceBuffer &) = delete;
+  TraceBuffer &operator=(const TraceBuffer &) = delete;
+
+  // Single-producer single-consumer ring.
+  class Ring {
+   public:
+    explicit Ring(std::size_t size);
+
+    bool TryPush(const TraceRecord &record);
+    const TraceRecord *Front() const;
+    void PopFront();
+
+    std::size_t head() const { return head_.load(std::memory_order_acquire); }
+    std::size_t tail() const { return tail_.load(std::memory_order_acquire); }
+
+   private:
+    std::vector<TraceRecord> records_;
+    std::size_t mask_;
+    std::atomic<std::size_t> head_;
+    std::atomic<std::size_t> tail_;
+  };
+
+  Ring *GetThreadRing();
+  bool ProcessRings();
+  void Run();
+
+ private:
+  Formatter formatter_;
+  std::size_t ring_size_;
+  std::atomic<bool> running_;
+  std::atomic<bool> stop_thread_;
+  std::thread thread_;
+  std::mutex mutex_;
+  std::vector<std::unique_ptr<Ring>> rings_;
+};
+
+#endif // !TRACEBUFFER_H
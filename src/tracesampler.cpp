@@ -0,0 +1,84 @@
+// Copyright (c) 2026 Zeex
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <algorithm>
+#include <chrono>
+#include "tracesampler.h"
+
+namespace {
+
+int64_t GetTimeMicroseconds() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+} // anonymous namespace
+
+TraceSampler::TraceSampler():
+  sample_(0),
+  rate_(0)
+{
+}
+
+void TraceSampler::Init(std::size_t num_slots,
+                        unsigned int sample,
+                        unsigned int rate) {
+  sample_ = sample;
+  rate_ = rate;
+  slots_.clear();
+  if (sample_ > 1 || rate_ > 0) {
+    Slot slot;
+    slot.count = 0;
+    slot.tokens = rate_;  // allow a full second's worth of calls up front
+    slot.last_time = GetTimeMicroseconds();
+    slots_.assign(num_slots, slot);
+  }
+}
+
+bool TraceSampler::Sample(std::size_t index) {
+  if (index >= slots_.size()) {
+    return true;
+  }
+
+  Slot &slot = slots_[index];
+  if (sample_ > 1) {
+    if (slot.count++ % sample_ != 0) {
+      return false;
+    }
+  }
+
+  if (rate_ > 0) {
+    int64_t time = GetTimeMicroseconds();
+    slot.tokens = std::min<double>(
+      rate_,
+      slot.tokens + (time - slot.last_time) * rate_ / 1000000.0);
+    slot.last_time = time;
+    if (slot.tokens < 1.0) {
+      return false;
+    }
+    slot.tokens -= 1.0;
+  }
+
+  return true;
+}
@@ -0,0 +1,60 @@
+// Copyright (c) 2026 Zeex
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef TRACESAMPLER_H
+#define TRACESAMPLER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Decides which calls get traced when trace_sample or trace_rate is set.
+// Every function (slot) has its own counter and token bucket, so frequently
+// called functions don't crowd out the rest.
+class TraceSampler {
+ public:
+  TraceSampler();
+
+  // Traces every sample-th call and at most rate calls per second for each
+  // slot. Zero disables the corresponding limit.
+  void Init(std::size_t num_slots, unsigned int sample, unsigned int rate);
+
+  bool IsEnabled() const { return !slots_.empty(); }
+
+  // Returns true if this call should be traced.
+  bool Sample(std::size_t index);
+
+ private:
+  struct Slot {
+    unsigned int count;
+    double tokens;
+    int64_t last_time;
+  };
+
+  unsigned int sample_;
+  unsigned int rate_;
+  std::vector<Slot> slots_;
+};
+
+#endif // !TRACESAMPLER_H
@@ -0,0 +1,235 @@
+// Copyright (c) 2026 Zeex
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <algorithm>
+#include <ctime>
+#include "tracewriter.h"
+
+// File format (all integers are little-endian):
+//
+//   header:  "CDTR", u8 version, u8 cell size, i64 start time (Unix time)
+//
+// followed by any number of entries, each starting with an entry type byte:
+//
+//   script:  0x01, varint id, varint path length, path,
+//            u32 FNV-1a hash of the .amx file
+//   record:  0x02, u8 kind, varint script id, varint time delta (us),
+//            svarint index, varint caller address, varint return address,
+//            varint frame, svarint number of arguments,
+//            svarint x min(number of arguments, TraceRecord::kMaxArgs),
+//            svarint return value (natives only),
+//            argument data (version 3 and later)
+//
+// Argument data is, for each of the arguments stored above, a varint number
+// of cells followed by that many svarint cells: the contents of references
+// and strings as copied at the time of the call (see AMXArgumentData), or
+// nothing if they weren't copied.
+//
+// varint is an unsigned LEB128 integer, svarint is a zigzag-encoded varint.
+// Time deltas are relative to the previous record.
+
+namespace {
+
+const unsigned char kMagic[4] = {'C', 'D', 'T', 'R'};
+const unsigned char kVersion = 3;
+
+const unsigned char kScriptEntry = 0x01;
+const unsigned char kRecordEntry = 0x02;
+
+const std::size_t kBufferSize = 65536;
+
+// Buffered data is flushed to disk at least this often (in microseconds).
+const int64_t kFlushInterval = 1000000;
+
+class Encoder {
+ public:
+  Encoder() : size_(0) {}
+
+  void PutByte(unsigned char byte) {
+    data_[size_++] = byte;
+  }
+
+  void PutUInt32(uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+      PutByte(static_cast<unsigned char>(value >> (i * 8)));
+    }
+  }
+
+  void PutInt64(int64_t value) {
+    for (int i = 0; i < 8; i++) {
+      PutByte(static_cast<unsigned char>(static_cast<uint64_t>(value)
+                                         >> (i * 8)));
+    }
+  }
+
+  void PutVarint(uint64_t value) {
+    while (value >= 0x80) {
+      PutByte(static_cast<unsigned char>(value | 0x80));
+      value >>= 7;
+    }
+    PutByte(static_cast<unsigned char>(value));
+  }
+
+  void PutSignedVarint(int64_t value) {
+    PutVarint((static_cast<uint64_t>(value) << 1)
+              ^ static_cast<uint64_t>(value >> 63));
+  }
+
+  const unsigned char *data() const { return data_; }
+  std::size_t size() const { return size_; }
+
+ private:
+  // Enough for the largest possible record.
+  unsigned char data_[512];
+  std::size_t size_;
+};
+
+uint32_t HashFile(const std::string &path) {
+  uint32_t hash = 2166136261u;
+  std::FILE *fp = std::fopen(path.c_str(), "rb");
+  if (fp != nullptr) {
+    unsigned char buffer[4096];
+    std::size_t size;
+    while ((size = std::fread(buffer, 1, sizeof(buffer), fp)) > 0) {
+      for (std::size_t i = 0; i < size; i++) {
+        hash ^= buffer[i];
+        hash *= 16777619u;
+      }
+    }
+    std::fclose(fp);
+  }
+  return hash;
+}
+
+} // anonymous namespace
+
+TraceWriter::TraceWriter()
+  : file_(nullptr),
+    last_time_(0),
+    last_flush_time_(0)
+{
+}
+
+TraceWriter::~TraceWriter() {
+  Close();
+}
+
+bool TraceWriter::Open(const std::string &filename) {
+  Close();
+
+  file_ = std::fopen(filename.c_str(), "wb");
+  if (file_ == nullptr) {
+    return false;
+  }
+  buffer_.reset(new char[kBufferSize]);
+  std::setvbuf(file_, buffer_.get(), _IOFBF, kBufferSize);
+
+  Encoder header;
+  for (std::size_t i = 0; i < sizeof(kMagic); i++) {
+    header.PutByte(kMagic[i]);
+  }
+  header.PutByte(kVersion);
+  header.PutByte(static_cast<unsigned char>(sizeof(cell)));
+  header.PutInt64(static_cast<int64_t>(std::time(nullptr)));
+  std::fwrite(header.data(), 1, header.size(), file_);
+
+  last_time_ = 0;
+  last_flush_time_ = 0;
+  scripts_.clear();
+  return true;
+}
+
+void TraceWriter::Close() {
+  if (file_ != nullptr) {
+    std::fclose(file_);
+    file_ = nullptr;
+  }
+  buffer_.reset();
+}
+
+void TraceWriter::WriteScript(uint32_t script_id,
+                              const std::string &script_path) {
+  Encoder entry;
+  entry.PutByte(kScriptEntry);
+  entry.PutVarint(script_id);
+  entry.PutVarint(script_path.length());
+  std::fwrite(entry.data(), 1, entry.size(), file_);
+  std::fwrite(script_path.data(), 1, script_path.length(), file_);
+
+  Encoder hash;
+  hash.PutUInt32(HashFile(script_path));
+  std::fwrite(hash.data(), 1, hash.size(), file_);
+}
+
+void TraceWriter::Write(const TraceRecord &record,
+                        uint32_t script_id,
+                        const std::string &script_path) {
+  if (file_ == nullptr) {
+    return;
+  }
+
+  if (scripts_.insert(script_id).second) {
+    WriteScript(script_id, script_path);
+  }
+
+  Encoder entry;
+  entry.PutByte(kRecordEntry);
+  entry.PutByte(static_cast<unsigned char>(record.kind));
+  entry.PutVarint(script_id);
+  entry.PutVarint(static_cast<uint64_t>(
+    std::max<int64_t>(record.time - last_time_, 0)));
+  entry.PutSignedVarint(record.index);
+  entry.PutVarint(static_cast<ucell>(record.caller_address));
+  entry.PutVarint(static_cast<ucell>(record.return_address));
+  entry.PutVarint(static_cast<ucell>(record.frame));
+  entry.PutSignedVarint(record.num_args);
+  cell num_args = std::min<cell>(record.num_args, TraceRecord::kMaxArgs);
+  for (cell i = 0; i < num_args; i++) {
+    entry.PutSignedVarint(record.args[i]);
+  }
+  if (record.kind == TraceRecord::NATIVE) {
+    entry.PutSignedVarint(record.retval);
+  }
+  for (cell i = 0; i < num_args; i++) {
+    cell size = record.arg_data.sizes[i];
+    const cell *cells = record.arg_data.cells + record.arg_data.offsets[i];
+    entry.PutVarint(static_cast<uint64_t>(size));
+    for (cell j = 0; j < size; j++) {
+      entry.PutSignedVarint(cells[j]);
+    }
+  }
+  std::fwrite(entry.data(), 1, entry.size(), file_);
+
+  last_time_ = record.time;
+  if (record.time - last_flush_time_ >= kFlushInterval) {
+    std::fflush(file_);
+    last_flush_time_ = record.time;
+  }
+}
+
+// static
+TraceWriter &TraceWriter::shared() {
+  static TraceWriter instance;
+  return instance;
+}
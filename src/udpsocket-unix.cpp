@@ -0,0 +1,97 @@
+// Copyright (c) 2026 Zeex
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <cstring>
+#include <fcntl.h>
+#include <netdb.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include "udpsocket.h"
+
+namespace {
+
+const std::size_t kInvalidSocket = static_cast<std::size_t>(-1);
+
+} // anonymous namespace
+
+UDPSocket::UDPSocket()
+  : socket_(kInvalidSocket)
+{
+}
+
+UDPSocket::~UDPSocket() {
+  Close();
+}
+
+bool UDPSocket::Open(const std::string &host, const std::string &port) {
+  Close();
+
+  addrinfo hints;
+  std::memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_DGRAM;
+
+  addrinfo *result;
+  if (getaddrinfo(host.c_str(), port.c_str(), &hints, &result) != 0) {
+    return false;
+  }
+
+  for (addrinfo *ai = result; ai != nullptr; ai = ai->ai_next) {
+    int fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+    if (fd < 0) {
+      continue;
+    }
+    // A connected UDP socket remembers the address for send().
+    if (connect(fd, ai->ai_addr, ai->ai_addrlen) != 0) {
+      close(fd);
+      continue;
+    }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    socket_ = static_cast<std::size_t>(fd);
+    break;
+  }
+
+  freeaddrinfo(result);
+  return IsOpen();
+}
+
+void UDPSocket::Close() {
+  if (IsOpen()) {
+    close(static_cast<int>(socket_));
+    socket_ = kInvalidSocket;
+  }
+}
+
+bool UDPSocket::IsOpen() const {
+  return socket_ != kInvalidSocket;
+}
+
+bool UDPSocket::Send(const char *data, std::size_t size) {
+  if (!IsOpen()) {
+    return false;
+  }
+  return send(static_cast<int>(socket_), data, size, 0)
+         == static_cast<ssize_t>(size);
+}
@@ -0,0 +1,100 @@
+// Copyright (c) 2026 Zeex
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <cstring>
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include "udpsocket.h"
+
+UDPSocket::UDPSocket()
+  : socket_(INVALID_SOCKET)
+{
+}
+
+UDPSocket::~UDPSocket() {
+  Close();
+}
+
+bool UDPSocket::Open(const std::string &host, const std::string &port) {
+  Close();
+
+  static bool wsa_initialized = false;
+  if (!wsa_initialized) {
+    WSADATA wsa_data;
+    if (WSAStartup(MAKEWORD(2, 2), &wsa_data) != 0) {
+      return false;
+    }
+    wsa_initialized = true;
+  }
+
+  addrinfo hints;
+  std::memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_DGRAM;
+
+  addrinfo *result;
+  if (getaddrinfo(host.c_str(), port.c_str(), &hints, &result) != 0) {
+    return false;
+  }
+
+  for (addrinfo *ai = result; ai != nullptr; ai = ai->ai_next) {
+    SOCKET s = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+    if (s == INVALID_SOCKET) {
+      continue;
+    }
+    // A connected UDP socket remembers the address for send().
+    if (connect(s, ai->ai_addr, static_cast<int>(ai->ai_addrlen)) != 0) {
+      closesocket(s);
+      continue;
+    }
+    u_long non_blocking = 1;
+    ioctlsocket(s, FIONBIO, &non_blocking);
+    socket_ = static_cast<std::size_t>(s);
+    break;
+  }
+
+  freeaddrinfo(result);
+  return IsOpen();
+}
+
+void UDPSocket::Close() {
+  if (IsOpen()) {
+    closesocket(static_cast<SOCKET>(socket_));
+    socket_ = INVALID_SOCKET;
+  }
+}
+
+bool UDPSocket::IsOpen() const {
+  return socket_ != INVALID_SOCKET;
+}
+
+bool UDPSocket::Send(const char *data, std::size_t size) {
+  if (!IsOpen()) {
+    return false;
+  }
+  return send(static_cast<SOCKET>(socket_),
+              data,
+              static_cast<int>(size),
+              0) == static_cast<int>(size);
+}
@@ -0,0 +1,55 @@
+// Copyright (c) 2026 Zeex
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef UDPSOCKET_H
+#define UDPSOCKET_H
+
+#include <cstddef>
+#include <string>
+
+// A non-blocking UDP socket that sends datagrams to a single address.
+class UDPSocket {
+ public:
+  UDPSocket();
+  ~UDPSocket();
+
+  UDPSocket(const UDPSocket &) = delete;
+  UDPSocket &operator=(const UDPSocket &) = delete;
+
+  // Resolves host and prepares the socket for sending to host:port.
+  bool Open(const std::string &host, const std::string &port);
+  void Close();
+
+  bool IsOpen() const;
+
+  // Sends a single datagram. Never waits: returns false if the datagram
+  // couldn't be sent right away.
+  bool Send(const char *data, std::size_t size);
+
+ private:
+  // SOCKET on Windows, a file descriptor everywhere else.
+  std::size_t socket_;
+};
+
+#endif // !UDPSOCKET_H
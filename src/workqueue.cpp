@@ -0,0 +1,103 @@
+// Copyright (c) 2026 Zeex
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <algorithm>
+#include <utility>
+#include "threadpolicy.h"
+#include "workqueue.h"
+
+namespace {
+
+// Jobs are mostly bound by disk I/O and memory bandwidth, so more threads
+// than this don't help much.
+const unsigned int kMaxThreads = 8;
+
+} // anonymous namespace
+
+WorkQueue::WorkQueue()
+  : stopping_(false)
+{
+}
+
+WorkQueue::~WorkQueue() {
+  Stop();
+}
+
+std::future<void> WorkQueue::Submit(std::function<void()> job) {
+  std::packaged_task<void()> task(std::move(job));
+  std::future<void> result = task.get_future();
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (threads_.empty()) {
+      unsigned int num_threads =
+        std::min(std::max(std::thread::hardware_concurrency(), 1u),
+                 kMaxThreads);
+      stopping_ = false;
+      for (unsigned int i = 0; i < num_threads; i++) {
+        threads_.push_back(std::thread(&WorkQueue::Run, this));
+      }
+    }
+    jobs_.push_back(std::move(task));
+  }
+  job_added_.notify_one();
+  return result;
+}
+
+void WorkQueue::Stop() {
+  std::vector<std::thread> threads;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+    threads.swap(threads_);
+  }
+  job_added_.notify_all();
+  for (std::size_t i = 0; i < threads.size(); i++) {
+    threads[i].join();
+  }
+}
+
+void WorkQueue::Run() {
+  ApplyThreadPolicy(THREAD_CLASS_WORKER);
+  for (;;) {
+    std::packaged_task<void()> task;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      job_added_.wait(lock, [this]() {
+        return stopping_ || !jobs_.empty();
+      });
+      if (jobs_.empty()) {
+        return;
+      }
+      task = std::move(jobs_.front());
+      jobs_.pop_front();
+    }
+    task();
+  }
+}
+
+// static
+WorkQueue &WorkQueue::shared() {
+  static WorkQueue instance;
+  return instance;
+}
@@ -0,0 +1,191 @@
+# Runs the benchmark scripts from bench.list under plugin-runner, first
+# without crashdetect and then with crashdetect in each of the modes below,
+# and reports how many times slower every mode is. This is what the
+# crashdetect-bench-scripts target runs:
+#
+#   cmake -DPLUGIN_RUNNER=<plugin-runner> -DPLUGIN=<crashdetect.so>
+#         -DSCRIPT_DIR=<dir> -DSCRIPTS=<name,name,...>
+#         [-DREPETITIONS=<n>] [-DOUTPUT_FILE=<results.json>]
+#         [-DBASELINE_FILE=<baseline.json> [-DTOLERANCE=<percent>]
+#          [-DUPDATE_BASELINE=ON]]
+#         -P RunBenchmarks.cmake
+#
+# Scripts print "ELAPSED: <ms>" when done. The best of REPETITIONS runs is
+# taken to filter out noise.
+#
+# With BASELINE_FILE, every ratio is compared with the one stored for the
+# same script and mode, and the run fails if it's more than TOLERANCE
+# percent (25 by default) worse. Scripts and modes that aren't in the
+# baseline are only reported. The run fails right away if BASELINE_FILE
+# doesn't exist, since there would be nothing to catch a regression with.
+# UPDATE_BASELINE=ON writes the results to BASELINE_FILE instead of
+# comparing against it.
+
+foreach(var PLUGIN_RUNNER PLUGIN SCRIPT_DIR SCRIPTS)
+  if(NOT ${var})
+    message(FATAL_ERROR "${var} is not set")
+  endif()
+endforeach()
+if(NOT REPETITIONS)
+  set(REPETITIONS 3)
+endif()
+if(NOT TOLERANCE)
+  set(TOLERANCE 25)
+endif()
+string(REPLACE "," ";" SCRIPTS "${SCRIPTS}")
+
+# Each mode is a server.cfg; "none" means running without the plugin.
+set(modes
+  default
+  sysreq_d_off
+  jit
+  trace
+  profiler
+)
+set(mode_default_config "")
+set(mode_sysreq_d_off_config "sysreq_d 0")
+set(mode_jit_config "jit 1")
+set(mode_trace_config "trace pfn;trace_mode counts")
+set(mode_profiler_config "profiler 1")
+
+get_filename_component(PLUGIN_RUNNER_DIR ${PLUGIN_RUNNER} DIRECTORY)
+if(WIN32)
+  set(ENV{Path} "${PLUGIN_RUNNER_DIR};$ENV{Path}")
+else()
+  set(ENV{PATH} "${PLUGIN_RUNNER_DIR}:$ENV{PATH}")
+endif()
+set(ENV{AMX_PATH} ${SCRIPT_DIR})
+
+# Runs a script REPETITIONS times and returns the best time in ms.
+function(run_script name work_dir result_var)
+  set(best "")
+  foreach(i RANGE 1 ${REPETITIONS})
+    execute_process(
+      COMMAND           ${PLUGIN_RUNNER} ${ARGN} ${SCRIPT_DIR}/${name}
+      WORKING_DIRECTORY ${work_dir}
+      OUTPUT_VARIABLE   output
+      ERROR_VARIABLE    output
+    )
+    string(REGEX MATCH "ELAPSED: ([0-9]+)" match "${output}")
+    if(NOT match)
+      message(FATAL_ERROR "${name} didn't print its time:\n${output}")
+    endif()
+    if(best STREQUAL "" OR CMAKE_MATCH_1 LESS best)
+      set(best ${CMAKE_MATCH_1})
+    endif()
+  endforeach()
+  set(${result_var} ${best} PARENT_SCOPE)
+endfunction()
+
+# Formats time / baseline_time with two decimal places.
+function(format_ratio time baseline_time result_var)
+  if(baseline_time EQUAL 0)
+    set(baseline_time 1)
+  endif()
+  math(EXPR ratio "${time} * 100 / ${baseline_time}")
+  math(EXPR whole "${ratio} / 100")
+  math(EXPR fraction "${ratio} % 100")
+  if(fraction LESS 10)
+    set(fraction "0${fraction}")
+  endif()
+  set(${result_var} "${whole}.${fraction}" PARENT_SCOPE)
+endfunction()
+
+# Appends a result to the "results" array of the JSON output.
+set(json_results "")
+function(add_json_result name mode time ratio)
+  if(json_results)
+    set(json_results "${json_results},")
+  endif()
+  set(entry "{\"script\": \"${name}\", \"mode\": \"${mode}\"")
+  set(entry "${entry}, \"ms\": ${time}, \"ratio\": ${ratio}}")
+  set(json_results "${json_results}\n    ${entry}" PARENT_SCOPE)
+endfunction()
+
+# Turns a ratio formatted by format_ratio() into hundredths.
+function(parse_ratio ratio result_var)
+  string(REGEX REPLACE "^([0-9]+)\\.([0-9][0-9])$" "\\1\\2" value ${ratio})
+  # Leading zeros could be read as octal.
+  string(REGEX REPLACE "^0+([0-9])" "\\1" value ${value})
+  set(${result_var} ${value} PARENT_SCOPE)
+endfunction()
+
+# Finds the ratio stored in the baseline for a script and mode. Sets the
+# result to an empty string if there isn't one.
+function(get_baseline_ratio name mode result_var)
+  set(pattern "\"script\": \"${name}\", \"mode\": \"${mode}\"")
+  set(pattern "${pattern}, \"ms\": [0-9]+")
+  set(pattern "${pattern}, \"ratio\": ([0-9]+\\.[0-9][0-9])")
+  string(REGEX MATCH "${pattern}" match "${baseline}")
+  if(match)
+    set(${result_var} ${CMAKE_MATCH_1} PARENT_SCOPE)
+  else()
+    set(${result_var} "" PARENT_SCOPE)
+  endif()
+endfunction()
+
+set(baseline "")
+if(BASELINE_FILE AND NOT UPDATE_BASELINE)
+  if(NOT EXISTS ${BASELINE_FILE})
+    message(FATAL_ERROR "${BASELINE_FILE} doesn't exist, build the "
+                        "crashdetect-bench-baseline target to create it")
+  endif()
+  file(READ ${BASELINE_FILE} baseline)
+endif()
+set(regressions "")
+
+set(work_root ${CMAKE_CURRENT_BINARY_DIR}/bench)
+file(MAKE_DIRECTORY ${work_root}/none)
+foreach(mode ${modes})
+  file(MAKE_DIRECTORY ${work_root}/${mode})
+  string(REPLACE ";" "\n" config "${mode_${mode}_config}")
+  file(WRITE ${work_root}/${mode}/server.cfg "${config}\n")
+endforeach()
+
+foreach(name ${SCRIPTS})
+  run_script(${name} ${work_root}/none plain_time)
+  message(STATUS "${name}: ${plain_time} ms without crashdetect")
+  add_json_result(${name} none ${plain_time} 1.00)
+
+  foreach(mode ${modes})
+    run_script(${name} ${work_root}/${mode} time ${PLUGIN})
+    format_ratio(${time} ${plain_time} ratio)
+    set(status "${name}: ${time} ms with crashdetect (${mode}), x${ratio}")
+
+    get_baseline_ratio(${name} ${mode} baseline_ratio)
+    if(NOT baseline_ratio STREQUAL "")
+      parse_ratio(${ratio} value)
+      parse_ratio(${baseline_ratio} baseline_value)
+      math(EXPR limit "${baseline_value} * (100 + ${TOLERANCE}) / 100")
+      set(status "${status}, baseline x${baseline_ratio}")
+      if(value GREATER limit)
+        set(status "${status} - REGRESSION")
+        list(APPEND regressions "${name} (${mode})")
+      endif()
+    endif()
+
+    message(STATUS "${status}")
+    add_json_result(${name} ${mode} ${time} ${ratio})
+  endforeach()
+endforeach()
+
+set(json "{
+  \"repetitions\": ${REPETITIONS},
+  \"results\": [${json_results}
+  ]
+}
+")
+if(OUTPUT_FILE)
+  file(WRITE ${OUTPUT_FILE} "${json}")
+  message(STATUS "Results written to ${OUTPUT_FILE}")
+endif()
+if(BASELINE_FILE AND UPDATE_BASELINE)
+  file(WRITE ${BASELINE_FILE} "${json}")
+  message(STATUS "Baseline written to ${BASELINE_FILE}")
+endif()
+
+if(regressions)
+  string(REPLACE ";" ", " regressions "${regressions}")
+  message(FATAL_ERROR "Overhead is more than ${TOLERANCE}% worse than the "
+                      "baseline: ${regressions}")
+endif()
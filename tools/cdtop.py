@@ -0,0 +1,269 @@
+#!/usr/bin/env python
+#
+# Copyright (c) 2026 Zeex
+# All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions are met:
+#
+# 1. Redistributions of source code must retain the above copyright notice,
+#    this list of conditions and the following disclaimer.
+# 2. Redistributions in binary form must reproduce the above copyright notice,
+#    this list of conditions and the following disclaimer in the documentation
+#    and/or other materials provided with the distribution.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+# AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+# IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+# ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+# LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+# CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+# SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+# INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+# CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+# ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+# POSSIBILITY OF SUCH DAMAGE.
+#
+# Shows the statistics that CrashDetect publishes with "stats_segment 1",
+# refreshed every few seconds, in the manner of top. The server is found
+# by its PID, or automatically if only one is running. Public and native
+# figures need callback_stats and native_stats to be on.
+#
+# The segment layout is described in src/statssegment.h.
+
+import argparse
+import glob
+import mmap
+import os
+import struct
+import sys
+import time
+
+STATS_MAGIC = b'CDST'
+STATS_VERSION = 1
+
+HEADER_FORMAT = '<4sIIIIIIIIIIIqQQQ32Q'
+SCRIPT_FORMAT = '<64sQ'
+PUBLIC_FORMAT = '<II32sQqqqq'
+NATIVE_FORMAT = '<II32s32sQq'
+SEQUENCE_OFFSET = 16
+
+ERROR_NAMES = {
+  1: 'exit',
+  2: 'assert',
+  3: 'stack/heap collision',
+  4: 'out of bounds',
+  5: 'invalid memory access',
+  6: 'invalid instruction',
+  7: 'stack underflow',
+  8: 'heap underflow',
+  9: 'invalid callback',
+  10: 'native failed',
+  11: 'divide by zero',
+  13: 'invalid state',
+  16: 'out of memory',
+  20: 'invalid index',
+  25: 'parameter error',
+  26: 'domain error',
+  27: 'general error',
+  28: 'address naught',
+}
+
+class Stats:
+  def __init__(self, data):
+    header = struct.unpack_from(HEADER_FORMAT, data, 0)
+    (magic, self.version, self.size, self.pid, sequence, num_scripts,
+     num_publics, num_natives, scripts_offset, publics_offset,
+     natives_offset, _, self.update_time, self.long_calls,
+     self.dropped_log_lines, self.log_queued_bytes) = header[:16]
+    self.errors = header[16:]
+
+    self.scripts = []
+    script_size = struct.calcsize(SCRIPT_FORMAT)
+    for i in range(num_scripts):
+      name, errors = struct.unpack_from(SCRIPT_FORMAT, data,
+                                        scripts_offset + i * script_size)
+      self.scripts.append((decode_name(name), errors))
+
+    self.publics = []
+    public_size = struct.calcsize(PUBLIC_FORMAT)
+    for i in range(num_publics):
+      script, _, name, calls, total, p50, p99, max_time = struct.unpack_from(
+        PUBLIC_FORMAT, data, publics_offset + i * public_size)
+      self.publics.append({
+        'script': self.script_name(script),
+        'name': decode_name(name),
+        'calls': calls,
+        'total': total,
+        'p50': p50,
+        'p99': p99,
+        'max': max_time,
+      })
+
+    self.natives = []
+    native_size = struct.calcsize(NATIVE_FORMAT)
+    for i in range(num_natives):
+      script, _, name, module, calls, total = struct.unpack_from(
+        NATIVE_FORMAT, data, natives_offset + i * native_size)
+      self.natives.append({
+        'script': self.script_name(script),
+        'name': decode_name(name),
+        'module': decode_name(module) or '?',
+        'calls': calls,
+        'total': total,
+      })
+
+  def script_name(self, index):
+    if index < len(self.scripts):
+      return self.scripts[index][0]
+    return '?'
+
+def decode_name(name):
+  return name.split(b'\0', 1)[0].decode('utf-8', 'replace')
+
+def find_servers():
+  pids = []
+  for path in glob.glob('/dev/shm/crashdetect-*'):
+    suffix = path.rsplit('-', 1)[1]
+    if suffix.isdigit():
+      pids.append(int(suffix))
+  return sorted(pids)
+
+def open_segment(pid):
+  name = 'crashdetect-%d' % pid
+  header_size = struct.calcsize(HEADER_FORMAT)
+  if os.name == 'nt':
+    # The mapping has to exist already, otherwise this would create a new
+    # one filled with zeros, which is caught by the magic check.
+    view = mmap.mmap(-1, header_size, tagname='Local\\' + name,
+                     access=mmap.ACCESS_READ)
+    size = struct.unpack_from('<I', view, 8)[0]
+    view.close()
+    if size < header_size:
+      return None
+    return mmap.mmap(-1, size, tagname='Local\\' + name,
+                     access=mmap.ACCESS_READ)
+  with open('/dev/shm/' + name, 'rb') as file:
+    return mmap.mmap(file.fileno(), 0, access=mmap.ACCESS_READ)
+
+def read_stats(view):
+  # The server may be in the middle of an update: copy everything and try
+  # again if the sequence number was odd or changed meanwhile.
+  for _ in range(100):
+    sequence = struct.unpack_from('<I', view, SEQUENCE_OFFSET)[0]
+    if sequence % 2 == 0:
+      data = view[:]
+      if struct.unpack_from('<I', view, SEQUENCE_OFFSET)[0] == sequence:
+        if data[:4] != STATS_MAGIC:
+          raise ValueError('not a CrashDetect statistics segment')
+        version = struct.unpack_from('<I', data, 4)[0]
+        if version != STATS_VERSION:
+          raise ValueError('unsupported segment version %d' % version)
+        return Stats(data)
+    time.sleep(0.001)
+  return None
+
+def format_time(us):
+  if us >= 1000000:
+    return '%.2fs' % (us / 1000000.0)
+  if us >= 1000:
+    return '%.2fms' % (us / 1000.0)
+  return '%dus' % us
+
+def print_stats(stats, args, out):
+  update_time = time.strftime('%H:%M:%S',
+                              time.localtime(stats.update_time / 1000.0))
+  total_errors = sum(stats.errors)
+  out.write('crashdetect - pid %d, updated %s\n' % (stats.pid, update_time))
+  out.write('Errors: %d, long calls: %d, dropped log lines: %d, '
+            'queued log bytes: %d\n' % (total_errors, stats.long_calls,
+                                        stats.dropped_log_lines,
+                                        stats.log_queued_bytes))
+  errors = ['%s: %d' % (ERROR_NAMES.get(code, 'error %d' % code), count)
+            for code, count in enumerate(stats.errors) if count != 0]
+  if errors:
+    out.write('  ' + ', '.join(errors) + '\n')
+
+  out.write('\n%-20s %-32s %10s %10s %10s %10s %10s\n' % (
+    'SCRIPT', 'PUBLIC', 'CALLS', 'TOTAL', 'P50', 'P99', 'MAX'))
+  publics = sorted(stats.publics, key=lambda p: p[args.sort], reverse=True)
+  for public in publics[:args.lines]:
+    out.write('%-20s %-32s %10d %10s %10s %10s %10s\n' % (
+      public['script'][:20], public['name'], public['calls'],
+      format_time(public['total']), format_time(public['p50']),
+      format_time(public['p99']), format_time(public['max'])))
+  if not stats.publics:
+    out.write('(none, is callback_stats on?)\n')
+
+  out.write('\n%-20s %-32s %-20s %10s %10s\n' % (
+    'SCRIPT', 'NATIVE', 'MODULE', 'CALLS', 'TIME'))
+  native_sort = args.sort if args.sort == 'calls' else 'total'
+  natives = sorted(stats.natives, key=lambda n: n[native_sort], reverse=True)
+  for native in natives[:args.lines]:
+    out.write('%-20s %-32s %-20s %10d %10s\n' % (
+      native['script'][:20], native['name'], native['module'][:20],
+      native['calls'], format_time(native['total'])))
+  if not stats.natives:
+    out.write('(none, is native_stats on?)\n')
+
+  out.write('\n%-64s %10s\n' % ('SCRIPT', 'ERRORS'))
+  for name, errors in stats.scripts:
+    out.write('%-64s %10d\n' % (name, errors))
+
+def main(argv):
+  arg_parser = argparse.ArgumentParser()
+  arg_parser.add_argument('pid', type=int, nargs='?',
+                          help='PID of the server (can be omitted if only '
+                               'one is running)')
+  arg_parser.add_argument('-d', '--delay', type=float, default=2,
+                          help='seconds between refreshes')
+  arg_parser.add_argument('-n', '--lines', type=int, default=15,
+                          help='how many publics and natives to show')
+  arg_parser.add_argument('-s', '--sort', default='total',
+                          choices=['total', 'calls', 'p50', 'p99', 'max'],
+                          help='what to sort publics by')
+  arg_parser.add_argument('-1', '--once', action='store_true', default=False,
+                          help='print once and exit')
+  args = arg_parser.parse_args(argv[1:])
+
+  pid = args.pid
+  if pid is None:
+    pids = find_servers()
+    if len(pids) != 1:
+      if pids:
+        sys.stderr.write('Several servers are running, pick one of: %s\n' %
+                         ', '.join(str(p) for p in pids))
+      else:
+        sys.stderr.write('No statistics found, is stats_segment on?\n')
+      sys.exit(1)
+    pid = pids[0]
+
+  try:
+    view = open_segment(pid)
+  except (OSError, IOError) as e:
+    sys.stderr.write('Could not open the segment of %d: %s\n' % (pid, e))
+    sys.exit(1)
+  if view is None:
+    sys.stderr.write('No statistics found for %d\n' % pid)
+    sys.exit(1)
+
+  try:
+    while True:
+      stats = read_stats(view)
+      if stats is not None:
+        if not args.once:
+          # Clear the screen and move to the top.
+          sys.stdout.write('\x1b[H\x1b[2J')
+        print_stats(stats, args, sys.stdout)
+        sys.stdout.flush()
+      if args.once:
+        break
+      time.sleep(args.delay)
+  except KeyboardInterrupt:
+    pass
+  except ValueError as e:
+    sys.stderr.write('%s\n' % e)
+    sys.exit(1)
+
+if __name__ == '__main__':
+  main(sys.argv)
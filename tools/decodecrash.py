@@ -0,0 +1,293 @@
+#!/usr/bin/env python
+#
+# Copyright (c) 2026 Zeex
+# All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions are met:
+#
+# 1. Redistributions of source code must retain the above copyright notice,
+#    this list of conditions and the following disclaimer.
+# 2. Redistributions in binary form must reproduce the above copyright notice,
+#    this list of conditions and the following disclaimer in the documentation
+#    and/or other materials provided with the distribution.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+# AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+# IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+# ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+# LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+# CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+# SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+# INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+# CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+# ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+# POSSIBILITY OF SUCH DAMAGE.
+#
+# Decodes crash dumps written by CrashDetect with "crash_dump <dir>" and
+# prints the registers, the native backtrace, the loaded modules, the native
+# stack and the AMX call stack. Script functions and source locations are
+# looked up in the .amx files of the scripts involved in the crash, which
+# must be the same files that were running at the time (this is checked
+# using the AMX headers stored in the dump).
+#
+# The file format is described in src/crashdump.cpp.
+
+import argparse
+import datetime
+import os
+import struct
+import sys
+
+from decodetrace import AMX_HEADER_FORMAT, Script, find_script
+
+DUMP_MAGIC = b'CDCD'
+DUMP_VERSIONS = (1,)
+
+SECTION_REGISTERS = 0x01
+SECTION_NATIVE_BACKTRACE = 0x02
+SECTION_NATIVE_STACK = 0x03
+SECTION_MODULES = 0x04
+SECTION_SCRIPT = 0x05
+SECTION_CALL_STACK = 0x06
+
+REGISTER_NAMES = ('eax', 'ebx', 'ecx', 'edx', 'esi', 'edi', 'ebp', 'esp',
+                  'eip', 'eflags')
+
+# Walking a corrupted frame chain could go on forever.
+MAX_FRAMES = 1000
+
+class Module:
+  def __init__(self, base, size, path):
+    self.base = base
+    self.size = size
+    self.path = path
+    self.name = os.path.basename(path.replace('\\', '/'))
+
+class Region:
+  def __init__(self, start, data):
+    self.start = start
+    self.data = data
+
+  def read_cell(self, address):
+    offset = address - self.start
+    if offset < 0 or offset + 4 > len(self.data):
+      return None
+    return struct.unpack_from('<i', self.data, offset)[0]
+
+class DumpedScript:
+  def __init__(self, script_id, path, header, registers, heap, stack):
+    self.script_id = script_id
+    self.path = path
+    self.header = header
+    self.cip, self.frm, self.stk, self.hea, self.hlw, self.stp = registers
+    self.heap = heap
+    self.stack = stack
+    self.script = None
+
+class Call:
+  def __init__(self, is_public, script_id, index, frm, cip):
+    self.is_public = is_public
+    self.script_id = script_id
+    self.index = index
+    self.frm = frm
+    self.cip = cip
+
+class DumpReader:
+  def __init__(self, file):
+    data = file.read()
+    if data[:4] != DUMP_MAGIC:
+      raise ValueError('Not a crash dump')
+    self.version, self.cell_size = struct.unpack_from('<BB', data, 4)
+    if self.version not in DUMP_VERSIONS:
+      raise ValueError('Unsupported dump version: %d' % self.version)
+    self.time, = struct.unpack_from('<q', data, 6)
+    self.registers = {}
+    self.backtrace = []
+    self.stack = None
+    self.modules = []
+    self.scripts = {}
+    self.calls = []
+    offset = 14
+    while offset + 8 <= len(data):
+      section_type, size = struct.unpack_from('<II', data, offset)
+      offset += 8
+      self._read_section(section_type, data[offset:offset + size])
+      offset += size
+
+  def _read_section(self, section_type, data):
+    if section_type == SECTION_REGISTERS:
+      values = struct.unpack_from('<10I', data, 0)
+      self.registers = dict(zip(REGISTER_NAMES, values))
+    elif section_type == SECTION_NATIVE_BACKTRACE:
+      count, = struct.unpack_from('<I', data, 0)
+      self.backtrace = list(struct.unpack_from('<%dI' % count, data, 4))
+    elif section_type == SECTION_NATIVE_STACK:
+      start, = struct.unpack_from('<I', data, 0)
+      self.stack = Region(start, data[4:])
+    elif section_type == SECTION_MODULES:
+      count, = struct.unpack_from('<I', data, 0)
+      offset = 4
+      for _ in range(count):
+        base, size, length = struct.unpack_from('<IIH', data, offset)
+        offset += 10
+        path = data[offset:offset + length].decode('latin-1')
+        offset += length
+        self.modules.append(Module(base, size, path))
+    elif section_type == SECTION_SCRIPT:
+      script_id, length = struct.unpack_from('<IH', data, 0)
+      offset = 6
+      path = data[offset:offset + length].decode('latin-1')
+      offset += length
+      header_size, = struct.unpack_from('<I', data, offset)
+      offset += 4
+      header = data[offset:offset + header_size]
+      offset += header_size
+      registers = struct.unpack_from('<6i', data, offset)
+      offset += 24
+      heap_size, = struct.unpack_from('<I', data, offset)
+      heap = Region(registers[4], data[offset + 4:offset + 4 + heap_size])
+      offset += 4 + heap_size
+      stack_size, = struct.unpack_from('<I', data, offset)
+      stack = Region(registers[2], data[offset + 4:offset + 4 + stack_size])
+      self.scripts[script_id] = DumpedScript(script_id, path, header,
+                                             registers, heap, stack)
+    elif section_type == SECTION_CALL_STACK:
+      count, = struct.unpack_from('<I', data, 0)
+      for i in range(count):
+        self.calls.append(Call(*struct.unpack_from('<BIiii', data,
+                                                   4 + i * 17)))
+
+  def find_module(self, address):
+    for module in self.modules:
+      if module.base <= address < module.base + module.size:
+        return module
+    return None
+
+  def format_address(self, address):
+    module = self.find_module(address)
+    if module is None:
+      return '%08x' % address
+    return '%08x in %s+%x' % (address, module.name, address - module.base)
+
+def load_script(dumped_script, search_dirs):
+  filename = find_script(dumped_script.path, search_dirs) \
+    if dumped_script.path else None
+  if filename is None:
+    sys.stderr.write('Could not find script %s\n' %
+                     (dumped_script.path or dumped_script.script_id))
+    return None
+  with open(filename, 'rb') as file:
+    data = file.read()
+  header_size = struct.calcsize(AMX_HEADER_FORMAT)
+  if data[:header_size] != dumped_script.header[:header_size]:
+    sys.stderr.write('Warning: %s differs from the crashed script\n' %
+                     filename)
+  return Script(dumped_script.path, data)
+
+def find_function(script, address):
+  for function in script.functions:
+    if function.codestart <= address < function.codeend:
+      return function
+  return None
+
+def format_location(script, cip):
+  if script is None:
+    return '%08x' % cip
+  function = find_function(script, cip)
+  name = function.name if function is not None else '??'
+  return '%08x in %s () at %s' % (cip, name, script.get_location(cip))
+
+def format_call(reader, call):
+  dumped_script = reader.scripts.get(call.script_id)
+  script = dumped_script.script if dumped_script is not None else None
+  if dumped_script is None:
+    script_name = '?'
+  else:
+    script_name = os.path.basename(dumped_script.path) or \
+      '#%d' % call.script_id
+  if call.is_public:
+    name = 'main' if call.index == -1 else None
+    if script is not None:
+      publics = list(script.publics.values())
+      if 0 <= call.index < len(publics):
+        name = publics[call.index]
+    return 'public %s (%s)' % (name or '#%d' % call.index, script_name)
+  name = None
+  if script is not None and 0 <= call.index < len(script.natives):
+    name = script.natives[call.index]
+  return 'native %s (%s)' % (name or '#%d' % call.index, script_name)
+
+def print_amx_frames(dumped_script, frm, cip):
+  # Each frame starts with the previous frame address followed by the
+  # return address.
+  script = dumped_script.script
+  for _ in range(MAX_FRAMES):
+    print('    %s' % format_location(script, cip))
+    prev_frm = dumped_script.stack.read_cell(frm)
+    ret = dumped_script.stack.read_cell(frm + 4)
+    if prev_frm is None or ret is None or ret <= 0:
+      break
+    frm, cip = prev_frm, ret
+
+def main(argv):
+  arg_parser = argparse.ArgumentParser()
+  arg_parser.add_argument('file', help='crash dump file')
+  arg_parser.add_argument('-s', '--search-path', action='append',
+                          default=[], help='add a directory to look for '
+                                           'scripts in')
+  arg_parser.add_argument('-n', '--no-names', action='store_true',
+                          default=False, help='don\'t load scripts')
+  arg_parser.add_argument('-w', '--stack-words', type=int, default=64,
+                          help='number of native stack words to print')
+  args = arg_parser.parse_args(argv[1:])
+
+  with open(args.file, 'rb') as file:
+    reader = DumpReader(file)
+
+  if not args.no_names:
+    for dumped_script in reader.scripts.values():
+      dumped_script.script = load_script(dumped_script, args.search_path)
+
+  print('Crash at %s' % datetime.datetime.fromtimestamp(reader.time))
+
+  print('\nRegisters:')
+  for name in REGISTER_NAMES:
+    if name in reader.registers:
+      print('  %-6s %08x' % (name.upper(), reader.registers[name]))
+
+  print('\nAMX backtrace:')
+  # The call that was running when the server crashed has its frame in the
+  # AMX itself, the others remember where they were entered from.
+  seen_scripts = set()
+  for i, call in enumerate(reader.calls):
+    print('  #%d %s' % (i, format_call(reader, call)))
+    if call.is_public and call.script_id not in seen_scripts:
+      dumped_script = reader.scripts.get(call.script_id)
+      if dumped_script is not None:
+        seen_scripts.add(call.script_id)
+        print_amx_frames(dumped_script, dumped_script.frm, dumped_script.cip)
+
+  print('\nNative backtrace:')
+  for i, address in enumerate(reader.backtrace):
+    print('  #%d %s' % (i, reader.format_address(address)))
+
+  if reader.stack is not None:
+    print('\nNative stack:')
+    for i in range(args.stack_words):
+      address = reader.stack.start + i * 4
+      value = reader.stack.read_cell(address)
+      if value is None:
+        break
+      value &= 0xffffffff
+      module = reader.find_module(value)
+      comment = ' (%s)' % reader.format_address(value) if module else ''
+      print('  %08x: %08x%s' % (address, value, comment))
+
+  print('\nLoaded modules:')
+  for module in reader.modules:
+    print('  %08x - %08x %s' % (module.base, module.base + module.size,
+                                module.path))
+
+if __name__ == '__main__':
+  main(sys.argv)
@@ -0,0 +1,197 @@
+#!/usr/bin/env python
+#
+# Copyright (c) 2026 Zeex
+# All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions are met:
+#
+# 1. Redistributions of source code must retain the above copyright notice,
+#    this list of conditions and the following disclaimer.
+# 2. Redistributions in binary form must reproduce the above copyright notice,
+#    this list of conditions and the following disclaimer in the documentation
+#    and/or other materials provided with the distribution.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+# AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+# IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+# ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+# LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+# CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+# SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+# INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+# CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+# ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+# POSSIBILITY OF SUCH DAMAGE.
+#
+# Prints the contents of the file written by CrashDetect when both
+# "flight_recorder" and "flight_recorder_file" are set: the last calls and
+# returns of publics and natives before the server stopped, however it
+# stopped. Names are looked up in the .amx files whose paths are stored in
+# the file, so they must be the same files that were running at the time.
+#
+# The file format is described in src/flightrecorder.cpp.
+
+import argparse
+import os
+import struct
+import sys
+
+FLIGHT_MAGIC = b'CDFR'
+FLIGHT_VERSIONS = (1,)
+
+HEADER_FORMAT = '<4sIIIIIII'
+SCRIPT_FORMAT = '<Q248s'
+
+AMX_HEADER_FORMAT = '<iHbbhhiiiiiiiiiii'
+AMX_EXEC_MAIN = -1
+
+ACTIONS = (
+  'call public',
+  'return from public',
+  'call native',
+  'return from native',
+)
+
+TIME_MASK = 0x3fffffff
+
+def read_cstring(data, offset):
+  end = data.index(b'\0', offset)
+  return data[offset:end].decode('latin-1'), end + 1
+
+class Script:
+  def __init__(self, path, data):
+    self.path = path
+    self.name = os.path.basename(path)
+    fields = struct.unpack_from(AMX_HEADER_FORMAT, data, 0)
+    defsize = fields[5]
+    publics, natives, libraries = fields[11], fields[12], fields[13]
+
+    def read_names(start, end):
+      names = []
+      for offset in range(start, end, defsize):
+        if defsize == 8:
+          nameofs, = struct.unpack_from('<I', data, offset + 4)
+          name, _ = read_cstring(data, nameofs)
+        else:
+          name, _ = read_cstring(data, offset + 4)
+        names.append(name)
+      return names
+
+    self.publics = read_names(publics, natives)
+    self.natives = read_names(natives, libraries)
+
+  def get_name(self, type, index):
+    if type >= 2:
+      names = self.natives
+    elif index == AMX_EXEC_MAIN:
+      return 'main'
+    else:
+      names = self.publics
+    if 0 <= index < len(names):
+      return names[index]
+    return None
+
+class FlightReader:
+  def __init__(self, data):
+    if len(data) < struct.calcsize(HEADER_FORMAT):
+      raise ValueError('File is too short')
+    (magic, version, self.capacity, event_size, pointer_size, max_scripts,
+     self.next, _) = struct.unpack_from(HEADER_FORMAT, data, 0)
+    if magic != FLIGHT_MAGIC:
+      raise ValueError('Not a flight recorder file')
+    if version not in FLIGHT_VERSIONS:
+      raise ValueError('Unsupported version: %d' % version)
+
+    offset = struct.calcsize(HEADER_FORMAT)
+    self.script_paths = {}
+    for _ in range(max_scripts):
+      amx, path = struct.unpack_from(SCRIPT_FORMAT, data, offset)
+      if amx != 0:
+        self.script_paths[amx] = path.split(b'\0', 1)[0].decode('latin-1')
+      offset += struct.calcsize(SCRIPT_FORMAT)
+
+    self._event_format = '<%sII' % ('I' if pointer_size == 4 else 'Q')
+    self._event_size = event_size
+    self._events_offset = offset
+    if offset + self.capacity * event_size > len(data):
+      raise ValueError('File is truncated')
+    self._data = data
+
+  def num_events(self):
+    return min(self.next, self.capacity)
+
+  # Returns (amx, type, index, time) of the age-th newest event.
+  def get_event(self, age):
+    position = (self.next - 1 - age) & (self.capacity - 1)
+    amx, index, time_and_type = struct.unpack_from(
+      self._event_format, self._data,
+      self._events_offset + position * self._event_size)
+    if index & 0x80000000:
+      index -= 0x100000000
+    return amx, time_and_type & 3, index, time_and_type >> 2
+
+def find_script(path, search_dirs):
+  candidates = [path]
+  for directory in search_dirs:
+    candidates.append(os.path.join(directory, os.path.basename(path)))
+  for candidate in candidates:
+    if os.path.isfile(candidate):
+      return candidate
+  return None
+
+def load_script(path, search_dirs):
+  filename = find_script(path, search_dirs)
+  if filename is None:
+    sys.stderr.write('Could not find script %s\n' % path)
+    return None
+  with open(filename, 'rb') as file:
+    return Script(path, file.read())
+
+def main(argv):
+  arg_parser = argparse.ArgumentParser()
+  arg_parser.add_argument('-f', '--file', default='crashdetect_flight.bin',
+                          help='set input file')
+  arg_parser.add_argument('-s', '--search-path', action='append',
+                          default=[], help='add a directory to look for '
+                                           'scripts in')
+  arg_parser.add_argument('-n', '--events', type=int, default=0,
+                          help='print only this many of the newest events')
+  args = arg_parser.parse_args(argv[1:])
+
+  with open(args.file, 'rb') as file:
+    try:
+      reader = FlightReader(file.read())
+    except ValueError as e:
+      sys.stderr.write('%s: %s\n' % (args.file, e))
+      return 1
+
+  num_events = reader.num_events()
+  if args.events > 0:
+    num_events = min(num_events, args.events)
+  if num_events == 0:
+    return 0
+
+  scripts = {}
+  newest_time = reader.get_event(0)[3]
+  print('Last %d calls and returns:' % num_events)
+  for age in range(num_events - 1, -1, -1):
+    amx, type, index, time = reader.get_event(age)
+    if amx not in scripts:
+      path = reader.script_paths.get(amx)
+      scripts[amx] = load_script(path, args.search_path) if path else None
+    script = scripts[amx]
+    name = script.get_name(type, index) if script is not None else None
+    if script is not None:
+      script_name = script.name
+    elif amx in reader.script_paths:
+      script_name = os.path.basename(reader.script_paths[amx])
+    else:
+      script_name = '<unknown>'
+    time_ago = (newest_time - time) & TIME_MASK
+    print('%10.3f ms ago %s %s (%s)' % (time_ago / 1000.0, ACTIONS[type],
+                                        name or '<unknown>', script_name))
+  return 0
+
+if __name__ == '__main__':
+  sys.exit(main(sys.argv))
@@ -0,0 +1,564 @@
+#!/usr/bin/env python
+#
+# Copyright (c) 2026 Zeex
+# All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions are met:
+#
+# 1. Redistributions of source code must retain the above copyright notice,
+#    this list of conditions and the following disclaimer.
+# 2. Redistributions in binary form must reproduce the above copyright notice,
+#    this list of conditions and the following disclaimer in the documentation
+#    and/or other materials provided with the distribution.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+# AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+# IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+# ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+# LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+# CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+# SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+# INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+# CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+# ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+# POSSIBILITY OF SUCH DAMAGE.
+#
+# Decodes trace files written by CrashDetect with "trace_output binary" and
+# prints them in the same format as the text trace. Names of functions and
+# their arguments are looked up in the .amx files of the traced scripts,
+# which must be the same files that were running at the time (this is
+# checked using the hashes stored in the trace file).
+#
+# The file format is described in src/tracewriter.cpp.
+#
+# Natives are printed with raw argument values unless their declarations
+# are given with -i, either as include files, a list generated with
+# "wrap_natives.py --signatures" or a table made with "wrap_natives.py
+# --table". Strings and references copied at the time of the call (trace
+# files of version 3 and later) are printed next to their addresses.
+
+import argparse
+import datetime
+import os
+import re
+import struct
+import sys
+
+TRACE_MAGIC = b'CDTR'
+TRACE_VERSIONS = (1, 2, 3)
+
+SCRIPT_ENTRY = 0x01
+RECORD_ENTRY = 0x02
+
+KIND_NATIVE = 0
+KIND_PUBLIC = 1
+KIND_FUNCTION = 2
+
+MAX_ARGS = 10
+MAX_STRING = 80
+UNPACKED_MAX = (1 << 24) - 1
+
+AMX_HEADER_FORMAT = '<iHbbhhiiiiiiiiiii'
+AMX_DBG_HEADER_FORMAT = '<IHbbHHHHHHH'
+AMX_DBG_MAGIC = 0xf1ef
+
+SYMBOL_FUNCTION = 9
+SYMBOL_VARIABLE = 1
+SYMBOL_REFERENCE = 2
+SYMBOL_LOCAL = 1
+
+def fnv1a(data):
+  h = 2166136261
+  for byte in bytearray(data):
+    h ^= byte
+    h = (h * 16777619) & 0xffffffff
+  return h
+
+def read_cstring(data, offset):
+  end = data.index(b'\0', offset)
+  return data[offset:end].decode('latin-1'), end + 1
+
+def to_signed(value):
+  value &= 0xffffffff
+  return value - 0x100000000 if value & 0x80000000 else value
+
+class Symbol:
+  def __init__(self, address, tag, codestart, codeend, ident, vclass, name,
+               dims):
+    self.address = address
+    self.tag = tag
+    self.codestart = codestart
+    self.codeend = codeend
+    self.ident = ident
+    self.vclass = vclass
+    self.name = name
+    self.dims = dims
+
+class Script:
+  def __init__(self, path, data):
+    self.path = path
+    self.name = os.path.basename(path)
+    self.natives = []
+    self.publics = {}
+    self.main = None
+    self.files = []
+    self.lines = []
+    self.functions = []
+    self.arguments = {}
+    self.tags = {}
+    self._parse_header(data)
+    self._parse_debug_info(data)
+
+  def _parse_header(self, data):
+    fields = struct.unpack_from(AMX_HEADER_FORMAT, data, 0)
+    (self._size, _, _, _, _, defsize, self._cod, self._dat, _, _, cip,
+     publics, natives, libraries, _, _, _) = fields
+    self.main = cip if cip >= 0 else None
+
+    def read_table(start, end):
+      entries = []
+      for offset in range(start, end, defsize):
+        address, nameofs = struct.unpack_from('<II', data, offset)
+        if defsize == 8:
+          name, _ = read_cstring(data, nameofs)
+        else:
+          name, _ = read_cstring(data, offset + 4)
+        entries.append((address, name))
+      return entries
+
+    for address, name in read_table(publics, natives):
+      self.publics[address] = name
+    self.natives = [name for _, name in read_table(natives, libraries)]
+
+  def _parse_debug_info(self, data):
+    offset = self._size
+    if offset + struct.calcsize(AMX_DBG_HEADER_FORMAT) > len(data):
+      return
+    (size, magic, _, _, _, num_files, num_lines, num_symbols, num_tags,
+     num_automata, num_states) = struct.unpack_from(AMX_DBG_HEADER_FORMAT,
+                                                    data, offset)
+    if magic != AMX_DBG_MAGIC:
+      return
+    dbg_start = offset
+    offset += struct.calcsize(AMX_DBG_HEADER_FORMAT)
+
+    for _ in range(num_files):
+      address, = struct.unpack_from('<I', data, offset)
+      name, offset = read_cstring(data, offset + 4)
+      self.files.append((address, name))
+
+    # Same workaround for overflow of the line count as in amxdbg.c.
+    lines_start = offset
+    offset += num_lines * 8
+    max_offset = (dbg_start + size - 19 * num_symbols - 3 * num_tags
+                  - 7 * num_automata - 5 * num_states)
+    code_size = self._dat - self._cod
+    while (offset < max_offset and offset + 0x10000 < max_offset
+           and struct.unpack_from('<I', data, offset)[0]
+               > struct.unpack_from('<I', data, offset - 8)[0]
+           and struct.unpack_from('<I', data, offset)[0] < code_size):
+      offset += 0x10000 * 8
+    for line_offset in range(lines_start, offset, 8):
+      self.lines.append(struct.unpack_from('<Ii', data, line_offset))
+    self.lines.sort(key=lambda line: line[0])
+
+    for _ in range(num_symbols):
+      (address, tag, codestart, codeend, ident, vclass,
+       dim) = struct.unpack_from('<IHIIbbH', data, offset)
+      name, offset = read_cstring(data, offset + 18)
+      dims = []
+      for _ in range(dim):
+        dims.append(struct.unpack_from('<HI', data, offset))
+        offset += 6
+      symbol = Symbol(to_signed(address), tag, codestart, codeend, ident,
+                      vclass, name, dims)
+      if ident == SYMBOL_FUNCTION and not name.startswith('@'):
+        self.functions.append(symbol)
+      elif vclass == SYMBOL_LOCAL:
+        self.arguments.setdefault(codestart, []).append(symbol)
+    for args in self.arguments.values():
+      args.sort(key=lambda arg: arg.address)
+
+    for _ in range(num_tags):
+      tag, = struct.unpack_from('<H', data, offset)
+      name, offset = read_cstring(data, offset + 2)
+      self.tags.setdefault(tag, name)
+
+  def get_function(self, address):
+    for function in self.functions:
+      if function.codestart == address:
+        return function
+    return None
+
+  def get_location(self, address):
+    filename = '<unknown file>'
+    for file_address, name in self.files:
+      if file_address <= address:
+        filename = name
+    line = -1
+    for line_address, number in self.lines:
+      if line_address > address:
+        break
+      line = number
+    return '%s:%d' % (filename, line + 1)
+
+  def get_tag_name(self, tag):
+    return self.tags.get(tag, '')
+
+class NativeParam:
+  def __init__(self, name, tag, is_reference, is_array):
+    self.name = name
+    self.tag = tag
+    self.is_reference = is_reference
+    self.is_array = is_array
+
+NATIVE_DECL_RE = re.compile(
+  r'native\s+(?:[A-Za-z_@][A-Za-z0-9_@]*:\s*)?'
+  r'([A-Za-z_@][A-Za-z0-9_@]*)\s*\((.*?)\)\s*;')
+
+def split_params(params):
+  parts = []
+  depth = 0
+  start = 0
+  for i, c in enumerate(params):
+    if c in '{[(':
+      depth += 1
+    elif c in '}])':
+      depth -= 1
+    elif c == ',' and depth == 0:
+      parts.append(params[start:i])
+      start = i + 1
+  parts.append(params[start:])
+  return [part.strip() for part in parts if part.strip()]
+
+def parse_native_params(params):
+  result = []
+  for param in split_params(params):
+    param = re.sub(r'^const\s+', '', param.split('=')[0].strip())
+    if param.endswith('...'):
+      break  # variable arguments are printed without names
+    is_reference = param.startswith('&')
+    param = param.lstrip('&').strip()
+    tag = ''
+    match = re.match(r'(\{.*?\}|[A-Za-z_@][A-Za-z0-9_@]*)\s*:\s*(.*)', param)
+    if match is not None:
+      tag, param = match.group(1), match.group(2)
+    is_array = '[' in param
+    name = param.split('[')[0].strip()
+    result.append(NativeParam(name, tag, is_reference, is_array))
+  return result
+
+NATIVE_TABLE_HEADER = '# CrashDetect native signatures'
+
+def parse_table_params(tokens):
+  result = []
+  for token in tokens:
+    if token == '...':
+      break
+    kind, _, rest = token.partition(':')
+    tag, _, name = rest.rpartition(':')
+    result.append(NativeParam(name, tag, kind == 'r', kind in ('a', 's')))
+  return result
+
+def load_natives(filenames):
+  natives = {}
+  for filename in filenames:
+    with open(filename, 'r') as file:
+      text = file.read()
+    if text.startswith(NATIVE_TABLE_HEADER):
+      for line in text.splitlines():
+        tokens = line.split()
+        if tokens and not tokens[0].startswith('#'):
+          natives[tokens[0]] = parse_table_params(tokens[1:])
+    else:
+      for match in NATIVE_DECL_RE.finditer(text):
+        natives[match.group(1)] = parse_native_params(match.group(2))
+  return natives
+
+class Record:
+  def __init__(self, kind, script_id, time, index, caller_address,
+               return_address, frame, num_args, args, retval, arg_data):
+    self.kind = kind
+    self.script_id = script_id
+    self.time = time
+    self.index = index
+    self.caller_address = caller_address
+    self.return_address = return_address
+    self.frame = frame
+    self.num_args = num_args
+    self.args = args
+    self.retval = retval
+    self.arg_data = arg_data  # lists of cells, empty if not copied
+
+class TraceReader:
+  def __init__(self, file):
+    self._data = file.read()
+    self._offset = 0
+    if self._data[:4] != TRACE_MAGIC:
+      raise ValueError('Not a CrashDetect trace file')
+    version, cell_size = struct.unpack_from('<BB', self._data, 4)
+    if version not in TRACE_VERSIONS or cell_size != 4:
+      raise ValueError('Unsupported trace file version')
+    self.version = version
+    self.start_time, = struct.unpack_from('<q', self._data, 6)
+    self._offset = 14
+    self.script_paths = {}
+    self.script_hashes = {}
+
+  def _read_byte(self):
+    byte = bytearray(self._data[self._offset:self._offset + 1])[0]
+    self._offset += 1
+    return byte
+
+  def _read_varint(self):
+    value = 0
+    shift = 0
+    while True:
+      byte = self._read_byte()
+      value |= (byte & 0x7f) << shift
+      shift += 7
+      if byte & 0x80 == 0:
+        return value
+
+  def _read_signed_varint(self):
+    value = self._read_varint()
+    return (value >> 1) ^ -(value & 1)
+
+  def records(self):
+    time = 0
+    while self._offset < len(self._data):
+      entry_type = self._read_byte()
+      if entry_type == SCRIPT_ENTRY:
+        script_id = self._read_varint()
+        length = self._read_varint()
+        path = self._data[self._offset:self._offset + length]
+        self._offset += length
+        self.script_paths[script_id] = path.decode('latin-1')
+        self.script_hashes[script_id], = struct.unpack_from(
+          '<I', self._data, self._offset)
+        self._offset += 4
+      elif entry_type == RECORD_ENTRY:
+        kind = self._read_byte()
+        script_id = self._read_varint()
+        time += self._read_varint()
+        index = self._read_signed_varint()
+        caller_address = self._read_varint()
+        return_address = self._read_varint()
+        frame = self._read_varint()
+        num_args = self._read_signed_varint()
+        args = [self._read_signed_varint()
+                for _ in range(max(0, min(num_args, MAX_ARGS)))]
+        retval = None
+        if kind == KIND_NATIVE and self.version >= 2:
+          retval = self._read_signed_varint()
+        arg_data = [[] for _ in args]
+        if self.version >= 3:
+          for data in arg_data:
+            for _ in range(self._read_varint()):
+              data.append(self._read_signed_varint())
+        yield Record(kind, script_id, time, index, caller_address,
+                     return_address, frame, num_args, args, retval, arg_data)
+      else:
+        raise ValueError('Bad entry type %d at offset %d' %
+                         (entry_type, self._offset - 1))
+
+def format_value(tag_name, value):
+  if tag_name == 'bool':
+    return 'true' if value else 'false'
+  if tag_name == 'Float':
+    return '%.5f' % struct.unpack('<f', struct.pack('<i', value))[0]
+  return '%d' % value
+
+def is_printable_char(c):
+  return 31 < c < 127
+
+# Same as PrintCapturedStringContents() in src/amxstacktrace.cpp.
+def format_captured_string(data):
+  packed = (data[0] & 0xffffffff) > UNPACKED_MAX
+  if packed:
+    chars = []
+    for c in data:
+      for shift in (24, 16, 8, 0):
+        chars.append((c >> shift) & 0xff)
+  else:
+    chars = [c for c in data]
+  text = ''
+  for c in chars[:MAX_STRING]:
+    if not is_printable_char(c):
+      return '%s"%s"' % (' !' if packed else ' ', text)
+    text += chr(c)
+  if len(chars) > MAX_STRING and not is_printable_char(chars[MAX_STRING]):
+    return '%s"%s"' % (' !' if packed else ' ', text)
+  return '%s"%s..."' % (' !' if packed else ' ', text)
+
+def format_captured_data(tag_name, is_reference, is_string, data):
+  if not data:
+    return ''
+  if is_reference:
+    return ' ' + format_value(tag_name, data[0])
+  if is_string:
+    return format_captured_string(data)
+  return ''
+
+def is_string_argument(script, arg):
+  return (len(arg.dims) == 1 and
+          script.get_tag_name(arg.tag) in ('', '_') and
+          script.get_tag_name(arg.dims[0][0]) in ('', '_'))
+
+def format_argument(script, arg, value, data):
+  text = ''
+  if arg.ident == SYMBOL_REFERENCE:
+    text += '&'
+  tag_name = script.get_tag_name(arg.tag)
+  if tag_name and tag_name != '_':
+    text += tag_name + ':'
+  text += arg.name
+  for dim_tag, dim_size in arg.dims:
+    if dim_size == 0:
+      text += '[]'
+    else:
+      dim_tag_name = script.get_tag_name(dim_tag)
+      if dim_tag_name != '_':
+        text += '[%s:%d]' % (dim_tag_name, dim_size)
+      else:
+        text += '[%d]' % dim_size
+  if arg.ident == SYMBOL_VARIABLE:
+    return text + '=' + format_value(tag_name, value)
+  text += '=@%08x' % (value & 0xffffffff)
+  return text + format_captured_data(tag_name,
+                                     arg.ident == SYMBOL_REFERENCE,
+                                     is_string_argument(script, arg), data)
+
+def format_more_arguments(num_more_args):
+  return '... <%d more %s>' % (num_more_args,
+    'argument' if num_more_args == 1 else 'arguments')
+
+def format_native_record(script, record, natives):
+  name = '<unknown>'
+  if script is not None and 0 <= record.index < len(script.natives):
+    name = script.natives[record.index]
+  params = natives.get(name, [])
+
+  arg_list = []
+  for i, value in enumerate(record.args):
+    if i < len(params):
+      param = params[i]
+      text = '&' if param.is_reference else ''
+      if param.tag:
+        text += param.tag + ':'
+      text += param.name
+      if param.is_array:
+        text += '[]'
+      if param.is_reference or param.is_array:
+        text += '=@%08x' % (value & 0xffffffff)
+        text += format_captured_data(param.tag, param.is_reference,
+                                     param.is_array, record.arg_data[i])
+      else:
+        text += '=' + format_value(param.tag, value)
+      arg_list.append(text)
+    else:
+      arg_list.append('%d' % value)
+  num_more_args = record.num_args - len(record.args)
+  if num_more_args > 0:
+    arg_list.append(format_more_arguments(num_more_args))
+
+  text = 'native %s (%s)' % (name, ', '.join(arg_list))
+  if record.retval is not None:
+    text += ' -> %d' % record.retval
+  return text
+
+def format_record(script, record, natives):
+  if record.kind == KIND_NATIVE:
+    return format_native_record(script, record, natives)
+
+  name = '??'
+  args = []
+  if script is not None:
+    function = script.get_function(record.caller_address)
+    if script.main == record.caller_address:
+      name = 'main'
+    elif function is not None:
+      name = function.name
+      tag_name = script.get_tag_name(function.tag)
+      if tag_name and tag_name != '_':
+        name = tag_name + ':' + name
+      if record.caller_address in script.publics:
+        name = 'public ' + name
+    elif record.caller_address in script.publics:
+      name = 'public ' + script.publics[record.caller_address]
+    args = script.arguments.get(record.caller_address, [])
+
+  arg_list = []
+  for i, value in enumerate(record.args):
+    if i < len(args):
+      arg_list.append(format_argument(script, args[i], value,
+                                      record.arg_data[i]))
+    else:
+      arg_list.append('%d' % value)
+  num_more_args = record.num_args - len(record.args)
+  if num_more_args > 0:
+    arg_list.append(format_more_arguments(num_more_args))
+
+  text = '%s (%s)' % (name, ', '.join(arg_list))
+  if script is not None and record.return_address != 0:
+    text += ' at ' + script.get_location(record.return_address)
+  return text
+
+def find_script(path, search_dirs):
+  candidates = [path]
+  for directory in search_dirs:
+    candidates.append(os.path.join(directory, os.path.basename(path)))
+  for candidate in candidates:
+    if os.path.isfile(candidate):
+      return candidate
+  return None
+
+def load_script(reader, script_id, search_dirs):
+  path = reader.script_paths.get(script_id, '')
+  filename = find_script(path, search_dirs) if path else None
+  if filename is None:
+    sys.stderr.write('Could not find script %s\n' % (path or script_id))
+    return None
+  with open(filename, 'rb') as file:
+    data = file.read()
+  if fnv1a(data) != reader.script_hashes.get(script_id):
+    sys.stderr.write('Warning: %s differs from the traced script\n' %
+                     filename)
+  return Script(path, data)
+
+def main(argv):
+  arg_parser = argparse.ArgumentParser()
+  arg_parser.add_argument('-f', '--file', default='crashdetect_trace.bin',
+                          help='set input file')
+  arg_parser.add_argument('-s', '--search-path', action='append',
+                          default=[], help='add a directory to look for '
+                                           'scripts in')
+  arg_parser.add_argument('-n', '--no-names', action='store_true',
+                          default=False, help='don\'t load scripts')
+  arg_parser.add_argument('-i', '--natives', action='append', default=[],
+                          help='read native declarations from a file')
+  args = arg_parser.parse_args(argv[1:])
+
+  natives = load_natives(args.natives)
+
+  with open(args.file, 'rb') as file:
+    reader = TraceReader(file)
+
+  scripts = {}
+  start_time = datetime.datetime.fromtimestamp(reader.start_time)
+  for record in reader.records():
+    if record.script_id not in scripts:
+      script = None
+      if not args.no_names:
+        script = load_script(reader, record.script_id, args.search_path)
+      scripts[record.script_id] = script
+    script = scripts[record.script_id]
+    time = start_time + datetime.timedelta(microseconds=record.time)
+    script_name = script.name if script is not None else \
+      os.path.basename(reader.script_paths.get(record.script_id, '?'))
+    print('[%s] %s: %s' % (time.strftime('%H:%M:%S.%f'), script_name,
+                           format_record(script, record, natives)))
+
+if __name__ == '__main__':
+  main(sys.argv)
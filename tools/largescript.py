@@ -0,0 +1,144 @@
+#!/usr/bin/env python
+#
+# Copyright (c) 2026 Zeex
+# All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions are met:
+#
+# 1. Redistributions of source code must retain the above copyright notice,
+#    this list of conditions and the following disclaimer.
+# 2. Redistributions in binary form must reproduce the above copyright notice,
+#    this list of conditions and the following disclaimer in the documentation
+#    and/or other materials provided with the distribution.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+# AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+# IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+# ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+# LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+# CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+# SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+# INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+# CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+# ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+# POSSIBILITY OF SUCH DAMAGE.
+#
+# Generates large scripts for testing how CrashDetect scales with script
+# size: debug info load time, memory used by the lookup indexes and how
+# long it takes to symbolize a backtrace. This is a bigger sibling of
+# 64k.py, which only stresses the line table.
+#
+# The script has --functions functions with --locals local variables and
+# --lines statements each, --automata automata with --states states each,
+# and a call chain --depth calls deep that is run from main(). With --halt
+# the bottom of the chain stops with a run time error, so that a backtrace
+# of that depth is printed.
+#
+# Compiled with -d3, every function takes roughly 1 KB of code and debug
+# info with the default settings, so e.g. --functions 1000 gives a 1 MB
+# .amx and --functions 50000 about 50 MB. With --pawncc the script is
+# compiled right away and the size of the resulting .amx is printed.
+
+import argparse
+import os
+import subprocess
+import sys
+
+def write_function(out, index, num_functions, num_locals, num_lines):
+  out.write('f%d(a, b) {\n' % index)
+  for i in range(num_locals):
+    out.write('\tnew l%d = a + %d;\n' % (i, i))
+  for i in range(num_lines):
+    if num_locals > 0:
+      out.write('\tl%d += b * %d;\n' % (i % num_locals, i + 1))
+    else:
+      out.write('\ta += b * %d;\n' % (i + 1))
+  # Makes the next function referenced so that the compiler keeps it. The
+  # condition is never true at run time.
+  if index + 1 < num_functions:
+    out.write('\tif (a == cellmin) {\n')
+    out.write('\t\tf%d(a, b);\n' % (index + 1))
+    out.write('\t}\n')
+  if num_locals > 0:
+    out.write('\treturn %s;\n' %
+              ' + '.join('l%d' % i for i in range(num_locals)))
+  else:
+    out.write('\treturn a;\n')
+  out.write('}\n\n')
+
+def write_automaton(out, index, num_states):
+  for i in range(num_states):
+    out.write('s%d() <a%d:st%d> {\n' % (index, index, i))
+    out.write('\treturn %d;\n' % i)
+    out.write('}\n\n')
+
+def write_call_chain(out, depth, halt):
+  for i in range(depth):
+    out.write('chain%d(n) {\n' % i)
+    if i + 1 < depth:
+      out.write('\treturn chain%d(n + 1);\n' % (i + 1))
+    elif halt:
+      out.write('\t#emit halt 1\n')
+      out.write('\treturn n;\n')
+    else:
+      out.write('\treturn n;\n')
+    out.write('}\n\n')
+
+def write_script(out, args):
+  out.write('#include <core>\n')
+  out.write('#include <console>\n\n')
+  if args.depth > 0:
+    # Each call in the chain takes 4 cells of stack.
+    out.write('#pragma dynamic %d\n\n' % (4096 + args.depth * 4))
+  for i in range(args.functions):
+    write_function(out, i, args.functions, args.locals, args.lines)
+  for i in range(args.automata):
+    write_automaton(out, i, args.states)
+  write_call_chain(out, args.depth, args.halt)
+  out.write('main() {\n')
+  out.write('\tnew x = 0;\n')
+  if args.functions > 0:
+    out.write('\tx += f0(1, 2);\n')
+  if args.states > 0:
+    for i in range(args.automata):
+      out.write('\tstate a%d:st%d;\n' % (i, i % args.states))
+      out.write('\tx += s%d();\n' % i)
+  if args.depth > 0:
+    out.write('\tx += chain0(0);\n')
+  out.write('\tprintf("%d", x);\n')
+  out.write('}\n')
+
+def main(argv):
+  arg_parser = argparse.ArgumentParser()
+  arg_parser.add_argument('-o', '--output', default='large.pwn',
+                          help='set output file')
+  arg_parser.add_argument('-n', '--functions', type=int, default=1000,
+                          help='set number of functions')
+  arg_parser.add_argument('-m', '--locals', type=int, default=8,
+                          help='set number of locals in each function')
+  arg_parser.add_argument('-l', '--lines', type=int, default=20,
+                          help='set number of statements in each function')
+  arg_parser.add_argument('-a', '--automata', type=int, default=0,
+                          help='set number of automata')
+  arg_parser.add_argument('-s', '--states', type=int, default=4,
+                          help='set number of states in each automaton')
+  arg_parser.add_argument('-d', '--depth', type=int, default=0,
+                          help='set depth of the call chain run by main()')
+  arg_parser.add_argument('--halt', action='store_true', default=False,
+                          help='stop with an error at the end of the chain')
+  arg_parser.add_argument('--pawncc', help='compile the script with -d3 '
+                                           'using this compiler')
+  args = arg_parser.parse_args(argv[1:])
+
+  with open(args.output, 'w') as out:
+    write_script(out, args)
+
+  if args.pawncc:
+    amx_file = os.path.splitext(args.output)[0] + '.amx'
+    subprocess.check_call([args.pawncc, '-d3', '-;+', '-(+',
+                           '-o' + amx_file, args.output])
+    print('%s: %d bytes' % (amx_file, os.path.getsize(amx_file)))
+
+if __name__ == '__main__':
+  main(sys.argv)
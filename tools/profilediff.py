@@ -0,0 +1,205 @@
+#!/usr/bin/env python
+#
+# Copyright (c) 2026 Zeex
+# All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions are met:
+#
+# 1. Redistributions of source code must retain the above copyright notice,
+#    this list of conditions and the following disclaimer.
+# 2. Redistributions in binary form must reproduce the above copyright notice,
+#    this list of conditions and the following disclaimer in the documentation
+#    and/or other materials provided with the distribution.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+# AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+# IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+# ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+# LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+# CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+# SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+# INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+# CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+# ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+# POSSIBILITY OF SUCH DAMAGE.
+#
+# Compares two profiles written by CrashDetect, e.g. from before and after
+# a deploy, and prints the functions and call sites whose share of the
+# total changed the most. Both profiles must be of the same kind:
+#
+#  * folded stacks written by "profiler 1" (crashdetect_profile.txt), where
+#    the cost is the number of samples, or
+#  * call graphs written by "profile callgraph" (callgrind.out.<script>),
+#    where the cost is time in microseconds.
+#
+# Costs are divided by the total of each profile, so profiles of different
+# length can be compared. Anything whose share grew by more than the
+# threshold (in percentage points) is reported as a regression and makes
+# the exit status 1, so this can be used to fail a release check.
+
+import argparse
+import collections
+import sys
+
+class Profile(object):
+  def __init__(self):
+    self.total = 0
+    # function -> cost of the function itself / with what it calls
+    self.self_costs = collections.defaultdict(int)
+    self.inclusive_costs = collections.defaultdict(int)
+    # (caller, callee) -> cost of the callee when called from the caller
+    self.call_costs = collections.defaultdict(int)
+
+def read_folded(lines):
+  profile = Profile()
+  for line in lines:
+    line = line.rstrip('\n')
+    stack, _, count = line.rpartition(' ')
+    if not stack:
+      continue
+    try:
+      count = int(count)
+    except ValueError:
+      continue
+    frames = stack.split(';')
+    profile.total += count
+    profile.self_costs[frames[-1]] += count
+    # Recursive functions are only counted once per stack.
+    for frame in set(frames):
+      profile.inclusive_costs[frame] += count
+    for site in set(zip(frames, frames[1:])):
+      profile.call_costs[site] += count
+  return profile
+
+def read_callgrind(lines):
+  profile = Profile()
+  names = {}
+
+  # Names may be compressed: "(id) name" defines an ID, "(id)" refers to it.
+  def get_name(value):
+    value = value.strip()
+    if value.startswith('('):
+      id, _, name = value.partition(')')
+      name = name.strip()
+      if name:
+        names[id] = name
+      return names.get(id, value)
+    return value
+
+  function = None
+  callee = None
+  for line in lines:
+    line = line.strip()
+    if not line or line.startswith('#'):
+      continue
+    key, sep, value = line.partition('=')
+    if sep and key in ('fn', 'cfn', 'cfi', 'fl', 'fi', 'fe', 'calls'):
+      if key == 'fn':
+        function = get_name(value)
+        profile.self_costs[function] += 0
+      elif key == 'cfn':
+        # The line after the following "calls=" has the inclusive cost of
+        # the call.
+        callee = get_name(value)
+      continue
+    if ':' in line and not line[0].isdigit() and not line[0] in '+-*':
+      continue  # header, e.g. "events: Microseconds"
+    fields = line.split()
+    if len(fields) < 2 or function is None:
+      continue
+    try:
+      cost = int(fields[1])
+    except ValueError:
+      continue
+    if callee is not None:
+      profile.call_costs[(function, callee)] += cost
+      profile.inclusive_costs[function] += cost
+      callee = None
+    else:
+      profile.self_costs[function] += cost
+      profile.inclusive_costs[function] += cost
+      profile.total += cost
+  return profile
+
+def read_profile(filename):
+  with open(filename) as f:
+    lines = f.readlines()
+  if lines and lines[0].startswith('# callgrind format'):
+    return read_callgrind(lines)
+  return read_folded(lines)
+
+def compare(old_costs, old_total, new_costs, new_total):
+  """Returns (key, old share, new share) for each key, in percent."""
+  result = []
+  for key in set(old_costs) | set(new_costs):
+    old = 100.0 * old_costs.get(key, 0) / old_total if old_total else 0.0
+    new = 100.0 * new_costs.get(key, 0) / new_total if new_total else 0.0
+    result.append((key, old, new))
+  result.sort(key=lambda r: abs(r[2] - r[1]), reverse=True)
+  return result
+
+def print_table(title, rows, args, out):
+  out.write('%s:\n' % title)
+  out.write('%8s %8s %8s  %s\n' % ('OLD %', 'NEW %', 'CHANGE', 'NAME'))
+  shown = 0
+  for name, old, new in rows:
+    if shown >= args.lines or abs(new - old) < args.min_change:
+      break
+    mark = ' !' if new - old > args.threshold else ''
+    out.write('%8.2f %8.2f %+8.2f  %s%s\n' % (old, new, new - old, name,
+                                              mark))
+    shown += 1
+  if shown == 0:
+    out.write('(no changes)\n')
+  out.write('\n')
+
+def main(argv):
+  arg_parser = argparse.ArgumentParser(
+    description='Compare two CrashDetect profiles')
+  arg_parser.add_argument('old', help='profile from before the change')
+  arg_parser.add_argument('new', help='profile from after the change')
+  arg_parser.add_argument('-t', '--threshold', type=float, default=1.0,
+                          help='growth in percentage points of the total '
+                               'that counts as a regression')
+  arg_parser.add_argument('-m', '--min-change', type=float, default=0.1,
+                          help='hide changes smaller than this many '
+                               'percentage points')
+  arg_parser.add_argument('-n', '--lines', type=int, default=20,
+                          help='how many entries to show in each table')
+  args = arg_parser.parse_args(argv[1:])
+
+  try:
+    old = read_profile(args.old)
+    new = read_profile(args.new)
+  except (OSError, IOError) as e:
+    sys.stderr.write('%s\n' % e)
+    sys.exit(2)
+  if old.total == 0 or new.total == 0:
+    sys.stderr.write('Profile is empty: %s\n' %
+                     (args.old if old.total == 0 else args.new))
+    sys.exit(2)
+
+  out = sys.stdout
+  out.write('Total: %d -> %d\n\n' % (old.total, new.total))
+  tables = [
+    ('Functions (self)', compare(old.self_costs, old.total,
+                                 new.self_costs, new.total)),
+    ('Functions (inclusive)', compare(old.inclusive_costs, old.total,
+                                      new.inclusive_costs, new.total)),
+    ('Call sites', [('%s -> %s' % key, o, n) for key, o, n in
+                    compare(old.call_costs, old.total,
+                            new.call_costs, new.total)]),
+  ]
+  regressions = 0
+  for title, rows in tables:
+    print_table(title, rows, args, out)
+    regressions += sum(1 for _, o, n in rows if n - o > args.threshold)
+
+  if regressions:
+    out.write('%d regressions above %.2f percentage points (marked with !)\n'
+              % (regressions, args.threshold))
+    sys.exit(1)
+
+if __name__ == '__main__':
+  main(sys.argv)
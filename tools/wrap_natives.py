@@ -27,9 +27,72 @@
 import re
 import sys
 
+# With --signatures, prints the declarations of all natives found in the
+# input files instead of wrapping them. The output can be passed to
+# decodetrace.py to show native arguments by name.
+#
+# With --table, prints the same in the format that CrashDetect reads with
+# "trace_native_signatures" (see src/nativesignatures.h), so that natives
+# are traced with their arguments. This is meant to be run as part of the
+# server's build, over the same includes that the scripts use.
+
+TABLE_HEADER = '# CrashDetect native signatures'
+
+def split_params(params):
+  parts = []
+  depth = 0
+  start = 0
+  for i, c in enumerate(params):
+    if c in '{[(':
+      depth += 1
+    elif c in '}])':
+      depth -= 1
+    elif c == ',' and depth == 0:
+      parts.append(params[start:i])
+      start = i + 1
+  parts.append(params[start:])
+  return [part.strip() for part in parts if part.strip()]
+
+def format_table_param(param):
+  param = re.sub(r'^const\s+', '', param.split('=')[0].strip())
+  if param.endswith('...'):
+    return '...'
+  is_reference = param.startswith('&')
+  param = param.lstrip('&').strip()
+  tag = ''
+  match = re.match(r'(\{.*?\}|[A-Za-z_@][A-Za-z0-9_@]*)\s*:\s*(.*)', param)
+  if match is not None:
+    tag, param = re.sub(r'\s+', '', match.group(1)), match.group(2)
+  dims = re.findall(r'\[(.*?)\]', param)
+  name = param.split('[')[0].strip()
+  if is_reference:
+    kind = 'r'
+  elif not dims:
+    kind = 'v'
+  elif len(dims) == 1 and not tag and ':' not in dims[0]:
+    # Same as CrashDetect does for functions: untagged one-dimensional
+    # arrays are assumed to be strings.
+    kind = 's'
+  else:
+    kind = 'a'
+  if tag:
+    return '%s:%s:%s' % (kind, tag, name)
+  return '%s:%s' % (kind, name)
+
+def format_table_entry(native):
+  name = re.sub(r'(?:[A-Za-z_@][A-Za-z0-9_@]*:\s*)?(.*?)\s*\(.*', r'\1',
+                native)
+  params = re.sub(r'.*?\((.*)\)', r'\1', native)
+  return ' '.join([name] + [format_table_param(param)
+                            for param in split_params(params)])
+
 def main(argv):
+  options = ('--signatures', '--table')
+  signatures = '--signatures' in argv[1:]
+  table = '--table' in argv[1:]
   natives = []
-  for filename in argv[1:]:
+  table_natives = []
+  for filename in [arg for arg in argv[1:] if arg not in options]:
     with open(filename, 'r') as f:
       for line in f.readlines():
         match = re.match(r'native\s+([a-zA-Z_@][a-zA-Z0-9_@]*\(.*?\))\s*;',
@@ -37,6 +100,24 @@ def main(argv):
         if match is not None:
           native = match.group(1)
           natives.append(native)
+          table_natives.append(native)
+          continue
+        # Natives with a return tag aren't wrapped, but their arguments can
+        # still be traced.
+        match = re.match(r'native\s+([a-zA-Z_@][a-zA-Z0-9_@]*:\s*'
+                         r'[a-zA-Z_@][a-zA-Z0-9_@]*\(.*?\))\s*;',
+                         line, re.MULTILINE)
+        if match is not None:
+          table_natives.append(match.group(1))
+  if signatures:
+    for native in natives:
+      print('native %s;' % native)
+    return 0
+  if table:
+    print(TABLE_HEADER)
+    for native in table_natives:
+      print(format_table_entry(native))
+    return 0
   for native in natives:
     name = re.sub(r'(.*)\(.*\)', r'\1', native)
     params = re.sub(r'.*\((.*)\)', r'\1', native)